@@ -0,0 +1,437 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Performance regression benchmarks for the pure logic parts of the runtime, run on a workstation.
+  *
+  * Each benchmark repeats an operation and reports its average cost in nanoseconds. Results are written
+  * one per line as "name ns_per_op iterations", after a header naming the commit measured, so that the
+  * output of one commit can be given as the baseline for the next:
+  *
+  *   microbit-host-benchmark [--iterations N] [--output FILE] [--baseline FILE] [--tolerance PERCENT]
+  *
+  * With a baseline, any benchmark slower than its baseline by more than the tolerance (default 10%)
+  * is reported, and the program exits with a non-zero status. It does the same if any heap allocation
+  * fails while the benchmarks run, as their results would then not be comparable.
+  *
+  * Host timings don't predict cycle counts on the nRF51, but they do show when a change makes a hot path
+  * do more work. The program is built with frame pointers, for use with perf, valgrind and gprof.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitMessageBus.h"
+#include "MicroBitFileSystem.h"
+#include "MicroBitHeapAllocator.h"
+#include "ManagedString.h"
+#include "MicroBitImage.h"
+#include "ErrorNo.h"
+
+#include <time.h>
+
+#ifndef MICROBIT_HOST_COMMIT
+#define MICROBIT_HOST_COMMIT                "unknown"
+#endif
+
+// The maximum number of benchmarks, and of baseline entries read.
+#define MICROBIT_HOST_BENCHMARK_MAX         32
+#define MICROBIT_HOST_BENCHMARK_NAME_LENGTH 32
+
+// The number of listeners registered for the event dispatched by the message bus benchmark.
+#define MICROBIT_HOST_BENCHMARK_LISTENERS   4
+
+// An event source not used by the runtime.
+#define MICROBIT_HOST_BENCHMARK_ID          1023
+
+struct HostBenchmarkResult
+{
+    char        name[MICROBIT_HOST_BENCHMARK_NAME_LENGTH];
+    double      ns_per_op;
+    uint32_t    iterations;
+};
+
+static HostBenchmarkResult results[MICROBIT_HOST_BENCHMARK_MAX];
+static int result_count = 0;
+
+static volatile uint32_t benchmark_counter = 0;
+static uint32_t benchmark_sink = 0;
+
+static uint64_t host_time_ns()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static void record(const char *name, uint64_t start, uint32_t iterations)
+{
+    HostBenchmarkResult &r = results[result_count++];
+
+    snprintf(r.name, sizeof(r.name), "%s", name);
+    r.ns_per_op = (double)(host_time_ns() - start) / iterations;
+    r.iterations = iterations;
+
+    printf("%-28s %12.1f ns/op %10u\n", r.name, r.ns_per_op, (unsigned int) r.iterations);
+}
+
+static void benchmark_handler(MicroBitEvent)
+{
+    benchmark_counter++;
+}
+
+/**
+  * Allocation and release of a small block, which is served by the size class free lists when they are enabled.
+  */
+static void benchmark_heap_small(uint32_t iterations)
+{
+    uint64_t start = host_time_ns();
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        void *p = malloc(16);
+        benchmark_sink += (uintptr_t) p;
+        free(p);
+    }
+
+    record("heap_small", start, iterations);
+}
+
+/**
+  * Replacement of randomly chosen allocations of mixed sizes, keeping the heap partially fragmented.
+  */
+static void benchmark_heap_churn(uint32_t iterations)
+{
+    void *slots[32];
+    uint32_t seed = 1;
+
+    memset(slots, 0, sizeof(slots));
+
+    uint64_t start = host_time_ns();
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+
+        int slot = (seed >> 16) % 32;
+        int size = 8 + (seed >> 8) % 120;
+
+        free(slots[slot]);
+        slots[slot] = malloc(size);
+    }
+
+    record("heap_churn", start, iterations);
+
+    for (int i = 0; i < 32; i++)
+        free(slots[i]);
+}
+
+static void benchmark_string(uint32_t iterations)
+{
+    ManagedString hello("hello");
+    ManagedString world(" world");
+    uint64_t start;
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ManagedString s = hello + world;
+        benchmark_sink += s.length();
+    }
+    record("string_concat", start, iterations);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ManagedString s((int) i);
+        benchmark_sink += s.length();
+    }
+    record("string_from_int", start, iterations);
+
+    ManagedString text("the quick brown fox jumps over the lazy dog");
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ManagedString s = text.substring(i % 20, 12);
+        benchmark_sink += s.charAt(0);
+    }
+    record("string_substring", start, iterations);
+
+    ManagedString other("the quick brown fox jumps over the lazy cat");
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+        benchmark_sink += (text == other) + (text < other);
+    record("string_compare", start, iterations);
+}
+
+static void benchmark_image(uint32_t iterations)
+{
+    uint64_t start;
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        MicroBitImage image("0,255,0,255,0\n255,0,255,0,255\n0,255,0,255,0\n255,0,255,0,255\n0,255,0,255,0\n");
+        benchmark_sink += image.getWidth();
+    }
+    record("image_from_string", start, iterations);
+
+    MicroBitImage canvas(5, 5);
+    MicroBitImage sprite("0,255,0\n255,255,255\n0,255,0\n");
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+        canvas.paste(sprite, i % 5 - 2, i % 3 - 1);
+    record("image_paste", start, iterations);
+
+    MicroBitImage wide(40, 5);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        wide.print('A' + i % 26, 35, 0);
+        wide.shiftLeft(1);
+    }
+    record("image_print_shift", start, iterations);
+}
+
+static void benchmark_message_bus(uint32_t iterations)
+{
+    MicroBitMessageBus bus;
+    MicroBitComponent &component = bus;
+    uint64_t start;
+
+    for (int i = 0; i < MICROBIT_HOST_BENCHMARK_LISTENERS; i++)
+        bus.listen(MICROBIT_HOST_BENCHMARK_ID, i + 1, benchmark_handler, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    bus.listen(MICROBIT_HOST_BENCHMARK_ID, MICROBIT_EVT_ANY, benchmark_handler, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        MicroBitEvent evt(MICROBIT_HOST_BENCHMARK_ID, i % MICROBIT_HOST_BENCHMARK_LISTENERS + 1, CREATE_ONLY);
+        bus.send(evt);
+    }
+    record("bus_send", start, iterations);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        bus.listen(MICROBIT_HOST_BENCHMARK_ID + 1, i % 8 + 1, benchmark_handler);
+        bus.ignore(MICROBIT_HOST_BENCHMARK_ID + 1, i % 8 + 1, benchmark_handler);
+        // Listeners are released by the idle loop on the device.
+        component.idleTick();
+    }
+    record("bus_listen_ignore", start, iterations);
+
+    if (benchmark_counter != 2 * iterations)
+        printf("bus_send: expected %u deliveries, saw %u\n", (unsigned int) (2 * iterations), (unsigned int) benchmark_counter);
+}
+
+static void benchmark_file_system(uint32_t iterations)
+{
+    MicroBitFileSystem fs;
+    uint8_t chunk[64];
+    uint64_t start;
+    int fd;
+
+    memset(chunk, 0x5A, sizeof(chunk));
+    iterations = iterations / 100 + 1;
+
+    uint32_t erases = microbit_host_flash_erase_count();
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        fs.remove("bench.dat");
+        fd = fs.open("bench.dat", MB_WRITE | MB_CREAT);
+
+        for (int j = 0; j < 16; j++)
+            fs.write(fd, chunk, sizeof(chunk));
+
+        fs.close(fd);
+    }
+    record("fs_write_1k", start, iterations);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        fd = fs.open("bench.dat", MB_READ);
+
+        for (int j = 0; j < 16; j++)
+            benchmark_sink += fs.read(fd, chunk, sizeof(chunk));
+
+        fs.close(fd);
+    }
+    record("fs_read_1k", start, iterations);
+
+    start = host_time_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        fd = fs.open("bench.dat", MB_READ);
+        fs.close(fd);
+    }
+    record("fs_open_close", start, iterations);
+
+    printf("fs: %u pages erased\n", (unsigned int) (microbit_host_flash_erase_count() - erases));
+}
+
+/**
+  * Compares the results against those in the given file.
+  *
+  * @return the number of benchmarks slower than their baseline by more than the given percentage, or -1 if the file could not be read.
+  */
+static int compare(const char *filename, double tolerance)
+{
+    FILE *f = fopen(filename, "r");
+    char line[128];
+    char name[MICROBIT_HOST_BENCHMARK_NAME_LENGTH];
+    double baseline;
+    int regressions = 0;
+
+    if (f == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#' || sscanf(line, "%31s %lf", name, &baseline) != 2 || baseline <= 0)
+            continue;
+
+        for (int i = 0; i < result_count; i++)
+        {
+            if (strcmp(results[i].name, name) != 0)
+                continue;
+
+            double change = (results[i].ns_per_op - baseline) * 100.0 / baseline;
+
+            if (change > tolerance)
+            {
+                printf("REGRESSION %-28s %12.1f -> %12.1f ns/op (%+.1f%%)\n", name, baseline, results[i].ns_per_op, change);
+                regressions++;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return regressions;
+}
+
+static int save(const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+
+    if (f == NULL)
+        return -1;
+
+    fprintf(f, "# microbit-dal host benchmark %s\n", MICROBIT_HOST_COMMIT);
+
+    for (int i = 0; i < result_count; i++)
+        fprintf(f, "%s %.1f %u\n", results[i].name, results[i].ns_per_op, (unsigned int) results[i].iterations);
+
+    fclose(f);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 100000;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    double tolerance = 10.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baseline = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            tolerance = strtod(argv[++i], NULL);
+        else
+        {
+            fprintf(stderr, "usage: %s [--iterations N] [--output FILE] [--baseline FILE] [--tolerance PERCENT]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (iterations == 0)
+        iterations = 1;
+
+    printf("microbit-dal host benchmark %s\n", MICROBIT_HOST_COMMIT);
+
+    MicroBitHeapStatistics stats;
+    uint32_t failures = 0;
+
+    // The C++ runtime makes a large speculative allocation before main() that the simulated heap can't satisfy
+    // (see MICROBIT_PANIC_HEAP_FULL), so only the failures after this point are counted.
+    if (microbit_heap_get_statistics(0, stats) == MICROBIT_OK)
+        failures = stats.failures;
+
+    benchmark_heap_small(iterations);
+    benchmark_heap_churn(iterations);
+    benchmark_string(iterations);
+    benchmark_image(iterations);
+    benchmark_message_bus(iterations);
+    benchmark_file_system(iterations);
+
+    if (microbit_heap_get_statistics(0, stats) == MICROBIT_OK)
+    {
+        failures = stats.failures - failures;
+        printf("heap: %u of %u bytes used, peak %u, %u allocation failures\n", (unsigned int) stats.used_bytes,
+                (unsigned int) stats.total_bytes, (unsigned int) stats.peak_used_bytes, (unsigned int) failures);
+    }
+
+    if (output && save(output) != 0)
+    {
+        fprintf(stderr, "cannot write %s\n", output);
+        return 2;
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%u heap allocations failed while benchmarking\n", (unsigned int) failures);
+        return 1;
+    }
+
+    if (baseline)
+    {
+        int regressions = compare(baseline, tolerance);
+
+        if (regressions < 0)
+        {
+            fprintf(stderr, "cannot read %s\n", baseline);
+            return 2;
+        }
+
+        if (regressions > 0)
+            return 1;
+    }
+
+    return 0;
+}
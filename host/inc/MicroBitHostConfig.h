@@ -0,0 +1,54 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Compile time configuration for host builds of the runtime.
+  *
+  * This is included ahead of every source file by the host build, in the same way as a yotta
+  * config file, and overrides the defaults in MicroBitConfig.h where the host differs from the device.
+  */
+
+#ifndef MICROBIT_HOST_CONFIG_H
+#define MICROBIT_HOST_CONFIG_H
+
+// Identifies a host build, for the few places that must behave differently.
+#define MICROBIT_HOST                           1
+
+// Pointers are twice the size on the host, so the simulated SRAM is larger than the nRF51's to hold
+// a comparable number of objects. The heap still ends MICROBIT_STACK_SIZE below the top of SRAM.
+#define MICROBIT_SRAM_END                       0x20008000
+
+// There is no SoftDevice, so there is no SoftDevice memory to reclaim.
+#define MICROBIT_BLE_ENABLED                    0
+#define MICROBIT_HEAP_REUSE_SD                  0
+
+// The C++ runtime makes large speculative allocations at start up that are expected to fail.
+#define MICROBIT_PANIC_HEAP_FULL                0
+
+// The simulated program image fills the FLASH below this address. The file system occupies the remainder.
+#define FLASH_PROGRAM_END                       0x00020000
+
+#define MICROBIT_DAL_VERSION                    "host"
+
+#endif
@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated hardware abstraction layer, standing in for mbed-classic and the nRF51 SDK in host builds.
+  *
+  * Only the small part of the platform used by the pure logic parts of the runtime is provided:
+  * interrupt masking, the FICR and NVMC peripherals, and the SRAM and FLASH memories themselves.
+  * SRAM and FLASH are placed at their nRF51 addresses by the host linker flags, so that code which
+  * treats addresses as 32 bit values behaves as it does on the device.
+  *
+  * The host build is single threaded and has no interrupts, so masking interrupts has no effect.
+  */
+
+#ifndef MICROBIT_HOST_MBED_H
+#define MICROBIT_HOST_MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The size of the simulated memories, in bytes.
+#define MICROBIT_HOST_FLASH_BASE        0x00010000
+#define MICROBIT_HOST_FLASH_END         0x00040000
+#define MICROBIT_HOST_SRAM_BASE         0x20000000
+
+extern "C" uint8_t microbit_host_flash[];
+extern "C" uint8_t microbit_host_sram[];
+
+/*
+ * Cortex-M0 core intrinsics.
+ */
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline uint32_t __get_IPSR() { return 0; }
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __WFE() {}
+inline void __WFI() {}
+inline void __SEV() {}
+inline void __NOP() {}
+inline void __DSB() {}
+inline void __ISB() {}
+
+extern uint32_t SystemCoreClock;
+
+void wait_ms(int ms);
+void wait_us(int us);
+
+/*
+ * GPIO pin names, as used to describe the LED matrix.
+ */
+typedef enum
+{
+    p0 = 0, p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15,
+    p16, p17, p18, p19, p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+    NC = (int)0xFFFFFFFF
+} PinName;
+
+/*
+ * Factory information configuration registers.
+ */
+struct NRF_FICR_Type
+{
+    uint32_t CODEPAGESIZE;
+    uint32_t CODESIZE;
+    uint32_t DEVICEID[2];
+};
+
+extern NRF_FICR_Type microbit_host_ficr;
+#define NRF_FICR (&microbit_host_ficr)
+
+/*
+ * Non-volatile memory controller. Writing ERASEPAGE erases the simulated FLASH page at that address,
+ * provided erase has been enabled through CONFIG. The controller is never busy.
+ */
+#define NVMC_READY_READY_Busy           0
+#define NVMC_READY_READY_Ready          1
+#define NVMC_CONFIG_WEN_Pos             0
+#define NVMC_CONFIG_WEN_Ren             0
+#define NVMC_CONFIG_WEN_Wen             1
+#define NVMC_CONFIG_WEN_Een             2
+
+struct NRF_NVMC_ErasePage
+{
+    NRF_NVMC_ErasePage &operator=(uint32_t address);
+};
+
+struct NRF_NVMC_Type
+{
+    uint32_t READY;
+    uint32_t CONFIG;
+    NRF_NVMC_ErasePage ERASEPAGE;
+};
+
+extern NRF_NVMC_Type microbit_host_nvmc;
+#define NRF_NVMC (&microbit_host_nvmc)
+
+/**
+  * Restores the simulated FLASH to its erased state, with every page erased.
+  */
+void microbit_host_flash_reset();
+
+/**
+  * Determines the number of pages erased through the simulated NVMC since start up.
+  */
+uint32_t microbit_host_flash_erase_count();
+
+#endif
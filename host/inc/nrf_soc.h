@@ -0,0 +1,46 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * SoftDevice calls used by the runtime, for host builds.
+  *
+  * There is no SoftDevice on the host, so ble_running() is always false and FLASH is written
+  * directly through the simulated NVMC. These calls are never made, and simply fail.
+  */
+
+#ifndef MICROBIT_HOST_NRF_SOC_H
+#define MICROBIT_HOST_NRF_SOC_H
+
+#include "mbed.h"
+
+#define NRF_SUCCESS                         0
+#define NRF_ERROR_BUSY                      17
+
+#define NRF_EVT_FLASH_OPERATION_SUCCESS     2
+#define NRF_EVT_FLASH_OPERATION_ERROR       3
+
+inline uint32_t sd_flash_write(uint32_t *, uint32_t const *, uint32_t) { return NRF_ERROR_BUSY; }
+inline uint32_t sd_flash_page_erase(uint32_t) { return NRF_ERROR_BUSY; }
+
+#endif
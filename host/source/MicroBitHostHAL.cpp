@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * The simulated hardware used by host builds of the runtime.
+  *
+  * The SRAM and FLASH arrays are placed in their own sections, which the host build links at
+  * MICROBIT_HOST_SRAM_BASE and MICROBIT_HOST_FLASH_BASE. The micro:bit heap allocator is given the
+  * simulated SRAM through the __end__ symbol, exactly as it is given the end of .bss on the device.
+  */
+#include "MicroBitConfig.h"
+#include "mbed.h"
+
+#include <time.h>
+
+extern "C"
+{
+__attribute__((section("microbit_flash"), aligned(PAGE_SIZE))) uint8_t microbit_host_flash[MICROBIT_HOST_FLASH_END - MICROBIT_HOST_FLASH_BASE];
+__attribute__((section("microbit_sram"), aligned(16))) uint8_t microbit_host_sram[MICROBIT_SRAM_END - MICROBIT_HOST_SRAM_BASE];
+}
+
+uint32_t SystemCoreClock = 16000000;
+
+// A 256KB nRF51822, with 1KB pages.
+NRF_FICR_Type microbit_host_ficr = { PAGE_SIZE, MICROBIT_HOST_FLASH_END / PAGE_SIZE, { 0x4d494352, 0x4f424954 } };
+NRF_NVMC_Type microbit_host_nvmc = { NVMC_READY_READY_Ready, NVMC_CONFIG_WEN_Ren, NRF_NVMC_ErasePage() };
+
+static uint32_t flash_erase_count = 0;
+
+/**
+  * Erase the page of simulated FLASH at the given address, if erase is enabled.
+  * Erasing a page outside of the simulated FLASH is a fault, as it would be on the device.
+  */
+NRF_NVMC_ErasePage &NRF_NVMC_ErasePage::operator=(uint32_t address)
+{
+    if (microbit_host_nvmc.CONFIG != NVMC_CONFIG_WEN_Een)
+        return *this;
+
+    if (address % PAGE_SIZE != 0 || address < MICROBIT_HOST_FLASH_BASE || address >= MICROBIT_HOST_FLASH_END)
+    {
+        fprintf(stderr, "NVMC: erase of invalid page 0x%08x\n", (unsigned int) address);
+        abort();
+    }
+
+    memset(&microbit_host_flash[address - MICROBIT_HOST_FLASH_BASE], 0xFF, PAGE_SIZE);
+    flash_erase_count++;
+
+    return *this;
+}
+
+/**
+  * Restores the simulated FLASH to its erased state, with every page erased.
+  */
+void microbit_host_flash_reset()
+{
+    memset(microbit_host_flash, 0xFF, sizeof(microbit_host_flash));
+}
+
+/**
+  * Determines the number of pages erased through the simulated NVMC since start up.
+  */
+uint32_t microbit_host_flash_erase_count()
+{
+    return flash_erase_count;
+}
+
+/*
+ * FLASH is erased when a device is first programmed, so start from the same state.
+ */
+__attribute__((constructor)) static void microbit_host_flash_init()
+{
+    microbit_host_flash_reset();
+}
+
+void wait_us(int us)
+{
+    struct timespec t;
+
+    t.tv_sec = us / 1000000;
+    t.tv_nsec = (us % 1000000) * 1000L;
+
+    nanosleep(&t, NULL);
+}
+
+void wait_ms(int ms)
+{
+    wait_us(ms * 1000);
+}
@@ -0,0 +1,319 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host implementations of the device, system timer and scheduler entry points used by the pure logic
+  * parts of the runtime.
+  *
+  * The fiber scheduler is never started on the host, so the message bus delivers events directly and
+  * idle components are serviced only when the caller asks. Time is taken from the host's monotonic clock,
+  * and system timer events are run from system_timer_tick().
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitDevice.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitFiber.h"
+#include "ErrorNo.h"
+
+#include <time.h>
+
+static char friendly_name[MICROBIT_NAME_LENGTH+1];
+static uint32_t random_value = 0xBBC5EED;
+static SystemTimerEvent *timer_events = NULL;
+
+bool ble_running()
+{
+    return false;
+}
+
+/**
+  * There is no SoftDevice to raise SoC events, so handlers are never called.
+  */
+int microbit_add_soc_event_handler(void (*handler)(uint32_t))
+{
+    return handler == NULL ? MICROBIT_INVALID_PARAMETER : MICROBIT_OK;
+}
+
+uint32_t microbit_serial_number()
+{
+    return NRF_FICR->DEVICEID[1];
+}
+
+char* microbit_friendly_name()
+{
+    memcpy(friendly_name, "host", 5);
+    return friendly_name;
+}
+
+void microbit_reset()
+{
+    exit(0);
+}
+
+const char *microbit_dal_version()
+{
+    return MICROBIT_DAL_VERSION;
+}
+
+void microbit_panic_timeout(int)
+{
+}
+
+/**
+  * There is no display to show the status code on, so report it and stop, leaving a core to inspect.
+  */
+void microbit_panic(int statusCode)
+{
+    fprintf(stderr, "microbit_panic: %d\n", statusCode);
+    abort();
+}
+
+/**
+  * The same Galois LFSR as the device, so that file system block allocation follows the same pattern.
+  */
+int microbit_random(int max)
+{
+    uint32_t m, result;
+
+    if(max <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    max--;
+
+    do {
+        m = (uint32_t)max;
+        result = 0;
+        do {
+            uint32_t rnd = random_value;
+
+            rnd = ((((rnd >> 31) ^ (rnd >> 6) ^ (rnd >> 4) ^ (rnd >> 2) ^ (rnd >> 1) ^ rnd) & 0x0000001) << 31 ) | (rnd >> 1);
+            random_value = rnd;
+
+            result = ((result << 1) | (rnd & 0x00000001));
+        } while(m >>= 1);
+    } while (result > (uint32_t)max);
+
+    return result;
+}
+
+void microbit_seed_random()
+{
+    random_value = 0xBBC5EED;
+}
+
+void microbit_seed_random(uint32_t seed)
+{
+    random_value = seed;
+}
+
+/*
+ * System timer.
+ */
+uint64_t system_timer_current_time_us()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+uint64_t system_timer_current_time()
+{
+    return system_timer_current_time_us() / 1000;
+}
+
+int system_timer_add_component(MicroBitComponent *, int)
+{
+    return MICROBIT_OK;
+}
+
+int system_timer_remove_component(MicroBitComponent *)
+{
+    return MICROBIT_OK;
+}
+
+int system_timer_set_requirement(MicroBitComponent *, int)
+{
+    return MICROBIT_OK;
+}
+
+int system_timer_cancel_event(SystemTimerEvent *event)
+{
+    for (SystemTimerEvent **p = &timer_events; *p != NULL; p = &(*p)->next)
+    {
+        if (*p == event)
+        {
+            *p = event->next;
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_INVALID_PARAMETER;
+}
+
+int system_timer_event_after_us(SystemTimerEvent *event, uint32_t period, void (*callback)(void *), void *context)
+{
+    if (event == NULL || callback == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    system_timer_cancel_event(event);
+
+    event->deadline = (uint32_t) system_timer_current_time_us() + period;
+    event->callback = callback;
+    event->context = context;
+    event->next = timer_events;
+    timer_events = event;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Runs any system timer events that are due.
+  */
+void system_timer_tick()
+{
+    uint32_t now = (uint32_t) system_timer_current_time_us();
+    SystemTimerEvent **p = &timer_events;
+
+    while (*p != NULL)
+    {
+        SystemTimerEvent *event = *p;
+
+        if ((int32_t)(now - event->deadline) < 0)
+        {
+            p = &event->next;
+            continue;
+        }
+
+        *p = event->next;
+        event->callback(event->context);
+        p = &timer_events;
+    }
+}
+
+/*
+ * Fiber scheduler. Nothing blocks on the host, so operations that would deschedule the caller are refused.
+ */
+int fiber_scheduler_running()
+{
+    return 0;
+}
+
+int scheduler_runqueue_empty()
+{
+    return 1;
+}
+
+void schedule()
+{
+}
+
+void fiber_sleep(unsigned long t)
+{
+    wait_ms(t);
+    system_timer_tick();
+}
+
+int fiber_wake_on_event(uint16_t, uint16_t)
+{
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+int fiber_wait_for_event(uint16_t, uint16_t)
+{
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+int invoke(void (*entry_fn)(void), int)
+{
+    if (entry_fn == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    entry_fn();
+    return MICROBIT_OK;
+}
+
+int invoke(void (*entry_fn)(void *), void *param, int)
+{
+    if (entry_fn == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    entry_fn(param);
+    return MICROBIT_OK;
+}
+
+int fiber_add_idle_component(MicroBitComponent *, int)
+{
+    return MICROBIT_OK;
+}
+
+int fiber_remove_idle_component(MicroBitComponent *)
+{
+    return MICROBIT_OK;
+}
+
+int fiber_idle_component_pending(MicroBitComponent *)
+{
+    return MICROBIT_OK;
+}
+
+int fiber_is_idle()
+{
+    return 0;
+}
+
+/*
+ * Semaphores never block on the host, so a wait either takes a unit straight away or is refused.
+ */
+FiberSemaphore::FiberSemaphore(int initial, int max)
+{
+    this->max = max;
+    this->count = initial > max ? max : initial;
+    this->queue = NULL;
+}
+
+int FiberSemaphore::wait()
+{
+    return tryWait() == MICROBIT_OK ? MICROBIT_OK : MICROBIT_NOT_SUPPORTED;
+}
+
+int FiberSemaphore::tryWait()
+{
+    if (count == 0)
+        return MICROBIT_BUSY;
+
+    count--;
+    return MICROBIT_OK;
+}
+
+void FiberSemaphore::notify()
+{
+    if (count < max)
+        count++;
+}
+
+FiberLock::FiberLock() : FiberSemaphore(1, 1)
+{
+}
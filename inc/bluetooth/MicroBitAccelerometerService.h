@@ -35,7 +35,11 @@ DEALINGS IN THE SOFTWARE.
 extern const uint8_t  MicroBitAccelerometerServiceUUID[];
 extern const uint8_t  MicroBitAccelerometerServiceDataUUID[];
 extern const uint8_t  MicroBitAccelerometerServicePeriodUUID[];
+extern const uint8_t  MicroBitAccelerometerServiceBatchUUID[];
 
+// The number of samples in each notification of the batched data characteristic, filling the 20 byte payload
+// after the 16 bit timestamp.
+#define MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES    3
 
 /**
   * Class definition for a MicroBit BLE Accelerometer Service.
@@ -66,6 +70,13 @@ class MicroBitAccelerometerService
      */
     void accelerometerUpdate(MicroBitEvent e);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    /**
+     * Sends as many batches of samples from the accelerometer's stream as the Bluetooth stack will take.
+     */
+    void sendBatches();
+#endif
+
     // Bluetooth stack we're running on.
     BLEDevice           	&ble;
 	MicroBitAccelerometer	&accelerometer;
@@ -73,10 +84,18 @@ class MicroBitAccelerometerService
     // memory for our 8 bit control characteristics.
     uint16_t            accelerometerDataCharacteristicBuffer[3];
     uint16_t            accelerometerPeriodCharacteristicBuffer;
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    // The time of the first sample in milliseconds, followed by the X, Y and Z of each sample.
+    int16_t             accelerometerBatchCharacteristicBuffer[1 + 3 * MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES];
+    bool                batchPending;           // The batch buffer holds a batch yet to be sent.
+#endif
 
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t accelerometerDataCharacteristicHandle;
     GattAttribute::Handle_t accelerometerPeriodCharacteristicHandle;
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattAttribute::Handle_t accelerometerBatchCharacteristicHandle;
+#endif
 };
 
 
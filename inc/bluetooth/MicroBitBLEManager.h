@@ -75,9 +75,27 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_BLE_EDDYSTONE_ADV_INTERVAL     400
 #define MICROBIT_BLE_EDDYSTONE_DEFAULT_POWER    0xF0
 
+// Connection intervals of each connection profile, in units of 1.25 ms.
+#define MICROBIT_BLE_LOW_LATENCY_MIN_INTERVAL   6       // 7.5 ms
+#define MICROBIT_BLE_LOW_LATENCY_MAX_INTERVAL   12      // 15 ms
+#define MICROBIT_BLE_BALANCED_MIN_INTERVAL      8       // 10 ms
+#define MICROBIT_BLE_BALANCED_MAX_INTERVAL      16      // 20 ms
+#define MICROBIT_BLE_LOW_POWER_MIN_INTERVAL     80      // 100 ms
+#define MICROBIT_BLE_LOW_POWER_MAX_INTERVAL     160     // 200 ms
+
+// The number of connection events the micro:bit may skip when it has nothing to send, in the low power profile.
+#define MICROBIT_BLE_LOW_POWER_SLAVE_LATENCY    4
+
+// The number of characteristics that can select the low latency profile while a client has enabled updates on them.
+#define MICROBIT_BLE_HIGH_RATE_CHARACTERISTICS  4
+
 // MicroBitComponent status flags
 #define MICROBIT_BLE_STATUS_STORE_SYSATTR       0x02
 #define MICROBIT_BLE_STATUS_DISCONNECT          0x04
+#define MICROBIT_BLE_STATUS_SERVICES            0x08
+#define MICROBIT_BLE_STATUS_SYSATTR_LOADED      0x10
+#define MICROBIT_BLE_STATUS_ADDED_TO_IDLE       0x20
+#define MICROBIT_BLE_STATUS_STORING_SYSATTR     0x40
 
 extern const int8_t MICROBIT_BLE_POWER_LEVEL[];
 
@@ -91,6 +109,28 @@ struct BLESysAttributeStore
     BLESysAttribute sys_attrs[MICROBIT_BLE_MAXIMUM_BONDS];
 };
 
+/**
+  * The connection parameters the micro:bit asks for, trading throughput and latency against power.
+  */
+enum MicroBitBLEConnectionProfile
+{
+    MICROBIT_BLE_PROFILE_LOW_LATENCY,
+    MICROBIT_BLE_PROFILE_BALANCED,
+    MICROBIT_BLE_PROFILE_LOW_POWER
+};
+
+/**
+  * The time taken by each stage of bringing up the BLE stack (microseconds).
+  * A stage that has not yet run reads as zero.
+  */
+struct MicroBitBLEBootProfile
+{
+    uint32_t stack;                     // Starting the SoftDevice and registering callbacks.
+    uint32_t security;                  // Configuring the security manager, bond table and whitelist.
+    uint32_t services;                  // Registering the core services.
+    uint32_t advertising;               // Building the advertising payload, and starting to advertise.
+};
+
 /**
   * Class definition for the MicroBitBLEManager.
   *
@@ -152,6 +192,23 @@ class MicroBitBLEManager : MicroBitComponent
       */
     void init(ManagedString deviceName, ManagedString serialNumber, EventModel &messageBus, bool enableBonding);
 
+    /**
+      * Registers the core BLE services enabled in MicroBitConfig.h, if this has not already been done.
+      *
+      * This is part of init(), unless MICROBIT_BLE_DEFERRED_SERVICES is set, in which case it is called when
+      * the micro:bit first advertises or enters pairing mode. Call it directly to register the services earlier.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack has not been initialised.
+      */
+    int startServices();
+
+    /**
+      * Determines how long each stage of bringing up the BLE stack took.
+      *
+      * @return the time taken by each stage, in microseconds.
+      */
+    MicroBitBLEBootProfile getBootProfile();
+
     /**
      * Change the output power level of the transmitter to the given value.
      *
@@ -166,6 +223,64 @@ class MicroBitBLEManager : MicroBitComponent
      */
     int setTransmitPower(int power);
 
+    /**
+     * Selects the connection parameters to ask for. If a client is connected, the new parameters are
+     * negotiated immediately.
+     *
+     * While a client has enabled updates on a characteristic registered with addHighRateCharacteristic(),
+     * MICROBIT_BLE_PROFILE_LOW_LATENCY is used, whatever profile is selected here.
+     *
+     * @param profile MICROBIT_BLE_PROFILE_LOW_LATENCY for a 7.5 - 15 ms connection interval,
+     *                MICROBIT_BLE_PROFILE_BALANCED for 10 - 20 ms (the default), or
+     *                MICROBIT_BLE_PROFILE_LOW_POWER for 100 - 200 ms, with some connection events skipped when idle.
+     *
+     * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the profile is not valid.
+     *
+     * @code
+     * // allow the longest intervals, as we only send the occasional event.
+     * bleManager.setConnectionProfile(MICROBIT_BLE_PROFILE_LOW_POWER);
+     * @endcode
+     */
+    int setConnectionProfile(MicroBitBLEConnectionProfile profile);
+
+    /**
+     * Determines the connection profile currently asked for.
+     *
+     * @return the profile in use, which is MICROBIT_BLE_PROFILE_LOW_LATENCY while any high rate characteristic is active.
+     */
+    MicroBitBLEConnectionProfile getConnectionProfile();
+
+    /**
+     * Registers a characteristic that sends data quickly enough to benefit from a short connection interval.
+     * Whenever a client enables notifications or indications on it, MICROBIT_BLE_PROFILE_LOW_LATENCY is
+     * negotiated, until they are disabled again, or the client disconnects.
+     *
+     * @param handle the value handle of the characteristic.
+     *
+     * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if MICROBIT_BLE_HIGH_RATE_CHARACTERISTICS are already registered.
+     */
+    int addHighRateCharacteristic(GattAttribute::Handle_t handle);
+
+    /**
+     * A client has enabled or disabled updates on a characteristic.
+     *
+     * @param handle the value handle of the characteristic.
+     *
+     * @param enabled true if updates were enabled, false if they were disabled.
+     */
+    void updatesEnabled(GattAttribute::Handle_t handle, bool enabled);
+
+    /**
+     * A client has connected. Unless the balanced profile is in use, the parameters of the current
+     * profile are negotiated, as the client will have chosen its own.
+     */
+    void connectionOpened();
+
+    /**
+     * A client has disconnected, so no characteristic has updates enabled.
+     */
+    void connectionClosed();
+
     /**
      * Enter pairing mode. This is mode is called to initiate pairing, and to enable FOTA programming
      * of the micro:bit in cases where BLE is disabled during normal operation.
@@ -211,7 +326,8 @@ class MicroBitBLEManager : MicroBitComponent
 
     /**
      * Periodic callback in thread context.
-     * We use this here purely to safely issue a disconnect operation after a pairing operation is complete.
+     * We use this here to safely issue a disconnect operation after a pairing operation is complete,
+     * and to write the system attributes of clients to flash.
 	 */
     void idleTick();
 
@@ -221,12 +337,38 @@ class MicroBitBLEManager : MicroBitComponent
     void stopAdvertising();
 
     /**
-     * A member function used to defer writes to flash, in order to prevent a write collision with 
-     * softdevice.
-     * @param handle The handle offered by soft device during pairing.
+     * Records the system attributes of a client that is disconnecting. They are held in RAM, and written
+     * to flash, by a fiber started from idleTick(), once no client has connected for MICROBIT_BLE_SYSATTR_WRITE_DELAY milliseconds,
+     * and only if they have changed.
+     *
+     * @param handle The connection handle of the client.
+     *
+     * @note for internal use only.
      * */
     void deferredSysAttrWrite(Gap::Handle_t handle);
 
+    /**
+     * Restores the system attributes last recorded for a bonded client.
+     *
+     * @param handle The connection handle of the client.
+     *
+     * @param device The device manager ID of the client.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_NO_DATA if nothing is recorded for the client,
+     *         or MICROBIT_NOT_SUPPORTED if the SoftDevice rejected them.
+     *
+     * @note for internal use only.
+     */
+    int restoreSystemAttributes(Gap::Handle_t handle, uint8_t device);
+
+    /**
+     * Writes the system attributes of every bonded client to storage, if they differ from those already stored.
+     * FLASH writes may block, so this is called from a fiber of its own rather than from idleTick().
+     *
+     * @note for internal use only.
+     */
+    void storeSystemAttributes();
+
 #if CONFIG_ENABLED(MICROBIT_BLE_EDDYSTONE_URL)
 
     /**
@@ -311,13 +453,44 @@ class MicroBitBLEManager : MicroBitComponent
     */
     void showManagementModeAnimation(MicroBitDisplay &display);
 
+    /**
+     * Reads the system attributes of every bonded client from storage, unless this has already been done.
+     */
+    void loadSystemAttributes();
+
+    /**
+     * Adds this component to the idle thread, unless this has already been done.
+     */
+    void addToIdle();
+
     #define MICROBIT_BLE_DISCONNECT_AFTER_PAIRING_DELAY  500
     unsigned long pairing_completed_at_time;   
 
     int pairingStatus;
     ManagedString passKey;
+
+    MicroBitBLEConnectionProfile connectionProfile;      // The profile selected by setConnectionProfile().
+    MicroBitBLEConnectionProfile activeProfile;          // The profile currently asked for.
+    GattAttribute::Handle_t highRateHandles[MICROBIT_BLE_HIGH_RATE_CHARACTERISTICS];
+    uint8_t highRateCount;                               // The number of registered high rate characteristics.
+    uint8_t highRateEnabled;                             // A bit for each high rate characteristic with updates enabled.
+
+    /**
+     * Asks for the connection parameters of the current profile, and negotiates them if a client is connected.
+     *
+     * @param renegotiate true to negotiate the parameters even if the profile has not changed.
+     */
+    void applyConnectionProfile(bool renegotiate = false);
     ManagedString deviceName;
 
+    ManagedString serialNumber;                          // Exposed by the device information service.
+    EventModel *messageBus;                              // Used by the event and partial flashing services.
+    MicroBitBLEBootProfile bootProfile;
+
+    BLESysAttributeStore sysAttrs;                       // The system attributes of each bonded client.
+    uint8_t sysAttrsValid;                               // A bit for each entry of sysAttrs that holds a client's attributes.
+    unsigned long sysAttrsChangedAt;                     // The time sysAttrs last changed, in milliseconds.
+
     /*
      * Default to Application Mode
      * This variable will be set to MICROBIT_MODE_PAIRING if pairingMode() is executed.
@@ -86,13 +86,38 @@ class MicroBitEventService : public MicroBitComponent
 
     private:
 
+    /**
+      * Finds a subscription in the table.
+      *
+      * @param key the subscription, as (id << 16) | value.
+      *
+      * @return the index of the subscription if it is present, otherwise the index at which it would be inserted.
+      */
+    int findSubscription(uint32_t key);
+
+    /**
+      * Determines if the client has subscribed to an event, either exactly or through MICROBIT_ID_ANY or MICROBIT_EVT_ANY.
+      *
+      * @param id the source of the event.
+      *
+      * @param value the value of the event.
+      *
+      * @return true if the event should be sent to the client.
+      */
+    bool isSubscribed(uint16_t id, uint16_t value);
+
+    /**
+      * Removes every subscription and any events waiting to be sent.
+      */
+    void clearSubscriptions();
+
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
 	EventModel	        &messageBus;
 
     // memory for our event characteristics.
     EventServiceEvent   clientEventBuffer;
-    EventServiceEvent   microBitEventBuffer;
+    EventServiceEvent   microBitEventBuffer[MICROBIT_BLE_EVENT_SERVICE_PACKED_EVENTS];
     EventServiceEvent   microBitRequirementsBuffer;
     EventServiceEvent   clientRequirementsBuffer;
 
@@ -105,6 +130,15 @@ class MicroBitEventService : public MicroBitComponent
     // Message bus offset last sent to the client...
     uint16_t messageBusListenerOffset;
 
+    // The events the client has subscribed to, each as (id << 16) | value, in ascending order.
+    uint32_t subscriptions[MICROBIT_BLE_EVENT_SERVICE_SUBSCRIPTIONS];
+    uint8_t subscriptionCount;
+
+    // Events waiting to be sent to the client, oldest first.
+    EventServiceEvent queue[MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
+    uint8_t queueHead;
+    uint8_t queueLength;
+
 };
 
 
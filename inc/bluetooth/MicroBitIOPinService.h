@@ -29,11 +29,19 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ble/BLE.h"
 #include "MicroBitIO.h"
+#include "MicroBitEvent.h"
+#include "MicroBitSystemTimer.h"
 
 #define MICROBIT_IO_PIN_SERVICE_PINCOUNT       19
 #define MICROBIT_IO_PIN_SERVICE_DATA_SIZE      10
 #define MICROBIT_PWM_PIN_SERVICE_DATA_SIZE     2
 
+// The interval at which analog inputs are sampled, in milliseconds.
+#define MICROBIT_IO_PIN_SERVICE_ANALOG_PERIOD  20
+
+// The change in an analog input, in the 8 bit units sent to the client, needed before it is sent again.
+#define MICROBIT_IO_PIN_SERVICE_ANALOG_THRESHOLD 2
+
 // UUIDs for our service and characteristics
 extern const uint8_t  MicroBitIOPinServiceUUID[];
 extern const uint8_t  MicroBitIOPinServiceADConfigurationUUID[];
@@ -79,15 +87,30 @@ class MicroBitIOPinService : public MicroBitComponent
     MicroBitIOPinService(BLEDevice &_ble, MicroBitIO &_io);
 
     /**
-     * Periodic callback from MicroBit scheduler.
+     * Callback from MicroBit scheduler, when the processor is idle after an input has changed or is due to be sampled.
      *
-     * Check if any of the pins we're watching need updating. Notify any connected
-     * device with any changes.
+     * Check if any of those pins need updating. Notify any connected device with any changes.
      */
     virtual void idleTick();
 
     private:
 
+    /**
+      * Callback. Invoked when a digital input that our BLE client is watching changes.
+      */
+    void onPinEvent(MicroBitEvent e);
+
+    /**
+      * Callback. Invoked every MICROBIT_IO_PIN_SERVICE_ANALOG_PERIOD milliseconds while any inputs need to be sampled.
+      */
+    void onSampleTimer();
+
+    /**
+      * Watches the inputs selected by the AD and IO configuration characteristics. Digital inputs raise events when
+      * they change, and others are sampled periodically.
+      */
+    void configureInputs();
+
     /**
       * Callback. Invoked when any of our attributes are written via BLE.
       */
@@ -132,6 +155,15 @@ class MicroBitIOPinService : public MicroBitComponent
      */
     void updateBLEInputs(bool updateAll = false);
 
+    /**
+     * Adds a pin value to the data characteristic buffer, if it differs enough from the value last sent.
+     *
+     * @param i the enumeration of the pin.
+     * @param pairs the number of pairs already in the buffer, which is updated.
+     * @param force if true, the value is added even if it hasn't changed.
+     */
+    void addInput(int i, int &pairs, bool force);
+
 
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
@@ -146,6 +178,12 @@ class MicroBitIOPinService : public MicroBitComponent
     // Historic information about our pin data data.
     uint8_t             ioPinServiceIOData[MICROBIT_IO_PIN_SERVICE_PINCOUNT];
 
+    // The inputs raising events when they change, those sampled periodically, and those waiting to be checked.
+    volatile uint32_t   edgeInputs;
+    uint32_t            sampledInputs;
+    volatile uint32_t   changedInputs;
+    SystemTimerEvent    sampleEvent;
+
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t ioPinServiceADCharacteristicHandle;
     GattAttribute::Handle_t ioPinServiceIOCharacteristicHandle;
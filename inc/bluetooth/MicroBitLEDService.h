@@ -29,16 +29,29 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ble/BLE.h"
 #include "MicroBitDisplay.h"
+#include "MicroBitSystemTimer.h"
 
 // Defines the buffer size for scrolling text over BLE, hence also defines
 // the maximum string length that can be scrolled via the BLE service.
 #define MICROBIT_BLE_MAXIMUM_SCROLLTEXT         20
 
+// Each frame written to the frames characteristic is a 32 bit little endian value. Bits 0..24 hold the pixels,
+// a row at a time from the top left, and bits 25..31 the time to show the frame for, in units of
+// MICROBIT_BLE_LED_FRAME_TICK milliseconds. A time of zero is treated as one unit.
+#define MICROBIT_BLE_LED_FRAME_SIZE             4
+#define MICROBIT_BLE_LED_FRAME_TICK             10
+#define MICROBIT_BLE_LED_FRAME_PIXELS           0x01FFFFFF
+#define MICROBIT_BLE_LED_FRAME_TIME_POS         25
+
+// The most frames that can be written at once, filling a 20 byte payload.
+#define MICROBIT_BLE_LED_MAXIMUM_FRAMES         5
+
 // UUIDs for our service and characteristics
 extern const uint8_t  MicroBitLEDServiceUUID[];
 extern const uint8_t  MicroBitLEDServiceMatrixUUID[];
 extern const uint8_t  MicroBitLEDServiceTextUUID[];
 extern const uint8_t  MicroBitLEDServiceScrollingSpeedUUID[];
+extern const uint8_t  MicroBitLEDServiceFramesUUID[];
 
 
 /**
@@ -69,6 +82,24 @@ class MicroBitLEDService
 
     private:
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    /**
+      * Adds the frames written to the frames characteristic to the queue, and starts showing them if the
+      * queue was empty.
+      */
+    void queueFrames(const uint8_t *data, int len);
+
+    /**
+      * Shows the next queued frame, and schedules the one after it. Invoked by the system timer.
+      */
+    void onFrameTimer();
+
+    /**
+      * Discards any queued frames, so that the display can be used for something else.
+      */
+    void stopFrames();
+#endif
+
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
     MicroBitDisplay     &display;
@@ -83,6 +114,18 @@ class MicroBitLEDService
     GattAttribute::Handle_t textCharacteristicHandle;
     GattAttribute::Handle_t scrollingSpeedCharacteristicHandle;
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    uint8_t             framesCharacteristicBuffer[MICROBIT_BLE_LED_MAXIMUM_FRAMES * MICROBIT_BLE_LED_FRAME_SIZE];
+    GattAttribute::Handle_t framesCharacteristicHandle;
+
+    // Frames waiting to be shown, in the order they were written.
+    uint32_t            frameQueue[MICROBIT_BLE_LED_FRAME_QUEUE_SIZE];
+    volatile uint8_t    frameHead;
+    volatile uint8_t    frameLength;
+    volatile bool       framePlaying;          // true while a frame is being shown for its time.
+    SystemTimerEvent    frameEvent;
+#endif
+
     // We hold a copy of the GattCharacteristic, as mbed's BLE API requires this to provide read callbacks (pity!).
     GattCharacteristic  matrixCharacteristic;
 };
@@ -42,6 +42,11 @@ extern const uint8_t  MicroBitMagnetometerServiceDataUUID[];
 extern const uint8_t  MicroBitMagnetometerServiceBearingUUID[];
 extern const uint8_t  MicroBitMagnetometerServicePeriodUUID[];
 extern const uint8_t  MicroBitMagnetometerServiceCalibrationUUID[];
+extern const uint8_t  MicroBitMagnetometerServiceBatchUUID[];
+
+// The number of samples in each notification of the batched data characteristic, filling the 20 byte payload
+// after the 16 bit timestamp.
+#define MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES     3
 
 /**
   * Class definition for the MicroBit BLE Magnetometer Service.
@@ -88,6 +93,13 @@ class MicroBitMagnetometerService
      */
     void compassEvents(MicroBitEvent e);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    /**
+     * Sends as many batches of samples from the compass's stream as the Bluetooth stack will take.
+     */
+    void sendBatches();
+#endif
+
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
     MicroBitCompass     &compass;
@@ -97,12 +109,20 @@ class MicroBitMagnetometerService
     uint16_t            magnetometerBearingCharacteristicBuffer;
     uint16_t            magnetometerPeriodCharacteristicBuffer;
     uint8_t             magnetometerCalibrationCharacteristicBuffer;
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    // The time of the first sample in milliseconds, followed by the X, Y and Z of each sample.
+    int16_t             magnetometerBatchCharacteristicBuffer[1 + 3 * MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES];
+    bool                batchPending;           // The batch buffer holds a batch yet to be sent.
+#endif
 
     // Handles to access each characteristic when they are held by Soft Device.
     GattAttribute::Handle_t magnetometerDataCharacteristicHandle;
     GattAttribute::Handle_t magnetometerBearingCharacteristicHandle;
     GattAttribute::Handle_t magnetometerPeriodCharacteristicHandle;
     GattAttribute::Handle_t magnetometerCalibrationCharacteristicHandle;
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattAttribute::Handle_t magnetometerBatchCharacteristicHandle;
+#endif
 };
 
 #endif
@@ -38,12 +38,16 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitListener.h"
 #include "EventModel.h"
 
-#define PARTIAL_FLASHING_VERSION 0x01
+#define PARTIAL_FLASHING_VERSION 0x03
 
 // BLE PF Control Codes
 #define REGION_INFO 0x00
 #define FLASH_DATA  0x01
 #define END_OF_TRANSMISSION 0x02
+#define PAGE_HASHES 0x03
+
+// Number of page hashes returned in each PAGE_HASHES notification
+#define PAGE_HASHES_PER_PACKET 4
 
 // BLE Utilities
 #define MICROBIT_STATUS 0xEE
@@ -100,10 +104,15 @@ class MicroBitPartialFlashingService
     uint8_t packetCount = 0;
     uint8_t blockPacketCount = 0;
 
-    // Keep track of blocks of data
-    uint32_t block[16];
+    // Number of unacknowledged blocks the client may send, as negotiated by MICROBIT_STATUS
+    uint8_t window = 1;
+
+    // Keep track of blocks of data. Blocks are received into, and written from, a ring of buffers.
+    uint32_t block[MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS][16];
+    uint32_t blockOffset[MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS];
     uint8_t  blockNum = 0;
-    uint32_t offset   = 0;
+    uint8_t  receiveBlock = 0;
+    uint8_t  writeBlock = 0;
 
 };
 
@@ -31,9 +31,14 @@ DEALINGS IN THE SOFTWARE.
 #include "ble/BLE.h"
 #include "MicroBitConfig.h"
 #include "MicroBitSerial.h"
+#include "MicroBitRingBuffer.h"
 
 #define MICROBIT_UART_S_DEFAULT_BUF_SIZE    20
 
+// The largest payload of a single notification or indication. The nRF51 Bluetooth stack does not
+// negotiate a larger ATT MTU than the default of 23 bytes, less 3 bytes of ATT header.
+#define MICROBIT_UART_S_MAX_PAYLOAD         20
+
 #define MICROBIT_UART_S_EVT_DELIM_MATCH     1
 #define MICROBIT_UART_S_EVT_HEAD_MATCH      2
 #define MICROBIT_UART_S_EVT_RX_FULL         3
@@ -45,45 +50,48 @@ DEALINGS IN THE SOFTWARE.
   */
 class MicroBitUARTService
 {
-    uint8_t* rxBuffer;
-
-    uint8_t* txBuffer;
-
-    uint8_t rxBufferHead;
-    uint8_t rxBufferTail;
-    uint8_t rxBufferSize;
+    //filled as the Bluetooth device writes to our RX characteristic, and emptied by fibers.
+    MicroBitRingBuffer rxBuffer;
 
-    uint8_t txBufferSize;
+    //filled by fibers, and emptied as indications are confirmed.
+    MicroBitRingBuffer txBuffer;
 
     uint32_t rxCharacteristicHandle;
 
     // Bluetooth stack we're running on.
     BLEDevice           &ble;
 
-    //delimeters used for matching on receive.
-    ManagedString delimeters;
+    //delimeters used for matching on receive, as a bitmap with one bit for each character value.
+    uint32_t delimeters[8];
 
     //a variable used when a user calls the eventAfter() method.
     int rxBuffHeadMatch;
 
+    //the rate of the most recent blocking send, in bytes per second.
+    int txThroughput;
+
     /**
       * A callback function for whenever a Bluetooth device writes to our TX characteristic.
       */
     void onDataWritten(const GattWriteCallbackParams *params);
 
     /**
-      * An internal method that copies values from a circular buffer to a linear buffer.
-      *
-      * @param circularBuff a pointer to the source circular buffer
-      * @param circularBuffSize the size of the circular buffer
-      * @param linearBuff a pointer to the destination linear buffer
-      * @param tailPosition the tail position in the circular buffer you want to copy from
-      * @param headPosition the head position in the circular buffer you want to copy to
+      * A callback function for whenever the Bluetooth stack has sent queued notifications.
+      */
+    void onDataSent(unsigned count);
+
+    /**
+      * A listener for MICROBIT_UART_S_EVT_TX_EMPTY, that hands any data left in the txBuffer to the Bluetooth stack.
+      */
+    void onTxEmpty(MicroBitEvent);
+
+    /**
+      * An internal method that hands data in the txBuffer to the Bluetooth stack, in payloads of up to
+      * MICROBIT_UART_S_MAX_PAYLOAD bytes, until the txBuffer is empty or the stack can accept no more.
       *
-      * @note this method assumes that the linear buffer has the appropriate amount of
-      *       memory to contain the copy operation
+      * @return true if the txBuffer was emptied, false if the stack can accept no more data.
       */
-    void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
+    bool sendBuffered();
 
     public:
 
@@ -144,7 +152,8 @@ class MicroBitUARTService
       * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
       *        gives a different behaviour:
       *
-      *            ASYNC - Will copy as many characters as it can into the buffer for transmission,
+      *            ASYNC - Will hand as many characters as it can to the Bluetooth stack, and copy
+      *                    as many of the rest as it can into the buffer for transmission,
       *                    and return control to the user.
       *
       *            SYNC_SPINWAIT - will return MICROBIT_INVALID_PARAMETER
@@ -155,6 +164,10 @@ class MicroBitUARTService
       *
       * @return the number of characters written, or MICROBIT_NOT_SUPPORTED if there is
       *         no connected device, or the connected device has not enabled indications.
+      *
+      * @note data is sent in payloads of up to MICROBIT_UART_S_MAX_PAYLOAD bytes. If the connected
+      *       device enables notifications rather than indications, several payloads are sent in
+      *       each connection interval.
       */
     int send(const uint8_t *buf, int length, MicroBitSerialMode mode = SYNC_SLEEP);
 
@@ -294,6 +307,14 @@ class MicroBitUARTService
       * @return The currently buffered number of bytes in our txBuff.
       */
     int txBufferedSize();
+
+    /**
+      * Determines the rate the most recent SYNC_SLEEP send() achieved, from the first byte being handed
+      * to the Bluetooth stack, to the last being sent.
+      *
+      * @return the rate in bytes per second, or zero if no blocking send has completed.
+      */
+    int getTxThroughput();
 };
 
 extern const uint8_t  UARTServiceBaseUUID[UUID::LENGTH_OF_LONG_UUID];
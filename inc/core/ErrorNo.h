@@ -63,7 +63,10 @@ enum ErrorCode{
     MICROBIT_SERIAL_IN_USE = -1011,
 
     // The requested operation had no data to return.
-    MICROBIT_NO_DATA = -1012
+    MICROBIT_NO_DATA = -1012,
+
+    // The requested operation did not complete within the time allowed.
+    MICROBIT_TIMEOUT = -1013
 };
 
 /**
@@ -86,5 +89,8 @@ enum PanicCode{
     // A requested hardware peripheral could not be found,
     MICROBIT_HARDWARE_UNAVAILABLE_ACC = 50,
     MICROBIT_HARDWARE_UNAVAILABLE_MAG = 51,
+
+    // A fiber or interrupt handler overran its dedicated stack (MICROBIT_FIBER_DEDICATED_STACKS only).
+    MICROBIT_STACK_OVERFLOW = 60,
 };
 #endif
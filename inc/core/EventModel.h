@@ -103,6 +103,23 @@ class EventModel
         return MICROBIT_NOT_SUPPORTED;
     }
 
+    /**
+      * Determines if any listener would receive events raised with the given ID and value, so that components can
+      * avoid the cost of generating events that nobody is waiting for.
+      *
+      * @param id The ID to test.
+      *
+      * @param value The event value to test. Defaults to MICROBIT_EVT_ANY, which matches listeners for any value.
+      *
+      * @return This default implementation cannot tell, and so simply returns true.
+      */
+    virtual bool isListening(uint16_t id, uint16_t value = MICROBIT_EVT_ANY)
+    {
+        (void) id;
+        (void) value;
+        return true;
+    }
+
     /**
       * Returns the MicroBitListener at the given position in the list.
       *
@@ -241,6 +258,55 @@ class EventModel
         return MICROBIT_NOT_SUPPORTED;
     }
 
+    /**
+	  * Register a listener function that receives events in batches.
+      *
+      * Matching events are held in the listener's queue, and delivered together in a single call
+      * once the EventModel has no more pressing work to do. This amortises the cost of dispatch
+      * for high rate sources. The queue depth can be tuned with MicroBitListener::setQueueDepth().
+      *
+      * An EventModel implementing this interface may optionally choose to override this method,
+      * if that EventModel supports asynchronous callbacks to user code, but there is no
+      * requirement to do so.
+      *
+	  * @param id The source of messages to listen for. Events sent from any other IDs will be filtered.
+	  * Use MICROBIT_ID_ANY to receive events from all components.
+	  *
+	  * @param value The value of messages to listen for. Events with any other values will be filtered.
+	  * Use MICROBIT_EVT_ANY to receive events of any value.
+	  *
+	  * @param handler The function to call with each batch of events received, oldest first.
+      *
+      * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+      * to be tuned.
+      *
+      * @return MICROBIT_OK on success, or any valid error code defined in "ErrNo.h". The default implementation
+      * simply returns MICROBIT_NOT_SUPPORTED.
+	  *
+      * @code
+      * void onSamples(MicroBitEvent *events, int count)
+      * {
+      * 	//do something with each of the count events
+      * }
+      *
+      * uBit.messageBus.listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE, onSamples);
+      * @endcode
+	  */
+    int listen(int id, int value, void (*handler)(MicroBitEvent *, int), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS)
+    {
+        if (handler == NULL)
+            return MICROBIT_INVALID_PARAMETER;
+
+        MicroBitListener *newListener = new MicroBitListener(id, value, handler, flags);
+
+        if(add(newListener) == MICROBIT_OK)
+            return MICROBIT_OK;
+
+        delete newListener;
+
+        return MICROBIT_NOT_SUPPORTED;
+    }
+
 	/**
 	  * Register a listener function.
 	  *
@@ -345,6 +411,28 @@ class EventModel
         return MICROBIT_OK;
     }
 
+    /**
+	  * Unregister a listener function that receives events in batches.
+      * Listeners are identified by the Event ID, Event value and handler registered using listen().
+	  *
+	  * @param id The Event ID used to register the listener.
+	  * @param value The Event value used to register the listener.
+	  * @param handler The function used to register the listener.
+      *
+      * @return MICROBIT_OK on success or MICROBIT_INVALID_PARAMETER if the handler
+      *         given is NULL.
+	  */
+	int ignore(int id, int value, void (*handler)(MicroBitEvent *, int))
+    {
+        if (handler == NULL)
+            return MICROBIT_INVALID_PARAMETER;
+
+        MicroBitListener listener(id, value, handler);
+        remove(&listener);
+
+        return MICROBIT_OK;
+    }
+
 	/**
 	  * Unregister a listener function.
       * Listners are identified by the Event ID, Event value and handler registered using listen().
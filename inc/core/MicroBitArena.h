@@ -0,0 +1,136 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_ARENA_H
+#define MICROBIT_ARENA_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Class definition for a MicroBitArena.
+  *
+  * An arena is a single block of heap memory, from which many short lived allocations can be made
+  * using a simple bump pointer, and then released together. This is useful for phases of work that
+  * create lots of temporary buffers (e.g. calibration or parsing), as it avoids those buffers
+  * fragmenting the shared heap, and makes each allocation O(1).
+  *
+  * Allocations cannot be released individually. Instead, a mark can be taken and later released,
+  * freeing everything allocated since that mark in one go.
+  *
+  * @code
+  * MicroBitArena arena(256);
+  *
+  * uint32_t mark = arena.mark();
+  * int16_t *samples = (int16_t *) arena.allocate(64 * sizeof(int16_t));
+  * char *text = (char *) arena.allocate(32);
+  *
+  * // ... use the buffers ...
+  *
+  * arena.release(mark);
+  * @endcode
+  */
+class MicroBitArena
+{
+    uint8_t             *buffer;            // The memory from which allocations are made.
+    uint16_t            size;               // The size of buffer, in bytes.
+    uint16_t            used;               // The number of bytes of buffer currently allocated.
+    uint16_t            peak;               // The greatest value of used since the arena was created.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create a new arena, allocating its memory from the heap.
+      *
+      * @param size The capacity of the arena in bytes, in the range 1..65532. This is rounded up to a whole number of words.
+      *
+      * @note If memory cannot be allocated, the arena is created with zero capacity and all allocations will fail.
+      *       Use getSize() to check.
+      */
+    MicroBitArena(int size);
+
+    /**
+      * Destructor.
+      *
+      * Releases the arena's memory back to the heap. Any memory allocated from the arena is no longer valid.
+      */
+    ~MicroBitArena();
+
+    /**
+      * Allocates memory from the arena. The memory is word aligned.
+      *
+      * @param bytes The amount of memory to allocate.
+      *
+      * @return A pointer to the memory, or NULL if bytes is not positive or the arena has insufficient space.
+      */
+    void *allocate(int bytes);
+
+    /**
+      * Records the current position of the arena, to be passed to release() later.
+      *
+      * @return A mark representing every allocation made so far.
+      */
+    uint32_t mark();
+
+    /**
+      * Releases every allocation made since the given mark was taken.
+      *
+      * @param mark A value previously returned by mark().
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the mark is beyond the current position.
+      */
+    int release(uint32_t mark);
+
+    /**
+      * Releases every allocation made from the arena.
+      */
+    void reset();
+
+    /**
+      * Determines the capacity of the arena.
+      *
+      * @return The size of the arena, in bytes.
+      */
+    int getSize();
+
+    /**
+      * Determines how much memory remains in the arena.
+      *
+      * @return The number of bytes available for allocation.
+      */
+    int getFree();
+
+    /**
+      * Determines the greatest amount of memory allocated from the arena at any one time.
+      * This can be used to tune the size of the arena.
+      *
+      * @return The peak number of bytes allocated.
+      */
+    int getPeak();
+};
+
+#endif
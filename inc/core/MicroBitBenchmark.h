@@ -0,0 +1,507 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A small set of micro-benchmarks for the micro:bit runtime.
+  *
+  * These allow the cost of core runtime operations to be measured on real hardware, so that
+  * the effect of changes to the scheduler and message bus can be quantified. Each benchmark repeats
+  * an operation a given number of times, and reports the average cost of each iteration.
+  *
+  * The nRF51 has no cycle counter, so timings are taken from the system timer and converted
+  * to processor cycles using SystemCoreClock. Use enough iterations to swamp the timer resolution.
+  *
+  * The benchmarks are only built when MICROBIT_BENCHMARK is enabled in MicroBitConfig.h.
+  */
+
+#ifndef MICROBIT_BENCHMARK_H
+#define MICROBIT_BENCHMARK_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitMessageBus.h"
+#include "MicroBitSerial.h"
+#include "MicroBitFileSystem.h"
+#include "MicroBitStorage.h"
+#include "MicroBitRadio.h"
+#include "MicroBitButton.h"
+
+#if CONFIG_ENABLED(MICROBIT_BENCHMARK)
+
+// Event values used internally by the benchmarks, raised with MICROBIT_ID_BENCHMARK.
+#define MICROBIT_BENCHMARK_EVT_DISPATCH     1
+#define MICROBIT_BENCHMARK_EVT_SEND         2
+#define MICROBIT_BENCHMARK_EVT_WAKE         3
+
+// The number of buckets in a latency distribution. Bucket n counts samples of 2^(n-1) to (2^n)-1 microseconds,
+// with the final bucket also holding any longer samples.
+#define MICROBIT_BENCHMARK_DISTRIBUTION_BUCKETS     10
+
+// The number of live allocations maintained by the heap churn benchmark.
+#define MICROBIT_BENCHMARK_HEAP_SLOTS       32
+
+// The file and key used by the storage benchmarks, and the size of each file read or write (bytes).
+#define MICROBIT_BENCHMARK_FILE_NAME        "bench.dat"
+#define MICROBIT_BENCHMARK_STORAGE_KEY      "bench"
+#define MICROBIT_BENCHMARK_FILE_CHUNK       64
+
+// Packet types exchanged between the sender and echo roles of the radio benchmark.
+#define MICROBIT_BENCHMARK_RADIO_CONFIG         1       // Asks the echo to move to the given data rate and transmit power.
+#define MICROBIT_BENCHMARK_RADIO_CONFIG_ACK     2       // Confirms the echo is moving to the requested setting.
+#define MICROBIT_BENCHMARK_RADIO_PING           3       // Asks the echo for a PONG.
+#define MICROBIT_BENCHMARK_RADIO_PONG           4       // The reply to a PING.
+#define MICROBIT_BENCHMARK_RADIO_BURST          5       // Counted by the echo, without reply.
+#define MICROBIT_BENCHMARK_RADIO_REPORT_REQUEST 6       // Asks the echo how many BURST packets it has received at this setting.
+#define MICROBIT_BENCHMARK_RADIO_REPORT         7       // The reply to a REPORT_REQUEST.
+#define MICROBIT_BENCHMARK_RADIO_END            8       // Tells the echo to return to the default setting.
+
+// Radio benchmark timing.
+#define MICROBIT_BENCHMARK_RADIO_TIMEOUT        50      // How long to wait for each reply (milliseconds).
+#define MICROBIT_BENCHMARK_RADIO_RETRIES        40      // The number of times a CONFIG or REPORT_REQUEST is sent without reply before giving up.
+#define MICROBIT_BENCHMARK_RADIO_IDLE_TIMEOUT   1000    // How long the echo stays at a test setting without hearing from the sender (milliseconds).
+#define MICROBIT_BENCHMARK_RADIO_POWER_LEVELS   8       // Transmit powers 0..7 are tested.
+
+/**
+  * The results of a single benchmark run.
+  */
+struct MicroBitBenchmarkResult
+{
+    uint32_t iterations;                // The number of times the operation was performed.
+    uint32_t time_us;                   // The total time taken (microseconds).
+    uint32_t cycles;                    // The average number of processor cycles taken by each iteration.
+};
+
+/**
+  * The distribution of the individual timings taken during a benchmark run.
+  */
+struct MicroBitBenchmarkDistribution
+{
+    uint32_t samples;                   // The number of timings taken.
+    uint32_t min_us;                    // The shortest timing (microseconds).
+    uint32_t max_us;                    // The longest timing (microseconds).
+    uint32_t failures;                  // The number of operations that failed, and were not timed.
+    uint32_t buckets[MICROBIT_BENCHMARK_DISTRIBUTION_BUCKETS];  // Histogram of timings, in power of two buckets.
+};
+
+/**
+  * The results of a storage benchmark run.
+  */
+struct MicroBitBenchmarkStorageResult
+{
+    uint32_t operations;                // The number of operations timed.
+    uint32_t failures;                  // The number of operations that failed, and were not timed.
+    uint32_t bytes;                     // The number of bytes read or written by the timed operations.
+    uint32_t time_us;                   // The total time taken by the timed operations (microseconds).
+    uint32_t latency_us;                // The average time taken by each operation (microseconds).
+    uint32_t max_us;                    // The longest time taken by any one operation (microseconds).
+    uint32_t bytes_per_second;          // The throughput of the timed operations.
+    uint32_t erases;                    // The number of flash pages erased during the run.
+};
+
+/**
+  * A radio benchmark packet. Every packet is padded to the largest datagram payload.
+  */
+struct MicroBitBenchmarkRadioPacket
+{
+    uint8_t type;                       // One of the MICROBIT_BENCHMARK_RADIO_ packet types.
+    uint8_t power;                      // The transmit power to move to (CONFIG).
+    uint16_t rate;                      // The data rate to move to, in kbit/s (CONFIG).
+    uint32_t sequence;                  // Identifies the packet, and is copied into its reply.
+    uint32_t timestamp;                 // The time the packet was sent, as seen by the sender (microseconds).
+    uint32_t count;                     // The number of BURST packets received (REPORT).
+    uint8_t padding[MICROBIT_RADIO_MAX_PACKET_SIZE - 16];
+};
+
+/**
+  * The results of a radio benchmark run at a single data rate and transmit power.
+  */
+struct MicroBitBenchmarkRadioResult
+{
+    uint32_t data_rate;                 // The data rate tested (kbit/s).
+    uint32_t power;                     // The transmit power tested (0..7).
+    uint32_t pings;                     // The number of PINGs sent.
+    uint32_t pongs;                     // The number of PONGs received in reply.
+    uint32_t p50_us;                    // The median round trip time (microseconds).
+    uint32_t p90_us;                    // The 90th percentile round trip time (microseconds).
+    uint32_t p99_us;                    // The 99th percentile round trip time (microseconds).
+    uint32_t max_us;                    // The longest round trip time (microseconds).
+    uint32_t burst_sent;                // The number of BURST packets sent.
+    uint32_t burst_received;            // The number of BURST packets the echo received.
+    uint32_t packets_per_second;        // The rate at which BURST packets were sent.
+    uint32_t bytes_per_second;          // The payload throughput of the BURST packets that were received.
+};
+
+/**
+  * Measures the cost of delivering an event through MicroBitMessageBus::process() to a single listener,
+  * using both the default (fork on block) dispatch path and the MESSAGE_BUS_LISTENER_NONBLOCKING fast path.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param iterations The number of events to deliver on each path.
+  *
+  * @param fob Populated with the results for listeners dispatched through invoke().
+  *
+  * @param direct Populated with the results for listeners dispatched directly.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive, or
+  *         MICROBIT_NO_RESOURCES if the benchmark listeners could not be registered.
+  */
+int benchmark_event_dispatch(MicroBitMessageBus &bus, int iterations, MicroBitBenchmarkResult &fob, MicroBitBenchmarkResult &direct);
+
+/**
+  * Measures the cost of a context switch between two fibers of the same priority.
+  *
+  * A partner fiber is created, and control is passed back and forth between it and the calling fiber
+  * using schedule(). Results are reported per context switch.
+  *
+  * @param iterations The number of round trips to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the partner fiber could not be created.
+  *
+  * @note Any other runnable fibers of the same priority will also be scheduled, and inflate the results.
+  */
+int benchmark_context_switch(int iterations, MicroBitBenchmarkResult &result);
+
+/**
+  * Measures the cost of invoke() for a function that completes without blocking.
+  *
+  * @param iterations The number of times to call invoke().
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_invoke(int iterations, MicroBitBenchmarkResult &result);
+
+/**
+  * Measures the latency of MicroBitMessageBus::send(), from the event being sent until it is delivered to a
+  * listener through the event queue, and the calling fiber is woken up by that listener.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param iterations The number of events to send.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the benchmark listener could not be registered.
+  */
+int benchmark_event_send(MicroBitMessageBus &bus, int iterations, MicroBitBenchmarkResult &result);
+
+/**
+  * Measures the wakeup latency of fiber_wait_for_event(), from an event being raised until
+  * the fiber waiting on it is running again.
+  *
+  * @param iterations The number of events to raise.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the waiting fiber could not be created.
+  */
+int benchmark_wait_for_event(int iterations, MicroBitBenchmarkResult &result);
+
+/**
+  * Measures the latency of malloc() over a mixed workload of small, medium and large allocations.
+  *
+  * A fixed number of allocations are kept live. On each iteration, one of these chosen at random is freed
+  * and replaced by a new allocation of random size, and the time taken by that allocation is recorded.
+  * The sequence of operations is the same on every run, so results from builds using different heap
+  * configurations (e.g. MICROBIT_HEAP_NEXT_FIT) can be compared directly.
+  *
+  * @param iterations The number of allocations to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @param distribution Populated with the distribution of allocation times.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_heap_churn(int iterations, MicroBitBenchmarkResult &result, MicroBitBenchmarkDistribution &distribution);
+
+/**
+  * Measures the cost of the MicroBitImage blit and shift kernels used when rendering text and animations.
+  *
+  * A 5x5 glyph is repeatedly pasted into a display sized image, both opaquely and with transparency,
+  * and the display sized image is shifted left by one pixel, as when scrolling.
+  *
+  * @param iterations The number of times to perform each operation.
+  *
+  * @param paste Populated with the results of the opaque paste benchmark.
+  *
+  * @param pasteAlpha Populated with the results of the transparent paste benchmark.
+  *
+  * @param shift Populated with the results of the shift benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_image(int iterations, MicroBitBenchmarkResult &paste, MicroBitBenchmarkResult &pasteAlpha, MicroBitBenchmarkResult &shift);
+
+/**
+  * Measures the cost of the orientation calculations used by the accelerometer and compass, in both
+  * their floating point and fixed point forms, regardless of which MICROBIT_FIXED_POINT_ORIENTATION selects.
+  *
+  * A fixed set of samples is used, so that results from different builds can be compared directly.
+  *
+  * @param iterations The number of times to perform each calculation.
+  *
+  * @param pitchRoll Populated with the results of the floating point pitch and roll benchmark.
+  *
+  * @param pitchRollFixed Populated with the results of the fixed point pitch and roll benchmark.
+  *
+  * @param bearing Populated with the results of the floating point tilt compensated bearing benchmark.
+  *
+  * @param bearingFixed Populated with the results of the fixed point tilt compensated bearing benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_orientation(int iterations, MicroBitBenchmarkResult &pitchRoll, MicroBitBenchmarkResult &pitchRollFixed, MicroBitBenchmarkResult &bearing, MicroBitBenchmarkResult &bearingFixed);
+
+/**
+  * Measures sequential append throughput, by writing MICROBIT_BENCHMARK_FILE_CHUNK bytes at a time to a new file.
+  *
+  * Any existing MICROBIT_BENCHMARK_FILE_NAME is removed first. The file is left in place for benchmark_fs_random_read().
+  * Appending stops early if the file system fills up.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of chunks to append.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive, or
+  *         the error code from MicroBitFileSystem::open() if the file could not be created.
+  */
+int benchmark_fs_append(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result);
+
+/**
+  * Measures random read latency, by seeking to pseudo-random positions in the file written by benchmark_fs_append()
+  * and reading MICROBIT_BENCHMARK_FILE_CHUNK bytes from each.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of reads to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         or MICROBIT_NO_DATA if the file does not exist or is shorter than one chunk.
+  */
+int benchmark_fs_random_read(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result);
+
+/**
+  * Measures the latency of opening and closing the file written by benchmark_fs_append() for reading.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of times to open and close the file.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         or MICROBIT_NO_DATA if the file does not exist.
+  */
+int benchmark_fs_open_close(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result);
+
+/**
+  * Measures the cost of file churn. On each iteration, MICROBIT_BENCHMARK_FILE_NAME is removed, then created again
+  * holding a single MICROBIT_BENCHMARK_FILE_CHUNK, and closed. This exercises block recycling, and is a good
+  * way to observe page erase counts. The file is removed once the benchmark completes.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of times to recreate the file.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_fs_churn(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result);
+
+/**
+  * Measures the cost of MicroBitStorage::put() and MicroBitStorage::get(), using a full sized value that
+  * changes on every iteration. The key is removed once the benchmark completes.
+  *
+  * @param storage The key/value store to benchmark.
+  *
+  * @param iterations The number of values to store and retrieve.
+  *
+  * @param put Populated with the results of the put benchmark.
+  *
+  * @param get Populated with the results of the get benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_storage(MicroBitStorage &storage, int iterations, MicroBitBenchmarkStorageResult &put, MicroBitBenchmarkStorageResult &get);
+
+/**
+  * Measures the radio link to a second micro:bit running benchmark_radio_echo(), at the given data rate and transmit power.
+  *
+  * The setting is agreed with the echo at the default data rate and transmit power. PINGs are then sent one at a time,
+  * each waiting up to MICROBIT_BENCHMARK_RADIO_TIMEOUT milliseconds for its PONG, to measure round trip latency and loss.
+  * Finally, a burst of packets is sent back to back, and the echo asked how many it received, to measure throughput.
+  * Both devices return to the default setting afterwards.
+  *
+  * @param radio The radio to benchmark. This must be enabled, and in the same group as the echo.
+  *
+  * @param rate The data rate to test: MICROBIT_RADIO_DATA_RATE_250KBIT, MICROBIT_RADIO_DATA_RATE_1MBIT or MICROBIT_RADIO_DATA_RATE_2MBIT.
+  *
+  * @param power The transmit power to test, in the range 0..7.
+  *
+  * @param iterations The number of PINGs, and of BURST packets, to send.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if a parameter is out of range,
+  *         MICROBIT_NO_DATA if the echo did not respond, MICROBIT_NO_RESOURCES if there is not enough memory
+  *         to hold the latency samples, or the error from MicroBitRadioDatagram::send() if sending failed.
+  */
+int benchmark_radio_link(MicroBitRadio &radio, int rate, int power, int iterations, MicroBitBenchmarkRadioResult &result);
+
+/**
+  * Acts as the echo for benchmark_radio_link() on another micro:bit. This function does not return.
+  *
+  * The echo follows the sender to each setting it requests, and returns to the default data rate and transmit power
+  * once told the test is over, or if it hears nothing for MICROBIT_BENCHMARK_RADIO_IDLE_TIMEOUT milliseconds.
+  *
+  * @param radio The radio to use. This must be enabled, and in the same group as the sender.
+  */
+void benchmark_radio_echo(MicroBitRadio &radio);
+
+/**
+  * Writes a benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkResult &result);
+
+/**
+  * Writes a latency distribution to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param distribution The distribution to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkDistribution &distribution);
+
+/**
+  * Writes a storage benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkStorageResult &result);
+
+/**
+  * Writes a radio benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, MicroBitBenchmarkRadioResult &result);
+
+/**
+  * Runs every benchmark, and writes the results to the given serial port.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of iterations of each benchmark to perform.
+  *
+  * @return MICROBIT_OK on success, or the error code of the first benchmark that failed.
+  *
+  * @code
+  * benchmark_run_all(uBit.messageBus, uBit.serial, 1000);
+  * @endcode
+  */
+int benchmark_run_all(MicroBitMessageBus &bus, MicroBitSerial &serial, int iterations);
+
+/**
+  * Runs every file system and storage benchmark, and writes the results to the given serial port.
+  *
+  * Flash operations behave differently while BLE is running, as they are scheduled around radio activity
+  * by the SoftDevice, so whether BLE is active is reported alongside the results. Run the benchmarks from
+  * builds with and without BLE enabled to compare the two.
+  *
+  * n.b. These benchmarks write to flash, and so wear it. Use modest iteration counts.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param storage The key/value store to benchmark.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of iterations of each benchmark to perform.
+  *
+  * @return MICROBIT_OK on success, or the error code of the first benchmark that failed.
+  *
+  * @code
+  * benchmark_run_storage(*MicroBitFileSystem::defaultFileSystem, uBit.storage, uBit.serial, 50);
+  * @endcode
+  */
+int benchmark_run_storage(MicroBitFileSystem &fs, MicroBitStorage &storage, MicroBitSerial &serial, int iterations);
+
+/**
+  * Runs the two device radio benchmark, with the role of this device chosen by button.
+  *
+  * Once a button is pressed, the device either acts as the sender, running benchmark_radio_link() at every data rate and
+  * transmit power and writing the results to the given serial port, or acts as the echo, and never returns.
+  * BLE must not be running, as the radio cannot then be used directly.
+  *
+  * @param radio The radio to benchmark.
+  *
+  * @param sender The button that selects the sender role.
+  *
+  * @param echo The button that selects the echo role.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of PINGs, and of BURST packets, to send at each setting.
+  *
+  * @return MICROBIT_OK once the sender has completed, MICROBIT_NOT_SUPPORTED if BLE is running,
+  *         or the error code of the first benchmark that failed.
+  *
+  * @code
+  * benchmark_run_radio(uBit.radio, uBit.buttonA, uBit.buttonB, uBit.serial, 100);
+  * @endcode
+  */
+int benchmark_run_radio(MicroBitRadio &radio, MicroBitButton &sender, MicroBitButton &echo, MicroBitSerial &serial, int iterations);
+
+#endif
+
+#endif
@@ -72,7 +72,12 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_ID_IO_INT2             34          //INT2
 #define MICROBIT_ID_IO_INT3             35          //INT3
 #define MICROBIT_ID_PARTIAL_FLASHING    36
+#define MICROBIT_ID_FLASH               37
+#define MICROBIT_ID_I2C                 38
+#define MICROBIT_ID_ANALOG_SAMPLER      39
+#define MICROBIT_ID_MOTOR_CONTROLLER    40
 
+#define MICROBIT_ID_BENCHMARK                       1020          // Events raised internally by the runtime benchmarks.
 #define MICROBIT_ID_MESSAGE_BUS_LISTENER            1021          // Message bus indication that a handler for a given ID has been registered.
 #define MICROBIT_ID_NOTIFY_ONE                      1022          // Notfication channel, for general purpose synchronisation
 #define MICROBIT_ID_NOTIFY                          1023          // Notfication channel, for general purpose synchronisation
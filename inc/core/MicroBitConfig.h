@@ -101,6 +101,7 @@ DEALINGS IN THE SOFTWARE.
 
 // Address of the end of the current program in FLASH memory.
 // This is recorded by the C/C++ linker, but the symbol name varies depending on which compiler is used.
+#ifndef FLASH_PROGRAM_END
 #if defined(__arm)
 extern uint32_t Image$$ER_IROM1$$RO$$Limit;
 #define FLASH_PROGRAM_END (uint32_t) (&Image$$ER_IROM1$$RO$$Limit)
@@ -108,6 +109,7 @@ extern uint32_t Image$$ER_IROM1$$RO$$Limit;
 extern uint32_t __etext;
 #define FLASH_PROGRAM_END (uint32_t) (&__etext)
 #endif
+#endif
 
 //
 // If set to '1', this option enables the microbit heap allocator. This supports multiple heaps and interrupt safe operation.
@@ -132,6 +134,46 @@ extern uint32_t __etext;
 #define MICROBIT_HEAP_REUSE_SD                  1
 #endif
 
+// If enabled, small allocations (up to 48 bytes) are rounded up to one of a small number of size classes, and
+// freed blocks are held on a free list per class for O(1) reuse. Blocks held on these lists are returned to the
+// heap if an allocation would otherwise fail.
+// Set '1' to enable.
+#ifndef MICROBIT_HEAP_SIZE_CLASSES
+#define MICROBIT_HEAP_SIZE_CLASSES              1
+#endif
+
+// If enabled, the heap allocator searches for free blocks from where the last allocation finished (next fit),
+// rather than from the start of the heap (first fit), and first considers a small cache of recently freed blocks.
+// Set '1' to enable.
+#ifndef MICROBIT_HEAP_NEXT_FIT
+#define MICROBIT_HEAP_NEXT_FIT                  1
+#endif
+
+// The number of recently freed blocks remembered by each heap, when MICROBIT_HEAP_NEXT_FIT is enabled.
+#ifndef MICROBIT_HEAP_HINT_CACHE_SIZE
+#define MICROBIT_HEAP_HINT_CACHE_SIZE           4
+#endif
+
+// The maximum number of heap blocks examined by the allocator before it briefly re-enables interrupts.
+// This bounds the interrupt latency caused by a search of a large or fragmented heap.
+#ifndef MICROBIT_HEAP_SEARCH_BATCH
+#define MICROBIT_HEAP_SEARCH_BATCH              16
+#endif
+
+// Enable this to attribute heap usage to the code that requested it. Each allocation records the return address
+// of its caller (the code calling malloc() or new), and live allocations, live bytes and peak bytes are kept for
+// each distinct call site. This costs one extra word per allocation.
+// Set '1' to enable.
+#ifndef MICROBIT_HEAP_PROFILE
+#define MICROBIT_HEAP_PROFILE                   0
+#endif
+
+// The number of distinct call sites tracked when MICROBIT_HEAP_PROFILE is enabled. Allocations from any further
+// call sites are accounted together, against a call site of zero.
+#ifndef MICROBIT_HEAP_PROFILE_SITES
+#define MICROBIT_HEAP_PROFILE_SITES             32
+#endif
+
 // The amount of memory allocated to Soft Device to hold its BLE GATT table.
 // For standard S110 builds, this should be word aligned and in the range 0x300 - 0x700.
 // Any unused memory will be automatically reclaimed as HEAP memory if both MICROBIT_HEAP_REUSE_SD and MICROBIT_HEAP_ALLOCATOR are enabled.
@@ -149,6 +191,126 @@ extern uint32_t __etext;
 #define SYSTEM_TICK_PERIOD_MS                   6
 #endif
 
+// Enables the system tick governor. This chooses the system tick period from the requirements registered by
+// components through system_timer_set_requirement() and the earliest fiber sleep deadline, lengthening the
+// period (up to SYSTEM_TICK_MAX_PERIOD_MS) when nothing needs frequent callbacks, to save power.
+// n.b. When enabled, components that count ticks without registering a requirement will run at a varying rate.
+// Set '1' to enable.
+#ifndef MICROBIT_SYSTEM_TICK_GOVERNOR
+#define MICROBIT_SYSTEM_TICK_GOVERNOR           0
+#endif
+
+// The longest system tick period the governor will select, in milliseconds.
+#ifndef SYSTEM_TICK_MAX_PERIOD_MS
+#define SYSTEM_TICK_MAX_PERIOD_MS               48
+#endif
+
+// Enables profiling of the system tick. This records how long each component's systemTick() callback takes,
+// and how far each tick strays from its nominal period, retrievable through system_timer_get_profile()
+// and system_timer_get_jitter(). Costs 60 bytes of RAM per registered component.
+// Set '1' to enable.
+#ifndef MICROBIT_SYSTEM_TICK_PROFILING
+#define MICROBIT_SYSTEM_TICK_PROFILING          0
+#endif
+
+// The number of buckets used to hold fibers blocked in fiber_wait_for_event(), hashed by event ID.
+// An event only inspects those fibers in the bucket of its ID, plus those waiting on MICROBIT_ID_ANY.
+// Each bucket costs 4 bytes of RAM.
+#ifndef MICROBIT_FIBER_WAIT_QUEUE_BUCKETS
+#define MICROBIT_FIBER_WAIT_QUEUE_BUCKETS       8
+#endif
+
+// Enable this to page fiber stacks into a set of statically reserved buffers rather than the heap.
+// Buffers are provided in three size classes, and are recycled along with the fibers that own them.
+// Stacks too large for any available buffer fall back to heap allocation.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_STACK_POOL
+#define MICROBIT_FIBER_STACK_POOL               0
+#endif
+
+// The size (bytes, multiple of 4) and number of buffers in each class of the fiber stack pool.
+#ifndef MICROBIT_FIBER_STACK_POOL_SMALL_SIZE
+#define MICROBIT_FIBER_STACK_POOL_SMALL_SIZE    256
+#endif
+
+#ifndef MICROBIT_FIBER_STACK_POOL_SMALL_COUNT
+#define MICROBIT_FIBER_STACK_POOL_SMALL_COUNT   4
+#endif
+
+#ifndef MICROBIT_FIBER_STACK_POOL_MEDIUM_SIZE
+#define MICROBIT_FIBER_STACK_POOL_MEDIUM_SIZE   512
+#endif
+
+#ifndef MICROBIT_FIBER_STACK_POOL_MEDIUM_COUNT
+#define MICROBIT_FIBER_STACK_POOL_MEDIUM_COUNT  2
+#endif
+
+#ifndef MICROBIT_FIBER_STACK_POOL_LARGE_SIZE
+#define MICROBIT_FIBER_STACK_POOL_LARGE_SIZE    1024
+#endif
+
+#ifndef MICROBIT_FIBER_STACK_POOL_LARGE_COUNT
+#define MICROBIT_FIBER_STACK_POOL_LARGE_COUNT   1
+#endif
+
+// Enable this to give every fiber its own persistent stack, rather than sharing the system stack and copying
+// the active region in and out of each fiber on every context switch. Context switches then cost a register
+// save and restore only, regardless of stack depth. Fibers run on the process stack (PSP), interrupts
+// run on a dedicated handler stack, and overflow is detected through a guard word at the bottom of each stack.
+// Fork on block is not available in this mode, so invoke() always launches a fiber.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_DEDICATED_STACKS
+#define MICROBIT_FIBER_DEDICATED_STACKS         0
+#endif
+
+// The size (bytes, multiple of 8) of the stack given to each fiber when MICROBIT_FIBER_DEDICATED_STACKS is enabled.
+// The main fiber continues to use the system stack (MICROBIT_STACK_SIZE).
+#ifndef MICROBIT_FIBER_DEDICATED_STACK_SIZE
+#define MICROBIT_FIBER_DEDICATED_STACK_SIZE     1024
+#endif
+
+// The size (bytes, multiple of 8) of the stack used by interrupt handlers when MICROBIT_FIBER_DEDICATED_STACKS is enabled.
+#ifndef MICROBIT_FIBER_HANDLER_STACK_SIZE
+#define MICROBIT_FIBER_HANDLER_STACK_SIZE       1024
+#endif
+
+// Enable this to record per fiber scheduling statistics (run time, switch count and peak stack depth),
+// and to keep a trace buffer of recent context switches for diagnosing latency problems.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_PROFILING
+#define MICROBIT_FIBER_PROFILING                0
+#endif
+
+// The number of context switches retained in the scheduler trace buffer.
+#ifndef MICROBIT_FIBER_TRACE_BUFFER_SIZE
+#define MICROBIT_FIBER_TRACE_BUFFER_SIZE        16
+#endif
+
+// Enable this to account for the time the processor sleeps and the radio, display, I2C bus and thermometer
+// are active, retrievable through power_profile_get(). Costs 16 bytes of RAM per power domain.
+// Set '1' to enable.
+#ifndef MICROBIT_POWER_PROFILING
+#define MICROBIT_POWER_PROFILING                0
+#endif
+
+// The number of power domains accounted for. Those beyond the built in domains are free for application use.
+#ifndef MICROBIT_POWER_DOMAINS
+#define MICROBIT_POWER_DOMAINS                  8
+#endif
+
+// Enable this to build the runtime micro-benchmarks (see MicroBitBenchmark.h) into the library.
+// They are only needed while measuring the runtime, so are left out of normal builds to save FLASH.
+// Set '1' to enable.
+#ifndef MICROBIT_BENCHMARK
+#define MICROBIT_BENCHMARK                      0
+#endif
+
+// The number of fiber local storage slots held by each fiber.
+// Each slot costs 4 bytes of RAM per fiber. Set '0' to disable fiber local storage.
+#ifndef MICROBIT_FIBER_LOCAL_STORAGE_SLOTS
+#define MICROBIT_FIBER_LOCAL_STORAGE_SLOTS      2
+#endif
+
 //
 // Message Bus:
 // Default behaviour for event handlers, if not specified in the listen() call
@@ -171,20 +333,87 @@ extern uint32_t __etext;
 #define MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH    10
 #endif
 
+//
+// The default depth of the queue held by each MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY listener.
+// This can be changed for an individual listener with MicroBitListener::setQueueDepth().
+//
+#ifndef MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH
+#define MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH    MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH
+#endif
+
+//
+// Enable this to record message bus statistics (events sent, queued, coalesced and dropped, and the peak queue length),
+// along with the number of events dispatched to, and dropped by, each listener and the time spent in its handler.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_STATISTICS
+#define MESSAGE_BUS_STATISTICS                  0
+#endif
+
+//
+// Enable this to defer events raised in interrupt context. Rather than running urgent listeners and queueing
+// the event from within the interrupt, send() simply records the event in a small ring. The ring is drained,
+// and urgent listeners run, in thread context the next time the message bus is serviced by the scheduler.
+// This bounds the time spent in interrupt handlers that raise events, at the expense of urgent listener latency.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_DEFERRED_IRQ_EVENTS
+#define MESSAGE_BUS_DEFERRED_IRQ_EVENTS         0
+#endif
+
+//
+// The number of events raised in interrupt context that can wait to be drained when MESSAGE_BUS_DEFERRED_IRQ_EVENTS
+// is enabled. Further events are dropped.
+//
+#ifndef MESSAGE_BUS_IRQ_QUEUE_DEPTH
+#define MESSAGE_BUS_IRQ_QUEUE_DEPTH             8
+#endif
+
+//
+// Enable this to give the message bus a second, priority event queue. Events from the buttons, the radio and the
+// serial port, and events with a listener flagged MESSAGE_BUS_LISTENER_PRIORITY, are held in this queue and are always
+// delivered ahead of those in the standard queue. This keeps input latency bounded when the standard queue is flooded
+// with lower value events (e.g. sensor data updates), at the expense of strict ordering between the two queues.
+// Set '1' to enable.
+//
+#ifndef MESSAGE_BUS_PRIORITY_LANE
+#define MESSAGE_BUS_PRIORITY_LANE               0
+#endif
+
+//
+// The number of events that can wait in the priority queue when MESSAGE_BUS_PRIORITY_LANE is enabled.
+// Further priority events are dropped.
+//
+#ifndef MESSAGE_BUS_PRIORITY_QUEUE_DEPTH
+#define MESSAGE_BUS_PRIORITY_QUEUE_DEPTH        4
+#endif
+
+//
+// Compact event layout. If enabled, MicroBitEvent holds a 32 bit microsecond timestamp (wrapping approximately
+// every 71 minutes) rather than a 64 bit one, reducing each event from 16 to 8 bytes. Default constructed events
+// are also no longer timestamped, as they are normally placeholders that are overwritten before use.
+// Set '1' to enable.
+//
+#ifndef MICROBIT_EVENT_COMPACT
+#define MICROBIT_EVENT_COMPACT                  0
+#endif
+
 //
 // Core micro:bit services
 //
 
 // To reduce memory cost and complexity, the micro:bit allows components to register for
 // periodic callback events during interrupt context, which occur every scheduling quantum (FIBER_TICK_PERIOD_MS)
-// This defines the maximum size of interrupt callback list.
+// This defines the initial size of interrupt callback list, which is statically allocated.
+// If more components are added, the list is moved to the heap and grown in steps of this size.
 #ifndef MICROBIT_SYSTEM_COMPONENTS
 #define MICROBIT_SYSTEM_COMPONENTS              10
 #endif
 
 // To reduce memory cost and complexity, the micro:bit allows components to register for
 // periodic callback events when the processor is idle.
-// This defines the maximum size of the idle callback list.
+// This defines the initial size of the idle callback list, which is statically allocated.
+// If more components are added, the list is moved to the heap and grown in steps of this size.
 #ifndef MICROBIT_IDLE_COMPONENTS
 #define MICROBIT_IDLE_COMPONENTS                6
 #endif
@@ -270,6 +499,29 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_DEFAULT_TX_POWER           0
 #endif
 
+// Defer the registration of the core BLE services (DFU, event, device information and partial flashing)
+// until they are first needed: the first call to MicroBitBLEManager::advertise(), pairingMode() or startServices().
+// No client can see a service until the micro:bit advertises, so this saves the time and memory they take
+// from start up whenever advertising is not started by init().
+// Set '1' to enable.
+#ifndef MICROBIT_BLE_DEFERRED_SERVICES
+#define MICROBIT_BLE_DEFERRED_SERVICES          0
+#endif
+
+// Prevent MicroBitBLEManager::init() from starting to advertise. The application calls advertise() when it
+// wants to be reachable over BLE.
+// Set '1' to enable.
+#ifndef MICROBIT_BLE_DEFERRED_ADVERTISING
+#define MICROBIT_BLE_DEFERRED_ADVERTISING       0
+#endif
+
+// The time to wait after a client disconnects before its system attributes (the notifications and indications
+// it has enabled) are written to FLASH, in milliseconds. Changes made by clients that reconnect within this
+// time are batched into a single write. Nothing is written while a client is connected.
+#ifndef MICROBIT_BLE_SYSATTR_WRITE_DELAY
+#define MICROBIT_BLE_SYSATTR_WRITE_DELAY        2000
+#endif
+
 // Enable/Disable BLE Service: MicroBitDFU
 // This allows over the air programming during normal operation.
 // Set '1' to enable.
@@ -296,6 +548,36 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_EVENT_SERVICE              1
 #endif
 
+// The number of distinct (id, value) pairs a client of MicroBitEventService may subscribe to.
+#ifndef MICROBIT_BLE_EVENT_SERVICE_SUBSCRIPTIONS
+#define MICROBIT_BLE_EVENT_SERVICE_SUBSCRIPTIONS 16
+#endif
+
+// The number of events MicroBitEventService holds while waiting to notify the client. An event that is
+// already waiting is not queued again, and events arriving while the queue is full are discarded.
+#ifndef MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE
+#define MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE   16
+#endif
+
+// The most events MicroBitEventService packs into each notification, up to 5 in a 20 byte payload.
+// Set '1' for clients that only read the first event of a notification.
+#ifndef MICROBIT_BLE_EVENT_SERVICE_PACKED_EVENTS
+#define MICROBIT_BLE_EVENT_SERVICE_PACKED_EVENTS 5
+#endif
+
+// Enable/Disable the frames characteristic of MicroBitLEDService. Clients write sequences of packed frames to it
+// without response, each with the time to show it for, and they are played through the display's double buffer.
+// Set '1' to enable.
+#ifndef MICROBIT_BLE_LED_STREAMING
+#define MICROBIT_BLE_LED_STREAMING              0
+#endif
+
+// The number of frames MicroBitLEDService holds while waiting to show them. Frames arriving while the queue is
+// full are discarded.
+#ifndef MICROBIT_BLE_LED_FRAME_QUEUE_SIZE
+#define MICROBIT_BLE_LED_FRAME_QUEUE_SIZE       16
+#endif
+
 // Enable/Disable BLE Service: MicroBitDeviceInformationService
 // This enables the standard BLE device information service.
 // Set '1' to enable.
@@ -311,6 +593,28 @@ extern uint32_t __etext;
 #define MICROBIT_BLE_PARTIAL_FLASHING           0
 #endif
 
+// The number of 64 byte blocks MicroBitPartialFlashingService buffers in RAM.
+// Blocks are written to FLASH in the background while the next ones are received, so a client
+// may have up to (MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS - 1) unacknowledged blocks in flight.
+// Must be at least 2.
+#ifndef MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS
+#define MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS   4
+#endif
+
+// Enable/Disable batched data characteristics in MicroBitAccelerometerService and MicroBitMagnetometerService.
+// Each notification of a batched characteristic carries several samples, taken from the sensor's sample stream,
+// so high sample rates can be streamed with fewer notifications. The stream is enabled by the service.
+// Set '1' to enable.
+#ifndef MICROBIT_BLE_SENSOR_BATCHING
+#define MICROBIT_BLE_SENSOR_BATCHING            0
+#endif
+
+// The number of samples the sensor streams queue for the batched characteristics, if not already enabled
+// by the application. Samples arriving while the queue is full are discarded.
+#ifndef MICROBIT_BLE_SENSOR_BATCH_STREAM_SIZE
+#define MICROBIT_BLE_SENSOR_BATCH_STREAM_SIZE   24
+#endif
+
 //
 // Radio options
 //
@@ -330,6 +634,153 @@ extern uint32_t __etext;
 #define MICROBIT_RADIO_UPPER_FREQ_BAND 83
 #endif
 
+// The time, in microseconds, MicroBitRadioEvent waits for further events to send in the same frame as the first.
+// Up to 8 events are sent per frame. Set '0' to send each event in its own frame, as understood by older peers.
+#ifndef MICROBIT_RADIO_EVENT_BATCH_WINDOW
+#define MICROBIT_RADIO_EVENT_BATCH_WINDOW 2000
+#endif
+
+// Enable/Disable listen before talk for the radio.
+// When enabled, MicroBitRadio::send() measures the signal strength on the channel before transmitting,
+// and backs off for a random number of slots while another micro:bit is transmitting.
+// Set '1' to enable.
+#ifndef MICROBIT_RADIO_LISTEN_BEFORE_TALK
+#define MICROBIT_RADIO_LISTEN_BEFORE_TALK 0
+#endif
+
+// The signal strength, in -dBm, at or above which the channel is considered busy.
+#ifndef MICROBIT_RADIO_LBT_THRESHOLD
+#define MICROBIT_RADIO_LBT_THRESHOLD 85
+#endif
+
+// The number of times the channel is found busy before send() gives up. The backoff doubles each time.
+#ifndef MICROBIT_RADIO_LBT_ATTEMPTS
+#define MICROBIT_RADIO_LBT_ATTEMPTS 5
+#endif
+
+// The length of a backoff slot, in microseconds. This is roughly the airtime of a full packet at 1Mbit.
+#ifndef MICROBIT_RADIO_LBT_SLOT
+#define MICROBIT_RADIO_LBT_SLOT 400
+#endif
+
+// Enable/Disable sharing of the radio with the Bluetooth stack.
+// When enabled, MicroBitRadio::enable() succeeds whilst Bluetooth is running, and the radio sends and receives
+// only within timeslots granted by the SoftDevice. Packets sent between timeslots are queued until the next one.
+// Set '1' to enable.
+#ifndef MICROBIT_RADIO_TIMESLOTS
+#define MICROBIT_RADIO_TIMESLOTS 0
+#endif
+
+// The length of each radio timeslot, in microseconds, when the radio is shared with the Bluetooth stack.
+#ifndef MICROBIT_RADIO_TIMESLOT_LENGTH
+#define MICROBIT_RADIO_TIMESLOT_LENGTH 5000
+#endif
+
+// The interval between the start of successive radio timeslots, in microseconds. Together with
+// MICROBIT_RADIO_TIMESLOT_LENGTH, this sets the share of airtime given to the radio (25% by default).
+#ifndef MICROBIT_RADIO_TIMESLOT_PERIOD
+#define MICROBIT_RADIO_TIMESLOT_PERIOD 20000
+#endif
+
+// The time, in microseconds, before the end of a timeslot at which the radio stops, so that a packet
+// in flight can finish and the transceiver can be handed back to the SoftDevice in time.
+#ifndef MICROBIT_RADIO_TIMESLOT_MARGIN
+#define MICROBIT_RADIO_TIMESLOT_MARGIN 700
+#endif
+
+// Sets the default radio data rate, in kbit/s: 250, 1000 or 2000.
+#ifndef MICROBIT_RADIO_DEFAULT_DATA_RATE
+#define MICROBIT_RADIO_DEFAULT_DATA_RATE 1000
+#endif
+
+// The number of radio FrameBuffers held in a dedicated pool, so that packet reception doesn't allocate from the heap.
+// The receive ring permanently holds one more than MICROBIT_RADIO_MAXIMUM_RX_BUFFERS. The other two replace
+// packets handed on to higher layer protocols, until they are freed, and hold copies of packets queued for transmission.
+// Further FrameBuffers are allocated from the heap. Set '0' to allocate all FrameBuffers from the heap.
+#ifndef MICROBIT_RADIO_FRAME_POOL_SIZE
+#define MICROBIT_RADIO_FRAME_POOL_SIZE (MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 3)
+#endif
+
+// The number of packets that can be queued awaiting transmission by the radio interrupt.
+// MicroBitRadio::send() waits for space once the queue is full.
+#ifndef MICROBIT_RADIO_TX_QUEUE_SIZE
+#define MICROBIT_RADIO_TX_QUEUE_SIZE 4
+#endif
+
+// The largest message, in bytes, that MicroBitRadioBulk will send or reassemble.
+// Messages are sent in fragments of 28 bytes, and can be no longer than 32 fragments (896 bytes).
+#ifndef MICROBIT_RADIO_BULK_MAX_SIZE
+#define MICROBIT_RADIO_BULK_MAX_SIZE 256
+#endif
+
+// The number of complete MicroBitRadioBulk messages that can be queued awaiting recv().
+// Further messages are dropped.
+#ifndef MICROBIT_RADIO_BULK_QUEUE_SIZE
+#define MICROBIT_RADIO_BULK_QUEUE_SIZE 2
+#endif
+
+// The number of MicroBitRadioReliable packets that may be sent before the first is acknowledged.
+// Larger windows keep the link busier over a slow round trip, at the cost of a FrameBuffer per packet.
+// Must be less than 128.
+#ifndef MICROBIT_RADIO_RELIABLE_WINDOW
+#define MICROBIT_RADIO_RELIABLE_WINDOW 4
+#endif
+
+// The time, in microseconds, MicroBitRadioReliable waits for an acknowledgement before retransmitting.
+// This is lengthened in proportion at data rates below 1Mbit.
+#ifndef MICROBIT_RADIO_RELIABLE_TIMEOUT
+#define MICROBIT_RADIO_RELIABLE_TIMEOUT 20000
+#endif
+
+// The number of times MicroBitRadioReliable retransmits without any progress, before abandoning the packets awaiting acknowledgement.
+#ifndef MICROBIT_RADIO_RELIABLE_RETRIES
+#define MICROBIT_RADIO_RELIABLE_RETRIES 10
+#endif
+
+// The number of MicroBitRadioReliable packets that can be queued awaiting recv().
+// Further packets are not acknowledged, so the sender will retransmit them later.
+#ifndef MICROBIT_RADIO_RELIABLE_QUEUE_SIZE
+#define MICROBIT_RADIO_RELIABLE_QUEUE_SIZE 4
+#endif
+
+// The interval, in microseconds, between the beacons sent by a MicroBitRadioTime reference.
+#ifndef MICROBIT_RADIO_TIME_BEACON_PERIOD
+#define MICROBIT_RADIO_TIME_BEACON_PERIOD 1000000
+#endif
+
+// The number of beacon periods MicroBitRadioTime waits without hearing its reference, before it no longer
+// considers itself synchronised, and will follow another reference.
+#ifndef MICROBIT_RADIO_TIME_TIMEOUT
+#define MICROBIT_RADIO_TIME_TIMEOUT 5
+#endif
+
+// The number of PacketBuffer payloads of up to MICROBIT_PACKET_POOL_PAYLOAD_SIZE bytes held in a dedicated pool.
+// Larger or further payloads are allocated from the heap. Set '0' to allocate all payloads from the heap.
+#ifndef MICROBIT_PACKET_POOL_SIZE
+#define MICROBIT_PACKET_POOL_SIZE 4
+#endif
+
+#ifndef MICROBIT_PACKET_POOL_PAYLOAD_SIZE
+#define MICROBIT_PACKET_POOL_PAYLOAD_SIZE 32
+#endif
+
+//
+// ManagedString options
+//
+
+// Enable this to hold every single character ASCII string in a read only table in FLASH memory (approximately 1K),
+// so that creating a ManagedString of one character (e.g. from a char, a digit, or a one character substring) never allocates memory.
+// Set '1' to enable.
+#ifndef MICROBIT_STRING_CHAR_TABLE
+#define MICROBIT_STRING_CHAR_TABLE              1
+#endif
+
+// The number of characters a ManagedStringBuilder allows space for when it first allocates its buffer.
+// The buffer is doubled in size each time it fills.
+#ifndef MICROBIT_STRING_BUILDER_CAPACITY
+#define MICROBIT_STRING_BUILDER_CAPACITY        32
+#endif
+
 //
 // Accelerometer options
 //
@@ -353,6 +804,72 @@ extern uint32_t __etext;
 #define MICROBIT_FULL_RANGE_PITCH_CALCULATION   1
 #endif
 
+//
+// Calculate pitch, roll and compass bearings using fixed point CORDIC rather than floating point
+// trigonometry, which is emulated in software on the nRF51. Results agree to within a few hundredths
+// of a degree. benchmark_orientation() compares the two.
+// Set '1' to enable.
+//
+#ifndef MICROBIT_FIXED_POINT_ORIENTATION
+#define MICROBIT_FIXED_POINT_ORIENTATION        1
+#endif
+
+//
+// The largest number of samples that can be read from the accelerometer in a single burst,
+// as configured by MicroBitAccelerometer::setBatchSize(). This is the depth of the hardware
+// FIFO on the LSM303 and FXOS8700.
+//
+#ifndef MICROBIT_ACCELEROMETER_FIFO_SIZE
+#define MICROBIT_ACCELEROMETER_FIFO_SIZE        32
+#endif
+
+//
+// The largest number of samples that the filters of the accelerometer, compass, thermometer and
+// light sensor can be configured to smooth over. See MicroBitSampleFilter.
+//
+#ifndef MICROBIT_FILTER_MAX_LENGTH
+#define MICROBIT_FILTER_MAX_LENGTH              16
+#endif
+
+//
+// The time (in milliseconds) that the accelerometer, compass and thermometer continue sampling after their
+// data was last read, if nothing is listening for their events. They are then placed into standby, and
+// resume when next read or when a listener for their events is registered.
+// Set to '0' to sample continuously once first read.
+//
+#ifndef MICROBIT_SENSOR_IDLE_TIMEOUT
+#define MICROBIT_SENSOR_IDLE_TIMEOUT            2000
+#endif
+
+//
+// Compass calibration finishes as soon as at least MICROBIT_COMPASS_CALIBRATION_MIN_SAMPLES have been gathered,
+// the estimated centre has settled, and the samples cover enough of the sphere around it. Coverage ranges from
+// 0 (all samples in a plane) to 1024 (samples spread evenly in every direction); a hemisphere scores about 600.
+// Set MICROBIT_COMPASS_CALIBRATION_COVERAGE above 1024 to always wait until the whole display has been filled.
+//
+#ifndef MICROBIT_COMPASS_CALIBRATION_MIN_SAMPLES
+#define MICROBIT_COMPASS_CALIBRATION_MIN_SAMPLES    12
+#endif
+
+#ifndef MICROBIT_COMPASS_CALIBRATION_COVERAGE
+#define MICROBIT_COMPASS_CALIBRATION_COVERAGE       768
+#endif
+
+//
+// Background compass calibration, started with MicroBitCompassCalibrator::startBackgroundCalibration(), gathers up to
+// MICROBIT_COMPASS_BACKGROUND_SAMPLES well spaced samples as the compass is used, and recalibrates each time they cover
+// enough of the sphere (as above). The result is only written to storage if its centre has moved by more than
+// 1/MICROBIT_COMPASS_BACKGROUND_THRESHOLD of the field radius, or a scale factor has changed by more than
+// 1/MICROBIT_COMPASS_BACKGROUND_THRESHOLD, since the calibration was last stored.
+//
+#ifndef MICROBIT_COMPASS_BACKGROUND_SAMPLES
+#define MICROBIT_COMPASS_BACKGROUND_SAMPLES         32
+#endif
+
+#ifndef MICROBIT_COMPASS_BACKGROUND_THRESHOLD
+#define MICROBIT_COMPASS_BACKGROUND_THRESHOLD       16
+#endif
+
 //
 // Display options
 //
@@ -387,6 +904,55 @@ extern uint32_t __etext;
 #define MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS     MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS
 #endif
 
+// Drives the bit planes of the greyscale display mode from a dedicated hardware timer, clocked at 1MHz.
+// All bit planes of a row are computed once per strobe, and the timer interrupt simply writes the next one,
+// so plane lengths are exact and little time is spent in interrupt context.
+// Set '1' to enable.
+#ifndef MICROBIT_DISPLAY_HARDWARE_GREYSCALE
+#define MICROBIT_DISPLAY_HARDWARE_GREYSCALE     0
+#endif
+
+// The hardware timer used for greyscale, and its interrupt. This must not be used by anything else.
+#ifndef MICROBIT_DISPLAY_GREYSCALE_TIMER
+#define MICROBIT_DISPLAY_GREYSCALE_TIMER        NRF_TIMER1
+#endif
+
+#ifndef MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn
+#define MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn   TIMER1_IRQn
+#endif
+
+// Ends each row strobe of the black and white display modes in hardware, when the brightness is below the maximum.
+// The row is driven by a GPIOTE task, which MICROBIT_DISPLAY_GREYSCALE_TIMER clears through a PPI channel once
+// the row has been lit for long enough. This takes no interrupt, and the on time is exact to 1us.
+// Set '1' to enable.
+#ifndef MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS
+#define MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS    0
+#endif
+
+// The GPIOTE and PPI channels used by MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS. These are shared with
+// MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL and MICROBIT_PIN_CAPTURE_PPI_CHANNEL, as the timer is already shared.
+#ifndef MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL
+#define MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL  3
+#endif
+
+#ifndef MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL
+#define MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL     6
+#endif
+
+// Leaves rows with no lit pixels out of the strobe cycle in black and white mode, so the remaining rows are
+// strobed more often. This reduces flicker and interrupt load for sparse images, but lit rows appear brighter
+// as the number of blank rows increases.
+// Set '1' to enable.
+#ifndef MICROBIT_DISPLAY_SKIP_BLANK_ROWS
+#define MICROBIT_DISPLAY_SKIP_BLANK_ROWS        0
+#endif
+
+// The number of animations (scroll, print and animate requests) that may wait for the display while another is shown.
+// Asynchronous requests made while the queue is full return MICROBIT_BUSY. Must be at least 1.
+#ifndef MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE
+#define MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE   4
+#endif
+
 // Selects the default scroll speed for the display.
 // The time taken to move a single pixel (ms).
 #ifndef MICROBIT_DEFAULT_SCROLL_SPEED
@@ -409,6 +975,57 @@ extern uint32_t __etext;
 #define MICROBIT_DEFAULT_SERIAL_MODE            SYNC_SLEEP
 #endif
 
+// Rounds the storage of serial and Bluetooth UART buffers up to a power of two, so that buffer indexes wrap with a bitwise AND
+// rather than a division. One byte of storage is always kept free, so a size of (2^n - 1) wastes no memory.
+// Set '1' to enable.
+#ifndef MICROBIT_SERIAL_POWER_OF_TWO_BUFFERS
+#define MICROBIT_SERIAL_POWER_OF_TWO_BUFFERS    0
+#endif
+
+//
+// The number of FLASH operations that MicroBitFlash can queue for the SoftDevice.
+// Page erases and writes requested with erase_page_async() and flash_burn_async() wait for space once the queue is full.
+//
+#ifndef MICROBIT_FLASH_QUEUE_SIZE
+#define MICROBIT_FLASH_QUEUE_SIZE               4
+#endif
+
+//
+// Drive register reads and writes on the I2C bus from the TWI interrupt, rather than mbed's polled driver.
+// Transfers are queued, and the calling fiber is descheduled until its transfer completes.
+// Set '1' to enable.
+//
+#ifndef MICROBIT_I2C_ASYNC
+#define MICROBIT_I2C_ASYNC                      1
+#endif
+
+//
+// The number of control registers each sensor driver keeps a shadow copy of.
+// Writes that would not change a shadowed register are skipped.
+//
+#ifndef MICROBIT_I2C_REGISTER_CACHE_SIZE
+#define MICROBIT_I2C_REGISTER_CACHE_SIZE        8
+#endif
+
+//
+// The number of bytes of true random data gathered from the hardware RNG in the background, by interrupt, once
+// microbit_seed_random() has been called. microbit_entropy_read() and microbit_seed_random() take bytes from this pool
+// rather than waiting for the RNG. When Bluetooth is running, the pool is topped up from the SoftDevice instead.
+// Set to zero to disable this feature. At most 255.
+//
+#ifndef MICROBIT_ENTROPY_POOL_SIZE
+#define MICROBIT_ENTROPY_POOL_SIZE              32
+#endif
+
+//
+// Enable this to have microbit_random() and microbit_random_fill() draw from the entropy pool while it holds enough
+// data, falling back to the Galois LFSR when it runs dry. Requires MICROBIT_ENTROPY_POOL_SIZE.
+// Set '1' to enable.
+//
+#ifndef MICROBIT_RANDOM_ENTROPY
+#define MICROBIT_RANDOM_ENTROPY                 0
+#endif
+
 //
 // File System configuration defaults
 //
@@ -422,14 +1039,43 @@ extern uint32_t __etext;
 #endif
 
 //
-// FileSystem writeback cache size, in bytes. Defines how many bytes will be stored
+// Default FileSystem writeback cache size, in bytes. Defines how many bytes will be stored
 // in RAM before being written back to FLASH. Set to zero to disable this feature.
-// Should be <= MBFS_BLOCK_SIZE.
+// Should be <= MBFS_BLOCK_SIZE. This can be overridden for each file when it is opened.
 //
 #ifndef MBFS_CACHE_SIZE
 #define MBFS_CACHE_SIZE	    0   
 #endif
 
+//
+// The number of block chain lookups (block index within a file -> logical block) remembered for each open file.
+// Seeks then walk the file table from the nearest remembered block, rather than from the start of the file.
+// Costs 4 bytes of RAM per entry, per open file. Set to zero to disable this feature.
+//
+#ifndef MBFS_BLOCK_CACHE_SIZE
+#define MBFS_BLOCK_CACHE_SIZE   4
+#endif
+
+//
+// The number of slots in the in-RAM hash index of directory entries, used to find files without scanning their directory.
+// Must be a power of two. Up to three quarters of the slots are used. If there are more files than that, files
+// not found in the index are searched for as normal. Costs 8 bytes of RAM per slot, allocated on first use.
+// Set to zero to disable this feature.
+//
+#ifndef MBFS_INDEX_SIZE
+#define MBFS_INDEX_SIZE         64
+#endif
+
+//
+// Enables a checkpoint of the free block map and directory index, held in the flash page after the file system.
+// It is rewritten whenever the last open file is closed after a change, and lets the next boot restore both without
+// scanning the file table and every directory. Costs one page of newly formatted file systems, and one page erase
+// per session of changes. Set to zero to disable this feature.
+//
+#ifndef MBFS_CHECKPOINT
+#define MBFS_CHECKPOINT         1
+#endif
+
 //
 // I/O Options
 //
@@ -443,6 +1089,81 @@ extern uint32_t __etext;
 #define MICROBIT_DEFAULT_PULLMODE                PullDown
 #endif
 
+// Samples buttons only while they are in use. An edge on the pin starts the debounce filter, which runs every
+// SYSTEM_TICK_PERIOD_MS from a one shot timer event until the button is released and settled, rather than on
+// every system tick. This costs an InterruptIn per button.
+// Set '1' to enable.
+#ifndef MICROBIT_BUTTON_INTERRUPT_WAKE
+#define MICROBIT_BUTTON_INTERRUPT_WAKE           0
+#endif
+
+// The hardware used to timestamp edges on a pin in the MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE mode.
+// Each edge is detected by a GPIOTE channel, which captures a free running 1MHz timer through a PPI channel.
+// None of these may be used by anything else while a pin is in this mode. By default, these avoid the
+// GPIOTE and PPI channels used by mbed for PWM, and the PPI channels reserved by the SoftDevice, but the timer
+// is shared with MICROBIT_DISPLAY_GREYSCALE_TIMER.
+#ifndef MICROBIT_PIN_CAPTURE_TIMER
+#define MICROBIT_PIN_CAPTURE_TIMER               NRF_TIMER1
+#endif
+
+#ifndef MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL
+#define MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL      3
+#endif
+
+#ifndef MICROBIT_PIN_CAPTURE_PPI_CHANNEL
+#define MICROBIT_PIN_CAPTURE_PPI_CHANNEL         6
+#endif
+
+// The hardware used by MicroBitAnalogSampler to start each ADC conversion. The timer is shared with
+// MICROBIT_DISPLAY_GREYSCALE_TIMER and MICROBIT_PIN_CAPTURE_TIMER, so only one of these may be in use at a time.
+#ifndef MICROBIT_ANALOG_SAMPLER_TIMER
+#define MICROBIT_ANALOG_SAMPLER_TIMER            NRF_TIMER1
+#endif
+
+#ifndef MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL
+#define MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL      7
+#endif
+
+// Drives the analog outputs of MicroBitPin in software from a hardware timer (see SoftPwmOut), rather than with
+// mbed's PwmOut. This supports up to MICROBIT_SOFT_PWM_CHANNELS pins at once, each with its own period, at the
+// cost of one short interrupt per edge. Set '1' to enable.
+#ifndef MICROBIT_PIN_SOFT_PWM
+#define MICROBIT_PIN_SOFT_PWM                    0
+#endif
+
+// The number of pins that SoftPwmOut can drive at once.
+#ifndef MICROBIT_SOFT_PWM_CHANNELS
+#define MICROBIT_SOFT_PWM_CHANNELS               8
+#endif
+
+// The hardware timer used by SoftPwmOut, and its interrupt. This is shared with MICROBIT_DISPLAY_GREYSCALE_TIMER,
+// MICROBIT_PIN_CAPTURE_TIMER and MICROBIT_ANALOG_SAMPLER_TIMER, so only one of these may be in use at a time.
+#ifndef MICROBIT_SOFT_PWM_TIMER
+#define MICROBIT_SOFT_PWM_TIMER                  NRF_TIMER1
+#endif
+
+#ifndef MICROBIT_SOFT_PWM_TIMER_IRQn
+#define MICROBIT_SOFT_PWM_TIMER_IRQn             TIMER1_IRQn
+#endif
+
+// The hardware timer used by MicroBitTouchSensor to time each pad while it charges. It is only running during a scan,
+// but is shared with MICROBIT_DISPLAY_GREYSCALE_TIMER, MICROBIT_PIN_CAPTURE_TIMER, MICROBIT_ANALOG_SAMPLER_TIMER and
+// MICROBIT_SOFT_PWM_TIMER, so none of these may be in use while scanning.
+#ifndef MICROBIT_TOUCH_TIMER
+#define MICROBIT_TOUCH_TIMER                     NRF_TIMER1
+#endif
+
+// The value of the resistor that charges each touch pad, in kilohms. The pads on the edge connector (P0, P1 and P2)
+// are each pulled up through 10M.
+#ifndef MICROBIT_TOUCH_RESISTANCE_KOHM
+#define MICROBIT_TOUCH_RESISTANCE_KOHM           10000
+#endif
+
+// The capacitance above a pad's baseline at which it is considered touched, in femtofarads.
+#ifndef MICROBIT_TOUCH_THRESHOLD
+#define MICROBIT_TOUCH_THRESHOLD                 30000
+#endif
+
 //
 // Panic options
 //
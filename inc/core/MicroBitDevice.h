@@ -48,6 +48,18 @@ DEALINGS IN THE SOFTWARE.
   */
 bool ble_running();
 
+/**
+  * Registers a function to be called with each SoC event raised by the SoftDevice,
+  * such as the completion of a FLASH operation or the scheduling of a radio timeslot.
+  *
+  * The Bluetooth stack delivers SoC events to a single handler, so drivers register here to share it.
+  *
+  * @param handler The function to call with the event identifier.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if handler is NULL, or MICROBIT_NO_RESOURCES if too many handlers are registered.
+  */
+int microbit_add_soc_event_handler(void (*handler)(uint32_t));
+
 /**
  * Derive a unique, consistent serial number of this device from internal data.
  *
@@ -115,6 +127,52 @@ void microbit_panic_timeout(int iterations);
   */
 int microbit_random(int max);
 
+/**
+  * Fills a buffer with random bytes.
+  *
+  * This is much faster than calling microbit_random(256) for each byte. Bytes are taken from the Galois LFSR,
+  * or from the entropy pool while it holds enough data if MICROBIT_RANDOM_ENTROPY is enabled.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The number of bytes to write.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is NULL or length is negative.
+  *
+  * @code
+  * uint8_t noise[64];
+  * microbit_random_fill(noise, sizeof(noise));
+  * @endcode
+  */
+int microbit_random_fill(uint8_t *buffer, int length);
+
+/**
+  * Determines how many bytes of true random data are immediately available to microbit_entropy_read().
+  *
+  * @return The number of bytes in the entropy pool, or zero if MICROBIT_ENTROPY_POOL_SIZE is zero.
+  */
+int microbit_entropy_available();
+
+/**
+  * Takes true random data, gathered from the hardware RNG in the background, from the entropy pool.
+  * This never waits for the RNG. The pool is topped up again as data is taken.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The number of bytes required. This can be no more than MICROBIT_ENTROPY_POOL_SIZE.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is NULL or length is out of range,
+  *         or MICROBIT_NO_DATA if the pool holds fewer than length bytes, in which case none are taken.
+  *
+  * @code
+  * uint8_t key[16];
+  *
+  * while (microbit_entropy_read(key, sizeof(key)) != MICROBIT_OK)
+  *     fiber_sleep(1);
+  * @endcode
+  */
+int microbit_entropy_read(uint8_t *buffer, int length);
+
 /**
   * Seed the random number generator (RNG).
   *
@@ -122,6 +180,9 @@ int microbit_random(int max);
   * We do this as the hardware RNG is relatively high power, and is locked out by the BLE stack internally,
   * with a less than optimal application interface. A Galois LFSR is sufficient for our
   * applications, and much more lightweight.
+  *
+  * The seed is taken from the entropy pool where possible, so only the first call waits for the RNG. This also
+  * starts the pool filling in the background.
   */
 void microbit_seed_random();
 
@@ -50,6 +50,27 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_FIBER_FLAG_PARENT          0x02
 #define MICROBIT_FIBER_FLAG_CHILD           0x04
 #define MICROBIT_FIBER_FLAG_DO_NOT_PAGE     0x08
+#define MICROBIT_FIBER_FLAG_TIMED_WAIT      0x10
+#define MICROBIT_FIBER_FLAG_TIMED_OUT       0x20
+
+// Fiber Priorities.
+// Runnable fibers of a higher priority are always scheduled ahead of those of a lower priority.
+// Fibers of equal priority are scheduled round robin.
+#define MICROBIT_FIBER_PRIORITY_LOW         0
+#define MICROBIT_FIBER_PRIORITY_NORMAL      1
+#define MICROBIT_FIBER_PRIORITY_HIGH        2
+#define MICROBIT_FIBER_PRIORITY_CRITICAL    3
+
+#define MICROBIT_FIBER_PRIORITY_LEVELS      4
+
+// Idle Component Modes.
+// Polled components have their idleTick() called every time the processor is idle.
+// On demand components have their idleTick() called only after they have signalled they have work pending.
+#define MICROBIT_IDLE_COMPONENT_POLLED      0
+#define MICROBIT_IDLE_COMPONENT_ON_DEMAND   1
+
+// The value held in the lowest word of each dedicated stack. If this changes, the stack has overflowed.
+#define MICROBIT_FIBER_STACK_GUARD          0x57AC6E4D
 
 /**
   *  Thread Context for an ARM Cortex M0 core.
@@ -84,12 +105,39 @@ struct Fiber
 {
     Cortex_M0_TCB tcb;                  // Thread context when last scheduled out.
     uint32_t stack_bottom;              // The start address of this Fiber's stack. The stack is heap allocated, and full descending.
+                                        // With MICROBIT_FIBER_DEDICATED_STACKS, this is the stack the fiber executes on.
     uint32_t stack_top;                 // The end address of this Fiber's stack.
     uint32_t context;                   // Context specific information.
     uint32_t flags;                     // Information about this fiber.
+    uint8_t priority;                   // The scheduling priority of this fiber (MICROBIT_FIBER_PRIORITY_*).
     Fiber **queue;                      // The queue this fiber is stored on.
     Fiber *next, *prev;                 // Position of this Fiber on the run queue.
+    Fiber *timed_next;                  // Position of this Fiber on the timed wait queue, if blocked in fiber_wait_for_event_timeout().
+    uint32_t wake_time;                 // The time at which a timed wait gives up (milliseconds).
+
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    void *local[MICROBIT_FIBER_LOCAL_STORAGE_SLOTS];   // Fiber local storage, indexed by key.
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+    uint32_t switch_count;              // The number of times this fiber has been scheduled in.
+    uint32_t run_time;                  // The total time this fiber has spent executing (microseconds).
+    uint32_t run_start;                 // The time at which this fiber was last scheduled in (microseconds).
+    uint32_t peak_stack;                // The deepest stack observed when this fiber was paged out (bytes).
+#endif
+};
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+/**
+  * A record of a single context switch, as held in the scheduler trace buffer.
+  */
+struct FiberTraceRecord
+{
+    uint32_t timestamp;                 // The time at which the switch occurred (microseconds, truncated to 32 bits).
+    Fiber *from;                        // The fiber that was scheduled out.
+    Fiber *to;                          // The fiber that was scheduled in.
 };
+#endif
 
 extern Fiber *currentFiber;
 
@@ -111,6 +159,15 @@ void scheduler_init(EventModel &_messageBus);
   */
 int fiber_scheduler_running();
 
+/**
+  * Determines if the calling code is running in the idle thread, such as from an idleTick() callback.
+  *
+  * The idle thread is restarted rather than resumed when it is next scheduled, so it must never block.
+  *
+  * @return 1 if running in the idle thread, 0 otherwise.
+  */
+int fiber_is_idle();
+
 /**
   * Exit point for all fibers.
   *
@@ -155,9 +212,11 @@ void launch_new_fiber_param(void (*ep)(void *), void (*cp)(void *), void *pm)
   * @param completion_fn The function called when the thread completes execution of entry_fn.
   *                      Defaults to release_fiber.
   *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
   * @return The new Fiber, or NULL if the operation could not be completed.
   */
-Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void) = release_fiber);
+Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void) = release_fiber, int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
 
 
 /**
@@ -170,9 +229,103 @@ Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void) = releas
   * @param completion_fn The function called when the thread completes execution of entry_fn.
   *                      Defaults to release_fiber.
   *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *) = release_fiber, int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
+
+/**
+  * Creates a new Fiber that calls the given function once per period, forever.
+  *
+  * Calls are scheduled against a fixed period from when the fiber starts, so they do not drift
+  * however long the function takes to complete. If a call overruns, any missed periods are skipped.
+  *
+  * @param entry_fn The function to call once per period.
+  *
+  * @param period The time between each call, in milliseconds.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  *
+  * @code
+  * // Log a sample at 50Hz.
+  * create_periodic_fiber(logSample, 20);
+  * @endcode
+  */
+Fiber *create_periodic_fiber(void (*entry_fn)(void), unsigned long period, int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
+
+/**
+  * Creates a new parameterised Fiber that calls the given function once per period, forever.
+  *
+  * Calls are scheduled against a fixed period from when the fiber starts, so they do not drift
+  * however long the function takes to complete. If a call overruns, any missed periods are skipped.
+  *
+  * @param entry_fn The function to call once per period.
+  *
+  * @param param an untyped parameter passed into entry_fn.
+  *
+  * @param period The time between each call, in milliseconds.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
   * @return The new Fiber, or NULL if the operation could not be completed.
   */
-Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *) = release_fiber);
+Fiber *create_periodic_fiber(void (*entry_fn)(void *), void *param, unsigned long period, int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
+
+/**
+  * Changes the scheduling priority of the given Fiber.
+  *
+  * If the fiber is currently runnable, it is moved to the tail of the run queue for its new priority.
+  *
+  * @param f The fiber to update, or NULL to update the currently running fiber.
+  *
+  * @param priority The new priority, in the range MICROBIT_FIBER_PRIORITY_LOW..MICROBIT_FIBER_PRIORITY_CRITICAL.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the priority is out of range.
+  */
+int fiber_set_priority(Fiber *f, int priority);
+
+/**
+  * Determines the scheduling priority of the given Fiber.
+  *
+  * @param f The fiber to query, or NULL to query the currently running fiber.
+  *
+  * @return The priority of the fiber.
+  */
+int fiber_get_priority(Fiber *f = NULL);
+
+/**
+  * Allocates a fiber local storage key. Each fiber holds its own value for each key, which is initially NULL.
+  *
+  * @param destructor An optional function, called with the value held by a fiber for this key when that fiber
+  *                   completes, if the value is not NULL. Useful for releasing per fiber buffers.
+  *
+  * @return The new key, or MICROBIT_NO_RESOURCES if all MICROBIT_FIBER_LOCAL_STORAGE_SLOTS keys are in use.
+  */
+int fiber_local_key_create(void (*destructor)(void *) = NULL);
+
+/**
+  * Sets the value held by the currently running fiber for the given fiber local storage key.
+  *
+  * @param key A key previously returned by fiber_local_key_create().
+  *
+  * @param value The value to store.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is not valid,
+  *         or MICROBIT_NOT_SUPPORTED if the scheduler is not running.
+  */
+int fiber_local_set(int key, void *value);
+
+/**
+  * Determines the value held by the currently running fiber for the given fiber local storage key.
+  *
+  * @param key A key previously returned by fiber_local_key_create().
+  *
+  * @return The value stored, or NULL if no value has been stored, the key is not valid or the scheduler is not running.
+  */
+void *fiber_local_get(int key);
 
 
 /**
@@ -194,6 +347,33 @@ void schedule();
   */
 void fiber_sleep(unsigned long t);
 
+/**
+  * Blocks the calling thread until the given system time.
+  * The calling thread will be immediateley descheduled, and placed onto a
+  * wait queue until the requested time is reached.
+  *
+  * Unlike fiber_sleep(), the wake time does not depend upon when this call is made, so loops
+  * that sleep until a fixed series of deadlines do not drift.
+  *
+  * @param deadline The system time to wake at, in milliseconds (as given by system_timer_current_time()).
+  *                 If this time has already passed, the call returns immediately.
+  *
+  * @code
+  * uint64_t deadline = system_timer_current_time();
+  *
+  * while(1)
+  * {
+  *     sample();
+  *     deadline += 20;
+  *     fiber_sleep_until(deadline);
+  * }
+  * @endcode
+  *
+  * @note the fiber will not be be made runnable until after the given time, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+void fiber_sleep_until(uint64_t deadline);
+
 /**
   * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
   * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
@@ -201,6 +381,15 @@ void fiber_sleep(unsigned long t);
   */
 void scheduler_tick();
 
+/**
+  * Determines the time at which the next fiber blocked in fiber_sleep() or a timed wait is due to be woken.
+  *
+  * This allows power management code to determine how long the processor may safely sleep for.
+  *
+  * @return the time (in milliseconds since power on) of the earliest pending wake up, or 0 if no fibers are sleeping.
+  */
+uint32_t scheduler_next_wakeup();
+
 /**
   * Blocks the calling thread until the specified event is raised.
   * The calling thread will be immediateley descheduled, and placed onto a
@@ -221,6 +410,29 @@ void scheduler_tick();
   */
 int fiber_wait_for_event(uint16_t id, uint16_t value);
 
+/**
+  * Blocks the calling thread until the specified event is raised, or the given period of time has elapsed,
+  * whichever happens first.
+  *
+  * @param id The ID field of the event to listen for (e.g. MICROBIT_ID_RADIO)
+  *
+  * @param value The value of the event to listen for (e.g. MICROBIT_RADIO_EVT_DATAGRAM)
+  *
+  * @param timeout The maximum period of time to wait, in milliseconds.
+  *
+  * @return MICROBIT_OK if the event was raised, MICROBIT_TIMEOUT if the period elapsed first,
+  *         or MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running, or associated with an EventModel.
+  *
+  * @code
+  * if (fiber_wait_for_event_timeout(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, 50) == MICROBIT_TIMEOUT)
+  *     retry();
+  * @endcode
+  *
+  * @note the fiber will not be be made runnable until after the event is raised or the time has elapsed, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+int fiber_wait_for_event_timeout(uint16_t id, uint16_t value, uint32_t timeout);
+
 /**
   * Configures the fiber context for the current fiber to block on an event ID
   * and value, but does not deschedule the fiber.
@@ -253,9 +465,12 @@ int fiber_wake_on_event(uint16_t id, uint16_t value);
   *
   * @param entry_fn The function to execute.
   *
+  * @param priority The scheduling priority given to any fiber created should entry_fn block.
+  *                 Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
   * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
   */
-int invoke(void (*entry_fn)(void));
+int invoke(void (*entry_fn)(void), int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
 
 /**
   * Executes the given function asynchronously if necessary, and offers the ability to provide a parameter.
@@ -270,9 +485,12 @@ int invoke(void (*entry_fn)(void));
   *
   * @param param an untyped parameter passed into the entry_fn and completion_fn.
   *
+  * @param priority The scheduling priority given to any fiber created should entry_fn block.
+  *                 Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
   * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
   */
-int invoke(void (*entry_fn)(void *), void *param);
+int invoke(void (*entry_fn)(void *), void *param, int priority = MICROBIT_FIBER_PRIORITY_NORMAL);
 
 /**
   * Resizes the stack allocation of the current fiber if necessary to hold the system stack.
@@ -341,10 +559,17 @@ void idle_task();
   * Adds a component to the array of idle thread components, which are processed
   * when the run queue is empty.
   *
+  * The array grows as necessary, so is not limited to MICROBIT_IDLE_COMPONENTS entries.
+  *
   * @param component The component to add to the array.
-  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array is full.
+  *
+  * @param mode MICROBIT_IDLE_COMPONENT_POLLED to have the component's idleTick() called every time the processor is idle, or
+  *             MICROBIT_IDLE_COMPONENT_ON_DEMAND to have it called only after fiber_idle_component_pending() has been called
+  *             for this component. Defaults to MICROBIT_IDLE_COMPONENT_POLLED.
+  *
+  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array could not be grown.
   */
-int fiber_add_idle_component(MicroBitComponent *component);
+int fiber_add_idle_component(MicroBitComponent *component, int mode = MICROBIT_IDLE_COMPONENT_POLLED);
 
 /**
   * remove a component from the array of idle thread components
@@ -354,6 +579,147 @@ int fiber_add_idle_component(MicroBitComponent *component);
   */
 int fiber_remove_idle_component(MicroBitComponent *component);
 
+/**
+  * Signals that the given idle component has work to do, so that its idleTick() is called the next
+  * time the processor is idle. The signal is cleared once the component has been serviced.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param component The component with work pending.
+  *
+  * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
+  */
+int fiber_idle_component_pending(MicroBitComponent *component);
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+/**
+  * Copies the most recent context switches recorded by the scheduler into the given buffer.
+  *
+  * Records are provided oldest first. At most MICROBIT_FIBER_TRACE_BUFFER_SIZE records are retained.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The maximum number of records to copy into buffer.
+  *
+  * @return The number of records copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL or length is negative.
+  */
+int fiber_get_trace(FiberTraceRecord *buffer, int length);
+
+/**
+  * Resets the per fiber statistics of the given fiber, and optionally clears the scheduler trace buffer.
+  *
+  * @param f The fiber to reset, or NULL to reset only the trace buffer.
+  */
+void fiber_reset_statistics(Fiber *f);
+
+#if CONFIG_ENABLED(MICROBIT_DBG)
+/**
+  * Diagnostics function. Displays the scheduler trace buffer, and the statistics of
+  * the currently running fiber, through the debug serial port.
+  */
+void fiber_trace_print();
+#endif
+#endif
+
+/**
+  * A counting semaphore that is integrated with the fiber scheduler.
+  *
+  * Fibers that wait on a semaphore with no available units are descheduled and held in a FIFO,
+  * rather than polling. Each call to notify() wakes exactly one waiting fiber, handing the unit
+  * directly to it, so it cannot be taken by another fiber in the meantime. Waiters of a higher priority
+  * are handed units ahead of those of a lower priority.
+  *
+  * notify() and notifyAll() may be safely called from interrupt context.
+  */
+class FiberSemaphore
+{
+    protected:
+
+    int count;                  // The number of units currently available.
+    int max;                    // The maximum number of units that may be available.
+    Fiber *queue;               // The list of fibers blocked on this semaphore, in the order they arrived.
+
+    public:
+
+    /**
+      * Constructor. Create a new FiberSemaphore.
+      *
+      * @param initial The number of units initially available.
+      *
+      * @param max The maximum number of units that may be available. Calls to notify() with no fibers
+      *            waiting do not increase the count beyond this value.
+      */
+    FiberSemaphore(int initial = 0, int max = 1);
+
+    /**
+      * Acquires a unit from this semaphore, blocking the calling fiber until one is available.
+      *
+      * @return MICROBIT_OK once a unit has been acquired, MICROBIT_CANCELLED if the wait was ended through
+      *         notifyAll(), or MICROBIT_NOT_SUPPORTED if the calling context cannot block (i.e. the scheduler is not
+      *         running, or this is an interrupt context) and no unit is available.
+      */
+    int wait();
+
+    /**
+      * Acquires a unit from this semaphore, if one is available. Never blocks.
+      *
+      * @return MICROBIT_OK if a unit was acquired, MICROBIT_BUSY otherwise.
+      */
+    int tryWait();
+
+    /**
+      * Releases a unit to this semaphore.
+      *
+      * If any fibers are waiting, the longest waiting fiber of the highest priority is handed the unit and made runnable.
+      * Otherwise, the number of available units is increased, up to the maximum given at construction.
+      */
+    void notify();
+
+    /**
+      * Wakes all fibers waiting on this semaphore, without handing them a unit.
+      *
+      * Each woken fiber returns MICROBIT_CANCELLED from wait().
+      */
+    void notifyAll();
+
+    /**
+      * Determines the number of units currently available.
+      *
+      * @return the number of units available.
+      */
+    int getCount();
+
+    /**
+      * Determines the number of fibers currently blocked on this semaphore.
+      *
+      * @return the number of waiting fibers.
+      */
+    int getWaitCount();
+};
+
+/**
+  * A mutual exclusion lock that is integrated with the fiber scheduler.
+  *
+  * A binary FiberSemaphore that starts unlocked. wait() acquires the lock and notify() releases it,
+  * handing it to the next waiting fiber, if there is one.
+  */
+class FiberLock : public FiberSemaphore
+{
+    public:
+
+    /**
+      * Constructor. Create a new, unlocked FiberLock.
+      */
+    FiberLock();
+
+    /**
+      * Determines if this lock is currently held.
+      *
+      * @return 1 if the lock is held, 0 otherwise.
+      */
+    int isLocked();
+};
+
 /**
   * Determines if the processor is executing in interrupt context.
   *
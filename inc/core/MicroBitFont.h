@@ -33,6 +33,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_FONT_HEIGHT 5
 #define MICROBIT_FONT_ASCII_START 32
 #define MICROBIT_FONT_ASCII_END 126
+#define MICROBIT_FONT_ROW_PATTERNS (1 << MICROBIT_FONT_WIDTH)
 
 /**
   * Class definition for a MicrobitFont
@@ -61,6 +62,10 @@ class MicroBitFont
     static const unsigned char* defaultFont;
     static MicroBitFont systemFont;
 
+    // Every possible row of a glyph, pre-expanded to one brightness value (0 or 255) per pixel.
+    // Indexed by the low MICROBIT_FONT_WIDTH bits of a row of font data, so rows can be copied rather than decoded.
+    static const uint8_t rowPixels[MICROBIT_FONT_ROW_PATTERNS][MICROBIT_FONT_WIDTH];
+
     const unsigned char* characters;
 
     int asciiEnd;
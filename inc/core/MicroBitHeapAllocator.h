@@ -45,7 +45,7 @@ DEALINGS IN THE SOFTWARE.
   * @note The need for this should be reviewed in the future, if a different memory allocator is
   * made availiable in the mbed platform.
   *
-  * TODO: Consider caching recently freed blocks to improve allocation time.
+  * Allocation uses a next fit policy by default, and caches recently freed blocks to improve allocation time.
   */
 
 #ifndef MICROBIT_HEAP_ALLOCTOR_H
@@ -58,12 +58,25 @@ DEALINGS IN THE SOFTWARE.
 
 // Flag to indicate that a given block is FREE/USED (top bit of a CPU word)
 #define MICROBIT_HEAP_BLOCK_FREE		0x80000000
+
+// Flag to indicate that a given USED block is held on a size class free list (second bit of a CPU word)
+#define MICROBIT_HEAP_BLOCK_CACHED		0x40000000
 #define MICROBIT_HEAP_BLOCK_SIZE        4
 
 struct HeapDefinition
 {
     uint32_t *heap_start;		// Physical address of the start of this heap.
     uint32_t *heap_end;		    // Physical address of the end of this heap.
+    uint32_t used;              // The number of blocks currently allocated, including index blocks.
+    uint32_t peak;              // The greatest value of used since the heap was created.
+    uint32_t allocations;       // The number of allocations currently live.
+    uint32_t generation;        // Incremented whenever the layout of blocks changes, so an interrupted search can detect it.
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+    uint32_t *rover;            // The block at which to start the next search.
+    uint32_t *hint[MICROBIT_HEAP_HINT_CACHE_SIZE];  // Recently freed blocks, or NULL.
+    uint8_t  hint_next;         // The next entry in hint to replace.
+#endif
 };
 
 /**
@@ -82,7 +95,81 @@ struct HeapDefinition
   * code, and user code targetting the runtime. External code can choose to include this file, or
   * simply use the standard heap.
   */
+/**
+  * A snapshot of the usage of a heap region.
+  */
+struct MicroBitHeapStatistics
+{
+    uint32_t total_bytes;       // The size of the heap.
+    uint32_t used_bytes;        // The memory currently allocated, including allocator overheads and blocks held by size class free lists.
+    uint32_t free_bytes;        // The memory currently available for allocation.
+    uint32_t peak_used_bytes;   // The greatest value of used_bytes since the heap was created.
+    uint32_t cached_bytes;      // The memory held by size class free lists, ready for reuse.
+    uint32_t largest_free;      // The largest single allocation that could currently be satisfied, in bytes.
+    uint32_t used_blocks;       // The number of allocations currently live.
+    uint32_t free_blocks;       // The number of separate regions of free memory. Adjacent free regions that are yet to be merged are counted separately.
+    uint32_t failures;          // The number of allocations that could not be satisfied by any heap, since start up.
+};
+
+/**
+  * The heap usage attributed to a single call site, when MICROBIT_HEAP_PROFILE is enabled.
+  */
+struct MicroBitHeapProfileEntry
+{
+    uint32_t site;              // The return address of the call to malloc() or new, or 0 for allocations from untracked call sites.
+    uint32_t live_count;        // The number of allocations currently live.
+    uint32_t live_bytes;        // The memory currently held by those allocations, including allocator overheads.
+    uint32_t peak_bytes;        // The greatest value of live_bytes seen.
+    uint32_t total_count;       // The number of allocations made since start up.
+};
+
+class MicroBitSerial;
+
 int microbit_create_heap(uint32_t start, uint32_t end);
 void microbit_heap_print();
 
+/**
+  * Determines the number of heap regions in use.
+  *
+  * @return The number of heaps created with microbit_create_heap().
+  */
+int microbit_heap_count();
+
+/**
+  * Provides a snapshot of the usage of a given heap region.
+  *
+  * Usage totals are maintained as memory is allocated and freed. The largest free block and
+  * block counts are determined by walking the heap on each call, so this should not be called
+  * at high rate.
+  *
+  * @param index The heap to inspect, in the order that heaps were created (0 is the first).
+  *
+  * @param stats Populated with the usage of the heap.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no heap with the given index,
+  *         or MICROBIT_NOT_SUPPORTED if the micro:bit heap allocator is disabled.
+  */
+int microbit_heap_get_statistics(int index, MicroBitHeapStatistics &stats);
+
+/**
+  * Provides the heap usage attributed to a given call site. Call sites are numbered in the order that they
+  * first allocated memory.
+  *
+  * @param index The call site to inspect, from 0.
+  *
+  * @param entry Populated with the usage attributed to the call site.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no call site with the given index,
+  *         or MICROBIT_NOT_SUPPORTED if MICROBIT_HEAP_PROFILE or the micro:bit heap allocator is disabled.
+  */
+int microbit_heap_profile_get(int index, MicroBitHeapProfileEntry &entry);
+
+/**
+  * Writes the heap usage attributed to each call site to the given serial port, one line per call site.
+  * Call site addresses can be resolved to functions using the map file or addr2line.
+  *
+  * @param serial The serial port to write to.
+  */
+void microbit_heap_profile_print(MicroBitSerial &serial);
+
 #endif
@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_LISTENER_H
 
 #include "mbed.h"
+#include <new>
 #include "MicroBitConfig.h"
 #include "MicroBitEvent.h"
 #include "MemberFunctionCallback.h"
@@ -41,10 +42,27 @@ DEALINGS IN THE SOFTWARE.
 #define MESSAGE_BUS_LISTENER_DROP_IF_BUSY           0x0020
 #define MESSAGE_BUS_LISTENER_NONBLOCKING            0x0040
 #define MESSAGE_BUS_LISTENER_URGENT                 0x0080
+#define MESSAGE_BUS_LISTENER_COALESCE               0x0100
+#define MESSAGE_BUS_LISTENER_BATCH                  0x0200
+#define MESSAGE_BUS_LISTENER_PRIORITY               0x0400
 #define MESSAGE_BUS_LISTENER_DELETING               0x8000
 
 #define MESSAGE_BUS_LISTENER_IMMEDIATE              (MESSAGE_BUS_LISTENER_NONBLOCKING |  MESSAGE_BUS_LISTENER_URGENT)
 
+// n.b. Listeners flagged as MESSAGE_BUS_LISTENER_COALESCE accept that repeated events with the same ID and value, raised
+// whilst an earlier one is still waiting to be processed, are collapsed into that earlier event (taking the latest timestamp).
+// The message bus only coalesces an event if every listener that would receive it is flagged in this way.
+
+// n.b. Listeners flagged as MESSAGE_BUS_LISTENER_BATCH hold matching events in their queue, and receive them as an array
+// in a single call from the message bus idle loop. The flag is set automatically when a batch handler is registered.
+
+// n.b. Listeners flagged as MESSAGE_BUS_LISTENER_PRIORITY cause matching events to be held in the message bus priority queue,
+// and so delivered ahead of other waiting events, when MESSAGE_BUS_PRIORITY_LANE is enabled. The flag has no effect otherwise.
+
+// n.b. Listeners flagged as MESSAGE_BUS_LISTENER_NONBLOCKING are dispatched by a direct function call, rather than via invoke().
+// This avoids the cost of saving register context and preparing a fork on block fiber for every event, but
+// such handlers MUST NOT block (e.g. call fiber_sleep() or fiber_wait_for_event()), as they run in the context of the message bus.
+
 /**
   *	This structure defines a MicroBitListener used to invoke functions, or member
   * functions if an instance of EventModel receives an event whose id and value
@@ -60,13 +78,23 @@ struct MicroBitListener
     {
         void (*cb)(MicroBitEvent);
         void (*cb_param)(MicroBitEvent, void *);
-        MemberFunctionCallback *cb_method;
+        void (*cb_batch)(MicroBitEvent *, int);
+        uint32_t cb_method_storage[(sizeof(MemberFunctionCallback) + 3) / 4];  // A MemberFunctionCallback, constructed in place rather than on the heap.
     };
 
 	void*			cb_arg;			// Optional argument to be passed to the caller.
 
 	MicroBitEvent 	            evt;
-	MicroBitEventQueueItem 	    *evt_queue;
+	MicroBitEvent 	            *evt_queue;         // Ring of events waiting for this listener, allocated on first use.
+	uint8_t                     evt_queue_head;     // Index of the oldest event in the ring.
+	uint8_t                     evt_queue_length;   // The number of events in the ring.
+	uint8_t                     evt_queue_depth;    // The capacity of the ring.
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+	uint32_t                    dispatched;         // The number of events delivered to this listener's handler.
+	uint32_t                    dropped;            // The number of events dropped because this listener was busy, or its queue was full.
+	uint32_t                    handler_time;       // The total time spent in this listener's handler (microseconds).
+#endif
 
 	MicroBitListener *next;
 
@@ -105,6 +133,22 @@ struct MicroBitListener
 	  */
     MicroBitListener(uint16_t id, uint16_t value, void (*handler)(MicroBitEvent, void *), void* arg, uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS);
 
+	/**
+	  * Constructor.
+	  *
+	  * Create a new Message Bus Listener, that receives events in batches.
+	  *
+	  * @param id The ID of the component you want to listen to.
+	  *
+	  * @param value The event value you would like to listen to from that component
+	  *
+	  * @param handler A function pointer to call with each batch of events, and the number of events in the batch.
+	  *
+	  * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+      * to be tuned.
+	  */
+    MicroBitListener(uint16_t id, uint16_t value, void (*handler)(MicroBitEvent *, int), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS);
+
 
 	/**
 	  * Constructor.
@@ -125,6 +169,16 @@ struct MicroBitListener
     template <typename T>
     MicroBitListener(uint16_t id, uint16_t value, T* object, void (T::*method)(MicroBitEvent), uint16_t flags = EVENT_LISTENER_DEFAULT_FLAGS);
 
+    /**
+      * Provides the member function callback held by this listener.
+      *
+      * @return The callback, held inline within this listener. Only valid if the listener is flagged MESSAGE_BUS_LISTENER_METHOD.
+      */
+    inline MemberFunctionCallback *cb_method()
+    {
+        return (MemberFunctionCallback *) cb_method_storage;
+    }
+
     /**
       * Destructor. Ensures all resources used by this listener are freed.
       */
@@ -136,6 +190,51 @@ struct MicroBitListener
       * @param e The event to queue
       */
     void queue(MicroBitEvent e);
+
+    /**
+      * Removes the oldest event from the queue of events waiting to be processed.
+      *
+      * @param e Updated with the event removed.
+      *
+      * @return 1 if an event was removed, 0 if the queue is empty.
+      */
+    int dequeue(MicroBitEvent &e);
+
+    /**
+      * Provides the oldest events waiting to be processed, as a contiguous array.
+      * The events remain in the queue until released with discard().
+      *
+      * @param events Updated to point to the oldest event in the queue.
+      *
+      * @return The number of contiguous events available, or 0 if the queue is empty. This may be fewer
+      *         than the number of events waiting, if the queue wraps around.
+      */
+    int peek(MicroBitEvent *&events);
+
+    /**
+      * Removes the given number of events from the front of the queue.
+      *
+      * @param count The number of events to remove, as returned by peek().
+      */
+    void discard(int count);
+
+    /**
+      * Sets the maximum number of events that may wait for this listener, when it is flagged
+      * MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY. Further events are dropped.
+      *
+      * @param depth The new depth of the queue, in the range 1..255.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the depth is out of range, or
+      *         MICROBIT_BUSY if events are currently waiting in the queue.
+      */
+    int setQueueDepth(int depth);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    /**
+      * Resets the statistics recorded for this listener.
+      */
+    void resetStatistics();
+#endif
 };
 
 /**
@@ -159,11 +258,18 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, T* object, void
 {
 	this->id = id;
 	this->value = value;
-    this->cb_method = new MemberFunctionCallback(object, method);
+    new (cb_method_storage) MemberFunctionCallback(object, method);
 	this->cb_arg = NULL;
     this->flags = flags | MESSAGE_BUS_LISTENER_METHOD;
     this->evt_queue = NULL;
+    this->evt_queue_head = 0;
+    this->evt_queue_length = 0;
+    this->evt_queue_depth = MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH;
 	this->next = NULL;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    resetStatistics();
+#endif
 }
 
 #endif
@@ -0,0 +1,133 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_MEMORY_POOL_H
+#define MICROBIT_MEMORY_POOL_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Class definition for a MicroBitMemoryPool.
+  *
+  * A memory pool holds a fixed number of equally sized blocks of memory, which can be allocated and
+  * released in constant time, with interrupts disabled only briefly. This makes it suitable for objects that are
+  * created and destroyed at a high rate, or from interrupt context, such as radio packets,
+  * without churning the shared heap.
+  *
+  * The memory for the pool is reserved from the heap in a single allocation the first time allocate()
+  * is called, so pools that are never used cost almost nothing.
+  *
+  * Every pool registers itself on creation, so that memory can be returned to the pool it came from
+  * with microbit_pool_release(), without the caller needing to know which pool that is.
+  */
+class MicroBitMemoryPool
+{
+    uint8_t                 *memory;        // The storage for the pool's blocks, or NULL if not yet reserved.
+    void                    *freeList;      // Chain of free blocks, linked through their first word.
+    uint16_t                blockSize;      // The size of each block, in bytes (a whole number of words).
+    uint16_t                count;          // The number of blocks in the pool.
+    uint16_t                available;      // The number of blocks currently free.
+
+    public:
+
+    MicroBitMemoryPool      *next;          // Chain of all registered pools.
+
+    /**
+      * Constructor.
+      *
+      * Create a new memory pool, and register it for use by microbit_pool_release().
+      *
+      * @param blockSize The size of each block, in bytes.
+      *
+      * @param count The number of blocks in the pool.
+      */
+    MicroBitMemoryPool(int blockSize, int count);
+
+    /**
+      * Destructor.
+      *
+      * Deregisters the pool, and releases its memory back to the heap. Any blocks allocated from the pool are no longer valid.
+      */
+    ~MicroBitMemoryPool();
+
+    /**
+      * Allocates a block from the pool. This is safe to call from interrupt context once the pool's memory
+      * has been reserved (i.e. after the first call).
+      *
+      * @return A pointer to the block, or NULL if the pool is exhausted or its memory could not be reserved.
+      */
+    void *allocate();
+
+    /**
+      * Returns a block to the pool.
+      *
+      * @param block The block to release.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the block was not allocated from this pool.
+      */
+    int release(void *block);
+
+    /**
+      * Determines if the given memory was allocated from this pool.
+      *
+      * @param block The memory to test.
+      *
+      * @return true if the memory lies within this pool, false otherwise.
+      */
+    bool contains(void *block);
+
+    /**
+      * Determines the size of the blocks in this pool.
+      *
+      * @return The size of each block, in bytes.
+      */
+    int getBlockSize();
+
+    /**
+      * Determines how many blocks remain available in this pool.
+      *
+      * @return The number of free blocks.
+      */
+    int getFree();
+};
+
+/**
+  * Returns the given memory to the registered pool that it was allocated from.
+  *
+  * @param block The memory to release.
+  *
+  * @return 1 if the memory was returned to a pool, 0 if it was not allocated from any pool (and should be freed as normal).
+  */
+int microbit_pool_release(void *block);
+
+/**
+  * Releases the given memory, either to the registered pool that it was allocated from, or to the heap.
+  *
+  * @param block The memory to release.
+  */
+void microbit_pool_free(void *block);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Energy accounting for the micro:bit runtime.
+  *
+  * Components report when they become active or inactive in a power domain, and the time spent active in each
+  * domain is accumulated, so the drain of each part of the system can be attributed. Times are taken from the
+  * system timer, so are only as accurate as its resolution.
+  *
+  * The reporting functions compile to nothing unless MICROBIT_POWER_PROFILING is enabled.
+  */
+
+#ifndef MICROBIT_POWER_PROFILE_H
+#define MICROBIT_POWER_PROFILE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitSerial.h"
+
+// The built in power domains.
+#define MICROBIT_POWER_DOMAIN_SLEEP         0       // The processor is asleep, waiting for an event in idle().
+#define MICROBIT_POWER_DOMAIN_RADIO         1       // The radio is enabled, and its transceiver running.
+#define MICROBIT_POWER_DOMAIN_DISPLAY       2       // LED on time, summed over every LED lit (microseconds per LED).
+#define MICROBIT_POWER_DOMAIN_I2C           3       // A transfer is in progress on the I2C bus.
+#define MICROBIT_POWER_DOMAIN_THERMOMETER   4       // A temperature conversion is in progress.
+#define MICROBIT_POWER_DOMAIN_USER          5       // The first domain free for application use.
+
+/**
+  * The accumulated activity of a single power domain.
+  */
+struct MicroBitPowerProfile
+{
+    uint64_t active_us;                 // The total time the domain has been active since the last reset (microseconds).
+    uint32_t transitions;               // The number of times the domain has become active since the last reset.
+    uint32_t active;                    // Non-zero if the domain is currently active.
+};
+
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+/**
+  * Records that a power domain has become active or inactive. Repeated reports of the same state are ignored.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param active true if the domain has become active, false if it has become inactive.
+  */
+void power_profile_set_active(int domain, bool active);
+
+/**
+  * Adds time to a power domain directly, for activity that is known only as a duration.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param us The time to add (microseconds).
+  */
+void power_profile_add_time(int domain, uint32_t us);
+
+#define POWER_PROFILE_ACTIVE(domain, active)    power_profile_set_active(domain, active)
+#define POWER_PROFILE_ADD_TIME(domain, us)      power_profile_add_time(domain, us)
+#else
+#define POWER_PROFILE_ACTIVE(domain, active)
+#define POWER_PROFILE_ADD_TIME(domain, us)
+#endif
+
+/**
+  * Reads the activity of a power domain, including any time in its current active period.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param profile Populated with the activity of the domain.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if domain is out of range, or
+  *         MICROBIT_NOT_SUPPORTED if MICROBIT_POWER_PROFILING is disabled.
+  */
+int power_profile_get(int domain, MicroBitPowerProfile &profile);
+
+/**
+  * Determines the time over which activity has been accumulated.
+  *
+  * @return The time since power_profile_reset() was last called, or since power on (microseconds).
+  */
+uint64_t power_profile_get_elapsed_us();
+
+/**
+  * Clears the accumulated activity of every power domain. Domains that are active remain so.
+  */
+void power_profile_reset();
+
+/**
+  * Writes the activity of every power domain to the given serial port, one line per domain, giving the
+  * active time and its share of the elapsed time in tenths of a percent.
+  *
+  * @param serial The serial port to write to.
+  */
+void power_profile_print(MicroBitSerial &serial);
+
+#endif
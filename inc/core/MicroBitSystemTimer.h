@@ -42,6 +42,65 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
 
+// The number of buckets in a system tick profile histogram. Bucket n counts samples of 2^(n-1) to (2^n)-1 microseconds,
+// with the final bucket also holding any longer samples.
+#define MICROBIT_SYSTEM_TICK_PROFILE_BUCKETS    12
+
+/**
+  * The time taken by one component's systemTick() callbacks, as recorded when MICROBIT_SYSTEM_TICK_PROFILING is enabled.
+  *
+  * n.b. Timings are taken from the microsecond ticker, which is driven by the 32.768kHz RTC on the nRF51,
+  * so individual samples have a resolution of around 30us. Totals over many calls are still meaningful.
+  */
+struct MicroBitSystemTickProfile
+{
+    MicroBitComponent   *component;     // The component profiled.
+    uint32_t            calls;          // The number of systemTick() callbacks made.
+    uint32_t            total_us;       // The total time spent in those callbacks (microseconds).
+    uint32_t            max_us;         // The longest callback (microseconds).
+    uint32_t            buckets[MICROBIT_SYSTEM_TICK_PROFILE_BUCKETS];  // Histogram of callback times, in power of two buckets.
+};
+
+/**
+  * The deviation of system ticks from their nominal period, as recorded when MICROBIT_SYSTEM_TICK_PROFILING is enabled.
+  */
+struct MicroBitSystemTickJitter
+{
+    uint32_t            ticks;          // The number of tick intervals measured.
+    uint32_t            max_late_us;    // The furthest a tick has run after it was due (microseconds).
+    uint32_t            max_early_us;   // The furthest a tick has run before it was due (microseconds).
+    uint32_t            max_tick_us;    // The longest time spent in a whole system tick (microseconds).
+    uint32_t            buckets[MICROBIT_SYSTEM_TICK_PROFILE_BUCKETS];  // Histogram of absolute deviations, in power of two buckets.
+};
+
+/**
+  * A one shot callback, scheduled with system_timer_event_after_us().
+  *
+  * Events are owned by the caller, so scheduling one never allocates memory. All pending events are held in a
+  * single queue, sorted by deadline, which drives one mbed Timeout. This avoids the RAM overhead of a Timeout per
+  * component, and costs one interrupt per event.
+  */
+struct SystemTimerEvent
+{
+    SystemTimerEvent    *next;          // The next event in the queue.
+    uint32_t            deadline;       // The time the event is due, in microseconds (as given by us_ticker_read()).
+    void                (*callback)(void *);
+    void                *context;       // The value passed to the callback.
+};
+
+/**
+  * Adapts a member function for use as a SystemTimerEvent callback, with the object as the event context.
+  *
+  * @code
+  * system_timer_event_after_us(&event, 100, system_timer_method_callback<MyComponent, &MyComponent::timeout>, this);
+  * @endcode
+  */
+template <typename T, void (T::*method)()>
+void system_timer_method_callback(void *object)
+{
+    (((T *) object)->*method)();
+}
+
 /**
   * Initialises a system wide timer, used to drive the various components used in the runtime.
   *
@@ -101,11 +160,17 @@ void system_timer_tick();
 
 /**
   * Add a component to the array of system components. This component will then receive
-  * periodic callbacks, once every tick period in interrupt context.
+  * periodic callbacks, once every divisor tick periods in interrupt context.
+  *
+  * The array grows as necessary, so is not limited to MICROBIT_SYSTEM_COMPONENTS entries.
+  * If the component has already been added, its divisor is updated.
   *
   * @param component The component to add.
   *
-  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the component array is full.
+  * @param divisor The number of tick periods between each callback. Defaults to 1 (every tick).
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if divisor is out of range,
+  *         or MICROBIT_NO_RESOURCES if the component array could not be grown.
   *
   * @code
   * // heap allocated - otherwise it will be paged out!
@@ -114,7 +179,7 @@ void system_timer_tick();
   * system_timer_add_component(display);
   * @endcode
   */
-int system_timer_add_component(MicroBitComponent *component);
+int system_timer_add_component(MicroBitComponent *component, int divisor = 1);
 
 /**
   * Remove a component from the array of system components. This component will no longer receive
@@ -135,6 +200,77 @@ int system_timer_add_component(MicroBitComponent *component);
   */
 int system_timer_remove_component(MicroBitComponent *component);
 
+/**
+  * Records the longest system tick period a component can tolerate. When the system tick governor is enabled
+  * (MICROBIT_SYSTEM_TICK_GOVERNOR), the tick period is the shortest of these requirements, or SYSTEM_TICK_MAX_PERIOD_MS
+  * if there are none, shortened as necessary to wake sleeping fibers on time.
+  *
+  * @param component The component, which must already have been added with system_timer_add_component().
+  *
+  * @param period The longest acceptable period between ticks in milliseconds, or 0 if the component has no requirement.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the component has not been added or period is out of range.
+  */
+int system_timer_set_requirement(MicroBitComponent *component, int period);
+
+/**
+  * Re-evaluates the system tick period chosen by the governor, e.g. after a fiber has started sleeping
+  * with a deadline earlier than the next tick. Has no effect unless MICROBIT_SYSTEM_TICK_GOVERNOR is enabled.
+  */
+void system_timer_governor_update();
+
+/**
+  * Schedules a one shot callback, the given number of microseconds from now. The callback is made in interrupt context.
+  *
+  * If the event is already pending, it is rescheduled.
+  *
+  * @param event The event to schedule. This must remain valid until the callback is made, or the event is cancelled.
+  *
+  * @param period The time until the callback is due, in microseconds.
+  *
+  * @param callback The function to call.
+  *
+  * @param context The value to pass to the callback.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if event or callback is NULL.
+  */
+int system_timer_event_after_us(SystemTimerEvent *event, uint32_t period, void (*callback)(void *), void *context);
+
+/**
+  * Cancels a one shot callback previously scheduled with system_timer_event_after_us().
+  *
+  * @param event The event to cancel.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the event is not pending.
+  */
+int system_timer_cancel_event(SystemTimerEvent *event);
+
+/**
+  * Retrieves the profile of a component registered for system tick callbacks.
+  *
+  * @param index The index of the component, from 0 upwards, in the order the components are called.
+  *
+  * @param profile The structure to fill in.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no component at that index,
+  *         or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TICK_PROFILING is disabled.
+  */
+int system_timer_get_profile(int index, MicroBitSystemTickProfile &profile);
+
+/**
+  * Retrieves the recorded deviation of system ticks from their nominal period.
+  *
+  * @param jitter The structure to fill in.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TICK_PROFILING is disabled.
+  */
+int system_timer_get_jitter(MicroBitSystemTickJitter &jitter);
+
+/**
+  * Discards all system tick profiling data recorded so far.
+  */
+void system_timer_reset_profile();
+
 /**
   * A simple C/C++ wrapper to allow periodic callbacks to standard C functions transparently.
   */
@@ -32,12 +32,18 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 
-#define CREATE_KEY_VALUE_TABLE(NAME, PAIRS) const KeyValueTable NAME { PAIRS, sizeof(PAIRS) / sizeof(KeyValueTableEntry) };
+/**
+ * Defines a KeyValueTable called NAME over the constexpr array of KeyValueTableEntry PAIRS.
+ * The build fails if PAIRS is empty, or its keys are not in strictly ascending order.
+ */
+#define CREATE_KEY_VALUE_TABLE(NAME, PAIRS) \
+    static_assert(keyValueTableSorted(PAIRS, sizeof(PAIRS) / sizeof(KeyValueTableEntry)), #PAIRS " must be non-empty, with keys in ascending order"); \
+    constexpr KeyValueTable NAME { PAIRS, sizeof(PAIRS) / sizeof(KeyValueTableEntry) };
 
 /**
  * Provides a simple key/value pair lookup table with range lookup support.
- * Normally stored in FLASH to reduce RAM usage. Keys should be pre-sorted
- * in ascending order.
+ * Normally stored in FLASH to reduce RAM usage. Keys must be pre-sorted
+ * in ascending order, which CREATE_KEY_VALUE_TABLE checks at compile time.
  */
 
 struct KeyValueTableEntry
@@ -46,11 +52,27 @@ struct KeyValueTableEntry
     const uint32_t value;
 };
 
+/**
+ * Determines if the given entries are suitable for a KeyValueTable: at least one entry, with keys in strictly ascending order.
+ * Used at compile time by CREATE_KEY_VALUE_TABLE.
+ */
+constexpr bool keyValueTableSorted(const KeyValueTableEntry *data, int length)
+{
+    return length == 1 || (length > 1 && data[0].key < data[1].key && keyValueTableSorted(data + 1, length - 1));
+}
+
 struct KeyValueTable
 {
     const KeyValueTableEntry *data;
     const int length;
 
+    /**
+     * Finds the entry with the smallest key no less than that given, or the entry with the largest key if there is none.
+     *
+     * @param key the key to look up.
+     *
+     * @return the matching entry.
+     */
     KeyValueTableEntry* find(const uint32_t key) const;
     uint32_t get(const uint32_t key) const;
     uint32_t getKey(const uint32_t key) const;
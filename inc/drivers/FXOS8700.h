@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "MicroBitPin.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRegisterCache.h"
 #include "MicroBitAccelerometer.h"
 #include "MicroBitCompass.h"
 #include "CoordinateSystem.h"
@@ -164,6 +165,14 @@ DEALINGS IN THE SOFTWARE.
  */
 #define FXOS8700_WHOAMI_VAL      0xC7
 
+/**
+ * FXOS8700 FIFO control
+ */
+#define FXOS8700_F_MODE_CIRCULAR    0x40        // F_SETUP: keep the most recent samples.
+#define FXOS8700_F_CNT              0x3F        // F_STATUS: the number of unread samples.
+#define FXOS8700_INT_DRDY           0x01        // CTRL_REG4/5: data ready interrupt.
+#define FXOS8700_INT_FIFO           0x40        // CTRL_REG4/5: FIFO watermark interrupt.
+
 /**
   * Term to convert sample data into SI units. 
   */
@@ -178,6 +187,7 @@ class FXOS8700 : public MicroBitAccelerometer, public MicroBitCompass
     MicroBitI2C&            i2c;                    // The I2C interface to use.
     MicroBitPin             int1;                   // Data ready interrupt.
     uint16_t                address;                // I2C address of this accelerometer.
+    MicroBitRegisterCache   registers;              // Shadowed access to the registers of this accelerometer.
 
     public:
 
@@ -202,6 +212,13 @@ class FXOS8700 : public MicroBitAccelerometer, public MicroBitCompass
      */
     int configure();
 
+    /**
+     * Places the device into standby, until configure() is next called.
+     *
+     * @return DEVICE_OK on success, DEVICE_I2C_ERROR if the device could not be configured.
+     */
+    virtual int standby();
+
     /**
      * Reads the acceleration data from the accelerometer, and stores it in our buffer.
      * This only happens if the accelerometer indicates that it has new data via int1.
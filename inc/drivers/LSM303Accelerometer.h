@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CoordinateSystem.h"
 #include "MicroBitAccelerometer.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRegisterCache.h"
 #include "MicroBitUtil.h"
 
 /**
@@ -85,6 +86,16 @@ DEALINGS IN THE SOFTWARE.
   */
 #define LSM303_A_WHOAMI_VAL             0x33
 
+/**
+  * LSM303_A FIFO control
+  */
+#define LSM303_A_FIFO_EN                0x40        // CTRL_REG5_A: enable the FIFO.
+#define LSM303_A_FIFO_MODE_STREAM       0x80        // FIFO_CTRL_REG_A: keep the most recent samples.
+#define LSM303_A_FIFO_OVRN              0x40        // FIFO_SRC_REG_A: the FIFO is full.
+#define LSM303_A_FIFO_FSS               0x1F        // FIFO_SRC_REG_A: the number of unread samples.
+#define LSM303_A_INT1_DRDY1             0x10        // CTRL_REG3_A: data ready interrupt on INT1.
+#define LSM303_A_INT1_WTM               0x04        // CTRL_REG3_A: FIFO watermark interrupt on INT1.
+
 /**
  * Class definition for LSM303Accelerometer.
  * This class provides a simple wrapper between the hybrid FXOS8700 accelerometer and higher level accelerometer funcitonality.
@@ -94,6 +105,7 @@ class LSM303Accelerometer : public MicroBitAccelerometer
     MicroBitI2C&            i2c;                    // The I2C interface to use.
     MicroBitPin             int1;                   // Data ready interrupt.
     uint16_t                address;                // I2C address of this accelerometer.
+    MicroBitRegisterCache   registers;              // Shadowed access to the registers of this accelerometer.
 
     public:
 
@@ -120,6 +132,13 @@ class LSM303Accelerometer : public MicroBitAccelerometer
      */
     virtual int configure();
 
+    /**
+     * Places the accelerometer into standby, until configure() is next called.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured.
+     */
+    virtual int standby();
+
     /**
      * Poll to see if new data is available from the hardware. If so, update it.
      * n.b. it is not necessary to explicitly call this funciton to update data
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CoordinateSystem.h"
 #include "MicroBitCompass.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRegisterCache.h"
 #include "MicroBitUtil.h"
 
 /**
@@ -73,6 +74,11 @@ DEALINGS IN THE SOFTWARE.
 #define LSM303_OUTZ_L_REG_M				0x6C
 #define LSM303_OUTZ_H_REG_M				0x6D
 
+//
+// CFG_REG_A_M mode bits
+//
+#define LSM303_M_MODE_IDLE				0x03
+
 
 
 /**
@@ -86,6 +92,7 @@ class LSM303Magnetometer : public MicroBitCompass
     MicroBitI2C&            i2c;                    // The I2C interface to use.
     MicroBitPin             int1;                   // Data ready interrupt.
     uint16_t                address;                // I2C address of this compass.
+    MicroBitRegisterCache   registers;              // Shadowed access to the registers of this compass.
 
     public:
 
@@ -109,6 +116,13 @@ class LSM303Magnetometer : public MicroBitCompass
      */
     virtual int configure();
 
+    /**
+     * Places the compass into standby, until configure() is next called.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured.
+     */
+    virtual int standby();
+
     /**
      * Poll to see if new data is available from the hardware. If so, update it.
      * n.b. it is not necessary to explicitly call this function to update data
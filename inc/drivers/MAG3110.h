@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CoordinateSystem.h"
 #include "MicroBitCompass.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRegisterCache.h"
 #include "MicroBitUtil.h"
 
 /**
@@ -82,6 +83,7 @@ class MAG3110 : public MicroBitCompass
     MicroBitI2C&            i2c;                    // The I2C interface to use.
     MicroBitPin             int1;                   // Data ready interrupt.
     uint16_t                address;                // I2C address of this compass.
+    MicroBitRegisterCache   registers;              // Shadowed access to the registers of this compass.
 
     public:
 
@@ -105,6 +107,13 @@ class MAG3110 : public MicroBitCompass
      */
     virtual int configure();
 
+    /**
+     * Places the compass into standby, until configure() is next called.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured.
+     */
+    virtual int standby();
+
     /**
      * Poll to see if new data is available from the hardware. If so, update it.
      * n.b. it is not necessary to explicitly call this function to update data
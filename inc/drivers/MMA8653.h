@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "CoordinateSystem.h"
 #include "MicroBitAccelerometer.h"
 #include "MicroBitI2C.h"
+#include "MicroBitRegisterCache.h"
 #include "MicroBitUtil.h"
 
 /**
@@ -70,6 +71,7 @@ class MMA8653 : public MicroBitAccelerometer
     MicroBitI2C&            i2c;                    // The I2C interface to use.
     MicroBitPin             int1;                   // Data ready interrupt.
     uint16_t                address;                // I2C address of this accelerometer.
+    MicroBitRegisterCache   registers;              // Shadowed access to the registers of this accelerometer.
 
     public:
 
@@ -96,6 +98,13 @@ class MMA8653 : public MicroBitAccelerometer
      */
     virtual int configure();
 
+    /**
+     * Places the accelerometer into standby, until configure() is next called.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured.
+     */
+    virtual int standby();
+
     /**
      * Poll to see if new data is available from the hardware. If so, update it.
      * n.b. it is not necessary to explicitly call this funciton to update data
@@ -30,12 +30,18 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitPin.h"
 #include "CoordinateSystem.h"
 #include "MicroBitI2C.h"
+#include "MicroBitSampleStream.h"
+#include "MicroBitSampleFilter.h"
+#include "MicroBitEvent.h"
+#include "MicroBitStorage.h"
 
 /**
  * Status flags
  */
 #define MICROBIT_ACCELEROMETER_IMU_DATA_VALID               0x02
 #define MICROBIT_ACCEL_ADDED_TO_IDLE                        0x04
+#define MICROBIT_ACCEL_GESTURE_TRACKING                     0x08
+#define MICROBIT_ACCEL_STANDBY                              0x10
 
 /**
  * Accelerometer events
@@ -79,6 +85,15 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_ACCELEROMETER_8G_THRESHOLD                 ((uint32_t)MICROBIT_ACCELEROMETER_8G_TOLERANCE * (uint32_t)MICROBIT_ACCELEROMETER_8G_TOLERANCE)
 #define MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD        4
 
+/**
+ * The accelerometer found by autoDetect(), as recorded in MicroBitStorage.
+ */
+#define MICROBIT_ACCELEROMETER_STORAGE_KEY                  "accelerometer"
+#define MICROBIT_ACCELEROMETER_NONE                         0
+#define MICROBIT_ACCELEROMETER_MMA8653                      1
+#define MICROBIT_ACCELEROMETER_LSM303                       2
+#define MICROBIT_ACCELEROMETER_FXOS8700                     3
+
 struct ShakeHistory
 {
     uint16_t    shaken:1,
@@ -115,6 +130,12 @@ class MicroBitAccelerometer : public MicroBitComponent
         uint16_t        lastGesture;        // the last, stable gesture recorded.
         uint16_t        currentGesture;     // the instantaneous, unfiltered gesture detected.
         ShakeHistory    shake;              // State information needed to detect shake events.
+        uint8_t         batchSize;          // The number of samples read from the hardware in each burst.
+        uint8_t         batchLength;        // The number of samples held in the batch buffer.
+        Sample3D        *batch;             // The samples read in the last burst, or NULL if samples are read one at a time.
+        MicroBitSampleStream stream;        // Every sample read, queued for the application if enabled.
+        MicroBitSampleFilter filter;        // Smooths the latest sample, if configured.
+        uint32_t        accessTime;         // The system time at which the accelerometer was last read, or found to be listened to.
 
     public:
 
@@ -139,6 +160,18 @@ class MicroBitAccelerometer : public MicroBitComponent
          */
         static MicroBitAccelerometer& autoDetect(MicroBitI2C &i2c); 
 
+        /**
+         * Device autodetection, remembering the device found.
+         *
+         * The device found on a previous boot is confirmed with a single WHO_AM_I read, and the
+         * bus is only scanned for every supported device if it does not respond.
+         *
+         * @param i2c the bus to scan.
+         * @param storage the storage used to record the device found.
+         *
+         */
+        static MicroBitAccelerometer& autoDetect(MicroBitI2C &i2c, MicroBitStorage &storage);
+
         /**
          * Attempts to set the sample rate of the accelerometer to the specified value (in ms).
          *
@@ -180,6 +213,105 @@ class MicroBitAccelerometer : public MicroBitComponent
          */
         virtual int getRange();
 
+        /**
+         * Attempts to set the number of samples read from the accelerometer in each burst.
+         *
+         * Where the hardware has a FIFO, it is filled to the given level before the samples are read
+         * together, and a single MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event is raised for the batch.
+         * This greatly reduces the I2C and event overhead at high sample rates. Gesture tracking
+         * still considers every sample.
+         *
+         * @param size The requested number of samples per burst, between 1 and MICROBIT_ACCELEROMETER_FIFO_SIZE.
+         *             A size of 1 reads each sample as it becomes available.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the size is out of range,
+         *         MICROBIT_NO_RESOURCES if the batch buffer could not be allocated, or MICROBIT_I2C_ERROR
+         *         if the request fails.
+         *
+         * @note Hardware without a FIFO always uses a batch size of 1.
+         */
+        int setBatchSize(int size);
+
+        /**
+         * Reads the currently configured number of samples read from the accelerometer in each burst.
+         *
+         * @return The batch size, in samples.
+         */
+        int getBatchSize();
+
+        /**
+         * Reads the samples retrieved in the last burst from the accelerometer, oldest first,
+         * in the coordinate system defined in the constructor.
+         *
+         * @param buffer The buffer to copy the samples into.
+         *
+         * @param length The maximum number of samples to copy.
+         *
+         * @return The number of samples copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL.
+         */
+        int getBatch(Sample3D *buffer, int length);
+
+        /**
+         * Enables a stream of every sample read from the accelerometer, to be read in bulk by an application fiber.
+         *
+         * Each sample is timestamped and queued as it is read, so no samples are lost between calls to readStream(),
+         * however often MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE events are processed.
+         *
+         * @param samples the number of samples to queue, or zero to disable the stream and free its storage.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+         *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+         */
+        int setStreamSize(int samples);
+
+        /**
+         * Removes up to length of the oldest samples from the stream, in the coordinate system defined in the constructor.
+         *
+         * @param samples the buffer to store the samples in.
+         *
+         * @param length the largest number of samples to remove.
+         *
+         * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+         *
+         * @note samples read from the hardware in a single burst share a timestamp.
+         */
+        int readStream(TimedSample3D *samples, int length);
+
+        /**
+         * Provides the stream of samples, for access to its fill level and overflow count.
+         *
+         * @return the sample stream of this accelerometer.
+         */
+        MicroBitSampleStream& getStream();
+
+        /**
+         * Smooths the samples read from the accelerometer, so that each read returns a filtered value without
+         * further bus traffic. The filter is updated incrementally as each sample arrives. Batches and streams
+         * still receive every unfiltered sample.
+         *
+         * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+         *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+         *
+         * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+         *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+         *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+         *
+         * @code
+         * // Report the median of the last 9 samples.
+         * accelerometer.setFilter(MICROBIT_FILTER_MEDIAN, 9);
+         * @endcode
+         */
+        int setFilter(int type, int length);
+
+        /**
+         * Determines the type of filter applied to the samples read, as set by setFilter().
+         *
+         * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+         */
+        int getFilter();
+
         /**
          * Configures the accelerometer for G range and sample rate defined
          * in this object. The nearest values are chosen to those defined
@@ -193,6 +325,19 @@ class MicroBitAccelerometer : public MicroBitComponent
          */
         virtual int configure();
 
+        /**
+         * Places the accelerometer into its lowest power mode, until configure() is next called.
+         *
+         * This is used to stop sampling while nothing is reading the accelerometer or listening for its events.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured,
+         *         or MICROBIT_NOT_SUPPORTED if the hardware has no such mode.
+         *
+         * @note This method should be overidden by the hardware driver to implement the requested
+         * changes in hardware.
+         */
+        virtual int standby();
+
         /**
          * Poll to see if new data is available from the hardware. If so, update it.
          * n.b. it is not necessary to explicitly call this funciton to update data
@@ -305,6 +450,9 @@ class MicroBitAccelerometer : public MicroBitComponent
         /**
          * Retrieves the last recorded gesture.
          *
+         * Gestures are only tracked while something is listening for MICROBIT_ID_GESTURE events, or once this
+         * has been called, so the first call may report a gesture that is out of date.
+         *
          * @return The last gesture that was detected.
          *
          * Example:
@@ -329,8 +477,61 @@ class MicroBitAccelerometer : public MicroBitComponent
          */
         ~MicroBitAccelerometer();
 
+    protected:
+
+        /**
+         * Stores the sample in sampleENU as the latest sample, appends it to the batch buffer and
+         * performs gesture tracking, without raising an event.
+         *
+         * Drivers reading a burst of samples call this for each sample, having reset batchLength,
+         * and then raise a single MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event.
+         */
+        void addSample();
+
+        /**
+         * Records that the accelerometer has been read through its API.
+         *
+         * If the accelerometer is in standby, it is reconfigured and this waits for one sample period,
+         * so that the caller receives a fresh sample.
+         */
+        void recordAccess();
+
+        /**
+         * Records that the accelerometer is in use, without reconfiguring the hardware. Used by operations
+         * that are about to call configure() themselves.
+         */
+        void wake();
+
+        /**
+         * Determines if the accelerometer should continue to be sampled, placing it into standby if it has not
+         * been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+         *
+         * Drivers call this from idleTick(), and skip the update if it returns 0.
+         *
+         * @return 1 if the accelerometer should be sampled, 0 if it is in standby.
+         */
+        int isSampling();
+
     private:
 
+        /**
+         * Scans the given I2C bus for supported accelerometer devices, starting with the one recorded in storage (if any),
+         * and constructs an appropriate driver.
+         *
+         * @param i2c the bus to scan.
+         * @param storage the storage used to record the device found, or NULL to scan every time.
+         */
+        static void detect(MicroBitI2C &i2c, MicroBitStorage *storage);
+
+        /**
+         * Brings the accelerometer out of standby when a listener is registered for its events,
+         * or for gesture events.
+         *
+         * @param evt The MICROBIT_ID_MESSAGE_BUS_LISTENER event raised by the message bus, carrying the ID listened to.
+         */
+        void onListenerRegistered(MicroBitEvent evt);
+
+
         /**
          * Recalculate roll and pitch values for the current sample.
          *
@@ -342,6 +543,8 @@ class MicroBitAccelerometer : public MicroBitComponent
         /**
          * Updates the basic gesture recognizer. This performs instantaneous pose recognition, and also some low pass filtering to promote
          * stability.
+         *
+         * Gesture tracking is skipped entirely while nothing is listening for MICROBIT_ID_GESTURE events, unless getGesture() has been called.
          */
         void updateGesture();
 
@@ -362,9 +565,11 @@ class MicroBitAccelerometer : public MicroBitComponent
          *
          * This makes no use of historic data, and forms this input to the filter implemented in updateGesture().
          *
+         * @param force the squared magnitude of the current sample, as given by instantaneousAccelerationSquared().
+         *
          * @return A 'best guess' of the current posture of the device, based on instanataneous data.
          */
-        uint16_t instantaneousPosture();
+        uint16_t instantaneousPosture(uint32_t force);
 };
 
 #endif
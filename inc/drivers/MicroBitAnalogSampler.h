@@ -0,0 +1,144 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_ANALOG_SAMPLER_H
+#define MICROBIT_ANALOG_SAMPLER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+
+// The most pins that can be sampled together.
+#define MICROBIT_ANALOG_SAMPLER_MAX_PINS        8
+
+// The shortest time between conversions, in microseconds. A 10 bit conversion takes 68us.
+#define MICROBIT_ANALOG_SAMPLER_MIN_PERIOD      80
+
+/**
+  * Events raised by MicroBitAnalogSampler
+  */
+#define MICROBIT_ANALOG_SAMPLER_EVT_DATA        1
+
+/**
+  * Class definition for MicroBitAnalogSampler.
+  *
+  * Samples one or more analog pins at a fixed rate, paced by a hardware timer which starts each conversion through PPI.
+  * Samples are written into a double buffer from the ADC interrupt, and MICROBIT_ANALOG_SAMPLER_EVT_DATA is raised
+  * each time one half is full, so that a consumer fiber can process it while the other half fills.
+  *
+  * The ADC is used exclusively while sampling, so pins must not be read through MicroBitPin::getAnalogValue(),
+  * and the display must not be in light sense mode.
+  */
+class MicroBitAnalogSampler : public MicroBitComponent
+{
+    uint16_t                *buffer;        // Both halves of the double buffer, one after the other.
+    uint16_t                length;         // The number of samples in each half.
+    uint16_t                position;       // The index of the next sample to be written.
+    uint8_t                 inputs[MICROBIT_ANALOG_SAMPLER_MAX_PINS];
+    uint8_t                 pinCount;
+    uint8_t                 channel;        // The index of the input currently being converted.
+    volatile int8_t         ready;          // The half last completed and not yet collected, or -1 if none.
+    uint32_t                overflows;
+
+    /**
+      * ADC interrupt handler. Stores each conversion, and moves the ADC on to the next input.
+      */
+    static void adcHandler();
+
+    public:
+
+    static MicroBitAnalogSampler *instance; // A singleton reference, used purely by the interrupt service routine.
+
+    /**
+      * Constructor.
+      *
+      * Create a software representation of the analog sampler, which is idle until started.
+      *
+      * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_ANALOG_SAMPLER.
+      */
+    MicroBitAnalogSampler(uint16_t id = MICROBIT_ID_ANALOG_SAMPLER);
+
+    /**
+      * Starts sampling the given pins.
+      *
+      * @param pins The pins to sample, which must be analog capable: MICROBIT_PIN_P0, P1, P2, P3, P4 or P10.
+      *
+      * @param pinCount The number of pins, up to MICROBIT_ANALOG_SAMPLER_MAX_PINS.
+      *
+      * @param frequency The number of times each pin is sampled per second.
+      *
+      * @param length The number of samples in each half of the buffer. When several pins are sampled, the samples are
+      *        interleaved, one from each pin in turn, so this should be a multiple of pinCount.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if a parameter is out of range or the conversions would be
+      *         closer together than MICROBIT_ANALOG_SAMPLER_MIN_PERIOD, MICROBIT_BUSY if another sampler is running,
+      *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+      *
+      * @code
+      * PinName pins[] = { MICROBIT_PIN_P0 };
+      * sampler.start(pins, 1, 8000, 256);
+      * @endcode
+      */
+    int start(const PinName *pins, int pinCount, int frequency, int length);
+
+    /**
+      * Stops sampling, and frees the buffer.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int stop();
+
+    /**
+      * Collects the half of the buffer completed most recently. The samples are 10 bit, in the range 0 - 1023.
+      *
+      * The samples remain valid until the sampler next fills this half, which is the time taken to fill the other half.
+      *
+      * @param samples Set to the first sample.
+      *
+      * @return the number of samples, or MICROBIT_NO_DATA if no half has completed since the last call.
+      *
+      * @code
+      * fiber_wait_for_event(MICROBIT_ID_ANALOG_SAMPLER, MICROBIT_ANALOG_SAMPLER_EVT_DATA);
+      *
+      * uint16_t *samples;
+      * int count = sampler.read(&samples);
+      * @endcode
+      */
+    int read(uint16_t **samples);
+
+    /**
+      * @return the number of halves completed while the previous one was still waiting to be collected.
+      */
+    uint32_t getOverflowCount();
+
+    /**
+      * Destructor.
+      *
+      * Stops sampling.
+      */
+    ~MicroBitAnalogSampler();
+};
+
+#endif
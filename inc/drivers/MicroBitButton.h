@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
 #include "MicroBitEvent.h"
+#include "MicroBitSystemTimer.h"
 
 #define MICROBIT_PIN_BUTTON_A                   P0_17
 #define MICROBIT_PIN_BUTTON_B                   P0_26
@@ -49,6 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_BUTTON_STATE_HOLD_TRIGGERED    2
 #define MICROBIT_BUTTON_STATE_CLICK             4
 #define MICROBIT_BUTTON_STATE_LONG_CLICK        8
+#define MICROBIT_BUTTON_STATE_SAMPLING          16
 
 #define MICROBIT_BUTTON_SIGMA_MIN               0
 #define MICROBIT_BUTTON_SIGMA_MAX               12
@@ -71,12 +73,24 @@ enum MicroBitButtonEventConfiguration
 class MicroBitButton : public MicroBitComponent
 {
     PinName name;                                           // mbed pin name for this button.
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+    InterruptIn pin;                                        // The mbed object looking after this pin, which wakes us on each edge.
+    SystemTimerEvent sampleEvent;                           // Schedules the next sample while the button is in use.
+#else
     DigitalIn pin;                                          // The mbed object looking after this pin at any point in time (may change!).
+#endif
 
     unsigned long downStartTime;                            // used to store the current system clock when a button down event occurs
     uint8_t sigma;                                          // integration of samples over time. We use this for debouncing, and noise tolerance for touch sensing
     MicroBitButtonEventConfiguration eventConfiguration;    // Do we want to generate high level event (clicks), or defer this to another service.
 
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+    /**
+      * Interrupt handler for an edge on the pin. Starts sampling the button, if it isn't being sampled already.
+      */
+    void onEdge();
+#endif
+
     public:
 
     /**
@@ -29,6 +29,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "CoordinateSystem.h"
 #include "MicroBitAccelerometer.h"
+#include "MicroBitSampleFilter.h"
 
 
 /**
@@ -38,6 +39,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_COMPASS_STATUS_CALIBRATED               0x02
 #define MICROBIT_COMPASS_STATUS_CALIBRATING              0x04
 #define MICROBIT_COMPASS_STATUS_ADDED_TO_IDLE            0x08
+#define MICROBIT_COMPASS_STATUS_STANDBY                  0x10
 
 /**
  * Accelerometer events
@@ -46,6 +48,18 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_COMPASS_EVT_CONFIG_NEEDED               2
 #define MICROBIT_COMPASS_EVT_CALIBRATE                   3
 #define MICROBIT_COMPASS_EVT_CALIBRATION_NEEDED          4
+#define MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE          5
+
+/**
+ * The compass found by autoDetect(), as recorded in MicroBitStorage.
+ */
+#define MICROBIT_COMPASS_STORAGE_KEY                     "compass"
+#define MICROBIT_COMPASS_NONE                            0
+#define MICROBIT_COMPASS_MAG3110                         1
+#define MICROBIT_COMPASS_LSM303                          2
+#define MICROBIT_COMPASS_FXOS8700                        3
+
+class MicroBitCompassCalibrator;
 
 struct CompassCalibration
 {
@@ -72,6 +86,10 @@ class MicroBitCompass : public MicroBitComponent
         Sample3D                sampleENU;                  // The last sample read, in raw ENU format (stored in case requests are made for data in other coordinate spaces)
         CoordinateSpace         &coordinateSpace;           // The coordinate space transform (if any) to apply to the raw data from the hardware.
         MicroBitAccelerometer*  accelerometer;              // The accelerometer to use for tilt compensation.
+        MicroBitSampleStream    stream;                     // Every sample read, queued for the application if enabled.
+        MicroBitSampleFilter    filter;                     // Smooths the latest sample, if configured.
+        uint32_t                accessTime;                 // The system time at which the compass was last read, or found to be listened to.
+        MicroBitCompassCalibrator *calibrator;              // Refines the calibration in the background from each uncalibrated sample, or NULL.
 
     public:
 
@@ -107,6 +125,18 @@ class MicroBitCompass : public MicroBitComponent
          */
         static MicroBitCompass& autoDetect(MicroBitI2C &i2c); 
 
+        /**
+         * Device autodetection, remembering the device found.
+         *
+         * The device found on a previous boot is confirmed with a single WHO_AM_I read, and the
+         * bus is only scanned for every supported device if it does not respond.
+         *
+         * @param i2c the bus to scan.
+         * @param storage the storage used to record the device found.
+         *
+         */
+        static MicroBitCompass& autoDetect(MicroBitI2C &i2c, MicroBitStorage &storage);
+
 
         /**
          * Gets the current heading of the device, relative to magnetic north.
@@ -172,6 +202,14 @@ class MicroBitCompass : public MicroBitComponent
          */
         CompassCalibration getCalibration();
 
+        /**
+         * Registers a calibrator to be passed every sample read, before calibration is applied, so that it can
+         * refine the calibration in the background.
+         *
+         * @param calibrator The calibrator to pass samples to, or NULL to stop.
+         */
+        void setCalibrator(MicroBitCompassCalibrator *calibrator);
+
         /**
          * Returns 0 or 1. 1 indicates that the compass is calibrated, zero means the compass requires calibration.
          */
@@ -198,6 +236,19 @@ class MicroBitCompass : public MicroBitComponent
          */
         virtual int configure();
 
+        /**
+         * Places the compass into its lowest power mode, until configure() is next called.
+         *
+         * This is used to stop sampling while nothing is reading the compass or listening for its events.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured,
+         *         or MICROBIT_NOT_SUPPORTED if the hardware has no such mode.
+         *
+         * @note This method should be overidden by the hardware driver to implement the requested
+         * changes in hardware.
+         */
+        virtual int standby();
+
         /**
          *
          * Defines the accelerometer to be used for tilt compensation.
@@ -253,6 +304,67 @@ class MicroBitCompass : public MicroBitComponent
          */
         virtual int update();
 
+        /**
+         * Enables a stream of every sample read from the compass, to be read in bulk by an application fiber.
+         *
+         * Each sample is timestamped and queued as it is read, so no samples are lost between calls to readStream(),
+         * however often MICROBIT_COMPASS_EVT_DATA_UPDATE events are processed.
+         *
+         * @param samples the number of samples to queue, or zero to disable the stream and free its storage.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+         *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+         */
+        int setStreamSize(int samples);
+
+        /**
+         * Removes up to length of the oldest samples from the stream, in the coordinate system defined in the constructor.
+         *
+         * @param samples the buffer to store the samples in.
+         *
+         * @param length the largest number of samples to remove.
+         *
+         * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+         *
+         * @note samples read from the hardware in a single burst share a timestamp.
+         */
+        int readStream(TimedSample3D *samples, int length);
+
+        /**
+         * Provides the stream of samples, for access to its fill level and overflow count.
+         *
+         * @return the sample stream of this compass.
+         */
+        MicroBitSampleStream& getStream();
+
+        /**
+         * Smooths the samples read from the compass, so that each read returns a filtered value without
+         * further bus traffic. The filter is updated incrementally as each sample arrives. The stream
+         * still receives every unfiltered sample.
+         *
+         * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+         *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+         *
+         * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+         *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+         *
+         * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+         *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+         *
+         * @code
+         * // Report the median of the last 9 samples.
+         * compass.setFilter(MICROBIT_FILTER_MEDIAN, 9);
+         * @endcode
+         */
+        int setFilter(int type, int length);
+
+        /**
+         * Determines the type of filter applied to the samples read, as set by setFilter().
+         *
+         * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+         */
+        int getFilter();
+
         /**
          * Reads the last compass value stored, and provides it in the coordinate system requested.
          *
@@ -305,8 +417,50 @@ class MicroBitCompass : public MicroBitComponent
          */
         ~MicroBitCompass();
 
+    protected:
+
+        /**
+         * Records that the compass has been read through its API.
+         *
+         * If the compass is in standby, it is reconfigured and this waits for one sample period,
+         * so that the caller receives a fresh sample.
+         */
+        void recordAccess();
+
+        /**
+         * Records that the compass is in use, without reconfiguring the hardware. Used by operations
+         * that are about to call configure() themselves.
+         */
+        void wake();
+
+        /**
+         * Determines if the compass should continue to be sampled, placing it into standby if it has not
+         * been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+         *
+         * Drivers call this from idleTick(), and skip the update if it returns 0.
+         *
+         * @return 1 if the compass should be sampled, 0 if it is in standby.
+         */
+        int isSampling();
+
     private:
 
+        /**
+         * Scans the given I2C bus for supported compass devices, starting with the one recorded in storage (if any),
+         * and constructs an appropriate driver.
+         *
+         * @param i2c the bus to scan.
+         * @param storage the storage used to record the device found, or NULL to scan every time.
+         */
+        static void detect(MicroBitI2C &i2c, MicroBitStorage *storage);
+
+        /**
+         * Brings the compass out of standby when a listener is registered for its events.
+         *
+         * @param evt The MICROBIT_ID_MESSAGE_BUS_LISTENER event raised by the message bus, carrying the ID listened to.
+         */
+        void onListenerRegistered(MicroBitEvent evt);
+
         /**
          * Internal helper used to de-duplicate code in the constructors
          *
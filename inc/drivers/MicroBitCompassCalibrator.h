@@ -32,6 +32,99 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitDisplay.h"
 #include "MicroBitStorage.h"
 
+// The largest number of samples a CompassSphereFit can accumulate without its sums overflowing.
+#define COMPASS_SPHERE_FIT_MAX_SAMPLES      128
+
+// Samples are accumulated in units of (1 << COMPASS_SPHERE_FIT_SHIFT), relative to the first sample.
+#define COMPASS_SPHERE_FIT_SHIFT            4
+
+/**
+  * Incremental least squares fit of a sphere to a set of compass samples.
+  *
+  * Each sample is folded into a set of fixed point sums as it arrives, so an estimate of the centre
+  * is available at any time for the cost of solving a 3x3 linear system, without revisiting earlier samples.
+  */
+class CompassSphereFit
+{
+    Sample3D    origin;                 // The first sample. Later samples are accumulated relative to it, to bound the sums.
+    int         samples;                // The number of samples accumulated.
+    int64_t     sum[3];                 // The sum of each component, u.
+    int64_t     sumSquares[3][3];       // The sum of each product of two components, u.u'
+    int64_t     sumCubes[3];            // The sum of each component multiplied by the squared length, u.|u|^2
+    int64_t     sumLengths;             // The sum of the squared lengths, |u|^2
+
+    /**
+      * Determines the centre of the sphere relative to the origin, in accumulated units.
+      *
+      * @param c Set to the centre found.
+      *
+      * @param coverage If not NULL, set to the spread of the samples, as returned by getCoverage().
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the samples do not yet determine a centre.
+      */
+    int solve(int64_t c[3], int *coverage);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an empty fit.
+      */
+    CompassSphereFit();
+
+    /**
+      * Discards all samples accumulated.
+      */
+    void clear();
+
+    /**
+      * Adds a sample to the fit.
+      *
+      * @param s The sample to add.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if COMPASS_SPHERE_FIT_MAX_SAMPLES have already been added.
+      */
+    int add(Sample3D s);
+
+    /**
+      * Determines the number of samples accumulated.
+      *
+      * @return the number of samples added since the fit was last cleared.
+      */
+    int getSamples();
+
+    /**
+      * Estimates the centre and radius of the sphere on which the samples lie.
+      *
+      * @param centre Set to the centre of the sphere.
+      *
+      * @param radius Set to the root mean square distance of the samples from the centre.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the samples do not yet determine a centre.
+      */
+    int getCentre(Sample3D &centre, int &radius);
+
+    /**
+      * Estimates how well the samples cover the sphere, from the spread of the samples about their mean.
+      *
+      * @return a value from 0 (all samples lie in a plane) to 1024 (samples are spread evenly in every direction).
+      */
+    int getCoverage();
+};
+
+/**
+  * The state of a background calibration, gathering samples as the compass is used.
+  */
+struct CompassBackgroundCalibration
+{
+    CompassSphereFit    fit;                                        // The fit of the samples gathered so far.
+    CompassCalibration  stored;                                     // The calibration last written to storage.
+    int                 samples;                                    // The number of samples gathered.
+    bool                refining;                                   // Set while the samples gathered are being processed.
+    bool                active;                                     // Cleared once stopped, while the samples are still being processed.
+    Sample3D            data[MICROBIT_COMPASS_BACKGROUND_SAMPLES];  // The samples gathered.
+};
 
 /**
   * Class definition for an interactive compass calibration algorithm.
@@ -51,6 +144,7 @@ class MicroBitCompassCalibrator
     MicroBitAccelerometer&  accelerometer;
     MicroBitDisplay&        display;
     MicroBitStorage         *storage;
+    CompassBackgroundCalibration *background;
 
     public:
 
@@ -99,6 +193,32 @@ class MicroBitCompassCalibrator
       * This function is, by design, synchronous and only returns once calibration is complete.
       */
     void calibrateUX(MicroBitEvent);
+
+    /**
+      * Starts refining the calibration of the compass in the background, from the samples read as it is used.
+      *
+      * Samples are gathered once they are well spaced from each other, and the calibration is recalculated each time
+      * they cover enough of the sphere. The new calibration is written to storage only if it differs significantly
+      * from that last stored. See MICROBIT_COMPASS_BACKGROUND_SAMPLES and MICROBIT_COMPASS_BACKGROUND_THRESHOLD.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if there is insufficient memory.
+      */
+    int startBackgroundCalibration();
+
+    /**
+      * Stops refining the calibration of the compass in the background. The calibration in use is kept.
+      */
+    void stopBackgroundCalibration();
+
+    /**
+      * Offers a sample to the background calibration. Called by the compass with every sample read.
+      *
+      * This is inexpensive, and may be called from the idle thread. The calibration itself is recalculated
+      * by a MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE event handler.
+      *
+      * @param s The sample, in ENU format, before calibration is applied.
+      */
+    void addSample(Sample3D s);
      /**
       * Calculates an independent X, Y, Z scale factor and centre for a given set of data points,
       * assumed to be on a bounding sphere
@@ -118,26 +238,14 @@ class MicroBitCompassCalibrator
     private:
 
     /**
-     * Scoring function for a hill climb algorithm.
-     *
-     * @param c An approximated centre point
-     * @param data a collection of data points
-     * @param samples the number of samples in the 'data' array
-     *
-     * @return The deviation between the closest and further point in the data array from the point given. 
+     * Recalculates the calibration from the samples gathered in the background, storing it if it has changed significantly.
      */
-    static float measureScore(Sample3D &c, Sample3D *data, int samples);
+    void refineCalibration(MicroBitEvent);
 
-    /*
-     * Performs an interative approximation (hill descent) algorithm to determine an
-     * estimated centre point of a sphere upon which the given data points reside.
-     *
-     * @param data an array containing sample points
-     * @param samples the number of sample points in the 'data' array.
-     *
-     * @return the approximated centre point of the points in the 'data' array.
+    /**
+     * Frees the state of a background calibration, once it has stopped.
      */
-    static Sample3D approximateCentre(Sample3D *data, int samples);
+    void releaseBackground();
 
     /**
      * Calculates an independent scale factor for X,Y and Z axes that places the given data points on a bounding sphere
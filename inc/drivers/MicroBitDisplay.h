@@ -34,12 +34,15 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitFont.h"
 #include "MicroBitMatrixMaps.h"
 #include "MicroBitLightSensor.h"
+#include "MicroBitFiber.h"
 
 /**
   * Event codes raised by MicroBitDisplay
   */
 #define MICROBIT_DISPLAY_EVT_ANIMATION_COMPLETE         1
 #define MICROBIT_DISPLAY_EVT_LIGHT_SENSE                2
+#define MICROBIT_DISPLAY_EVT_FRAME_SWAPPED              3
+#define MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY          4
 
 //
 // Internal constants
@@ -47,6 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_DISPLAY_DEFAULT_AUTOCLEAR      1
 #define MICROBIT_DISPLAY_SPACING                1
 #define MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH    8
+#define MICROBIT_DISPLAY_GREYSCALE_WAIT_PLANES  3
 #define MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS    -255
 
 enum AnimationMode {
@@ -73,6 +77,23 @@ enum DisplayRotation {
     MICROBIT_DISPLAY_ROTATION_270
 };
 
+/**
+  * A request to show an animation on the display, held in the animation queue until the display is free.
+  */
+struct DisplayAnimation
+{
+    ManagedString text;         // The text to print or scroll.
+    MicroBitImage image;        // The image to print, scroll or animate.
+    uint16_t ticket;            // The sequence number of this request, used to wait for its completion.
+    uint16_t delay;             // The time between updates, or the time to show a printed image (ms).
+    int16_t x;                  // The horizontal position of a printed image, or the starting position of an animation.
+    int16_t y;                  // The vertical position of a printed image.
+    int8_t stride;              // The number of pixels to move an image in each update.
+    uint8_t alpha;              // Treat pixels of a printed image at brightness '0' as transparent.
+    char character;             // The character to print, or zero to print the image.
+    uint8_t mode;               // The AnimationMode that shows this request.
+};
+
 /**
   * Class definition for MicroBitDisplay.
   *
@@ -90,9 +111,73 @@ class MicroBitDisplay : public MicroBitComponent
     uint8_t timingCount;
     uint32_t col_mask;
 
-    Timeout renderTimer;
+    // The number of consecutive blank rows strobed, and whether the display needs no tick of its own
+    // because the whole image is blank.
+    uint8_t blankRows;
+    bool blankIdle;
+
+    // The number of frames shown since the light sensor last took a sample, in light sense mode.
+    uint8_t lightSenseFrames;
+
+    SystemTimerEvent renderTimer;
     PortOut *LEDMatrix;
 
+    // For each row, the offset into the image bitmap of the pixel shown by each column, for the current rotation.
+    // This keeps the rotation arithmetic out of the strobe, which runs in interrupt context.
+    uint16_t *strobeTable;
+
+    // When double buffering, the copy of the image that is being strobed, or NULL if the image is strobed directly.
+    // `image` then acts as the back buffer, and is copied here between frames when a swap has been requested.
+    uint8_t *frontBuffer;
+    uint16_t frontBufferSize;
+    volatile uint8_t swapPending;
+
+    /**
+      * Called as the strobe returns to the first row. Publishes the back buffer if a swap has been requested.
+      */
+    void publishFrame();
+
+    /**
+      * Determines the bitmap to strobe.
+      *
+      * @return the front buffer if double buffering is enabled, or the bitmap of the image otherwise.
+      */
+    const uint8_t *getFrameBitmap()
+    {
+        return frontBuffer ? frontBuffer : image.getBitmap();
+    }
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+    // The port values for each greyscale bit plane of the row being strobed.
+    uint32_t greyscalePlanes[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH];
+
+    /**
+      * Greyscale timer interrupt handler. Shows the next bit plane of the current row.
+      */
+    static void greyscaleTimerHandler();
+
+    /**
+      * Stops the greyscale timer, abandoning any bit planes still to be shown.
+      */
+    void stopGreyscaleTimer();
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    /**
+      * Lights the given row through the brightness GPIOTE channel, and starts the timer that turns it off.
+      *
+      * @param pin the pin of the row.
+      *
+      * @param onTime the time to light the row for, in microseconds.
+      */
+    void startBrightnessTimer(int pin, uint32_t onTime);
+
+    /**
+      * Stops the brightness timer, and returns the row pin it was driving to the port.
+      */
+    void stopBrightnessTimer();
+#endif
+
     //
     // State used by all animation routines.
     //
@@ -100,6 +185,22 @@ class MicroBitDisplay : public MicroBitComponent
     // The animation mode that's currently running (if any)
     volatile AnimationMode animationMode;
 
+    // The fibers blocked waiting for the current animation to complete, in the order they arrived.
+    FiberSemaphore freeDisplay;
+
+    // Animations waiting to be shown, in the order they were requested.
+    DisplayAnimation animationQueue[MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE];
+    uint8_t animationQueueHead;
+    uint8_t animationQueueLength;
+
+    // The ticket last issued, the ticket of the animation being shown, and the ticket last completed.
+    // Tickets between animationCancelledFrom and animationCancelledTo were discarded by the last call to stopAnimation().
+    uint16_t animationTicket;
+    uint16_t animationCurrent;
+    uint16_t animationCompleted;
+    uint16_t animationCancelledFrom;
+    uint16_t animationCancelledTo;
+
     // The time in milliseconds between each frame update.
     uint16_t animationDelay;
 
@@ -119,7 +220,7 @@ class MicroBitDisplay : public MicroBitComponent
     // The index of the character currently being displayed.
     uint16_t scrollingChar;
 
-    // The number of pixels the current character has been shifted on the display.
+    // The column of the current character (including its trailing spacing) to be shown next.
     uint8_t scrollingPosition;
 
     //
@@ -149,6 +250,10 @@ class MicroBitDisplay : public MicroBitComponent
     // A pointer to an instance of light sensor, if in use
     MicroBitLightSensor* lightSensor;
 
+    // The filter applied to light level readings, restored whenever the light sensor is created
+    uint8_t lightFilterType;
+    uint8_t lightFilterLength;
+
     // Flag to indicate if image has been rendered to screen yet (or not)
     bool scrollingImageRendered;
 
@@ -179,6 +284,38 @@ class MicroBitDisplay : public MicroBitComponent
       */
     void renderWithLightSense();
 
+    /**
+      * Puts the display into DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE and creates the light sensor,
+      * if this has not been done already.
+      */
+    void startLightSense();
+
+    /**
+      * Informs the system tick governor of the tick period the display needs in its current mode,
+      * or that it needs none if the display is disabled.
+      */
+    void updateTickRequirement();
+
+    /**
+      * Determines the columns lit in the given row of the matrix.
+      *
+      * @param row The row of the matrix.
+      *
+      * @return A bitmask of the lit columns, where bit 0 is the first column of the matrix.
+      */
+    uint32_t getRowPattern(int row);
+
+    /**
+      * Tracks whether the image has been blank for a whole frame, with no animation running, and if so relaxes
+      * the display's system tick requirement until something is drawn again. Used in black and white mode.
+      */
+    void updateBlankIdle();
+
+    /**
+      * Recomputes the strobe table for the current rotation.
+      */
+    void updateStrobeTable();
+
     /**
       * Translates a bit mask into a timer interrupt that gives the appearence of greyscale.
       */
@@ -186,7 +323,7 @@ class MicroBitDisplay : public MicroBitComponent
 
     /**
       * Internal scrollText update method.
-      * Shift the screen image by one pixel to the left. If necessary, paste in the next char.
+      * Shift the screen image by one pixel to the left, and draw the newly exposed column of the current char.
       */
     void updateScrollText();
 
@@ -220,6 +357,39 @@ class MicroBitDisplay : public MicroBitComponent
       */
     void waitForFreeDisplay();
 
+    /**
+      * Starts the given animation, replacing the state of any previous animation.
+      *
+      * @param a The animation to start.
+      */
+    void startAnimation(const DisplayAnimation &a);
+
+    /**
+      * Removes the animation at the head of the queue, and starts it.
+      */
+    void startNextAnimation();
+
+    /**
+      * Starts the given animation if the display is free, or adds it to the animation queue otherwise.
+      *
+      * @param a The animation to show.
+      *
+      * @param ticket Populated with the ticket issued to the animation.
+      *
+      * @return MICROBIT_OK, or MICROBIT_BUSY if the animation queue is full.
+      */
+    int queueAnimation(DisplayAnimation &a, uint16_t &ticket);
+
+    /**
+      * Shows the given animation, blocking the calling fiber until there is space for it in the animation queue,
+      * and then until it has completed.
+      *
+      * @param a The animation to show.
+      *
+      * @return MICROBIT_OK, or MICROBIT_CANCELLED if the animation was stopped by stopAnimation().
+      */
+    int runAnimation(DisplayAnimation &a);
+
     /**
       * Blocks the current fiber until the current animation has finished.
       * If the scheduler is not running, this call will essentially perform a spinning wait.
@@ -265,14 +435,14 @@ public:
     virtual void systemTick();
 
     /**
-      * Prints the given character to the display, if it is not in use.
+      * Prints the given character to the display, or queues it if the display is in use.
       *
       * @param c The character to display.
       *
       * @param delay Optional parameter - the time for which to show the character. Zero displays the character forever,
       *              or until the Displays next use.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY is the screen is in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * display.printAsync('p');
@@ -290,7 +460,7 @@ public:
       * @param delay The time to delay between characters, in milliseconds. Must be > 0.
       *              Defaults to: MICROBIT_DEFAULT_PRINT_SPEED.
       *
-      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * display.printAsync("abc123",400);
@@ -299,7 +469,7 @@ public:
     int printAsync(ManagedString s, int delay = MICROBIT_DEFAULT_PRINT_SPEED);
 
     /**
-      * Prints the given image to the display, if the display is not in use.
+      * Prints the given image to the display, or queues it if the display is in use.
       * Returns immediately, and executes the animation asynchronously.
       *
       * @param i The image to display.
@@ -368,7 +538,7 @@ public:
       *
       * @param delay The time to display the image for, or zero to show the image forever. Defaults to 0.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_CANCELLED or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * MicrobitImage i("1,1,1,1,1\n1,1,1,1,1\n");
@@ -386,7 +556,7 @@ public:
       * @param delay The time to delay between characters, in milliseconds. Defaults
       *              to: MICROBIT_DEFAULT_SCROLL_SPEED.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * display.scrollAsync("abc123",100);
@@ -405,7 +575,7 @@ public:
       *
       * @param stride The number of pixels to shift by in each update. Defaults to MICROBIT_DEFAULT_SCROLL_STRIDE.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * MicrobitImage i("1,1,1,1,1\n1,1,1,1,1\n");
@@ -466,7 +636,7 @@ public:
       *
       * @param autoClear defines whether or not the display is automatically cleared once the animation is complete. By default, the display is cleared. Set this parameter to zero to disable the autoClear operation.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY if the screen is in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
       *
       * @code
       * const int heart_w = 10;
@@ -594,6 +764,59 @@ public:
       */
     void clear();
 
+    /**
+      * Enables or disables double buffering of the display.
+      *
+      * When enabled, the display strobes a private copy of the image. Drawing into `image` then has no visible
+      * effect until swap() or swapAsync() is called, after which the whole image is shown from the start of the next
+      * frame. This avoids tearing when redrawing the display while it is being refreshed. Animations and the other
+      * display methods request swaps automatically.
+      *
+      * @param enable true to enable double buffering, false to strobe `image` directly.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the front buffer could not be allocated.
+      *
+      * @code
+      * display.setDoubleBuffering(true);
+      * @endcode
+      */
+    int setDoubleBuffering(bool enable);
+
+    /**
+      * Determines if the display is double buffered.
+      *
+      * @return true if double buffering is enabled, false otherwise.
+      */
+    bool isDoubleBuffered();
+
+    /**
+      * Requests that the contents of `image` are shown from the start of the next frame.
+      * Returns immediately. Any further changes made to `image` before the swap takes place may be shown.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NOT_SUPPORTED if double buffering is not enabled.
+      */
+    int swapAsync();
+
+    /**
+      * Requests that the contents of `image` are shown from the start of the next frame, and blocks the calling fiber
+      * until the swap has taken place, so that drawing of the next frame can safely begin.
+      * If the scheduler is not running, this call will essentially perform a spinning wait.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NOT_SUPPORTED if double buffering is not enabled.
+      *
+      * @code
+      * display.setDoubleBuffering(true);
+      *
+      * while(1)
+      * {
+      *     display.image.clear();
+      *     display.image.setPixelValue(x, y, 255);
+      *     display.swap();
+      * }
+      * @endcode
+      */
+    int swap();
+
     /**
       * Updates the font that will be used for display operations.
 	  *
@@ -624,8 +847,8 @@ public:
       * Internally, it constructs an instance of a MicroBitLightSensor if not already configured
       * and sets the display mode to DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
       *
-      * This also changes the tickPeriod to MICROBIT_LIGHT_SENSOR_TICK_SPEED so
-      * that the display does not suffer from artifacts.
+      * The light sensor takes a sample once every MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES frames, in a strobe slot
+      * of its own, so the system tick period is unaffected.
       *
       * @return an indicative light level in the range 0 - 255.
       *
@@ -635,6 +858,47 @@ public:
       */
     int readLightLevel();
 
+    /**
+      * Requests a fresh light level reading, without waiting for one to be taken.
+      *
+      * The display is put into DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE if it isn't already, and the most
+      * recent reading is returned immediately. An event with value MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY
+      * is raised from MICROBIT_ID_DISPLAY once the light sensor next completes a reading, which can then be
+      * collected with another call to this method, or with readLightLevel().
+      *
+      * @param timestamp If not NULL, set to the time the returned reading was taken, in milliseconds
+      *        (as given by system_timer_current_time()), or 0 if no reading has been taken yet.
+      *
+      * @return an indicative light level in the range 0 - 255, or MICROBIT_NO_DATA if the light sensor
+      *         has not yet completed its first reading.
+      *
+      * @code
+      * display.requestLightLevel();
+      * fiber_wait_for_event(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY);
+      * int level = display.requestLightLevel();
+      * @endcode
+      */
+    int requestLightLevel(uint64_t *timestamp = NULL);
+
+    /**
+      * Smooths the light level readings, so that each call to readLightLevel() returns a filtered value.
+      * The filter is updated incrementally as each set of light sensor samples is taken, rather than when read.
+      *
+      * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+      *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      *
+      * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+      *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+      *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @code
+      * display.setLightLevelFilter(MICROBIT_FILTER_MOVING_AVERAGE, 8);
+      * @endcode
+      */
+    int setLightLevelFilter(int type, int length);
+
     /**
       * Destructor for MicroBitDisplay, where we deregister this instance from the array of system components.
       */
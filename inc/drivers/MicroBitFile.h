@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #define WRITE                           MB_WRITE
 #define READ_AND_WRITE                  READ | WRITE
 #define CREATE                          MB_CREAT
+#define LOG_APPEND                      MB_LOG
 
 class MicroBitFile
 {
@@ -45,9 +46,14 @@ class MicroBitFile
       *
       * @param fileName the name of the file to create/open.
       *
-      * @param mode One of: READ, WRITE, READ_AND_WRITE. Defaults to READ_AND_WRITE.
+      * @param mode One of: READ, WRITE, READ_AND_WRITE, optionally combined with CREATE and LOG_APPEND.
+      *             Defaults to READ_AND_WRITE | CREATE. LOG_APPEND opens the file as an append-only log:
+      *             every write is added to the end of the file, and its length is only recorded on close().
+      *
+      * @param cacheSize the size of the writeback cache for this file, in bytes, up to MBFS_BLOCK_SIZE.
+      *                  Defaults to MBFS_CACHE_SIZE.
       */
-    MicroBitFile(ManagedString fileName, int mode = READ | WRITE | CREATE);
+    MicroBitFile(ManagedString fileName, int mode = READ | WRITE | CREATE, int cacheSize = MBFS_CACHE_SIZE);
 
     /**
       * Seeks to a position in this MicroBitFile instance from the beginning of the file.
@@ -35,6 +35,7 @@ DEALINGS IN THE SOFTWARE.
 #define MB_WRITE    0x02
 #define MB_CREAT    0x04
 #define MB_APPEND   0x08
+#define MB_LOG      0x10
 
 // seek() flags.
 #define MB_SEEK_SET 0x01
@@ -43,6 +44,13 @@ DEALINGS IN THE SOFTWARE.
 
 // Status flags
 #define MBFS_STATUS_INITIALISED           0x01
+#define MBFS_STATUS_INDEXED               0x02    // The directory index has been built.
+#define MBFS_STATUS_INDEX_INCOMPLETE      0x04    // The directory index was too small to hold every entry.
+#define MBFS_STATUS_CHECKPOINTED          0x08    // The mount checkpoint in flash describes the file system as it is now.
+
+// Checkpoint codes
+#define MBFS_CHECKPOINT_MAGIC             0x4D424350
+#define MBFS_CHECKPOINT_VALID             0x0000C0DE
 
 // FileTable codes
 #define MBFS_UNUSED                       0xFFFF
@@ -83,6 +91,42 @@ struct Directory
     DirectoryEntry entry[0];
 };
 
+//
+// An entry in the in-RAM hash index of directory entries.
+//
+struct DirectoryIndexEntry
+{
+    DirectoryEntry *entry;                      // The indexed entry, or NULL if this slot is unused.
+    uint16_t directory;                         // The first block of the directory holding the entry.
+    uint16_t hash;                              // The hash of the entry's filename and directory.
+};
+
+//
+// A remembered position in a file's block chain.
+//
+struct FileBlockCacheEntry
+{
+    uint16_t index;                             // The index of the block within the file.
+    uint16_t block;                             // The logical block number.
+};
+
+//
+// A summary of the file system, written to the page after the file system whenever it is left with no open files.
+// If it is still valid when the file system is next mounted, the free block map and directory index are
+// restored from it, rather than by scanning the file table and every directory.
+//
+struct FileSystemCheckpoint
+{
+    uint32_t magic;                             // MBFS_CHECKPOINT_MAGIC.
+    uint32_t valid;                             // MBFS_CHECKPOINT_VALID once complete, cleared to zero when the file system changes.
+    uint32_t fileSystemTable;                   // Address of the file table this checkpoint describes.
+    uint16_t fileSystemSize;                    // Number of blocks in the file system.
+    uint16_t indexSize;                         // Number of directory index slots held, or zero if the index was not saved.
+    uint16_t indexLength;                       // Number of directory index slots in use.
+    uint16_t indexStatus;                       // MBFS_STATUS_INDEX_INCOMPLETE, if the index did not hold every entry.
+    uint32_t data[0];                           // The free block map, followed by the directory index.
+};
+
 //
 // A FileDescriptor holds contextual information needed for each OPEN file.
 //
@@ -110,8 +154,14 @@ struct FileDescriptor
     FileDescriptor *next;
 
     // Optional writeback cache, to minimise FLASH write operations at the expense of RAM.
+    // The cache holds up to cacheSize bytes, and is only allocated on the first write through it.
+    uint16_t cacheSize;
     uint16_t cacheLength;
-    uint8_t cache[MBFS_CACHE_SIZE];
+    uint8_t *cache;
+
+    // Recently used positions in the block chain, most recently used first, to speed up seeks.
+    uint16_t blockCacheLength;
+    FileBlockCacheEntry blockCache[MBFS_BLOCK_CACHE_SIZE];
 };
 
 /**
@@ -126,6 +176,10 @@ struct FileDescriptor
   * - remove()
   *
   * Only a single instance shoud exist at any given time.
+  *
+  * Each operation holds the FLASH lock (see MicroBitFlashLock) while it runs, so operations from different fibers
+  * are not interleaved. If the lock is held elsewhere and the caller cannot wait for it (e.g. the idle thread),
+  * the operation returns MICROBIT_BUSY.
   */
 class MicroBitFileSystem
 {
@@ -149,12 +203,22 @@ class MicroBitFileSystem
     // Cache of the last block allocated. Used to enable round robin use of blocks.
     uint16_t lastBlockAllocated;
 
+    // Bitmap of the blocks marked as UNUSED in the file table (one bit per block), or NULL if unavailable.
+    uint32_t *freeBlockMap;
+
     // Reference to the root directory of the file system.
     DirectoryEntry *rootDirectory;
 
     // Chain of open files.
     FileDescriptor *openFiles;
 
+    // Hash index of directory entries, keyed on filename and directory (MBFS_INDEX_SIZE slots), or NULL if not yet built.
+    DirectoryIndexEntry *directoryIndex;
+    uint16_t directoryIndexLength;
+
+    // The flash page holding the mount checkpoint, or NULL if there is no room for one.
+    uint32_t *checkpoint;
+
     /**
       * Initialize the flash storage system
       *
@@ -183,6 +247,40 @@ class MicroBitFileSystem
       */
     uint16_t getFreeBlock();
 
+    /**
+      * Find the next block marked as UNUSED in the file table, starting immediately after the last block allocated
+      * and wrapping around the file system space if necessary.
+      *
+      * @return The block number, or zero if no UNUSED blocks are available.
+      */
+    uint16_t findUnusedBlock();
+
+    /**
+      * Rebuild the bitmap of UNUSED blocks from the file table.
+      */
+    void buildFreeBlockMap();
+
+    /**
+      * Restore the free block map and directory index from the mount checkpoint, if it is valid.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if there is no valid checkpoint,
+      *         or MICROBIT_NO_RESOURCES if there is not enough memory to restore it.
+      */
+    int loadCheckpoint();
+
+    /**
+      * Write the free block map and directory index to the mount checkpoint.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if there is no room for a checkpoint,
+      *         or MICROBIT_NO_RESOURCES if the summary does not fit in a single page.
+      */
+    int writeCheckpoint();
+
+    /**
+      * Mark the mount checkpoint as out of date, before the file system is changed.
+      */
+    void invalidateCheckpoint();
+
     /**
     * Allocates a free physical block.
     * A round robin algorithm is used to even out the wear on the physical device.
@@ -206,6 +304,55 @@ class MicroBitFileSystem
     * @return A pointer to the DirectoryEntry for the given file, or NULL if no entry is found.
     */
     DirectoryEntry* getDirectoryEntry(char const * filename, const DirectoryEntry *directory = NULL);
+
+    /**
+    * Calculate the index hash of a filename within a directory.
+    *
+    * @param name The filename, without any path.
+    * @param directory The first block of the directory holding the file.
+    *
+    * @return The hash value.
+    */
+    uint16_t getIndexHash(char const *name, uint16_t directory);
+
+    /**
+    * Build the directory index, by scanning every directory in the file system.
+    */
+    void buildDirectoryIndex();
+
+    /**
+    * Add every entry of the given directory, and of the directories within it, to the directory index.
+    *
+    * @param directory The directory to scan.
+    */
+    void indexDirectory(DirectoryEntry *directory);
+
+    /**
+    * Add a DirectoryEntry to the directory index.
+    * If the index is too full, the entry is not added, and the index is marked as incomplete.
+    *
+    * @param entry The entry to add.
+    * @param directory The first block of the directory holding the entry.
+    */
+    void indexInsert(DirectoryEntry *entry, uint16_t directory);
+
+    /**
+    * Remove a DirectoryEntry from the directory index, if present.
+    *
+    * @param entry The entry to remove.
+    * @param directory The first block of the directory holding the entry.
+    */
+    void indexRemove(DirectoryEntry *entry, uint16_t directory);
+
+    /**
+    * Look up a filename in the directory index.
+    *
+    * @param name The filename, without any path.
+    * @param directory The first block of the directory to search.
+    *
+    * @return The DirectoryEntry for the given file, or NULL if it is not in the index.
+    */
+    DirectoryEntry* indexLookup(char const *name, uint16_t directory);
     
     /**
     * Create a new DirectoryEntry with the given filename and flags.
@@ -272,6 +419,45 @@ class MicroBitFileSystem
     */
     uint16_t getNextFileBlock(uint16_t block);
 
+    /**
+    * Retrieve the logical block holding the given block of an open file.
+    *
+    * The walk along the file table starts from the nearest remembered block at or before the one requested,
+    * and the result is remembered for next time.
+    *
+    * @param file The open file.
+    * @param index The index of the block within the file, counting from zero.
+    *
+    * @return The logical block number.
+    */
+    uint16_t getFileBlock(FileDescriptor *file, uint16_t index);
+
+    /**
+    * Determine the length of a log file, including any data written since its directory entry was last updated.
+    * Data is assumed to end at the last byte in the file's blocks that is not in the erased (0xFF) state.
+    *
+    * @param dirent The directory entry of the file.
+    *
+    * @return The length of the file, in bytes.
+    */
+    uint32_t getLogLength(DirectoryEntry *dirent);
+
+    /**
+    * Update the directory entry of an open file, if its length has changed.
+    *
+    * @param file The open file.
+    */
+    void syncDirectoryEntry(FileDescriptor *file);
+
+    /**
+    * Remember the logical block holding the given block of an open file, evicting the least recently used entry if necessary.
+    *
+    * @param file The open file.
+    * @param index The index of the block within the file, counting from zero.
+    * @param block The logical block number.
+    */
+    void cacheFileBlock(FileDescriptor *file, uint16_t index, uint16_t block);
+
     /**
     * Determine the logical block that contains the given address.
     *
@@ -343,6 +529,16 @@ class MicroBitFileSystem
      */
     bool isValidFilename(const char *name);
 
+    /**
+      * Opens a file, as open(), for callers that already hold the FLASH lock.
+      *
+      * @param filename name of the file to open.
+      * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG.
+      * @param cacheSize The size of the writeback cache for this file, in bytes.
+      * @return the file handle on success, or an error code as open().
+      */
+    int openFile(char const * filename, uint32_t flags, int cacheSize);
+
     public:
 
     static MicroBitFileSystem *defaultFileSystem;
@@ -358,12 +554,21 @@ class MicroBitFileSystem
       *  - MB_READ : read from the file.
       *  - MB_WRITE : write to the file.
       *  - MB_CREAT : create a new file, if it doesn't already exist.
+      *  - MB_APPEND : start with the seek position at the end of the file.
+      *  - MB_LOG : treat the file as an append-only log. All writes are added to the end of the file,
+      *             and the directory entry is only updated on close(), rather than on every flush().
       *
       * If a file is opened that doesn't exist, and MB_CREAT isn't passed,
       * an error is returned, otherwise the file is created.
       *
+      * If a log file was not closed (e.g. due to a reset), its length is recovered when it is next opened
+      * with MB_LOG, by scanning for the last byte written. Any 0xFF bytes at the end of the log are lost in this case.
+      *
       * @param filename name of the file to open, must contain only printable characters.
-      * @param flags One or more of MB_READ, MB_WRITE or MB_CREAT. 
+      * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG. 
+      * @param cacheSize The size of the writeback cache for this file, in bytes, up to MBFS_BLOCK_SIZE. Zero disables
+      *        the cache. The cache is allocated on the first small write, and is written back whenever it fills or the
+      *        end of a block is reached, such that a cache of MBFS_BLOCK_SIZE bytes results in whole block writes.
       * @return return the file handle,MICROBIT_NOT_SUPPORTED if the file system has
       *         not been initialised MICROBIT_INVALID_PARAMETER if the filename is
       *         too large, MICROBIT_NO_RESOURCES if the file system is full.
@@ -375,12 +580,14 @@ class MicroBitFileSystem
       *    print("file open error");
       * @endcode
       */
-    int open(char const * filename, uint32_t flags);
+    int open(char const * filename, uint32_t flags, int cacheSize = MBFS_CACHE_SIZE);
 
     /**
      * Writes back all state associated with the given file to FLASH memory, 
      * leaving the file open.
      *
+     * For files opened with MB_LOG, only the file data is written back. The directory entry is updated by close().
+     *
      * @param fd file descriptor - obtained with open().
      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system has not
      *         been initialised, MICROBIT_INVALID_PARAMETER if the given file handle
@@ -490,6 +697,34 @@ class MicroBitFileSystem
       */
     int read(int fd, uint8_t* buffer, int size);
 
+    /**
+      * Map a region of the file, for reading in place.
+      *
+      * Provides a pointer to the flash memory holding the data at the current seek
+      * position in the file, and the number of contiguous bytes available there, up to
+      * size. The seek position is incremented by the number of bytes returned, so
+      * repeated calls iterate over the file a run at a time. Runs extend across file
+      * blocks that happen to be adjacent in flash. The data remains valid until the
+      * file is next written or removed.
+      *
+      * @param fd File handle, obtained with open()
+      * @param data pointer to be set to the start of the mapped data
+      * @param size maximum number of bytes to map
+      * @return number of bytes mapped on success (zero at the end of the file),
+      *         MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+      *         MICROBIT_INVALID_PARAMETER if the given file handle is invalid.
+      *
+      * @code
+      * MicroBitFileSystem f;
+      * const uint8_t *data;
+      * int fd = f.open("image.bin", MB_READ);
+      * int len;
+      * while ((len = f.map(fd, &data, 256)) > 0)
+      *    consume(data, len);
+      * @endcode
+      */
+    int map(int fd, const uint8_t **data, int size);
+
     /**
       * Remove a file from the system, and free allocated assets
       * (including assigned blocks which are returned for use by other files).
@@ -23,9 +23,27 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_FLASH_H_
 
 #include <mbed.h>
+#include "MicroBitConfig.h"
 
 #define PAGE_SIZE 1024
 
+// Events raised on MICROBIT_ID_FLASH.
+#define MICROBIT_FLASH_EVT_COMPLETE 1           // A queued operation has completed.
+#define MICROBIT_FLASH_EVT_IDLE     2           // All queued operations have completed.
+
+// The number of words assembled in RAM before they are burned, when updating a page.
+#define MICROBIT_FLASH_BURN_WORDS   16
+
+/**
+  * A single write, for use with MicroBitFlash::flash_write() when several writes are to be made at once.
+  */
+struct MicroBitFlashWrite
+{
+    void* address;              // location in flash to write to.
+    void* buffer;               // location in memory to write from.
+    int length;                 // number of bytes to write.
+};
+
 class MicroBitFlash
 {
     private:
@@ -42,6 +60,43 @@ class MicroBitFlash
       * @return non-zero if erase required, zero otherwise.
       */
     int need_erase(uint8_t* source, uint8_t* flash_addr, int len);
+
+    /**
+      * Determine the new value of a word in flash, after any of the given writes that cover it are applied.
+      *
+      * @param address address of the word in flash.
+      * @param value the current value of the word.
+      * @param writes the writes to apply. Later writes take precedence over earlier ones.
+      * @param count the number of writes.
+      * @return the updated value of the word.
+      */
+    uint32_t merge_word(uint32_t* address, uint32_t value, MicroBitFlashWrite* writes, int count);
+
+    /**
+      * Burn a range of words from a source page into a destination page, applying the given writes.
+      * Only words that differ from the destination's current value are burned, and consecutive
+      * words are burned together.
+      *
+      * @param dest the page to write to.
+      * @param source the page holding the existing data.
+      * @param page the page that the writes are addressed to.
+      * @param start the first word to burn.
+      * @param end the word after the last word to burn.
+      * @param writes the writes to apply.
+      * @param count the number of writes.
+      */
+    void burn_words(uint32_t* dest, uint32_t* source, uint32_t* page, int start, int end, MicroBitFlashWrite* writes, int count);
+
+    /**
+      * Apply any of the given writes that fall within a page of flash memory.
+      * The page is erased at most once, and only if a bit needs to change from 0 to 1.
+      *
+      * @param page address of the page.
+      * @param writes the writes to apply.
+      * @param count the number of writes.
+      * @param scratch the scratch page to use if the page must be erased.
+      */
+    void write_page(uint32_t* page, MicroBitFlashWrite* writes, int count, uint32_t* scratch);
  
     public:
     /**
@@ -52,6 +107,7 @@ class MicroBitFlash
     /**
       * Writes the given number of bytes to the address in flash specified.
       * Neither address nor buffer need be word-aligned.
+      * Only the words that change are written, and the page is only erased if a bit needs to change from 0 to 1.
       * @param address location in flash to write to.
       * @param buffer location in memory to write from. 
       * @length number of bytes to burn
@@ -69,12 +125,51 @@ class MicroBitFlash
     int flash_write(void* address, void* buffer, int length, 
                     void* scratch_addr = NULL);
 
+    /**
+      * Makes several writes to flash memory at once.
+      * Writes to the same page are merged, so each page is erased at most once, however many writes
+      * it receives. Words whose contents would not change are not written at all.
+      *
+      * @param writes the writes to make. Where writes overlap, later writes take precedence.
+      * @param count the number of writes.
+      * @param scratch_addr if specified, scratch page to use. Use default otherwise.
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the scratch page is not page aligned.
+      *
+      * Example:
+      * @code
+      * MicroBitFlash flash();
+      * uint32_t a = 0x01, b = 0x02;
+      * MicroBitFlashWrite writes[] = {{(void *)0x38000, &a, sizeof(a)}, {(void *)0x38010, &b, sizeof(b)}};
+      * flash.flash_write(writes, 2);
+      * @endcode
+      */
+    int flash_write(MicroBitFlashWrite* writes, int count, void* scratch_addr = NULL);
+
+    /**
+      * Determine how many pages have been erased since the device started, by all instances of MicroBitFlash.
+      *
+      * @return the number of page erase operations.
+      */
+    uint32_t get_erase_count();
+
     /**
       * Erase an entire page.
+      * When BLE is running, the calling fiber is descheduled until the SoftDevice completes the erase.
       * @param page_address address of first word of page.
       */
     void erase_page(uint32_t* page_address);
 
+    /**
+      * Queue the erase of an entire page, and return without waiting for it to complete.
+      * A MICROBIT_FLASH_EVT_COMPLETE event is raised once the page is erased.
+      *
+      * Without BLE, the CPU cannot run while the FLASH is being erased, so the erase is performed immediately.
+      *
+      * @param page_address address of first word of page.
+      * @return MICROBIT_OK on success.
+      */
+    int erase_page_async(uint32_t* page_address);
+
     /**
       * Write to flash memory, assuming that a write is valid
       * (using need_erase).
@@ -86,6 +181,76 @@ class MicroBitFlash
       */
     void flash_burn(uint32_t* page_address, uint32_t* buffer, int len);
 
+    /**
+      * Queue a write to flash memory, and return without waiting for it to complete.
+      * A MICROBIT_FLASH_EVT_COMPLETE event is raised once the data is written.
+      *
+      * Without BLE, the CPU cannot run while the FLASH is being written, so the write is performed immediately.
+      *
+      * @param page_address address of memory to write to. Must be word aligned.
+      * @param buffer address to write from, must be word-aligned. This must remain valid until the write completes.
+      * @param len number of uint32_t words to write.
+      * @return MICROBIT_OK on success.
+      */
+    int flash_burn_async(uint32_t* page_address, uint32_t* buffer, int len);
+
+    /**
+      * Wait for queued FLASH operations to complete.
+      * The calling fiber is descheduled while it waits, if possible. The idle thread and interrupt handlers spin instead.
+      *
+      * As operations complete in the order they were queued, an operation is known to have completed
+      * once no more operations remain than were queued after it.
+      *
+      * @param pending the number of operations that may remain queued. Defaults to zero, waiting for all operations.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int flash_wait(int pending = 0);
+
+    /**
+      * Determine if any queued FLASH operations have yet to complete.
+      *
+      * @return true if FLASH operations are pending, false otherwise.
+      */
+    bool is_busy();
+
+};
+
+/**
+  * Holds the lock shared by all users of FLASH for as long as it is in scope, so that a sequence of operations
+  * (such as a read-modify-write through a scratch page) is not interleaved with that of another fiber.
+  *
+  * The lock is not reentrant. The idle thread and interrupt handlers cannot wait for it, so only take it if it is free.
+  *
+  * @code
+  * MicroBitFlashLock lock;
+  *
+  * if (!lock.isLocked())
+  *     return MICROBIT_BUSY;
+  * @endcode
+  */
+class MicroBitFlashLock
+{
+    bool locked;
+
+    public:
+
+    /**
+      * Constructor. Acquires the lock, blocking the calling fiber until it is available if possible.
+      */
+    MicroBitFlashLock();
+
+    /**
+      * Destructor. Releases the lock, if it was acquired.
+      */
+    ~MicroBitFlashLock();
+
+    /**
+      * Determines if the lock was acquired.
+      *
+      * @return true if the lock is held by this object, false otherwise.
+      */
+    bool isLocked();
 };
 
 #endif
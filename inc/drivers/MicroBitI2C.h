@@ -31,6 +31,30 @@ DEALINGS IN THE SOFTWARE.
 
 #define MICROBIT_I2C_MAX_RETRIES 9
 
+// Events raised on MICROBIT_ID_I2C.
+#define MICROBIT_I2C_EVT_COMPLETE   1           // A queued transfer has completed, and a fiber is waiting for one.
+
+// MicroBitI2CTransfer flags.
+#define MICROBIT_I2C_TRANSFER_READ  0x01        // Read from the device, rather than write to it.
+
+/**
+  * A register read or write, queued with MicroBitI2C::readRegisterAsync() or MicroBitI2C::writeRegisterAsync().
+  *
+  * The transfer and its buffer are owned by the caller, and must remain valid until the transfer completes.
+  */
+struct MicroBitI2CTransfer
+{
+    uint8_t address;                                // 8-bit I2C slave address.
+    uint8_t reg;                                    // The first register to access.
+    uint8_t flags;                                  // MICROBIT_I2C_TRANSFER_READ, or zero for a write.
+    uint8_t *buffer;                                // The data read, or to be written.
+    int length;                                     // The number of bytes to transfer.
+    volatile int result;                            // MICROBIT_BUSY until complete, then MICROBIT_OK or MICROBIT_I2C_ERROR.
+    void (*callback)(MicroBitI2CTransfer *);        // Called in interrupt context once complete, or NULL.
+    void *context;                                  // For use by the callback.
+    MicroBitI2CTransfer *next;                      // The next transfer in the queue.
+};
+
 /**
   * Class definition for MicroBitI2C.
   *
@@ -47,6 +71,43 @@ class MicroBitI2C : public I2C
 {
     uint8_t retries;
 
+    MicroBitI2CTransfer *queueHead;                 // The transfer in progress, followed by those waiting.
+    MicroBitI2CTransfer *queueTail;                 // The last transfer queued.
+    volatile uint8_t engineStatus;                  // The state of the transfer in progress.
+    volatile uint8_t waiting;                       // The number of fibers waiting for a transfer to complete.
+    int index;                                      // The number of bytes of the transfer in progress read or written.
+    uint32_t pins[2];                               // The SCL and SDA pins, restored after the peripheral is reset.
+    uint32_t speed;                                 // The bus frequency, restored after the peripheral is reset.
+
+    /**
+      * Starts the transfer at the head of the queue, if there is one and the bus is idle.
+      */
+    void startTransfer();
+
+    /**
+      * Completes the transfer in progress, and starts the next.
+      *
+      * @param result MICROBIT_OK or MICROBIT_I2C_ERROR.
+      */
+    void endTransfer(int result);
+
+    /**
+      * Adds a transfer to the tail of the queue, and starts it if the bus is idle.
+      *
+      * @param transfer the transfer to queue.
+      */
+    void queueTransfer(MicroBitI2CTransfer &transfer);
+
+    /**
+      * Waits for a transfer, or for all queued transfers, to complete.
+      *
+      * When waiting for the queue to empty, the peripheral is then claimed for mbed's polled driver, and no
+      * further transfers start until I2C_ENGINE_LOCKED is cleared and startTransfer() is called.
+      *
+      * @param transfer the transfer to wait for, or NULL to wait until the queue is empty.
+      */
+    void waitFor(MicroBitI2CTransfer *transfer);
+
     public:
 
     /**
@@ -143,6 +204,75 @@ class MicroBitI2C : public I2C
      */
     int readRegister(uint8_t address, uint8_t reg);
 
+    /**
+     * Queues a read of consecutive registers, and returns without waiting for it to complete.
+     *
+     * Transfers are performed in the order they were queued, from the TWI interrupt.
+     *
+     * @param transfer Storage for the transfer, which must remain valid until it completes.
+     * @param address The address of the I2C device to read from.
+     * @param reg The address of the first register to read.
+     * @param buffer Memory area to read the data into, which must remain valid until the transfer completes.
+     * @param length The number of bytes to read.
+     * @param callback A function to call in interrupt context once the transfer completes, or NULL.
+     *
+     * @return MICROBIT_OK if the transfer was queued, or MICROBIT_INVALID_PARAMETER.
+     *
+     * @code
+     * MicroBitI2CTransfer t;
+     * uint8_t data[6];
+     *
+     * i2c.readRegisterAsync(t, address, reg, data, 6);
+     * // Do something else...
+     * if (i2c.wait(t) == MICROBIT_OK)
+     *     // Use the data...
+     * @endcode
+     */
+    int readRegisterAsync(MicroBitI2CTransfer &transfer, uint8_t address, uint8_t reg, uint8_t *buffer, int length, void (*callback)(MicroBitI2CTransfer *) = NULL);
+
+    /**
+     * Queues a write of consecutive registers, and returns without waiting for it to complete.
+     *
+     * Transfers are performed in the order they were queued, from the TWI interrupt.
+     *
+     * @param transfer Storage for the transfer, which must remain valid until it completes.
+     * @param address The address of the I2C device to write to.
+     * @param reg The address of the first register to write.
+     * @param buffer The data to write, which must remain valid until the transfer completes.
+     * @param length The number of bytes to write.
+     * @param callback A function to call in interrupt context once the transfer completes, or NULL.
+     *
+     * @return MICROBIT_OK if the transfer was queued, MICROBIT_INVALID_PARAMETER,
+     *         or MICROBIT_NO_RESOURCES if the write could not be buffered.
+     */
+    int writeRegisterAsync(MicroBitI2CTransfer &transfer, uint8_t address, uint8_t reg, uint8_t *buffer, int length, void (*callback)(MicroBitI2CTransfer *) = NULL);
+
+    /**
+     * Waits for a queued transfer to complete.
+     *
+     * The calling fiber is descheduled while it waits, where possible. Otherwise, the processor
+     * sleeps until the next interrupt.
+     *
+     * @param transfer The transfer to wait for.
+     *
+     * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the transfer failed.
+     */
+    int wait(MicroBitI2CTransfer &transfer);
+
+    /**
+     * Determines if any queued transfers have yet to complete.
+     *
+     * @return true if transfers are pending, false otherwise.
+     */
+    bool isBusy();
+
+    /**
+     * Services the TWI interrupt, advancing the transfer in progress.
+     *
+     * @note This is called by the TWI interrupt handler, and should not be called by applications.
+     */
+    void interruptHandler();
+
 };
 
 #endif
@@ -31,6 +31,9 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "MicroBitPin.h"
 
+// The number of pins on the edge connector, held in MicroBitIO::pin[]
+#define MICROBIT_IO_PINS        19
+
 /**
   * Class definition for MicroBit IO.
   *
@@ -38,6 +41,32 @@ DEALINGS IN THE SOFTWARE.
   */
 class MicroBitIO
 {
+    // The GPIO port bits of the pins configured for bulk operations
+    uint32_t outputMask;
+    uint32_t inputMask;
+
+    /**
+      * Finds the pin on the edge connector attached to the given bit of the GPIO port.
+      *
+      * @param bit The bit in the GPIO port.
+      *
+      * @return the pin, or NULL if the bit has no pin on the edge connector.
+      */
+    MicroBitPin* findPin(int bit);
+
+    /**
+      * Configures a set of pins as digital inputs or outputs, for use with readDigital() and writeDigital().
+      *
+      * @param mask The pins to configure, as a mask of bits in the processor's GPIO port.
+      *
+      * @param output true to configure the pins as outputs, false for inputs.
+      *
+      * @param pull The pull to apply to inputs.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_NOT_SUPPORTED on failure.
+      */
+    int configureDigital(uint32_t mask, bool output, PinMode pull);
+
     public:
 
 	MicroBitPin			 pin[0];
@@ -76,6 +105,65 @@ class MicroBitIO
                int ID_P12,int ID_P13,int ID_P14,
                int ID_P15,int ID_P16,int ID_P19,
                int ID_P20);
+
+    /**
+      * Configures a set of pins as digital outputs, ready to be written together with writeDigital().
+      *
+      * @param mask The pins to configure, as a mask of bits in the processor's GPIO port, i.e. (1 << P0.name) | (1 << P1.name).
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the mask includes a pin that is not on the edge connector,
+      *         or MICROBIT_NOT_SUPPORTED if it includes a pin that does not have digital capability.
+      *
+      * @note Once configured, the pins must not be given another mode through their MicroBitPin until the bulk operations are
+      *       finished with. Configuring the pins again will bring them back into line.
+      */
+    int setDigitalOutputs(uint32_t mask);
+
+    /**
+      * Configures a set of pins as digital inputs, ready to be read together with readDigital().
+      *
+      * @param mask The pins to configure, as a mask of bits in the processor's GPIO port, i.e. (1 << P0.name) | (1 << P1.name).
+      *
+      * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the mask includes a pin that is not on the edge connector,
+      *         or MICROBIT_NOT_SUPPORTED if it includes a pin that does not have digital capability.
+      *
+      * @note Once configured, the pins must not be given another mode through their MicroBitPin until the bulk operations are
+      *       finished with. Configuring the pins again will bring them back into line.
+      */
+    int setDigitalInputs(uint32_t mask, PinMode pull = MICROBIT_DEFAULT_PULLMODE);
+
+    /**
+      * Sets the level of several digital outputs at once, with a single access to the GPIO port.
+      *
+      * @param mask The pins to write, as a mask of bits in the processor's GPIO port. These must have been configured with setDigitalOutputs().
+      *
+      * @param value The levels to write, one bit per pin in the same layout as the mask. Bits outside of the mask are ignored.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the mask includes a pin not configured as an output.
+      *
+      * @code
+      * uBit.io.setDigitalOutputs(bus);
+      * uBit.io.writeDigital(bus, data);
+      * @endcode
+      */
+    int writeDigital(uint32_t mask, uint32_t value);
+
+    /**
+      * Reads the level of several digital inputs at once, with a single access to the GPIO port.
+      *
+      * @param mask The pins to read, as a mask of bits in the processor's GPIO port. These must have been configured with setDigitalInputs().
+      *
+      * @return the level of each pin, as a bit in the same layout as the mask, or MICROBIT_NOT_SUPPORTED if the mask includes a pin not
+      *         configured as an input.
+      *
+      * @code
+      * uBit.io.setDigitalInputs(keys, PullUp);
+      * int pressed = ~uBit.io.readDigital(keys) & keys;
+      * @endcode
+      */
+    int readDigital(uint32_t mask);
 };
 
 #endif
@@ -29,12 +29,15 @@ DEALINGS IN THE SOFTWARE.
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
+#include "MicroBitSystemTimer.h"
 #include "EventModel.h"
 #include "MicroBitMatrixMaps.h"
+#include "MicroBitSampleFilter.h"
 
 #define MICROBIT_LIGHT_SENSOR_CHAN_NUM      3
 #define MICROBIT_LIGHT_SENSOR_AN_SET_TIME   4000
 #define MICROBIT_LIGHT_SENSOR_TICK_PERIOD   5
+#define MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES 4
 
 #define MICROBIT_LIGHT_SENSOR_MAX_VALUE     338
 #define MICROBIT_LIGHT_SENSOR_MIN_VALUE     75
@@ -53,14 +56,28 @@ class MicroBitLightSensor
     //holds the current channel (also used to index the results array)
     uint8_t chan;
 
-    //a Timeout which triggers our analogReady() call
-    Timeout analogTrigger;
+    //a one shot timer event which triggers our analogReady() call
+    SystemTimerEvent analogTrigger;
 
     //a pointer the currently sensed pin, represented as an AnalogIn
     AnalogIn* sensePin;
 
     const MatrixMap &matrixMap;
 
+    //smooths the average of each complete set of results, if configured
+    MicroBitSampleFilter filter;
+
+    //the time the last complete set of results was taken, in milliseconds, or 0 if none has been taken yet
+    volatile uint64_t timestamp;
+
+    //set if an event should be raised when the next complete set of results has been taken
+    volatile bool notify;
+
+    /**
+      * Calculates the average of the results from each section of the display.
+      */
+    int average();
+
     /**
       * After the startSensing method has been called, this method will be called
       * MICROBIT_LIGHT_SENSOR_AN_SET_TIME after.
@@ -126,6 +143,49 @@ class MicroBitLightSensor
       */
     void startSensing(MicroBitEvent);
 
+    /**
+      * Requests that an event with value MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY is raised from MICROBIT_ID_DISPLAY
+      * when the next complete set of results has been taken. This method does not wait for the results.
+      *
+      * @return the time the results returned by read() were taken, in milliseconds (as given by
+      *         system_timer_current_time()), or 0 if no complete set of results has been taken yet.
+      */
+    uint64_t requestSample();
+
+    /**
+      * Determines when the results returned by read() were taken.
+      *
+      * @return the time, in milliseconds (as given by system_timer_current_time()), or 0 if no complete set
+      *         of results has been taken yet.
+      */
+    uint64_t getTimestamp();
+
+     /**
+      * Smooths the readings of the light sensor, so that each read returns a filtered value. The filter is
+      * updated incrementally as each complete sample is taken, rather than when read.
+      *
+      * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+      *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      *
+      * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+      *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+      *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @code
+      * lightSensor.setFilter(MICROBIT_FILTER_EXPONENTIAL, 4);
+      * @endcode
+      */
+    int setFilter(int type, int length);
+
+     /**
+      * Determines the type of filter applied to the readings, as set by setFilter().
+      *
+      * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      */
+    int getFilter();
+
     /**
       * A destructor for MicroBitLightSensor.
       *
@@ -32,6 +32,10 @@ DEALINGS IN THE SOFTWARE.
 
 #define NUMBER_OF_REGIONS 3
 
+// Seed and multiplier of the 32 bit FNV-1a hash used to summarise a page of flash.
+#define MICROBIT_MEMORY_MAP_HASH_SEED       0x811C9DC5
+#define MICROBIT_MEMORY_MAP_HASH_PRIME      0x01000193
+
 /**
   * Class definition for the MicroBitMemoryMap class.
   * This allows reading and writing of regions within the memory map.
@@ -107,6 +111,36 @@ class MicroBitMemoryMap
      *
      */
     void findHashes();
+
+    /**
+      * Computes a 32 bit FNV-1a hash of the contents of one page of flash.
+      *
+      * Page hashes let a client compare the program it holds against the one on the device
+      * page by page, and resend only those pages that differ. Hashes are always computed
+      * from the live contents of flash, so they remain valid as pages are rewritten.
+      *
+      * @param address The address of the page. Must be page aligned.
+      *
+      * @return the hash of the page's contents.
+      */
+    uint32_t getPageHash(uint32_t address);
+
+    /**
+      * Computes the hashes of a run of consecutive pages of flash.
+      *
+      * Only pages above the Soft Device and below the scratch page can be hashed.
+      *
+      * @param address The address of the first page. Must be page aligned.
+      *
+      * @param hashes The buffer to store the hashes in.
+      *
+      * @param count The maximum number of hashes to store.
+      *
+      * @return the number of hashes stored, which is less than count if the end of the
+      *         program flash was reached, or MICROBIT_INVALID_PARAMETER if address is misaligned
+      *         or out of range.
+      */
+    int getPageHashes(uint32_t address, uint32_t *hashes, int count);
 };
 
 #endif
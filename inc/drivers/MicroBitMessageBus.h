@@ -33,6 +33,23 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitListener.h"
 #include "EventModel.h"
 
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+/**
+  * A snapshot of the statistics recorded by a MicroBitMessageBus.
+  */
+struct MicroBitMessageBusStatistics
+{
+    uint32_t sent;                      // The number of events sent to the bus.
+    uint32_t queued;                    // The number of events added to the bus queue.
+    uint32_t coalesced;                 // The number of events coalesced with an identical event already in the bus queue.
+    uint32_t dropped;                   // The number of events dropped because the bus queue was full.
+    uint32_t dispatched;                // The number of events delivered to listeners, summed over all current listeners.
+    uint32_t listenerDropped;           // The number of events dropped by busy listeners, summed over all current listeners.
+    uint32_t prioritised;               // The number of events added to the priority queue (always zero unless MESSAGE_BUS_PRIORITY_LANE is enabled).
+    uint16_t peakQueueLength;           // The greatest number of events held in the bus queues at any one time.
+};
+#endif
+
 /**
   * Class definition for the MicroBitMessageBus.
   *
@@ -116,6 +133,18 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     virtual MicroBitListener *elementAt(int n);
 
+    /**
+      * Determines if any listener would receive events raised with the given ID and value, so that components can
+      * avoid the cost of generating events that nobody is waiting for.
+      *
+      * @param id The ID to test.
+      *
+      * @param value The event value to test. Defaults to MICROBIT_EVT_ANY, which matches listeners for any value.
+      *
+      * @return true if a listener is registered for the ID and value, or for MICROBIT_ID_ANY. false otherwise.
+      */
+    virtual bool isListening(uint16_t id, uint16_t value = MICROBIT_EVT_ANY);
+
     /**
       * Destructor for MicroBitMessageBus, where we deregister this instance from the array of fiber components.
       */
@@ -139,13 +168,55 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     virtual int remove(MicroBitListener *newListener);
 
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    /**
+      * Provides a snapshot of the statistics recorded by this message bus.
+      *
+      * @param stats Updated with the statistics recorded since creation, or the last call to resetStatistics().
+      *
+      * @note Per listener statistics (including the time spent in each handler) are held in the MicroBitListener
+      *       itself, and are available through elementAt(). The listener totals only include current listeners.
+      */
+    void getStatistics(MicroBitMessageBusStatistics &stats);
+
+    /**
+      * Resets the statistics recorded by this message bus, and by each of its listeners.
+      */
+    void resetStatistics();
+#endif
+
 	private:
 
     MicroBitListener            *listeners;		    // Chain of active listeners.
-    MicroBitEventQueueItem      *evt_queue_head;    // Head of queued events to be processed.
-    MicroBitEventQueueItem      *evt_queue_tail;    // Tail of queued events to be processed.
+    MicroBitListener            **listenerIndex;    // The first listener in the chain for each distinct ID, in increasing order of ID.
+    uint16_t                    listenerIndexSize;  // The number of entries in listenerIndex.
+    MicroBitEvent               evt_queue[MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH];   // Ring of queued events to be processed.
+    uint16_t                    evt_queue_head;     // Index of the oldest event in the ring.
     uint16_t                    nonce_val;          // The last nonce issued.
     uint16_t                    queueLength;        // The number of events currently waiting to be processed.
+    uint16_t                    deletionsPending;   // The number of listeners marked MESSAGE_BUS_LISTENER_DELETING.
+    bool                        batchPending;       // true if events are waiting in the queue of a MESSAGE_BUS_LISTENER_BATCH listener.
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    MicroBitEvent               priority_queue[MESSAGE_BUS_PRIORITY_QUEUE_DEPTH];   // Ring of queued priority events, delivered ahead of evt_queue.
+    uint16_t                    priority_queue_head;    // Index of the oldest event in the priority ring.
+    uint16_t                    priorityQueueLength;    // The number of events currently waiting in the priority ring.
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+    MicroBitEvent               irq_queue[MESSAGE_BUS_IRQ_QUEUE_DEPTH];   // Ring of events raised in interrupt context, waiting to be drained.
+    volatile uint8_t            irq_queue_head;     // Index of the next free slot in irq_queue. Written in interrupt context only.
+    volatile uint8_t            irq_queue_tail;     // Index of the oldest event in irq_queue. Written in thread context only.
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    uint32_t                    statSent;           // The number of events sent to the bus.
+    uint32_t                    statQueued;         // The number of events added to the queue.
+    uint32_t                    statCoalesced;      // The number of events coalesced with one already in the queue.
+    uint32_t                    statDropped;        // The number of events dropped because the queue was full.
+    uint32_t                    statPrioritised;    // The number of events added to the priority queue.
+    uint16_t                    statPeakQueueLength;// The greatest number of queued events seen, over both queues.
+#endif
 
     /**
       * Cleanup any MicroBitListeners marked for deletion from the list.
@@ -154,6 +225,44 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     int deleteMarkedListeners();
 
+    /**
+      * Determines if the given event may be coalesced with an identical event already waiting in the queue.
+      *
+      * @param evt The event to test.
+      *
+      * @return 1 if every listener that would process the event in the standard pass is flagged
+      *         MESSAGE_BUS_LISTENER_COALESCE, 0 otherwise.
+      */
+    int isCoalescing(MicroBitEvent &evt);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    /**
+      * Determines if the given event should be held in the priority queue.
+      *
+      * @param evt The event to test.
+      *
+      * @return 1 if the event was raised by a button, the radio or the serial port, or if a listener that would
+      *         process it in the standard pass is flagged MESSAGE_BUS_LISTENER_PRIORITY. 0 otherwise.
+      */
+    int isPriority(MicroBitEvent &evt);
+#endif
+
+    /**
+      * Rebuilds the index used to locate the listeners for a given ID, following a change to the chain of listeners.
+      *
+      * If memory cannot be allocated for the index, process() falls back to walking the chain.
+      */
+    void rebuildListenerIndex();
+
+    /**
+      * Locates the first listener in the chain registered for the given ID.
+      *
+      * @param id The ID to search for. Must not be MICROBIT_ID_ANY.
+      *
+      * @return The first listener registered for the ID, or NULL if there are none.
+      */
+    MicroBitListener *findListeners(uint16_t id);
+
     /**
       * Queue the given event for processing at a later time.
       * Add the given event at the tail of our queue.
@@ -162,18 +271,44 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     void queueEvent(MicroBitEvent &evt);
 
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+    /**
+      * Records an event raised in interrupt context, to be delivered once the bus is next serviced in thread context.
+      *
+      * @param evt The event to record.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the ring is full and the event was dropped.
+      */
+    int queueEventFromIRQ(MicroBitEvent &evt);
+
+    /**
+      * Passes any events raised in interrupt context on to the event queue, in the order they were raised,
+      * running their urgent listeners as it does so.
+      */
+    void drainIRQEvents();
+#endif
+
     /**
       * Extract the next event from the front of the event queue (if present).
+      * Events waiting in the priority queue are always extracted first.
+      *
+      * @param evt Updated with the event at the front of the queue.
       *
-      * @return a pointer to the MicroBitEventQueueItem that is at the head of the list.
+      * @return 1 if an event was extracted, 0 if the queue is empty.
+      */
+    int dequeueEvent(MicroBitEvent &evt);
+
+    /**
+      * Delivers the events waiting for each MESSAGE_BUS_LISTENER_BATCH listener, in a single call per listener.
       */
-    MicroBitEventQueueItem* dequeueEvent();
+    void deliverBatches();
 
     /**
       * Periodic callback from MicroBit.
       *
       * Process at least one event from the event queue, if it is not empty.
       * We then continue processing events until something appears on the runqueue.
+      * Events in the priority queue are processed first, including any that arrive whilst we are running.
       */
     virtual void idleTick();
 };
@@ -0,0 +1,199 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_MOTOR_CONTROLLER_H
+#define MICROBIT_MOTOR_CONTROLLER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+#include "MicroBitPin.h"
+#include "MicroBitQuadratureDecoder.h"
+#include "MicroBitSystemTimer.h"
+
+// The default and shortest periods of the control loop, in microseconds.
+#define MICROBIT_MOTOR_DEFAULT_PERIOD_US        2000
+#define MICROBIT_MOTOR_MIN_PERIOD_US            500
+
+// The gains are fixed point, with this many fractional bits.
+#define MICROBIT_MOTOR_GAIN_SHIFT               8
+
+// The default position error, in encoder counts, within which the setpoint is considered reached.
+#define MICROBIT_MOTOR_DEFAULT_TOLERANCE        2
+
+/**
+  * Events raised by MicroBitMotorController
+  */
+#define MICROBIT_MOTOR_EVT_SETPOINT_REACHED     1       // The position has come within tolerance of the setpoint.
+#define MICROBIT_MOTOR_EVT_STALLED              2       // The output has been saturated with no movement for over a second.
+
+/**
+  * Class definition for MicroBitMotorController.
+  *
+  * Drives a DC motor through an H bridge to a position or velocity setpoint, using feedback from a quadrature encoder.
+  * An integer PID loop runs at a fixed rate from a system timer event, in interrupt context, so that it doesn't
+  * depend on scheduling between fibers.
+  *
+  * The bridge is driven with PWM on one of two pins, according to direction, so both pins should be left to
+  * the controller while it is running. Both pins use DynamicPwm channels, which are allocated by start().
+  */
+class MicroBitMotorController : public MicroBitComponent
+{
+    MicroBitQuadratureDecoder   &decoder;
+    MicroBitPin                 &forward;       // PWM output driving the motor forward.
+    MicroBitPin                 &reverse;       // PWM output driving the motor in reverse.
+    SystemTimerEvent            loopEvent;
+
+    uint32_t                    period;         // The period of the control loop, in microseconds.
+    int32_t                     kp, ki, kd;     // The gains, as fixed point values.
+    int32_t                     tolerance;
+
+    int64_t                     target;         // The position setpoint, in encoder counts.
+    int32_t                     velocity;       // The velocity setpoint, in counts per second, or 0 to hold position.
+    int32_t                     remainder;      // The fractional counts by which target is yet to advance, in millionths.
+    int64_t                     integral;
+    int32_t                     lastError;
+    int32_t                     output;         // The last output level, from -MICROBIT_PIN_MAX_OUTPUT to MICROBIT_PIN_MAX_OUTPUT.
+    int64_t                     lastPosition;
+    uint32_t                    stallTime;      // The time the output has been saturated without movement, in microseconds.
+    bool                        reached;
+
+    /**
+      * Runs one iteration of the control loop, and schedules the next.
+      */
+    void update();
+
+    /**
+      * Drives the bridge at the given level.
+      *
+      * @param level the output, from -MICROBIT_PIN_MAX_OUTPUT to MICROBIT_PIN_MAX_OUTPUT.
+      */
+    void drive(int32_t level);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create a motor controller, which is stopped until start() is called.
+      *
+      * @param decoder the decoder reading the motor's encoder.
+      *
+      * @param forward the pin driving the motor forward.
+      *
+      * @param reverse the pin driving the motor in reverse.
+      *
+      * @param id the ID of the new MicroBitMotorController object. Defaults to MICROBIT_ID_MOTOR_CONTROLLER.
+      *
+      * @code
+      * MicroBitQuadratureDecoder qdec(uBit.io.P0, uBit.io.P1, QDEC_USE_INTERRUPT);
+      * MicroBitMotorController motor(qdec, uBit.io.P13, uBit.io.P14);
+      * @endcode
+      */
+    MicroBitMotorController(MicroBitQuadratureDecoder &decoder, MicroBitPin &forward, MicroBitPin &reverse, uint16_t id = MICROBIT_ID_MOTOR_CONTROLLER);
+
+    /**
+      * Sets the gains of the PID loop. Each is a fixed point value with MICROBIT_MOTOR_GAIN_SHIFT fractional bits,
+      * so 256 is a gain of 1, and the output is in the range of MicroBitPin::setAnalogValue().
+      *
+      * @param kp the proportional gain, per count of error.
+      *
+      * @param ki the integral gain, per count of error per loop period.
+      *
+      * @param kd the derivative gain, per count of change in error per loop period.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if any gain is negative.
+      */
+    int setGains(int32_t kp, int32_t ki, int32_t kd);
+
+    /**
+      * Sets the period of the control loop. This takes effect from the next iteration.
+      *
+      * @param period the period, in microseconds.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is less than MICROBIT_MOTOR_MIN_PERIOD_US.
+      */
+    int setPeriodUs(uint32_t period);
+
+    /**
+      * Sets the position error within which the setpoint is considered reached.
+      *
+      * @param counts the tolerance, in encoder counts.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if counts is negative.
+      */
+    int setTolerance(int32_t counts);
+
+    /**
+      * Moves the motor to the given position, and holds it there.
+      * MICROBIT_MOTOR_EVT_SETPOINT_REACHED is raised when it first arrives.
+      *
+      * @param position the position, in encoder counts.
+      */
+    void setPosition(int64_t position);
+
+    /**
+      * Turns the motor at the given speed, by moving the position setpoint steadily.
+      *
+      * @param velocity the speed, in encoder counts per second. Use 0 to hold the current setpoint.
+      */
+    void setVelocity(int32_t velocity);
+
+    /**
+      * Determines the position setpoint.
+      *
+      * @return the setpoint, in encoder counts.
+      */
+    int64_t getTarget();
+
+    /**
+      * Determines the level the motor is being driven at.
+      *
+      * @return the level, from -MICROBIT_PIN_MAX_OUTPUT to MICROBIT_PIN_MAX_OUTPUT, negative in reverse.
+      */
+    int getOutput();
+
+    /**
+      * Starts the control loop, holding the motor at its current position.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_BUSY if already running, or MICROBIT_NOT_SUPPORTED if either pin
+      *         has no analog output.
+      */
+    int start();
+
+    /**
+      * Stops the control loop, and stops driving the motor.
+      */
+    void stop();
+
+    /**
+      * Destructor for MicroBitMotorController.
+      *
+      * Ensures that stop() gets called if necessary.
+      */
+    ~MicroBitMotorController();
+};
+
+#endif
@@ -37,6 +37,7 @@ DEALINGS IN THE SOFTWARE.
 #define IO_STATUS_TOUCH_IN                  0x10        // Pin is a makey-makey style touch sensor
 #define IO_STATUS_EVENT_ON_EDGE             0x20        // Pin will generate events on pin change
 #define IO_STATUS_EVENT_PULSE_ON_EDGE       0x40        // Pin will generate events on pin change
+#define IO_STATUS_EVENT_PULSE_CAPTURE       0x80        // Pin will generate events on pin change, timed in hardware
 
 //#defines for each edge connector pin
 #define MICROBIT_PIN_P0                     P0_3        //P0 is the left most pad (ANALOG/DIGITAL) used to be P0_3 on green board
@@ -69,6 +70,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_PIN_EVENT_ON_EDGE          1
 #define MICROBIT_PIN_EVENT_ON_PULSE         2
 #define MICROBIT_PIN_EVENT_ON_TOUCH         3
+#define MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE 4
 
 #define MICROBIT_PIN_EVT_RISE               2
 #define MICROBIT_PIN_EVT_FALL               3
@@ -99,6 +101,15 @@ class MicroBitPin : public MicroBitComponent
 {
     // The mbed object looking after this pin at any point in time (untyped due to dynamic behaviour).
     void *pin;
+
+    // Storage for the small, frequently swapped mbed objects, which are constructed in place rather than on the heap.
+    union
+    {
+        uint32_t            align;
+        uint8_t             digitalIn[sizeof(DigitalIn)];
+        uint8_t             digitalOut[sizeof(DigitalOut)];
+        uint8_t             analogIn[sizeof(AnalogIn)];
+    } storage;
     PinCapability capability;
     uint8_t pullMode;
 
@@ -144,6 +155,14 @@ class MicroBitPin : public MicroBitComponent
       */
     int enableRiseFallEvents(int eventType);
 
+    /**
+      * This member function will construct a PulseCaptureIn instance, which measures the width
+      * of each pulse on the pin in hardware.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_BUSY if another pin is already in this mode.
+      */
+    int enablePulseCapture();
+
     /**
       * If this pin is in a mode where the pin is generating events, it will destruct
       * the current instance attached to this MicroBitPin instance.
@@ -373,10 +392,11 @@ class MicroBitPin : public MicroBitComponent
       *
       * MICROBIT_PIN_EVENT_ON_EDGE - Configures this pin to a digital input, and generates events whenever a rise/fall is detected on this pin. (MICROBIT_PIN_EVT_RISE, MICROBIT_PIN_EVT_FALL)
       * MICROBIT_PIN_EVENT_ON_PULSE - Configures this pin to a digital input, and generates events where the timestamp is the duration that this pin was either HI or LO. (MICROBIT_PIN_EVT_PULSE_HI, MICROBIT_PIN_EVT_PULSE_LO)
+      * MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE - As MICROBIT_PIN_EVENT_ON_PULSE, but each edge is timestamped in hardware, so durations are exact to the microsecond. Only one pin may be in this mode at a time.
       * MICROBIT_PIN_EVENT_ON_TOUCH - Configures this pin as a makey makey style touch sensor, in the form of a MicroBitButton. Normal button events will be generated using the ID of this pin.
       * MICROBIT_PIN_EVENT_NONE - Disables events for this pin.
       *
-      * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
+      * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
       *
       * @code
       * MicroBitMessageBus bus;
@@ -392,10 +412,11 @@ class MicroBitPin : public MicroBitComponent
       * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_PULSE_HI, onPulse, MESSAGE_BUS_LISTENER_IMMEDIATE)
       * @endcode
       *
-      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the given eventype does not match
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the given eventype does not match, or MICROBIT_BUSY
+      *        if another pin is already in the MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE mode.
       *
       * @note In the MICROBIT_PIN_EVENT_ON_PULSE mode, the smallest pulse that was reliably detected was 85us, around 5khz. If more precision is required,
-      *       please use the InterruptIn class supplied by ARM mbed.
+      *       please use the MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE mode.
       */
     int eventOn(int eventType);
 };
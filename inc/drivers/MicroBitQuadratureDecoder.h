@@ -34,6 +34,10 @@ DEALINGS IN THE SOFTWARE.
 #define QDEC_USE_SYSTEM_TICK                0x01        // Use systemTick() to keep position up to date.
 #define QDEC_USE_DEBOUNCE                   0x02        // Use input debounce feature.
 #define QDEC_LED_ACTIVE_LOW                 0x04        // Drive LED pin low to activate.
+#define QDEC_USE_INTERRUPT                  0x08        // Use the REPORTRDY and ACCOF interrupts to keep position up to date.
+
+// The interval over which getVelocity() measures the change in position, in microseconds.
+#define QDEC_VELOCITY_WINDOW_US             20000
 
 /**
   * Class definition for MicroBit Quadrature decoder.
@@ -48,11 +52,26 @@ class MicroBitQuadratureDecoder : public MicroBitComponent
     MicroBitPin*    LED;                // LED output to assert while decoding
     uint32_t        samplePeriod = 128; // Minimum sampling period allowed
     uint16_t        faults = 0;         // Double-transition counter
+    uint16_t        overflows = 0;      // Accumulator overflow counter
+    uint64_t        timestamp = 0;      // Time of the last poll(), in microseconds
+    int64_t         velocityPosition = 0; // Position at the start of the current velocity window
+    uint64_t        velocityTime = 0;   // Time at the start of the current velocity window, in microseconds
+    int32_t         velocity = 0;       // Counts per second over the last complete velocity window
     uint8_t         LEDDelay = 0;       // power-up time for LED, in microseconds
     uint8_t         flags;
 
+    /**
+      * Updates the velocity estimate, if the current window is complete.
+      * Must be called with interrupts disabled.
+      *
+      * @param now the current time, in microseconds.
+      */
+    void updateVelocity(uint64_t now);
+
     public:
 
+    static MicroBitQuadratureDecoder *instance; // The instance attached to the hardware, if any.
+
     /**
       * Constructor.
       * Create a software abstraction of the quadrature decoder.
@@ -117,7 +136,9 @@ class MicroBitQuadratureDecoder : public MicroBitComponent
       * several motors with their own encoders if they run only at different
       * times.
       *
-      * While the hardware is active, `poll()` must be called
+      * While the hardware is active, `poll()` must be called, unless
+      * QDEC_USE_INTERRUPT is set, in which case the position is kept up to
+      * date by the QDEC interrupt.
       *
       * @return MICROBIT_OK on success, MICROBIT_BUSY if the hardware is already attached to another instance, or MICROBIT_INVALID_PARAMETER if the configuration is invalid.
       */
@@ -138,12 +159,32 @@ class MicroBitQuadratureDecoder : public MicroBitComponent
       */
     virtual void poll();
 
+    /**
+      * Interrupt service routine for the QDEC. Accumulates the hardware count into the position on REPORTRDY,
+      * and counts any accumulator overflows.
+      */
+    void interruptHandler();
+
     /**
       * Read the absolute position of the encoder at last call to `poll()`.
       *
       * @return current decoder position.
       */
-    int64_t getPosition() { return position; }
+    int64_t getPosition();
+
+    /**
+      * Read the time of the last call to `poll()`, which is the time at which getPosition() was valid.
+      *
+      * @return the time of the last poll, in microseconds since power on.
+      */
+    uint64_t getTimestamp();
+
+    /**
+      * Read the speed of the encoder, measured over the last QDEC_VELOCITY_WINDOW_US microseconds.
+      *
+      * @return the velocity in encoder counts per second, positive or negative according to direction.
+      */
+    int32_t getVelocity();
 
     /**
       * Reset the position to a known value.
@@ -167,6 +208,16 @@ class MicroBitQuadratureDecoder : public MicroBitComponent
       */
     int64_t getCountFaults() { return faults; }
 
+    /**
+      * Read the number of times the hardware accumulator has overflowed since start().
+      *
+      * Any counts that arrive while the accumulator is full are lost, so
+      * overflows imply that poll() is being called too infrequently.
+      *
+      * @return total number of overflows.
+      */
+    int64_t getCountOverflows() { return overflows; }
+
     /**
       * Destructor for MicroBitQuadratureDecoder.
       *
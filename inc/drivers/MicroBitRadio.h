@@ -34,6 +34,9 @@ struct FrameBuffer;
 #include "PacketBuffer.h"
 #include "MicroBitRadioDatagram.h"
 #include "MicroBitRadioEvent.h"
+#include "MicroBitRadioBulk.h"
+#include "MicroBitRadioReliable.h"
+#include "MicroBitRadioTime.h"
 
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -49,9 +52,9 @@ struct FrameBuffer;
  * TODO: Meshing should also be considered - again a GLOSSY approach may be effective here, and highly complementary to
  * the master/slave arachitecture of BLE.
  *
- * TODO: This implementation only operates whilst the BLE stack is disabled. The nrf51822 provides a timeslot API to allow
- * BLE to cohabit with other protocols. Future work to allow this colocation would be benefical, and would also allow for the
- * creation of wireless BLE bridges.
+ * NOTE: By default, this implementation only operates whilst the BLE stack is disabled. With MICROBIT_RADIO_TIMESLOTS enabled,
+ * the radio instead shares the RADIO module with BLE, through the SoftDevice's timeslot API, and sends and receives only within
+ * the timeslots it is granted (see setTimeslots()).
  *
  * NOTE: This API does not contain any form of encryption, authentication or authorization. It's purpose is solely for use as a
  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
@@ -60,6 +63,13 @@ struct FrameBuffer;
 
 // Status Flags
 #define MICROBIT_RADIO_STATUS_INITIALISED       0x0001
+#define MICROBIT_RADIO_STATUS_TIMESLOTS         0x0002  // The RADIO module is shared with the BLE stack, and used only within SoftDevice timeslots.
+#define MICROBIT_RADIO_STATUS_TIMESTAMPS        0x0004  // Frames are timestamped as their address is sent or received.
+
+// Transmit states
+#define MICROBIT_RADIO_TX_IDLE                  0       // The radio is receiving.
+#define MICROBIT_RADIO_TX_STARTING              1       // The receiver is being disabled, and the transmitter will ramp up to send the head of the queue.
+#define MICROBIT_RADIO_TX_SENDING               2       // The head of the queue is being sent.
 
 // Default configuration values
 #define MICROBIT_RADIO_BASE_ADDRESS             0x75626974
@@ -67,14 +77,53 @@ struct FrameBuffer;
 #define MICROBIT_RADIO_DEFAULT_TX_POWER         6
 #define MICROBIT_RADIO_MAX_PACKET_SIZE          32
 #define MICROBIT_RADIO_HEADER_SIZE              4
+
+// FrameBuffers allocated with new are preceded by enough space to complete a PacketData header, so that a received
+// frame can be adopted by a PacketBuffer in place. The frame header then occupies the PacketBuffer's headroom.
+#define MICROBIT_RADIO_FRAME_HEADROOM           (sizeof(PacketData) - MICROBIT_PACKET_BUFFER_HEADROOM)
+#ifndef MICROBIT_RADIO_MAXIMUM_RX_BUFFERS
 #define MICROBIT_RADIO_MAXIMUM_RX_BUFFERS       4
+#endif
+#define MICROBIT_RADIO_MAX_GROUPS               8       // The RADIO hardware matches up to 8 addresses. One is our own group, the rest are extra groups.
+
+// Data rates, in kbit/s
+#define MICROBIT_RADIO_DATA_RATE_250KBIT        250     // Four times the airtime of 1Mbit, for better range.
+#define MICROBIT_RADIO_DATA_RATE_1MBIT          1000
+#define MICROBIT_RADIO_DATA_RATE_2MBIT          2000    // Half the airtime of 1Mbit, for fewer collisions between busy micro:bits.
 
 // Known Protocol Numbers
 #define MICROBIT_RADIO_PROTOCOL_DATAGRAM        1       // A simple, single frame datagram. a little like UDP but with smaller packets. :-)
 #define MICROBIT_RADIO_PROTOCOL_EVENTBUS        2       // Transparent propogation of events from one micro:bit to another.
+#define MICROBIT_RADIO_PROTOCOL_BULK            3       // Messages larger than a single frame, sent as numbered fragments and reassembled on receipt.
+#define MICROBIT_RADIO_PROTOCOL_RELIABLE        4       // An acknowledged, ordered stream of packets between two micro:bits, a little like TCP.
+#define MICROBIT_RADIO_PROTOCOL_TIME            5       // Beacons used to keep a network clock, shared by a group of micro:bits.
 
 // Events
 #define MICROBIT_RADIO_EVT_DATAGRAM             1       // Event to signal that a new datagram has been received.
+#define MICROBIT_RADIO_EVT_BULK                 2       // Event to signal that a new bulk message has been completely received.
+#define MICROBIT_RADIO_EVT_RELIABLE             3       // Event to signal that a new reliable packet has been received.
+#define MICROBIT_RADIO_EVT_RELIABLE_ACK         4       // Event to signal that reliable packets have been acknowledged, or abandoned.
+#define MICROBIT_RADIO_EVT_RELIABLE_FAILED      5       // Event to signal that reliable packets were abandoned after too many retransmissions.
+#define MICROBIT_RADIO_EVT_RELIABLE_TIMEOUT     6       // Internal event, used to retransmit unacknowledged reliable packets.
+#define MICROBIT_RADIO_EVT_TIME_SYNC            7       // Event to signal that the network clock has been synchronised with a reference.
+#define MICROBIT_RADIO_EVT_TIME_BEACON          8       // Internal event, used to send time beacons.
+
+// Link statistics
+#define MICROBIT_RADIO_STATISTICS_PROTOCOLS     4       // The number of protocol numbers counted separately. Higher numbers share the last count.
+#define MICROBIT_RADIO_RSSI_AVERAGE_SHIFT       3       // Each packet moves the RSSI average 1/(2^n) of the way towards its own RSSI.
+
+/**
+  * Counts of the packets seen by the radio receiver, since it was enabled or the statistics were last reset.
+  */
+struct MicroBitRadioStatistics
+{
+    uint32_t        received;                                       // Packets received with a valid CRC, including those dropped.
+    uint32_t        crcFailures;                                    // Packets discarded because their CRC did not match.
+    uint32_t        overflows;                                      // Packets dropped because the receive queue was full.
+    uint32_t        channelBusy;                                    // Packets not sent because the channel was never clear (see MICROBIT_RADIO_LISTEN_BEFORE_TALK).
+    uint32_t        protocols[MICROBIT_RADIO_STATISTICS_PROTOCOLS]; // Packets queued, by protocol number.
+    int             rssiAverage;                                    // The running average RSSI of received packets, in -dbm.
+};
 
 
 struct FrameBuffer
@@ -87,20 +136,120 @@ struct FrameBuffer
     uint8_t         payload[MICROBIT_RADIO_MAX_PACKET_SIZE];    // User / higher layer protocol data
     FrameBuffer     *next;                              // Linkage, to allow this and other protocols to queue packets pending processing.
     int             rssi;                               // Received signal strength of this frame.
+    uint32_t        timestamp;                          // The low 32 bits of the system time at which the address of this frame was received, if timestamping is enabled.
+
+    /**
+      * Allocates memory for a FrameBuffer, from the radio's pool of frame buffers where possible.
+      * The memory is preceded by MICROBIT_RADIO_FRAME_HEADROOM bytes, so it may later be adopted by a PacketBuffer.
+      * This is safe to call from interrupt context.
+      *
+      * @param size The amount of memory required.
+      *
+      * @return A pointer to the memory.
+      */
+    static void *operator new(size_t size);
+
+    /**
+      * Releases the memory held by a FrameBuffer, back to the pool it came from where appropriate.
+      *
+      * @param p The memory to release.
+      */
+    static void operator delete(void *p);
 };
 
 
 class MicroBitRadio : MicroBitComponent
 {
     uint8_t                 group;      // The radio group to which this micro:bit belongs.
-    uint8_t                 queueDepth; // The number of packets in the receiver queue.
+    uint8_t                 groups[MICROBIT_RADIO_MAX_GROUPS];  // The group matched by each hardware address. groups[0] is always our own group.
+    uint8_t                 groupMask;  // A bitmap of the hardware addresses in use, as written to RXADDRESSES.
+    int                     dataRate;   // The data rate used on air, in kbit/s.
+    uint8_t                 band;       // The frequency band, in MHz above 2400MHz.
+    uint8_t                 txPower;    // The transmit power level, 0..7.
     int                     rssi;
-    FrameBuffer             *rxQueue;   // A linear list of incoming packets, queued awaiting processing.
-    FrameBuffer             *rxBuf;     // A pointer to the buffer being actively used by the RADIO hardware.
+    volatile uint8_t        inTimeslot; // Set whilst the radio holds a SoftDevice timeslot, and may use the RADIO module.
+    volatile uint32_t       addressTime; // The low 32 bits of the system time at which the address of the last frame was sent or received.
+
+    // A ring of preallocated receive buffers. rxRing[rxHead] is being actively used by the RADIO hardware,
+    // and the buffers from rxTail up to rxHead hold incoming packets, queued awaiting processing.
+    FrameBuffer             *rxRing[MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1];
+    volatile uint8_t        rxHead;
+    volatile uint8_t        rxTail;
+
+    // A linear list of packets awaiting transmission, sent from the radio interrupt.
+    FrameBuffer             *txQueue;
+    volatile uint8_t        txQueueLength;
+    volatile uint8_t        txState;
+
+    MicroBitRadioStatistics stats;       // Counts of received, failed and dropped packets.
+    int                     rssiAverage; // The running average RSSI, scaled up by 2^MICROBIT_RADIO_RSSI_AVERAGE_SHIFT.
+
+    /**
+      * Programs the RADIO hardware to match the addresses of our group, and any groups added with addGroup().
+      */
+    void setAddresses();
+
+    /**
+      * Programs the RADIO hardware with our frequency, data rate, addresses and packet format,
+      * ready for startReceiver(). This is done once when the radio is enabled, or at the start of every timeslot.
+      */
+    void configureTransceiver();
+
+    /**
+      * Determines if the RADIO module may be used from thread context.
+      *
+      * @return true if the radio has the RADIO module to itself, or holds a timeslot.
+      */
+    bool ownsTransceiver();
+
+    /**
+      * Protects the transmit queue and statistics from the radio interrupt, or from the timeslot signal handler
+      * if the RADIO module is shared with the BLE stack.
+      */
+    void lock();
+
+    /**
+      * Allows the radio interrupt or timeslot signal handler to run again.
+      */
+    void unlock();
+
+    /**
+      * Turns off the transceiver, waiting until it has done so.
+      *
+      * @note the radio interrupt should be disabled by the caller.
+      */
+    void disableTransceiver();
+
+    /**
+      * Turns on the receiver, to listen for the next packet.
+      *
+      * This does not wait for the receiver to ramp up. Reception starts as soon as it is ready,
+      * through the READY_START short.
+      */
+    void startReceiver();
+
+    /**
+      * Waits until every queued packet has been transmitted.
+      *
+      * @note this must not be called in interrupt context, or whilst the radio interrupt is disabled.
+      */
+    void waitForTransmit();
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_LISTEN_BEFORE_TALK)
+    /**
+      * Performs a clear channel assessment, by measuring the signal strength on our frequency.
+      *
+      * @return true if the signal is weaker than MICROBIT_RADIO_LBT_THRESHOLD, false if another device is transmitting.
+      */
+    bool channelClear();
+#endif
 
     public:
     MicroBitRadioDatagram   datagram;   // A simple datagram service.
     MicroBitRadioEvent      event;      // A simple event handling service.
+    MicroBitRadioBulk       bulk;       // A service for messages larger than a single packet.
+    MicroBitRadioReliable   reliable;   // An acknowledged stream of packets to another micro:bit.
+    MicroBitRadioTime       time;       // A network clock, shared with other micro:bits.
     static MicroBitRadio    *instance;  // A singleton reference, used purely by the interrupt service routine.
 
     /**
@@ -128,10 +277,34 @@ class MicroBitRadio : MicroBitComponent
       * @param band a frequency band in the range 0 - 100. Each step is 1MHz wide, based at 2400MHz.
       *
       * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the value is out of range,
-      *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
       */
     int setFrequencyBand(int band);
 
+    /**
+      * Change the data rate the radio sends and receives at.
+      *
+      * All micro:bits wishing to communicate must use the same data rate. If the radio is not yet enabled,
+      * the data rate is applied when it is.
+      *
+      * @param rate MICROBIT_RADIO_DATA_RATE_250KBIT, MICROBIT_RADIO_DATA_RATE_1MBIT or MICROBIT_RADIO_DATA_RATE_2MBIT.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the rate is not supported,
+      *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+      *
+      * @code
+      * radio.setDataRate(MICROBIT_RADIO_DATA_RATE_2MBIT);
+      * @endcode
+      */
+    int setDataRate(int rate);
+
+    /**
+      * Retrieves the data rate the radio sends and receives at.
+      *
+      * @return the data rate, in kbit/s.
+      */
+    int getDataRate();
+
     /**
       * Retrieve a pointer to the currently allocated receive buffer. This is the area of memory
       * actively being used by the radio hardware to store incoming data.
@@ -142,9 +315,10 @@ class MicroBitRadio : MicroBitComponent
 
     /**
       * Attempt to queue a buffer received by the radio hardware, if sufficient space is available.
+      * The radio hardware moves on to the next preallocated buffer in the receive ring, so no memory
+      * is allocated in interrupt context.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if a replacement receiver buffer
-      *         could not be allocated (either by policy or memory exhaustion).
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the receive ring is full.
       */
     int queueRxBuf();
 
@@ -168,29 +342,172 @@ class MicroBitRadio : MicroBitComponent
       */
     int getRSSI();
 
+    /**
+      * Records a packet that was discarded because its CRC did not match.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void crcFailed();
+
+    /**
+      * Begins transmitting the packet at the head of the transmit queue, if the radio is receiving.
+      *
+      * @return true if transmission has begun, false if the queue is empty or the radio is already transmitting.
+      *
+      * @note should only be called from RADIO_IRQHandler, or with the radio interrupt disabled...
+      */
+    bool startTransmit();
+
+    /**
+      * Determines if the radio is transmitting queued packets.
+      *
+      * @return true if packets are being transmitted, false if the radio is receiving.
+      */
+    bool isTransmitting()
+    {
+        return txState != MICROBIT_RADIO_TX_IDLE;
+    }
+
+    /**
+      * Called when the transceiver has been disabled during a transmission. Moves on to the next queued
+      * packet, or back to receiving once the queue is empty.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void transmitDisabled();
+
+    /**
+      * Enables or disables timestamping of frames. When enabled, the radio is interrupted as the address of each frame
+      * is sent or received, and records the system time. Received frames carry this in their timestamp field.
+      *
+      * @param enabled true to timestamp frames.
+      *
+      * @return MICROBIT_OK.
+      */
+    int setTimestamping(bool enabled);
+
+    /**
+      * Records the time at which the address of the frame being sent or received went by, if timestamping is enabled.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void timestampFrame();
+
+    /**
+      * Called at the start of each timeslot granted by the SoftDevice. Reprograms the RADIO module,
+      * starts listening, and sends anything queued since the last timeslot.
+      *
+      * @note should only be called from the timeslot signal handler...
+      */
+    void timeslotStart();
+
+    /**
+      * Called shortly before the end of each timeslot, to hand the RADIO module back to the SoftDevice.
+      * A packet still being sent is sent again from the start of the next timeslot.
+      *
+      * @return true if another timeslot should be requested, or false if the radio is being disabled.
+      *
+      * @note should only be called from the timeslot signal handler...
+      */
+    bool timeslotEnd();
+
+    /**
+      * Called with each SoC event raised by the SoftDevice. Requests a further timeslot if the one requested
+      * could not be granted.
+      *
+      * @param evt The event identifier.
+      */
+    void timeslotEvent(uint32_t evt);
+
+    /**
+      * Sets the length and interval of the timeslots used when the radio is shared with the BLE stack.
+      * The share of airtime given to the radio is length / period. Changes take effect from the next timeslot requested.
+      *
+      * @param length The length of each timeslot, in microseconds.
+      *
+      * @param period The interval between the start of successive timeslots, in microseconds.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the length is too short to send a packet or is not
+      *         shorter than the period, or MICROBIT_NOT_SUPPORTED if MICROBIT_RADIO_TIMESLOTS is not enabled.
+      *
+      * @code
+      * radio.setTimeslots(10000, 20000);   // Give the radio half of the airtime.
+      * @endcode
+      */
+    int setTimeslots(uint32_t length, uint32_t period);
+
+    /**
+      * Retrieves counts of the packets seen by the receiver, since it was enabled or resetStatistics() was last called.
+      *
+      * @param statistics the structure to fill in.
+      *
+      * @return MICROBIT_OK.
+      *
+      * @code
+      * MicroBitRadioStatistics s;
+      * radio.getStatistics(s);
+      * if (s.overflows > 0)
+      *     // consider a larger MICROBIT_RADIO_MAXIMUM_RX_BUFFERS...
+      * @endcode
+      */
+    int getStatistics(MicroBitRadioStatistics &statistics);
+
+    /**
+      * Resets all the receiver statistics to zero.
+      */
+    void resetStatistics();
+
     /**
       * Initialises the radio for use as a multipoint sender/receiver
       *
-      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
       */
     int enable();
 
     /**
       * Disables the radio for use as a multipoint sender/receiver.
       *
-      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
       */
     int disable();
 
     /**
       * Sets the radio to listen to packets sent with the given group id.
       *
-      * @param group The group to join. A micro:bit can only listen to one group ID at any time.
+      * @param group The group to join. Packets are sent to this group. Further groups may be listened to with addGroup().
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
       */
     int setGroup(uint8_t group);
 
+    /**
+      * Additionally listens to packets sent with the given group id.
+      *
+      * Groups are matched by the RADIO hardware, so packets from other groups never consume a receive buffer.
+      * Packets received are marked with the group they were sent to. Packets are still sent to the group given to setGroup().
+      *
+      * @param group The group to listen to.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if this micro:bit is already listening to
+      *         MICROBIT_RADIO_MAX_GROUPS groups, or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+      *
+      * @code
+      * radio.setGroup(1);
+      * radio.addGroup(2);    // Receive from groups 1 and 2, and send to group 1.
+      * @endcode
+      */
+    int addGroup(uint8_t group);
+
+    /**
+      * Stops listening to packets sent with the given group id, previously given to addGroup().
+      *
+      * @param group The group to stop listening to.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the group was not added with addGroup(),
+      *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+      */
+    int removeGroup(uint8_t group);
+
     /**
       * A background, low priority callback that is triggered whenever the processor is idle.
       * Here, we empty our queue of received packets, and pass them onto higher level protocol handlers.
@@ -209,7 +526,7 @@ class MicroBitRadio : MicroBitComponent
       * If a data packet is available, then it will be returned immediately to
       * the caller. This call will also dequeue the buffer.
       *
-      * @return The buffer containing the the packet. If no data is available, NULL is returned.
+      * @return The buffer containing the the packet. If no data is available, or no memory is available to replace it, NULL is returned.
       *
       * @note Once recv() has been called, it is the callers responsibility to
       *       delete the buffer when appropriate.
@@ -218,11 +535,15 @@ class MicroBitRadio : MicroBitComponent
 
     /**
       * Transmits the given buffer onto the broadcast radio.
-      * The call will wait until the transmission of the packet has completed before returning.
+      *
+      * The packet is copied onto a queue that is sent from the radio interrupt, so the call returns
+      * as soon as there is space in the queue, without waiting for the packet to be sent.
       *
       * @param data The packet contents to transmit.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the radio is not enabled,
+      *         MICROBIT_NO_RESOURCES if the queue is full and we're in interrupt context,
+      *         or MICROBIT_BUSY if MICROBIT_RADIO_LISTEN_BEFORE_TALK is enabled and the channel was never clear.
       */
     int send(FrameBuffer *buffer);
 };
@@ -0,0 +1,150 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_BULK_H
+#define MICROBIT_RADIO_BULK_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "PacketBuffer.h"
+#include "ManagedString.h"
+
+class MicroBitRadio;
+
+// The size of the header at the start of each fragment.
+// Byte 0 is the message id, byte 1 is the fragment index, and bytes 2-3 hold the total message length, little endian.
+#define MICROBIT_RADIO_BULK_HEADER_SIZE         4
+#define MICROBIT_RADIO_BULK_FRAGMENT_SIZE       (MICROBIT_RADIO_MAX_PACKET_SIZE - MICROBIT_RADIO_BULK_HEADER_SIZE)
+
+// Fragments received are tracked with a 32 bit map, so messages can be no longer than 32 fragments.
+#define MICROBIT_RADIO_BULK_MAX_FRAGMENTS       32
+
+struct RadioBulkMessage;
+
+/**
+  * Provides the ability to broadcast messages larger than a single radio packet to other micro:bits in the vicinity.
+  *
+  * Messages of up to MICROBIT_RADIO_BULK_MAX_SIZE bytes are split into numbered fragments on transmission, and
+  * reassembled on reception. A MICROBIT_RADIO_EVT_BULK event is raised once all the fragments of a message have arrived.
+  *
+  * As packets carry no sender address, only one message is reassembled at a time. A message that is interrupted
+  * by the fragments of another is discarded.
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+class MicroBitRadioBulk
+{
+    MicroBitRadio       &radio;         // The underlying radio module used to send and receive data.
+    uint8_t             txId;           // The id given to the last message sent.
+
+    RadioBulkMessage    *rxMessage;     // The message currently being reassembled, or NULL.
+    uint8_t             rxId;           // The id of the message currently being reassembled.
+    uint32_t            rxMissing;      // A bitmap of the fragments of rxMessage yet to arrive.
+
+    RadioBulkMessage    *rxQueue;       // A linear list of complete messages, queued awaiting processing.
+    uint8_t             rxQueueLength;  // The number of messages in rxQueue.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitRadioBulk which offers the ability
+      * to broadcast messages larger than a single radio packet to other micro:bits in the vicinity.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioBulk(MicroBitRadio &r);
+
+    /**
+      * Destructor.
+      *
+      * Releases any messages that are queued or partially received.
+      */
+    ~MicroBitRadioBulk();
+
+    /**
+      * Retreives a complete message.
+      *
+      * If a message is already available, then it will be returned immediately to the caller
+      * in the form of a PacketBuffer.
+      *
+      * @return the message received, or an empty PacketBuffer if no message is available.
+      */
+    PacketBuffer recv();
+
+    /**
+      * Transmits the given buffer onto the broadcast radio, as a series of fragments.
+      *
+      * The fragments are queued for transmission, so this call returns once the last has been
+      * queued, without waiting for it to be sent.
+      *
+      * @param buffer The message contents to transmit.
+      *
+      * @param len The number of bytes to transmit.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+      */
+    int send(uint8_t *buffer, int len);
+
+    /**
+      * Transmits the given PacketBuffer onto the broadcast radio, as a series of fragments.
+      *
+      * The fragments are queued for transmission, so this call returns once the last has been
+      * queued, without waiting for it to be sent.
+      *
+      * @param data The message contents to transmit.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+      */
+    int send(PacketBuffer data);
+
+    /**
+      * Transmits the given string onto the broadcast radio, as a series of fragments.
+      *
+      * The fragments are queued for transmission, so this call returns once the last has been
+      * queued, without waiting for it to be sent.
+      *
+      * @param data The message contents to transmit.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+      */
+    int send(ManagedString data);
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as a bulk fragment.
+      *
+      * This function adds the fragment to the message being reassembled, and queues the message
+      * for user reception once it is complete.
+      */
+    void packetReceived();
+};
+
+#endif
@@ -86,8 +86,8 @@ class MicroBitRadioDatagram
     /**
       * Transmits the given buffer onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, so this call returns without waiting
+      * for it to be sent.
       *
       * @param buffer The packet contents to transmit.
       *
@@ -101,8 +101,8 @@ class MicroBitRadioDatagram
     /**
       * Transmits the given string onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, so this call returns without waiting
+      * for it to be sent.
       *
       * @param data The packet contents to transmit.
       *
@@ -114,8 +114,8 @@ class MicroBitRadioDatagram
     /**
       * Transmits the given string onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, so this call returns without waiting
+      * for it to be sent.
       *
       * @param data The packet contents to transmit.
       *
@@ -30,6 +30,13 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitRadio.h"
 #include "EventModel.h"
+#include "MicroBitSystemTimer.h"
+
+// Frames of version 1 carry a single MicroBitEvent. Frames of this version carry a batch of events,
+// each packed as a 16 bit source followed by a 16 bit value.
+#define MICROBIT_RADIO_EVENT_BATCH_VERSION      2
+#define MICROBIT_RADIO_EVENT_PACKED_SIZE        4
+#define MICROBIT_RADIO_EVENT_BATCH_SIZE         8       // The number of packed events that fit in MICROBIT_RADIO_MAX_PACKET_SIZE.
 
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -49,6 +56,15 @@ class MicroBitRadioEvent
     bool            suppressForwarding;     // A private flag used to prevent event forwarding loops.
     MicroBitRadio   &radio;                 // A reference to the underlying radio module to use.
 
+    uint8_t             batch[MICROBIT_RADIO_EVENT_BATCH_SIZE * MICROBIT_RADIO_EVENT_PACKED_SIZE];  // Packed events awaiting transmission.
+    volatile uint8_t    batchLength;        // The number of events in batch.
+    SystemTimerEvent    batchTimer;         // Transmits the batch once the coalescing window has passed.
+
+    /**
+      * Transmits any events awaiting transmission as a single frame.
+      */
+    void sendBatch();
+
     public:
 
     /**
@@ -128,7 +144,7 @@ class MicroBitRadioEvent
     /**
       * Protocol handler callback. This is called when the radio receives a packet marked as using the event protocol.
       *
-      * This function process this packet, and fires the event contained inside onto the default EventModel.
+      * This function process this packet, and fires the events contained inside onto the default EventModel, in the order they were sent.
       */
     void packetReceived();
 
@@ -136,6 +152,7 @@ class MicroBitRadioEvent
       * Event handler callback. This is called whenever an event is received matching one of those registered through
       * the registerEvent() method described above. Upon receiving such an event, it is wrapped into
       * a radio packet and transmitted to any other micro:bits in the same group.
+      * Events that follow within MICROBIT_RADIO_EVENT_BATCH_WINDOW microseconds share the same packet.
       */
     void eventReceived(MicroBitEvent e);
 };
@@ -0,0 +1,223 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_RELIABLE_H
+#define MICROBIT_RADIO_RELIABLE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitEvent.h"
+#include "PacketBuffer.h"
+#include "ManagedString.h"
+
+class MicroBitRadio;
+struct FrameBuffer;
+
+// The size of the header at the start of each packet.
+// Byte 0 holds the flags below, byte 1 is the sender's session id, and byte 2 is the sequence number.
+// Acknowledgements carry the sequence number the receiver expects next.
+#define MICROBIT_RADIO_RELIABLE_HEADER_SIZE     3
+#define MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE    (MICROBIT_RADIO_MAX_PACKET_SIZE - MICROBIT_RADIO_RELIABLE_HEADER_SIZE)
+
+// Header flags
+#define MICROBIT_RADIO_RELIABLE_FLAG_ACK        0x01    // The packet is an acknowledgement, rather than data.
+#define MICROBIT_RADIO_RELIABLE_FLAG_SYNC       0x02    // The session starts at sequence number zero, and has not been acknowledged yet.
+
+/**
+  * Provides an acknowledged, ordered stream of packets between two micro:bits, built upon MicroBitRadio.
+  *
+  * Up to MICROBIT_RADIO_RELIABLE_WINDOW packets may be awaiting acknowledgement at once, so a sender can keep
+  * transmitting without waiting a round trip for each packet. If the oldest unacknowledged packet is not acknowledged
+  * within MICROBIT_RADIO_RELIABLE_TIMEOUT microseconds, every unacknowledged packet is sent again (go-back-N).
+  * The receiver only accepts packets in order, and acknowledges each packet it sees with the next sequence number it
+  * expects, so the acknowledgement of a later packet also covers any earlier ones whose acknowledgements were lost.
+  *
+  * The protocol has no addressing, so it is intended for use between exactly two micro:bits. Use a radio group
+  * that no other micro:bits share to keep other traffic off the link.
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+class MicroBitRadioReliable
+{
+    MicroBitRadio       &radio;                                     // The underlying radio module used to send and receive data.
+    bool                listening;                                  // true once our handlers have been registered with the default EventModel.
+
+    FrameBuffer         *txWindow[MICROBIT_RADIO_RELIABLE_WINDOW];  // The packets sent but not yet acknowledged, oldest at txHead.
+    uint8_t             txHead;                                     // The index in txWindow of the oldest unacknowledged packet.
+    uint8_t             txCount;                                    // The number of unacknowledged packets.
+    uint8_t             txBase;                                     // The sequence number of the oldest unacknowledged packet.
+    uint8_t             txSession;                                  // Our session id, changed whenever the sequence restarts.
+    uint8_t             txRetries;                                  // The number of times the window has been resent without progress.
+    bool                txSynced;                                   // true once the receiver has acknowledged a packet in this session.
+    bool                txFailed;                                   // true if packets have been abandoned since the last flush().
+    SystemTimerEvent    retransmitTimer;
+
+    FrameBuffer         *rxQueue;                                   // A linear list of incoming packets, queued awaiting processing.
+    uint8_t             rxQueueLength;
+    uint8_t             rxExpected;                                 // The sequence number of the next packet we will accept.
+    uint8_t             rxSession;                                  // The session id of the sender.
+    bool                rxSynced;                                   // true once a packet has been received from a sender.
+
+    /**
+      * Registers our handlers with the default EventModel, and starts a new session, if that hasn't already been done.
+      */
+    void init();
+
+    /**
+      * Determines how long to wait for an acknowledgement before retransmitting.
+      *
+      * @return MICROBIT_RADIO_RELIABLE_TIMEOUT, lengthened in proportion to the airtime of a packet at data rates below 1Mbit.
+      */
+    uint32_t retransmitTimeout();
+
+    /**
+      * Transmits an acknowledgement of the packets received so far.
+      */
+    void sendAck();
+
+    /**
+      * Processes an acknowledgement, removing the packets it covers from the transmit window.
+      *
+      * @param session The session id the acknowledgement refers to.
+      *
+      * @param next The sequence number the receiver expects next.
+      */
+    void ackReceived(uint8_t session, uint8_t next);
+
+    /**
+      * Abandons every unacknowledged packet, and starts a new session.
+      */
+    void abandon();
+
+    /**
+      * Timer callback, made in interrupt context when the oldest unacknowledged packet is overdue.
+      */
+    void timeout();
+
+    /**
+      * Event handler, called from the scheduler to resend the transmit window after a timeout.
+      */
+    void retransmit(MicroBitEvent);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitRadioReliable which offers an acknowledged, ordered stream
+      * of packets to another micro:bit.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioReliable(MicroBitRadio &r);
+
+    /**
+      * Destructor.
+      *
+      * Releases any packets awaiting acknowledgement or reception.
+      */
+    ~MicroBitRadioReliable();
+
+    /**
+      * Retreives the next packet received, in the order sent.
+      *
+      * If a packet is already available, then it will be returned immediately to the caller
+      * in the form of a PacketBuffer.
+      *
+      * @return the data received, or an empty PacketBuffer if no data is available.
+      */
+    PacketBuffer recv();
+
+    /**
+      * Transmits the given buffer to the other micro:bit.
+      *
+      * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+      * the calling fiber is blocked until an acknowledgement makes room for it.
+      *
+      * @param buffer The packet contents to transmit.
+      *
+      * @param len The number of bytes to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+      *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+      *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      */
+    int send(uint8_t *buffer, int len);
+
+    /**
+      * Transmits the given PacketBuffer to the other micro:bit.
+      *
+      * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+      * the calling fiber is blocked until an acknowledgement makes room for it.
+      *
+      * @param data The packet contents to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+      *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+      *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      */
+    int send(PacketBuffer data);
+
+    /**
+      * Transmits the given string to the other micro:bit.
+      *
+      * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+      * the calling fiber is blocked until an acknowledgement makes room for it.
+      *
+      * @param data The packet contents to transmit.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+      *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+      *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      */
+    int send(ManagedString data);
+
+    /**
+      * Blocks the calling fiber until every packet sent has been acknowledged, or abandoned.
+      *
+      * @return MICROBIT_OK if every packet sent since the last call to flush() was acknowledged, MICROBIT_CANCELLED if
+      *         any were abandoned after MICROBIT_RADIO_RELIABLE_RETRIES attempts, or MICROBIT_BUSY if the scheduler is not running.
+      */
+    int flush();
+
+    /**
+      * Determines the number of packets sent that are yet to be acknowledged.
+      *
+      * @return the number of packets in the transmit window.
+      */
+    int pending();
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as reliable.
+      *
+      * This function processes acknowledgements, and acknowledges and queues data packets for user reception.
+      */
+    void packetReceived();
+};
+
+#endif
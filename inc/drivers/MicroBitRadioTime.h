@@ -0,0 +1,209 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RADIO_TIME_H
+#define MICROBIT_RADIO_TIME_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitEvent.h"
+
+class MicroBitRadio;
+struct FrameBuffer;
+
+// The layout of a beacon. Bytes 0-3 hold the serial number of the reference, byte 4 the sequence number of the beacon,
+// and byte 5 the flags below. Bytes 6-13 hold the time, in microseconds, at which the previous beacon was sent.
+#define MICROBIT_RADIO_TIME_BEACON_SIZE         14
+
+// The largest drift between two clocks we believe, scaled up by 2^24 (500ppm). Crystals differ by tens of ppm.
+#define MICROBIT_RADIO_TIME_MAX_SKEW            8389
+
+// Beacon flags
+#define MICROBIT_RADIO_TIME_FLAG_PREVIOUS       0x01    // The beacon holds the time at which the previous beacon was sent.
+
+/**
+  * Provides a network clock shared by a group of micro:bits, built upon MicroBitRadio.
+  *
+  * One micro:bit acts as the reference, and its system time is the network time. It broadcasts a beacon every
+  * MICROBIT_RADIO_TIME_BEACON_PERIOD microseconds. Each frame is timestamped by the radio interrupt as its address goes
+  * by, which happens at the same moment at the sender and every receiver, so the time taken to queue, send and process
+  * the beacon doesn't matter. The sender can't know when a beacon went until it has been sent, so each beacon carries the
+  * time at which the previous one was sent. Followers compare this with the time they received the previous beacon to
+  * learn the offset between their clock and the reference's, and the change in offset over successive beacons to learn
+  * the drift between them.
+  *
+  * Timestamps are taken from the system timer, so their resolution is that of the system timer (approximately 30us).
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+class MicroBitRadioTime
+{
+    MicroBitRadio       &radio;             // The underlying radio module used to send and receive data.
+    bool                listening;          // true once our handlers have been registered with the default EventModel.
+    bool                isReference;        // true if our system time is the network time, and we send beacons.
+    bool                synchronised;       // true once the offset from the reference's clock is known.
+    SystemTimerEvent    beaconTimer;
+
+    uint8_t             txSeq;              // The sequence number of the next beacon we send.
+    volatile uint8_t    txSentSeq;          // The sequence number of the last beacon sent, as recorded by the radio interrupt.
+    volatile uint32_t   txSentTime;         // The time the last beacon was sent, as recorded by the radio interrupt.
+    volatile bool       txSent;             // true once a beacon has been sent.
+
+    uint32_t            referenceId;        // The serial number of the reference we follow.
+    uint8_t             rxSeq;              // The sequence number of the last beacon received.
+    bool                rxValid;            // true once a beacon has been received from the reference.
+    uint64_t            rxTime;             // The time the last beacon was received, by our clock.
+
+    uint64_t            syncTime;           // The time of the last synchronisation, by our clock.
+    int64_t             offset;             // The network time, less our time, at syncTime.
+    int32_t             skew;               // The rate at which the reference's clock gains on ours, scaled up by 2^24.
+    bool                skewValid;          // true once the skew has been measured.
+
+    /**
+      * Registers our handlers with the default EventModel, if that hasn't already been done.
+      */
+    void init();
+
+    /**
+      * Extends a timestamp taken by the radio interrupt to a 64 bit system time.
+      *
+      * @param timestamp The low 32 bits of the system time, no more than 71 minutes ago.
+      *
+      * @return The system time, in microseconds.
+      */
+    uint64_t extendTime(uint32_t timestamp);
+
+    /**
+      * Timer callback, made in interrupt context when the next beacon is due.
+      */
+    void beaconDue();
+
+    /**
+      * Event handler, called from the scheduler to send a beacon.
+      */
+    void sendBeacon(MicroBitEvent);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of MicroBitRadioTime, which maintains a network clock shared with other micro:bits.
+      *
+      * @param r The underlying radio module used to send and receive data.
+      */
+    MicroBitRadioTime(MicroBitRadio &r);
+
+    /**
+      * Destructor.
+      *
+      * Stops sending beacons.
+      */
+    ~MicroBitRadioTime();
+
+    /**
+      * Starts keeping network time, and turns on radio timestamping. The radio should also be enabled.
+      *
+      * @param reference true if this micro:bit's system time is to be the network time. It then sends beacons for
+      *        others to synchronise to. Otherwise, we follow the first reference we hear.
+      *
+      * @return MICROBIT_OK on success.
+      *
+      * @code
+      * radio.enable();
+      * radio.time.enable(true);    // on one micro:bit
+      * radio.time.enable();        // on the rest
+      * @endcode
+      */
+    int enable(bool reference = false);
+
+    /**
+      * Stops keeping network time, and sending beacons.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int disable();
+
+    /**
+      * Determines if our network time is valid.
+      *
+      * @return true if we are the reference, or have heard from our reference within the last
+      *         MICROBIT_RADIO_TIME_TIMEOUT beacon periods.
+      */
+    bool isSynchronised();
+
+    /**
+      * Retrieves the serial number of the micro:bit whose clock we follow.
+      *
+      * @return The serial number of our reference, or 0 if we are not synchronised.
+      */
+    uint32_t getReference();
+
+    /**
+      * Converts a system time to network time.
+      *
+      * @param time A system time, as returned by system_timer_current_time_us().
+      *
+      * @return The network time at that moment, in microseconds. Until we have synchronised, this is the system time.
+      */
+    uint64_t toNetworkTime(uint64_t time);
+
+    /**
+      * Determines the network time.
+      *
+      * @return The network time in microseconds. Until we have synchronised, this is the system time.
+      */
+    uint64_t currentTimeUs();
+
+    /**
+      * Determines the network time.
+      *
+      * @return The network time in milliseconds. Until we have synchronised, this is the system time.
+      */
+    uint64_t currentTime();
+
+    /**
+      * Records the time at which a beacon was sent.
+      *
+      * @param packet The beacon.
+      *
+      * @param timestamp The low 32 bits of the system time at which its address was sent.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    void beaconSent(FrameBuffer *packet, uint32_t timestamp);
+
+    /**
+      * Protocol handler callback. This is called when the radio receives a packet marked as a time beacon.
+      *
+      * This function synchronises our network clock with the reference.
+      */
+    void packetReceived();
+};
+
+#endif
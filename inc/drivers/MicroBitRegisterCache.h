@@ -0,0 +1,143 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_REGISTER_CACHE_H
+#define MICROBIT_REGISTER_CACHE_H
+
+#include "MicroBitConfig.h"
+#include "MicroBitI2C.h"
+
+/**
+  * Class definition for MicroBitRegisterCache.
+  *
+  * Wraps the register accesses of a single I2C sensor, keeping a shadow copy of the control registers written
+  * through it. Writes that would not change the contents of a register are skipped, and runs of consecutive
+  * registers are read and written in a single auto-increment transaction.
+  *
+  * Only registers written through the cache are shadowed, so status and data registers are always read from the device.
+  */
+class MicroBitRegisterCache
+{
+    MicroBitI2C&    i2c;                                        // The I2C interface to use.
+    uint16_t        address;                                    // I2C address of the device.
+    uint8_t         autoIncrement;                              // Bits set in the register address of multi-byte transfers.
+    uint8_t         count;                                      // The number of registers shadowed.
+    uint8_t         reg[MICROBIT_I2C_REGISTER_CACHE_SIZE];      // The address of each register shadowed.
+    uint8_t         value[MICROBIT_I2C_REGISTER_CACHE_SIZE];    // The last value written to each register shadowed.
+
+    /**
+      * Looks up the shadow copy of a register.
+      *
+      * @param r The address of the register.
+      *
+      * @return the index of the shadow copy, or -1 if the register is not shadowed.
+      */
+    int find(uint8_t r);
+
+    /**
+      * Records the value last written to a register, if space allows.
+      *
+      * @param r The address of the register.
+      *
+      * @param v The value written.
+      */
+    void store(uint8_t r, uint8_t v);
+
+    /**
+      * Stops shadowing a register, whose contents are no longer known.
+      *
+      * @param r The address of the register.
+      */
+    void forget(uint8_t r);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * @param _i2c The I2C interface the device is attached to.
+      *
+      * @param address The 8-bit I2C address of the device.
+      *
+      * @param autoIncrement Bits to set in the register address of multi-byte transfers, for devices
+      *        that only auto-increment when asked to (e.g. 0x80 for the LSM303). Defaults to 0.
+      */
+    MicroBitRegisterCache(MicroBitI2C &_i2c, uint16_t address, uint8_t autoIncrement = 0);
+
+    /**
+      * Writes a control register, unless it is already known to hold the given value.
+      *
+      * @param r The address of the register.
+      *
+      * @param v The value to write.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the write failed.
+      */
+    int writeRegister(uint8_t r, uint8_t v);
+
+    /**
+      * Writes a run of consecutive control registers. Only the span of registers whose contents would
+      * change is written, in a single transaction.
+      *
+      * @param r The address of the first register.
+      *
+      * @param values The value to write to each register.
+      *
+      * @param length The number of registers to write.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the write failed.
+      */
+    int writeRegisters(uint8_t r, const uint8_t *values, int length);
+
+    /**
+      * Reads a run of consecutive registers from the device, in a single transaction.
+      *
+      * @param r The address of the first register.
+      *
+      * @param buffer Memory area to read the data into.
+      *
+      * @param length The number of registers to read.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read failed.
+      */
+    int readRegisters(uint8_t r, uint8_t *buffer, int length);
+
+    /**
+      * Reads a single register from the device.
+      *
+      * @param r The address of the register.
+      *
+      * @return the byte read on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read failed.
+      */
+    int readRegister(uint8_t r);
+
+    /**
+      * Discards the shadow copy of every register, so that each is written again on next use.
+      * Call this whenever the device may have been reset.
+      */
+    void invalidate();
+};
+
+#endif
@@ -28,13 +28,27 @@ DEALINGS IN THE SOFTWARE.
 
 #include "mbed.h"
 #include "ManagedString.h"
+#include "MicroBitFiber.h"
+#include "PacketBuffer.h"
+#include "MicroBitRingBuffer.h"
 
 #define MICROBIT_SERIAL_DEFAULT_BAUD_RATE   115200
 #define MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE 20
+#define MICROBIT_SERIAL_MAX_BUFFER_SIZE     MICROBIT_RING_BUFFER_MAX_SIZE
 
 #define MICROBIT_SERIAL_EVT_DELIM_MATCH     1
 #define MICROBIT_SERIAL_EVT_HEAD_MATCH      2
 #define MICROBIT_SERIAL_EVT_RX_FULL         3
+#define MICROBIT_SERIAL_EVT_TX_LOW_WATER    4
+#define MICROBIT_SERIAL_EVT_FRAME_RECEIVED  5
+
+// Framing constants (SLIP, RFC 1055).
+#define MICROBIT_SERIAL_SLIP_END            0xC0
+#define MICROBIT_SERIAL_SLIP_ESC            0xDB
+#define MICROBIT_SERIAL_SLIP_ESC_END        0xDC
+#define MICROBIT_SERIAL_SLIP_ESC_ESC        0xDD
+#define MICROBIT_SERIAL_MAX_FRAME_SIZE      256
+#define MICROBIT_SERIAL_FRAME_QUEUE_SIZE    4
 
 #define MICROBIT_SERIAL_RX_IN_USE           1
 #define MICROBIT_SERIAL_TX_IN_USE           2
@@ -42,6 +56,8 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_SERIAL_TX_BUFF_INIT        8
 
 
+struct SerialFrame;
+
 enum MicroBitSerialMode
 {
     ASYNC,
@@ -57,28 +73,49 @@ enum MicroBitSerialMode
 class MicroBitSerial : public RawSerial
 {
 
-    //holds that state of the mutex locks for all MicroBitSerial instances.
+    //holds the state of the buffers for all MicroBitSerial instances.
     static uint8_t status;
 
+    //the mutex locks for reception and transmission, shared by all MicroBitSerial instances.
+    static FiberLock rxLock;
+    static FiberLock txLock;
+
     //holds the state of the baudrate for all MicroBitSerial instances.
     static int baudrate;
 
-    //delimeters used for matching on receive.
-    ManagedString delimeters;
+    //delimeters used for matching on receive, as a bitmap with one bit for each character value.
+    uint32_t delimeters[8];
 
     //a variable used when a user calls the eventAfter() method.
     int rxBuffHeadMatch;
 
-    uint8_t *rxBuff;
-    uint8_t rxBuffSize;
-    volatile uint16_t rxBuffHead;
-    uint16_t rxBuffTail;
+    //filled by the receive interrupt, and emptied by fibers.
+    MicroBitRingBuffer rxBuff;
 
+    //filled by fibers, and emptied by the transmit interrupt.
+    MicroBitRingBuffer txBuff;
 
-    uint8_t *txBuff;
-    uint8_t txBuffSize;
-    uint16_t txBuffHead;
-    volatile uint16_t txBuffTail;
+    //the number of bytes left in the txBuff at which MICROBIT_SERIAL_EVT_TX_LOW_WATER is raised, or zero if disabled.
+    uint16_t txLowWaterMark;
+
+    //when framing is enabled, the frame being received, and the complete frames waiting to be read.
+    uint8_t *frameBuff;
+    uint16_t frameLength;
+    bool frameEscape;
+    bool frameOverflow;
+    SerialFrame *frameQueue;
+    uint8_t frameQueueLength;
+
+    /**
+      * An internal method, used by the receive interrupt, to decode a received character
+      * when framing is enabled.
+      *
+      * @param c the character received.
+      *
+      * @return MICROBIT_SERIAL_EVT_FRAME_RECEIVED if a frame was completed, MICROBIT_SERIAL_EVT_RX_FULL
+      *         if a frame was completed but could not be stored, or zero otherwise.
+      */
+    int frameReceived(uint8_t c);
 
     /**
       * An internal interrupt callback for MicroBitSerial configured for when a
@@ -114,12 +151,14 @@ class MicroBitSerial : public RawSerial
     int setTxInterrupt(uint8_t *string, int len, MicroBitSerialMode mode);
 
     /**
-      * Locks the mutex so that others can't use this serial instance for reception
+      * Locks the mutex so that others can't use this serial instance for reception,
+      * blocking the calling fiber until the mutex is available
       */
     void lockRx();
 
     /**
-      * Locks the mutex so that others can't use this serial instance for transmission
+      * Locks the mutex so that others can't use this serial instance for transmission,
+      * blocking the calling fiber until the mutex is available
       */
     void lockTx();
 
@@ -177,24 +216,6 @@ class MicroBitSerial : public RawSerial
       */
     int getChar(MicroBitSerialMode mode);
 
-    /**
-      * An internal method that copies values from a circular buffer to a linear buffer.
-      *
-      * @param circularBuff a pointer to the source circular buffer
-      *
-      * @param circularBuffSize the size of the circular buffer
-      *
-      * @param linearBuff a pointer to the destination linear buffer
-      *
-      * @param tailPosition the tail position in the circular buffer you want to copy from
-      *
-      * @param headPosition the head position in the circular buffer you want to copy to
-      *
-      * @note this method assumes that the linear buffer has the appropriate amount of
-      *       memory to contain the copy operation
-      */
-    void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
-
     public:
 
     /**
@@ -205,9 +226,9 @@ class MicroBitSerial : public RawSerial
       *
       * @param rx the Pin to be used for receiving data
       *
-      * @param rxBufferSize the size of the buffer to be used for receiving bytes
+      * @param rxBufferSize the size of the buffer to be used for receiving bytes, up to MICROBIT_SERIAL_MAX_BUFFER_SIZE
       *
-      * @param txBufferSize the size of the buffer to be used for transmitting bytes
+      * @param txBufferSize the size of the buffer to be used for transmitting bytes, up to MICROBIT_SERIAL_MAX_BUFFER_SIZE
       *
       * @code
       * MicroBitSerial serial(USBTX, USBRX);
@@ -218,7 +239,7 @@ class MicroBitSerial : public RawSerial
       *
       *       Buffers aren't allocated until the first send or receive respectively.
       */
-    MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize = MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE, uint8_t txBufferSize = MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE);
+    MicroBitSerial(PinName tx, PinName rx, uint16_t rxBufferSize = MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE, uint16_t txBufferSize = MICROBIT_SERIAL_DEFAULT_BUFFER_SIZE);
 
     /**
       * Sends a single character over the serial line.
@@ -507,7 +528,7 @@ class MicroBitSerial : public RawSerial
       * @return MICROBIT_SERIAL_IN_USE if another fiber is currently using this instance
       *         for reception, otherwise MICROBIT_OK.
       */
-    int setRxBufferSize(uint8_t size);
+    int setRxBufferSize(uint16_t size);
 
     /**
       * Reconfigures the size of our txBuff
@@ -517,7 +538,7 @@ class MicroBitSerial : public RawSerial
       * @return MICROBIT_SERIAL_IN_USE if another fiber is currently using this instance
       *         for transmission, otherwise MICROBIT_OK.
       */
-    int setTxBufferSize(uint8_t size);
+    int setTxBufferSize(uint16_t size);
 
     /**
       * The size of our rx buffer in bytes.
@@ -567,6 +588,147 @@ class MicroBitSerial : public RawSerial
       */
     int txBufferedSize();
 
+    /**
+      * Provides direct access to the characters waiting in the rxBuff, so they can be parsed in place
+      * without being copied. Only the contiguous region starting at the oldest character is exposed, so
+      * when the waiting characters wrap around the end of the buffer, the remainder becomes available
+      * once this region has been released with commitRead().
+      *
+      * @param data populated with a pointer to the oldest character waiting in the rxBuff.
+      *
+      * @return the number of characters available at data, MICROBIT_SERIAL_IN_USE if another fiber
+      *         is currently using this instance for reception, or MICROBIT_NO_RESOURCES if the
+      *         rxBuff could not be allocated.
+      *
+      * @code
+      * uint8_t *data;
+      * int len = serial.getReadRegion(data);
+      *
+      * if (len > 0)
+      *     serial.commitRead(parse(data, len));
+      * @endcode
+      */
+    int getReadRegion(uint8_t *&data);
+
+    /**
+      * Releases characters at the start of the region given by getReadRegion(), once they have been used.
+      *
+      * @param len the number of characters to release.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than are waiting.
+      */
+    int commitRead(int len);
+
+    /**
+      * Provides direct access to free space in the txBuff, so that data can be written in place
+      * without being copied. Only the contiguous region following the last character queued is exposed.
+      *
+      * @param data populated with a pointer to the free space in the txBuff.
+      *
+      * @return the number of bytes that may be written at data, MICROBIT_SERIAL_IN_USE if another fiber
+      *         is currently using this instance for transmission, or MICROBIT_NO_RESOURCES if the
+      *         txBuff could not be allocated.
+      *
+      * @code
+      * uint8_t *data;
+      * int len = serial.getWriteRegion(data);
+      *
+      * if (len >= 4)
+      * {
+      *     memcpy(data, "ping", 4);
+      *     serial.commitWrite(4);
+      * }
+      * @endcode
+      */
+    int getWriteRegion(uint8_t *&data);
+
+    /**
+      * Queues bytes written into the region given by getWriteRegion() for transmission. Returns immediately.
+      *
+      * @param len the number of bytes written.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or larger than the region.
+      */
+    int commitWrite(int len);
+
+    /**
+      * Enables or disables binary framing of received data. While enabled, received bytes are decoded
+      * as SLIP (RFC 1055) frames as they arrive, rather than being stored in the rxBuff. Each complete
+      * frame is queued for recvFrame(), and an event with the id MICROBIT_ID_SERIAL and the value
+      * MICROBIT_SERIAL_EVT_FRAME_RECEIVED is raised.
+      *
+      * Frames longer than MICROBIT_SERIAL_MAX_FRAME_SIZE bytes are discarded. If
+      * MICROBIT_SERIAL_FRAME_QUEUE_SIZE frames are already waiting, new frames are discarded, and
+      * MICROBIT_SERIAL_EVT_RX_FULL is raised.
+      *
+      * @param enable true to decode frames, false to return to receiving a stream of characters.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the frame buffer could not be allocated.
+      */
+    int setFraming(bool enable);
+
+    /**
+      * Reads the oldest complete frame received while framing is enabled.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - A frame is returned if available, otherwise an empty PacketBuffer is
+      *                    returned immediately.
+      *
+      *            SYNC_SPINWAIT - A frame is returned if available, otherwise this method will
+      *                            spin (lock up the processor) until a frame is received.
+      *
+      *            SYNC_SLEEP - A frame is returned if available, otherwise the calling fiber
+      *                         sleeps until a frame is received.
+      *
+      *         Defaults to SYNC_SLEEP.
+      *
+      * @return the decoded frame, or an empty PacketBuffer if no frame is available or framing is not enabled.
+      */
+    PacketBuffer recvFrame(MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Sends a buffer as a single SLIP (RFC 1055) frame. The frame is encoded directly into the txBuff.
+      *
+      * @param buffer a pointer to the first byte of the frame.
+      *
+      * @param bufferLen the number of bytes in the frame.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - the frame is encoded into the txBuff and this method returns immediately.
+      *                    If the whole encoded frame does not fit, nothing is sent.
+      *
+      *            SYNC_SPINWAIT - the frame is encoded into the txBuff as space allows, and this method
+      *                            will spin (lock up the processor) until it has been sent.
+      *
+      *            SYNC_SLEEP - the frame is encoded into the txBuff as space allows, and the fiber
+      *                         sleeps until it has been sent.
+      *
+      *         Defaults to SYNC_SLEEP.
+      *
+      * @return the number of bytes in the frame, MICROBIT_SERIAL_IN_USE if another fiber is using
+      *         the serial instance for transmission, MICROBIT_INVALID_PARAMETER if buffer is invalid
+      *         or bufferLen is <= 0, or MICROBIT_NO_RESOURCES if an ASYNC frame does not fit in the txBuff.
+      */
+    int sendFrame(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Sends a PacketBuffer as a single SLIP (RFC 1055) frame. The frame is encoded directly into the txBuff.
+      *
+      * @param frame the frame to send.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. See sendFrame(uint8_t *, int, MicroBitSerialMode).
+      *         Defaults to SYNC_SLEEP.
+      *
+      * @return the number of bytes in the frame, MICROBIT_SERIAL_IN_USE if another fiber is using
+      *         the serial instance for transmission, MICROBIT_INVALID_PARAMETER if the frame is empty,
+      *         or MICROBIT_NO_RESOURCES if an ASYNC frame does not fit in the txBuff.
+      */
+    int sendFrame(PacketBuffer frame, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
     /**
       * Determines if the serial bus is currently in use by another fiber for reception.
       *
@@ -585,6 +747,32 @@ class MicroBitSerial : public RawSerial
       */
     int txInUse();
 
+    /**
+      * Configures an event to be raised as the txBuff drains, so that a fiber producing data can top
+      * the buffer up before it empties, keeping the line busy without blocking in send() or polling.
+      *
+      * Once the number of bytes waiting to be transmitted falls to the given level, an event with
+      * the id MICROBIT_ID_SERIAL and the value MICROBIT_SERIAL_EVT_TX_LOW_WATER is raised.
+      * An event with the id MICROBIT_ID_NOTIFY and the value MICROBIT_SERIAL_EVT_TX_EMPTY is also
+      * raised each time the txBuff becomes empty.
+      *
+      * @param bytes the number of bytes remaining at which to raise the event, or zero to disable the event.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if bytes is negative or not less than the size of the txBuff.
+      *
+      * @code
+      * serial.setTxLowWaterMark(16);
+      *
+      * while(1)
+      * {
+      *     // Queue as much as the buffer will take, then sleep until it has drained.
+      *     serial.send(nextChunk(), ASYNC);
+      *     fiber_wait_for_event(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_TX_LOW_WATER);
+      * }
+      * @endcode
+      */
+    int setTxLowWaterMark(int bytes);
+
     /**
       * Detaches a previously configured interrupt
       *
@@ -31,7 +31,8 @@ DEALINGS IN THE SOFTWARE.
 #include "ManagedString.h"
 #include "ErrorNo.h"
 
-#define MICROBIT_STORAGE_MAGIC       0xCAFE
+#define MICROBIT_STORAGE_MAGIC       0xCAFF
+#define MICROBIT_STORAGE_LEGACY_MAGIC 0xCAFE    // Stores written before the log structured layout.
 
 #define MICROBIT_STORAGE_BLOCK_SIZE             48
 #define MICROBIT_STORAGE_KEY_SIZE               16
@@ -65,6 +66,16 @@ struct KeyValueStore
 };
 
 
+/**
+  * A single change to the store, for use with MicroBitStorage::update().
+  */
+struct MicroBitStorageUpdate
+{
+    const char *key;                // the unique name of the KeyValuePair to change.
+    uint8_t *data;                  // the new value, or NULL to remove the KeyValuePair.
+    int dataSize;                   // the size of the new value, in bytes.
+};
+
 /**
   * Class definition for the MicroBitStorage class.
   * This allows reading and writing of small blocks of data to FLASH memory.
@@ -72,16 +83,18 @@ struct KeyValueStore
   * This class operates as a key value store, it allows the retrieval, addition
   * and deletion of KeyValuePairs.
   *
-  * The first 8 bytes are reserved for the KeyValueStore struct which gives core
-  * information such as the number of KeyValuePairs in the store, and whether the
-  * store has been initialised.
+  * The first 8 bytes are reserved for the KeyValueStore struct which records
+  * whether the store has been initialised.
   *
-  * After the KeyValueStore struct, KeyValuePairs are arranged contiguously until
-  * the end of the block used as persistent storage.
+  * After the KeyValueStore struct, KeyValuePairs are written as a log, contiguously until
+  * the end of the block used as persistent storage. Updating a key appends a new KeyValuePair,
+  * and clears the previous one to zero, which needs no page erase. Removed pairs are also cleared.
+  * Only when the log reaches the end of the page are the remaining pairs compacted,
+  * via the scratch page.
   *
-  * |-------8-------|--------48-------|-----|---------48--------|
-  * | KeyValueStore | KeyValuePair[0] | ... | KeyValuePair[N-1] |
-  * |---------------|-----------------|-----|-------------------|
+  * |-------8-------|--------48-------|-----|---------48--------|----------|
+  * | KeyValueStore | KeyValuePair[0] | ... | KeyValuePair[N-1] | (unused) |
+  * |---------------|-----------------|-----|-------------------|----------|
   */
 class MicroBitStorage
 {
@@ -104,15 +117,53 @@ class MicroBitStorage
     void scratchKeyValueStore(KeyValueStore store);
 
     /**
-      * Function for populating the scratch page with a KeyValuePair.
+      * Determine the address of the first KeyValuePair in the storage page, initialising
+      * the page if it does not yet hold a valid store.
+      *
+      * @return a pointer to the first KeyValuePair slot.
+      */
+    KeyValuePair* getFirstPair();
+
+    /**
+      * Determine the address of the first unused KeyValuePair slot at the end of the log.
+      *
+      * @return a pointer to the slot, or NULL if the storage page is full.
+      */
+    KeyValuePair* getFreePair();
+
+    /**
+      * Find the most recent KeyValuePair in the log with the given key.
+      *
+      * @param key the key to find.
+      *
+      * @return a pointer to the KeyValuePair in FLASH, or NULL if the key is not present.
+      */
+    KeyValuePair* findPair(const char* key);
+
+    /**
+      * Rebuild the RAM index of the log, if it is not already up to date.
+      */
+    void buildIndex();
+
+    /**
+      * Clear a KeyValuePair in the log to zero, so that it is no longer used.
+      *
+      * @param pair the KeyValuePair to clear.
+      */
+    void clearPair(KeyValuePair* pair);
+
+    /**
+      * Copy the current KeyValuePairs to the start of a freshly erased storage page, recovering
+      * the space used by pairs that have since been updated or removed, and applying the given changes as we go.
+      *
+      * @param updates the changes to apply.
       *
-      * @param pair the KeyValuePair struct to write to the scratch page.
+      * @param count the number of changes.
       *
-      * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-      * is used to determine the offset into the scratch page, where the KeyValuePair should
-      * be written.
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the result would not fit in the storage page,
+      *         in which case the store is left unchanged.
       */
-    void scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer);
+    int compact(MicroBitStorageUpdate* updates = NULL, int count = 0);
 
     public:
 
@@ -151,8 +202,9 @@ class MicroBitStorage
       *
       * @param dataSize the size of the data to be persisted
       *
-      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-      *         MICROBIT_NO_RESOURCES if the storage page is full
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
+      *         MICROBIT_NO_RESOURCES if the storage page is full, or MICROBIT_BUSY if FLASH is in use
+      *         by another fiber and the caller cannot wait (e.g. the idle thread).
       */
     int put(const char* key, uint8_t* data, int dataSize);
 
@@ -168,7 +220,8 @@ class MicroBitStorage
       * @param dataSize the size of the data to be persisted
       *
       * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-      *         MICROBIT_NO_RESOURCES if the storage page is full
+      *         MICROBIT_NO_RESOURCES if the storage page is full, or MICROBIT_BUSY if FLASH is in use
+      *         by another fiber and the caller cannot wait (e.g. the idle thread).
       */
     int put(ManagedString key, uint8_t* data, int dataSize);
 
@@ -196,13 +249,62 @@ class MicroBitStorage
       */
     KeyValuePair* get(ManagedString key);
 
+    /**
+      * Retreives the value of a KeyValuePair identified by a given key, without allocating any memory.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @param buffer the buffer to copy the value into.
+      *
+      * @param length the size of the buffer. At most MICROBIT_STORAGE_VALUE_SIZE bytes are copied.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage,
+      *         or MICROBIT_INVALID_PARAMETER if the buffer is invalid.
+      */
+    int get(const char* key, uint8_t* buffer, int length);
+
+    /**
+      * Retreives the value of a KeyValuePair identified by a given key, without allocating any memory.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @param buffer the buffer to copy the value into.
+      *
+      * @param length the size of the buffer. At most MICROBIT_STORAGE_VALUE_SIZE bytes are copied.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage,
+      *         or MICROBIT_INVALID_PARAMETER if the buffer is invalid.
+      */
+    int get(ManagedString key, uint8_t* buffer, int length);
+
+    /**
+      * Applies several changes to the store at once.
+      *
+      * If there is space at the end of the log for every new value, they are simply appended. Otherwise the store
+      * is compacted just once, with all of the changes applied, at the cost of a single erase of the storage page.
+      *
+      * @param updates the changes to apply. Where the same key appears more than once, the last change is used.
+      *
+      * @param count the number of changes.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if any key is empty or any key or size is too large,
+      *         MICROBIT_NO_RESOURCES if the results would not fit in the storage page, or MICROBIT_BUSY if FLASH is in use
+      *         by another fiber and the caller cannot wait (e.g. the idle thread). No changes are made on error.
+      *
+      * @code
+      * MicroBitStorageUpdate updates[] = {{"compassCal", (uint8_t *)&cal, sizeof(cal)}, {"tempCal", NULL, 0}};
+      * storage.update(updates, 2);
+      * @endcode
+      */
+    int update(MicroBitStorageUpdate* updates, int count);
+
     /**
       * Removes a KeyValuePair identified by a given key.
       *
       * @param key the unique name used to identify a KeyValuePair in flash.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-      *         was not found in flash.
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key was not found in flash,
+      *         or MICROBIT_BUSY if FLASH is in use by another fiber and the caller cannot wait (e.g. the idle thread).
       */
     int remove(const char* key);
 
@@ -211,8 +313,8 @@ class MicroBitStorage
       *
       * @param key the unique name used to identify a KeyValuePair in flash.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-      *         was not found in flash.
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key was not found in flash,
+      *         or MICROBIT_BUSY if FLASH is in use by another fiber and the caller cannot wait (e.g. the idle thread).
       */
     int remove(ManagedString key);
 
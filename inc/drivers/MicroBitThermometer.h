@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
 #include "MicroBitStorage.h"
+#include "MicroBitSampleFilter.h"
 
 #define MICROBIT_THERMOMETER_PERIOD             1000
 
@@ -42,6 +43,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_THERMOMETER_EVT_UPDATE         1
 
 #define MICROBIT_THERMOMETER_ADDED_TO_IDLE      2
+#define MICROBIT_THERMOMETER_SAMPLED            4
 
 /**
   * Class definition for MicroBit Thermometer.
@@ -53,13 +55,18 @@ DEALINGS IN THE SOFTWARE.
 class MicroBitThermometer : public MicroBitComponent
 {
     unsigned long           sampleTime;
+    unsigned long           accessTime;
     uint32_t                samplePeriod;
     int16_t                 temperature;
     int16_t                 offset;
     MicroBitStorage*        storage;
+    MicroBitSampleFilter    filter;
+    volatile bool           converting;
 
     public:
 
+    static MicroBitThermometer  *instance;  // A singleton reference, used purely by the interrupt service routine.
+
     /**
       * Constructor.
       * Create new MicroBitThermometer that gives an indication of the current temperature.
@@ -106,6 +113,32 @@ class MicroBitThermometer : public MicroBitComponent
       */
     int getPeriod();
 
+     /**
+      * Smooths the readings of the thermometer, so that each read returns a filtered value. The filter is
+      * updated incrementally as each sample is taken, rather than when read.
+      *
+      * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+      *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      *
+      * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+      *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+      *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @code
+      * thermometer.setFilter(MICROBIT_FILTER_MOVING_AVERAGE, 8);
+      * @endcode
+      */
+    int setFilter(int type, int length);
+
+     /**
+      * Determines the type of filter applied to the readings, as set by setFilter().
+      *
+      * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      */
+    int getFilter();
+
     /**
       * Set the value that is used to offset the raw silicon temperature.
       *
@@ -148,6 +181,9 @@ class MicroBitThermometer : public MicroBitComponent
       * Updates the temperature sample of this instance of MicroBitThermometer
       * only if isSampleNeeded() indicates that an update is required.
       *
+      * Unless Bluetooth is enabled, this only starts a conversion, and the new sample is recorded
+      * from the TEMP interrupt once it is ready. Only the very first reading is waited for.
+      *
       * This call also will add the thermometer to fiber components to receive
       * periodic callbacks.
       *
@@ -160,14 +196,36 @@ class MicroBitThermometer : public MicroBitComponent
       */
     virtual void idleTick();
 
+    /**
+      * Collects the result of a temperature conversion started by updateSample().
+      *
+      * @note should only be called from TEMP_IRQHandler...
+      */
+    void conversionComplete();
+
     private:
 
+    /**
+      * Records a raw temperature reading from the processor, and raises MICROBIT_THERMOMETER_EVT_UPDATE.
+      *
+      * @param processorTemperature the reading, in quarter degrees celsius.
+      */
+    void recordSample(int32_t processorTemperature);
+
     /**
       * Determines if we're due to take another temperature reading
       *
       * @return 1 if we're due to take a temperature reading, 0 otherwise.
       */
     int isSampleNeeded();
+
+    /**
+      * Determines if the thermometer should continue to be sampled in the background. This is not the case
+      * once it has not been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+      *
+      * @return 1 if the thermometer should be sampled, 0 otherwise.
+      */
+    int isSampling();
 };
 
 #endif
@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_TOUCH_SENSOR_H
+#define MICROBIT_TOUCH_SENSOR_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+// The most pads that can be scanned together.
+#define MICROBIT_TOUCH_MAX_PADS             8
+
+// The longest a pad is given to charge in each scan, in microseconds. With a 10M resistor, this allows for around 330pF.
+#define MICROBIT_TOUCH_TIMEOUT_US           4000
+
+// The number of scans averaged to find the baseline of each pad when it is calibrated.
+#define MICROBIT_TOUCH_CALIBRATION_SCANS    8
+
+// The number of times a scan is repeated if it is interrupted, before the result is used anyway.
+#define MICROBIT_TOUCH_RETRIES              3
+
+/**
+  * Class definition for MicroBitTouchSensor.
+  *
+  * Measures the capacitance of one or more touch pads, from the time each one takes to charge through its pull up
+  * resistor after being discharged. All of the pads are released together and timed in the same pass, against
+  * MICROBIT_TOUCH_TIMER running at 16MHz.
+  *
+  * Each pad needs an external pull up of a high value (see MICROBIT_TOUCH_RESISTANCE_KOHM), and must not be used through
+  * its MicroBitPin while it is being scanned.
+  */
+class MicroBitTouchSensor
+{
+    PinName             pads[MICROBIT_TOUCH_MAX_PADS];
+    uint32_t            charge[MICROBIT_TOUCH_MAX_PADS];    // The charge time of each pad in the last scan, in timer ticks.
+    uint32_t            baseline[MICROBIT_TOUCH_MAX_PADS];  // The charge time of each pad when untouched, in timer ticks.
+    uint8_t             padCount;
+    bool                calibrated;
+
+    /**
+      * Measures the charge time of every pad once.
+      *
+      * @return true if the measurement was taken without interruption, false otherwise.
+      */
+    bool measure();
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create a touch sensor, with no pads.
+      */
+    MicroBitTouchSensor();
+
+    /**
+      * Adds a pad to be scanned.
+      *
+      * @param pad the pin attached to the pad, e.g. MICROBIT_PIN_P0.
+      *
+      * @return the index of the pad, used to read its results, MICROBIT_INVALID_PARAMETER if the pin is out of range,
+      *         or MICROBIT_NO_RESOURCES if MICROBIT_TOUCH_MAX_PADS pads have been added already.
+      */
+    int addPad(PinName pad);
+
+    /**
+      * Measures every pad once. The first scan also calibrates the pads, if calibrate() hasn't been called.
+      *
+      * This takes as long as the slowest pad takes to charge, up to MICROBIT_TOUCH_TIMEOUT_US, and is repeated if it is
+      * interrupted for long enough to affect the result.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no pads have been added.
+      */
+    int scan();
+
+    /**
+      * Finds the untouched capacitance of every pad, by averaging MICROBIT_TOUCH_CALIBRATION_SCANS scans.
+      * The pads must not be touched at the time.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no pads have been added.
+      */
+    int calibrate();
+
+    /**
+      * Determines the capacitance of a pad above its baseline, in the last scan.
+      *
+      * @param pad the index of the pad, as returned by addPad().
+      *
+      * @return the capacitance in femtofarads, or MICROBIT_INVALID_PARAMETER if pad is out of range.
+      *
+      * @code
+      * int p0 = touch.addPad(MICROBIT_PIN_P0);
+      * touch.scan();
+      * int strength = touch.getCapacitance(p0);
+      * @endcode
+      */
+    int getCapacitance(int pad);
+
+    /**
+      * Determines if a pad was touched in the last scan.
+      *
+      * @param pad the index of the pad, as returned by addPad().
+      *
+      * @return 1 if the pad's capacitance is at least MICROBIT_TOUCH_THRESHOLD above its baseline, 0 if not,
+      *         or MICROBIT_INVALID_PARAMETER if pad is out of range.
+      */
+    int isTouched(int pad);
+};
+
+#endif
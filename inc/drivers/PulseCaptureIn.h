@@ -0,0 +1,97 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PULSE_CAPTURE_IN_H
+#define PULSE_CAPTURE_IN_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Class definition for PulseCaptureIn.
+  *
+  * Measures the width of pulses on a pin in hardware. Each edge is detected by a GPIOTE channel, which
+  * captures MICROBIT_PIN_CAPTURE_TIMER through a PPI channel, so the timestamps are exact regardless of
+  * interrupt latency. The GPIOTE interrupt simply reads the captured time, and raises MICROBIT_PIN_EVT_PULSE_HI
+  * or MICROBIT_PIN_EVT_PULSE_LO with the width of the pulse, in microseconds, as the event timestamp.
+  *
+  * The hardware is shared, so only one instance may exist at a time.
+  */
+class PulseCaptureIn
+{
+    PinName                 name;
+    uint16_t                id;
+    uint32_t                previous;
+    bool                    primed;
+    uint32_t                chainedHandler;
+
+    /**
+      * GPIOTE interrupt handler. Collects the capture of each edge on our pin, and passes any other
+      * GPIOTE events on to the handler that was installed before us.
+      */
+    static void gpioteHandler();
+
+    public:
+
+    static PulseCaptureIn   *instance;  // A singleton reference, used purely by the interrupt service routine.
+
+    /**
+      * Constructor.
+      *
+      * Create an instance of PulseCaptureIn, and start measuring pulses on the given pin.
+      *
+      * @param name the pin to measure.
+      *
+      * @param id the id used when raising pulse events on the message bus.
+      *
+      * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+      *
+      * @note check that instance is NULL before creating one.
+      */
+    PulseCaptureIn(PinName name, uint16_t id, PinMode pull);
+
+    /**
+      * Reads the current level of the pin.
+      *
+      * @return 1 if the pin is HI, 0 if it is LO.
+      */
+    int read();
+
+    /**
+      * Configures the pull of the pin.
+      *
+      * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+      */
+    void mode(PinMode pull);
+
+    /**
+      * Destructor.
+      *
+      * Stops measuring pulses, and releases the hardware for use by another instance.
+      */
+    ~PulseCaptureIn();
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SOFT_PWM_OUT_H
+#define SOFT_PWM_OUT_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Class definition for SoftPwmOut.
+  *
+  * A PWM output driven in software from a single free running hardware timer, so that many pins can be driven
+  * at once, each with its own period. The timer interrupt only runs at each edge: it handles every edge that is due,
+  * then sets the timer to compare against the next edge of any channel.
+  *
+  * New periods and pulse widths take effect at the start of a channel's next period, so a pulse is never cut short
+  * or stretched by an update.
+  *
+  * Provides the same interface as DynamicPwm, so can be used by MicroBitPin in its place. See MICROBIT_PIN_SOFT_PWM.
+  */
+class SoftPwmOut
+{
+    PinName                 pin;
+    float                   lastValue;
+    uint32_t                period;         // The period and pulse width last requested, in microseconds.
+    uint32_t                pulse;
+    uint32_t                activePeriod;   // The period and pulse width being output.
+    uint32_t                activePulse;
+    uint32_t                start;          // The time the current period started, and the time of the next edge.
+    uint32_t                next;
+    bool                    high;
+
+    /**
+      * Timer interrupt handler. Produces every edge that is due, and schedules the next.
+      */
+    static void timerHandler();
+
+    /**
+      * Produces the edge of this channel that is due.
+      */
+    void edge();
+
+    public:
+
+    static SoftPwmOut       *channels[MICROBIT_SOFT_PWM_CHANNELS];
+
+    /**
+      * Constructor.
+      *
+      * Create a PWM output on the given pin, which starts LO with the default period of MICROBIT_DEFAULT_PWM_PERIOD.
+      *
+      * @param pin the name of the pin for the pwm to target
+      *
+      * @note if MICROBIT_SOFT_PWM_CHANNELS outputs exist already, this one has no effect, and write() returns
+      *       MICROBIT_NO_RESOURCES.
+      */
+    SoftPwmOut(PinName pin);
+
+    /**
+      * Sets the duty cycle of the output.
+      *
+      * @param value the duty cycle, in the range 0 to 1.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NO_RESOURCES
+      *         if there was no channel free for this output.
+      */
+    int write(float value);
+
+    /**
+      * Sets the pulse width of the output.
+      *
+      * @param width the desired pulse width in microseconds.
+      */
+    void pulsewidth_us(int width);
+
+    /**
+      * Retrieves the PinName associated with this SoftPwmOut instance.
+      */
+    PinName getPinName();
+
+    /**
+      * Retrieves the last duty cycle written to this SoftPwmOut instance, in the range 0 - 1023 inclusive.
+      */
+    int getValue();
+
+    /**
+      * Retrieves the period of this output in microseconds.
+      */
+    uint32_t getPeriodUs();
+
+    /**
+      * Retrieves the period of this output in milliseconds.
+      */
+    uint32_t getPeriod();
+
+    /**
+      * Sets the period of this output, keeping the same duty cycle. Other outputs are unaffected.
+      *
+      * @param period the desired period in microseconds.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is out of range
+      */
+    int setPeriodUs(uint32_t period);
+
+    /**
+      * Sets the period of this output, keeping the same duty cycle. Other outputs are unaffected.
+      *
+      * @param period the desired period in milliseconds.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is out of range
+      */
+    int setPeriod(uint32_t period);
+
+    /**
+      * Destructor.
+      *
+      * Stops the output, leaving the pin LO, and frees its channel.
+      */
+    ~SoftPwmOut();
+};
+
+#endif
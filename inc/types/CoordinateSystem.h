@@ -133,11 +133,43 @@ struct Sample3D
 
 };
 
+/**
+ * A sample, together with the system time at which it was read from the sensor.
+ */
+struct TimedSample3D
+{
+    Sample3D    sample;
+    uint32_t    timestamp;      // The time the sample was read, in microseconds (as given by system_timer_current_time_us()).
+};
+
+
+/**
+ * A transformation between coordinate systems, expressed as the ENU axis and sign of each output axis.
+ * Every supported transformation is a signed permutation of the axes, so can be applied without branching.
+ */
+struct CoordinateMapping
+{
+    uint8_t     axis[3];        // The index (x=0, y=1, z=2) of the ENU axis providing each output axis.
+    int8_t      sign[3];        // 0 to copy that axis, -1 to negate it.
+};
 
 class CoordinateSpace
 {
+    /**
+     * Applies the mounting of the sensor and a coordinate system to a sample, step by step.
+     * Used to derive the mapping for each coordinate system when constructed.
+     *
+     * @param s the sample point to convert, in ENU format.
+     * @param system The coordinate system to use in the result.
+     * @return the equivalent location of 's' in the coordinate space and system given.
+     */
+    Sample3D compose(Sample3D s, CoordinateSystem system);
+
+    CoordinateMapping       mapping[EAST_NORTH_UP + 1];     // The transformation to each CoordinateSystem, indexed by system.
+
     public:
 
+        // n.b. The transformations are derived from these when constructed, so changing them afterwards has no effect.
         CoordinateSystem    system;
         bool                upsidedown;
         int                 rotated;
@@ -36,6 +36,24 @@ struct StringData : RefCounted
     char data[0];
 };
 
+/**
+  * Defines a ManagedString with the given name, backed by a read only StringData held in FLASH memory.
+  * Creating, copying and destroying such a string never allocates memory.
+  *
+  * @param name The name of the ManagedString to define.
+  *
+  * @param text The string literal to use.
+  *
+  * @code
+  * MANAGED_STRING_LITERAL(hello, "Hello");
+  * uBit.serial.send(hello);
+  * @endcode
+  */
+#define MANAGED_STRING_LITERAL(name, text)                                                                      \
+    static const struct { uint16_t refCount; uint16_t len; char data[sizeof(text)]; } name ## _literal        \
+        __attribute__ ((aligned (4))) = { 0xffff, sizeof(text) - 1, text };                                   \
+    static ManagedString name((StringData *)(void *) &name ## _literal)
+
 
 /**
   * Class definition for a ManagedString.
@@ -59,11 +77,14 @@ struct StringData : RefCounted
 class ManagedString
 {
     // StringData contains the reference count, the length, follwed by char[] data, all in one block.
-    // When referece count is 0xffff, then it's read only and should not be counted.
-    // Otherwise the block was malloc()ed.
+    // When referece count is 0xffff, then it's read only and should not be counted (e.g. the EmptyString,
+    // single character strings, and MANAGED_STRING_LITERAL). Otherwise the block was malloc()ed.
     // We control access to this to proide immutability and reference counting.
     StringData *ptr;
 
+    // Views share the StringData of the string they were created from.
+    friend class ManagedStringView;
+
     public:
 
     /**
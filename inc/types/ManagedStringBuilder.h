@@ -0,0 +1,168 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MANAGED_STRING_BUILDER_H
+#define MANAGED_STRING_BUILDER_H
+
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+
+/**
+  * Class definition for a ManagedStringBuilder.
+  *
+  * Builds up a string in a single buffer, which grows geometrically as text is appended, and then
+  * hands that buffer over to a ManagedString without copying it. This avoids the cost of creating
+  * (and copying) a new ManagedString for every intermediate result when concatenating many strings,
+  * e.g. a + b + c + d, or when composing a message in a loop.
+  *
+  * Numbers are formatted directly into the buffer, without creating temporary ManagedStrings.
+  *
+  * @code
+  * ManagedStringBuilder b;
+  *
+  * b.append("x:");
+  * b.append(x);
+  * b.append(" t:");
+  * b.append(temperature, 1);
+  *
+  * uBit.serial.send(b.toManagedString());
+  * @endcode
+  */
+class ManagedStringBuilder
+{
+    StringData      *ptr;           // The buffer being built, or NULL if none has been allocated yet.
+    uint16_t        capacity;       // The number of characters ptr can hold, excluding the terminating NULL.
+    uint16_t        initialCapacity;// The capacity with which to allocate the first buffer.
+
+    /**
+      * Ensures the buffer can hold at least the given number of additional characters, growing it if necessary.
+      *
+      * @param extra The number of characters about to be appended.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the buffer could not be grown.
+      */
+    int reserve(int extra);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an empty string builder. No memory is allocated until text is first appended.
+      *
+      * @param capacity The number of characters to allow space for initially. Defaults to MICROBIT_STRING_BUILDER_CAPACITY.
+      */
+    ManagedStringBuilder(int capacity = MICROBIT_STRING_BUILDER_CAPACITY);
+
+    /**
+      * Destructor.
+      *
+      * Releases any buffer still held by the builder.
+      */
+    ~ManagedStringBuilder();
+
+    /**
+      * Appends a NULL terminated character array to the string.
+      *
+      * @param str The characters to append.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if str is NULL, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      */
+    int append(const char *str);
+
+    /**
+      * Appends the given number of characters to the string.
+      *
+      * @param str The characters to append.
+      *
+      * @param length The number of characters to append.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if str is NULL or length is negative,
+      *         or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      */
+    int append(const char *str, int length);
+
+    /**
+      * Appends a ManagedString to the string.
+      *
+      * @param s The string to append.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      */
+    int append(const ManagedString &s);
+
+    /**
+      * Appends a single character to the string.
+      *
+      * @param c The character to append.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      */
+    int append(char c);
+
+    /**
+      * Appends the decimal representation of an integer to the string.
+      *
+      * @param value The integer to append.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      */
+    int append(int value);
+
+    /**
+      * Appends the decimal representation of a floating point number to the string, rounded to the given number of decimal places.
+      *
+      * @param value The number to append.
+      *
+      * @param decimals The number of digits to show after the decimal point, in the range 0..6.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if decimals is out of range, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+      *
+      * @note Values whose integer part does not fit in an int are shown as "inf" or "-inf". NaN is shown as "nan".
+      */
+    int append(float value, int decimals);
+
+    /**
+      * Determines the length of the string built so far.
+      *
+      * @return The number of characters in the string.
+      */
+    int length();
+
+    /**
+      * Discards the string built so far. Any buffer is retained for reuse.
+      */
+    void clear();
+
+    /**
+      * Creates a ManagedString from the text built so far. The builder's buffer is handed over to the
+      * new ManagedString without copying, and the builder is left empty.
+      *
+      * @return The string that has been built.
+      */
+    ManagedString toManagedString();
+};
+
+#endif
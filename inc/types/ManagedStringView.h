@@ -0,0 +1,209 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MANAGED_STRING_VIEW_H
+#define MANAGED_STRING_VIEW_H
+
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+
+/**
+  * Class definition for a ManagedStringView.
+  *
+  * A read only window onto part of a ManagedString. The view shares the StringData of the string it
+  * was created from, holding a reference to it, so creating, copying and destroying views never
+  * allocates or copies characters. This makes it cheap to split a line of text into tokens.
+  *
+  * Note that the characters of a view are not NULL terminated. Use toManagedString() where a
+  * NULL terminated string is needed.
+  *
+  * @code
+  * ManagedStringView line(uBit.serial.readUntil("\n"));
+  * int position = 0;
+  *
+  * while (position < line.length())
+  * {
+  *     ManagedStringView token = line.nextToken(' ', position);
+  *
+  *     if (token == "reset")
+  *         ...
+  * }
+  * @endcode
+  */
+class ManagedStringView
+{
+    StringData      *ptr;           // The StringData shared with the parent string.
+    uint16_t        offset;         // The index of the first character of the view within ptr->data.
+    uint16_t        len;            // The number of characters in the view.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Create an empty view.
+      */
+    ManagedStringView();
+
+    /**
+      * Constructor.
+      *
+      * Create a view of the whole of the given string.
+      *
+      * @param s The string to view.
+      */
+    ManagedStringView(const ManagedString &s);
+
+    /**
+      * Constructor.
+      *
+      * Create a view of part of the given string. The range is clipped to the bounds of the string.
+      *
+      * @param s The string to view.
+      *
+      * @param start The index of the first character of the view, indexed from zero.
+      *
+      * @param length The number of characters in the view.
+      */
+    ManagedStringView(const ManagedString &s, int start, int length);
+
+    /**
+      * Copy constructor.
+      *
+      * The new view shares the StringData of the given view.
+      *
+      * @param v The view to copy.
+      */
+    ManagedStringView(const ManagedStringView &v);
+
+    /**
+      * Destructor.
+      *
+      * Releases this view's reference to the underlying StringData.
+      */
+    ~ManagedStringView();
+
+    /**
+      * Copy assign operation.
+      *
+      * @param v The view to copy.
+      *
+      * @return a reference to this view.
+      */
+    ManagedStringView& operator = (const ManagedStringView &v);
+
+    /**
+      * Equality operation.
+      *
+      * @param v The view to compare against.
+      *
+      * @return true if the views contain the same characters, false otherwise.
+      */
+    bool operator== (const ManagedStringView &v) const;
+
+    /**
+      * Equality operation.
+      *
+      * @param str The NULL terminated character array to compare against.
+      *
+      * @return true if the view contains exactly the characters of str, false otherwise.
+      */
+    bool operator== (const char *str) const;
+
+    /**
+      * Creates a view of part of this view. The range is clipped to the bounds of this view.
+      *
+      * @param start The index of the first character, relative to the start of this view.
+      *
+      * @param length The number of characters.
+      *
+      * @return a view sharing the same StringData as this view.
+      */
+    ManagedStringView substring(int start, int length) const;
+
+    /**
+      * Finds the first occurrence of a character in this view.
+      *
+      * @param c The character to search for.
+      *
+      * @param start The index from which to start searching. Defaults to 0.
+      *
+      * @return the index of the character, relative to the start of this view, or -1 if it is not found.
+      */
+    int indexOf(char c, int start = 0) const;
+
+    /**
+      * Extracts the next token from this view, delimited by the given separator character.
+      *
+      * @param separator The character separating tokens.
+      *
+      * @param position The index from which to start. Updated to the index just past the separator
+      *                 that ended the token, or the length of the view if there was none.
+      *
+      * @return a view of the characters from position up to (but not including) the next separator.
+      */
+    ManagedStringView nextToken(char separator, int &position) const;
+
+    /**
+      * Provides a character value at a given position in the view, indexed from zero.
+      *
+      * @param index The position of the character to return.
+      *
+      * @return the character at position index, zero if index is invalid.
+      */
+    char charAt(int index) const;
+
+    /**
+      * Provides the characters of this view. These are NOT NULL terminated.
+      *
+      * @return a pointer to the first character of the view.
+      */
+    const char *getData() const
+    {
+        return ptr->data + offset;
+    }
+
+    /**
+      * Determines the length of this view in characters.
+      *
+      * @return the length of the view in characters.
+      */
+    int length() const
+    {
+        return len;
+    }
+
+    /**
+      * Creates a ManagedString holding the characters of this view.
+      *
+      * If the view covers the whole of its parent string, the parent's StringData is shared.
+      * Otherwise, the characters are copied into a new string.
+      *
+      * @return a ManagedString with the same characters as this view.
+      */
+    ManagedString toManagedString() const;
+};
+
+#endif
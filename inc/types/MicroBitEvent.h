@@ -52,7 +52,11 @@ class MicroBitEvent
 
     uint16_t source;         // ID of the MicroBit Component that generated the event e.g. MICROBIT_ID_BUTTON_A.
     uint16_t value;          // Component specific code indicating the cause of the event.
+#if CONFIG_ENABLED(MICROBIT_EVENT_COMPACT)
+    uint32_t timestamp;      // Time at which the event was generated. us since power on, wrapping every ~71 minutes.
+#else
     uint64_t timestamp;      // Time at which the event was generated. us since power on.
+#endif
 
     /**
       * Constructor.
@@ -77,6 +81,8 @@ class MicroBitEvent
 
     /**
       * Default constructor - initialises all values, and sets timestamp to the current time.
+      *
+      * If MICROBIT_EVENT_COMPACT is enabled, the timestamp is set to zero instead, avoiding a read of the system timer.
       */
     MicroBitEvent();
 
@@ -30,11 +30,28 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ManagedString.h"
 #include "RefCounted.h"
+#include "MicroBitImageLiteral.h"
+
+/**
+  * The ways in which the pixels of a MicroBitImage may be stored.
+  *
+  * The packed formats store pixels most significant bits first, with each row padded to a whole byte.
+  */
+enum MicroBitImageFormat
+{
+    MICROBIT_IMAGE_FORMAT_8BPP = 0,     // One byte per pixel, holding its brightness (0-255).
+    MICROBIT_IMAGE_FORMAT_4BPP = 1,     // Two pixels per byte, holding the top four bits of their brightness.
+    MICROBIT_IMAGE_FORMAT_1BPP = 2      // Eight pixels per byte, each either off (0) or on (255).
+};
+
+// The pixel format is held in the top bits of ImageData::height, so existing images are all MICROBIT_IMAGE_FORMAT_8BPP.
+#define MICROBIT_IMAGE_FORMAT_SHIFT     14
+#define MICROBIT_IMAGE_HEIGHT_MASK      0x3FFF
 
 struct ImageData : RefCounted
 {
     uint16_t width;     // Width in pixels
-    uint16_t height;    // Height in pixels
+    uint16_t height;    // Height in pixels (low 14 bits), and MicroBitImageFormat (top 2 bits)
     uint8_t data[0];    // 2D array representing the bitmap image
 };
 
@@ -42,7 +59,8 @@ struct ImageData : RefCounted
   * Class definition for a MicroBitImage.
   *
   * An MicroBitImage is a simple bitmap representation of an image.
-  * n.b. This is a mutable, managed type.
+  * n.b. This is a mutable, managed type. Copies of an image share the same bitmap until one of them
+  * is modified, at which point that copy takes a private copy of the bitmap (copy-on-write).
   */
 class MicroBitImage
 {
@@ -57,14 +75,24 @@ class MicroBitImage
       * @param y the height of the image
       *
       * @param bitmap an array of integers that make up an image.
+      *
+      * @param format the pixel format of the image. Defaults to MICROBIT_IMAGE_FORMAT_8BPP.
       */
-    void init(const int16_t x, const int16_t y, const uint8_t *bitmap);
+    void init(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format = MICROBIT_IMAGE_FORMAT_8BPP);
 
     /**
       * Internal constructor which defaults to the Empty Image instance variable
       */
     void init_empty();
 
+    /**
+      * Ensures this image holds the only reference to its bitmap, copying the bitmap if it is
+      * shared with other images or resides in flash. Called by every operation that modifies the image,
+      * so that copies of an image can be modified independently while the common case of a single
+      * owner is modified in place.
+      */
+    void detach();
+
     public:
     static MicroBitImage EmptyImage;    // Shared representation of a null image.
 
@@ -77,6 +105,11 @@ class MicroBitImage
 
     /**
       * Return a 2D array representing the bitmap image.
+      *
+      * @note The layout of the bitmap depends on the image's format (see getFormat() and getStride()).
+      *
+      * @note Writing to the bitmap directly bypasses copy-on-write, and so also modifies any copies of this image
+      *       sharing the same bitmap. Use the methods of MicroBitImage to modify an image, or clone() it first.
       */
     uint8_t *getBitmap()
     {
@@ -96,6 +129,21 @@ class MicroBitImage
       */
     MicroBitImage(ImageData *ptr);
 
+    /**
+      * Constructor.
+      * Create an image from a compile time image literal, with no parsing or copying.
+      *
+      * @param literal The literal, as declared by MICROBIT_IMAGE_LITERAL.
+      *
+      * @code
+      * MICROBIT_IMAGE_LITERAL(heart, "0,1,0,1,0\n1,1,1,1,1\n1,1,1,1,1\n0,1,1,1,0\n0,0,1,0,0\n");
+      * MicroBitImage i(heart);
+      * @endcode
+      */
+    template <uint16_t W, uint16_t H> MicroBitImage(const MicroBitImageLiteral<W, H> &literal) : MicroBitImage((ImageData *)(void *)&literal)
+    {
+    }
+
     /**
       * Default Constructor.
       * Creates a new reference to the empty MicroBitImage bitmap
@@ -167,6 +215,23 @@ class MicroBitImage
       */
     MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap);
 
+    /**
+      * Constructor.
+      * Create a blank bitmap representation of a given size, in the given pixel format.
+      *
+      * @param x the width of the image.
+      *
+      * @param y the height of the image.
+      *
+      * @param format the pixel format. The packed formats use an eighth (MICROBIT_IMAGE_FORMAT_1BPP)
+      *               or a half (MICROBIT_IMAGE_FORMAT_4BPP) of the memory of the default format.
+      *
+      * @code
+      * MicroBitImage i(100, 5, MICROBIT_IMAGE_FORMAT_1BPP); // a black and white canvas, of 65 bytes
+      * @endcode
+      */
+    MicroBitImage(const int16_t x, const int16_t y, MicroBitImageFormat format);
+
     /**
       * Destructor.
       *
@@ -415,11 +480,39 @@ class MicroBitImage
       */
     int getHeight() const
     {
-        return ptr->height;
+        return ptr->height & MICROBIT_IMAGE_HEIGHT_MASK;
+    }
+
+    /**
+      * Gets the pixel format of this image.
+      *
+      * @return The format of this image's bitmap.
+      */
+    MicroBitImageFormat getFormat() const
+    {
+        return (MicroBitImageFormat) (ptr->height >> MICROBIT_IMAGE_FORMAT_SHIFT);
     }
 
     /**
-      * Gets number of bytes in the bitmap, ie., width * height.
+      * Gets the number of bytes in each row of the bitmap.
+      *
+      * @return The stride of the bitmap. This is the width of the image for MICROBIT_IMAGE_FORMAT_8BPP.
+      */
+    int getStride() const
+    {
+        MicroBitImageFormat format = getFormat();
+
+        if (format == MICROBIT_IMAGE_FORMAT_1BPP)
+            return (ptr->width + 7) >> 3;
+
+        if (format == MICROBIT_IMAGE_FORMAT_4BPP)
+            return (ptr->width + 1) >> 1;
+
+        return ptr->width;
+    }
+
+    /**
+      * Gets number of bytes in the bitmap, ie., stride * height (width * height for MICROBIT_IMAGE_FORMAT_8BPP).
       *
       * @return The size of the bitmap.
       *
@@ -431,7 +524,7 @@ class MicroBitImage
       */
     int getSize() const
     {
-        return ptr->width * ptr->height;
+        return getStride() * getHeight();
     }
 
     /**
@@ -470,7 +563,10 @@ class MicroBitImage
     bool isReadOnly();
 
     /**
-      * Create a copy of the image bitmap. Used particularly, when isReadOnly() is true.
+      * Create a copy of the image bitmap.
+      *
+      * Modifying an image copies its bitmap automatically when it is shared, so this is only needed before
+      * writing to getBitmap() directly.
       *
       * @return an instance of MicroBitImage which can be modified independently of the current instance
       */
@@ -0,0 +1,157 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_IMAGE_LITERAL_H
+#define MICROBIT_IMAGE_LITERAL_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+/**
+  * Compile time image literals.
+  *
+  * These evaluate the text syntax accepted by MicroBitImage(const char *) while compiling, producing an
+  * ImageData with a read only reference count that the linker places in flash. Constructing a MicroBitImage
+  * from one therefore costs no parse time and no RAM, exactly as for a hand written 0xff, 0xff literal.
+  *
+  * Each pixel rescans the text, and each character costs a level of constexpr recursion, so these are
+  * intended for icon sized images of up to a few hundred characters.
+  */
+
+/**
+  * Determines whether the given character is a decimal digit.
+  */
+constexpr bool microbit_image_literal_digit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+  * Determines the width of an image literal: the largest number of values on any one line.
+  *
+  * @param s the text of the image, in the format accepted by MicroBitImage(const char *).
+  */
+constexpr int microbit_image_literal_width(const char *s, int count = 0, int digit = 0, int width = 0)
+{
+    return *s == 0 ? width :
+           microbit_image_literal_digit(*s) ? microbit_image_literal_width(s + 1, count, 1, width) :
+           *s == '\n' ? microbit_image_literal_width(s + 1, 0, 0, count + digit > width ? count + digit : width) :
+           microbit_image_literal_width(s + 1, count + digit, 0, width);
+}
+
+/**
+  * Determines the height of an image literal: the number of newline terminated lines.
+  *
+  * @param s the text of the image, in the format accepted by MicroBitImage(const char *).
+  */
+constexpr int microbit_image_literal_height(const char *s, int height = 0)
+{
+    return *s == 0 ? height : microbit_image_literal_height(s + 1, *s == '\n' ? height + 1 : height);
+}
+
+/**
+  * Determines the value of the given pixel of an image literal.
+  *
+  * As in MicroBitImage(const char *), values fill the bitmap in the order they appear, and any pixels
+  * left over once the values run out are zero.
+  *
+  * @param s the text of the image, in the format accepted by MicroBitImage(const char *).
+  *
+  * @param n the index of the pixel in the bitmap.
+  */
+constexpr uint8_t microbit_image_literal_pixel(const char *s, int n, int value = -1)
+{
+    return *s == 0 ? 0 :
+           microbit_image_literal_digit(*s) ? microbit_image_literal_pixel(s + 1, n, (value < 0 ? 0 : value) * 10 + *s - '0') :
+           value < 0 ? microbit_image_literal_pixel(s + 1, n) :
+           n == 0 ? (uint8_t) value :
+           microbit_image_literal_pixel(s + 1, n - 1);
+}
+
+/**
+  * A list of pixel indices, used to expand the bitmap of a MicroBitImageLiteral.
+  */
+template <int... I> struct MicroBitImageLiteralIndices
+{
+};
+
+template <int N, int... I> struct MicroBitImageLiteralSequence : MicroBitImageLiteralSequence<N - 1, N - 1, I...>
+{
+};
+
+template <int... I> struct MicroBitImageLiteralSequence<0, I...>
+{
+    typedef MicroBitImageLiteralIndices<I...> type;
+};
+
+/**
+  * An image held in flash, laid out exactly as an ImageData.
+  *
+  * These are normally declared through MICROBIT_IMAGE_LITERAL, rather than directly.
+  */
+template <uint16_t W, uint16_t H> struct __attribute__ ((aligned (4))) MicroBitImageLiteral
+{
+    uint16_t refCount;      // Always 0xffff, marking the image as read only.
+    uint16_t width;         // Width in pixels
+    uint16_t height;        // Height in pixels
+    uint8_t data[W * H];    // 2D array representing the bitmap image
+
+    /**
+      * Builds the literal for the given text.
+      *
+      * @param s the text of the image, in the format accepted by MicroBitImage(const char *).
+      */
+    static constexpr MicroBitImageLiteral build(const char *s)
+    {
+        return build(s, typename MicroBitImageLiteralSequence<W * H>::type());
+    }
+
+    template <int... I> static constexpr MicroBitImageLiteral build(const char *s, MicroBitImageLiteralIndices<I...>)
+    {
+        return MicroBitImageLiteral { 0xffff, W, H, { microbit_image_literal_pixel(s, I)... } };
+    }
+};
+
+/**
+  * The type of the image literal for the given text.
+  */
+#define MICROBIT_IMAGE_LITERAL_TYPE(text) MicroBitImageLiteral<microbit_image_literal_width(text), microbit_image_literal_height(text)>
+
+/**
+  * Declares a flash resident image, from the text syntax accepted by MicroBitImage(const char *).
+  * May be used at file or function scope, and passed to the MicroBitImage constructor.
+  *
+  * @param name the name of the literal.
+  *
+  * @param text the text of the image, as a string literal.
+  *
+  * @code
+  * MICROBIT_IMAGE_LITERAL(heart, "0,1,0,1,0\n1,1,1,1,1\n1,1,1,1,1\n0,1,1,1,0\n0,0,1,0,0\n");
+  * MicroBitImage i(heart);
+  * @endcode
+  */
+#define MICROBIT_IMAGE_LITERAL(name, text) static constexpr MICROBIT_IMAGE_LITERAL_TYPE(text) name = MICROBIT_IMAGE_LITERAL_TYPE(text)::build(text)
+
+#endif
@@ -0,0 +1,162 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Orientation calculations shared by MicroBitAccelerometer and MicroBitCompass.
+  *
+  * Each calculation is provided both in floating point, and in fixed point using CORDIC. The nRF51 has no
+  * floating point unit, so the trigonometric functions of the C library are emulated in software and cost
+  * several thousand cycles each. The fixed point versions use only shifts and additions, and are accurate to
+  * within a few hundredths of a degree. MICROBIT_FIXED_POINT_ORIENTATION selects which is used by the drivers.
+  *
+  * Fixed point angles are binary angles, where a full turn is MICROBIT_ANGLE_FULL_TURN, so that they wrap
+  * around naturally. Fixed point sines and cosines are scaled by MICROBIT_ANGLE_UNITY.
+  */
+#ifndef MICROBIT_ORIENTATION_H
+#define MICROBIT_ORIENTATION_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "CoordinateSystem.h"
+
+#define MICROBIT_ANGLE_FULL_TURN        65536
+#define MICROBIT_ANGLE_HALF_TURN        32768
+#define MICROBIT_ANGLE_QUARTER_TURN     16384
+
+// The fixed point representation of 1.0 used for sines and cosines (Q14).
+#define MICROBIT_ANGLE_UNITY            16384
+#define MICROBIT_ANGLE_UNITY_SHIFT      14
+
+// The number of CORDIC iterations performed. Each adds roughly one bit of precision.
+#define MICROBIT_CORDIC_ITERATIONS      15
+
+/**
+  * Calculates the angle of the vector (x, y) from the x axis, as atan2(y, x) does.
+  *
+  * @param y the y component of the vector.
+  *
+  * @param x the x component of the vector.
+  *
+  * @return the angle, as a binary angle between -MICROBIT_ANGLE_HALF_TURN and MICROBIT_ANGLE_HALF_TURN.
+  *         Zero is returned for a zero length vector.
+  */
+int32_t fixed_atan2(int32_t y, int32_t x);
+
+/**
+  * Calculates the sine and cosine of an angle.
+  *
+  * @param angle the angle, as a binary angle. Any value is accepted, and wrapped to a single turn.
+  *
+  * @param sine set to the sine of the angle, scaled by MICROBIT_ANGLE_UNITY.
+  *
+  * @param cosine set to the cosine of the angle, scaled by MICROBIT_ANGLE_UNITY.
+  */
+void fixed_sincos(int32_t angle, int32_t &sine, int32_t &cosine);
+
+/**
+  * Converts an angle in radians to a binary angle.
+  *
+  * @param radians the angle, in radians.
+  *
+  * @return the binary angle.
+  */
+int32_t fixed_from_radians(float radians);
+
+/**
+  * Converts a binary angle to radians.
+  *
+  * @param angle the binary angle.
+  *
+  * @return the angle, in radians.
+  */
+float fixed_to_radians(int32_t angle);
+
+/**
+  * Calculates the pitch and roll of the device from an accelerometer sample, in floating point.
+  *
+  * @param sample the accelerometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @param pitch set to the pitch of the device, in radians.
+  *
+  * @param roll set to the roll of the device, in radians.
+  */
+void orientation_pitch_roll(const Sample3D &sample, float &pitch, float &roll);
+
+/**
+  * Calculates the pitch and roll of the device from an accelerometer sample, in fixed point.
+  *
+  * @param sample the accelerometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @param pitch set to the pitch of the device, in radians.
+  *
+  * @param roll set to the roll of the device, in radians.
+  */
+void orientation_pitch_roll_fixed(const Sample3D &sample, float &pitch, float &roll);
+
+/**
+  * Calculates a tilt compensated bearing from a magnetometer sample, in floating point.
+  *
+  * @param field the magnetometer sample, in the NORTH_EAST_DOWN coordinate system.
+  *
+  * @param pitch the pitch of the device, in radians.
+  *
+  * @param roll the roll of the device, in radians.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_bearing(const Sample3D &field, float pitch, float roll);
+
+/**
+  * Calculates a tilt compensated bearing from a magnetometer sample, in fixed point.
+  *
+  * @param field the magnetometer sample, in the NORTH_EAST_DOWN coordinate system.
+  *
+  * @param pitch the pitch of the device, in radians.
+  *
+  * @param roll the roll of the device, in radians.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_bearing_fixed(const Sample3D &field, float pitch, float roll);
+
+/**
+  * Calculates a bearing from a magnetometer sample, without tilt compensation, in floating point.
+  *
+  * @param field the magnetometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_basic_bearing(const Sample3D &field);
+
+/**
+  * Calculates a bearing from a magnetometer sample, without tilt compensation, in fixed point.
+  *
+  * @param field the magnetometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_basic_bearing_fixed(const Sample3D &field);
+
+#endif
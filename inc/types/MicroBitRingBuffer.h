@@ -0,0 +1,327 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_RING_BUFFER_H
+#define MICROBIT_RING_BUFFER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+
+// The largest number of bytes a ring buffer can hold.
+#define MICROBIT_RING_BUFFER_MAX_SIZE       32767
+
+/**
+  * Class definition for a MicroBitRingBuffer.
+  *
+  * A byte circular buffer shared by the serial transports. It is safe without locking for a single
+  * producer and a single consumer, such as an interrupt handler filling the buffer while a fiber
+  * empties it: the head is only moved by the producer, and the tail only by the consumer.
+  *
+  * One byte of storage is always left free, so that a full buffer can be told apart from an empty one.
+  */
+class MicroBitRingBuffer
+{
+    uint8_t *buffer;
+    uint16_t size;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an empty ring buffer. No storage is allocated until allocate() is called.
+      *
+      * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+      */
+    MicroBitRingBuffer(int capacity = 0);
+
+    /**
+      * Destructor.
+      *
+      * Frees the storage of this ring buffer.
+      */
+    ~MicroBitRingBuffer();
+
+    /**
+      * Changes the number of bytes the buffer can hold. This takes effect the next time allocate() is called.
+      *
+      * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+      */
+    void setCapacity(int capacity);
+
+    /**
+      * Allocates new storage for this ring buffer, freeing any existing storage and its contents.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @note interrupts that use this buffer should be disabled while it is reallocated.
+      */
+    int allocate();
+
+    /**
+      * Frees the storage of this ring buffer.
+      */
+    void release();
+
+    /**
+      * Determines the storage needed for a buffer of the given capacity.
+      *
+      * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+      *
+      * @return the number of bytes of storage for the buffer.
+      */
+    static uint16_t storageFor(int capacity);
+
+    /**
+      * Wraps an index into this buffer's storage.
+      *
+      * @param index a non-negative index.
+      *
+      * @return the index, wrapped to the storage of the buffer.
+      */
+    inline uint16_t wrap(int index) const
+    {
+#if CONFIG_ENABLED(MICROBIT_SERIAL_POWER_OF_TWO_BUFFERS)
+        return index & (size - 1);
+#else
+        return index % size;
+#endif
+    }
+
+    /**
+      * Advances an index by one position, without a division.
+      *
+      * @param index an index into the storage of the buffer.
+      *
+      * @return the following index.
+      */
+    inline uint16_t next(uint16_t index) const
+    {
+#if CONFIG_ENABLED(MICROBIT_SERIAL_POWER_OF_TWO_BUFFERS)
+        return (index + 1) & (size - 1);
+#else
+        return (index + 1 == size) ? 0 : index + 1;
+#endif
+    }
+
+    /**
+      * Adds a single byte to the head of the buffer. Called by the producer only.
+      *
+      * @param c the byte to add.
+      *
+      * @return true if the byte was added, false if the buffer is full.
+      */
+    inline bool put(uint8_t c)
+    {
+        uint16_t nextHead = next(head);
+
+        if(nextHead == tail)
+            return false;
+
+        buffer[head] = c;
+        head = nextHead;
+
+        return true;
+    }
+
+    /**
+      * Removes a single byte from the tail of the buffer. Called by the consumer only.
+      *
+      * @return the byte, or -1 if the buffer is empty.
+      */
+    inline int get()
+    {
+        if(tail == head)
+            return -1;
+
+        uint8_t c = buffer[tail];
+        tail = next(tail);
+
+        return c;
+    }
+
+    /**
+      * Reads a byte from the buffer, without removing it. Called by the consumer only.
+      *
+      * @param offset the position of the byte, relative to the tail of the buffer.
+      *
+      * @return the byte, or -1 if fewer than offset + 1 bytes are buffered.
+      */
+    int peek(int offset = 0);
+
+    /**
+      * Adds as many bytes as will fit to the head of the buffer. Called by the producer only.
+      *
+      * @param data the bytes to add.
+      *
+      * @param len the number of bytes to add.
+      *
+      * @return the number of bytes added.
+      */
+    int write(const uint8_t *data, int len);
+
+    /**
+      * Removes up to len bytes from the tail of the buffer. Called by the consumer only.
+      *
+      * @param data the buffer to store the bytes in.
+      *
+      * @param len the largest number of bytes to remove.
+      *
+      * @return the number of bytes removed.
+      */
+    int read(uint8_t *data, int len);
+
+    /**
+      * Copies up to len bytes from the tail of the buffer, without removing them. Called by the consumer only.
+      *
+      * @param data the buffer to store the bytes in.
+      *
+      * @param len the largest number of bytes to copy.
+      *
+      * @return the number of bytes copied.
+      */
+    int copy(uint8_t *data, int len);
+
+    /**
+      * Searches the buffered bytes for the first character in a delimeter map.
+      *
+      * @param map a delimeter map, built with delimeterMap().
+      *
+      * @param offset the position to search from, relative to the tail of the buffer.
+      *
+      * @return the position of the first delimeter relative to the tail of the buffer, or -1 if none is buffered.
+      */
+    int find(const uint32_t *map, int offset = 0);
+
+    /**
+      * Provides direct access to the longest contiguous run of buffered bytes. Called by the consumer only.
+      *
+      * @param data set to point at the first buffered byte.
+      *
+      * @return the number of bytes in the run.
+      */
+    int getReadRegion(uint8_t *&data);
+
+    /**
+      * Removes bytes from the tail of the buffer, after they have been read through getReadRegion().
+      *
+      * @param len the number of bytes to remove.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than are buffered.
+      */
+    int commitRead(int len);
+
+    /**
+      * Provides direct access to the longest contiguous run of free storage. Called by the producer only.
+      *
+      * @param data set to point at the first free byte.
+      *
+      * @return the number of bytes in the run.
+      */
+    int getWriteRegion(uint8_t *&data);
+
+    /**
+      * Adds bytes to the head of the buffer, after they have been written through getWriteRegion().
+      *
+      * @param len the number of bytes to add.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than will fit.
+      */
+    int commitWrite(int len);
+
+    /**
+      * Discards the buffered bytes. Called by the consumer only.
+      */
+    void clear();
+
+    /**
+      * @return the number of bytes currently buffered.
+      */
+    int length();
+
+    /**
+      * @return the number of bytes that can be added before the buffer is full.
+      */
+    int space();
+
+    /**
+      * @return true if no bytes are buffered.
+      */
+    bool isEmpty();
+
+    /**
+      * @return true if no more bytes can be added.
+      */
+    bool isFull();
+
+    /**
+      * @return the number of bytes the buffer can hold.
+      */
+    int getCapacity();
+
+    /**
+      * @return the number of bytes of storage, including the byte that is always left free.
+      */
+    int getSize();
+
+    /**
+      * @return the head index, where the next byte added will be stored.
+      */
+    uint16_t getHead();
+
+    /**
+      * @return a pointer to the storage of this buffer, or NULL if it has none.
+      */
+    uint8_t *getBuffer();
+
+    /**
+      * Builds a bitmap of the given delimeters, with one bit for each character value, so that
+      * characters can be matched with a single lookup.
+      *
+      * @param delimeters the delimeter characters.
+      *
+      * @param map the bitmap of 8 words to populate.
+      */
+    static void delimeterMap(ManagedString delimeters, uint32_t *map);
+
+    /**
+      * Determines if a character is in a delimeter bitmap.
+      *
+      * @param map a bitmap built with delimeterMap().
+      *
+      * @param c the character to test.
+      *
+      * @return true if c is one of the delimeters.
+      */
+    static inline bool isDelimeter(const uint32_t *map, uint8_t c)
+    {
+        return (map[c >> 5] & (1UL << (c & 0x1F))) != 0;
+    }
+};
+
+#endif
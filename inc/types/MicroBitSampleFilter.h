@@ -0,0 +1,138 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_SAMPLE_FILTER_H
+#define MICROBIT_SAMPLE_FILTER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "CoordinateSystem.h"
+
+/**
+  * Filter types.
+  */
+#define MICROBIT_FILTER_NONE                0       // Samples are passed through unchanged.
+#define MICROBIT_FILTER_MOVING_AVERAGE      1       // The mean of the last 'length' samples.
+#define MICROBIT_FILTER_EXPONENTIAL         2       // Each sample moves the output 1/length of the way towards it.
+#define MICROBIT_FILTER_MEDIAN              3       // The median of the last 'length' samples, in each axis.
+
+/**
+  * Class definition for a MicroBitSampleFilter.
+  *
+  * Smooths the samples read by a sensor driver. Each sample is folded into the filter as it arrives,
+  * so that reading the filtered value costs nothing. Scalar sensors use the x axis only.
+  *
+  * No storage is allocated unless a moving average or median filter is configured.
+  */
+class MicroBitSampleFilter
+{
+    Sample3D    *history;               // The last 'length' samples, for the moving average and median filters.
+    Sample3D    output;                 // The filtered value.
+    int32_t     state[3];               // The sum of the samples held (moving average), or the output scaled by 16 (exponential).
+    uint8_t     type;                   // The type of filter, e.g. MICROBIT_FILTER_MEDIAN.
+    uint8_t     length;                 // The number of samples filtered over.
+    uint8_t     count;                  // The number of samples held in history.
+    uint8_t     head;                   // The position in history of the next sample.
+    uint8_t     shift;                  // log2(length), for the exponential filter.
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates a filter that passes samples through unchanged.
+      */
+    MicroBitSampleFilter();
+
+    /**
+      * Destructor.
+      *
+      * Frees the storage of the filter, if any.
+      */
+    ~MicroBitSampleFilter();
+
+    /**
+      * Selects the filter to apply, discarding any samples it holds.
+      *
+      * @param type The type of filter: MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE,
+      *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+      *
+      * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+      *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+      *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      *
+      * @note If the filter is fed from an interrupt, reconfiguring it is safe, but should be rare.
+      */
+    int configure(int type, int length);
+
+    /**
+      * Determines if a filter type and length are supported, as given to configure().
+      *
+      * @return true if the filter can be configured, false otherwise.
+      */
+    static bool isValid(int type, int length);
+
+    /**
+      * @return the type of filter in use, e.g. MICROBIT_FILTER_MEDIAN.
+      */
+    int getType();
+
+    /**
+      * @return the number of samples filtered over.
+      */
+    int getLength();
+
+    /**
+      * Discards the samples held, so the next sample is passed through unchanged.
+      */
+    void reset();
+
+    /**
+      * Adds a sample to the filter. Called by the sensor driver only.
+      *
+      * @param sample The sample to add.
+      *
+      * @return the filtered value, including this sample.
+      */
+    Sample3D push(const Sample3D &sample);
+
+    /**
+      * Adds a scalar sample to the filter. Called by the sensor driver only.
+      *
+      * @param value The sample to add.
+      *
+      * @return the filtered value, including this sample.
+      */
+    int push(int value);
+
+    /**
+      * @return the filtered value, as of the last sample pushed.
+      */
+    Sample3D get();
+};
+
+#endif
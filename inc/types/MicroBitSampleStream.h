@@ -0,0 +1,101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_SAMPLE_STREAM_H
+#define MICROBIT_SAMPLE_STREAM_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "CoordinateSystem.h"
+#include "MicroBitRingBuffer.h"
+
+/**
+  * Class definition for a MicroBitSampleStream.
+  *
+  * A queue of timestamped samples, filled by a sensor driver as each sample is read and emptied in bulk
+  * by an application fiber. This lets an application process every sample without keeping pace with
+  * the sensor's data update events.
+  *
+  * No storage is allocated until a capacity is set. When the queue is full, new samples are discarded and counted.
+  */
+class MicroBitSampleStream
+{
+    MicroBitRingBuffer buffer;
+    uint32_t overflows;
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates a disabled sample stream.
+      */
+    MicroBitSampleStream();
+
+    /**
+      * Sets the number of samples the stream can hold, discarding any samples it holds.
+      *
+      * @param samples the number of samples to hold, or zero to disable the stream and free its storage.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+      *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+      */
+    int setCapacity(int samples);
+
+    /**
+      * @return the number of samples the stream can hold, or zero if it is disabled.
+      */
+    int getCapacity();
+
+    /**
+      * Adds a sample to the stream, timestamped with the current system time. Called by the sensor driver only.
+      *
+      * @param sample the sample to add.
+      */
+    void push(const Sample3D &sample);
+
+    /**
+      * Removes up to length of the oldest samples from the stream. Called by the consumer only.
+      *
+      * @param samples the buffer to store the samples in.
+      *
+      * @param length the largest number of samples to remove.
+      *
+      * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+      */
+    int read(TimedSample3D *samples, int length);
+
+    /**
+      * @return the number of samples waiting to be read.
+      */
+    int available();
+
+    /**
+      * @return the number of samples discarded because the stream was full, since its capacity was last set.
+      */
+    uint32_t getOverflowCount();
+};
+
+#endif
@@ -30,10 +30,15 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "RefCounted.h"
 
+// The number of bytes reserved immediately ahead of the payload of every PacketBuffer, so that a lower layer
+// can prepend its header in place rather than copying the payload.
+#define MICROBIT_PACKET_BUFFER_HEADROOM     4
+
 struct PacketData : RefCounted
 {
-    int             rssi;               // The radio signal strength this packet was received.
     uint8_t         length;             // The length of the payload in bytes
+    int             rssi;               // The radio signal strength this packet was received.
+    uint8_t         headroom[MICROBIT_PACKET_BUFFER_HEADROOM];  // Space for a lower layer header. Not part of the packet contents.
     uint8_t         payload[0];         // User / higher layer protocol data
 };
 
@@ -56,6 +61,15 @@ class PacketBuffer
       */
     uint8_t *getBytes();
 
+    /**
+      * Provide a pointer to the MICROBIT_PACKET_BUFFER_HEADROOM bytes held immediately ahead of the packet data,
+      * which a lower layer may use to prepend a header in place. These bytes are not part of the packet contents,
+      * and are not copied or compared with the packet.
+      *
+      * @return The start of the headroom. The packet data follows it directly.
+      */
+    uint8_t *getHeadroom();
+
     /**
       * Default Constructor.
       * Creates an empty Packet Buffer.
@@ -96,6 +110,15 @@ class PacketBuffer
       */
     PacketBuffer(uint8_t *data, int length, int rssi = 0);
 
+    /**
+      * Constructor.
+      * Creates a PacketBuffer that takes ownership of an existing payload, without copying it.
+      *
+      * @param data The payload to adopt. This must have been initialised with a single reference,
+      *             and be held in memory that can be released with microbit_pool_free().
+      */
+    PacketBuffer(PacketData *data);
+
     /**
       * Copy Constructor.
       * Add ourselves as a reference to an existing PacketBuffer.
@@ -32,7 +32,7 @@ DEALINGS IN THE SOFTWARE.
 
 /**
   * Base class for payload for ref-counted objects. Used by ManagedString and MicroBitImage.
-  * There is no constructor, as this struct is typically malloc()ed.
+  * There is no constructor, as this struct is typically malloc()ed, or allocated from a MicroBitMemoryPool.
   */
 struct RefCounted
 {
@@ -67,6 +67,13 @@ public:
       * @return true if the object resides in flash memory, false otherwise.
       */
     bool isReadOnly();
+
+    /**
+      * Checks if the object may be seen by more than one owner, and so must be copied before it is modified.
+      *
+      * @return true if the object resides in flash memory or has more than one outstanding reference, false otherwise.
+      */
+    bool isShared();
 };
 
 #endif
@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ble/UUID.h"
 
 #include "MicroBitAccelerometerService.h"
+#include "MicroBitBLEManager.h"
 
 /**
   * Constructor.
@@ -49,6 +50,20 @@ MicroBitAccelerometerService::MicroBitAccelerometerService(BLEDevice &_ble, Micr
     sizeof(accelerometerPeriodCharacteristicBuffer),
     GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattCharacteristic  accelerometerBatchCharacteristic(MicroBitAccelerometerServiceBatchUUID, (uint8_t *)accelerometerBatchCharacteristicBuffer, 0,
+    sizeof(accelerometerBatchCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    memset(accelerometerBatchCharacteristicBuffer, 0, sizeof(accelerometerBatchCharacteristicBuffer));
+    batchPending = false;
+
+    accelerometerBatchCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Batches are drawn from the accelerometer's stream, so enable it unless the application already has.
+    if (accelerometer.getStream().getCapacity() == 0)
+        accelerometer.setStreamSize(MICROBIT_BLE_SENSOR_BATCH_STREAM_SIZE);
+#endif
+
     // Initialise our characteristic values.
     accelerometerDataCharacteristicBuffer[0] = 0;
     accelerometerDataCharacteristicBuffer[1] = 0;
@@ -59,7 +74,11 @@ MicroBitAccelerometerService::MicroBitAccelerometerService(BLEDevice &_ble, Micr
     accelerometerDataCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     accelerometerPeriodCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattCharacteristic *characteristics[] = {&accelerometerDataCharacteristic, &accelerometerPeriodCharacteristic, &accelerometerBatchCharacteristic};
+#else
     GattCharacteristic *characteristics[] = {&accelerometerDataCharacteristic, &accelerometerPeriodCharacteristic};
+#endif
     GattService         service(MicroBitAccelerometerServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -67,6 +86,17 @@ MicroBitAccelerometerService::MicroBitAccelerometerService(BLEDevice &_ble, Micr
     accelerometerDataCharacteristicHandle = accelerometerDataCharacteristic.getValueHandle();
     accelerometerPeriodCharacteristicHandle = accelerometerPeriodCharacteristic.getValueHandle();
 
+    // Streaming accelerometer data benefits from the shortest connection interval.
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->addHighRateCharacteristic(accelerometerDataCharacteristicHandle);
+
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    accelerometerBatchCharacteristicHandle = accelerometerBatchCharacteristic.getValueHandle();
+
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->addHighRateCharacteristic(accelerometerBatchCharacteristicHandle);
+#endif
+
     ble.gattServer().write(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, sizeof(accelerometerDataCharacteristicBuffer));
     ble.gattServer().write(accelerometerPeriodCharacteristicHandle, (const uint8_t *)&accelerometerPeriodCharacteristicBuffer, sizeof(accelerometerPeriodCharacteristicBuffer));
 
@@ -105,9 +135,52 @@ void MicroBitAccelerometerService::accelerometerUpdate(MicroBitEvent)
         accelerometerDataCharacteristicBuffer[2] = accelerometer.getZ();
 
         ble.gattServer().notify(accelerometerDataCharacteristicHandle,(uint8_t *)accelerometerDataCharacteristicBuffer, sizeof(accelerometerDataCharacteristicBuffer));
+
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+        sendBatches();
+#endif
     }
 }
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+/**
+ * Sends as many batches of samples from the accelerometer's stream as the Bluetooth stack will take.
+ */
+void MicroBitAccelerometerService::sendBatches()
+{
+    TimedSample3D samples[MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES];
+
+    while (true)
+    {
+        if (!batchPending)
+        {
+            if (accelerometer.getStream().available() < MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES)
+                return;
+
+            accelerometer.readStream(samples, MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES);
+
+            // Later samples follow at the accelerometer's period, so only the first is timestamped.
+            accelerometerBatchCharacteristicBuffer[0] = (int16_t)(samples[0].timestamp / 1000);
+
+            for (int i = 0; i < MICROBIT_ACCELEROMETER_SERVICE_BATCH_SAMPLES; i++)
+            {
+                accelerometerBatchCharacteristicBuffer[1 + 3 * i] = samples[i].sample.x;
+                accelerometerBatchCharacteristicBuffer[2 + 3 * i] = samples[i].sample.y;
+                accelerometerBatchCharacteristicBuffer[3 + 3 * i] = samples[i].sample.z;
+            }
+
+            batchPending = true;
+        }
+
+        // If the stack is out of buffers, keep the batch for the next update.
+        if (ble.gattServer().notify(accelerometerBatchCharacteristicHandle, (uint8_t *)accelerometerBatchCharacteristicBuffer, sizeof(accelerometerBatchCharacteristicBuffer)) != BLE_ERROR_NONE)
+            return;
+
+        batchPending = false;
+    }
+}
+#endif
+
 const uint8_t  MicroBitAccelerometerServiceUUID[] = {
     0xe9,0x5d,0x07,0x53,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
@@ -119,3 +192,7 @@ const uint8_t  MicroBitAccelerometerServiceDataUUID[] = {
 const uint8_t  MicroBitAccelerometerServicePeriodUUID[] = {
     0xe9,0x5d,0xfb,0x24,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
+
+const uint8_t  MicroBitAccelerometerServiceBatchUUID[] = {
+    0xe9,0x5d,0xba,0x7c,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
@@ -88,37 +88,7 @@ MicroBitBLEManager *MicroBitBLEManager::manager = NULL; // Singleton reference t
 
 static uint8_t deviceID = 255;          // Unique ID for the peer that has connected to us.
 static Gap::Handle_t pairingHandle = 0; // The connection handle used during a pairing process. Used to ensure that connections are dropped elegantly.
-
-static void storeSystemAttributes(Gap::Handle_t handle)
-{
-    if (MicroBitBLEManager::manager->storage != NULL && deviceID < MICROBIT_BLE_MAXIMUM_BONDS)
-    {
-        ManagedString key("bleSysAttrs");
-
-        KeyValuePair *bleSysAttrs = MicroBitBLEManager::manager->storage->get(key);
-
-        BLESysAttribute attrib;
-        BLESysAttributeStore attribStore;
-
-        uint16_t len = sizeof(attrib.sys_attr);
-
-        sd_ble_gatts_sys_attr_get(handle, attrib.sys_attr, &len, BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS);
-
-        //copy our stored sysAttrs
-        if (bleSysAttrs != NULL)
-        {
-            memcpy(&attribStore, bleSysAttrs->value, sizeof(BLESysAttributeStore));
-            delete bleSysAttrs;
-        }
-
-        //check if we need to update
-        if (memcmp(attribStore.sys_attrs[deviceID].sys_attr, attrib.sys_attr, len) != 0)
-        {
-            attribStore.sys_attrs[deviceID] = attrib;
-            MicroBitBLEManager::manager->storage->put(key, (uint8_t *)&attribStore, sizeof(attribStore));
-        }
-    }
-}
+static Gap::Handle_t connectionHandle = 0; // The connection handle of the connected client, used to renegotiate connection parameters.
 
 /**
   * Callback when a BLE GATT disconnect occurs.
@@ -129,64 +99,71 @@ static void bleDisconnectionCallback(const Gap::DisconnectionCallbackParams_t *r
 
     if (MicroBitBLEManager::manager)
     {
-        MicroBitBLEManager::manager->advertise();
         MicroBitBLEManager::manager->deferredSysAttrWrite(reason->handle);
+        MicroBitBLEManager::manager->advertise();
+        MicroBitBLEManager::manager->connectionClosed();
     }
 }
 
 /**
   * Callback when a BLE connection is established.
   */
-static void bleConnectionCallback(const Gap::ConnectionCallbackParams_t *)
+static void bleConnectionCallback(const Gap::ConnectionCallbackParams_t *params)
 {
+    connectionHandle = params->handle;
+
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->connectionOpened();
+
     MicroBitEvent(MICROBIT_ID_BLE, MICROBIT_BLE_EVT_CONNECTED);
 }
 
+/**
+  * Callback when a client enables notifications or indications on a characteristic.
+  */
+static void bleUpdatesEnabledCallback(GattAttribute::Handle_t handle)
+{
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->updatesEnabled(handle, true);
+}
+
+/**
+  * Callback when a client disables notifications or indications on a characteristic.
+  */
+static void bleUpdatesDisabledCallback(GattAttribute::Handle_t handle)
+{
+    if (MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->updatesEnabled(handle, false);
+}
+
 /**
   * Callback when a BLE SYS_ATTR_MISSING.
   */
 static void bleSysAttrMissingCallback(const GattSysAttrMissingCallbackParams *params)
 {
-    int complete = 0;
+    int ret = MICROBIT_NO_DATA;
     deviceID = 255;
 
     dm_handle_t dm_handle = {0, 0, 0, 0};
 
-    int ret = dm_handle_get(params->connHandle, &dm_handle);
-
-    if (ret == 0)
+    if (dm_handle_get(params->connHandle, &dm_handle) == 0)
         deviceID = dm_handle.device_id;
 
-    if (MicroBitBLEManager::manager->storage != NULL && deviceID < MICROBIT_BLE_MAXIMUM_BONDS)
-    {
-        ManagedString key("bleSysAttrs");
-
-        KeyValuePair *bleSysAttrs = MicroBitBLEManager::manager->storage->get(key);
-
-        BLESysAttributeStore attribStore;
-        BLESysAttribute attrib;
-
-        if (bleSysAttrs != NULL)
-        {
-            //restore our sysAttrStore
-            memcpy(&attribStore, bleSysAttrs->value, sizeof(BLESysAttributeStore));
-            delete bleSysAttrs;
-
-            attrib = attribStore.sys_attrs[deviceID];
-
-            ret = sd_ble_gatts_sys_attr_set(params->connHandle, attrib.sys_attr, sizeof(attrib.sys_attr), BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS);
-
-            complete = 1;
+    if (MicroBitBLEManager::manager)
+        ret = MicroBitBLEManager::manager->restoreSystemAttributes(params->connHandle, deviceID);
 
-            if (ret == 0)
-                ret = sd_ble_gatts_service_changed(params->connHandle, 0x000c, 0xffff);
-        }
-    }
+    if (ret == MICROBIT_OK)
+        sd_ble_gatts_service_changed(params->connHandle, 0x000c, 0xffff);
 
-    if (!complete)
+    if (ret == MICROBIT_NO_DATA)
         sd_ble_gatts_sys_attr_set(params->connHandle, NULL, 0, 0);
 }
 
+static void storeSystemAttributesFiber(void *manager)
+{
+    ((MicroBitBLEManager *)manager)->storeSystemAttributes();
+}
+
 static void passkeyDisplayCallback(Gap::Handle_t handle, const SecurityManager::Passkey_t passkey)
 {
     (void)handle; /* -Wunused-param */
@@ -229,6 +206,14 @@ MicroBitBLEManager::MicroBitBLEManager(MicroBitStorage &_storage) : storage(&_st
     manager = this;
     this->ble = NULL;
     this->pairingStatus = 0;
+    this->connectionProfile = MICROBIT_BLE_PROFILE_BALANCED;
+    this->activeProfile = MICROBIT_BLE_PROFILE_BALANCED;
+    this->highRateCount = 0;
+    this->highRateEnabled = 0;
+    this->messageBus = NULL;
+    memset(&bootProfile, 0, sizeof(bootProfile));
+    this->sysAttrsValid = 0;
+    this->sysAttrsChangedAt = 0;
     this->status = MICROBIT_COMPONENT_RUNNING;
 }
 
@@ -245,6 +230,14 @@ MicroBitBLEManager::MicroBitBLEManager() : storage(NULL)
     manager = this;
     this->ble = NULL;
     this->pairingStatus = 0;
+    this->connectionProfile = MICROBIT_BLE_PROFILE_BALANCED;
+    this->activeProfile = MICROBIT_BLE_PROFILE_BALANCED;
+    this->highRateCount = 0;
+    this->highRateEnabled = 0;
+    this->messageBus = NULL;
+    memset(&bootProfile, 0, sizeof(bootProfile));
+    this->sysAttrsValid = 0;
+    this->sysAttrsChangedAt = 0;
 }
 
 /**
@@ -267,18 +260,131 @@ MicroBitBLEManager *MicroBitBLEManager::getInstance()
 void MicroBitBLEManager::advertise()
 {
     if (ble)
+    {
+        startServices();
         ble->gap().startAdvertising();
+    }
 }
 
 /**
- * A member function used to defer writes to flash, in order to prevent a write collision with 
- * softdevice.
- * @param handle The handle offered by soft device during pairing.
+ * Records the system attributes of a client that is disconnecting. They are held in RAM, and written
+ * to flash, by a fiber started from idleTick(), once no client has connected for MICROBIT_BLE_SYSATTR_WRITE_DELAY milliseconds,
+ * and only if they have changed.
+ *
+ * @param handle The connection handle of the client.
+ *
+ * @note for internal use only.
  * */
 void MicroBitBLEManager::deferredSysAttrWrite(Gap::Handle_t handle)
 {
-    pairingHandle = handle;
+    if (storage == NULL || deviceID >= MICROBIT_BLE_MAXIMUM_BONDS)
+        return;
+
+    BLESysAttribute attrib;
+    uint16_t len = sizeof(attrib.sys_attr);
+
+    memset(&attrib, 0, sizeof(attrib));
+
+    // The SoftDevice only holds the attributes of a connection until it is reused, so take them now.
+    if (sd_ble_gatts_sys_attr_get(handle, attrib.sys_attr, &len, BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS) != NRF_SUCCESS)
+        return;
+
+    loadSystemAttributes();
+
+    if ((sysAttrsValid & (1 << deviceID)) && memcmp(sysAttrs.sys_attrs[deviceID].sys_attr, attrib.sys_attr, sizeof(attrib.sys_attr)) == 0)
+        return;
+
+    sysAttrs.sys_attrs[deviceID] = attrib;
+    sysAttrsValid |= 1 << deviceID;
+    sysAttrsChangedAt = system_timer_current_time();
+
     this->status |= MICROBIT_BLE_STATUS_STORE_SYSATTR;
+    addToIdle();
+}
+
+/**
+ * Restores the system attributes last recorded for a bonded client.
+ *
+ * @param handle The connection handle of the client.
+ *
+ * @param device The device manager ID of the client.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_NO_DATA if nothing is recorded for the client,
+ *         or MICROBIT_NOT_SUPPORTED if the SoftDevice rejected them.
+ *
+ * @note for internal use only.
+ */
+int MicroBitBLEManager::restoreSystemAttributes(Gap::Handle_t handle, uint8_t device)
+{
+    if (storage == NULL || device >= MICROBIT_BLE_MAXIMUM_BONDS)
+        return MICROBIT_NO_DATA;
+
+    loadSystemAttributes();
+
+    if (!(sysAttrsValid & (1 << device)))
+        return MICROBIT_NO_DATA;
+
+    if (sd_ble_gatts_sys_attr_set(handle, sysAttrs.sys_attrs[device].sys_attr, sizeof(sysAttrs.sys_attrs[device].sys_attr), BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS) != NRF_SUCCESS)
+        return MICROBIT_NOT_SUPPORTED;
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Reads the system attributes of every bonded client from storage, unless this has already been done.
+ */
+void MicroBitBLEManager::loadSystemAttributes()
+{
+    if (this->status & MICROBIT_BLE_STATUS_SYSATTR_LOADED)
+        return;
+
+    this->status |= MICROBIT_BLE_STATUS_SYSATTR_LOADED;
+
+    if (storage->get("bleSysAttrs", (uint8_t *)&sysAttrs, sizeof(sysAttrs)) == MICROBIT_OK)
+    {
+        sysAttrsValid = (1 << MICROBIT_BLE_MAXIMUM_BONDS) - 1;
+    }
+    else
+    {
+        memset(&sysAttrs, 0, sizeof(sysAttrs));
+        sysAttrsValid = 0;
+    }
+}
+
+/**
+ * Writes the system attributes of every bonded client to storage, if they differ from those already stored.
+ * FLASH writes may block, so this is called from a fiber of its own rather than from idleTick().
+ *
+ * @note for internal use only.
+ */
+void MicroBitBLEManager::storeSystemAttributes()
+{
+    BLESysAttributeStore stored;
+
+    // A client may have put things back the way they were, so compare with what we have before erasing anything.
+    if (storage->get("bleSysAttrs", (uint8_t *)&stored, sizeof(stored)) != MICROBIT_OK || memcmp(&stored, &sysAttrs, sizeof(stored)) != 0)
+    {
+        // If FLASH is busy, try again later.
+        if (storage->put("bleSysAttrs", (uint8_t *)&sysAttrs, sizeof(sysAttrs)) == MICROBIT_BUSY)
+        {
+            sysAttrsChangedAt = system_timer_current_time();
+            this->status |= MICROBIT_BLE_STATUS_STORE_SYSATTR;
+        }
+    }
+
+    this->status &= ~MICROBIT_BLE_STATUS_STORING_SYSATTR;
+}
+
+/**
+ * Adds this component to the idle thread, unless this has already been done.
+ */
+void MicroBitBLEManager::addToIdle()
+{
+    if (this->status & MICROBIT_BLE_STATUS_ADDED_TO_IDLE)
+        return;
+
+    this->status |= MICROBIT_BLE_STATUS_ADDED_TO_IDLE;
+    fiber_add_idle_component(this);
 }
 
 /**
@@ -298,6 +404,10 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
 {
     ManagedString BLEName("BBC micro:bit");
     this->deviceName = deviceName;
+    this->serialNumber = serialNumber;
+    this->messageBus = &messageBus;
+
+    uint32_t stageStart = (uint32_t) system_timer_current_time_us();
 
 #if !(CONFIG_ENABLED(MICROBIT_BLE_WHITELIST))
     ManagedString namePrefix(" [");
@@ -320,6 +430,10 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
     // generate an event when a Bluetooth connection is established
     ble->gap().onConnection(bleConnectionCallback);
 
+    // track which characteristics clients are listening to, to select the connection profile.
+    ble->gattServer().onUpdatesEnabled(bleUpdatesEnabledCallback);
+    ble->gattServer().onUpdatesDisabled(bleUpdatesDisabledCallback);
+
     // Configure the stack to hold onto the CPU during critical timing events.
     // mbed-classic performs __disable_irq() calls in its timers that can cause
     // MIC failures on secure BLE channels...
@@ -332,6 +446,9 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
     ble->gap().setAddress(BLEProtocol::AddressType::RANDOM_PRIVATE_RESOLVABLE, {0});
 #endif
 
+    bootProfile.stack = (uint32_t) system_timer_current_time_us() - stageStart;
+    stageStart += bootProfile.stack;
+
     // Setup our security requirements.
     ble->securityManager().onPasskeyDisplay(passkeyDisplayCallback);
     ble->securityManager().onSecuritySetupCompleted(securitySetupCompletedCallback);
@@ -380,34 +497,16 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
     // Configure the radio at our default power level
     setTransmitPower(MICROBIT_BLE_DEFAULT_TX_POWER);
 
-// Bring up core BLE services.
-#if CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE)
-    new MicroBitDFUService(*ble);
-#endif
+    bootProfile.security = (uint32_t) system_timer_current_time_us() - stageStart;
 
-#if CONFIG_ENABLED(MICROBIT_BLE_PARTIAL_FLASHING)
-    new MicroBitPartialFlashingService(*ble, messageBus);
-#endif
-
-#if CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE)
-    DeviceInformationService ble_device_information_service(*ble, MICROBIT_BLE_MANUFACTURER, MICROBIT_BLE_MODEL, serialNumber.toCharArray(), MICROBIT_BLE_HARDWARE_VERSION, MICROBIT_BLE_FIRMWARE_VERSION, MICROBIT_BLE_SOFTWARE_VERSION);
-#else
-    (void)serialNumber;
-#endif
-
-#if CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE)
-    new MicroBitEventService(*ble, messageBus);
-#else
-    (void)messageBus;
+#if !CONFIG_ENABLED(MICROBIT_BLE_DEFERRED_SERVICES)
+    startServices();
 #endif
 
     // Configure for high speed mode where possible.
-    Gap::ConnectionParams_t fast;
-    ble->getPreferredConnectionParams(&fast);
-    fast.minConnectionInterval = 8;  // 10 ms
-    fast.maxConnectionInterval = 16; // 20 ms
-    fast.slaveLatency = 0;
-    ble->setPreferredConnectionParams(&fast);
+    applyConnectionProfile();
+
+    stageStart = (uint32_t) system_timer_current_time_us();
 
 // Setup advertising.
 #if CONFIG_ENABLED(MICROBIT_BLE_WHITELIST)
@@ -426,12 +525,75 @@ void MicroBitBLEManager::init(ManagedString deviceName, ManagedString serialNumb
 // If we have whitelisting enabled, then prevent only enable advertising of we have any binded devices...
 // This is to further protect kids' privacy. If no-one initiates BLE, then the device is unreachable.
 // If whiltelisting is disabled, then we always advertise.
+    bootProfile.advertising = (uint32_t) system_timer_current_time_us() - stageStart;
+
+#if !CONFIG_ENABLED(MICROBIT_BLE_DEFERRED_ADVERTISING)
 #if CONFIG_ENABLED(MICROBIT_BLE_WHITELIST)
     if (whitelist.size > 0)
 #endif
+    {
+        startServices();
+
+        stageStart = (uint32_t) system_timer_current_time_us();
         ble->startAdvertising();
+        bootProfile.advertising += (uint32_t) system_timer_current_time_us() - stageStart;
+    }
+#endif
 }
 
+/**
+  * Registers the core BLE services enabled in MicroBitConfig.h, if this has not already been done.
+  *
+  * This is part of init(), unless MICROBIT_BLE_DEFERRED_SERVICES is set, in which case it is called when
+  * the micro:bit first advertises or enters pairing mode. Call it directly to register the services earlier.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack has not been initialised.
+  */
+int MicroBitBLEManager::startServices()
+{
+    if (ble == NULL)
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (status & MICROBIT_BLE_STATUS_SERVICES)
+        return MICROBIT_OK;
+
+    status |= MICROBIT_BLE_STATUS_SERVICES;
+
+    uint32_t stageStart = (uint32_t) system_timer_current_time_us();
+
+// Bring up core BLE services.
+#if CONFIG_ENABLED(MICROBIT_BLE_DFU_SERVICE)
+    new MicroBitDFUService(*ble);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_PARTIAL_FLASHING)
+    new MicroBitPartialFlashingService(*ble, *messageBus);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_DEVICE_INFORMATION_SERVICE)
+    DeviceInformationService ble_device_information_service(*ble, MICROBIT_BLE_MANUFACTURER, MICROBIT_BLE_MODEL, serialNumber.toCharArray(), MICROBIT_BLE_HARDWARE_VERSION, MICROBIT_BLE_FIRMWARE_VERSION, MICROBIT_BLE_SOFTWARE_VERSION);
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_BLE_EVENT_SERVICE)
+    new MicroBitEventService(*ble, *messageBus);
+#endif
+
+    bootProfile.services = (uint32_t) system_timer_current_time_us() - stageStart;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines how long each stage of bringing up the BLE stack took.
+  *
+  * @return the time taken by each stage, in microseconds.
+  */
+MicroBitBLEBootProfile MicroBitBLEManager::getBootProfile()
+{
+    return bootProfile;
+}
+
+
 /**
  * Change the output power level of the transmitter to the given value.
  *
@@ -455,6 +617,149 @@ int MicroBitBLEManager::setTransmitPower(int power)
     return MICROBIT_OK;
 }
 
+/**
+ * Selects the connection parameters to ask for. If a client is connected, the new parameters are
+ * negotiated immediately.
+ *
+ * While a client has enabled updates on a characteristic registered with addHighRateCharacteristic(),
+ * MICROBIT_BLE_PROFILE_LOW_LATENCY is used, whatever profile is selected here.
+ *
+ * @param profile MICROBIT_BLE_PROFILE_LOW_LATENCY for a 7.5 - 15 ms connection interval,
+ *                MICROBIT_BLE_PROFILE_BALANCED for 10 - 20 ms (the default), or
+ *                MICROBIT_BLE_PROFILE_LOW_POWER for 100 - 200 ms, with some connection events skipped when idle.
+ *
+ * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the profile is not valid.
+ *
+ * @code
+ * // allow the longest intervals, as we only send the occasional event.
+ * bleManager.setConnectionProfile(MICROBIT_BLE_PROFILE_LOW_POWER);
+ * @endcode
+ */
+int MicroBitBLEManager::setConnectionProfile(MicroBitBLEConnectionProfile profile)
+{
+    if (profile < MICROBIT_BLE_PROFILE_LOW_LATENCY || profile > MICROBIT_BLE_PROFILE_LOW_POWER)
+        return MICROBIT_INVALID_PARAMETER;
+
+    connectionProfile = profile;
+    applyConnectionProfile();
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Determines the connection profile currently asked for.
+ *
+ * @return the profile in use, which is MICROBIT_BLE_PROFILE_LOW_LATENCY while any high rate characteristic is active.
+ */
+MicroBitBLEConnectionProfile MicroBitBLEManager::getConnectionProfile()
+{
+    return activeProfile;
+}
+
+/**
+ * Registers a characteristic that sends data quickly enough to benefit from a short connection interval.
+ * Whenever a client enables notifications or indications on it, MICROBIT_BLE_PROFILE_LOW_LATENCY is
+ * negotiated, until they are disabled again, or the client disconnects.
+ *
+ * @param handle the value handle of the characteristic.
+ *
+ * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if MICROBIT_BLE_HIGH_RATE_CHARACTERISTICS are already registered.
+ */
+int MicroBitBLEManager::addHighRateCharacteristic(GattAttribute::Handle_t handle)
+{
+    if (highRateCount >= MICROBIT_BLE_HIGH_RATE_CHARACTERISTICS)
+        return MICROBIT_NO_RESOURCES;
+
+    highRateHandles[highRateCount++] = handle;
+
+    return MICROBIT_OK;
+}
+
+/**
+ * A client has enabled or disabled updates on a characteristic.
+ *
+ * @param handle the value handle of the characteristic.
+ *
+ * @param enabled true if updates were enabled, false if they were disabled.
+ */
+void MicroBitBLEManager::updatesEnabled(GattAttribute::Handle_t handle, bool enabled)
+{
+    for (int i = 0; i < highRateCount; i++)
+    {
+        if (highRateHandles[i] == handle)
+        {
+            if (enabled)
+                highRateEnabled |= (1 << i);
+            else
+                highRateEnabled &= ~(1 << i);
+
+            applyConnectionProfile();
+            return;
+        }
+    }
+}
+
+/**
+ * A client has connected. Unless the balanced profile is in use, the parameters of the current
+ * profile are negotiated, as the client will have chosen its own.
+ */
+void MicroBitBLEManager::connectionOpened()
+{
+    applyConnectionProfile(activeProfile != MICROBIT_BLE_PROFILE_BALANCED);
+}
+
+/**
+ * A client has disconnected, so no characteristic has updates enabled.
+ */
+void MicroBitBLEManager::connectionClosed()
+{
+    highRateEnabled = 0;
+    applyConnectionProfile();
+}
+
+/**
+ * Asks for the connection parameters of the current profile, and negotiates them if a client is connected.
+ *
+ * @param renegotiate true to negotiate the parameters even if the profile has not changed.
+ */
+void MicroBitBLEManager::applyConnectionProfile(bool renegotiate)
+{
+    if (ble == NULL)
+        return;
+
+    MicroBitBLEConnectionProfile profile = highRateEnabled ? MICROBIT_BLE_PROFILE_LOW_LATENCY : connectionProfile;
+
+    Gap::ConnectionParams_t params;
+    ble->getPreferredConnectionParams(&params);
+
+    if (profile == MICROBIT_BLE_PROFILE_LOW_LATENCY)
+    {
+        params.minConnectionInterval = MICROBIT_BLE_LOW_LATENCY_MIN_INTERVAL;
+        params.maxConnectionInterval = MICROBIT_BLE_LOW_LATENCY_MAX_INTERVAL;
+        params.slaveLatency = 0;
+    }
+    else if (profile == MICROBIT_BLE_PROFILE_LOW_POWER)
+    {
+        params.minConnectionInterval = MICROBIT_BLE_LOW_POWER_MIN_INTERVAL;
+        params.maxConnectionInterval = MICROBIT_BLE_LOW_POWER_MAX_INTERVAL;
+        params.slaveLatency = MICROBIT_BLE_LOW_POWER_SLAVE_LATENCY;
+    }
+    else
+    {
+        params.minConnectionInterval = MICROBIT_BLE_BALANCED_MIN_INTERVAL;
+        params.maxConnectionInterval = MICROBIT_BLE_BALANCED_MAX_INTERVAL;
+        params.slaveLatency = 0;
+    }
+
+    ble->setPreferredConnectionParams(&params);
+
+    // Only renegotiate an open connection when the profile actually changes.
+    if (ble->getGapState().connected && (renegotiate || profile != activeProfile))
+        ble->gap().updateConnectionParams(connectionHandle, &params);
+
+    activeProfile = profile;
+}
+
 /**
  * Determines the number of devices currently bonded with this micro:bit.
  * @return The number of active bonds.
@@ -505,7 +810,8 @@ void MicroBitBLEManager::pairingComplete(bool success)
 
 /**
  * Periodic callback in thread context.
- * We use this here purely to safely issue a disconnect operation after a pairing operation is complete.
+ * We use this here to safely issue a disconnect operation after a pairing operation is complete,
+ * and to write the system attributes of clients to flash.
  */
 void MicroBitBLEManager::idleTick()
 {
@@ -518,10 +824,21 @@ void MicroBitBLEManager::idleTick()
         }
     }
 
+    // Wait until clients have stopped coming and going, so that their changes are written together,
+    // and the flash operations do not compete with a connection for radio time.
     if (this->status & MICROBIT_BLE_STATUS_STORE_SYSATTR)
     {
-        storeSystemAttributes(pairingHandle);
-        this->status &= ~MICROBIT_BLE_STATUS_STORE_SYSATTR;
+        // The write may block, which the idle thread must never do, so hand it to a fiber of its own.
+        if (ble && !ble->getGapState().connected && (system_timer_current_time() - sysAttrsChangedAt) >= MICROBIT_BLE_SYSATTR_WRITE_DELAY
+            && !(this->status & MICROBIT_BLE_STATUS_STORING_SYSATTR))
+        {
+            this->status &= ~MICROBIT_BLE_STATUS_STORE_SYSATTR;
+            this->status |= MICROBIT_BLE_STATUS_STORING_SYSATTR;
+
+            // If there's no memory for the fiber, try again on the next tick.
+            if (create_fiber(storeSystemAttributesFiber, this) == NULL)
+                this->status = (this->status & ~MICROBIT_BLE_STATUS_STORING_SYSATTR) | MICROBIT_BLE_STATUS_STORE_SYSATTR;
+        }
     }
 }
 
@@ -555,6 +872,9 @@ int MicroBitBLEManager::advertiseEddystoneUrl(const char* url, int8_t calibrated
     ble->clearAdvertisingPayload();
 
     ble->setAdvertisingType(connectable ? GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED : GapAdvertisingParams::ADV_NON_CONNECTABLE_UNDIRECTED);
+
+    if (connectable)
+        startServices();
     ble->setAdvertisingInterval(interval);
 
     ble->accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
@@ -612,6 +932,9 @@ int MicroBitBLEManager::advertiseEddystoneUid(const char* uid_namespace, const c
     ble->clearAdvertisingPayload();
 
     ble->setAdvertisingType(connectable ? GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED : GapAdvertisingParams::ADV_NON_CONNECTABLE_UNDIRECTED);
+
+    if (connectable)
+        startServices();
     ble->setAdvertisingInterval(interval);
 
     ble->accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
@@ -654,6 +977,9 @@ void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &a
 
     currentMode = MICROBIT_MODE_PAIRING;
 
+    // Pairing mode exists to let a client program the micro:bit, so it needs the core services.
+    startServices();
+
     ble->gap().stopAdvertising();
 
 // Clear the whitelist (if we have one), so that we're discoverable by all BLE devices.
@@ -681,7 +1007,7 @@ void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &a
     // Stop any running animations on the display
     display.stopAnimation();
 
-    fiber_add_idle_component(this);
+    addToIdle();
 
     showManagementModeAnimation(display);
 
@@ -693,7 +1019,7 @@ void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &a
         if (pairingStatus & MICROBIT_BLE_PAIR_REQUEST)
         {
             timeInPairingMode = 0;
-            MicroBitImage arrow("0,0,255,0,0\n0,255,0,0,0\n255,255,255,255,255\n0,255,0,0,0\n0,0,255,0,0\n");
+            MICROBIT_IMAGE_LITERAL(arrow, "0,0,255,0,0\n0,255,0,0,0\n255,255,255,255,255\n0,255,0,0,0\n0,0,255,0,0\n");
             display.print(arrow, 0, 0, 0);
 
             if (fadeDirection == 0)
@@ -739,7 +1065,7 @@ void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &a
         {
             if (pairingStatus & MICROBIT_BLE_PAIR_SUCCESSFUL)
             {
-                MicroBitImage tick("0,0,0,0,0\n0,0,0,0,255\n0,0,0,255,0\n255,0,255,0,0\n0,255,0,0,0\n");
+                MICROBIT_IMAGE_LITERAL(tick, "0,0,0,0,0\n0,0,0,0,255\n0,0,0,255,0\n255,0,255,0,0\n0,255,0,0,0\n");
                 display.print(tick, 0, 0, 0);
                 fiber_sleep(15000);
                 timeInPairingMode = MICROBIT_BLE_PAIRING_TIMEOUT * 30;
@@ -760,7 +1086,7 @@ void MicroBitBLEManager::pairingMode(MicroBitDisplay &display, MicroBitButton &a
             }
             else
             {
-                MicroBitImage cross("255,0,0,0,255\n0,255,0,255,0\n0,0,255,0,0\n0,255,0,255,0\n255,0,0,0,255\n");
+                MICROBIT_IMAGE_LITERAL(cross, "255,0,0,0,255\n0,255,0,255,0\n0,0,255,0,0\n0,255,0,255,0\n255,0,0,0,255\n");
                 display.print(cross, 0, 0, 0);
             }
         }
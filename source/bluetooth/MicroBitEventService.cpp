@@ -43,7 +43,7 @@ DEALINGS IN THE SOFTWARE.
 MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_messageBus) :
         ble(_ble),messageBus(_messageBus)
 {
-    GattCharacteristic  microBitEventCharacteristic(MicroBitEventServiceMicroBitEventCharacteristicUUID, (uint8_t *)&microBitEventBuffer, 0, sizeof(EventServiceEvent),
+    GattCharacteristic  microBitEventCharacteristic(MicroBitEventServiceMicroBitEventCharacteristicUUID, (uint8_t *)microBitEventBuffer, 0, sizeof(microBitEventBuffer),
     GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
     GattCharacteristic  clientEventCharacteristic(MicroBitEventServiceClientEventCharacteristicUUID, (uint8_t *)&clientEventBuffer, 0, sizeof(EventServiceEvent),
@@ -58,9 +58,12 @@ MicroBitEventService::MicroBitEventService(BLEDevice &_ble, EventModel &_message
     clientEventBuffer.type = 0x00;
     clientEventBuffer.reason = 0x00;
 
-    microBitEventBuffer = microBitRequirementsBuffer = clientRequirementsBuffer = clientEventBuffer;
+    microBitEventBuffer[0] = microBitRequirementsBuffer = clientRequirementsBuffer = clientEventBuffer;
 
     messageBusListenerOffset = 0;
+    subscriptionCount = 0;
+    queueHead = 0;
+    queueLength = 0;
 
     // Set default security requirements
     microBitEventCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
@@ -104,14 +107,29 @@ void MicroBitEventService::onDataWritten(const GattWriteCallbackParams *params)
     }
 
     if (params->handle == clientRequirementsCharacteristicHandle) {
-        // Read and register for all the events given...
+        // Record all the events given. A single listener sees every event on the bus, and forwards those in the table,
+        // so an event matching several subscriptions is only sent once.
         while (len >= 4)
         {
-            messageBus.listen(e->type, e->reason, this, &MicroBitEventService::onMicroBitEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+            uint32_t key = ((uint32_t)e->type << 16) | e->reason;
+            int i = findSubscription(key);
+
+            if ((i == subscriptionCount || subscriptions[i] != key) && subscriptionCount < MICROBIT_BLE_EVENT_SERVICE_SUBSCRIPTIONS)
+            {
+                __disable_irq();
+                memmove(&subscriptions[i + 1], &subscriptions[i], (subscriptionCount - i) * sizeof(uint32_t));
+                subscriptions[i] = key;
+                subscriptionCount++;
+                __enable_irq();
+            }
 
             len-=4;
             e++;
         }
+
+        if (subscriptionCount > 0)
+            messageBus.listen(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, this, &MicroBitEventService::onMicroBitEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
         return;
     }
 }
@@ -121,26 +139,128 @@ void MicroBitEventService::onDataWritten(const GattWriteCallbackParams *params)
   */
 void MicroBitEventService::onMicroBitEvent(MicroBitEvent evt)
 {
-    EventServiceEvent *e = &microBitEventBuffer;
+    if (!ble.getGapState().connected || !isSubscribed(evt.source, evt.value))
+        return;
+
+    // Queue the event to be sent when we're next idle, unless it is already waiting.
+    __disable_irq();
 
-    if (ble.getGapState().connected) {
+    bool queued = false;
+
+    for (int i = 0; i < queueLength && !queued; i++)
+    {
+        EventServiceEvent *e = &queue[(queueHead + i) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
+        queued = e->type == evt.source && e->reason == evt.value;
+    }
+
+    if (!queued && queueLength < MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE)
+    {
+        EventServiceEvent *e = &queue[(queueHead + queueLength) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
         e->type = evt.source;
         e->reason = evt.value;
-
-        ble.gattServer().notify(microBitEventCharacteristicHandle, (const uint8_t *)e, sizeof(EventServiceEvent));
+        queueLength++;
     }
+
+    __enable_irq();
 }
 
 /**
   * Periodic callback from MicroBit scheduler.
+  * Sends any events waiting for the client, several to each notification.
   * If we're no longer connected, remove any registered Message Bus listeners.
   */
 void MicroBitEventService::idleTick()
 {
-    if (!ble.getGapState().connected && messageBusListenerOffset >0) {
-        messageBusListenerOffset = 0;
-        messageBus.ignore(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, this, &MicroBitEventService::onMicroBitEvent);
+    if (!ble.getGapState().connected)
+    {
+        if (messageBusListenerOffset > 0 || subscriptionCount > 0)
+        {
+            messageBusListenerOffset = 0;
+            messageBus.ignore(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, this, &MicroBitEventService::onMicroBitEvent);
+            clearSubscriptions();
+        }
+
+        return;
+    }
+
+    while (queueLength > 0)
+    {
+        int count = min(queueLength, MICROBIT_BLE_EVENT_SERVICE_PACKED_EVENTS);
+
+        for (int i = 0; i < count; i++)
+            microBitEventBuffer[i] = queue[(queueHead + i) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE];
+
+        // If the stack is out of buffers, leave the events queued until the next connection event has made room.
+        if (ble.gattServer().notify(microBitEventCharacteristicHandle, (const uint8_t *)microBitEventBuffer, count * sizeof(EventServiceEvent)) != BLE_ERROR_NONE)
+            return;
+
+        __disable_irq();
+        queueHead = (queueHead + count) % MICROBIT_BLE_EVENT_SERVICE_QUEUE_SIZE;
+        queueLength -= count;
+        __enable_irq();
+    }
+}
+
+/**
+  * Finds a subscription in the table.
+  *
+  * @param key the subscription, as (id << 16) | value.
+  *
+  * @return the index of the subscription if it is present, otherwise the index at which it would be inserted.
+  */
+int MicroBitEventService::findSubscription(uint32_t key)
+{
+    int low = 0;
+    int high = subscriptionCount;
+
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+
+        if (subscriptions[mid] < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+  * Determines if the client has subscribed to an event, either exactly or through MICROBIT_ID_ANY or MICROBIT_EVT_ANY.
+  *
+  * @param id the source of the event.
+  *
+  * @param value the value of the event.
+  *
+  * @return true if the event should be sent to the client.
+  */
+bool MicroBitEventService::isSubscribed(uint16_t id, uint16_t value)
+{
+    uint32_t keys[] = { ((uint32_t)id << 16) | value, ((uint32_t)id << 16) | MICROBIT_EVT_ANY,
+                        ((uint32_t)MICROBIT_ID_ANY << 16) | value, ((uint32_t)MICROBIT_ID_ANY << 16) | MICROBIT_EVT_ANY };
+
+    for (int k = 0; k < 4; k++)
+    {
+        int i = findSubscription(keys[k]);
+
+        if (i < subscriptionCount && subscriptions[i] == keys[k])
+            return true;
     }
+
+    return false;
+}
+
+/**
+  * Removes every subscription and any events waiting to be sent.
+  */
+void MicroBitEventService::clearSubscriptions()
+{
+    __disable_irq();
+    subscriptionCount = 0;
+    queueHead = 0;
+    queueLength = 0;
+    __enable_irq();
 }
 
 /**
@@ -32,6 +32,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitIOPinService.h"
 #include "MicroBitFiber.h"
+#include "EventModel.h"
 
 /**
   * Constructor.
@@ -61,6 +62,9 @@ MicroBitIOPinService::MicroBitIOPinService(BLEDevice &_ble, MicroBitIO &_io) :
     ioPinServiceIOCharacteristicBuffer = 0;
     memset(ioPinServiceIOData, 0, sizeof(ioPinServiceIOData));
     memset(ioPinServicePWMCharacteristicBuffer, 0, sizeof(ioPinServicePWMCharacteristicBuffer));
+    edgeInputs = 0;
+    sampledInputs = 0;
+    changedInputs = 0;
 
     // Set default security requirements
     ioPinServiceADCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
@@ -82,7 +86,9 @@ MicroBitIOPinService::MicroBitIOPinService(BLEDevice &_ble, MicroBitIO &_io) :
     ble.gattServer().write(ioPinServicePWMCharacteristicHandle, (const uint8_t *)&ioPinServicePWMCharacteristicBuffer, sizeof(ioPinServicePWMCharacteristicBuffer));
 
     ble.onDataWritten(this, &MicroBitIOPinService::onDataWritten);
-    fiber_add_idle_component(this);
+
+    // We only have work to do when an input changes, or is due to be sampled.
+    fiber_add_idle_component(this, MICROBIT_IDLE_COMPONENT_ON_DEMAND);
 }
 
 /**
@@ -126,29 +132,36 @@ void MicroBitIOPinService::updateBLEInputs(bool updateAll)
 {
     int pairs = 0;
 
-    for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
+    if (updateAll)
     {
-        if (isActiveInput(i))
-        {
-            uint8_t value;
-
-            if (isDigital(i))
-               	value = io.pin[i].getDigitalValue();
-            else
-               	value = io.pin[i].getAnalogValue() >> 2;
+        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT && pairs < MICROBIT_IO_PIN_SERVICE_DATA_SIZE; i++)
+            if (isActiveInput(i))
+                addInput(i, pairs, true);
+    }
+    else
+    {
+        // Only look at the inputs that have raised an event, or are due to be sampled.
+        __disable_irq();
+        uint32_t changed = changedInputs;
+        changedInputs = 0;
+        __enable_irq();
 
-            // If the data has changed, send an update.
-            if (updateAll || value != ioPinServiceIOData[i])
+        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
+        {
+            if (changed & (1 << i))
             {
-                ioPinServiceIOData[i] = value;
-
-                ioPinServiceDataCharacteristicBuffer[pairs].pin = i;
-                ioPinServiceDataCharacteristicBuffer[pairs].value = value;
-
-                pairs++;
-
+                // Any inputs that don't fit into this notification are left for the next one.
                 if (pairs >= MICROBIT_IO_PIN_SERVICE_DATA_SIZE)
+                {
+                    __disable_irq();
+                    changedInputs |= changed & ~((1 << i) - 1);
+                    __enable_irq();
+
+                    fiber_idle_component_pending(this);
                     break;
+                }
+
+                addInput(i, pairs, false);
             }
         }
     }
@@ -158,6 +171,136 @@ void MicroBitIOPinService::updateBLEInputs(bool updateAll)
         ble.gattServer().notify(ioPinServiceDataCharacteristic->getValueHandle(), (uint8_t *)ioPinServiceDataCharacteristicBuffer, pairs * sizeof(IOData));
 }
 
+/**
+ * Adds a pin value to the data characteristic buffer, if it differs enough from the value last sent.
+ *
+ * @param i the enumeration of the pin.
+ * @param pairs the number of pairs already in the buffer, which is updated.
+ * @param force if true, the value is added even if it hasn't changed.
+ */
+void MicroBitIOPinService::addInput(int i, int &pairs, bool force)
+{
+    uint8_t value;
+    int threshold;
+
+    if (isDigital(i))
+    {
+        value = io.pin[i].getDigitalValue();
+        threshold = 1;
+    }
+    else
+    {
+        value = io.pin[i].getAnalogValue() >> 2;
+        threshold = MICROBIT_IO_PIN_SERVICE_ANALOG_THRESHOLD;
+    }
+
+    int delta = (int)value - (int)ioPinServiceIOData[i];
+
+    // Always report an analog input reaching either end of its range, which the threshold could otherwise hide.
+    if (force || delta >= threshold || delta <= -threshold || (delta != 0 && (value == 0 || value == 255)))
+    {
+        ioPinServiceIOData[i] = value;
+
+        ioPinServiceDataCharacteristicBuffer[pairs].pin = i;
+        ioPinServiceDataCharacteristicBuffer[pairs].value = value;
+
+        pairs++;
+    }
+}
+
+/**
+  * Callback. Invoked when a digital input that our BLE client is watching changes.
+  */
+void MicroBitIOPinService::onPinEvent(MicroBitEvent e)
+{
+    // The pins of MicroBitIO have consecutive IDs, in the same order as the pins of this service.
+    int i = e.source - MICROBIT_ID_IO_P0;
+
+    if (i >= 0 && i < MICROBIT_IO_PIN_SERVICE_PINCOUNT && (edgeInputs & (1 << i)))
+    {
+        changedInputs |= 1 << i;
+        fiber_idle_component_pending(this);
+    }
+}
+
+/**
+  * Callback. Invoked every MICROBIT_IO_PIN_SERVICE_ANALOG_PERIOD milliseconds while any inputs need to be sampled.
+  */
+void MicroBitIOPinService::onSampleTimer()
+{
+    if (sampledInputs == 0)
+        return;
+
+    system_timer_event_after_us(&sampleEvent, MICROBIT_IO_PIN_SERVICE_ANALOG_PERIOD * 1000, system_timer_method_callback<MicroBitIOPinService, &MicroBitIOPinService::onSampleTimer>, this);
+
+    changedInputs |= sampledInputs;
+    fiber_idle_component_pending(this);
+}
+
+/**
+  * Watches the inputs selected by the AD and IO configuration characteristics. Digital inputs raise events when
+  * they change, and others are sampled periodically.
+  */
+void MicroBitIOPinService::configureInputs()
+{
+    uint32_t edges = 0;
+    uint32_t sampled = 0;
+
+    for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
+    {
+        uint32_t bit = 1 << i;
+
+        if (isDigital(i) && isActiveInput(i))
+        {
+            // A pin that can't raise events is sampled instead.
+            if ((edgeInputs & bit) || io.pin[i].eventOn(MICROBIT_PIN_EVENT_ON_EDGE) == MICROBIT_OK)
+            {
+                if (!(edgeInputs & bit) && EventModel::defaultEventBus)
+                    EventModel::defaultEventBus->listen(MICROBIT_ID_IO_P0 + i, MICROBIT_EVT_ANY, this, &MicroBitIOPinService::onPinEvent, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+                edges |= bit;
+            }
+            else
+            {
+                sampled |= bit;
+            }
+
+            io.pin[i].getDigitalValue();
+        }
+        else if (edgeInputs & bit)
+        {
+            if (EventModel::defaultEventBus)
+                EventModel::defaultEventBus->ignore(MICROBIT_ID_IO_P0 + i, MICROBIT_EVT_ANY, this, &MicroBitIOPinService::onPinEvent);
+
+            io.pin[i].eventOn(MICROBIT_PIN_EVENT_NONE);
+        }
+
+        if (isAnalog(i) && isActiveInput(i))
+        {
+            io.pin[i].getAnalogValue();
+            sampled |= bit;
+        }
+    }
+
+    bool sampling = sampledInputs != 0;
+
+    __disable_irq();
+    edgeInputs = edges;
+    sampledInputs = sampled;
+
+    // Check every new input straight away.
+    changedInputs = edges | sampled;
+    __enable_irq();
+
+    if (sampled != 0 && !sampling)
+        system_timer_event_after_us(&sampleEvent, MICROBIT_IO_PIN_SERVICE_ANALOG_PERIOD * 1000, system_timer_method_callback<MicroBitIOPinService, &MicroBitIOPinService::onSampleTimer>, this);
+
+    if (sampled == 0)
+        system_timer_cancel_event(&sampleEvent);
+
+    fiber_idle_component_pending(this);
+}
+
 /**
   * Callback. Invoked when any of our attributes are written via BLE.
   */
@@ -173,14 +316,7 @@ void MicroBitIOPinService::onDataWritten(const GattWriteCallbackParams *params)
         ble.gattServer().write(ioPinServiceIOCharacteristicHandle, (const uint8_t *)&ioPinServiceIOCharacteristicBuffer, sizeof(ioPinServiceIOCharacteristicBuffer));
 
         // Also, drop any selected pins into input mode, so we can pick up changes later
-        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
-        {
-            if(isDigital(i) && isActiveInput(i))
-                io.pin[i].getDigitalValue();
-
-            if(isAnalog(i) && isActiveInput(i))
-                io.pin[i].getAnalogValue();
-        }
+        configureInputs();
     }
 
     // Check for writes to the IO configuration characteristic
@@ -193,14 +329,7 @@ void MicroBitIOPinService::onDataWritten(const GattWriteCallbackParams *params)
         ble.gattServer().write(ioPinServiceADCharacteristicHandle, (const uint8_t *)&ioPinServiceADCharacteristicBuffer, sizeof(ioPinServiceADCharacteristicBuffer));
 
         // Also, drop any selected pins into input mode, so we can pick up changes later
-        for (int i=0; i < MICROBIT_IO_PIN_SERVICE_PINCOUNT; i++)
-        {
-            if(isDigital(i) && isActiveInput(i))
-               io.pin[i].getDigitalValue();
-
-            if(isAnalog(i) && isActiveInput(i))
-               io.pin[i].getAnalogValue();
-        }
+        configureInputs();
     }
 
     // Check for writes to the PWM Control characteristic
@@ -266,15 +395,16 @@ void MicroBitIOPinService::onDataRead(GattReadAuthCallbackParams *params)
 
 
 /**
- * Periodic callback from MicroBit scheduler.
+ * Callback from MicroBit scheduler, when the processor is idle after an input has changed or is due to be sampled.
  *
- * Check if any of the pins we're watching need updating. Notify any connected
- * device with any changes.
+ * Check if any of those pins need updating. Notify any connected device with any changes.
  */
 void MicroBitIOPinService::idleTick()
 {
     if (ble.getGapState().connected)
         updateBLEInputs();
+    else
+        changedInputs = 0;
 }
 
 const uint8_t  MicroBitIOPinServiceUUID[] = {
@@ -50,6 +50,17 @@ MicroBitLEDService::MicroBitLEDService(BLEDevice &_ble, MicroBitDisplay &_displa
     GattCharacteristic  scrollingSpeedCharacteristic(MicroBitLEDServiceScrollingSpeedUUID, (uint8_t *)&scrollingSpeedCharacteristicBuffer, 0,
     sizeof(scrollingSpeedCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    GattCharacteristic  framesCharacteristic(MicroBitLEDServiceFramesUUID, (uint8_t *)framesCharacteristicBuffer, 0, sizeof(framesCharacteristicBuffer),
+    GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
+
+    framesCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    frameHead = 0;
+    frameLength = 0;
+    framePlaying = false;
+#endif
+
     // Initialise our characteristic values.
     memclr(matrixCharacteristicBuffer, sizeof(matrixCharacteristicBuffer));
     textCharacteristicBuffer[0] = 0;
@@ -62,7 +73,11 @@ MicroBitLEDService::MicroBitLEDService(BLEDevice &_ble, MicroBitDisplay &_displa
     textCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     scrollingSpeedCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    GattCharacteristic *characteristics[] = {&matrixCharacteristic, &textCharacteristic, &scrollingSpeedCharacteristic, &framesCharacteristic};
+#else
     GattCharacteristic *characteristics[] = {&matrixCharacteristic, &textCharacteristic, &scrollingSpeedCharacteristic};
+#endif
     GattService         service(MicroBitLEDServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -71,6 +86,10 @@ MicroBitLEDService::MicroBitLEDService(BLEDevice &_ble, MicroBitDisplay &_displa
     textCharacteristicHandle = textCharacteristic.getValueHandle();
     scrollingSpeedCharacteristicHandle = scrollingSpeedCharacteristic.getValueHandle();
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    framesCharacteristicHandle = framesCharacteristic.getValueHandle();
+#endif
+
     ble.gattServer().write(scrollingSpeedCharacteristicHandle, (const uint8_t *)&scrollingSpeedCharacteristicBuffer, sizeof(scrollingSpeedCharacteristicBuffer));
     ble.gattServer().write(matrixCharacteristicHandle, (const uint8_t *)&matrixCharacteristicBuffer, sizeof(matrixCharacteristicBuffer));
 
@@ -85,6 +104,18 @@ void MicroBitLEDService::onDataWritten(const GattWriteCallbackParams *params)
 {
     uint8_t *data = (uint8_t *)params->data;
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+    if (params->handle == framesCharacteristicHandle)
+    {
+        queueFrames(data, params->len);
+        return;
+    }
+
+    // Anything else written to the display replaces the frames.
+    if (params->handle == matrixCharacteristicHandle || params->handle == textCharacteristicHandle)
+        stopFrames();
+#endif
+
     if (params->handle == matrixCharacteristicHandle && params->len > 0 && params->len < 6)
     {
        // interrupt any animation that might be currently going on
@@ -137,6 +168,98 @@ void MicroBitLEDService::onDataRead(GattReadAuthCallbackParams *params)
     }
 }
 
+#if CONFIG_ENABLED(MICROBIT_BLE_LED_STREAMING)
+/**
+  * Adds the frames written to the frames characteristic to the queue, and starts showing them if the
+  * queue was empty.
+  */
+void MicroBitLEDService::queueFrames(const uint8_t *data, int len)
+{
+    bool start = false;
+
+    // Frames are drawn off screen and swapped in whole, so that none is seen half drawn.
+    if (!display.isDoubleBuffered() && display.setDoubleBuffering(true) != MICROBIT_OK)
+        return;
+
+    for (int i = 0; i + MICROBIT_BLE_LED_FRAME_SIZE <= len; i += MICROBIT_BLE_LED_FRAME_SIZE)
+    {
+        uint32_t frame = data[i] | (data[i+1] << 8) | (data[i+2] << 16) | ((uint32_t)data[i+3] << 24);
+
+        __disable_irq();
+
+        if (frameLength < MICROBIT_BLE_LED_FRAME_QUEUE_SIZE)
+        {
+            frameQueue[(frameHead + frameLength) % MICROBIT_BLE_LED_FRAME_QUEUE_SIZE] = frame;
+            frameLength++;
+        }
+
+        if (!framePlaying)
+        {
+            framePlaying = true;
+            start = true;
+        }
+
+        __enable_irq();
+    }
+
+    if (start)
+    {
+        // interrupt any animation that might be currently going on
+        display.stopAnimation();
+        onFrameTimer();
+    }
+}
+
+/**
+  * Shows the next queued frame, and schedules the one after it. Invoked by the system timer.
+  */
+void MicroBitLEDService::onFrameTimer()
+{
+    uint32_t frame;
+
+    __disable_irq();
+
+    // Leave the last frame on the display, and show the next one written as soon as it arrives.
+    if (frameLength == 0)
+    {
+        framePlaying = false;
+        __enable_irq();
+        return;
+    }
+
+    frame = frameQueue[frameHead];
+    frameHead = (frameHead + 1) % MICROBIT_BLE_LED_FRAME_QUEUE_SIZE;
+    frameLength--;
+
+    __enable_irq();
+
+    for (int y=0; y<5; y++)
+        for (int x=0; x<5; x++)
+            display.image.setPixelValue(x, y, (frame & (0x01 << (y*5 + x))) ? 255 : 0);
+
+    display.swapAsync();
+
+    uint32_t time = frame >> MICROBIT_BLE_LED_FRAME_TIME_POS;
+
+    if (time == 0)
+        time = 1;
+
+    system_timer_event_after_us(&frameEvent, time * MICROBIT_BLE_LED_FRAME_TICK * 1000, system_timer_method_callback<MicroBitLEDService, &MicroBitLEDService::onFrameTimer>, this);
+}
+
+/**
+  * Discards any queued frames, so that the display can be used for something else.
+  */
+void MicroBitLEDService::stopFrames()
+{
+    system_timer_cancel_event(&frameEvent);
+
+    __disable_irq();
+    frameLength = 0;
+    framePlaying = false;
+    __enable_irq();
+}
+#endif
 
 const uint8_t  MicroBitLEDServiceUUID[] = {
     0xe9,0x5d,0xd9,0x1d,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
@@ -153,3 +276,7 @@ const uint8_t  MicroBitLEDServiceTextUUID[] = {
 const uint8_t  MicroBitLEDServiceScrollingSpeedUUID[] = {
     0xe9,0x5d,0x0d,0x2d,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
 };
+
+const uint8_t  MicroBitLEDServiceFramesUUID[] = {
+    0xe9,0x5d,0xf5,0x3e,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
@@ -56,6 +56,20 @@ MicroBitMagnetometerService::MicroBitMagnetometerService(BLEDevice &_ble, MicroB
     sizeof(magnetometerCalibrationCharacteristicBuffer),
     GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattCharacteristic  magnetometerBatchCharacteristic(MicroBitMagnetometerServiceBatchUUID, (uint8_t *)magnetometerBatchCharacteristicBuffer, 0,
+    sizeof(magnetometerBatchCharacteristicBuffer), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    memset(magnetometerBatchCharacteristicBuffer, 0, sizeof(magnetometerBatchCharacteristicBuffer));
+    batchPending = false;
+
+    magnetometerBatchCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
+
+    // Batches are drawn from the compass's stream, so enable it unless the application already has.
+    if (compass.getStream().getCapacity() == 0)
+        compass.setStreamSize(MICROBIT_BLE_SENSOR_BATCH_STREAM_SIZE);
+#endif
+
     // Initialise our characteristic values.
     magnetometerDataCharacteristicBuffer[0] = 0;
     magnetometerDataCharacteristicBuffer[1] = 0;
@@ -70,7 +84,11 @@ MicroBitMagnetometerService::MicroBitMagnetometerService(BLEDevice &_ble, MicroB
     magnetometerPeriodCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
     magnetometerCalibrationCharacteristic.requireSecurity(SecurityManager::MICROBIT_BLE_SECURITY_LEVEL);
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    GattCharacteristic *characteristics[] = {&magnetometerDataCharacteristic, &magnetometerBearingCharacteristic, &magnetometerPeriodCharacteristic, &magnetometerCalibrationCharacteristic, &magnetometerBatchCharacteristic};
+#else
     GattCharacteristic *characteristics[] = {&magnetometerDataCharacteristic, &magnetometerBearingCharacteristic, &magnetometerPeriodCharacteristic, &magnetometerCalibrationCharacteristic};
+#endif
     GattService         service(MicroBitMagnetometerServiceUUID, characteristics, sizeof(characteristics) / sizeof(GattCharacteristic *));
 
     ble.addService(service);
@@ -79,6 +97,9 @@ MicroBitMagnetometerService::MicroBitMagnetometerService(BLEDevice &_ble, MicroB
     magnetometerBearingCharacteristicHandle = magnetometerBearingCharacteristic.getValueHandle();
     magnetometerPeriodCharacteristicHandle = magnetometerPeriodCharacteristic.getValueHandle();
     magnetometerCalibrationCharacteristicHandle = magnetometerCalibrationCharacteristic.getValueHandle();
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+    magnetometerBatchCharacteristicHandle = magnetometerBatchCharacteristic.getValueHandle();
+#endif
 
     ble.gattServer().notify(magnetometerDataCharacteristicHandle,(uint8_t *)magnetometerDataCharacteristicBuffer, sizeof(magnetometerDataCharacteristicBuffer));
     ble.gattServer().notify(magnetometerBearingCharacteristicHandle,(uint8_t *)&magnetometerBearingCharacteristicBuffer, sizeof(magnetometerBearingCharacteristicBuffer));
@@ -161,9 +182,52 @@ void MicroBitMagnetometerService::magnetometerUpdate()
             magnetometerBearingCharacteristicBuffer = (uint16_t) compass.heading();
             ble.gattServer().notify(magnetometerBearingCharacteristicHandle,(uint8_t *)&magnetometerBearingCharacteristicBuffer, sizeof(magnetometerBearingCharacteristicBuffer));
         }
+
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+        sendBatches();
+#endif
     }
 }
 
+#if CONFIG_ENABLED(MICROBIT_BLE_SENSOR_BATCHING)
+/**
+ * Sends as many batches of samples from the compass's stream as the Bluetooth stack will take.
+ */
+void MicroBitMagnetometerService::sendBatches()
+{
+    TimedSample3D samples[MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES];
+
+    while (true)
+    {
+        if (!batchPending)
+        {
+            if (compass.getStream().available() < MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES)
+                return;
+
+            compass.readStream(samples, MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES);
+
+            // Later samples follow at the compass's period, so only the first is timestamped.
+            magnetometerBatchCharacteristicBuffer[0] = (int16_t)(samples[0].timestamp / 1000);
+
+            for (int i = 0; i < MICROBIT_MAGNETOMETER_SERVICE_BATCH_SAMPLES; i++)
+            {
+                magnetometerBatchCharacteristicBuffer[1 + 3 * i] = samples[i].sample.x;
+                magnetometerBatchCharacteristicBuffer[2 + 3 * i] = samples[i].sample.y;
+                magnetometerBatchCharacteristicBuffer[3 + 3 * i] = samples[i].sample.z;
+            }
+
+            batchPending = true;
+        }
+
+        // If the stack is out of buffers, keep the batch for the next update.
+        if (ble.gattServer().notify(magnetometerBatchCharacteristicHandle, (uint8_t *)magnetometerBatchCharacteristicBuffer, sizeof(magnetometerBatchCharacteristicBuffer)) != BLE_ERROR_NONE)
+            return;
+
+        batchPending = false;
+    }
+}
+#endif
+
 /**
  * Sample Period Change Needed callback.
  * Reconfiguring the magnetometer can to a REALLY long time (sometimes even seconds to complete)
@@ -202,3 +266,7 @@ const uint8_t  MicroBitMagnetometerServiceBearingUUID[] = {
 const uint8_t  MicroBitMagnetometerServiceCalibrationUUID[] = {
     0xE9,0x5D,0xB3,0x58,0x25,0x1D,0x47,0x0A,0xA0,0x62,0xFA,0x19,0x22,0xDF,0xA9,0xA8
 };
+
+const uint8_t  MicroBitMagnetometerServiceBatchUUID[] = {
+    0xe9,0x5d,0xba,0x7d,0x25,0x1d,0x47,0x0a,0xa0,0x62,0xfa,0x19,0x22,0xdf,0xa9,0xa8
+};
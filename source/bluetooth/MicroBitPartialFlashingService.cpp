@@ -109,10 +109,42 @@ void MicroBitPartialFlashingService::onDataWritten(const GattWriteCallbackParams
           packetCount = 0;
           blockPacketCount = 0;
           blockNum = 0;
-          offset = 0;
 
           break;
         }
+        case PAGE_HASHES:
+        {
+          /*
+           * Return the hashes of up to PAGE_HASHES_PER_PACKET pages, starting at the
+           * page aligned address in data[1..4]. The client compares these against its own
+           * image and only sends FLASH_DATA for the pages that differ.
+           */
+          if (params->len < 5)
+            break;
+
+          MicroBitMemoryMap memoryMap;
+
+          uint32_t address = (data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
+          uint32_t hashes[PAGE_HASHES_PER_PACKET];
+          int count = memoryMap.getPageHashes(address, hashes, PAGE_HASHES_PER_PACKET);
+
+          // Response:
+          // PAGE_HASHES, number of hashes (0 if the address is invalid), then each hash MSB first
+          uint8_t buffer[2 + 4 * PAGE_HASHES_PER_PACKET];
+          buffer[0] = PAGE_HASHES;
+          buffer[1] = count < 0 ? 0 : count;
+
+          for (int i = 0; i < buffer[1]; i++)
+          {
+            buffer[2 + 4*i] = (hashes[i] & 0xFF000000) >> 24;
+            buffer[3 + 4*i] = (hashes[i] & 0x00FF0000) >> 16;
+            buffer[4 + 4*i] = (hashes[i] & 0x0000FF00) >>  8;
+            buffer[5 + 4*i] = (hashes[i] & 0x000000FF);
+          }
+
+          ble.gattServer().notify(partialFlashCharacteristicHandle, (const uint8_t *)buffer, 2 + 4 * buffer[1]);
+          break;
+        }
         case FLASH_DATA:
         {
           // Process FLASH data packet
@@ -132,9 +164,17 @@ void MicroBitPartialFlashingService::onDataWritten(const GattWriteCallbackParams
         case MICROBIT_STATUS:
         {
           /*
-           * Return the version of the Partial Flashing Service and the current BLE mode (application / pairing)
+           * Return the version of the Partial Flashing Service, the current BLE mode (application / pairing)
+           * and the number of unacknowledged FLASH_DATA blocks the client may send.
+           *
+           * data[1], if present, is the number of blocks the client would like in flight. Clients that
+           * don't ask are acknowledged one block at a time, as before.
            */
-          uint8_t flashNotificationBuffer[] = {MICROBIT_STATUS, PARTIAL_FLASHING_VERSION, MicroBitBLEManager::manager->getCurrentMode()};
+          window = 1;
+          if (params->len > 1 && data[1] > 1)
+            window = min(data[1], MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS - 1);
+
+          uint8_t flashNotificationBuffer[] = {MICROBIT_STATUS, PARTIAL_FLASHING_VERSION, MicroBitBLEManager::manager->getCurrentMode(), window};
           ble.gattServer().notify(partialFlashCharacteristicHandle, (const uint8_t *)flashNotificationBuffer, sizeof(flashNotificationBuffer));
           break;
         }
@@ -187,12 +227,15 @@ void MicroBitPartialFlashingService::flashData(uint8_t *data)
           */
         if (packetNum != packetCount)
         {
-          if ( packetNum < packetCount ? packetCount - packetNum < 8 : packetNum - packetCount > 248 )
+          // Packets already in flight when an error was reported may still arrive. Skip their numbers.
+          uint8_t inFlight = 4 * (window + 1);
+
+          if ( packetNum < packetCount ? packetCount - packetNum < inFlight : packetNum - packetCount > 256 - inFlight )
             return; // packet is from a previous batch
 
           uint8_t flashNotificationBuffer[] = {FLASH_DATA, 0xAA};
           ble.gattServer().notify(partialFlashCharacteristicHandle, (const uint8_t *)flashNotificationBuffer, sizeof(flashNotificationBuffer));
-          blockPacketCount += 4;
+          blockPacketCount += 4 * window;
           packetCount = blockPacketCount;
           blockNum = 0;
           return;
@@ -201,21 +244,21 @@ void MicroBitPartialFlashingService::flashData(uint8_t *data)
         packetCount++;
 
         // Add to block
-        memcpy(block + (4*blockNum), data + 4, 16);
+        memcpy(block[receiveBlock] + (4*blockNum), data + 4, 16);
 
         // Actions
         switch(blockNum) {
             // blockNum is 0: set up offset
             case 0:
                 {
-                    offset = ((data[1] << 8) | data[2] << 0);
+                    blockOffset[receiveBlock] = ((data[1] << 8) | data[2] << 0);
                     blockNum++;
                     break;
                 }
             // blockNum is 1: complete the offset
             case 1:
                 {
-                    offset |= ((data[1] << 24) | data[2] << 16);
+                    blockOffset[receiveBlock] |= ((data[1] << 24) | data[2] << 16);
                     blockNum++;
                     break;
                 }
@@ -224,8 +267,9 @@ void MicroBitPartialFlashingService::flashData(uint8_t *data)
                 {
                     // Fire write event
                     MicroBitEvent evt(MICROBIT_ID_PARTIAL_FLASHING, FLASH_DATA );
-                    // Reset blockNum
+                    // Reset blockNum and move on to the next buffer
                     blockNum = 0;
+                    receiveBlock = (receiveBlock + 1) % MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS;
                     blockPacketCount += 4;
                     break;
                 }
@@ -262,18 +306,23 @@ void MicroBitPartialFlashingService::partialFlashingEvent(MicroBitEvent e)
        }
        delete flashIncomplete;
 
-      uint32_t *flashPointer   = (uint32_t *)(offset);
+      uint32_t *flashPointer   = (uint32_t *)(blockOffset[writeBlock]);
+      int operations = 1;
 
       // If the pointer is on a page boundary erase the page
       if(!((uint32_t)flashPointer % 0x400))
-          flash.erase_page(flashPointer);
+      {
+          flash.erase_page_async(flashPointer);
+          operations++;
+      }
 
-      // Create a pointer to the data block
-      uint32_t *blockPointer;
-      blockPointer = block;
+      // Queue the write, and carry on receiving into the other buffers while it happens
+      flash.flash_burn_async(flashPointer, block[writeBlock], 16);
+      writeBlock = (writeBlock + 1) % MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS;
 
-      // Write to flash
-      flash.flash_burn(flashPointer, blockPointer, 16);
+      // Acknowledging this block lets the client send one into the buffer of the block before it,
+      // so that block must have been written first.
+      flash.flash_wait(operations);
 
       // Update flash control buffer to send next packet
       uint8_t flashNotificationBuffer[] = {FLASH_DATA, 0xFF};
@@ -282,12 +331,17 @@ void MicroBitPartialFlashingService::partialFlashingEvent(MicroBitEvent e)
     }
     case END_OF_TRANSMISSION:
     {
-      // Write final packet
-      uint32_t *blockPointer;
-      uint32_t *flashPointer   = (uint32_t *) offset;
+      // Write final packet, if the last block was incomplete. Unused packets are left blank.
+      int last = blockNum ? receiveBlock : (receiveBlock + MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS - 1) % MICROBIT_BLE_PARTIAL_FLASHING_BUFFERS;
+      uint32_t *flashPointer   = (uint32_t *) blockOffset[last];
+
+      if (blockNum)
+      {
+        memset(block[last] + (4*blockNum), 0xFF, 16 * (4 - blockNum));
+        flash.flash_burn(flashPointer, block[last], 16);
+      }
 
-      blockPointer = block;
-      flash.flash_burn(flashPointer, blockPointer, 16);
+      flash.flash_wait();
 
       // Search for and remove embedded source magic (if it exists!)
       // Move to next page
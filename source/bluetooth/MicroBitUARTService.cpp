@@ -36,9 +36,8 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitFiber.h"
 #include "ErrorNo.h"
 #include "NotifyEvents.h"
-
-static uint8_t txBufferHead = 0;
-static uint8_t txBufferTail = 0;
+#include "MicroBitSystemTimer.h"
+#include "MicroBitBLEManager.h"
 
 static GattCharacteristic* txCharacteristic = NULL;
 
@@ -49,7 +48,6 @@ void on_confirmation(uint16_t handle)
 {
     if(handle == txCharacteristic->getValueAttribute().getHandle())
     {
-        txBufferTail = txBufferHead;
         MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
     }
 }
@@ -62,25 +60,18 @@ void on_confirmation(uint16_t handle)
  *
  * @note defaults to 20
  */
-MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize, uint8_t txBufferSize) : ble(_ble)
+MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize, uint8_t txBufferSize) : rxBuffer(rxBufferSize), txBuffer(txBufferSize), ble(_ble)
 {
-    rxBufferSize += 1;
-    txBufferSize += 1;
-
-    txBuffer = (uint8_t *)malloc(txBufferSize);
-    rxBuffer = (uint8_t *)malloc(rxBufferSize);
-
-    rxBufferHead = 0;
-    rxBufferTail = 0;
-    this->rxBufferSize = rxBufferSize;
+    rxBuffer.allocate();
+    txBuffer.allocate();
 
-    txBufferHead = 0;
-    txBufferTail = 0;
-    this->txBufferSize = txBufferSize;
+    memclr(delimeters, sizeof(delimeters));
+    rxBuffHeadMatch = -1;
+    txThroughput = 0;
 
-    GattCharacteristic rxCharacteristic(UARTServiceRXCharacteristicUUID, rxBuffer, 1, rxBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
+    GattCharacteristic rxCharacteristic(UARTServiceRXCharacteristicUUID, rxBuffer.getBuffer(), 1, rxBuffer.getSize(), GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
 
-    txCharacteristic = new GattCharacteristic(UARTServiceTXCharacteristicUUID, txBuffer, 1, txBufferSize, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE);
+    txCharacteristic = new GattCharacteristic(UARTServiceTXCharacteristicUUID, txBuffer.getBuffer(), 1, MICROBIT_UART_S_MAX_PAYLOAD, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_INDICATE | GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
 
     GattCharacteristic *charTable[] = {txCharacteristic, &rxCharacteristic};
 
@@ -90,76 +81,97 @@ MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize,
 
     this->rxCharacteristicHandle = rxCharacteristic.getValueAttribute().getHandle();
 
+    // Bulk transfers benefit from the shortest connection interval.
+    if(MicroBitBLEManager::manager)
+        MicroBitBLEManager::manager->addHighRateCharacteristic(txCharacteristic->getValueAttribute().getHandle());
+
     _ble.gattServer().onDataWritten(this, &MicroBitUARTService::onDataWritten);
     _ble.gattServer().onConfirmationReceived(on_confirmation);
+    _ble.gattServer().onDataSent(this, &MicroBitUARTService::onDataSent);
+
+    if(EventModel::defaultEventBus)
+        EventModel::defaultEventBus->listen(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY, this, &MicroBitUARTService::onTxEmpty);
 }
 
 /**
-  * A callback function for whenever a Bluetooth device writes to our RX characteristic.
+  * A callback function for whenever the Bluetooth stack has sent queued notifications.
   */
-void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
-    if (params->handle == this->rxCharacteristicHandle)
+void MicroBitUARTService::onDataSent(unsigned)
+{
+    MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
+}
+
+/**
+  * A listener for MICROBIT_UART_S_EVT_TX_EMPTY, that hands any data left in the txBuffer to the Bluetooth stack.
+  */
+void MicroBitUARTService::onTxEmpty(MicroBitEvent)
+{
+    if(ble.getGapState().connected)
+        sendBuffered();
+}
+
+/**
+  * An internal method that hands data in the txBuffer to the Bluetooth stack, in payloads of up to
+  * MICROBIT_UART_S_MAX_PAYLOAD bytes, until the txBuffer is empty or the stack can accept no more.
+  *
+  * @return true if the txBuffer was emptied, false if the stack can accept no more data.
+  */
+bool MicroBitUARTService::sendBuffered()
+{
+    while(!txBuffer.isEmpty())
     {
-        uint16_t bytesWritten = params->len;
+        uint8_t payload[MICROBIT_UART_S_MAX_PAYLOAD];
 
-        for(int byteIterator = 0; byteIterator <  bytesWritten; byteIterator++)
-        {
-            int newHead = (rxBufferHead + 1) % rxBufferSize;
+        int size = txBuffer.copy(payload, MICROBIT_UART_S_MAX_PAYLOAD);
 
-            if(newHead != rxBufferTail)
-            {
-                char c = params->data[byteIterator];
+        if(ble.gattServer().write(txCharacteristic->getValueAttribute().getHandle(), payload, size) != BLE_ERROR_NONE)
+            return false;
 
-                int delimeterOffset = 0;
-                int delimLength = this->delimeters.length();
+        txBuffer.commitRead(size);
+    }
 
-                //iterate through our delimeters (if any) to see if there is a match
-                while(delimeterOffset < delimLength)
-                {
-                    //fire an event if there is to block any waiting fibers
-                    if(this->delimeters.charAt(delimeterOffset) == c)
-                        MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_DELIM_MATCH);
+    return true;
+}
 
-                    delimeterOffset++;
-                }
+/**
+  * A callback function for whenever a Bluetooth device writes to our RX characteristic.
+  */
+void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
+    if (params->handle == this->rxCharacteristicHandle)
+    {
+        bool delimMatch = false;
+        bool headMatch = false;
+        bool full = false;
 
-                rxBuffer[rxBufferHead] = c;
+        //store the whole write, and raise each event at most once for it.
+        for(int byteIterator = 0; byteIterator < params->len; byteIterator++)
+        {
+            char c = params->data[byteIterator];
 
-                rxBufferHead = newHead;
+            if(rxBuffer.put(c))
+            {
+                //fire an event if there is to block any waiting fibers
+                if(MicroBitRingBuffer::isDelimeter(delimeters, c))
+                    delimMatch = true;
 
-                if(rxBufferHead == rxBuffHeadMatch)
+                if(rxBuffer.getHead() == rxBuffHeadMatch)
                 {
                     rxBuffHeadMatch = -1;
-                    MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_HEAD_MATCH);
+                    headMatch = true;
                 }
             }
             else
-                MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_RX_FULL);
+                full = true;
         }
-    }
-}
 
-/**
-  * An internal method that copies values from a circular buffer to a linear buffer.
-  *
-  * @param circularBuff a pointer to the source circular buffer
-  * @param circularBuffSize the size of the circular buffer
-  * @param linearBuff a pointer to the destination linear buffer
-  * @param tailPosition the tail position in the circular buffer you want to copy from
-  * @param headPosition the head position in the circular buffer you want to copy to
-  *
-  * @note this method assumes that the linear buffer has the appropriate amount of
-  *       memory to contain the copy operation
-  */
-void MicroBitUARTService::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition)
-{
-    int toBuffIndex = 0;
+        if(delimMatch)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_DELIM_MATCH);
 
-    while(tailPosition != headPosition)
-    {
-        linearBuff[toBuffIndex++] = circularBuff[tailPosition];
+        if(headMatch)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_HEAD_MATCH);
 
-        tailPosition = (tailPosition + 1) % circularBuffSize;
+        if(full)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_RX_FULL);
     }
 }
 
@@ -195,11 +207,7 @@ int MicroBitUARTService::getc(MicroBitSerialMode mode)
             eventAfter(1, mode);
     }
 
-    char c = rxBuffer[rxBufferTail];
-
-    rxBufferTail = (rxBufferTail + 1) % rxBufferSize;
-
-    return c;
+    return rxBuffer.get();
 }
 
 /**
@@ -235,7 +243,8 @@ int MicroBitUARTService::putc(char c, MicroBitSerialMode mode)
   * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
   *        gives a different behaviour:
   *
-  *            ASYNC - Will copy as many characters as it can into the buffer for transmission,
+  *            ASYNC - Will hand as many characters as it can to the Bluetooth stack, and copy
+  *                    as many of the rest as it can into the buffer for transmission,
   *                    and return control to the user.
   *
   *            SYNC_SPINWAIT - will return MICROBIT_INVALID_PARAMETER
@@ -246,6 +255,10 @@ int MicroBitUARTService::putc(char c, MicroBitSerialMode mode)
   *
   * @return the number of characters written, or MICROBIT_NOT_SUPPORTED if there is
   *         no connected device, or the connected device has not enabled indications.
+  *
+  * @note data is sent in payloads of up to MICROBIT_UART_S_MAX_PAYLOAD bytes. If the connected
+  *       device enables notifications rather than indications, several payloads are sent in
+  *       each connection interval.
   */
 int MicroBitUARTService::send(const uint8_t *buf, int length, MicroBitSerialMode mode)
 {
@@ -260,41 +273,45 @@ int MicroBitUARTService::send(const uint8_t *buf, int length, MicroBitSerialMode
         return MICROBIT_NOT_SUPPORTED;
 
     int bytesWritten = 0;
+    uint64_t start = system_timer_current_time_us();
 
-    while(bytesWritten < length && ble.getGapState().connected && updatesEnabled)
+    while(ble.getGapState().connected && updatesEnabled)
     {
-        for(int bufferIterator = bytesWritten; bufferIterator < length; bufferIterator++)
-        {
-            int nextHead = (txBufferHead + 1) % txBufferSize;
+        if(mode == SYNC_SLEEP)
+            fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
 
-            if(nextHead != txBufferTail)
-            {
-                txBuffer[txBufferHead] = buf[bufferIterator];
+        //anything left from an earlier ASYNC send goes first, then our data is handed straight to the stack,
+        //so as many notifications are queued as it has buffers for, whatever the size of the txBuffer.
+        bool accepted = sendBuffered();
 
-                txBufferHead = nextHead;
+        while(accepted && bytesWritten < length)
+        {
+            int size = min(length - bytesWritten, MICROBIT_UART_S_MAX_PAYLOAD);
 
-                bytesWritten++;
-            }
+            if(ble.gattServer().write(txCharacteristic->getValueAttribute().getHandle(), buf + bytesWritten, size) != BLE_ERROR_NONE)
+                accepted = false;
+            else
+                bytesWritten += size;
         }
 
-        int size = txBufferedSize();
-
-        uint8_t temp[size];
-
-        memclr(&temp, size);
-
-        circularCopy(txBuffer, txBufferSize, temp, txBufferTail, txBufferHead);
+        //whatever the stack can't take yet waits in the txBuffer, until the stack has sent something.
+        if(mode == ASYNC)
+        {
+            bytesWritten += txBuffer.write(buf + bytesWritten, length - bytesWritten);
+            break;
+        }
 
+        schedule();
 
-        if(mode == SYNC_SLEEP)
-            fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_UART_S_EVT_TX_EMPTY);
+        if(bytesWritten >= length && txBuffer.isEmpty())
+        {
+            uint64_t elapsed = system_timer_current_time_us() - start;
 
-        ble.gattServer().write(txCharacteristic->getValueAttribute().getHandle(), temp, size);
+            if(elapsed > 0)
+                txThroughput = (int)((uint64_t)bytesWritten * 1000000 / elapsed);
 
-        if(mode == SYNC_SLEEP)
-            schedule();
-        else
             break;
+        }
 
         ble.gattServer().areUpdatesEnabled(*txCharacteristic, &updatesEnabled);
     }
@@ -433,23 +450,11 @@ ManagedString MicroBitUARTService::readUntil(ManagedString delimeters, MicroBitS
     if(mode == SYNC_SPINWAIT)
         return MICROBIT_INVALID_PARAMETER;
 
-    int localTail = rxBufferTail;
-    int preservedTail = rxBufferTail;
-
-    int foundIndex = -1;
-
-    //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBufferHead && foundIndex  == -1)
-    {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuffer[localTail];
-
-        for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-            if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
+    uint32_t map[8];
+    MicroBitRingBuffer::delimeterMap(delimeters, map);
 
-        localTail = (localTail + 1) % rxBufferSize;
-    }
+    //ASYNC mode just searches our stored characters for any matches.
+    int foundIndex = rxBuffer.find(map);
 
     //if our mode is SYNC_SLEEP, we set up an event to be fired when we see a
     //matching character.
@@ -457,24 +462,23 @@ ManagedString MicroBitUARTService::readUntil(ManagedString delimeters, MicroBitS
     {
         eventOn(delimeters, mode);
 
-        foundIndex = rxBufferHead - 1;
+        foundIndex = rxBuffer.find(map);
 
-        this->delimeters = ManagedString();
+        memclr(this->delimeters, sizeof(this->delimeters));
     }
 
     if(foundIndex >= 0)
     {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBufferSize - preservedTail) + foundIndex : foundIndex - preservedTail;
+        int localBuffSize = foundIndex;
 
         uint8_t localBuff[localBuffSize + 1];
 
         memclr(&localBuff, localBuffSize + 1);
 
-        circularCopy(rxBuffer, rxBufferSize, localBuff, preservedTail, foundIndex);
+        rxBuffer.read(localBuff, localBuffSize);
 
         //plus one for the character we listened for...
-        rxBufferTail = (rxBufferTail + localBuffSize + 1) % rxBufferSize;
+        rxBuffer.commitRead(1);
 
         return ManagedString((char *)localBuff, localBuffSize);
     }
@@ -506,7 +510,7 @@ int MicroBitUARTService::eventOn(ManagedString delimeters, MicroBitSerialMode mo
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->delimeters = delimeters;
+    MicroBitRingBuffer::delimeterMap(delimeters, this->delimeters);
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -537,7 +541,7 @@ int MicroBitUARTService::eventAfter(int len, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->rxBuffHeadMatch = (rxBufferHead + len) % rxBufferSize;
+    this->rxBuffHeadMatch = rxBuffer.wrap(rxBuffer.getHead() + len);
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -556,7 +560,7 @@ int MicroBitUARTService::eventAfter(int len, MicroBitSerialMode mode)
   */
 int MicroBitUARTService::isReadable()
 {
-    return (rxBufferTail != rxBufferHead) ? 1 : 0;
+    return rxBuffer.isEmpty() ? 0 : 1;
 }
 
 /**
@@ -564,10 +568,7 @@ int MicroBitUARTService::isReadable()
   */
 int MicroBitUARTService::rxBufferedSize()
 {
-    if(rxBufferTail > rxBufferHead)
-        return (rxBufferSize - rxBufferTail) + rxBufferHead;
-
-    return rxBufferHead - rxBufferTail;
+    return rxBuffer.length();
 }
 
 /**
@@ -575,8 +576,16 @@ int MicroBitUARTService::rxBufferedSize()
   */
 int MicroBitUARTService::txBufferedSize()
 {
-    if(txBufferTail > txBufferHead)
-        return (txBufferSize - txBufferTail) + txBufferHead;
+    return txBuffer.length();
+}
 
-    return txBufferHead - txBufferTail;
+/**
+  * Determines the rate the most recent SYNC_SLEEP send() achieved, from the first byte being handed
+  * to the Bluetooth stack, to the last being sent.
+  *
+  * @return the rate in bytes per second, or zero if no blocking send has completed.
+  */
+int MicroBitUARTService::getTxThroughput()
+{
+    return txThroughput;
 }
@@ -0,0 +1,1508 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A small set of micro-benchmarks for the micro:bit runtime.
+  *
+  * These allow the cost of core runtime operations to be measured on real hardware, so that
+  * the effect of changes to the scheduler and message bus can be quantified. Each benchmark repeats
+  * an operation a given number of times, and reports the average cost of each iteration.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitBenchmark.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitFiber.h"
+#include "ManagedString.h"
+#include "MicroBitImage.h"
+#include "MicroBitOrientation.h"
+#include "MicroBitFlash.h"
+#include "ErrorNo.h"
+
+#if CONFIG_ENABLED(MICROBIT_BENCHMARK)
+static volatile uint32_t benchmark_counter = 0;
+
+// State shared with the partner fibers and listeners used by the scheduler benchmarks.
+static volatile int benchmark_running = 0;
+static volatile uint64_t benchmark_raised_at = 0;
+static uint64_t benchmark_latency = 0;
+static FiberSemaphore *benchmark_complete = NULL;
+
+/**
+  * Trivial event handlers, used as the target of dispatch benchmarks.
+  * Separate handlers are used for each dispatch path, so that their listeners remain distinct.
+  */
+static void benchmark_fob_handler(MicroBitEvent)
+{
+    benchmark_counter++;
+}
+
+static void benchmark_direct_handler(MicroBitEvent)
+{
+    benchmark_counter++;
+}
+
+/**
+  * A trivial function, used as the target of the invoke() benchmark.
+  */
+static void benchmark_invoke_handler()
+{
+    benchmark_counter++;
+}
+
+/**
+  * Listener used by the send benchmark. Wakes the benchmarking fiber once the event has been delivered.
+  */
+static void benchmark_send_handler(MicroBitEvent)
+{
+    benchmark_complete->notify();
+}
+
+/**
+  * Partner fiber used by the context switch benchmark. Simply yields until the benchmark completes.
+  */
+static void benchmark_yield_fiber()
+{
+    while (benchmark_running)
+        schedule();
+}
+
+/**
+  * Partner fiber used by the wakeup benchmark. Repeatedly waits for the benchmark event, and records
+  * how long it took to be woken, until the benchmark completes.
+  */
+static void benchmark_wait_fiber()
+{
+    while (1)
+    {
+        fiber_wait_for_event(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_WAKE);
+
+        if (!benchmark_running)
+            break;
+
+        benchmark_latency += system_timer_current_time_us() - benchmark_raised_at;
+        benchmark_complete->notify();
+    }
+}
+
+/**
+  * Fills in a benchmark result from the given measurements.
+  *
+  * @param result The result to populate.
+  *
+  * @param iterations The number of times the operation was performed.
+  *
+  * @param start The time at which the benchmark started (microseconds).
+  *
+  * @param end The time at which the benchmark finished (microseconds).
+  */
+static void benchmark_record(MicroBitBenchmarkResult &result, int iterations, uint64_t start, uint64_t end)
+{
+    result.iterations = iterations;
+    result.time_us = (uint32_t) (end - start);
+    result.cycles = (uint32_t) (((uint64_t) result.time_us * (SystemCoreClock / 1000000)) / iterations);
+}
+
+/**
+  * Delivers the given number of benchmark events through the given message bus to the given handler.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param handler The handler to register.
+  *
+  * @param flags The listener flags to register the handler with.
+  *
+  * @param iterations The number of events to deliver.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the listener could not be registered.
+  */
+static int benchmark_dispatch(MicroBitMessageBus &bus, void (*handler)(MicroBitEvent), uint16_t flags, int iterations, MicroBitBenchmarkResult &result)
+{
+    MicroBitEvent evt(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_DISPATCH, CREATE_ONLY);
+    uint64_t start, end;
+
+    if (bus.listen(MICROBIT_ID_BENCHMARK, MICROBIT_EVT_ANY, handler, flags) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    start = system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        bus.process(evt);
+
+    end = system_timer_current_time_us();
+
+    bus.ignore(MICROBIT_ID_BENCHMARK, MICROBIT_EVT_ANY, handler);
+    benchmark_record(result, iterations, start, end);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of delivering an event through MicroBitMessageBus::process() to a single listener,
+  * using both the default (fork on block) dispatch path and the MESSAGE_BUS_LISTENER_NONBLOCKING fast path.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param iterations The number of events to deliver on each path.
+  *
+  * @param fob Populated with the results for listeners dispatched through invoke().
+  *
+  * @param direct Populated with the results for listeners dispatched directly.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive, or
+  *         MICROBIT_NO_RESOURCES if the benchmark listeners could not be registered.
+  */
+int benchmark_event_dispatch(MicroBitMessageBus &bus, int iterations, MicroBitBenchmarkResult &fob, MicroBitBenchmarkResult &direct)
+{
+    int result;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    result = benchmark_dispatch(bus, benchmark_fob_handler, MESSAGE_BUS_LISTENER_REENTRANT, iterations, fob);
+
+    if (result != MICROBIT_OK)
+        return result;
+
+    return benchmark_dispatch(bus, benchmark_direct_handler, MESSAGE_BUS_LISTENER_REENTRANT | MESSAGE_BUS_LISTENER_NONBLOCKING, iterations, direct);
+}
+
+/**
+  * Measures the cost of a context switch between two fibers of the same priority.
+  *
+  * A partner fiber is created, and control is passed back and forth between it and the calling fiber
+  * using schedule(). Results are reported per context switch.
+  *
+  * @param iterations The number of round trips to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the partner fiber could not be created.
+  *
+  * @note Any other runnable fibers of the same priority will also be scheduled, and inflate the results.
+  */
+int benchmark_context_switch(int iterations, MicroBitBenchmarkResult &result)
+{
+    uint64_t start, end;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    benchmark_running = 1;
+
+    if (create_fiber(benchmark_yield_fiber, release_fiber, fiber_get_priority()) == NULL)
+    {
+        benchmark_running = 0;
+        return MICROBIT_NO_RESOURCES;
+    }
+
+    // Let the partner fiber start, so that its stack is populated before we begin timing.
+    schedule();
+
+    start = system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        schedule();
+
+    end = system_timer_current_time_us();
+
+    // Allow the partner fiber to complete.
+    benchmark_running = 0;
+    schedule();
+
+    // Each round trip is two context switches.
+    benchmark_record(result, iterations * 2, start, end);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of invoke() for a function that completes without blocking.
+  *
+  * @param iterations The number of times to call invoke().
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_invoke(int iterations, MicroBitBenchmarkResult &result)
+{
+    uint64_t start, end;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    start = system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+        invoke(benchmark_invoke_handler);
+
+    end = system_timer_current_time_us();
+
+    benchmark_record(result, iterations, start, end);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the latency of MicroBitMessageBus::send(), from the event being sent until it is delivered to a
+  * listener through the event queue, and the calling fiber is woken up by that listener.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param iterations The number of events to send.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the benchmark listener could not be registered.
+  */
+int benchmark_event_send(MicroBitMessageBus &bus, int iterations, MicroBitBenchmarkResult &result)
+{
+    MicroBitEvent evt(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_SEND, CREATE_ONLY);
+    FiberSemaphore complete;
+    uint64_t start, end;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    if (bus.listen(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_SEND, benchmark_send_handler, MESSAGE_BUS_LISTENER_REENTRANT | MESSAGE_BUS_LISTENER_NONBLOCKING) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    benchmark_complete = &complete;
+
+    start = system_timer_current_time_us();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        bus.send(evt);
+        complete.wait();
+    }
+
+    end = system_timer_current_time_us();
+
+    bus.ignore(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_SEND, benchmark_send_handler);
+    benchmark_complete = NULL;
+
+    benchmark_record(result, iterations, start, end);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the wakeup latency of fiber_wait_for_event(), from an event being raised until
+  * the fiber waiting on it is running again.
+  *
+  * @param iterations The number of events to raise.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         MICROBIT_NOT_SUPPORTED if the scheduler is not running, or MICROBIT_NO_RESOURCES if the waiting fiber could not be created.
+  */
+int benchmark_wait_for_event(int iterations, MicroBitBenchmarkResult &result)
+{
+    FiberSemaphore complete;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (!fiber_scheduler_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    benchmark_complete = &complete;
+    benchmark_latency = 0;
+    benchmark_running = 1;
+
+    if (create_fiber(benchmark_wait_fiber, release_fiber, fiber_get_priority()) == NULL)
+    {
+        benchmark_running = 0;
+        benchmark_complete = NULL;
+        return MICROBIT_NO_RESOURCES;
+    }
+
+    // Let the waiting fiber start, and block on the benchmark event.
+    schedule();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        benchmark_raised_at = system_timer_current_time_us();
+        MicroBitEvent(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_WAKE);
+
+        // The waiting fiber blocks on the event again before it can release us.
+        complete.wait();
+    }
+
+    // Release the waiting fiber, and allow it to complete.
+    benchmark_running = 0;
+    MicroBitEvent(MICROBIT_ID_BENCHMARK, MICROBIT_BENCHMARK_EVT_WAKE);
+    schedule();
+
+    benchmark_complete = NULL;
+
+    benchmark_record(result, iterations, 0, benchmark_latency);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds a single timing to the given distribution.
+  *
+  * @param distribution The distribution to update.
+  *
+  * @param time_us The timing to add (microseconds).
+  */
+static void benchmark_sample(MicroBitBenchmarkDistribution &distribution, uint32_t time_us)
+{
+    int bucket = 0;
+
+    while (bucket < MICROBIT_BENCHMARK_DISTRIBUTION_BUCKETS - 1 && (time_us >> bucket) != 0)
+        bucket++;
+
+    distribution.buckets[bucket]++;
+
+    if (distribution.samples == 0 || time_us < distribution.min_us)
+        distribution.min_us = time_us;
+
+    if (time_us > distribution.max_us)
+        distribution.max_us = time_us;
+
+    distribution.samples++;
+}
+
+/**
+  * Measures the latency of malloc() over a mixed workload of small, medium and large allocations.
+  *
+  * A fixed number of allocations are kept live. On each iteration, one of these chosen at random is freed
+  * and replaced by a new allocation of random size, and the time taken by that allocation is recorded.
+  * The sequence of operations is the same on every run, so results from builds using different heap
+  * configurations (e.g. MICROBIT_HEAP_NEXT_FIT) can be compared directly.
+  *
+  * @param iterations The number of allocations to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @param distribution Populated with the distribution of allocation times.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_heap_churn(int iterations, MicroBitBenchmarkResult &result, MicroBitBenchmarkDistribution &distribution)
+{
+    void *slots[MICROBIT_BENCHMARK_HEAP_SLOTS];
+    uint32_t seed = 0x2545F491;
+    uint32_t total = 0;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(slots, 0, sizeof(slots));
+    memset(&distribution, 0, sizeof(distribution));
+
+    for (int i = 0; i < iterations; i++)
+    {
+        // A simple LCG, so that every run performs the same sequence of operations.
+        seed = seed * 1664525 + 1013904223;
+        uint32_t r = seed >> 8;
+
+        int slot = r % MICROBIT_BENCHMARK_HEAP_SLOTS;
+        int kind = (r >> 5) % 20;
+        int size;
+
+        // Mostly small objects (events, listeners, strings), some buffers, and the occasional large block.
+        if (kind < 14)
+            size = 4 + (r >> 10) % 45;
+        else if (kind < 19)
+            size = 64 + (r >> 10) % 193;
+        else
+            size = 512 + (r >> 10) % 513;
+
+        free(slots[slot]);
+
+        uint64_t start = system_timer_current_time_us();
+        slots[slot] = malloc(size);
+        uint32_t elapsed = (uint32_t) (system_timer_current_time_us() - start);
+
+        if (slots[slot] == NULL)
+        {
+            distribution.failures++;
+            continue;
+        }
+
+        total += elapsed;
+        benchmark_sample(distribution, elapsed);
+    }
+
+    for (int i = 0; i < MICROBIT_BENCHMARK_HEAP_SLOTS; i++)
+        free(slots[i]);
+
+    benchmark_record(result, iterations, 0, total);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of the MicroBitImage blit and shift kernels used when rendering text and animations.
+  *
+  * A 5x5 glyph is repeatedly pasted into a display sized image, both opaquely and with transparency,
+  * and the display sized image is shifted left by one pixel, as when scrolling.
+  *
+  * @param iterations The number of times to perform each operation.
+  *
+  * @param paste Populated with the results of the opaque paste benchmark.
+  *
+  * @param pasteAlpha Populated with the results of the transparent paste benchmark.
+  *
+  * @param shift Populated with the results of the shift benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_image(int iterations, MicroBitBenchmarkResult &paste, MicroBitBenchmarkResult &pasteAlpha, MicroBitBenchmarkResult &shift)
+{
+    uint64_t start;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    MicroBitImage frame(10, 5);
+    MicroBitImage glyph("0,255,255,255,0\n255,0,0,0,255\n255,255,255,255,255\n255,0,0,0,255\n255,0,0,0,255\n");
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        frame.paste(glyph, i % 6, 0, 0);
+    benchmark_record(paste, iterations, start, system_timer_current_time_us());
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        frame.paste(glyph, i % 6, 0, 1);
+    benchmark_record(pasteAlpha, iterations, start, system_timer_current_time_us());
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        frame.shiftLeft(1);
+    benchmark_record(shift, iterations, start, system_timer_current_time_us());
+
+    return MICROBIT_OK;
+}
+
+// Accelerometer (milli-g) and magnetometer (nano-tesla) samples used by the orientation benchmarks.
+static const Sample3D benchmark_accelerometer_samples[] = {
+    Sample3D(0, 0, -1024), Sample3D(512, -256, -860), Sample3D(-700, 420, 600), Sample3D(90, 1010, -35)
+};
+
+static const Sample3D benchmark_magnetometer_samples[] = {
+    Sample3D(21000, -4000, 43000), Sample3D(-15000, 18000, 40000), Sample3D(3000, 25000, -38000), Sample3D(-22000, -9000, 41000)
+};
+
+#define BENCHMARK_ORIENTATION_SAMPLES   4
+
+/**
+  * Measures the cost of the orientation calculations used by the accelerometer and compass, in both
+  * their floating point and fixed point forms, regardless of which MICROBIT_FIXED_POINT_ORIENTATION selects.
+  *
+  * A fixed set of samples is used, so that results from different builds can be compared directly.
+  *
+  * @param iterations The number of times to perform each calculation.
+  *
+  * @param pitchRoll Populated with the results of the floating point pitch and roll benchmark.
+  *
+  * @param pitchRollFixed Populated with the results of the fixed point pitch and roll benchmark.
+  *
+  * @param bearing Populated with the results of the floating point tilt compensated bearing benchmark.
+  *
+  * @param bearingFixed Populated with the results of the fixed point tilt compensated bearing benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_orientation(int iterations, MicroBitBenchmarkResult &pitchRoll, MicroBitBenchmarkResult &pitchRollFixed, MicroBitBenchmarkResult &bearing, MicroBitBenchmarkResult &bearingFixed)
+{
+    uint64_t start;
+    float pitch, roll;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        orientation_pitch_roll(benchmark_accelerometer_samples[i % BENCHMARK_ORIENTATION_SAMPLES], pitch, roll);
+    benchmark_record(pitchRoll, iterations, start, system_timer_current_time_us());
+
+    // Keep the results live, so that the calculations cannot be optimised away.
+    benchmark_counter += (uint32_t) pitch + (uint32_t) roll;
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        orientation_pitch_roll_fixed(benchmark_accelerometer_samples[i % BENCHMARK_ORIENTATION_SAMPLES], pitch, roll);
+    benchmark_record(pitchRollFixed, iterations, start, system_timer_current_time_us());
+
+    benchmark_counter += (uint32_t) pitch + (uint32_t) roll;
+
+    orientation_pitch_roll(benchmark_accelerometer_samples[1], pitch, roll);
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        benchmark_counter += orientation_bearing(benchmark_magnetometer_samples[i % BENCHMARK_ORIENTATION_SAMPLES], pitch, roll);
+    benchmark_record(bearing, iterations, start, system_timer_current_time_us());
+
+    start = system_timer_current_time_us();
+    for (int i = 0; i < iterations; i++)
+        benchmark_counter += orientation_bearing_fixed(benchmark_magnetometer_samples[i % BENCHMARK_ORIENTATION_SAMPLES], pitch, roll);
+    benchmark_record(bearingFixed, iterations, start, system_timer_current_time_us());
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the number of flash pages erased since the device started.
+  */
+static uint32_t benchmark_erase_count()
+{
+    MicroBitFlash flash;
+
+    return flash.get_erase_count();
+}
+
+/**
+  * Adds a single timed storage operation to the given result.
+  *
+  * @param result The result to update.
+  *
+  * @param start The time at which the operation started (microseconds).
+  *
+  * @param bytes The number of bytes read or written by the operation.
+  */
+static void benchmark_storage_sample(MicroBitBenchmarkStorageResult &result, uint64_t start, int bytes)
+{
+    uint32_t elapsed = (uint32_t) (system_timer_current_time_us() - start);
+
+    result.operations++;
+    result.bytes += bytes;
+    result.time_us += elapsed;
+
+    if (elapsed > result.max_us)
+        result.max_us = elapsed;
+}
+
+/**
+  * Derives the averages of a completed storage benchmark run.
+  *
+  * @param result The result to update.
+  *
+  * @param erases The flash page erase count when the run started.
+  */
+static void benchmark_storage_record(MicroBitBenchmarkStorageResult &result, uint32_t erases)
+{
+    result.latency_us = result.operations ? result.time_us / result.operations : 0;
+    result.bytes_per_second = result.time_us ? (uint32_t) (((uint64_t) result.bytes * 1000000) / result.time_us) : 0;
+    result.erases = benchmark_erase_count() - erases;
+}
+
+/**
+  * Measures sequential append throughput, by writing MICROBIT_BENCHMARK_FILE_CHUNK bytes at a time to a new file.
+  *
+  * Any existing MICROBIT_BENCHMARK_FILE_NAME is removed first. The file is left in place for benchmark_fs_random_read().
+  * Appending stops early if the file system fills up.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of chunks to append.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive, or
+  *         the error code from MicroBitFileSystem::open() if the file could not be created.
+  */
+int benchmark_fs_append(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result)
+{
+    uint8_t chunk[MICROBIT_BENCHMARK_FILE_CHUNK];
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&result, 0, sizeof(result));
+
+    fs.remove(MICROBIT_BENCHMARK_FILE_NAME);
+
+    uint32_t erases = benchmark_erase_count();
+    int fd = fs.open(MICROBIT_BENCHMARK_FILE_NAME, MB_WRITE | MB_CREAT);
+
+    if (fd < 0)
+        return fd;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        memset(chunk, i, sizeof(chunk));
+
+        uint64_t start = system_timer_current_time_us();
+
+        if (fs.write(fd, chunk, sizeof(chunk)) != (int) sizeof(chunk))
+        {
+            result.failures++;
+            break;
+        }
+
+        benchmark_storage_sample(result, start, sizeof(chunk));
+    }
+
+    fs.close(fd);
+    benchmark_storage_record(result, erases);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures random read latency, by seeking to pseudo-random positions in the file written by benchmark_fs_append()
+  * and reading MICROBIT_BENCHMARK_FILE_CHUNK bytes from each.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of reads to perform.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         or MICROBIT_NO_DATA if the file does not exist or is shorter than one chunk.
+  */
+int benchmark_fs_random_read(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result)
+{
+    uint8_t chunk[MICROBIT_BENCHMARK_FILE_CHUNK];
+    uint32_t seed = 0x2545F491;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&result, 0, sizeof(result));
+
+    uint32_t erases = benchmark_erase_count();
+    int fd = fs.open(MICROBIT_BENCHMARK_FILE_NAME, MB_READ);
+
+    if (fd < 0)
+        return MICROBIT_NO_DATA;
+
+    int length = fs.seek(fd, 0, MB_SEEK_END);
+
+    if (length < (int) sizeof(chunk))
+    {
+        fs.close(fd);
+        return MICROBIT_NO_DATA;
+    }
+
+    for (int i = 0; i < iterations; i++)
+    {
+        // A simple LCG, so that every run reads the same sequence of positions.
+        seed = seed * 1664525 + 1013904223;
+        int offset = (seed >> 8) % (length - sizeof(chunk) + 1);
+
+        uint64_t start = system_timer_current_time_us();
+
+        if (fs.seek(fd, offset, MB_SEEK_SET) != offset || fs.read(fd, chunk, sizeof(chunk)) != (int) sizeof(chunk))
+        {
+            result.failures++;
+            continue;
+        }
+
+        benchmark_storage_sample(result, start, sizeof(chunk));
+    }
+
+    fs.close(fd);
+    benchmark_storage_record(result, erases);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the latency of opening and closing the file written by benchmark_fs_append() for reading.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of times to open and close the file.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if iterations is not positive,
+  *         or MICROBIT_NO_DATA if the file does not exist.
+  */
+int benchmark_fs_open_close(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result)
+{
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&result, 0, sizeof(result));
+
+    uint32_t erases = benchmark_erase_count();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        uint64_t start = system_timer_current_time_us();
+        int fd = fs.open(MICROBIT_BENCHMARK_FILE_NAME, MB_READ);
+
+        if (fd < 0)
+            return MICROBIT_NO_DATA;
+
+        fs.close(fd);
+        benchmark_storage_sample(result, start, 0);
+    }
+
+    benchmark_storage_record(result, erases);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of file churn. On each iteration, MICROBIT_BENCHMARK_FILE_NAME is removed, then created again
+  * holding a single MICROBIT_BENCHMARK_FILE_CHUNK, and closed. This exercises block recycling, and is a good
+  * way to observe page erase counts. The file is removed once the benchmark completes.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param iterations The number of times to recreate the file.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_fs_churn(MicroBitFileSystem &fs, int iterations, MicroBitBenchmarkStorageResult &result)
+{
+    uint8_t chunk[MICROBIT_BENCHMARK_FILE_CHUNK];
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&result, 0, sizeof(result));
+
+    uint32_t erases = benchmark_erase_count();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        memset(chunk, i, sizeof(chunk));
+
+        uint64_t start = system_timer_current_time_us();
+
+        fs.remove(MICROBIT_BENCHMARK_FILE_NAME);
+
+        int fd = fs.open(MICROBIT_BENCHMARK_FILE_NAME, MB_WRITE | MB_CREAT);
+
+        if (fd < 0)
+        {
+            result.failures++;
+            continue;
+        }
+
+        int written = fs.write(fd, chunk, sizeof(chunk));
+        fs.close(fd);
+
+        if (written != (int) sizeof(chunk))
+        {
+            result.failures++;
+            continue;
+        }
+
+        benchmark_storage_sample(result, start, sizeof(chunk));
+    }
+
+    fs.remove(MICROBIT_BENCHMARK_FILE_NAME);
+    benchmark_storage_record(result, erases);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Measures the cost of MicroBitStorage::put() and MicroBitStorage::get(), using a full sized value that
+  * changes on every iteration. The key is removed once the benchmark completes.
+  *
+  * @param storage The key/value store to benchmark.
+  *
+  * @param iterations The number of values to store and retrieve.
+  *
+  * @param put Populated with the results of the put benchmark.
+  *
+  * @param get Populated with the results of the get benchmark.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if iterations is not positive.
+  */
+int benchmark_storage(MicroBitStorage &storage, int iterations, MicroBitBenchmarkStorageResult &put, MicroBitBenchmarkStorageResult &get)
+{
+    uint8_t value[MICROBIT_STORAGE_VALUE_SIZE];
+    uint32_t erases;
+
+    if (iterations <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&put, 0, sizeof(put));
+    memset(&get, 0, sizeof(get));
+
+    erases = benchmark_erase_count();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        memset(value, i, sizeof(value));
+
+        uint64_t start = system_timer_current_time_us();
+
+        if (storage.put(MICROBIT_BENCHMARK_STORAGE_KEY, value, sizeof(value)) != MICROBIT_OK)
+        {
+            put.failures++;
+            continue;
+        }
+
+        benchmark_storage_sample(put, start, sizeof(value));
+    }
+
+    benchmark_storage_record(put, erases);
+
+    erases = benchmark_erase_count();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        uint64_t start = system_timer_current_time_us();
+
+        if (storage.get(MICROBIT_BENCHMARK_STORAGE_KEY, value, sizeof(value)) != MICROBIT_OK)
+        {
+            get.failures++;
+            continue;
+        }
+
+        benchmark_storage_sample(get, start, sizeof(value));
+    }
+
+    benchmark_storage_record(get, erases);
+
+    storage.remove(MICROBIT_BENCHMARK_STORAGE_KEY);
+
+    return MICROBIT_OK;
+}
+
+// Identifies each radio benchmark packet sent, so that stale replies can be told apart.
+static uint32_t benchmark_radio_sequence = 0;
+
+/**
+  * Returns the radio to the default data rate and transmit power.
+  *
+  * @param radio The radio to reset.
+  */
+static void benchmark_radio_default(MicroBitRadio &radio)
+{
+    radio.setDataRate(MICROBIT_RADIO_DEFAULT_DATA_RATE);
+    radio.setTransmitPower(MICROBIT_RADIO_DEFAULT_TX_POWER);
+}
+
+/**
+  * Sends a radio benchmark packet, waiting for room in the transmit queue if necessary.
+  *
+  * @param radio The radio to send with.
+  *
+  * @param packet The packet to send.
+  *
+  * @return MICROBIT_OK on success, or the error from MicroBitRadioDatagram::send().
+  */
+static int benchmark_radio_send(MicroBitRadio &radio, MicroBitBenchmarkRadioPacket &packet)
+{
+    int status;
+
+    while ((status = radio.datagram.send((uint8_t *)&packet, sizeof(packet))) == MICROBIT_NO_RESOURCES || status == MICROBIT_BUSY)
+        fiber_sleep(1);
+
+    return status;
+}
+
+/**
+  * Waits for the reply to a radio benchmark packet, discarding any other packets received in the meantime.
+  *
+  * @param radio The radio to receive with.
+  *
+  * @param packet Populated with the reply.
+  *
+  * @param type The type of reply expected.
+  *
+  * @param sequence The sequence number of the packet being replied to.
+  *
+  * @param timeout How long to wait for the reply (milliseconds).
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_TIMEOUT if no reply was received in time.
+  */
+static int benchmark_radio_receive(MicroBitRadio &radio, MicroBitBenchmarkRadioPacket &packet, uint8_t type, uint32_t sequence, uint32_t timeout)
+{
+    uint64_t deadline = system_timer_current_time_us() + timeout * 1000;
+
+    while (1)
+    {
+        int length;
+
+        while ((length = radio.datagram.recv((uint8_t *)&packet, sizeof(packet))) >= 0)
+            if (length == sizeof(packet) && packet.type == type && packet.sequence == sequence)
+                return MICROBIT_OK;
+
+        uint64_t now = system_timer_current_time_us();
+
+        if (now >= deadline)
+            return MICROBIT_TIMEOUT;
+
+        fiber_wait_for_event_timeout(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, (uint32_t) ((deadline - now + 999) / 1000));
+    }
+}
+
+/**
+  * Sends a radio benchmark packet, and waits for its reply, retrying up to MICROBIT_BENCHMARK_RADIO_RETRIES times.
+  *
+  * @param radio The radio to use.
+  *
+  * @param packet The packet to send, which is replaced by its reply.
+  *
+  * @param type The type of reply expected.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if no reply was received, or the error from MicroBitRadioDatagram::send().
+  */
+static int benchmark_radio_request(MicroBitRadio &radio, MicroBitBenchmarkRadioPacket &packet, uint8_t type)
+{
+    MicroBitBenchmarkRadioPacket request = packet;
+
+    request.sequence = ++benchmark_radio_sequence;
+
+    for (int i = 0; i < MICROBIT_BENCHMARK_RADIO_RETRIES; i++)
+    {
+        int status = benchmark_radio_send(radio, request);
+
+        if (status != MICROBIT_OK)
+            return status;
+
+        if (benchmark_radio_receive(radio, packet, type, request.sequence, MICROBIT_BENCHMARK_RADIO_TIMEOUT) == MICROBIT_OK)
+            return MICROBIT_OK;
+    }
+
+    return MICROBIT_NO_DATA;
+}
+
+/**
+  * Measures the radio link to a second micro:bit running benchmark_radio_echo(), at the given data rate and transmit power.
+  *
+  * The setting is agreed with the echo at the default data rate and transmit power. PINGs are then sent one at a time,
+  * each waiting up to MICROBIT_BENCHMARK_RADIO_TIMEOUT milliseconds for its PONG, to measure round trip latency and loss.
+  * Finally, a burst of packets is sent back to back, and the echo asked how many it received, to measure throughput.
+  * Both devices return to the default setting afterwards.
+  *
+  * @param radio The radio to benchmark. This must be enabled, and in the same group as the echo.
+  *
+  * @param rate The data rate to test: MICROBIT_RADIO_DATA_RATE_250KBIT, MICROBIT_RADIO_DATA_RATE_1MBIT or MICROBIT_RADIO_DATA_RATE_2MBIT.
+  *
+  * @param power The transmit power to test, in the range 0..7.
+  *
+  * @param iterations The number of PINGs, and of BURST packets, to send.
+  *
+  * @param result Populated with the results of the benchmark.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if a parameter is out of range,
+  *         MICROBIT_NO_DATA if the echo did not respond, MICROBIT_NO_RESOURCES if there is not enough memory
+  *         to hold the latency samples, or the error from MicroBitRadioDatagram::send() if sending failed.
+  */
+int benchmark_radio_link(MicroBitRadio &radio, int rate, int power, int iterations, MicroBitBenchmarkRadioResult &result)
+{
+    MicroBitBenchmarkRadioPacket packet;
+    uint32_t *samples;
+    uint64_t start;
+    int status;
+
+    if (iterations <= 0 || power < 0 || power >= MICROBIT_BENCHMARK_RADIO_POWER_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (rate != MICROBIT_RADIO_DATA_RATE_250KBIT && rate != MICROBIT_RADIO_DATA_RATE_1MBIT && rate != MICROBIT_RADIO_DATA_RATE_2MBIT)
+        return MICROBIT_INVALID_PARAMETER;
+
+    memset(&result, 0, sizeof(result));
+    memset(&packet, 0, sizeof(packet));
+
+    result.data_rate = rate;
+    result.power = power;
+
+    samples = (uint32_t *) malloc(iterations * sizeof(uint32_t));
+
+    if (samples == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    // Agree the setting with the echo, while we can both still hear each other.
+    packet.type = MICROBIT_BENCHMARK_RADIO_CONFIG;
+    packet.rate = rate;
+    packet.power = power;
+
+    status = benchmark_radio_request(radio, packet, MICROBIT_BENCHMARK_RADIO_CONFIG_ACK);
+
+    if (status != MICROBIT_OK)
+    {
+        free(samples);
+        return status;
+    }
+
+    radio.setDataRate(rate);
+    radio.setTransmitPower(power);
+
+    // Give the echo time to follow.
+    fiber_sleep(MICROBIT_BENCHMARK_RADIO_TIMEOUT);
+
+    // Round trip latency, one PING at a time.
+    for (int i = 0; i < iterations && status == MICROBIT_OK; i++)
+    {
+        packet.type = MICROBIT_BENCHMARK_RADIO_PING;
+        packet.sequence = ++benchmark_radio_sequence;
+
+        start = system_timer_current_time_us();
+        packet.timestamp = (uint32_t) start;
+
+        status = benchmark_radio_send(radio, packet);
+        if (status != MICROBIT_OK)
+            break;
+
+        result.pings++;
+
+        if (benchmark_radio_receive(radio, packet, MICROBIT_BENCHMARK_RADIO_PONG, packet.sequence, MICROBIT_BENCHMARK_RADIO_TIMEOUT) == MICROBIT_OK)
+            samples[result.pongs++] = (uint32_t) (system_timer_current_time_us() - start);
+    }
+
+    // Throughput, with packets sent back to back.
+    start = system_timer_current_time_us();
+
+    for (int i = 0; i < iterations && status == MICROBIT_OK; i++)
+    {
+        packet.type = MICROBIT_BENCHMARK_RADIO_BURST;
+        packet.sequence = ++benchmark_radio_sequence;
+        packet.timestamp = (uint32_t) system_timer_current_time_us();
+
+        status = benchmark_radio_send(radio, packet);
+        if (status == MICROBIT_OK)
+            result.burst_sent++;
+    }
+
+    uint32_t elapsed = (uint32_t) (system_timer_current_time_us() - start);
+
+    if (status == MICROBIT_OK)
+    {
+        packet.type = MICROBIT_BENCHMARK_RADIO_REPORT_REQUEST;
+
+        if (benchmark_radio_request(radio, packet, MICROBIT_BENCHMARK_RADIO_REPORT) == MICROBIT_OK)
+            result.burst_received = packet.count;
+    }
+
+    // Release the echo, and return to the default setting ourselves.
+    packet.type = MICROBIT_BENCHMARK_RADIO_END;
+
+    for (int i = 0; i < 3; i++)
+    {
+        packet.sequence = ++benchmark_radio_sequence;
+        benchmark_radio_send(radio, packet);
+    }
+
+    fiber_sleep(MICROBIT_BENCHMARK_RADIO_TIMEOUT);
+    benchmark_radio_default(radio);
+
+    if (elapsed)
+    {
+        result.packets_per_second = (uint32_t) (((uint64_t) result.burst_sent * 1000000) / elapsed);
+        result.bytes_per_second = (uint32_t) (((uint64_t) result.burst_received * sizeof(packet) * 1000000) / elapsed);
+    }
+
+    // Sort the round trip times, to find the percentiles.
+    for (uint32_t i = 1; i < result.pongs; i++)
+    {
+        uint32_t sample = samples[i];
+        uint32_t j = i;
+
+        while (j > 0 && samples[j - 1] > sample)
+        {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+
+        samples[j] = sample;
+    }
+
+    if (result.pongs)
+    {
+        result.p50_us = samples[(result.pongs - 1) * 50 / 100];
+        result.p90_us = samples[(result.pongs - 1) * 90 / 100];
+        result.p99_us = samples[(result.pongs - 1) * 99 / 100];
+        result.max_us = samples[result.pongs - 1];
+    }
+
+    free(samples);
+
+    return status;
+}
+
+/**
+  * Acts as the echo for benchmark_radio_link() on another micro:bit. This function does not return.
+  *
+  * The echo follows the sender to each setting it requests, and returns to the default data rate and transmit power
+  * once told the test is over, or if it hears nothing for MICROBIT_BENCHMARK_RADIO_IDLE_TIMEOUT milliseconds.
+  *
+  * @param radio The radio to use. This must be enabled, and in the same group as the sender.
+  */
+void benchmark_radio_echo(MicroBitRadio &radio)
+{
+    MicroBitBenchmarkRadioPacket packet;
+    uint32_t received = 0;
+    uint64_t heard = 0;
+    bool testing = false;
+
+    while (1)
+    {
+        int length = radio.datagram.recv((uint8_t *)&packet, sizeof(packet));
+
+        if (length < 0)
+        {
+            // If the sender has gone quiet, it may have missed our CONFIG_ACK, or our END. Go back to where it can find us.
+            if (testing && system_timer_current_time_us() - heard > MICROBIT_BENCHMARK_RADIO_IDLE_TIMEOUT * 1000)
+            {
+                benchmark_radio_default(radio);
+                testing = false;
+            }
+
+            fiber_wait_for_event_timeout(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, MICROBIT_BENCHMARK_RADIO_TIMEOUT);
+            continue;
+        }
+
+        if (length != sizeof(packet))
+            continue;
+
+        heard = system_timer_current_time_us();
+
+        switch (packet.type)
+        {
+            case MICROBIT_BENCHMARK_RADIO_CONFIG:
+                packet.type = MICROBIT_BENCHMARK_RADIO_CONFIG_ACK;
+                benchmark_radio_send(radio, packet);
+
+                // Let the acknowledgement leave before changing setting.
+                fiber_sleep(5);
+
+                radio.setDataRate(packet.rate);
+                radio.setTransmitPower(packet.power);
+                received = 0;
+                testing = true;
+                break;
+
+            case MICROBIT_BENCHMARK_RADIO_PING:
+                packet.type = MICROBIT_BENCHMARK_RADIO_PONG;
+                benchmark_radio_send(radio, packet);
+                break;
+
+            case MICROBIT_BENCHMARK_RADIO_BURST:
+                received++;
+                break;
+
+            case MICROBIT_BENCHMARK_RADIO_REPORT_REQUEST:
+                packet.type = MICROBIT_BENCHMARK_RADIO_REPORT;
+                packet.count = received;
+                benchmark_radio_send(radio, packet);
+                break;
+
+            case MICROBIT_BENCHMARK_RADIO_END:
+                if (testing)
+                    benchmark_radio_default(radio);
+
+                testing = false;
+                break;
+        }
+    }
+}
+
+/**
+  * Writes a benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkResult &result)
+{
+    ManagedString line = ManagedString(name) + ": " + ManagedString((int) result.iterations) + " iterations, " +
+                         ManagedString((int) result.time_us) + " us, " + ManagedString((int) result.cycles) + " cycles\r\n";
+
+    serial.send(line);
+}
+
+/**
+  * Writes a latency distribution to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param distribution The distribution to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkDistribution &distribution)
+{
+    ManagedString line = ManagedString(name) + ": min " + ManagedString((int) distribution.min_us) + " us, max " +
+                         ManagedString((int) distribution.max_us) + " us, failures " + ManagedString((int) distribution.failures) + ", buckets";
+
+    for (int i = 0; i < MICROBIT_BENCHMARK_DISTRIBUTION_BUCKETS; i++)
+        line = line + " " + ManagedString((int) distribution.buckets[i]);
+
+    serial.send(line + "\r\n");
+}
+
+/**
+  * Writes a storage benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param name The name of the benchmark.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, const char *name, MicroBitBenchmarkStorageResult &result)
+{
+    ManagedString line = ManagedString(name) + ": " + ManagedString((int) result.operations) + " operations, " +
+                         ManagedString((int) result.failures) + " failures, " + ManagedString((int) result.bytes) + " bytes, " +
+                         ManagedString((int) result.time_us) + " us, " + ManagedString((int) result.latency_us) + " us average, " +
+                         ManagedString((int) result.max_us) + " us max, " + ManagedString((int) result.bytes_per_second) + " bytes/s, " +
+                         ManagedString((int) result.erases) + " erases\r\n";
+
+    serial.send(line);
+}
+
+/**
+  * Writes a radio benchmark result to the given serial port, as a single line of text.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param result The result to write.
+  */
+void benchmark_print(MicroBitSerial &serial, MicroBitBenchmarkRadioResult &result)
+{
+    ManagedString line = ManagedString("radio ") + ManagedString((int) result.data_rate) + " kbit/s, power " + ManagedString((int) result.power) + ": " +
+                         ManagedString((int) result.pongs) + "/" + ManagedString((int) result.pings) + " pongs, rtt p50 " +
+                         ManagedString((int) result.p50_us) + " us, p90 " + ManagedString((int) result.p90_us) + " us, p99 " +
+                         ManagedString((int) result.p99_us) + " us, max " + ManagedString((int) result.max_us) + " us, burst " +
+                         ManagedString((int) result.burst_received) + "/" + ManagedString((int) result.burst_sent) + ", " +
+                         ManagedString((int) result.packets_per_second) + " packets/s, " + ManagedString((int) result.bytes_per_second) + " bytes/s\r\n";
+
+    serial.send(line);
+}
+
+/**
+  * Runs every benchmark, and writes the results to the given serial port.
+  *
+  * @param bus The message bus to benchmark.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of iterations of each benchmark to perform.
+  *
+  * @return MICROBIT_OK on success, or the error code of the first benchmark that failed.
+  */
+int benchmark_run_all(MicroBitMessageBus &bus, MicroBitSerial &serial, int iterations)
+{
+    MicroBitBenchmarkResult fob, direct, result, alpha, shift, fixed, bearing, bearingFixed;
+    MicroBitBenchmarkDistribution distribution;
+    int status;
+
+    status = benchmark_event_dispatch(bus, iterations, fob, direct);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "dispatch (invoke)", fob);
+    benchmark_print(serial, "dispatch (direct)", direct);
+
+    status = benchmark_context_switch(iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "context switch", result);
+
+    status = benchmark_invoke(iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "invoke", result);
+
+    status = benchmark_event_send(bus, iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "send", result);
+
+    status = benchmark_wait_for_event(iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "wait for event", result);
+
+    status = benchmark_heap_churn(iterations, result, distribution);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "heap churn", result);
+    benchmark_print(serial, "heap churn", distribution);
+
+    status = benchmark_image(iterations, result, alpha, shift);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "image paste", result);
+    benchmark_print(serial, "image paste (alpha)", alpha);
+    benchmark_print(serial, "image shift", shift);
+
+    status = benchmark_orientation(iterations, result, fixed, bearing, bearingFixed);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "pitch/roll (float)", result);
+    benchmark_print(serial, "pitch/roll (fixed)", fixed);
+    benchmark_print(serial, "bearing (float)", bearing);
+    benchmark_print(serial, "bearing (fixed)", bearingFixed);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Runs every file system and storage benchmark, and writes the results to the given serial port.
+  *
+  * Flash operations behave differently while BLE is running, as they are scheduled around radio activity
+  * by the SoftDevice, so whether BLE is active is reported alongside the results. Run the benchmarks from
+  * builds with and without BLE enabled to compare the two.
+  *
+  * n.b. These benchmarks write to flash, and so wear it. Use modest iteration counts.
+  *
+  * @param fs The file system to benchmark.
+  *
+  * @param storage The key/value store to benchmark.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of iterations of each benchmark to perform.
+  *
+  * @return MICROBIT_OK on success, or the error code of the first benchmark that failed.
+  */
+int benchmark_run_storage(MicroBitFileSystem &fs, MicroBitStorage &storage, MicroBitSerial &serial, int iterations)
+{
+    MicroBitBenchmarkStorageResult result, get;
+    int status;
+
+    serial.send(ble_running() ? "storage benchmarks (BLE active)\r\n" : "storage benchmarks (BLE inactive)\r\n");
+
+    status = benchmark_fs_append(fs, iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "fs append", result);
+
+    status = benchmark_fs_random_read(fs, iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "fs random read", result);
+
+    status = benchmark_fs_open_close(fs, iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "fs open/close", result);
+
+    status = benchmark_fs_churn(fs, iterations, result);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "fs remove/recreate", result);
+
+    status = benchmark_storage(storage, iterations, result, get);
+    if (status != MICROBIT_OK)
+        return status;
+
+    benchmark_print(serial, "storage put", result);
+    benchmark_print(serial, "storage get", get);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Runs the two device radio benchmark, with the role of this device chosen by button.
+  *
+  * Once a button is pressed, the device either acts as the sender, running benchmark_radio_link() at every data rate and
+  * transmit power and writing the results to the given serial port, or acts as the echo, and never returns.
+  * BLE must not be running, as the radio cannot then be used directly.
+  *
+  * @param radio The radio to benchmark.
+  *
+  * @param sender The button that selects the sender role.
+  *
+  * @param echo The button that selects the echo role.
+  *
+  * @param serial The serial port to write to.
+  *
+  * @param iterations The number of PINGs, and of BURST packets, to send at each setting.
+  *
+  * @return MICROBIT_OK once the sender has completed, MICROBIT_NOT_SUPPORTED if BLE is running,
+  *         or the error code of the first benchmark that failed.
+  */
+int benchmark_run_radio(MicroBitRadio &radio, MicroBitButton &sender, MicroBitButton &echo, MicroBitSerial &serial, int iterations)
+{
+    static const int rates[] = { MICROBIT_RADIO_DATA_RATE_250KBIT, MICROBIT_RADIO_DATA_RATE_1MBIT, MICROBIT_RADIO_DATA_RATE_2MBIT };
+    MicroBitBenchmarkRadioResult result;
+    int status;
+
+    status = radio.enable();
+    if (status != MICROBIT_OK)
+        return status;
+
+    serial.send("radio benchmark: press the sender or echo button\r\n");
+
+    while (!sender.isPressed() && !echo.isPressed())
+        fiber_sleep(10);
+
+    if (!sender.isPressed())
+    {
+        serial.send("radio echo\r\n");
+        benchmark_radio_echo(radio);
+    }
+
+    for (int r = 0; r < (int) (sizeof(rates) / sizeof(rates[0])); r++)
+    {
+        for (int power = 0; power < MICROBIT_BENCHMARK_RADIO_POWER_LEVELS; power++)
+        {
+            status = benchmark_radio_link(radio, rates[r], power, iterations, result);
+
+            if (status == MICROBIT_NO_DATA)
+            {
+                serial.send("radio " + ManagedString(rates[r]) + " kbit/s, power " + ManagedString(power) + ": no echo\r\n");
+                continue;
+            }
+
+            if (status != MICROBIT_OK)
+                return status;
+
+            benchmark_print(serial, result);
+        }
+    }
+
+    return MICROBIT_OK;
+}
+
+#endif
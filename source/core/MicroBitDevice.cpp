@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitButton.h"
 #include "MicroBitDevice.h"
 #include "MicroBitFont.h"
+#include "MicroBitCompat.h"
 #include "mbed.h"
 #include "ErrorNo.h"
 
@@ -47,6 +48,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "nrf_soc.h"
 #include "nrf_sdm.h"
+extern "C" void btle_set_user_evt_handler(void (*func)(uint32_t));
 
 /*
  * Return to our predefined compiler settings.
@@ -60,6 +62,19 @@ static const uint8_t panicFace[5] = {0x1B, 0x1B,0x0,0x0E,0x11};
 static int panic_timeout = 0;
 static uint32_t random_value = 0;
 
+// The number of drivers that may listen for SoftDevice SoC events.
+#define MICROBIT_SOC_EVENT_HANDLERS 4
+
+static void (*soc_event_handlers[MICROBIT_SOC_EVENT_HANDLERS])(uint32_t);
+
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+// A ring of true random bytes from the hardware RNG, filled in the background.
+static uint8_t entropy_pool[MICROBIT_ENTROPY_POOL_SIZE];
+static volatile uint8_t entropy_head = 0;
+static volatile uint8_t entropy_count = 0;
+static volatile bool entropy_filling = false;
+#endif
+
 /**
   * Determines if a BLE stack is currently running.
   *
@@ -76,6 +91,49 @@ bool ble_running()
     return t==1;
 }
 
+/*
+ * Passes each SoC event raised by the SoftDevice to every registered handler.
+ */
+static void soc_event_dispatch(uint32_t evt)
+{
+    for (int i = 0; i < MICROBIT_SOC_EVENT_HANDLERS && soc_event_handlers[i] != NULL; i++)
+        soc_event_handlers[i](evt);
+}
+
+/**
+  * Registers a function to be called with each SoC event raised by the SoftDevice,
+  * such as the completion of a FLASH operation or the scheduling of a radio timeslot.
+  *
+  * The Bluetooth stack delivers SoC events to a single handler, so drivers register here to share it.
+  *
+  * @param handler The function to call with the event identifier.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if handler is NULL, or MICROBIT_NO_RESOURCES if too many handlers are registered.
+  */
+int microbit_add_soc_event_handler(void (*handler)(uint32_t))
+{
+    if (handler == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    for (int i = 0; i < MICROBIT_SOC_EVENT_HANDLERS; i++)
+    {
+        if (soc_event_handlers[i] == handler)
+            return MICROBIT_OK;
+
+        if (soc_event_handlers[i] == NULL)
+        {
+            soc_event_handlers[i] = handler;
+
+            if (i == 0)
+                btle_set_user_evt_handler(soc_event_dispatch);
+
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_NO_RESOURCES;
+}
+
 /**
  * Derive a unique, consistent serial number of this device from internal data.
  *
@@ -267,6 +325,177 @@ void microbit_panic(int statusCode)
     microbit_reset();
 }
 
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+/*
+ * Called as the hardware RNG produces each byte. Adds it to the entropy pool, stopping the RNG once the pool is full.
+ */
+extern "C" void RNG_IRQHandler(void)
+{
+    NRF_RNG->EVENTS_VALRDY = 0;
+
+    if (entropy_count < MICROBIT_ENTROPY_POOL_SIZE)
+    {
+        entropy_pool[(entropy_head + entropy_count) % MICROBIT_ENTROPY_POOL_SIZE] = NRF_RNG->VALUE;
+        entropy_count++;
+    }
+
+    if (entropy_count == MICROBIT_ENTROPY_POOL_SIZE)
+    {
+        NRF_RNG->TASKS_STOP = 1;
+        NRF_RNG->INTENCLR = RNG_INTENCLR_VALRDY_Msk;
+        entropy_filling = false;
+    }
+}
+
+/*
+ * Tops up the entropy pool. The hardware RNG is started, and fills the pool by interrupt.
+ * If Bluetooth is running, the SoftDevice owns the RNG, so we take what it has gathered instead, without waiting for more.
+ */
+static void entropy_refill()
+{
+    if (entropy_count == MICROBIT_ENTROPY_POOL_SIZE)
+        return;
+
+    if (ble_running())
+    {
+        uint8_t available = 0;
+        uint8_t bytes[MICROBIT_ENTROPY_POOL_SIZE];
+
+        sd_rand_application_bytes_available_get(&available);
+        available = min(available, MICROBIT_ENTROPY_POOL_SIZE - entropy_count);
+
+        if (available == 0 || sd_rand_application_vector_get(bytes, available) != NRF_SUCCESS)
+            return;
+
+        __disable_irq();
+
+        for (int i = 0; i < available && entropy_count < MICROBIT_ENTROPY_POOL_SIZE; i++)
+        {
+            entropy_pool[(entropy_head + entropy_count) % MICROBIT_ENTROPY_POOL_SIZE] = bytes[i];
+            entropy_count++;
+        }
+
+        __enable_irq();
+
+        return;
+    }
+
+    if (entropy_filling)
+        return;
+
+    entropy_filling = true;
+
+    // Bias correction halves the rate of the RNG, but it's working in the background, and this is what the pool is for.
+    NRF_RNG->CONFIG = RNG_CONFIG_DERCEN_Msk;
+    NRF_RNG->EVENTS_VALRDY = 0;
+    NRF_RNG->INTENSET = RNG_INTENSET_VALRDY_Msk;
+
+    NVIC_ClearPendingIRQ(RNG_IRQn);
+    NVIC_EnableIRQ(RNG_IRQn);
+
+    NRF_RNG->TASKS_START = 1;
+}
+#endif
+
+/**
+  * Determines how many bytes of true random data are immediately available to microbit_entropy_read().
+  *
+  * @return The number of bytes in the entropy pool, or zero if MICROBIT_ENTROPY_POOL_SIZE is zero.
+  */
+int microbit_entropy_available()
+{
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+    entropy_refill();
+
+    return entropy_count;
+#else
+    return 0;
+#endif
+}
+
+/**
+  * Takes true random data, gathered from the hardware RNG in the background, from the entropy pool.
+  * This never waits for the RNG. The pool is topped up again as data is taken.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The number of bytes required. This can be no more than MICROBIT_ENTROPY_POOL_SIZE.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is NULL or length is out of range,
+  *         or MICROBIT_NO_DATA if the pool holds fewer than length bytes, in which case none are taken.
+  *
+  * @code
+  * uint8_t key[16];
+  *
+  * while (microbit_entropy_read(key, sizeof(key)) != MICROBIT_OK)
+  *     fiber_sleep(1);
+  * @endcode
+  */
+int microbit_entropy_read(uint8_t *buffer, int length)
+{
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+    if (buffer == NULL || length <= 0 || length > MICROBIT_ENTROPY_POOL_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int result = MICROBIT_NO_DATA;
+
+    // Take what the SoftDevice has gathered, if it owns the RNG.
+    if (entropy_count < length)
+        entropy_refill();
+
+    __disable_irq();
+
+    if (entropy_count >= length)
+    {
+        for (int i = 0; i < length; i++)
+        {
+            buffer[i] = entropy_pool[entropy_head];
+            entropy_head = (entropy_head + 1) % MICROBIT_ENTROPY_POOL_SIZE;
+        }
+
+        entropy_count -= length;
+        result = MICROBIT_OK;
+    }
+
+    __enable_irq();
+
+    entropy_refill();
+
+    return result;
+#else
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/*
+ * Cycles the Galois LFSR once.
+ *
+ * We use an optimal sequence with a period of 2^32-1, as defined by Bruce Schneier here (a true legend in the field!),
+ * For those interested, it's documented in his paper:
+ * "Pseudo-Random Sequence Generator for 32-Bit CPUs: A fast, machine-independent generator for 32-bit Microprocessors"
+ * https://www.schneier.com/paper-pseudorandom-sequence.html
+ *
+ * @return The bit shifted out of the register.
+ */
+static inline uint32_t random_lfsr_bit()
+{
+    uint32_t rnd = random_value;
+
+    rnd = ((((rnd >> 31)
+                  ^ (rnd >> 6)
+                  ^ (rnd >> 4)
+                  ^ (rnd >> 2)
+                  ^ (rnd >> 1)
+                  ^ rnd)
+                  & 0x0000001)
+                  << 31 )
+                  | (rnd >> 1);
+
+    random_value = rnd;
+
+    return rnd & 0x00000001;
+}
+
 /**
   * Generate a random number in the given range.
   * We use a simple Galois LFSR random number generator here,
@@ -274,6 +503,8 @@ void microbit_panic(int statusCode)
   * than the hardware random number generator built int the processor, which takes
   * a long time and uses a lot of energy.
   *
+  * If MICROBIT_RANDOM_ENTROPY is enabled, true random data from the entropy pool is used instead while the pool has enough.
+  *
   * KIDS: You shouldn't use this is the real world to generte cryptographic keys though...
   * have a think why not. :-)
   *
@@ -298,33 +529,80 @@ int microbit_random(int max)
     do {
         m = (uint32_t)max;
         result = 0;
+
+#if CONFIG_ENABLED(MICROBIT_RANDOM_ENTROPY) && MICROBIT_ENTROPY_POOL_SIZE >= 4
+        // Take as many bits of true random data as max needs, and try again if the result is out of range.
+        if (microbit_entropy_read((uint8_t *)&result, sizeof(result)) == MICROBIT_OK)
+        {
+            m |= m >> 1;
+            m |= m >> 2;
+            m |= m >> 4;
+            m |= m >> 8;
+            m |= m >> 16;
+
+            result &= m;
+            continue;
+        }
+#endif
+
 		do {
-            // Cycle the LFSR (Linear Feedback Shift Register).
-            // We use an optimal sequence with a period of 2^32-1, as defined by Bruce Schneier here (a true legend in the field!),
-            // For those interested, it's documented in his paper:
-            // "Pseudo-Random Sequence Generator for 32-Bit CPUs: A fast, machine-independent generator for 32-bit Microprocessors"
-            // https://www.schneier.com/paper-pseudorandom-sequence.html
-			uint32_t rnd = random_value;
-
-            rnd = ((((rnd >> 31)
-                          ^ (rnd >> 6)
-                          ^ (rnd >> 4)
-                          ^ (rnd >> 2)
-                          ^ (rnd >> 1)
-                          ^ rnd)
-                          & 0x0000001)
-                          << 31 )
-                          | (rnd >> 1);
-
-			random_value = rnd;
-
-            result = ((result << 1) | (rnd & 0x00000001));
+            // Cycle the LFSR (Linear Feedback Shift Register) for each bit of the result.
+            result = ((result << 1) | random_lfsr_bit());
         } while(m >>= 1);
     } while (result > (uint32_t)max);
 
     return result;
 }
 
+/**
+  * Fills a buffer with random bytes.
+  *
+  * This is much faster than calling microbit_random(256) for each byte. Bytes are taken from the Galois LFSR,
+  * or from the entropy pool while it holds enough data if MICROBIT_RANDOM_ENTROPY is enabled.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The number of bytes to write.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is NULL or length is negative.
+  *
+  * @code
+  * uint8_t noise[64];
+  * microbit_random_fill(noise, sizeof(noise));
+  * @endcode
+  */
+int microbit_random_fill(uint8_t *buffer, int length)
+{
+    if (buffer == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+#if CONFIG_ENABLED(MICROBIT_RANDOM_ENTROPY) && MICROBIT_ENTROPY_POOL_SIZE > 0
+    // Take whole chunks of the pool for as long as it lasts.
+    while (length > 0)
+    {
+        int chunk = min(length, max(1, entropy_count));
+
+        if (microbit_entropy_read(buffer, chunk) != MICROBIT_OK)
+            break;
+
+        buffer += chunk;
+        length -= chunk;
+    }
+#endif
+
+    while (length-- > 0)
+    {
+        uint32_t b = 0;
+
+        for (int i = 0; i < 8; i++)
+            b = (b << 1) | random_lfsr_bit();
+
+        *buffer++ = b;
+    }
+
+    return MICROBIT_OK;
+}
+
 /**
   * Seed the random number generator (RNG).
   *
@@ -332,11 +610,19 @@ int microbit_random(int max)
   * We do this as the hardware RNG is relatively high power, and is locked out by the BLE stack internally,
   * with a less than optimal application interface. A Galois LFSR is sufficient for our
   * applications, and much more lightweight.
+  *
+  * The seed is taken from the entropy pool where possible, so only the first call waits for the RNG. This also
+  * starts the pool filling in the background.
   */
 void microbit_seed_random()
 {
     random_value = 0;
 
+#if MICROBIT_ENTROPY_POOL_SIZE >= 4
+    if (microbit_entropy_read((uint8_t*)&random_value, sizeof(random_value)) == MICROBIT_OK && random_value != 0)
+        return;
+#endif
+
     if(ble_running())
     {
         // If Bluetooth is enabled, we need to go through the Nordic software to safely do this.
@@ -349,6 +635,11 @@ void microbit_seed_random()
     else
     {
         // Othwerwise we can access the hardware RNG directly.
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+        // Take the RNG back from the entropy pool. It is given back below.
+        NRF_RNG->INTENCLR = RNG_INTENCLR_VALRDY_Msk;
+        entropy_filling = false;
+#endif
 
         // Start the Random number generator. No need to leave it running... I hope. :-)
         NRF_RNG->TASKS_START = 1;
@@ -367,6 +658,14 @@ void microbit_seed_random()
         // Disable the generator to save power.
         NRF_RNG->TASKS_STOP = 1;
     }
+
+    // The LFSR never leaves zero.
+    if (random_value == 0)
+        random_value = 0xBBC5EED;
+
+#if MICROBIT_ENTROPY_POOL_SIZE > 0
+    entropy_refill();
+#endif
 }
 
 /**
@@ -34,6 +34,8 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitFiber.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitPowerProfile.h"
+#include "MicroBitDevice.h"
 
 /*
  * Statically allocated values used to create and destroy Fibers.
@@ -46,9 +48,11 @@ static Fiber *idleFiber = NULL;                    // the idle task - performs a
 /*
  * Scheduler state.
  */
-static Fiber *runQueue = NULL;                     // The list of runnable fibers.
-static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation.
-static Fiber *waitQueue = NULL;                    // The list of blocked fibers waiting on an event.
+static Fiber *runQueue[MICROBIT_FIBER_PRIORITY_LEVELS];    // The lists of runnable fibers, one per priority level.
+static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation, ordered by wake time.
+static Fiber *waitQueue[MICROBIT_FIBER_WAIT_QUEUE_BUCKETS + 1];   // The lists of blocked fibers waiting on an event, bucketed by event ID.
+                                                                    // The last bucket holds fibers waiting on MICROBIT_ID_ANY.
+static Fiber *timedWaitQueue = NULL;               // The list of fibers blocked in fiber_wait_for_event_timeout(), ordered by wake time.
 static Fiber *fiberPool = NULL;                    // Pool of unused fibers, just waiting for a job to do.
 
 /*
@@ -56,14 +60,283 @@ static Fiber *fiberPool = NULL;                    // Pool of unused fibers, jus
  */
 static uint8_t fiber_flags = 0;
 
+/*
+ * The priority assigned to any fiber forked from the current fork on block context.
+ */
+static uint8_t fob_priority = MICROBIT_FIBER_PRIORITY_NORMAL;
+
 
 /*
  * Fibers may perform wait/notify semantics on events. If set, these operations will be permitted on this EventModel.
  */
 static EventModel *messageBus = NULL;
 
-// Array of components which are iterated during idle thread execution.
-static MicroBitComponent* idleThreadComponents[MICROBIT_IDLE_COMPONENTS];
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+/*
+ * Fiber local storage keys. A key is in use if it is less than fiberLocalKeys.
+ */
+static uint8_t fiberLocalKeys = 0;
+static void (*fiberLocalDestructors[MICROBIT_FIBER_LOCAL_STORAGE_SLOTS])(void *);
+#endif
+
+/*
+ * A component registered to receive idle callbacks.
+ */
+struct IdleComponent
+{
+    MicroBitComponent *component;       // The component to call.
+    uint8_t mode;                       // MICROBIT_IDLE_COMPONENT_POLLED or MICROBIT_IDLE_COMPONENT_ON_DEMAND.
+    volatile uint8_t pending;           // Set when an on demand component has signalled it has work to do.
+};
+
+// Compacted array of components which are iterated during idle thread execution.
+// This starts out in static storage, and is moved to the heap if more than MICROBIT_IDLE_COMPONENTS are added.
+static IdleComponent idleThreadComponentsStatic[MICROBIT_IDLE_COMPONENTS];
+static IdleComponent *idleThreadComponents = idleThreadComponentsStatic;
+static int idleThreadComponentsCount = 0;
+static int idleThreadComponentsCapacity = MICROBIT_IDLE_COMPONENTS;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+/*
+ * Ring buffer of recent context switches. This is only ever written from schedule(), so needs no locking.
+ */
+static FiberTraceRecord traceBuffer[MICROBIT_FIBER_TRACE_BUFFER_SIZE];
+static uint32_t traceCount = 0;
+
+/**
+  * Records a context switch in the trace buffer, and updates the run time statistics
+  * of the fibers involved.
+  *
+  * @param from The fiber being scheduled out.
+  *
+  * @param to The fiber being scheduled in.
+  */
+static void fiber_trace_switch(Fiber *from, Fiber *to)
+{
+    uint32_t now = (uint32_t) system_timer_current_time_us();
+
+    from->run_time += now - from->run_start;
+    to->run_start = now;
+    to->switch_count++;
+
+    FiberTraceRecord *r = &traceBuffer[traceCount % MICROBIT_FIBER_TRACE_BUFFER_SIZE];
+    r->timestamp = now;
+    r->from = from;
+    r->to = to;
+
+    traceCount++;
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+/*
+ * Preallocated stack buffers, used in preference to the heap when paging out fiber stacks.
+ * Each size class holds a free list of unused buffers, linked through the first word of each buffer.
+ */
+struct FiberStackClass
+{
+    uint32_t size;                      // The size of each buffer in this class, in bytes.
+    uint32_t *base;                     // The start address of the memory reserved for this class.
+    uint32_t count;                     // The number of buffers in this class.
+    uint32_t *free;                     // The list of unused buffers in this class.
+};
+
+static uint32_t stackPoolSmall[MICROBIT_FIBER_STACK_POOL_SMALL_COUNT][MICROBIT_FIBER_STACK_POOL_SMALL_SIZE / 4];
+static uint32_t stackPoolMedium[MICROBIT_FIBER_STACK_POOL_MEDIUM_COUNT][MICROBIT_FIBER_STACK_POOL_MEDIUM_SIZE / 4];
+static uint32_t stackPoolLarge[MICROBIT_FIBER_STACK_POOL_LARGE_COUNT][MICROBIT_FIBER_STACK_POOL_LARGE_SIZE / 4];
+
+static FiberStackClass stackPool[] = {
+    { MICROBIT_FIBER_STACK_POOL_SMALL_SIZE, &stackPoolSmall[0][0], MICROBIT_FIBER_STACK_POOL_SMALL_COUNT, NULL },
+    { MICROBIT_FIBER_STACK_POOL_MEDIUM_SIZE, &stackPoolMedium[0][0], MICROBIT_FIBER_STACK_POOL_MEDIUM_COUNT, NULL },
+    { MICROBIT_FIBER_STACK_POOL_LARGE_SIZE, &stackPoolLarge[0][0], MICROBIT_FIBER_STACK_POOL_LARGE_COUNT, NULL }
+};
+
+#define MICROBIT_FIBER_STACK_POOL_CLASSES   (sizeof(stackPool) / sizeof(FiberStackClass))
+
+/**
+  * Places every buffer of every size class onto the free list of its class.
+  */
+static void stack_pool_init()
+{
+    for (uint32_t i = 0; i < MICROBIT_FIBER_STACK_POOL_CLASSES; i++)
+    {
+        FiberStackClass *c = &stackPool[i];
+        c->free = NULL;
+
+        for (uint32_t j = 0; j < c->count; j++)
+        {
+            uint32_t *b = c->base + (j * c->size / 4);
+            *b = (uint32_t) c->free;
+            c->free = b;
+        }
+    }
+}
+
+/**
+  * Determines which size class (if any) the given stack buffer was taken from.
+  *
+  * @param buffer The start address of the buffer.
+  *
+  * @return The size class holding the buffer, or NULL if it was allocated from the heap.
+  */
+static FiberStackClass *stack_pool_owner(uint32_t buffer)
+{
+    for (uint32_t i = 0; i < MICROBIT_FIBER_STACK_POOL_CLASSES; i++)
+    {
+        FiberStackClass *c = &stackPool[i];
+
+        if (buffer >= (uint32_t) c->base && buffer < (uint32_t) c->base + c->size * c->count)
+            return c;
+    }
+
+    return NULL;
+}
+
+/**
+  * Takes an unused buffer from the smallest size class able to hold the given number of bytes.
+  *
+  * @param size The minimum size of the buffer required, in bytes.
+  *
+  * @param bufferSize Updated with the actual size of the buffer provided.
+  *
+  * @return The start address of the buffer, or 0 if no suitable buffer is available.
+  */
+static uint32_t stack_pool_allocate(uint32_t size, uint32_t *bufferSize)
+{
+    uint32_t buffer = 0;
+
+    __disable_irq();
+
+    for (uint32_t i = 0; i < MICROBIT_FIBER_STACK_POOL_CLASSES; i++)
+    {
+        FiberStackClass *c = &stackPool[i];
+
+        if (c->size >= size && c->free != NULL)
+        {
+            buffer = (uint32_t) c->free;
+            c->free = (uint32_t *) *c->free;
+            *bufferSize = c->size;
+            break;
+        }
+    }
+
+    __enable_irq();
+
+    return buffer;
+}
+
+/**
+  * Releases the given stack buffer, returning it to its size class or to the heap as appropriate.
+  *
+  * @param buffer The start address of the buffer to release.
+  */
+static void stack_pool_release(uint32_t buffer)
+{
+    FiberStackClass *c = stack_pool_owner(buffer);
+
+    if (c == NULL)
+    {
+        free((void *)buffer);
+        return;
+    }
+
+    __disable_irq();
+
+    *((uint32_t *)buffer) = (uint32_t) c->free;
+    c->free = (uint32_t *) buffer;
+
+    __enable_irq();
+}
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS)
+/*
+ * The stack used by interrupt handlers once thread mode has moved onto the process stack.
+ */
+static uint32_t handlerStack[MICROBIT_FIBER_HANDLER_STACK_SIZE / 4];
+
+// Fibers start executing at the top of their own stack.
+#define FIBER_INITIAL_SP(f)         ((f)->stack_top - 0x04)
+
+/**
+  * Moves thread mode execution onto the process stack (PSP), and interrupt handling onto a dedicated handler stack.
+  *
+  * The process stack takes over at the current stack pointer, so the calling code continues undisturbed
+  * as the main fiber, on the system stack.
+  */
+static void fiber_enable_process_stack()
+{
+    handlerStack[0] = MICROBIT_FIBER_STACK_GUARD;
+
+    __disable_irq();
+
+    __set_PSP(__get_MSP());
+    __set_CONTROL(__get_CONTROL() | 0x02);
+    __ISB();
+
+    __set_MSP((uint32_t) &handlerStack[MICROBIT_FIBER_HANDLER_STACK_SIZE / 4]);
+
+    __enable_irq();
+}
+
+/**
+  * Ensures the given fiber has a stack of its own to execute on.
+  *
+  * Stacks persist with their fiber, including whilst it is held in the fiber pool, so this is typically only
+  * an allocation the first time a fiber context is used.
+  *
+  * @param f The fiber to provide a stack for.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if no memory is available.
+  */
+static int fiber_allocate_stack(Fiber *f)
+{
+    if (f->stack_bottom == 0)
+    {
+        uint32_t bufferSize = MICROBIT_FIBER_DEDICATED_STACK_SIZE;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+        f->stack_bottom = stack_pool_allocate(MICROBIT_FIBER_DEDICATED_STACK_SIZE, &bufferSize);
+
+        if (f->stack_bottom == 0)
+            f->stack_bottom = (uint32_t) malloc(bufferSize);
+#else
+        f->stack_bottom = (uint32_t) malloc(bufferSize);
+#endif
+
+        if (f->stack_bottom == 0)
+            return MICROBIT_NO_RESOURCES;
+
+        f->stack_top = f->stack_bottom + bufferSize;
+        *((uint32_t *)f->stack_bottom) = MICROBIT_FIBER_STACK_GUARD;
+    }
+
+    f->tcb.stack_base = f->stack_top;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Checks the guard words of the given fiber's stack and of the handler stack, and panics if either has been overwritten.
+  *
+  * @param f The fiber being scheduled out.
+  */
+static void verify_stack_guard(Fiber *f)
+{
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+    uint32_t stackDepth = f->stack_top - __get_PSP();
+
+    if (stackDepth > f->peak_stack)
+        f->peak_stack = stackDepth;
+#endif
+
+    if (*((uint32_t *)f->stack_bottom) != MICROBIT_FIBER_STACK_GUARD || handlerStack[0] != MICROBIT_FIBER_STACK_GUARD)
+        microbit_panic(MICROBIT_STACK_OVERFLOW);
+}
+#else
+// Fibers start executing at the top of the shared system stack.
+#define FIBER_INITIAL_SP(f)         (CORTEX_M0_STACK_BASE - 0x04)
+#endif
 
 /**
   * Utility function to add the currenty running fiber to the given queue.
@@ -109,6 +382,91 @@ void queue_fiber(Fiber *f, Fiber **queue)
     __enable_irq();
 }
 
+/**
+  * Utility function to add the given fiber to the sleep queue, maintaining the queue in order of
+  * increasing wake up time (as stored in the fiber's context field).
+  *
+  * Fibers with equal wake up times are queued in the order they went to sleep.
+  *
+  * @param f The fiber to add to the sleep queue.
+  */
+static void queue_fiber_sleeping(Fiber *f)
+{
+    __disable_irq();
+
+    f->queue = &sleepQueue;
+
+    Fiber *p = NULL;
+    Fiber *l = sleepQueue;
+
+    // Find the first fiber due to wake after this one.
+    while (l != NULL && l->context <= f->context)
+    {
+        p = l;
+        l = l->next;
+    }
+
+    f->prev = p;
+    f->next = l;
+
+    if (p == NULL)
+        sleepQueue = f;
+    else
+        p->next = f;
+
+    if (l != NULL)
+        l->prev = f;
+
+    __enable_irq();
+}
+
+/**
+  * Utility function to add the given fiber to the timed wait queue, maintaining the queue in order of
+  * increasing wake up time (as stored in the fiber's wake_time field).
+  *
+  * The fiber remains on its event wait queue, and is woken by whichever of the two is satisfied first.
+  *
+  * @param f The fiber to add to the timed wait queue.
+  */
+static void queue_fiber_timed(Fiber *f)
+{
+    Fiber **p = &timedWaitQueue;
+
+    // Find the first fiber due to wake after this one.
+    while (*p != NULL && (*p)->wake_time <= f->wake_time)
+        p = &(*p)->timed_next;
+
+    f->timed_next = *p;
+    *p = f;
+    f->flags |= MICROBIT_FIBER_FLAG_TIMED_WAIT;
+}
+
+/**
+  * Utility function to remove the given fiber from the timed wait queue, if it is on it.
+  *
+  * @param f The fiber to remove.
+  */
+static void dequeue_fiber_timed(Fiber *f)
+{
+    if (!(f->flags & MICROBIT_FIBER_FLAG_TIMED_WAIT))
+        return;
+
+    __disable_irq();
+
+    Fiber **p = &timedWaitQueue;
+
+    while (*p != NULL && *p != f)
+        p = &(*p)->timed_next;
+
+    if (*p != NULL)
+        *p = f->timed_next;
+
+    f->timed_next = NULL;
+    f->flags &= ~MICROBIT_FIBER_FLAG_TIMED_WAIT;
+
+    __enable_irq();
+}
+
 /**
   * Utility function to the given fiber from whichever queue it is currently stored on.
   *
@@ -139,6 +497,45 @@ void dequeue_fiber(Fiber *f)
 
 }
 
+/**
+  * Determines the highest priority run queue that holds at least one runnable fiber.
+  *
+  * This is a constant time operation, bounded by MICROBIT_FIBER_PRIORITY_LEVELS rather than
+  * the number of fibers in the system.
+  *
+  * @return the run queue to schedule from next, or NULL if no fibers are runnable.
+  */
+static Fiber **get_runnable_queue()
+{
+    for (int i = MICROBIT_FIBER_PRIORITY_LEVELS - 1; i >= 0; i--)
+        if (runQueue[i] != NULL)
+            return &runQueue[i];
+
+    return NULL;
+}
+
+/**
+  * Determines if the given fiber is currently held on any of the run queues.
+  *
+  * @param f The fiber to test.
+  *
+  * @return true if the fiber is runnable, false otherwise.
+  */
+static inline bool fiber_is_runnable(Fiber *f)
+{
+    return f->queue >= &runQueue[0] && f->queue < &runQueue[MICROBIT_FIBER_PRIORITY_LEVELS];
+}
+
+/**
+  * Utility function to make the given fiber runnable, by adding it to the run queue of its priority.
+  *
+  * @param f The fiber to make runnable.
+  */
+static inline void make_runnable(Fiber *f)
+{
+    queue_fiber(f, &runQueue[f->priority]);
+}
+
 /**
   * Allocates a fiber from the fiber pool if availiable. Otherwise, allocates a new one from the heap.
   */
@@ -169,8 +566,17 @@ Fiber *getFiberContext()
 
     // Ensure this fiber is in suitable state for reuse.
     f->flags = 0;
+    f->priority = MICROBIT_FIBER_PRIORITY_NORMAL;
     f->tcb.stack_base = CORTEX_M0_STACK_BASE;
 
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    memset(f->local, 0, sizeof(f->local));
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+    fiber_reset_statistics(f);
+#endif
+
     return f;
 }
 
@@ -193,16 +599,35 @@ void scheduler_init(EventModel &_messageBus)
 	// This parameter will be NULL if we're being run without a message bus.
 	messageBus = &_messageBus;
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+    stack_pool_init();
+#endif
+
     // Create a new fiber context
     currentFiber = getFiberContext();
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS)
+    // The main fiber keeps the system stack. Interrupts move onto their own stack from here on.
+    currentFiber->stack_bottom = MICROBIT_HEAP_END;
+    currentFiber->stack_top = CORTEX_M0_STACK_BASE;
+    *((uint32_t *)currentFiber->stack_bottom) = MICROBIT_FIBER_STACK_GUARD;
+
+    fiber_enable_process_stack();
+#endif
+
     // Add ourselves to the run queue.
-    queue_fiber(currentFiber, &runQueue);
+    make_runnable(currentFiber);
 
     // Create the IDLE fiber.
     // Configure the fiber to directly enter the idle task.
     idleFiber = getFiberContext();
-    idleFiber->tcb.SP = CORTEX_M0_STACK_BASE - 0x04;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS)
+    if (fiber_allocate_stack(idleFiber) != MICROBIT_OK)
+        microbit_panic(MICROBIT_OOM);
+#endif
+
+    idleFiber->tcb.SP = FIBER_INITIAL_SP(idleFiber);
     idleFiber->tcb.LR = (uint32_t) &idle_task;
 
 	if (messageBus)
@@ -231,6 +656,18 @@ int fiber_scheduler_running()
 	return 0;
 }
 
+/**
+  * Determines if the calling code is running in the idle thread, such as from an idleTick() callback.
+  *
+  * The idle thread is restarted rather than resumed when it is next scheduled, so it must never block.
+  *
+  * @return 1 if running in the idle thread, 0 otherwise.
+  */
+int fiber_is_idle()
+{
+    return (currentFiber != NULL && currentFiber == idleFiber) ? 1 : 0;
+}
+
 /**
   * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
   * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
@@ -241,41 +678,85 @@ void scheduler_tick()
     Fiber *f = sleepQueue;
     Fiber *t;
 
+    // Nothing is sleeping, so there's nothing to do.
+    if (f == NULL && timedWaitQueue == NULL)
+        return;
+
+    uint64_t now = system_timer_current_time();
+
     // Check the sleep queue, and wake up any fibers as necessary.
-    while (f != NULL)
+    // The queue is held in order of wake time, so we can stop at the first fiber that isn't yet due.
+    while (f != NULL && now >= f->context)
     {
         t = f->next;
 
-        if (system_timer_current_time() >= f->context)
-        {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
-        }
+        // Wakey wakey!
+        dequeue_fiber(f);
+        make_runnable(f);
 
         f = t;
     }
+
+    // Give up on any timed waits that have expired. These fibers are still held on an event wait queue.
+    while (timedWaitQueue != NULL && now >= timedWaitQueue->wake_time)
+    {
+        f = timedWaitQueue;
+        timedWaitQueue = f->timed_next;
+
+        f->timed_next = NULL;
+        f->flags = (f->flags & ~MICROBIT_FIBER_FLAG_TIMED_WAIT) | MICROBIT_FIBER_FLAG_TIMED_OUT;
+
+        dequeue_fiber(f);
+        make_runnable(f);
+    }
 }
 
 /**
-  * Event callback. Called from an instance of MicroBitMessageBus whenever an event is raised.
+  * Determines the time at which the next fiber blocked in fiber_sleep() or a timed wait is due to be woken.
   *
-  * This function checks to determine if any fibers blocked on the wait queue need to be woken up
-  * and made runnable due to the event.
+  * This allows power management code to determine how long the processor may safely sleep for.
   *
-  * @param evt the event that has just been raised on an instance of MicroBitMessageBus.
+  * @return the time (in milliseconds since power on) of the earliest pending wake up, or 0 if no fibers are sleeping.
   */
-void scheduler_event(MicroBitEvent evt)
+uint32_t scheduler_next_wakeup()
 {
-    Fiber *f = waitQueue;
-    Fiber *t;
-    int notifyOneComplete = 0;
+    Fiber *f = sleepQueue;
+    Fiber *t = timedWaitQueue;
 
-	// This should never happen.
-	// It is however, safe to simply ignore any events provided, as if no messageBus if recorded,
-	// no fibers are permitted to block on events.
-	if (messageBus == NULL)
-		return;
+    if (t != NULL && (f == NULL || t->wake_time < f->context))
+        return t->wake_time;
+
+    return f == NULL ? 0 : f->context;
+}
+
+/**
+  * Determines the wait queue bucket used to hold fibers blocked on the given event ID.
+  *
+  * @param id The event ID being waited on.
+  *
+  * @return The wait queue holding fibers blocked on that ID.
+  */
+static inline Fiber **get_wait_queue(uint16_t id)
+{
+    if (id == MICROBIT_ID_ANY)
+        return &waitQueue[MICROBIT_FIBER_WAIT_QUEUE_BUCKETS];
+
+    return &waitQueue[id % MICROBIT_FIBER_WAIT_QUEUE_BUCKETS];
+}
+
+/**
+  * Wakes any fibers on the given wait queue that are blocked on the given event.
+  *
+  * @param queue The wait queue bucket to scan.
+  *
+  * @param evt The event that has just been raised.
+  *
+  * @param notifyOneComplete Set to 1 once a fiber has been woken by a MICROBIT_ID_NOTIFY_ONE event.
+  */
+static void wake_waiting_fibers(Fiber **queue, MicroBitEvent &evt, int &notifyOneComplete)
+{
+    Fiber *f = *queue;
+    Fiber *t;
 
     // Check the wait queue, and wake up any fibers as necessary.
     while (f != NULL)
@@ -293,21 +774,53 @@ void scheduler_event(MicroBitEvent evt)
             {
                 // Wakey wakey!
                 dequeue_fiber(f);
-                queue_fiber(f,&runQueue);
+                dequeue_fiber_timed(f);
+                make_runnable(f);
                 notifyOneComplete = 1;
             }
         }
 
-        // Normal case.
-        else if ((id == MICROBIT_ID_ANY || id == evt.source) && (value == MICROBIT_EVT_ANY || value == evt.value))
-        {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
-        }
+        // Normal case.
+        else if ((id == MICROBIT_ID_ANY || id == evt.source) && (value == MICROBIT_EVT_ANY || value == evt.value))
+        {
+            // Wakey wakey!
+            dequeue_fiber(f);
+            dequeue_fiber_timed(f);
+            make_runnable(f);
+        }
+
+        f = t;
+    }
+}
+
+/**
+  * Event callback. Called from an instance of MicroBitMessageBus whenever an event is raised.
+  *
+  * This function checks to determine if any fibers blocked on the wait queue need to be woken up
+  * and made runnable due to the event.
+  *
+  * @param evt the event that has just been raised on an instance of MicroBitMessageBus.
+  */
+void scheduler_event(MicroBitEvent evt)
+{
+    int notifyOneComplete = 0;
+
+	// This should never happen.
+	// It is however, safe to simply ignore any events provided, as if no messageBus if recorded,
+	// no fibers are permitted to block on events.
+	if (messageBus == NULL)
+		return;
+
+    // Only inspect those fibers that could possibly match this event: those blocked on its ID...
+    Fiber **queue = get_wait_queue(evt.source);
+    wake_waiting_fibers(queue, evt, notifyOneComplete);
 
-        f = t;
-    }
+    // ... those blocked on the NOTIFY channel, if this is a NOTIFY_ONE event...
+    if (evt.source == MICROBIT_ID_NOTIFY_ONE && get_wait_queue(MICROBIT_ID_NOTIFY) != queue)
+        wake_waiting_fibers(get_wait_queue(MICROBIT_ID_NOTIFY), evt, notifyOneComplete);
+
+    // ... and those blocked on any event.
+    wake_waiting_fibers(get_wait_queue(MICROBIT_ID_ANY), evt, notifyOneComplete);
 
     // Unregister this event, as we've woken up all the fibers with this match.
     if (evt.source != MICROBIT_ID_NOTIFY && evt.source != MICROBIT_ID_NOTIFY_ONE)
@@ -316,26 +829,15 @@ void scheduler_event(MicroBitEvent evt)
 
 
 /**
-  * Blocks the calling thread for the given period of time.
-  * The calling thread will be immediateley descheduled, and placed onto a
-  * wait queue until the requested amount of time has elapsed.
-  *
-  * @param t The period of time to sleep, in milliseconds.
+  * Deschedules the calling thread, and places it onto the sleep queue until the given system time.
+  * The scheduler is always entered, even if the time has already passed, so that other fibers may run.
   *
-  * @note the fiber will not be be made runnable until after the elapsed time, but there
-  * are no guarantees precisely when the fiber will next be scheduled.
+  * @param deadline The system time to wake at, in milliseconds.
   */
-void fiber_sleep(unsigned long t)
+static void fiber_sleep_deadline(uint64_t deadline)
 {
     Fiber *f = currentFiber;
 
-    // If the scheduler is not running, then simply perform a spin wait and exit.
-    if (!fiber_scheduler_running())
-    {
-        wait_ms(t);
-        return;
-    }
-
     // Sleep is a blocking call, so if we're in a fork on block context,
     // it's time to spawn a new fiber...
     if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
@@ -347,22 +849,82 @@ void fiber_sleep(unsigned long t)
         // If we're out of memory, there's nothing we can do.
         // keep running in the context of the current thread as a best effort.
         if (forkedFiber != NULL)
-                f = forkedFiber;
+        {
+            forkedFiber->priority = fob_priority;
+            f = forkedFiber;
+        }
     }
 
-    // Calculate and store the time we want to wake up.
-    f->context = system_timer_current_time() + t;
+    // Store the time we want to wake up.
+    f->context = deadline;
 
     // Remove fiber from the run queue
     dequeue_fiber(f);
 
     // Add fiber to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &sleepQueue);
+    queue_fiber_sleeping(f);
+
+    // If we're now the first fiber due to wake, the system tick may need to come sooner.
+    if (sleepQueue == f)
+        system_timer_governor_update();
 
     // Finally, enter the scheduler.
     schedule();
 }
 
+/**
+  * Blocks the calling thread for the given period of time.
+  * The calling thread will be immediateley descheduled, and placed onto a
+  * wait queue until the requested amount of time has elapsed.
+  *
+  * @param t The period of time to sleep, in milliseconds.
+  *
+  * @note the fiber will not be be made runnable until after the elapsed time, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+void fiber_sleep(unsigned long t)
+{
+    // If the scheduler is not running, then simply perform a spin wait and exit.
+    if (!fiber_scheduler_running())
+    {
+        wait_ms(t);
+        return;
+    }
+
+    fiber_sleep_deadline(system_timer_current_time() + t);
+}
+
+/**
+  * Blocks the calling thread until the given system time.
+  * The calling thread will be immediateley descheduled, and placed onto a
+  * wait queue until the requested time is reached.
+  *
+  * Unlike fiber_sleep(), the wake time does not depend upon when this call is made, so loops
+  * that sleep until a fixed series of deadlines do not drift.
+  *
+  * @param deadline The system time to wake at, in milliseconds (as given by system_timer_current_time()).
+  *                 If this time has already passed, the call returns immediately.
+  *
+  * @note the fiber will not be be made runnable until after the given time, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+void fiber_sleep_until(uint64_t deadline)
+{
+    uint64_t now = system_timer_current_time();
+
+    if (deadline <= now)
+        return;
+
+    // If the scheduler is not running, then simply perform a spin wait and exit.
+    if (!fiber_scheduler_running())
+    {
+        wait_ms(deadline - now);
+        return;
+    }
+
+    fiber_sleep_deadline(deadline);
+}
+
 /**
   * Blocks the calling thread until the specified event is raised.
   * The calling thread will be immediateley descheduled, and placed onto a
@@ -391,6 +953,63 @@ int fiber_wait_for_event(uint16_t id, uint16_t value)
 	return ret;
 }
 
+/**
+  * Blocks the calling thread until the specified event is raised, or the given period of time has elapsed,
+  * whichever happens first.
+  *
+  * @param id The ID field of the event to listen for (e.g. MICROBIT_ID_RADIO)
+  *
+  * @param value The value of the event to listen for (e.g. MICROBIT_RADIO_EVT_DATAGRAM)
+  *
+  * @param timeout The maximum period of time to wait, in milliseconds.
+  *
+  * @return MICROBIT_OK if the event was raised, MICROBIT_TIMEOUT if the period elapsed first,
+  *         or MICROBIT_NOT_SUPPORTED if the fiber scheduler is not running, or associated with an EventModel.
+  *
+  * @code
+  * if (fiber_wait_for_event_timeout(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM, 50) == MICROBIT_TIMEOUT)
+  *     retry();
+  * @endcode
+  *
+  * @note the fiber will not be be made runnable until after the event is raised or the time has elapsed, but there
+  * are no guarantees precisely when the fiber will next be scheduled.
+  */
+int fiber_wait_for_event_timeout(uint16_t id, uint16_t value, uint32_t timeout)
+{
+    int ret = fiber_wake_on_event(id, value);
+
+    if (ret != MICROBIT_OK)
+        return ret;
+
+    // If we were in a fork on block context, we are now the forked fiber.
+    Fiber *f = currentFiber;
+
+    f->flags &= ~MICROBIT_FIBER_FLAG_TIMED_OUT;
+    f->wake_time = system_timer_current_time() + timeout;
+
+    // Also place ourselves on the timed wait queue, unless the event has already woken us.
+    __disable_irq();
+
+    if (f->queue == get_wait_queue(id))
+        queue_fiber_timed(f);
+
+    __enable_irq();
+
+    // If we're now the first fiber due to wake, the system tick may need to come sooner.
+    if (timedWaitQueue == f)
+        system_timer_governor_update();
+
+    schedule();
+
+    if (f->flags & MICROBIT_FIBER_FLAG_TIMED_OUT)
+    {
+        f->flags &= ~MICROBIT_FIBER_FLAG_TIMED_OUT;
+        return MICROBIT_TIMEOUT;
+    }
+
+    return MICROBIT_OK;
+}
+
 /**
   * Configures the fiber context for the current fiber to block on an event ID
   * and value, but does not deschedule the fiber.
@@ -429,9 +1048,10 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
         // keep running in the context of the current thread as a best effort.
         if (forkedFiber != NULL)
         {
+            forkedFiber->priority = fob_priority;
             f = forkedFiber;
             dequeue_fiber(f);
-            queue_fiber(f, &runQueue);
+            make_runnable(f);
             schedule();
         }
     }
@@ -443,7 +1063,7 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
     dequeue_fiber(f);
 
     // Add ourselves to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &waitQueue);
+    queue_fiber(f, get_wait_queue(id));
 
     // Register to receive this event, so we can wake up the fiber when it happens.
     // Special case for the notify channel, as we always stay registered for that.
@@ -466,7 +1086,7 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
   *
   * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
   */
-int invoke(void (*entry_fn)(void))
+int invoke(void (*entry_fn)(void), int priority)
 {
     // Validate our parameters.
     if (entry_fn == NULL)
@@ -475,11 +1095,15 @@ int invoke(void (*entry_fn)(void))
     if (!fiber_scheduler_running())
 		return MICROBIT_NOT_SUPPORTED;
 
-    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+    if (priority < MICROBIT_FIBER_PRIORITY_LOW || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB || CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS))
     {
         // If we attempt a fork on block whilst already in  fork n block context,
         // simply launch a fiber to deal with the request and we're done.
-        create_fiber(entry_fn);
+        // Fork on block cannot be used with dedicated stacks, so always launch a fiber in that mode.
+        create_fiber(entry_fn, release_fiber, priority);
         return MICROBIT_OK;
     }
 
@@ -502,6 +1126,7 @@ int invoke(void (*entry_fn)(void))
     // Otherwise, we're here for the first time. Enter FORK ON BLOCK mode, and
     // execute the function directly. If the code tries to block, we detect this and
     // spawn a thread to deal with it.
+    fob_priority = priority;
     currentFiber->flags |= MICROBIT_FIBER_FLAG_FOB;
     entry_fn();
     currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
@@ -529,7 +1154,7 @@ int invoke(void (*entry_fn)(void))
   *
   * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
   */
-int invoke(void (*entry_fn)(void *), void *param)
+int invoke(void (*entry_fn)(void *), void *param, int priority)
 {
     // Validate our parameters.
     if (entry_fn == NULL)
@@ -538,11 +1163,15 @@ int invoke(void (*entry_fn)(void *), void *param)
     if (!fiber_scheduler_running())
 		return MICROBIT_NOT_SUPPORTED;
 
-    if (currentFiber->flags & (MICROBIT_FIBER_FLAG_FOB | MICROBIT_FIBER_FLAG_PARENT | MICROBIT_FIBER_FLAG_CHILD))
+    if (priority < MICROBIT_FIBER_PRIORITY_LOW || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (currentFiber->flags & (MICROBIT_FIBER_FLAG_FOB | MICROBIT_FIBER_FLAG_PARENT | MICROBIT_FIBER_FLAG_CHILD) || CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS))
     {
         // If we attempt a fork on block whilst already in a fork on block context,
         // simply launch a fiber to deal with the request and we're done.
-        create_fiber(entry_fn, param);
+        // Fork on block cannot be used with dedicated stacks, so always launch a fiber in that mode.
+        create_fiber(entry_fn, param, release_fiber, priority);
         return MICROBIT_OK;
     }
 
@@ -565,6 +1194,7 @@ int invoke(void (*entry_fn)(void *), void *param)
     // Otherwise, we're here for the first time. Enter FORK ON BLOCK mode, and
     // execute the function directly. If the code tries to block, we detect this and
     // spawn a thread to deal with it.
+    fob_priority = priority;
     currentFiber->flags |= MICROBIT_FIBER_FLAG_FOB;
     entry_fn(param);
     currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
@@ -617,71 +1247,343 @@ void launch_new_fiber_param(void (*ep)(void *), void (*cp)(void *), void *pm)
     release_fiber(pm);
 }
 
-Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised)
+Fiber *__create_fiber(uint32_t ep, uint32_t cp, uint32_t pm, int parameterised, int priority)
 {
     // Validate our parameters.
-    if (ep == 0 || cp == 0)
+    if (ep == 0 || cp == 0 || priority < MICROBIT_FIBER_PRIORITY_LOW || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
         return NULL;
 
     // Allocate a TCB from the new fiber. This will come from the fiber pool if availiable,
     // else a new one will be allocated on the heap.
     Fiber *newFiber = getFiberContext();
 
-    // If we're out of memory, there's nothing we can do.
-    if (newFiber == NULL)
-        return NULL;
+    // If we're out of memory, there's nothing we can do.
+    if (newFiber == NULL)
+        return NULL;
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS)
+    // Every fiber needs a stack of its own to execute on. If we can't have one, return the context to the pool.
+    if (fiber_allocate_stack(newFiber) != MICROBIT_OK)
+    {
+        queue_fiber(newFiber, &fiberPool);
+        return NULL;
+    }
+#elif CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+    // Assign a preallocated stack to any fiber that doesn't already have one, so that the first
+    // time this fiber is paged out doesn't need to touch the heap.
+    if (newFiber->stack_bottom == 0)
+    {
+        uint32_t bufferSize = 0;
+
+        newFiber->stack_bottom = stack_pool_allocate(0, &bufferSize);
+        newFiber->stack_top = newFiber->stack_bottom + bufferSize;
+    }
+#endif
+
+    newFiber->tcb.R0 = (uint32_t) ep;
+    newFiber->tcb.R1 = (uint32_t) cp;
+    newFiber->tcb.R2 = (uint32_t) pm;
+    newFiber->priority = priority;
+
+    // Set the stack and assign the link register to refer to the appropriate entry point wrapper.
+    newFiber->tcb.SP = FIBER_INITIAL_SP(newFiber);
+    newFiber->tcb.LR = parameterised ? (uint32_t) &launch_new_fiber_param : (uint32_t) &launch_new_fiber;
+
+    // Add new fiber to the run queue.
+    make_runnable(newFiber);
+
+    return newFiber;
+}
+
+/**
+  * Creates a new Fiber, and launches it.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void), int priority)
+{
+    if (!fiber_scheduler_running())
+		return NULL;
+
+    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, 0, 0, priority);
+}
+
+
+/**
+  * Creates a new parameterised Fiber, and launches it.
+  *
+  * @param entry_fn The function the new Fiber will begin execution in.
+  *
+  * @param param an untyped parameter passed into the entry_fn and completion_fn.
+  *
+  * @param completion_fn The function called when the thread completes execution of entry_fn.
+  *                      Defaults to release_fiber.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *), int priority)
+{
+    if (!fiber_scheduler_running())
+		return NULL;
+
+    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, (uint32_t) param, 1, priority);
+}
+
+/*
+ * The state of a fiber created by create_periodic_fiber().
+ */
+struct FiberPeriodicTask
+{
+    void (*entry_fn)(void);             // The function to call, if unparameterised.
+    void (*entry_fn_param)(void *);     // The function to call, if parameterised.
+    void *param;                        // The parameter to pass to entry_fn_param.
+    unsigned long period;               // The time between calls, in milliseconds.
+};
+
+/**
+  * Entry point of all periodic fibers. Calls the task's function once per period, forever.
+  *
+  * Each deadline is calculated from the previous deadline rather than the time the function completed,
+  * so the period does not drift. If the function overruns, any missed periods are skipped.
+  *
+  * @param param The FiberPeriodicTask to run.
+  */
+static void periodic_fiber_entry(void *param)
+{
+    FiberPeriodicTask *task = (FiberPeriodicTask *) param;
+    uint64_t deadline = system_timer_current_time();
+
+    while (1)
+    {
+        if (task->entry_fn_param)
+            task->entry_fn_param(task->param);
+        else
+            task->entry_fn();
+
+        deadline += task->period;
+
+        uint64_t now = system_timer_current_time();
+
+        if (deadline <= now)
+            deadline += ((now - deadline) / task->period + 1) * task->period;
+
+        fiber_sleep_until(deadline);
+    }
+}
+
+/**
+  * Creates a new Fiber that calls the given function once per period, forever.
+  *
+  * Calls are scheduled against a fixed period from when the fiber starts, so they do not drift
+  * however long the function takes to complete. If a call overruns, any missed periods are skipped.
+  *
+  * @param entry_fn The function to call once per period.
+  *
+  * @param period The time between each call, in milliseconds.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *create_periodic_fiber(void (*entry_fn)(void), unsigned long period, int priority)
+{
+    if (entry_fn == NULL || period == 0 || !fiber_scheduler_running())
+        return NULL;
+
+    FiberPeriodicTask *task = new FiberPeriodicTask();
+
+    if (task == NULL)
+        return NULL;
+
+    task->entry_fn = entry_fn;
+    task->entry_fn_param = NULL;
+    task->param = NULL;
+    task->period = period;
+
+    Fiber *f = create_fiber(periodic_fiber_entry, task, release_fiber, priority);
+
+    if (f == NULL)
+        delete task;
+
+    return f;
+}
+
+/**
+  * Creates a new parameterised Fiber that calls the given function once per period, forever.
+  *
+  * Calls are scheduled against a fixed period from when the fiber starts, so they do not drift
+  * however long the function takes to complete. If a call overruns, any missed periods are skipped.
+  *
+  * @param entry_fn The function to call once per period.
+  *
+  * @param param an untyped parameter passed into entry_fn.
+  *
+  * @param period The time between each call, in milliseconds.
+  *
+  * @param priority The scheduling priority of the new Fiber. Defaults to MICROBIT_FIBER_PRIORITY_NORMAL.
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+Fiber *create_periodic_fiber(void (*entry_fn)(void *), void *param, unsigned long period, int priority)
+{
+    if (entry_fn == NULL || period == 0 || !fiber_scheduler_running())
+        return NULL;
+
+    FiberPeriodicTask *task = new FiberPeriodicTask();
+
+    if (task == NULL)
+        return NULL;
+
+    task->entry_fn = NULL;
+    task->entry_fn_param = entry_fn;
+    task->param = param;
+    task->period = period;
+
+    Fiber *f = create_fiber(periodic_fiber_entry, task, release_fiber, priority);
+
+    if (f == NULL)
+        delete task;
+
+    return f;
+}
+
+/**
+  * Changes the scheduling priority of the given Fiber.
+  *
+  * If the fiber is currently runnable, it is moved to the tail of the run queue for its new priority.
+  *
+  * @param f The fiber to update, or NULL to update the currently running fiber.
+  *
+  * @param priority The new priority, in the range MICROBIT_FIBER_PRIORITY_LOW..MICROBIT_FIBER_PRIORITY_CRITICAL.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the priority is out of range.
+  */
+int fiber_set_priority(Fiber *f, int priority)
+{
+    if (priority < MICROBIT_FIBER_PRIORITY_LOW || priority >= MICROBIT_FIBER_PRIORITY_LEVELS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (f == NULL)
+        f = currentFiber;
+
+    if (f == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (f->priority == priority)
+        return MICROBIT_OK;
+
+    // If the fiber is runnable, move it onto the run queue of its new priority.
+    if (fiber_is_runnable(f))
+    {
+        dequeue_fiber(f);
+        f->priority = priority;
+        make_runnable(f);
+    }
+    else
+    {
+        f->priority = priority;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the scheduling priority of the given Fiber.
+  *
+  * @param f The fiber to query, or NULL to query the currently running fiber.
+  *
+  * @return The priority of the fiber.
+  */
+int fiber_get_priority(Fiber *f)
+{
+    if (f == NULL)
+        f = currentFiber;
+
+    if (f == NULL)
+        return MICROBIT_FIBER_PRIORITY_NORMAL;
 
-    newFiber->tcb.R0 = (uint32_t) ep;
-    newFiber->tcb.R1 = (uint32_t) cp;
-    newFiber->tcb.R2 = (uint32_t) pm;
+    return f->priority;
+}
 
-    // Set the stack and assign the link register to refer to the appropriate entry point wrapper.
-    newFiber->tcb.SP = CORTEX_M0_STACK_BASE - 0x04;
-    newFiber->tcb.LR = parameterised ? (uint32_t) &launch_new_fiber_param : (uint32_t) &launch_new_fiber;
+/**
+  * Allocates a fiber local storage key. Each fiber holds its own value for each key, which is initially NULL.
+  *
+  * @param destructor An optional function, called with the value held by a fiber for this key when that fiber
+  *                   completes, if the value is not NULL. Useful for releasing per fiber buffers.
+  *
+  * @return The new key, or MICROBIT_NO_RESOURCES if all MICROBIT_FIBER_LOCAL_STORAGE_SLOTS keys are in use.
+  */
+int fiber_local_key_create(void (*destructor)(void *))
+{
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    if (fiberLocalKeys >= MICROBIT_FIBER_LOCAL_STORAGE_SLOTS)
+        return MICROBIT_NO_RESOURCES;
 
-    // Add new fiber to the run queue.
-    queue_fiber(newFiber, &runQueue);
+    fiberLocalDestructors[fiberLocalKeys] = destructor;
 
-    return newFiber;
+    return fiberLocalKeys++;
+#else
+    (void) destructor;
+    return MICROBIT_NO_RESOURCES;
+#endif
 }
 
 /**
-  * Creates a new Fiber, and launches it.
+  * Sets the value held by the currently running fiber for the given fiber local storage key.
   *
-  * @param entry_fn The function the new Fiber will begin execution in.
+  * @param key A key previously returned by fiber_local_key_create().
   *
-  * @param completion_fn The function called when the thread completes execution of entry_fn.
-  *                      Defaults to release_fiber.
+  * @param value The value to store.
   *
-  * @return The new Fiber, or NULL if the operation could not be completed.
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is not valid,
+  *         or MICROBIT_NOT_SUPPORTED if the scheduler is not running.
   */
-Fiber *create_fiber(void (*entry_fn)(void), void (*completion_fn)(void))
+int fiber_local_set(int key, void *value)
 {
-    if (!fiber_scheduler_running())
-		return NULL;
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    if (key < 0 || key >= fiberLocalKeys)
+        return MICROBIT_INVALID_PARAMETER;
 
-    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, 0, 0);
-}
+    if (currentFiber == NULL)
+        return MICROBIT_NOT_SUPPORTED;
 
+    currentFiber->local[key] = value;
+
+    return MICROBIT_OK;
+#else
+    (void) key;
+    (void) value;
+    return MICROBIT_INVALID_PARAMETER;
+#endif
+}
 
 /**
-  * Creates a new parameterised Fiber, and launches it.
-  *
-  * @param entry_fn The function the new Fiber will begin execution in.
+  * Determines the value held by the currently running fiber for the given fiber local storage key.
   *
-  * @param param an untyped parameter passed into the entry_fn and completion_fn.
-  *
-  * @param completion_fn The function called when the thread completes execution of entry_fn.
-  *                      Defaults to release_fiber.
+  * @param key A key previously returned by fiber_local_key_create().
   *
-  * @return The new Fiber, or NULL if the operation could not be completed.
+  * @return The value stored, or NULL if no value has been stored, the key is not valid or the scheduler is not running.
   */
-Fiber *create_fiber(void (*entry_fn)(void *), void *param, void (*completion_fn)(void *))
+void *fiber_local_get(int key)
 {
-    if (!fiber_scheduler_running())
-		return NULL;
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    if (key < 0 || key >= fiberLocalKeys || currentFiber == NULL)
+        return NULL;
 
-    return __create_fiber((uint32_t) entry_fn, (uint32_t)completion_fn, (uint32_t) param, 1);
+    return currentFiber->local[key];
+#else
+    (void) key;
+    return NULL;
+#endif
 }
 
 /**
@@ -707,6 +1609,17 @@ void release_fiber(void)
     if (!fiber_scheduler_running())
 		return;
 
+#if MICROBIT_FIBER_LOCAL_STORAGE_SLOTS > 0
+    // Release any fiber local storage still held by this fiber.
+    for (int i = 0; i < fiberLocalKeys; i++)
+    {
+        if (currentFiber->local[i] != NULL && fiberLocalDestructors[i] != NULL)
+            fiberLocalDestructors[i](currentFiber->local[i]);
+
+        currentFiber->local[i] = NULL;
+    }
+#endif
+
     // Remove ourselves form the runqueue.
     dequeue_fiber(currentFiber);
 
@@ -739,9 +1652,28 @@ void verify_stack_size(Fiber *f)
     // Calculate the size of our allocated stack buffer
     bufferSize = f->stack_top - f->stack_bottom;
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+    if (stackDepth > f->peak_stack)
+        f->peak_stack = stackDepth;
+#endif
+
     // If we're too small, increase our buffer size.
     if (bufferSize < stackDepth)
     {
+#if CONFIG_ENABLED(MICROBIT_FIBER_STACK_POOL)
+        // Release the old memory, back to whichever pool it came from.
+        if (f->stack_bottom != 0)
+            stack_pool_release(f->stack_bottom);
+
+        // Prefer a preallocated buffer. Only fall back to the heap if no buffer is large enough.
+        f->stack_bottom = stack_pool_allocate(stackDepth, &bufferSize);
+
+        if (f->stack_bottom == 0)
+        {
+            bufferSize = (stackDepth + 32) & 0xffffffe0;
+            f->stack_bottom = (uint32_t) malloc(bufferSize);
+        }
+#else
         // To ease heap churn, we choose the next largest multple of 32 bytes.
         bufferSize = (stackDepth + 32) & 0xffffffe0;
 
@@ -751,6 +1683,7 @@ void verify_stack_size(Fiber *f)
 
         // Allocate a new one of the appropriate size.
         f->stack_bottom = (uint32_t) malloc(bufferSize);
+#endif
 
         // Recalculate where the top of the stack is and we're done.
         f->stack_top = f->stack_bottom + bufferSize;
@@ -764,7 +1697,7 @@ void verify_stack_size(Fiber *f)
   */
 int scheduler_runqueue_empty()
 {
-    return (runQueue == NULL);
+    return (get_runnable_queue() == NULL);
 }
 
 /**
@@ -810,18 +1743,21 @@ void schedule()
         return;
     }
 
-    // We're in a normal scheduling context, so perform a round robin algorithm across runnable fibers.
+    // We're in a normal scheduling context, so perform a round robin algorithm across the runnable fibers
+    // of the highest priority level that has any.
+    Fiber **queue = get_runnable_queue();
+
     // OK - if we've nothing to do, then run the IDLE task (power saving sleep)
-    if (runQueue == NULL)
+    if (queue == NULL)
         currentFiber = idleFiber;
 
-    else if (currentFiber->queue == &runQueue)
-        // If the current fiber is on the run queue, round robin.
-        currentFiber = currentFiber->next == NULL ? runQueue : currentFiber->next;
+    else if (currentFiber->queue == queue)
+        // If the current fiber is on the chosen run queue, round robin.
+        currentFiber = currentFiber->next == NULL ? *queue : currentFiber->next;
 
     else
         // Otherwise, just pick the head of the run queue.
-        currentFiber = runQueue;
+        currentFiber = *queue;
 
     if (currentFiber == idleFiber && oldFiber->flags & MICROBIT_FIBER_FLAG_DO_NOT_PAGE)
     {
@@ -836,24 +1772,34 @@ void schedule()
         {
             idle();
         }
-        while (runQueue == NULL);
+        while (scheduler_runqueue_empty());
 
         // Switch to a non-idle fiber.
         // If this fiber is the same as the old one then there'll be no switching at all.
-        currentFiber = runQueue;
+        currentFiber = *get_runnable_queue();
     }
 
     // Swap to the context of the chosen fiber, and we're done.
     // Don't bother with the overhead of switching if there's only one fiber on the runqueue!
     if (currentFiber != oldFiber)
     {
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+        fiber_trace_switch(oldFiber, currentFiber);
+#endif
+
         // Special case for the idle task, as we don't maintain a stack context (just to save memory).
         if (currentFiber == idleFiber)
         {
-            idleFiber->tcb.SP = CORTEX_M0_STACK_BASE - 0x04;
+            idleFiber->tcb.SP = FIBER_INITIAL_SP(idleFiber);
             idleFiber->tcb.LR = (uint32_t) &idle_task;
         }
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_DEDICATED_STACKS)
+        // Every fiber executes on its own stack, so only the register context needs to be switched.
+        verify_stack_guard(oldFiber);
+
+        swap_context(oldFiber == idleFiber ? NULL : &oldFiber->tcb, &currentFiber->tcb, 0, 0);
+#else
         if (oldFiber == idleFiber)
         {
             // Just swap in the new fiber, and discard changes to stack and register context.
@@ -867,27 +1813,327 @@ void schedule()
             // Schedule in the new fiber.
             swap_context(&oldFiber->tcb, &currentFiber->tcb, oldFiber->stack_top, currentFiber->stack_top);
         }
+#endif
+    }
+}
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_PROFILING)
+/**
+  * Copies the most recent context switches recorded by the scheduler into the given buffer.
+  *
+  * Records are provided oldest first. At most MICROBIT_FIBER_TRACE_BUFFER_SIZE records are retained.
+  *
+  * @param buffer The buffer to fill.
+  *
+  * @param length The maximum number of records to copy into buffer.
+  *
+  * @return The number of records copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL or length is negative.
+  */
+int fiber_get_trace(FiberTraceRecord *buffer, int length)
+{
+    if (buffer == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint32_t end = traceCount;
+    uint32_t available = end < MICROBIT_FIBER_TRACE_BUFFER_SIZE ? end : MICROBIT_FIBER_TRACE_BUFFER_SIZE;
+    uint32_t count = (uint32_t) length < available ? (uint32_t) length : available;
+
+    for (uint32_t i = 0; i < count; i++)
+        buffer[i] = traceBuffer[(end - count + i) % MICROBIT_FIBER_TRACE_BUFFER_SIZE];
+
+    return count;
+}
+
+/**
+  * Resets the per fiber statistics of the given fiber, and optionally clears the scheduler trace buffer.
+  *
+  * @param f The fiber to reset, or NULL to reset only the trace buffer.
+  */
+void fiber_reset_statistics(Fiber *f)
+{
+    if (f == NULL)
+    {
+        traceCount = 0;
+        return;
+    }
+
+    f->switch_count = 0;
+    f->run_time = 0;
+    f->run_start = (uint32_t) system_timer_current_time_us();
+    f->peak_stack = 0;
+}
+
+#if CONFIG_ENABLED(MICROBIT_DBG)
+/**
+  * Diagnostics function. Displays the scheduler trace buffer, and the statistics of
+  * the currently running fiber, through the debug serial port.
+  */
+void fiber_trace_print()
+{
+    FiberTraceRecord trace[MICROBIT_FIBER_TRACE_BUFFER_SIZE];
+    int count = fiber_get_trace(trace, MICROBIT_FIBER_TRACE_BUFFER_SIZE);
+
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("\nFIBER TRACE:\n");
+
+    for (int i = 0; i < count; i++)
+        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("[%lu] %p -> %p\n", (unsigned long) trace[i].timestamp, trace[i].from, trace[i].to);
+
+    if (currentFiber == NULL)
+        return;
+
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("fiber        : %p\n", currentFiber);
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("switch_count : %lu\n", (unsigned long) currentFiber->switch_count);
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("run_time     : %lu\n", (unsigned long) currentFiber->run_time);
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("peak_stack   : %lu\n", (unsigned long) currentFiber->peak_stack);
+}
+#endif
+#endif
+
+/**
+  * Constructor. Create a new FiberSemaphore.
+  *
+  * @param initial The number of units initially available.
+  *
+  * @param max The maximum number of units that may be available. Calls to notify() with no fibers
+  *            waiting do not increase the count beyond this value.
+  */
+FiberSemaphore::FiberSemaphore(int initial, int max)
+{
+    this->max = max;
+    this->count = initial > max ? max : initial;
+    this->queue = NULL;
+}
+
+/**
+  * Acquires a unit from this semaphore, blocking the calling fiber until one is available.
+  *
+  * @return MICROBIT_OK once a unit has been acquired, MICROBIT_CANCELLED if the wait was ended through
+  *         notifyAll(), or MICROBIT_NOT_SUPPORTED if the calling context cannot block (i.e. the scheduler is not
+  *         running, or this is an interrupt context) and no unit is available.
+  */
+int FiberSemaphore::wait()
+{
+    if (tryWait() == MICROBIT_OK)
+        return MICROBIT_OK;
+
+    if (!fiber_scheduler_running() || inInterruptContext())
+        return MICROBIT_NOT_SUPPORTED;
+
+    Fiber *f = currentFiber;
+
+    // Waiting is a blocking call, so if we're in a fork on block context,
+    // it's time to spawn a new fiber...
+    if (currentFiber->flags & MICROBIT_FIBER_FLAG_FOB)
+    {
+        forkedFiber = getFiberContext();
+
+        // If we're out of memory, there's nothing we can do.
+        // keep running in the context of the current thread as a best effort.
+        if (forkedFiber != NULL)
+        {
+            forkedFiber->priority = fob_priority;
+            f = forkedFiber;
+        }
+    }
+
+    // The context field records how the wait ended. notify() overwrites this with MICROBIT_OK on handoff.
+    f->context = (uint32_t) MICROBIT_CANCELLED;
+
+    dequeue_fiber(f);
+    queue_fiber(f, &queue);
+
+    // A unit may have been released between our first attempt and joining the queue. If so, take it now.
+    __disable_irq();
+
+    if (count > 0 && f->queue == &queue)
+    {
+        count--;
+        f->context = MICROBIT_OK;
+
+        // dequeue_fiber() exits with irqs enabled, so no need to do this again!
+        dequeue_fiber(f);
+        make_runnable(f);
+    }
+    else
+    {
+        __enable_irq();
+    }
+
+    schedule();
+
+    return (int) f->context;
+}
+
+/**
+  * Acquires a unit from this semaphore, if one is available. Never blocks.
+  *
+  * @return MICROBIT_OK if a unit was acquired, MICROBIT_BUSY otherwise.
+  */
+int FiberSemaphore::tryWait()
+{
+    __disable_irq();
+
+    if (count > 0)
+    {
+        count--;
+        __enable_irq();
+        return MICROBIT_OK;
+    }
+
+    __enable_irq();
+    return MICROBIT_BUSY;
+}
+
+/**
+  * Releases a unit to this semaphore.
+  *
+  * If any fibers are waiting, the longest waiting fiber of the highest priority is handed the unit and made runnable.
+  * Otherwise, the number of available units is increased, up to the maximum given at construction.
+  */
+void FiberSemaphore::notify()
+{
+    Fiber *f = NULL;
+
+    __disable_irq();
+
+    // The queue is held in order of arrival, so the first fiber found at the highest priority is the longest waiting.
+    for (Fiber *p = queue; p != NULL; p = p->next)
+        if (f == NULL || p->priority > f->priority)
+            f = p;
+
+    if (f == NULL)
+    {
+        if (count < max)
+            count++;
+
+        __enable_irq();
+        return;
+    }
+
+    // Hand the unit directly to the chosen fiber.
+    f->context = MICROBIT_OK;
+
+    // dequeue_fiber() exits with irqs enabled, so no need to do this again!
+    dequeue_fiber(f);
+    make_runnable(f);
+}
+
+/**
+  * Wakes all fibers waiting on this semaphore, without handing them a unit.
+  *
+  * Each woken fiber returns MICROBIT_CANCELLED from wait().
+  */
+void FiberSemaphore::notifyAll()
+{
+    __disable_irq();
+
+    while (queue != NULL)
+    {
+        Fiber *f = queue;
+        f->context = (uint32_t) MICROBIT_CANCELLED;
+
+        dequeue_fiber(f);
+        make_runnable(f);
+
+        __disable_irq();
     }
+
+    __enable_irq();
+}
+
+/**
+  * Determines the number of units currently available.
+  *
+  * @return the number of units available.
+  */
+int FiberSemaphore::getCount()
+{
+    return count;
+}
+
+/**
+  * Determines the number of fibers currently blocked on this semaphore.
+  *
+  * @return the number of waiting fibers.
+  */
+int FiberSemaphore::getWaitCount()
+{
+    int waiting = 0;
+
+    __disable_irq();
+
+    for (Fiber *p = queue; p != NULL; p = p->next)
+        waiting++;
+
+    __enable_irq();
+
+    return waiting;
+}
+
+/**
+  * Constructor. Create a new, unlocked FiberLock.
+  */
+FiberLock::FiberLock() : FiberSemaphore(1, 1)
+{
+}
+
+/**
+  * Determines if this lock is currently held.
+  *
+  * @return 1 if the lock is held, 0 otherwise.
+  */
+int FiberLock::isLocked()
+{
+    return count == 0;
 }
 
 /**
   * Adds a component to the array of idle thread components, which are processed
   * when the run queue is empty.
   *
+  * The array grows as necessary, so is not limited to MICROBIT_IDLE_COMPONENTS entries.
+  *
   * @param component The component to add to the array.
-  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array is full.
+  *
+  * @param mode MICROBIT_IDLE_COMPONENT_POLLED to have the component's idleTick() called every time the processor is idle, or
+  *             MICROBIT_IDLE_COMPONENT_ON_DEMAND to have it called only after fiber_idle_component_pending() has been called
+  *             for this component. Defaults to MICROBIT_IDLE_COMPONENT_POLLED.
+  *
+  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the fiber components array could not be grown.
   */
-int fiber_add_idle_component(MicroBitComponent *component)
+int fiber_add_idle_component(MicroBitComponent *component, int mode)
 {
-    int i = 0;
+    if(idleThreadComponentsCount == idleThreadComponentsCapacity)
+    {
+        int capacity = idleThreadComponentsCapacity + MICROBIT_IDLE_COMPONENTS;
+        IdleComponent *components = (IdleComponent *) malloc(capacity * sizeof(IdleComponent));
 
-    while(idleThreadComponents[i] != NULL && i < MICROBIT_IDLE_COMPONENTS)
-        i++;
+        if(components == NULL)
+            return MICROBIT_NO_RESOURCES;
 
-    if(i == MICROBIT_IDLE_COMPONENTS)
-        return MICROBIT_NO_RESOURCES;
+        // Swap to the larger array atomically, as pending signals may be raised from interrupt context.
+        __disable_irq();
+
+        IdleComponent *old = idleThreadComponents;
+        memcpy(components, old, idleThreadComponentsCount * sizeof(IdleComponent));
+        idleThreadComponents = components;
+        idleThreadComponentsCapacity = capacity;
+
+        __enable_irq();
+
+        if(old != idleThreadComponentsStatic)
+            free(old);
+    }
+
+    __disable_irq();
 
-    idleThreadComponents[i] = component;
+    IdleComponent *c = &idleThreadComponents[idleThreadComponentsCount];
+    c->component = component;
+    c->mode = mode;
+    c->pending = 0;
+    idleThreadComponentsCount++;
+
+    __enable_irq();
 
     return MICROBIT_OK;
 }
@@ -902,31 +2148,82 @@ int fiber_remove_idle_component(MicroBitComponent *component)
 {
     int i = 0;
 
-    while(idleThreadComponents[i] != component && i < MICROBIT_IDLE_COMPONENTS)
+    while(i < idleThreadComponentsCount && idleThreadComponents[i].component != component)
         i++;
 
-    if(i == MICROBIT_IDLE_COMPONENTS)
+    if(i == idleThreadComponentsCount)
         return MICROBIT_INVALID_PARAMETER;
 
-    idleThreadComponents[i] = NULL;
+    // Close the gap, so the idle loop never needs to skip empty entries.
+    __disable_irq();
+
+    idleThreadComponentsCount--;
+    memmove(&idleThreadComponents[i], &idleThreadComponents[i+1], (idleThreadComponentsCount - i) * sizeof(IdleComponent));
+
+    __enable_irq();
 
     return MICROBIT_OK;
 }
 
+/**
+  * Signals that the given idle component has work to do, so that its idleTick() is called the next
+  * time the processor is idle. The signal is cleared once the component has been serviced.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param component The component with work pending.
+  *
+  * @return MICROBIT_OK on success. MICROBIT_INVALID_PARAMETER is returned if the given component has not been previously added.
+  */
+int fiber_idle_component_pending(MicroBitComponent *component)
+{
+    for(int i = 0; i < idleThreadComponentsCount; i++)
+    {
+        if(idleThreadComponents[i].component == component)
+        {
+            idleThreadComponents[i].pending = 1;
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_INVALID_PARAMETER;
+}
+
 /**
   * Set of tasks to perform when idle.
   * Service any background tasks that are required, and attempt a power efficient sleep.
   */
 void idle()
 {
-    // Service background tasks
-    for(int i = 0; i < MICROBIT_IDLE_COMPONENTS; i++)
-        if(idleThreadComponents[i] != NULL)
-            idleThreadComponents[i]->idleTick();
+    // Service background tasks. Pending signals are cleared before each component is serviced,
+    // so any raised whilst it is running will be seen next time round.
+    int i = 0;
+
+    while(i < idleThreadComponentsCount)
+    {
+        IdleComponent *c = &idleThreadComponents[i];
+        MicroBitComponent *component = c->component;
+
+        if(c->mode == MICROBIT_IDLE_COMPONENT_POLLED || c->pending)
+        {
+            c->pending = 0;
+            component->idleTick();
+
+            // If a component was removed from the array during the tick, another may have shifted into this slot.
+            if(i < idleThreadComponentsCount && idleThreadComponents[i].component != component)
+                continue;
+        }
+
+        i++;
+    }
 
     // If the above did create any useful work, enter power efficient sleep.
     if(scheduler_runqueue_empty())
-    	__WFE();
+    {
+        POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_SLEEP, true);
+        __WFE();
+        POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_SLEEP, false);
+    }
 }
 
 /**
@@ -52,6 +52,45 @@ const unsigned char pendolino3[475] = {
 
 
 const unsigned char* MicroBitFont::defaultFont = pendolino3;
+
+/**
+  * Every possible row of a glyph, pre-expanded to one brightness value per pixel.
+  * Indexed by the low MICROBIT_FONT_WIDTH bits of a row of font data.
+  */
+const uint8_t MicroBitFont::rowPixels[MICROBIT_FONT_ROW_PATTERNS][MICROBIT_FONT_WIDTH] = {
+    { 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 255 },
+    { 0, 0, 0, 255, 0 },
+    { 0, 0, 0, 255, 255 },
+    { 0, 0, 255, 0, 0 },
+    { 0, 0, 255, 0, 255 },
+    { 0, 0, 255, 255, 0 },
+    { 0, 0, 255, 255, 255 },
+    { 0, 255, 0, 0, 0 },
+    { 0, 255, 0, 0, 255 },
+    { 0, 255, 0, 255, 0 },
+    { 0, 255, 0, 255, 255 },
+    { 0, 255, 255, 0, 0 },
+    { 0, 255, 255, 0, 255 },
+    { 0, 255, 255, 255, 0 },
+    { 0, 255, 255, 255, 255 },
+    { 255, 0, 0, 0, 0 },
+    { 255, 0, 0, 0, 255 },
+    { 255, 0, 0, 255, 0 },
+    { 255, 0, 0, 255, 255 },
+    { 255, 0, 255, 0, 0 },
+    { 255, 0, 255, 0, 255 },
+    { 255, 0, 255, 255, 0 },
+    { 255, 0, 255, 255, 255 },
+    { 255, 255, 0, 0, 0 },
+    { 255, 255, 0, 0, 255 },
+    { 255, 255, 0, 255, 0 },
+    { 255, 255, 0, 255, 255 },
+    { 255, 255, 255, 0, 0 },
+    { 255, 255, 255, 0, 255 },
+    { 255, 255, 255, 255, 0 },
+    { 255, 255, 255, 255, 255 }
+};
 MicroBitFont MicroBitFont::systemFont = MicroBitFont(defaultFont, MICROBIT_FONT_ASCII_END);
 
 /**
@@ -45,7 +45,7 @@ DEALINGS IN THE SOFTWARE.
   * @note The need for this should be reviewed in the future, if a different memory allocator is
   * made availiable in the mbed platform.
   *
-  * TODO: Consider caching recently freed blocks to improve allocation time.
+  * Allocation uses a next fit policy by default, and caches recently freed blocks to improve allocation time.
   */
 
 #include "MicroBitConfig.h"
@@ -54,6 +54,10 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitCompat.h"
 #include "ErrorNo.h"
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+#include "MicroBitSerial.h"
+#endif
+
 #if CONFIG_ENABLED(MICROBIT_HEAP_ENABLED)
 
 // A list of all active heap regions, and their dimensions in memory.
@@ -61,6 +65,136 @@ HeapDefinition heap[MICROBIT_MAXIMUM_HEAPS] = { };
 uint8_t heap_count = 0;
 extern "C" int __end__;
 
+// The number of allocations that could not be satisfied by any heap.
+static uint32_t heap_failures = 0;
+
+/**
+  * Determines which heap a given block belongs to.
+  *
+  * @param block The index block to locate.
+  *
+  * @return The heap containing the block, or NULL if it is not part of any registered heap.
+  */
+static HeapDefinition *heap_containing(uint32_t *block)
+{
+    for (int i=0; i < heap_count; i++)
+        if (block >= heap[i].heap_start && block < heap[i].heap_end)
+            return &heap[i];
+
+    return NULL;
+}
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+// The size of each small object size class, in blocks (including the index block).
+// These hold 8, 16, 24, 32 and 48 bytes respectively.
+static const uint32_t heap_class_blocks[] = { 3, 5, 7, 9, 13 };
+#define MICROBIT_HEAP_SIZE_CLASS_COUNT  (sizeof(heap_class_blocks) / sizeof(heap_class_blocks[0]))
+
+// Singly linked lists of free blocks of each size class. The link is held in the first word after the index block.
+static uint32_t *heap_class_free[MICROBIT_HEAP_SIZE_CLASS_COUNT] = { };
+
+/**
+  * Determines the size class used to serve an allocation of the given number of blocks.
+  *
+  * @param blocks The number of blocks needed, including the index block.
+  *
+  * @return The index of the smallest size class that can hold the given number of blocks, or -1 if it is too large.
+  */
+static int heap_size_class(uint32_t blocks)
+{
+    for (uint32_t i = 0; i < MICROBIT_HEAP_SIZE_CLASS_COUNT; i++)
+        if (blocks <= heap_class_blocks[i])
+            return i;
+
+    return -1;
+}
+
+/**
+  * Removes a block from the free list of the given size class.
+  *
+  * @param sc The size class to allocate from.
+  *
+  * @return A pointer to the allocated memory, or NULL if the free list is empty.
+  */
+static void *heap_class_pop(int sc)
+{
+    uint32_t *block;
+
+    __disable_irq();
+
+    block = heap_class_free[sc];
+
+    if (block != NULL)
+    {
+        heap_class_free[sc] = (uint32_t *) block[1];
+        *block &= ~MICROBIT_HEAP_BLOCK_CACHED;
+    }
+
+    __enable_irq();
+
+    return block ? block+1 : NULL;
+}
+
+/**
+  * Places the given block on the free list of its size class, if it exactly matches one.
+  *
+  * @param block The index block of the memory being freed.
+  *
+  * @return 1 if the block was placed on a free list, 0 otherwise.
+  */
+static int heap_class_push(uint32_t *block)
+{
+    int sc = heap_size_class(*block);
+
+    if (sc < 0 || heap_class_blocks[sc] != *block)
+        return 0;
+
+    __disable_irq();
+
+    *block |= MICROBIT_HEAP_BLOCK_CACHED;
+    block[1] = (uintptr_t) heap_class_free[sc];
+    heap_class_free[sc] = block;
+
+    __enable_irq();
+
+    return 1;
+}
+
+/**
+  * Returns all blocks held on the size class free lists to their heap, so they can be merged and reused.
+  *
+  * @return 1 if any blocks were released, 0 otherwise.
+  */
+static int heap_class_flush()
+{
+    int released = 0;
+
+    __disable_irq();
+
+    for (uint32_t i = 0; i < MICROBIT_HEAP_SIZE_CLASS_COUNT; i++)
+    {
+        while (heap_class_free[i] != NULL)
+        {
+            uint32_t *block = heap_class_free[i];
+
+            heap_class_free[i] = (uint32_t *) block[1];
+            *block &= ~MICROBIT_HEAP_BLOCK_CACHED;
+
+            HeapDefinition *h = heap_containing(block);
+            h->used -= *block;
+            h->allocations--;
+
+            *block |= MICROBIT_HEAP_BLOCK_FREE;
+            released = 1;
+        }
+    }
+
+    __enable_irq();
+
+    return released;
+}
+#endif
+
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
 // Diplays a usage summary about a given heap...
 void microbit_heap_print(HeapDefinition &heap)
@@ -87,8 +221,8 @@ void microbit_heap_print(HeapDefinition &heap)
 	block = heap.heap_start;
 	while (block < heap.heap_end)
 	{
-		blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
-        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("[%c:%d] ", *block & MICROBIT_HEAP_BLOCK_FREE ? 'F' : 'U', blockSize*MICROBIT_HEAP_BLOCK_SIZE);
+		blockSize = *block & ~(MICROBIT_HEAP_BLOCK_FREE | MICROBIT_HEAP_BLOCK_CACHED);
+        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("[%c:%d] ", *block & MICROBIT_HEAP_BLOCK_FREE ? 'F' : *block & MICROBIT_HEAP_BLOCK_CACHED ? 'C' : 'U', blockSize*MICROBIT_HEAP_BLOCK_SIZE);
         if (cols++ == 20)
         {
             if(SERIAL_DEBUG) SERIAL_DEBUG->printf("\n");
@@ -158,9 +292,22 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     // Record the dimensions of this new heap
     h->heap_start = (uint32_t *)start;
     h->heap_end = (uint32_t *)end;
+    h->used = 0;
+    h->peak = 0;
+    h->allocations = 0;
+    h->generation = 0;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+    h->rover = h->heap_start;
+
+    for (int i = 0; i < MICROBIT_HEAP_HINT_CACHE_SIZE; i++)
+        h->hint[i] = NULL;
+
+    h->hint_next = 0;
+#endif
 
     // Initialise the heap as being completely empty and available for use.
-    *h->heap_start = MICROBIT_HEAP_BLOCK_FREE | (((uint32_t) h->heap_end - (uint32_t) h->heap_start) / MICROBIT_HEAP_BLOCK_SIZE);
+    *h->heap_start = MICROBIT_HEAP_BLOCK_FREE | (((uintptr_t) h->heap_end - (uintptr_t) h->heap_start) / MICROBIT_HEAP_BLOCK_SIZE);
     heap_count++;
 
 	// Enable Interrupts
@@ -173,39 +320,110 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     return MICROBIT_OK;
 }
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
 /**
-  * Attempt to allocate a given amount of memory from a given heap area.
+  * Updates the roving pointer and free block hints of a heap, following the merge of one free block into another.
   *
-  * @param size The amount of memory, in bytes, to allocate.
-  * @param heap The heap to allocate memory from.
+  * @param heap The heap containing the blocks.
   *
-  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  * @param absorbed The index block that no longer exists.
+  *
+  * @param block The index block of the free block it was merged into.
   */
-void *microbit_malloc(size_t size, HeapDefinition &heap)
+static void heap_forget(HeapDefinition &heap, uint32_t *absorbed, uint32_t *block)
 {
-	uint32_t	blockSize = 0;
-	uint32_t	blocksNeeded = size % MICROBIT_HEAP_BLOCK_SIZE == 0 ? size / MICROBIT_HEAP_BLOCK_SIZE : size / MICROBIT_HEAP_BLOCK_SIZE + 1;
-	uint32_t	*block;
-	uint32_t	*next;
+    if (heap.rover == absorbed)
+        heap.rover = block;
 
-	if (size <= 0)
-		return NULL;
+    for (int i = 0; i < MICROBIT_HEAP_HINT_CACHE_SIZE; i++)
+        if (heap.hint[i] == absorbed)
+            heap.hint[i] = NULL;
+}
 
-	// Account for the index block;
-	blocksNeeded++;
+/**
+  * Looks for a recently freed block that is large enough to hold the given number of blocks.
+  *
+  * @param heap The heap to search.
+  *
+  * @param blocksNeeded The number of blocks needed, including the index block.
+  *
+  * @return The index block of a suitable free block, or NULL if none of the hints are suitable.
+  */
+static uint32_t *heap_hint_lookup(HeapDefinition &heap, uint32_t blocksNeeded)
+{
+    for (int i = 0; i < MICROBIT_HEAP_HINT_CACHE_SIZE; i++)
+    {
+        uint32_t *block = heap.hint[i];
 
-	// Disable IRQ temporarily to ensure no race conditions!
-    __disable_irq();
+        if (block == NULL)
+            continue;
 
-	// We implement a first fit algorithm with cache to handle rapid churn...
-    // We also defragment free blocks as we search, to optimise this and future searches.
-	block = heap.heap_start;
-	while (block < heap.heap_end)
+        // Discard hints for blocks that have since been allocated.
+        if (!(*block & MICROBIT_HEAP_BLOCK_FREE))
+        {
+            heap.hint[i] = NULL;
+            continue;
+        }
+
+        if ((*block & ~MICROBIT_HEAP_BLOCK_FREE) >= blocksNeeded)
+        {
+            heap.hint[i] = NULL;
+            return block;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+// Returned by heap_search() if the heap was changed by an interrupt handler while the search was in progress.
+#define MICROBIT_HEAP_SEARCH_RESTART    ((uint32_t *) 1)
+
+/**
+  * Searches a range of a heap for a free block large enough to hold the given number of blocks.
+  * Adjacent free blocks are merged as we search, to optimise this and future searches.
+  *
+  * Must be called with interrupts disabled. To bound interrupt latency, interrupts are briefly re-enabled
+  * every MICROBIT_HEAP_SEARCH_BATCH blocks. If an interrupt handler changes the layout of the heap in that time
+  * (by allocating memory), our position may no longer be valid, and the search is abandoned.
+  *
+  * @param heap The heap to search.
+  *
+  * @param block The index block to start searching from.
+  *
+  * @param end The address at which to stop searching.
+  *
+  * @param blocksNeeded The number of blocks needed, including the index block.
+  *
+  * @return The index block of a suitable free block, NULL if there is none in the given range,
+  *         or MICROBIT_HEAP_SEARCH_RESTART if the search must be restarted.
+  */
+static uint32_t *heap_search(HeapDefinition &heap, uint32_t *block, uint32_t *end, uint32_t blocksNeeded)
+{
+	uint32_t	blockSize;
+	uint32_t	*next;
+    int         visited = 0;
+
+	while (block < end)
 	{
+        // Give any pending interrupts a chance to run. We hold no state in the heap itself at this point,
+        // so only need to check whether the block we're about to examine has been merged or split.
+        if (++visited == MICROBIT_HEAP_SEARCH_BATCH)
+        {
+            uint32_t generation = heap.generation;
+
+            visited = 0;
+            __enable_irq();
+            __disable_irq();
+
+            if (heap.generation != generation)
+                return MICROBIT_HEAP_SEARCH_RESTART;
+        }
+
 		// If the block is used, then keep looking.
 		if(!(*block & MICROBIT_HEAP_BLOCK_FREE))
 		{
-			block += *block;
+			block += *block & ~MICROBIT_HEAP_BLOCK_CACHED;
 			continue;
 		}
 
@@ -214,14 +432,16 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		// We have a free block. Let's see if the subsequent ones are too. If so, we can merge...
 		next = block + blockSize;
 
-		while (*next & MICROBIT_HEAP_BLOCK_FREE)
+		while (next < heap.heap_end && (*next & MICROBIT_HEAP_BLOCK_FREE))
 		{
-			if (next >= heap.heap_end)
-				break;
-
 			// We can merge!
 			blockSize += (*next & ~MICROBIT_HEAP_BLOCK_FREE);
 			*block = blockSize | MICROBIT_HEAP_BLOCK_FREE;
+            heap.generation++;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+            heap_forget(heap, next, block);
+#endif
 
 			next = block + blockSize;
 		}
@@ -229,19 +449,66 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		// We have a free block. Let's see if it's big enough.
         // If so, we have a winner.
 		if (blockSize >= blocksNeeded)
-			break;
+			return block;
 
 		// Otherwise, keep looking...
 		block += blockSize;
 	}
 
+    return NULL;
+}
+
+/**
+  * Attempt to allocate a given amount of memory from a given heap area.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  * @param heap The heap to allocate memory from.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+void *microbit_malloc(size_t size, HeapDefinition &heap)
+{
+	uint32_t	blockSize = 0;
+	uint32_t	blocksNeeded = size % MICROBIT_HEAP_BLOCK_SIZE == 0 ? size / MICROBIT_HEAP_BLOCK_SIZE : size / MICROBIT_HEAP_BLOCK_SIZE + 1;
+	uint32_t	*block;
+
+	if (size <= 0)
+		return NULL;
+
+	// Account for the index block;
+	blocksNeeded++;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    do
+    {
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+        // We implement a next fit algorithm, preferring recently freed blocks where they are large enough.
+        // Otherwise, we search from where the last allocation finished, which avoids repeatedly walking over
+        // the long lived allocations at the start of the heap, and wrap around if necessary.
+        block = heap_hint_lookup(heap, blocksNeeded);
+
+        if (block == NULL)
+            block = heap_search(heap, heap.rover, heap.heap_end, blocksNeeded);
+
+        if (block == NULL)
+            block = heap_search(heap, heap.heap_start, heap.rover, blocksNeeded);
+#else
+        // We implement a first fit algorithm with cache to handle rapid churn...
+        block = heap_search(heap, heap.heap_start, heap.heap_end, blocksNeeded);
+#endif
+    } while (block == MICROBIT_HEAP_SEARCH_RESTART);
+
 	// We're full!
-	if (block >= heap.heap_end)
+	if (block == NULL)
     {
         __enable_irq();
         return NULL;
     }
 
+    blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
+
 	// If we're at the end of memory or have very near match then mark the whole segment as in use.
 	if (blockSize <= blocksNeeded+1 || block+blocksNeeded+1 >= heap.heap_end)
 	{
@@ -258,12 +525,48 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		*block = blocksNeeded;
 	}
 
+    heap.used += *block;
+    heap.allocations++;
+    heap.generation++;
+
+    if (heap.used > heap.peak)
+        heap.peak = heap.used;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+    // Start the next search just beyond this allocation.
+    heap.rover = block + *block;
+
+    if (heap.rover >= heap.heap_end)
+        heap.rover = heap.heap_start;
+#endif
+
 	// Enable Interrupts
     __enable_irq();
 
 	return block+1;
 }
 
+/**
+  * Attempt to allocate a given amount of memory from the first of our configured heap areas that has space.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+static void *microbit_malloc(size_t size)
+{
+    void *p = NULL;
+
+    for (int i=0; i < heap_count; i++)
+    {
+        p = microbit_malloc(size, heap[i]);
+        if (p != NULL)
+            break;
+    }
+
+    return p;
+}
+
 /**
   * Attempt to allocate a given amount of memory from any of our configured heap areas.
   *
@@ -271,29 +574,46 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
   *
   * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
   */
-void *malloc(size_t size)
+static void *heap_allocate(size_t size)
 {
     static uint8_t initialised = 0;
-    void *p;
+    void *p = NULL;
 
     if (!initialised)
     {
         heap_count = 0;
 
-        if(microbit_create_heap((uint32_t)(&__end__), (uint32_t)(MICROBIT_HEAP_END)) == MICROBIT_INVALID_PARAMETER)
+        if(microbit_create_heap((uintptr_t)(&__end__), (uint32_t)(MICROBIT_HEAP_END)) == MICROBIT_INVALID_PARAMETER)
             microbit_panic(MICROBIT_HEAP_ERROR);
 
         initialised = 1;
     }
 
-    // Assign the memory from the first heap created that has space.
-    for (int i=0; i < heap_count; i++)
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+    // Small allocations are served from the free list of their size class where possible.
+    // Otherwise, we allocate a block of exactly the class size, so that it can be recycled when freed.
+    int sc = size > 0 ? heap_size_class((size + MICROBIT_HEAP_BLOCK_SIZE - 1) / MICROBIT_HEAP_BLOCK_SIZE + 1) : -1;
+
+    if (sc >= 0)
     {
-        p = microbit_malloc(size, heap[i]);
+        p = heap_class_pop(sc);
+
         if (p != NULL)
-            break;
+            return p;
+
+        size = (heap_class_blocks[sc] - 1) * MICROBIT_HEAP_BLOCK_SIZE;
     }
 
+#endif
+
+    p = microbit_malloc(size);
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+    // If we're out of memory, return any blocks held for reuse to the heap, and try again.
+    if (p == NULL && heap_class_flush())
+        p = microbit_malloc(size);
+#endif
+
     if (p != NULL)
     {
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
@@ -303,6 +623,8 @@ void *malloc(size_t size)
     }
 
     // We're totally out of options (and memory!).
+    heap_failures++;
+
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
     if(SERIAL_DEBUG) SERIAL_DEBUG->printf("malloc: OUT OF MEMORY [%d]\n", size);
 #endif
@@ -319,7 +641,7 @@ void *malloc(size_t size)
   *
   * @param mem The memory area to release.
   */
-void free(void *mem)
+static void heap_free(void *mem)
 {
 	uint32_t	*memory = (uint32_t *)mem;
 	uint32_t	*cb = memory-1;
@@ -339,10 +661,29 @@ void free(void *mem)
         {
             // The memory block given is part of this heap, so we can simply
 	        // flag that this memory area is now free, and we're done.
-            if (*cb == 0 || *cb & MICROBIT_HEAP_BLOCK_FREE)
+            if (*cb == 0 || *cb & (MICROBIT_HEAP_BLOCK_FREE | MICROBIT_HEAP_BLOCK_CACHED))
                 microbit_panic(MICROBIT_HEAP_ERROR);
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_SIZE_CLASSES)
+            // Small blocks are held for reuse by their size class.
+            if (heap_class_push(cb))
+                return;
+#endif
+
+            __disable_irq();
+
+            heap[i].used -= *cb;
+            heap[i].allocations--;
+
 	        *cb |= MICROBIT_HEAP_BLOCK_FREE;
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+            // Remember this block, so that it can be reused quickly.
+            heap[i].hint[heap[i].hint_next] = cb;
+            heap[i].hint_next = (heap[i].hint_next + 1) % MICROBIT_HEAP_HINT_CACHE_SIZE;
+#endif
+
+            __enable_irq();
             return;
         }
     }
@@ -351,9 +692,292 @@ void free(void *mem)
     microbit_panic(MICROBIT_HEAP_ERROR);
 }
 
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+// The usage attributed to each call site. The last entry collects allocations from any call site that doesn't fit.
+static MicroBitHeapProfileEntry heap_profile[MICROBIT_HEAP_PROFILE_SITES];
+static uint8_t heap_profile_count = 0;
+
+/**
+  * Determines the profile entry used to account for allocations from the given call site, creating one if necessary.
+  * Must be called with interrupts disabled.
+  *
+  * @param site The return address of the allocating call.
+  *
+  * @return The index of the entry for the call site.
+  */
+static uint32_t heap_profile_site(uint32_t site)
+{
+    for (int i = 0; i < heap_profile_count; i++)
+        if (heap_profile[i].site == site)
+            return i;
+
+    if (heap_profile_count < MICROBIT_HEAP_PROFILE_SITES - 1)
+    {
+        heap_profile[heap_profile_count].site = site;
+        return heap_profile_count++;
+    }
+
+    return MICROBIT_HEAP_PROFILE_SITES - 1;
+}
+
+/**
+  * Allocates memory on behalf of the given call site. The call site is recorded in a word
+  * ahead of the memory returned, so that it can be accounted for when the memory is freed.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @param site The return address of the allocating call.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+static void *heap_profile_allocate(size_t size, void *site)
+{
+    uint32_t *block = (uint32_t *) heap_allocate(size > 0 ? size + sizeof(uint32_t) : 0);
+
+    if (block == NULL)
+        return NULL;
+
+    uint32_t bytes = (block[-1] & ~(MICROBIT_HEAP_BLOCK_FREE | MICROBIT_HEAP_BLOCK_CACHED)) * MICROBIT_HEAP_BLOCK_SIZE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t i = heap_profile_site((uint32_t) site);
+    MicroBitHeapProfileEntry &e = heap_profile[i];
+
+    e.live_count++;
+    e.total_count++;
+    e.live_bytes += bytes;
+
+    if (e.live_bytes > e.peak_bytes)
+        e.peak_bytes = e.live_bytes;
+
+    __set_PRIMASK(primask);
+
+    block[0] = i;
+
+    return block + 1;
+}
+
+/**
+  * Removes the given allocation from the usage of the call site that made it.
+  *
+  * @param mem The memory being freed, as returned by heap_profile_allocate().
+  *
+  * @return The start of the underlying heap allocation.
+  */
+static void *heap_profile_release(void *mem)
+{
+    uint32_t *block = ((uint32_t *) mem) - 1;
+
+    // Leave anything that isn't ours for heap_free() to reject.
+    if (heap_containing(block) == NULL || block[0] >= MICROBIT_HEAP_PROFILE_SITES)
+        return block;
+
+    uint32_t bytes = (block[-1] & ~(MICROBIT_HEAP_BLOCK_FREE | MICROBIT_HEAP_BLOCK_CACHED)) * MICROBIT_HEAP_BLOCK_SIZE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    MicroBitHeapProfileEntry &e = heap_profile[block[0]];
+
+    e.live_count--;
+    e.live_bytes -= bytes;
+
+    __set_PRIMASK(primask);
+
+    return block;
+}
+
+/**
+  * Provides the heap usage attributed to a given call site. Call sites are numbered in the order that they
+  * first allocated memory.
+  *
+  * @param index The call site to inspect, from 0.
+  *
+  * @param entry Populated with the usage attributed to the call site.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no call site with the given index,
+  *         or MICROBIT_NOT_SUPPORTED if MICROBIT_HEAP_PROFILE or the micro:bit heap allocator is disabled.
+  */
+int microbit_heap_profile_get(int index, MicroBitHeapProfileEntry &entry)
+{
+    // The shared entry for untracked call sites is reported last, once it has been used.
+    if (index == heap_profile_count && heap_profile[MICROBIT_HEAP_PROFILE_SITES - 1].total_count > 0)
+        index = MICROBIT_HEAP_PROFILE_SITES - 1;
+
+    else if (index < 0 || index >= heap_profile_count)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+    entry = heap_profile[index];
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Writes the heap usage attributed to each call site to the given serial port, one line per call site.
+  * Call site addresses can be resolved to functions using the map file or addr2line.
+  *
+  * @param serial The serial port to write to.
+  */
+void microbit_heap_profile_print(MicroBitSerial &serial)
+{
+    MicroBitHeapProfileEntry entry;
+
+    for (int i = 0; microbit_heap_profile_get(i, entry) == MICROBIT_OK; i++)
+        serial.printf("%08x: %d live, %d bytes, %d peak, %d total\r\n", (unsigned int) entry.site, (int) entry.live_count,
+                      (int) entry.live_bytes, (int) entry.peak_bytes, (int) entry.total_count);
+}
+#endif
+
+/**
+  * Attempt to allocate a given amount of memory from any of our configured heap areas.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+void *malloc(size_t size)
+{
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+    return heap_profile_allocate(size, __builtin_return_address(0));
+#else
+    return heap_allocate(size);
+#endif
+}
+
+/**
+  * Release a given area of memory from the heap.
+  *
+  * @param mem The memory area to release.
+  */
+void free(void *mem)
+{
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+    if (mem != NULL)
+        mem = heap_profile_release(mem);
+#endif
+
+    heap_free(mem);
+}
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+// Attribute memory allocated with new to the code calling new, rather than to the C++ runtime.
+void *operator new(size_t size)
+{
+    return heap_profile_allocate(size, __builtin_return_address(0));
+}
+
+void *operator new[](size_t size)
+{
+    return heap_profile_allocate(size, __builtin_return_address(0));
+}
+
+void operator delete(void *p)
+{
+    free(p);
+}
+
+void operator delete[](void *p)
+{
+    free(p);
+}
+#endif
+
+/**
+  * Determines the number of heap regions in use.
+  *
+  * @return The number of heaps created with microbit_create_heap().
+  */
+int microbit_heap_count()
+{
+    return heap_count;
+}
+
+/**
+  * Provides a snapshot of the usage of a given heap region.
+  *
+  * Usage totals are maintained as memory is allocated and freed. The largest free block and
+  * block counts are determined by walking the heap on each call, so this should not be called
+  * at high rate.
+  *
+  * @param index The heap to inspect, in the order that heaps were created (0 is the first).
+  *
+  * @param stats Populated with the usage of the heap.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no heap with the given index,
+  *         or MICROBIT_NOT_SUPPORTED if the micro:bit heap allocator is disabled.
+  */
+int microbit_heap_get_statistics(int index, MicroBitHeapStatistics &stats)
+{
+    uint32_t *block;
+    uint32_t blockSize;
+    uint32_t run = 0;
+
+    if (index < 0 || index >= heap_count)
+        return MICROBIT_INVALID_PARAMETER;
+
+    HeapDefinition &h = heap[index];
+
+    stats.cached_bytes = 0;
+    stats.largest_free = 0;
+    stats.free_blocks = 0;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    stats.total_bytes = (uintptr_t) h.heap_end - (uintptr_t) h.heap_start;
+    stats.used_bytes = h.used * MICROBIT_HEAP_BLOCK_SIZE;
+    stats.peak_used_bytes = h.peak * MICROBIT_HEAP_BLOCK_SIZE;
+    stats.used_blocks = h.allocations;
+    stats.failures = heap_failures;
+
+    // Walk the heap to determine how fragmented it is. We don't merge blocks here, but treat runs of
+    // adjacent free blocks as one, as that's how the allocator will see them.
+	block = h.heap_start;
+	while (block < h.heap_end)
+	{
+		blockSize = *block & ~(MICROBIT_HEAP_BLOCK_FREE | MICROBIT_HEAP_BLOCK_CACHED);
+
+        if (*block & MICROBIT_HEAP_BLOCK_FREE)
+        {
+            stats.free_blocks++;
+            run += blockSize;
+
+            if (run > stats.largest_free)
+                stats.largest_free = run;
+        }
+        else
+        {
+            if (*block & MICROBIT_HEAP_BLOCK_CACHED)
+                stats.cached_bytes += blockSize * MICROBIT_HEAP_BLOCK_SIZE;
+
+            run = 0;
+        }
+
+		block += blockSize;
+    }
+
+	// Enable Interrupts
+    __enable_irq();
+
+    stats.free_bytes = stats.total_bytes - stats.used_bytes;
+
+    // Account for the index block of any allocation made from the largest free region.
+    stats.largest_free = stats.largest_free > 1 ? (stats.largest_free - 1) * MICROBIT_HEAP_BLOCK_SIZE : 0;
+
+    return MICROBIT_OK;
+}
+
 void* calloc (size_t num, size_t size)
 {
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+    void *mem = heap_profile_allocate(num*size, __builtin_return_address(0));
+#else
     void *mem = malloc(num*size);
+#endif
 
     if (mem)
         memclr(mem, num*size);
@@ -361,8 +985,116 @@ void* calloc (size_t num, size_t size)
     return mem;
 }
 
+/**
+  * Attempt to resize a given allocation without moving it, by absorbing any free blocks that follow it.
+  *
+  * @param ptr The memory to resize.
+  *
+  * @param size The new size of the memory, in bytes.
+  *
+  * @return 1 if the allocation now holds at least size bytes, 0 otherwise.
+  */
+static int microbit_resize(void *ptr, size_t size)
+{
+    uint32_t *cb = ((uint32_t *)ptr) - 1;
+    uint32_t blocksNeeded = (size + MICROBIT_HEAP_BLOCK_SIZE - 1) / MICROBIT_HEAP_BLOCK_SIZE + 1;
+    uint32_t blockSize;
+    uint32_t available;
+    uint32_t *next;
+
+    HeapDefinition *h = heap_containing(cb);
+
+    if (h == NULL)
+        return 0;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    blockSize = *cb;
+
+    // If we already have enough space, there's nothing to do.
+    if (blockSize >= blocksNeeded)
+    {
+        __enable_irq();
+        return 1;
+    }
+
+    // Determine how much contiguous free memory follows this block, merging it as we go.
+    available = blockSize;
+    next = cb + blockSize;
+
+    while (next < h->heap_end && (*next & MICROBIT_HEAP_BLOCK_FREE))
+    {
+        uint32_t *absorbed = next;
+
+        available += (*next & ~MICROBIT_HEAP_BLOCK_FREE);
+        next = cb + available;
+
+        // Keep the merged region as a single free block following this one, in case it isn't enough.
+        if (absorbed != cb + blockSize)
+        {
+            *(cb + blockSize) = (available - blockSize) | MICROBIT_HEAP_BLOCK_FREE;
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+            heap_forget(*h, absorbed, cb + blockSize);
+#endif
+        }
+
+        h->generation++;
+    }
+
+    if (available < blocksNeeded)
+    {
+        __enable_irq();
+        return 0;
+    }
+
+#if CONFIG_ENABLED(MICROBIT_HEAP_NEXT_FIT)
+    // The free block that followed us is about to be absorbed.
+    heap_forget(*h, cb + blockSize, cb);
+#endif
+
+    // Take what we need, leaving any reasonable remainder free.
+    if (available > blocksNeeded+1)
+    {
+        *(cb + blocksNeeded) = (available - blocksNeeded) | MICROBIT_HEAP_BLOCK_FREE;
+        available = blocksNeeded;
+    }
+
+    *cb = available;
+
+    h->used += available - blockSize;
+    h->generation++;
+
+    if (h->used > h->peak)
+        h->peak = h->used;
+
+    __enable_irq();
+
+    return 1;
+}
+
 void* realloc (void* ptr, size_t size)
 {
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+    // Resizing in place would bypass the accounting for the call site, so always move the allocation.
+    void *mem = heap_profile_allocate(size, __builtin_return_address(0));
+
+    if (ptr != NULL && mem != NULL)
+    {
+        // Discount both the index block and the call site word.
+        uint32_t *cb = ((uint32_t *)ptr) - 2;
+        uint32_t blockSize = (*cb & ~MICROBIT_HEAP_BLOCK_FREE) - 2;
+
+        memcpy(mem, ptr, min(blockSize * sizeof(uint32_t), size));
+        free(ptr);
+    }
+
+    return mem;
+#else
+    // Where possible, grow the existing allocation in place, avoiding a copy and a second allocation.
+    if (ptr != NULL && size > 0 && microbit_resize(ptr, size))
+        return ptr;
+
     void *mem = malloc(size);
 
     // handle the simplest case - no previous memory allocted.
@@ -378,12 +1110,17 @@ void* realloc (void* ptr, size_t size)
     }
 
     return mem;
+#endif
 }
 
 // make sure the libc allocator is not pulled in
 void *_malloc_r(struct _reent *, size_t len)
 {
+#if CONFIG_ENABLED(MICROBIT_HEAP_PROFILE)
+    return heap_profile_allocate(len, __builtin_return_address(0));
+#else
     return malloc(len);
+#endif
 }
 
 void _free_r(struct _reent *, void *addr)
@@ -408,4 +1145,32 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     return MICROBIT_OK;
 }
 
+int microbit_heap_count()
+{
+    return 0;
+}
+
+int microbit_heap_get_statistics(int index, MicroBitHeapStatistics &stats)
+{
+    (void) index;
+    (void) stats;
+
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+#endif
+
+#if !(CONFIG_ENABLED(MICROBIT_HEAP_ENABLED) && CONFIG_ENABLED(MICROBIT_HEAP_PROFILE))
+int microbit_heap_profile_get(int index, MicroBitHeapProfileEntry &entry)
+{
+    (void) index;
+    (void) entry;
+
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+void microbit_heap_profile_print(MicroBitSerial &serial)
+{
+    (void) serial;
+}
 #endif
@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
   */
 #include "MicroBitConfig.h"
 #include "MicroBitListener.h"
+#include "ErrorNo.h"
 
 /**
   * Constructor.
@@ -54,6 +55,13 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
     this->flags = flags;
 	this->next = NULL;
     this->evt_queue = NULL;
+    this->evt_queue_head = 0;
+    this->evt_queue_length = 0;
+    this->evt_queue_depth = MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    resetStatistics();
+#endif
 }
 
 /**
@@ -82,6 +90,45 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
     this->flags = flags | MESSAGE_BUS_LISTENER_PARAMETERISED;
 	this->next = NULL;
     this->evt_queue = NULL;
+    this->evt_queue_head = 0;
+    this->evt_queue_length = 0;
+    this->evt_queue_depth = MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    resetStatistics();
+#endif
+}
+
+/**
+  * Constructor.
+  *
+  * Create a new Message Bus Listener, that receives events in batches.
+  *
+  * @param id The ID of the component you want to listen to.
+  *
+  * @param value The event value you would like to listen to from that component
+  *
+  * @param handler A function pointer to call with each batch of events, and the number of events in the batch.
+  *
+  * @param flags User specified, implementation specific flags, that allow behaviour of this events listener
+  * to be tuned.
+  */
+MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(MicroBitEvent *, int), uint16_t flags)
+{
+	this->id = id;
+	this->value = value;
+	this->cb_batch = handler;
+	this->cb_arg = NULL;
+    this->flags = flags | MESSAGE_BUS_LISTENER_BATCH;
+	this->next = NULL;
+    this->evt_queue = NULL;
+    this->evt_queue_head = 0;
+    this->evt_queue_length = 0;
+    this->evt_queue_depth = MESSAGE_BUS_LISTENER_DEFAULT_QUEUE_DEPTH;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    resetStatistics();
+#endif
 }
 
 /**
@@ -89,8 +136,7 @@ MicroBitListener::MicroBitListener(uint16_t id, uint16_t value, void (*handler)(
   */
 MicroBitListener::~MicroBitListener()
 {
-    if(this->flags & MESSAGE_BUS_LISTENER_METHOD)
-        delete cb_method;
+    free(evt_queue);
 }
 
 /**
@@ -100,23 +146,158 @@ MicroBitListener::~MicroBitListener()
   */
 void MicroBitListener::queue(MicroBitEvent e)
 {
-    int queueDepth;
-
-    MicroBitEventQueueItem *p = evt_queue;
-
+    // Allocate our queue on first use. Thereafter, queueing an event never touches the heap.
     if (evt_queue == NULL)
-        evt_queue = new MicroBitEventQueueItem(e);
-    else
     {
-        queueDepth = 1;
+        evt_queue = (MicroBitEvent *) malloc(evt_queue_depth * sizeof(MicroBitEvent));
 
-        while (p->next != NULL)
+        if (evt_queue == NULL)
         {
-            p = p->next;
-            queueDepth++;
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+            dropped++;
+#endif
+            return;
         }
+    }
+
+    __disable_irq();
+
+    // If we're coalescing and an identical event is already waiting, simply bring it up to date.
+    if (flags & MESSAGE_BUS_LISTENER_COALESCE)
+    {
+        for (int i = 0; i < evt_queue_length; i++)
+        {
+            MicroBitEvent &q = evt_queue[(evt_queue_head + i) % evt_queue_depth];
+
+            if (q.source == e.source && q.value == e.value)
+            {
+                q.timestamp = e.timestamp;
+                __enable_irq();
+                return;
+            }
+        }
+    }
 
-        if (queueDepth < MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
-            p->next = new MicroBitEventQueueItem(e);
+    if (evt_queue_length < evt_queue_depth)
+    {
+        evt_queue[(evt_queue_head + evt_queue_length) % evt_queue_depth] = e;
+        evt_queue_length++;
+    }
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    else
+    {
+        dropped++;
     }
+#endif
+
+    __enable_irq();
+}
+
+/**
+  * Removes the oldest event from the queue of events waiting to be processed.
+  *
+  * @param e Updated with the event removed.
+  *
+  * @return 1 if an event was removed, 0 if the queue is empty.
+  */
+int MicroBitListener::dequeue(MicroBitEvent &e)
+{
+    int dequeued = 0;
+
+    __disable_irq();
+
+    if (evt_queue_length > 0)
+    {
+        e = evt_queue[evt_queue_head];
+        evt_queue_head = (evt_queue_head + 1) % evt_queue_depth;
+        evt_queue_length--;
+        dequeued = 1;
+    }
+
+    __enable_irq();
+
+    return dequeued;
+}
+
+/**
+  * Provides the oldest events waiting to be processed, as a contiguous array.
+  * The events remain in the queue until released with discard().
+  *
+  * @param events Updated to point to the oldest event in the queue.
+  *
+  * @return The number of contiguous events available, or 0 if the queue is empty. This may be fewer
+  *         than the number of events waiting, if the queue wraps around.
+  */
+int MicroBitListener::peek(MicroBitEvent *&events)
+{
+    int length;
+
+    __disable_irq();
+
+    events = evt_queue + evt_queue_head;
+    length = evt_queue_depth - evt_queue_head;
+
+    if (evt_queue_length < length)
+        length = evt_queue_length;
+
+    __enable_irq();
+
+    return length;
+}
+
+/**
+  * Removes the given number of events from the front of the queue.
+  *
+  * @param count The number of events to remove, as returned by peek().
+  */
+void MicroBitListener::discard(int count)
+{
+    __disable_irq();
+
+    if (count > evt_queue_length)
+        count = evt_queue_length;
+
+    evt_queue_head = (evt_queue_head + count) % evt_queue_depth;
+    evt_queue_length -= count;
+
+    __enable_irq();
+}
+
+/**
+  * Sets the maximum number of events that may wait for this listener, when it is flagged
+  * MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY. Further events are dropped.
+  *
+  * @param depth The new depth of the queue, in the range 1..255.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the depth is out of range, or
+  *         MICROBIT_BUSY if events are currently waiting in the queue.
+  */
+int MicroBitListener::setQueueDepth(int depth)
+{
+    if (depth < 1 || depth > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (evt_queue_length > 0)
+        return MICROBIT_BUSY;
+
+    // Release any existing queue. A new one of the requested size is allocated on next use.
+    free(evt_queue);
+
+    evt_queue = NULL;
+    evt_queue_head = 0;
+    evt_queue_depth = depth;
+
+    return MICROBIT_OK;
+}
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+/**
+  * Resets the statistics recorded for this listener.
+  */
+void MicroBitListener::resetStatistics()
+{
+    dispatched = 0;
+    dropped = 0;
+    handler_time = 0;
 }
+#endif
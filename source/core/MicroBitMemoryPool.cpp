@@ -0,0 +1,233 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitMemoryPool.
+  *
+  * A memory pool holds a fixed number of equally sized blocks of memory, which can be allocated and
+  * released in constant time, with interrupts disabled only briefly.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitMemoryPool.h"
+#include "ErrorNo.h"
+
+// Chain of all registered memory pools.
+static MicroBitMemoryPool *pools = NULL;
+
+/**
+  * Constructor.
+  *
+  * Create a new memory pool, and register it for use by microbit_pool_release().
+  *
+  * @param blockSize The size of each block, in bytes.
+  *
+  * @param count The number of blocks in the pool.
+  */
+MicroBitMemoryPool::MicroBitMemoryPool(int blockSize, int count)
+{
+    // Each block must be able to hold our free list linkage, and be word aligned.
+    if (blockSize < (int) sizeof(void *))
+        blockSize = sizeof(void *);
+
+    this->blockSize = (blockSize + 3) & ~3;
+    this->count = count > 0 ? count : 0;
+    this->available = 0;
+    this->memory = NULL;
+    this->freeList = NULL;
+
+    __disable_irq();
+    this->next = pools;
+    pools = this;
+    __enable_irq();
+}
+
+/**
+  * Destructor.
+  *
+  * Deregisters the pool, and releases its memory back to the heap. Any blocks allocated from the pool are no longer valid.
+  */
+MicroBitMemoryPool::~MicroBitMemoryPool()
+{
+    __disable_irq();
+
+    if (pools == this)
+    {
+        pools = next;
+    }
+    else
+    {
+        for (MicroBitMemoryPool *p = pools; p != NULL; p = p->next)
+        {
+            if (p->next == this)
+            {
+                p->next = next;
+                break;
+            }
+        }
+    }
+
+    __enable_irq();
+
+    free(memory);
+}
+
+/**
+  * Allocates a block from the pool. This is safe to call from interrupt context once the pool's memory
+  * has been reserved (i.e. after the first call).
+  *
+  * @return A pointer to the block, or NULL if the pool is exhausted or its memory could not be reserved.
+  */
+void *MicroBitMemoryPool::allocate()
+{
+    void *block;
+
+    // Reserve our memory on first use, and chain all the blocks together.
+    if (memory == NULL)
+    {
+        if (count == 0)
+            return NULL;
+
+        uint8_t *m = (uint8_t *) malloc(blockSize * count);
+
+        if (m == NULL)
+            return NULL;
+
+        for (int i = 0; i < count; i++)
+            *(void **)(m + i * blockSize) = (i == count - 1) ? NULL : m + (i + 1) * blockSize;
+
+        // We may have been beaten to it by an interrupt handler, in which case we use its memory instead.
+        __disable_irq();
+
+        if (memory == NULL)
+        {
+            freeList = m;
+            available = count;
+            memory = m;
+            m = NULL;
+        }
+
+        __enable_irq();
+
+        free(m);
+    }
+
+    __disable_irq();
+
+    block = freeList;
+
+    if (block != NULL)
+    {
+        freeList = *(void **)block;
+        available--;
+    }
+
+    __enable_irq();
+
+    return block;
+}
+
+/**
+  * Returns a block to the pool.
+  *
+  * @param block The block to release.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the block was not allocated from this pool.
+  */
+int MicroBitMemoryPool::release(void *block)
+{
+    if (!contains(block))
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    *(void **)block = freeList;
+    freeList = block;
+    available++;
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines if the given memory was allocated from this pool.
+  *
+  * @param block The memory to test.
+  *
+  * @return true if the memory lies within this pool, false otherwise.
+  */
+bool MicroBitMemoryPool::contains(void *block)
+{
+    uint8_t *b = (uint8_t *) block;
+
+    return memory != NULL && b >= memory && b < memory + blockSize * count;
+}
+
+/**
+  * Determines the size of the blocks in this pool.
+  *
+  * @return The size of each block, in bytes.
+  */
+int MicroBitMemoryPool::getBlockSize()
+{
+    return blockSize;
+}
+
+/**
+  * Determines how many blocks remain available in this pool.
+  *
+  * @return The number of free blocks.
+  */
+int MicroBitMemoryPool::getFree()
+{
+    return memory == NULL ? count : available;
+}
+
+/**
+  * Returns the given memory to the registered pool that it was allocated from.
+  *
+  * @param block The memory to release.
+  *
+  * @return 1 if the memory was returned to a pool, 0 if it was not allocated from any pool (and should be freed as normal).
+  */
+int microbit_pool_release(void *block)
+{
+    for (MicroBitMemoryPool *p = pools; p != NULL; p = p->next)
+        if (p->release(block) == MICROBIT_OK)
+            return 1;
+
+    return 0;
+}
+
+/**
+  * Releases the given memory, either to the registered pool that it was allocated from, or to the heap.
+  *
+  * @param block The memory to release.
+  */
+void microbit_pool_free(void *block)
+{
+    if (!microbit_pool_release(block))
+        free(block);
+}
@@ -0,0 +1,193 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Energy accounting for the micro:bit runtime.
+  *
+  * Accumulates the time spent active in each power domain, as reported by the components of the runtime.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitPowerProfile.h"
+#include "MicroBitSystemTimer.h"
+#include "ManagedString.h"
+#include "ErrorNo.h"
+
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+static MicroBitPowerProfile domains[MICROBIT_POWER_DOMAINS];
+static uint64_t activeSince[MICROBIT_POWER_DOMAINS];
+static uint64_t epoch = 0;
+
+/**
+  * Records that a power domain has become active or inactive. Repeated reports of the same state are ignored.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param active true if the domain has become active, false if it has become inactive.
+  */
+void power_profile_set_active(int domain, bool active)
+{
+    if (domain < 0 || domain >= MICROBIT_POWER_DOMAINS)
+        return;
+
+    MicroBitPowerProfile *d = &domains[domain];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (active && !d->active)
+    {
+        activeSince[domain] = system_timer_current_time_us();
+        d->active = 1;
+        d->transitions++;
+    }
+    else if (!active && d->active)
+    {
+        d->active_us += system_timer_current_time_us() - activeSince[domain];
+        d->active = 0;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * Adds time to a power domain directly, for activity that is known only as a duration.
+  *
+  * This function may be safely called from interrupt context.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param us The time to add (microseconds).
+  */
+void power_profile_add_time(int domain, uint32_t us)
+{
+    if (domain < 0 || domain >= MICROBIT_POWER_DOMAINS)
+        return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    domains[domain].active_us += us;
+
+    __set_PRIMASK(primask);
+}
+#endif
+
+/**
+  * Reads the activity of a power domain, including any time in its current active period.
+  *
+  * @param domain The power domain, from 0 to MICROBIT_POWER_DOMAINS - 1.
+  *
+  * @param profile Populated with the activity of the domain.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if domain is out of range, or
+  *         MICROBIT_NOT_SUPPORTED if MICROBIT_POWER_PROFILING is disabled.
+  */
+int power_profile_get(int domain, MicroBitPowerProfile &profile)
+{
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+    if (domain < 0 || domain >= MICROBIT_POWER_DOMAINS)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    profile = domains[domain];
+
+    if (profile.active)
+        profile.active_us += system_timer_current_time_us() - activeSince[domain];
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+#else
+    (void) domain;
+    (void) profile;
+
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Determines the time over which activity has been accumulated.
+  *
+  * @return The time since power_profile_reset() was last called, or since power on (microseconds).
+  */
+uint64_t power_profile_get_elapsed_us()
+{
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+    return system_timer_current_time_us() - epoch;
+#else
+    return 0;
+#endif
+}
+
+/**
+  * Clears the accumulated activity of every power domain. Domains that are active remain so.
+  */
+void power_profile_reset()
+{
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+    __disable_irq();
+
+    epoch = system_timer_current_time_us();
+
+    for (int i = 0; i < MICROBIT_POWER_DOMAINS; i++)
+    {
+        domains[i].active_us = 0;
+        domains[i].transitions = 0;
+        activeSince[i] = epoch;
+    }
+
+    __enable_irq();
+#endif
+}
+
+/**
+  * Writes the activity of every power domain to the given serial port, one line per domain, giving the
+  * active time and its share of the elapsed time in tenths of a percent.
+  *
+  * @param serial The serial port to write to.
+  */
+void power_profile_print(MicroBitSerial &serial)
+{
+    static const char * const names[] = { "sleep", "radio", "display", "i2c", "thermometer" };
+
+    uint64_t elapsed = power_profile_get_elapsed_us();
+
+    for (int i = 0; i < MICROBIT_POWER_DOMAINS; i++)
+    {
+        MicroBitPowerProfile profile;
+
+        if (power_profile_get(i, profile) != MICROBIT_OK)
+            return;
+
+        ManagedString name = i < MICROBIT_POWER_DOMAIN_USER ? ManagedString(names[i]) : ManagedString("user") + ManagedString(i - MICROBIT_POWER_DOMAIN_USER);
+        int permille = elapsed ? (int)((profile.active_us * 1000) / elapsed) : 0;
+
+        serial.send(name + ": " + ManagedString((int)(profile.active_us / 1000)) + " ms, " + ManagedString(permille) + " permille, " +
+                    ManagedString((int) profile.transitions) + " transitions\r\n");
+    }
+}
@@ -33,26 +33,67 @@ DEALINGS IN THE SOFTWARE.
   *
   * The latter is useful to avoid costs associated with multiple mbed Ticker instances
   * in microbit-dal components, as each incurs a significant additional RAM overhead (circa 80 bytes).
+  * For the same reason, one shot callbacks share a single mbed Timeout, through a queue sorted by deadline.
+  *
+  * Time is taken from the free running mbed microsecond ticker, which on the nRF51 is driven by the
+  * low frequency RTC, so the high frequency clock need not run while the processor is idle. The 32 bit
+  * counter is never reset, and is extended to 64 bits by counting its overflows.
   */
 #include "MicroBitConfig.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitFiber.h"
+#include "us_ticker_api.h"
 #include "ErrorNo.h"
 
 /*
- * Time since power on. Measured in milliseconds.
- * When stored as an unsigned long, this gives us approx 50 days between rollover, which is ample. :-)
+ * Time since power on. Measured in microseconds.
  */
 static uint64_t time_us = 0;
 static unsigned int tick_period = 0;
 
-// Array of components which are iterated during a system tick
-static MicroBitComponent* systemTickComponents[MICROBIT_SYSTEM_COMPONENTS];
+// The last value read from the free running microsecond counter, and the number of times it has overflowed.
+// The counter overflows every 71 minutes, and is read at least once per system tick, so no overflow can be missed.
+static uint32_t ticker_last = 0;
+static uint32_t ticker_overflows = 0;
+
+/*
+ * A component registered to receive system tick callbacks.
+ */
+struct SystemTickComponent
+{
+    MicroBitComponent *component;       // The component to call.
+    uint16_t divisor;                   // The number of ticks between each callback.
+    uint16_t count;                     // The number of ticks remaining until the next callback.
+    uint16_t requirement;               // The longest tick period the component can tolerate in milliseconds, or 0 if it has none.
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    uint32_t calls;                     // The number of callbacks made.
+    uint32_t total_us;                  // The total time spent in callbacks.
+    uint32_t max_us;                    // The longest callback.
+    uint32_t buckets[MICROBIT_SYSTEM_TICK_PROFILE_BUCKETS];
+#endif
+};
+
+// Compacted array of components which are iterated during a system tick.
+// This starts out in static storage, and is moved to the heap if more than MICROBIT_SYSTEM_COMPONENTS are added.
+static SystemTickComponent systemTickComponentsStatic[MICROBIT_SYSTEM_COMPONENTS];
+static SystemTickComponent *systemTickComponents = systemTickComponentsStatic;
+static int systemTickComponentsCount = 0;
+static int systemTickComponentsCapacity = MICROBIT_SYSTEM_COMPONENTS;
 
 // Periodic callback interrupt
 static Ticker *ticker = NULL;
 
-// System timer.
-static Timer *timer = NULL;
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+// Tick jitter, and the time the last tick started (0 if there is no previous tick to measure from).
+static MicroBitSystemTickJitter tickJitter;
+static uint32_t tickLast = 0;
+#endif
+
+// One shot callback interrupt, and the queue of pending events ordered by deadline.
+static Timeout *timeout = NULL;
+static SystemTimerEvent *timerEvents = NULL;
+
+static void system_timer_event_fire();
 
 
 /**
@@ -67,12 +108,9 @@ static Timer *timer = NULL;
 int system_timer_init(int period)
 {
     if (ticker == NULL)
-        ticker = new Ticker();
-
-    if (timer == NULL)
     {
-        timer = new Timer();
-        timer->start();
+        ticker = new Ticker();
+        ticker_last = us_ticker_read();
     }
 
     return system_timer_set_period(period);
@@ -98,6 +136,11 @@ int system_timer_set_period(int period)
     tick_period = period;
     ticker->attach_us(system_timer_tick, period * 1000);
 
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    // The next interval will not be a whole period of either the old or new rate.
+    tickLast = 0;
+#endif
+
     return MICROBIT_OK;
 }
 
@@ -114,17 +157,28 @@ int system_timer_get_period()
 /**
   * Updates the current time in microseconds, since power on.
   *
-  * If the mbed Timer hasn't been initialised, it will be initialised
+  * If the system timer hasn't been initialised, it will be initialised
   * on the first call to this function.
   */
 void update_time()
 {
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    time_us += timer->read_us();
-    timer->reset();
+    // This may be called from both thread and interrupt context, possibly with interrupts already disabled.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = us_ticker_read();
+
+    if (now < ticker_last)
+        ticker_overflows++;
+
+    ticker_last = now;
+    time_us = ((uint64_t) ticker_overflows << 32) | now;
+
+    __set_PRIMASK(primask);
 }
 
 /**
@@ -148,6 +202,25 @@ uint64_t system_timer_current_time_us()
     return time_us;
 }
 
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+/**
+  * Determines the histogram bucket for a sample.
+  *
+  * @param time_us The sample, in microseconds.
+  *
+  * @return the index of the power of two bucket holding the sample.
+  */
+static int system_timer_profile_bucket(uint32_t time_us)
+{
+    int bucket = 0;
+
+    while (bucket < MICROBIT_SYSTEM_TICK_PROFILE_BUCKETS - 1 && (time_us >> bucket) != 0)
+        bucket++;
+
+    return bucket;
+}
+#endif
+
 /**
   * Timer callback. Called from interrupt context, once per period.
   *
@@ -158,37 +231,235 @@ void system_timer_tick()
 {
     update_time();
 
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    uint32_t tickStart = us_ticker_read();
+
+    if (tickLast)
+    {
+        int32_t deviation = (int32_t) (tickStart - tickLast) - (int32_t) (tick_period * 1000);
+        uint32_t magnitude = deviation < 0 ? -deviation : deviation;
+
+        if (deviation > 0 && magnitude > tickJitter.max_late_us)
+            tickJitter.max_late_us = magnitude;
+
+        if (deviation < 0 && magnitude > tickJitter.max_early_us)
+            tickJitter.max_early_us = magnitude;
+
+        tickJitter.ticks++;
+        tickJitter.buckets[system_timer_profile_bucket(magnitude)]++;
+    }
+
+    tickLast = tickStart;
+#endif
+
     // Update any components registered for a callback
-    for(int i = 0; i < MICROBIT_SYSTEM_COMPONENTS; i++)
-        if(systemTickComponents[i] != NULL)
-            systemTickComponents[i]->systemTick();
+    int i = 0;
+    while(i < systemTickComponentsCount)
+    {
+        SystemTickComponent *c = &systemTickComponents[i];
+        MicroBitComponent *component = c->component;
+
+        if(--c->count == 0)
+        {
+            c->count = c->divisor;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+            uint32_t start = us_ticker_read();
+            component->systemTick();
+            uint32_t elapsed = us_ticker_read() - start;
+#else
+            component->systemTick();
+#endif
+
+            // If a component was removed from the array during the tick, another may have shifted into this slot.
+            if(i < systemTickComponentsCount && systemTickComponents[i].component != component)
+                continue;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+            // The array may have been reallocated if a component was added, so find this one again before recording.
+            if(i < systemTickComponentsCount)
+            {
+                c = &systemTickComponents[i];
+                c->calls++;
+                c->total_us += elapsed;
+
+                if (elapsed > c->max_us)
+                    c->max_us = elapsed;
+
+                c->buckets[system_timer_profile_bucket(elapsed)]++;
+            }
+#endif
+        }
+
+        i++;
+    }
+
+    system_timer_governor_update();
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    uint32_t tickTime = us_ticker_read() - tickStart;
+
+    if (tickTime > tickJitter.max_tick_us)
+        tickJitter.max_tick_us = tickTime;
+#endif
+}
+
+/**
+  * Re-evaluates the system tick period chosen by the governor, e.g. after a fiber has started sleeping
+  * with a deadline earlier than the next tick. Has no effect unless MICROBIT_SYSTEM_TICK_GOVERNOR is enabled.
+  */
+void system_timer_governor_update()
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_GOVERNOR)
+    if (ticker == NULL)
+        return;
+
+    // This may be called from both thread and interrupt context.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    int period = SYSTEM_TICK_MAX_PERIOD_MS;
+
+    for(int i = 0; i < systemTickComponentsCount; i++)
+    {
+        int requirement = systemTickComponents[i].requirement;
+
+        if (requirement && requirement < period)
+            period = requirement;
+    }
+
+    // Bring the next tick forward to meet the earliest sleeping fiber's deadline, but never tick more often
+    // than SYSTEM_TICK_PERIOD_MS to do so. That has always been the granularity of fiber_sleep().
+    uint32_t wakeup = scheduler_next_wakeup();
+
+    if (wakeup)
+    {
+        int remaining = (int) (wakeup - (uint32_t) system_timer_current_time());
+
+        if (remaining < SYSTEM_TICK_PERIOD_MS)
+            remaining = SYSTEM_TICK_PERIOD_MS;
+
+        if (remaining < period)
+            period = remaining;
+    }
+
+    if (period != (int) tick_period)
+        system_timer_set_period(period);
+
+    __set_PRIMASK(primask);
+#endif
+}
+
+/**
+  * Records the longest system tick period a component can tolerate. When the system tick governor is enabled
+  * (MICROBIT_SYSTEM_TICK_GOVERNOR), the tick period is the shortest of these requirements, or SYSTEM_TICK_MAX_PERIOD_MS
+  * if there are none, shortened as necessary to wake sleeping fibers on time.
+  *
+  * @param component The component, which must already have been added with system_timer_add_component().
+  *
+  * @param period The longest acceptable period between ticks in milliseconds, or 0 if the component has no requirement.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the component has not been added or period is out of range.
+  */
+int system_timer_set_requirement(MicroBitComponent *component, int period)
+{
+    if (period < 0 || period > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    for(int i = 0; i < systemTickComponentsCount; i++)
+    {
+        if(systemTickComponents[i].component == component)
+        {
+            if (systemTickComponents[i].requirement != period)
+            {
+                systemTickComponents[i].requirement = period;
+                system_timer_governor_update();
+            }
+
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_INVALID_PARAMETER;
 }
 
 /**
   * Add a component to the array of system components. This component will then receive
-  * periodic callbacks, once every tick period.
+  * periodic callbacks, once every divisor tick periods.
+  *
+  * The array grows as necessary, so is not limited to MICROBIT_SYSTEM_COMPONENTS entries.
+  * If the component has already been added, its divisor is updated.
   *
   * @param component The component to add.
   *
-  * @return MICROBIT_OK on success. MICROBIT_NO_RESOURCES is returned if the component array is full.
+  * @param divisor The number of tick periods between each callback. Defaults to 1 (every tick).
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if divisor is out of range,
+  *         or MICROBIT_NO_RESOURCES if the component array could not be grown.
   *
   * @note The callback will be in interrupt context.
   */
-int system_timer_add_component(MicroBitComponent *component)
+int system_timer_add_component(MicroBitComponent *component, int divisor)
 {
-    int i = 0;
+    if (component == NULL || divisor < 1 || divisor > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
 
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    while(systemTickComponents[i] != NULL && i < MICROBIT_SYSTEM_COMPONENTS)
-        i++;
+    for(int i = 0; i < systemTickComponentsCount; i++)
+    {
+        if(systemTickComponents[i].component == component)
+        {
+            __disable_irq();
+            systemTickComponents[i].divisor = divisor;
+            systemTickComponents[i].count = divisor;
+            __enable_irq();
+
+            return MICROBIT_OK;
+        }
+    }
 
-    if(i == MICROBIT_SYSTEM_COMPONENTS)
-        return MICROBIT_NO_RESOURCES;
+    if(systemTickComponentsCount == systemTickComponentsCapacity)
+    {
+        int capacity = systemTickComponentsCapacity + MICROBIT_SYSTEM_COMPONENTS;
+        SystemTickComponent *components = (SystemTickComponent *) malloc(capacity * sizeof(SystemTickComponent));
+
+        if(components == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        // Swap to the larger array atomically, as the tick handler may be iterating over it.
+        __disable_irq();
+
+        SystemTickComponent *old = systemTickComponents;
+        memcpy(components, old, systemTickComponentsCount * sizeof(SystemTickComponent));
+        systemTickComponents = components;
+        systemTickComponentsCapacity = capacity;
+
+        __enable_irq();
+
+        if(old != systemTickComponentsStatic)
+            free(old);
+    }
+
+    __disable_irq();
+
+    SystemTickComponent *c = &systemTickComponents[systemTickComponentsCount];
+    c->component = component;
+    c->divisor = divisor;
+    c->count = divisor;
+    c->requirement = 0;
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    c->calls = 0;
+    c->total_us = 0;
+    c->max_us = 0;
+    memset(c->buckets, 0, sizeof(c->buckets));
+#endif
+    systemTickComponentsCount++;
+
+    __enable_irq();
 
-    systemTickComponents[i] = component;
     return MICROBIT_OK;
 }
 
@@ -204,13 +475,257 @@ int system_timer_remove_component(MicroBitComponent *component)
 {
     int i = 0;
 
-    while(systemTickComponents[i] != component && i < MICROBIT_SYSTEM_COMPONENTS)
+    while(i < systemTickComponentsCount && systemTickComponents[i].component != component)
         i++;
 
-    if(i == MICROBIT_SYSTEM_COMPONENTS)
+    if(i == systemTickComponentsCount)
         return MICROBIT_INVALID_PARAMETER;
 
-    systemTickComponents[i] = NULL;
+    // Close the gap, so the tick handler never needs to skip empty entries.
+    __disable_irq();
+
+    systemTickComponentsCount--;
+    memmove(&systemTickComponents[i], &systemTickComponents[i+1], (systemTickComponentsCount - i) * sizeof(SystemTickComponent));
+
+    __enable_irq();
+
+    // The component's requirement no longer applies.
+    system_timer_governor_update();
 
     return MICROBIT_OK;
 }
+
+/**
+  * Retrieves the profile of a component registered for system tick callbacks.
+  *
+  * @param index The index of the component, from 0 upwards, in the order the components are called.
+  *
+  * @param profile The structure to fill in.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if there is no component at that index,
+  *         or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TICK_PROFILING is disabled.
+  */
+int system_timer_get_profile(int index, MicroBitSystemTickProfile &profile)
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    int result = MICROBIT_INVALID_PARAMETER;
+
+    // Take a consistent snapshot, as the tick handler may be updating the counters.
+    __disable_irq();
+
+    if (index >= 0 && index < systemTickComponentsCount)
+    {
+        SystemTickComponent *c = &systemTickComponents[index];
+
+        profile.component = c->component;
+        profile.calls = c->calls;
+        profile.total_us = c->total_us;
+        profile.max_us = c->max_us;
+        memcpy(profile.buckets, c->buckets, sizeof(profile.buckets));
+
+        result = MICROBIT_OK;
+    }
+
+    __enable_irq();
+
+    return result;
+#else
+    (void) index;
+    (void) profile;
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Retrieves the recorded deviation of system ticks from their nominal period.
+  *
+  * @param jitter The structure to fill in.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TICK_PROFILING is disabled.
+  */
+int system_timer_get_jitter(MicroBitSystemTickJitter &jitter)
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    __disable_irq();
+    jitter = tickJitter;
+    __enable_irq();
+
+    return MICROBIT_OK;
+#else
+    (void) jitter;
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Discards all system tick profiling data recorded so far.
+  */
+void system_timer_reset_profile()
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_PROFILING)
+    __disable_irq();
+
+    for(int i = 0; i < systemTickComponentsCount; i++)
+    {
+        SystemTickComponent *c = &systemTickComponents[i];
+
+        c->calls = 0;
+        c->total_us = 0;
+        c->max_us = 0;
+        memset(c->buckets, 0, sizeof(c->buckets));
+    }
+
+    memset(&tickJitter, 0, sizeof(tickJitter));
+    tickLast = 0;
+
+    __enable_irq();
+#endif
+}
+
+/**
+  * Programs the one shot Timeout for the event at the head of the queue, if any.
+  * Must be called with interrupts disabled.
+  */
+static void system_timer_event_schedule()
+{
+    if (timerEvents == NULL)
+    {
+        timeout->detach();
+        return;
+    }
+
+    int32_t delay = (int32_t) (timerEvents->deadline - us_ticker_read());
+
+    if (delay < 1)
+        delay = 1;
+
+    timeout->attach_us(system_timer_event_fire, delay);
+}
+
+/**
+  * One shot Timeout callback. Called from interrupt context.
+  *
+  * Makes the callback of every event that is now due, then reprograms the Timeout for the next.
+  */
+static void system_timer_event_fire()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    while (timerEvents != NULL && (int32_t) (timerEvents->deadline - us_ticker_read()) <= 0)
+    {
+        SystemTimerEvent *e = timerEvents;
+        timerEvents = e->next;
+        e->next = NULL;
+
+        // The callback may reschedule this or any other event.
+        __set_PRIMASK(primask);
+        e->callback(e->context);
+        __disable_irq();
+    }
+
+    system_timer_event_schedule();
+
+    __set_PRIMASK(primask);
+}
+
+/**
+  * Removes an event from the queue. Must be called with interrupts disabled.
+  *
+  * @param event The event to remove.
+  *
+  * @return true if the event was pending, false otherwise.
+  */
+static bool system_timer_event_dequeue(SystemTimerEvent *event)
+{
+    SystemTimerEvent **p = &timerEvents;
+
+    while (*p != NULL && *p != event)
+        p = &(*p)->next;
+
+    if (*p == NULL)
+        return false;
+
+    *p = event->next;
+    event->next = NULL;
+
+    return true;
+}
+
+/**
+  * Schedules a one shot callback, the given number of microseconds from now. The callback is made in interrupt context.
+  *
+  * If the event is already pending, it is rescheduled.
+  *
+  * @param event The event to schedule. This must remain valid until the callback is made, or the event is cancelled.
+  *
+  * @param period The time until the callback is due, in microseconds.
+  *
+  * @param callback The function to call.
+  *
+  * @param context The value to pass to the callback.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if event or callback is NULL.
+  */
+int system_timer_event_after_us(SystemTimerEvent *event, uint32_t period, void (*callback)(void *), void *context)
+{
+    if (event == NULL || callback == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (timeout == NULL)
+        timeout = new Timeout();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    SystemTimerEvent *head = timerEvents;
+    system_timer_event_dequeue(event);
+
+    event->deadline = us_ticker_read() + period;
+    event->callback = callback;
+    event->context = context;
+
+    // Insert after any events due at or before the same time, comparing deadlines relative to each other
+    // so that wrap around of the microsecond counter is handled.
+    SystemTimerEvent **p = &timerEvents;
+
+    while (*p != NULL && (int32_t) ((*p)->deadline - event->deadline) <= 0)
+        p = &(*p)->next;
+
+    event->next = *p;
+    *p = event;
+
+    // Only reprogram the Timeout if the earliest deadline has changed.
+    if (timerEvents != head || head == event)
+        system_timer_event_schedule();
+
+    __set_PRIMASK(primask);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Cancels a one shot callback previously scheduled with system_timer_event_after_us().
+  *
+  * @param event The event to cancel.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the event is not pending.
+  */
+int system_timer_cancel_event(SystemTimerEvent *event)
+{
+    if (event == NULL || timeout == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    SystemTimerEvent *head = timerEvents;
+    bool pending = system_timer_event_dequeue(event);
+
+    if (pending && head == event)
+        system_timer_event_schedule();
+
+    __set_PRIMASK(primask);
+
+    return pending ? MICROBIT_OK : MICROBIT_INVALID_PARAMETER;
+}
@@ -28,22 +28,31 @@ DEALINGS IN THE SOFTWARE.
   */
 #include "MicroBitUtil.h"
 
+/**
+ * Finds the entry with the smallest key no less than that given, or the entry with the largest key if there is none.
+ *
+ * @param key the key to look up.
+ *
+ * @return the matching entry.
+ */
 KeyValueTableEntry* KeyValueTable::find(const uint32_t key) const
 {
-	// Now find the nearest sample range to that specified.
-	KeyValueTableEntry *p = (KeyValueTableEntry *)data + (length - 1);
-	KeyValueTableEntry *result = p;
+	// Binary search for the nearest key at or above that specified. Keys are sorted,
+	// and there is at least one entry, as CREATE_KEY_VALUE_TABLE verifies both.
+	int low = 0;
+	int high = length - 1;
 
-	while (p >= (KeyValueTableEntry *)data)
+	while (low < high)
 	{
-		if (p->key < key)
-			break;
+		int mid = (low + high) >> 1;
 
-		result = p;
-		p--;
+		if (data[mid].key < key)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	return result;
+	return (KeyValueTableEntry *)&data[low];
 }
 
 
@@ -39,7 +39,7 @@ DEALINGS IN THE SOFTWARE.
 // Configuration table for available g force ranges.
 // Maps g -> XYZ_DATA_CFG bit [0..1]
 //
-static const KeyValueTableEntry accelerometerRangeData[] = {
+static constexpr KeyValueTableEntry accelerometerRangeData[] = {
     {2,0},
     {4,1},
     {8,2}
@@ -50,7 +50,7 @@ CREATE_KEY_VALUE_TABLE(accelerometerRange, accelerometerRangeData);
 // Configuration table for available data update frequency.
 // maps microsecond period -> CTRL_REG1 data rate selection bits [3..5]
 //
-static const KeyValueTableEntry accelerometerPeriodData[] = {
+static constexpr KeyValueTableEntry accelerometerPeriodData[] = {
     {2500,0x00},
     {5000,0x08},
     {10000,0x10},
@@ -84,62 +84,78 @@ int FXOS8700::configure()
     // Now configure the accelerometer accordingly.
     // Firstly, disable the module (as some registers cannot be changed while its running).
     value = 0x00;
-    result = i2c.writeRegister(address, FXOS8700_CTRL_REG1, value);
+    result = registers.writeRegister(FXOS8700_CTRL_REG1, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Enter hybrid mode (interleave accelerometer and magnetometer samples).
-    // Also, select full oversampling on the magnetometer
+    // Also, select full oversampling on the magnetometer (M_CTRL_REG1)
     // TODO: Determine power / accuracy tradeoff here.
-    value = 0x1F;
-    result = i2c.writeRegister(address, FXOS8700_M_CTRL_REG1, value);
-    if (result != 0)
-        return MICROBIT_I2C_ERROR;
-
+    //
     // Select the auto incremement mode, which allows a contiguous I2C block
     // read of both acceleromter and magnetometer data despite them being non-contguous
-    // in memory... funky!
-    value = 0x20;
-    result = i2c.writeRegister(address, FXOS8700_M_CTRL_REG2, value);
+    // in memory... funky! (M_CTRL_REG2)
+    const uint8_t hybrid[] = {0x1F, 0x20};
+    result = registers.writeRegisters(FXOS8700_M_CTRL_REG1, hybrid, 2);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Configure Open Drain Active LOW interrupt mode.
     // n.b. This may need to be reconfigured if the interrupt line is shared.
     value = 0x01;
-    result = i2c.writeRegister(address, FXOS8700_CTRL_REG3, value);
+    result = registers.writeRegister(FXOS8700_CTRL_REG3, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
-    // Enable a data ready interrupt.
-    // TODO: This is currently PUSHPULL mode. This may nede to be reconfigured
-    // to OPEN_DRAIN if the interrupt line is shared.
-    value = 0x01;
-    result = i2c.writeRegister(address, FXOS8700_CTRL_REG4, value);
+    // When reading samples in batches, collect accelerometer samples in the FIFO until it reaches the batch size.
+    value = MicroBitAccelerometer::batchSize > 1 ? FXOS8700_F_MODE_CIRCULAR | MicroBitAccelerometer::batchSize : 0x00;
+    result = registers.writeRegister(FXOS8700_F_SETUP, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
-    // Route the data ready interrupt to INT1 pin.
-    value = 0x01;
-    result = i2c.writeRegister(address, FXOS8700_CTRL_REG5, value);
+    // Enable a data ready interrupt, or a FIFO watermark interrupt when reading samples in batches (CTRL_REG4),
+    // and route the interrupt to INT1 pin (CTRL_REG5).
+    // TODO: This is currently PUSHPULL mode. This may nede to be reconfigured
+    // to OPEN_DRAIN if the interrupt line is shared.
+    value = MicroBitAccelerometer::batchSize > 1 ? FXOS8700_INT_FIFO : FXOS8700_INT_DRDY;
+    const uint8_t interrupts[] = {value, value};
+    result = registers.writeRegisters(FXOS8700_CTRL_REG4, interrupts, 2);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Configure acceleromter g range.
     value = accelerometerRange.get(MicroBitAccelerometer::sampleRange);
-    result = i2c.writeRegister(address, FXOS8700_XYZ_DATA_CFG, value);
+    result = registers.writeRegister(FXOS8700_XYZ_DATA_CFG, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Configure sample rate and re-enable the sensor.
     value = accelerometerPeriod.get(MicroBitAccelerometer::samplePeriod * 1000) | 0x01;
-    result = i2c.writeRegister(address, FXOS8700_CTRL_REG1, value);
+    result = registers.writeRegister(FXOS8700_CTRL_REG1, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     return MICROBIT_OK;
 }
 
+/**
+ * Places the device into standby, until configure() is next called.
+ *
+ * @return DEVICE_OK on success, DEVICE_I2C_ERROR if the device could not be configured.
+ */
+int FXOS8700::standby()
+{
+    // The accelerometer and magnetometer share a single device, so only stop it once neither is in use.
+    if (!(MicroBitAccelerometer::status & MICROBIT_ACCEL_STANDBY) || !(MicroBitCompass::status & MICROBIT_COMPASS_STATUS_STANDBY))
+        return MICROBIT_OK;
+
+    // Standby mode. configure() brings the device back online.
+    if (registers.writeRegister(FXOS8700_CTRL_REG1, 0x00) != 0)
+        return MICROBIT_I2C_ERROR;
+
+    return MICROBIT_OK;
+}
+
 /**
   * Constructor.
   * Create a software abstraction of an FXSO8700 combined accelerometer/magnetometer
@@ -152,7 +168,7 @@ int FXOS8700::configure()
 FXOS8700::FXOS8700(MicroBitI2C &_i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t aid, uint16_t cid) : 
     MicroBitAccelerometer(coordinateSpace, aid),
     MicroBitCompass(coordinateSpace, cid),
-    i2c(_i2c), int1(_int1)
+    i2c(_i2c), int1(_int1), registers(_i2c, address)
 {
     // Store our identifiers.
     this->address = address;
@@ -197,57 +213,97 @@ int FXOS8700::requestUpdate()
     // Poll interrupt line from device (ACTIVE LOW)
     if(int1.getDigitalValue() == 0)
     {
-        uint8_t data[12];
+        uint8_t buffer[6 * (MICROBIT_ACCELEROMETER_FIFO_SIZE + 1) + 1];
+        uint8_t *data = buffer;
         int16_t s;
         uint8_t *lsb = (uint8_t *) &s;
         uint8_t *msb = lsb + 1;
         Sample3D accelerometerSample;
         Sample3D compassSample;
         int result;
-
-        // Read the combined accelerometer and magnetometer data.
-        result = i2c.readRegister(address, FXOS8700_OUT_X_MSB, data, 12);
+        int count = 1;
+        uint8_t *compassData = &data[6];
+
+        if (MicroBitAccelerometer::batchSize > 1)
+        {
+            // The FIFO holds only accelerometer samples. In FIFO mode, the register address wraps around to
+            // FXOS8700_OUT_X_MSB after each sample, so the status register (F_STATUS) and a whole burst can be
+            // read at once. The watermark interrupt ensures at least a batch is waiting. The latest magnetometer
+            // sample is read separately, queued behind the burst so that the bus moves straight on to it.
+            MicroBitI2CTransfer accelerometerTransfer;
+            MicroBitI2CTransfer compassTransfer;
+
+            count = MicroBitAccelerometer::batchSize;
+            data = &buffer[1];
+            compassData = &data[6 * count];
+
+            i2c.readRegisterAsync(accelerometerTransfer, address, FXOS8700_STATUS_REG, buffer, 6 * count + 1);
+            i2c.readRegisterAsync(compassTransfer, address, FXOS8700_M_OUT_X_MSB, compassData, 6);
+
+            result = i2c.wait(accelerometerTransfer);
+
+            if (i2c.wait(compassTransfer) != MICROBIT_OK)
+                result = MICROBIT_I2C_ERROR;
+
+            // Discard any slots read beyond the samples actually held, should the interrupt have been spurious.
+            count = min(buffer[0] & FXOS8700_F_CNT, count);
+
+            if (result == MICROBIT_OK && count == 0)
+                return MICROBIT_OK;
+        }
+        else
+        {
+            // Read the combined accelerometer and magnetometer data.
+            result = registers.readRegisters(FXOS8700_OUT_X_MSB, data, 12);
+        }
 
         if (result !=0)
             return MICROBIT_I2C_ERROR;
 
-        
-        // read sensor data (and translate into signed little endian)
-        *msb = data[0];
-        *lsb = data[1];
-        accelerometerSample.x = s;
+        MicroBitAccelerometer::batchLength = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            // read sensor data (and translate into signed little endian)
+            *msb = data[6*i];
+            *lsb = data[6*i + 1];
+            accelerometerSample.x = s;
+
+            *msb = data[6*i + 2];
+            *lsb = data[6*i + 3];
+            accelerometerSample.y = s;
 
-        *msb = data[2];
-        *lsb = data[3];
-        accelerometerSample.y = s;
+            *msb = data[6*i + 4];
+            *lsb = data[6*i + 5];
+            accelerometerSample.z = s;
 
-        *msb = data[4];
-        *lsb = data[5];
-        accelerometerSample.z = s;
+            // scale the 14 bit accelerometer data (packed into 16 bits) into SI units (milli-g), and translate to ENU coordinate system
+            MicroBitAccelerometer::sampleENU.x = (-accelerometerSample.y * MicroBitAccelerometer::sampleRange) / 32;
+            MicroBitAccelerometer::sampleENU.y = (accelerometerSample.x * MicroBitAccelerometer::sampleRange) / 32;
+            MicroBitAccelerometer::sampleENU.z = (accelerometerSample.z * MicroBitAccelerometer::sampleRange) / 32;
 
-        *msb = data[6];
-        *lsb = data[7];
+            MicroBitAccelerometer::addSample();
+        }
+
+        *msb = compassData[0];
+        *lsb = compassData[1];
         compassSample.x = s;
 
-        *msb = data[8];
-        *lsb = data[9];
+        *msb = compassData[2];
+        *lsb = compassData[3];
         compassSample.y = s;
 
-        *msb = data[10];
-        *lsb = data[11];
+        *msb = compassData[4];
+        *lsb = compassData[5];
         compassSample.z = s;
 
-        // scale the 14 bit accelerometer data (packed into 16 bits) into SI units (milli-g), and translate to ENU coordinate system
-        MicroBitAccelerometer::sampleENU.x = (-accelerometerSample.y * MicroBitAccelerometer::sampleRange) / 32;
-        MicroBitAccelerometer::sampleENU.y = (accelerometerSample.x * MicroBitAccelerometer::sampleRange) / 32;
-        MicroBitAccelerometer::sampleENU.z = (accelerometerSample.z * MicroBitAccelerometer::sampleRange) / 32;
-
         // translate magnetometer data into ENU coordinate system and normalise into nano-teslas
         MicroBitCompass::sampleENU.x = FXOS8700_NORMALIZE_SAMPLE(-compassSample.y);
         MicroBitCompass::sampleENU.y = FXOS8700_NORMALIZE_SAMPLE(compassSample.x);
         MicroBitCompass::sampleENU.z = FXOS8700_NORMALIZE_SAMPLE(compassSample.z);
 
-        MicroBitAccelerometer::update();
+        // indicate that new data is available.
+        MicroBitEvent e(MicroBitAccelerometer::id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
         MicroBitCompass::update();
     }
 
@@ -262,7 +318,12 @@ int FXOS8700::requestUpdate()
   */
 void FXOS8700::idleTick()
 {
-    requestUpdate();
+    // Both halves need a chance to time out, so evaluate each.
+    int accelerometerSampling = MicroBitAccelerometer::isSampling();
+    int compassSampling = MicroBitCompass::isSampling();
+
+    if (accelerometerSampling || compassSampling)
+        requestUpdate();
 }
 
 /**
@@ -39,7 +39,7 @@ DEALINGS IN THE SOFTWARE.
 // Configuration table for available g force ranges.
 // Maps g ->  CTRL_REG4 full scale selection bits [4..5]
 //
-static const KeyValueTableEntry accelerometerRangeData[] = {
+static constexpr KeyValueTableEntry accelerometerRangeData[] = {
     {2, 0x00},
     {4, 0x10},
     {8, 0x20},
@@ -51,7 +51,7 @@ CREATE_KEY_VALUE_TABLE(accelerometerRange, accelerometerRangeData);
 // Configuration table for available data update frequency.
 // maps microsecond period -> CTRL_REG1 data rate selection bits [4..7]
 //
-static const KeyValueTableEntry accelerometerPeriodData[] = {
+static constexpr KeyValueTableEntry accelerometerPeriodData[] = {
     {617, 0x80},
     {744, 0x90},
     {2500, 0x70},
@@ -73,7 +73,7 @@ CREATE_KEY_VALUE_TABLE(accelerometerPeriod, accelerometerPeriodData);
  * @param id The unique EventModel id of this component. Defaults to: MICROBIT_ID_ACCELEROMETER
  *
  */
-LSM303Accelerometer::LSM303Accelerometer(MicroBitI2C& _i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitAccelerometer(coordinateSpace, id), i2c(_i2c), int1(_int1)
+LSM303Accelerometer::LSM303Accelerometer(MicroBitI2C& _i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitAccelerometer(coordinateSpace, id), i2c(_i2c), int1(_int1), registers(_i2c, address, 0x80)
 {
     // Store our identifiers.
     this->status = 0;
@@ -105,23 +105,44 @@ int LSM303Accelerometer::configure()
     // Now configure the accelerometer accordingly.
 
     // Place the device into normal (10 bit) mode, with all axes enabled at the nearest supported data rate to that  requested.
-    result = i2c.writeRegister(address, LSM303_CTRL_REG1_A, accelerometerPeriod.get(samplePeriod * 1000) | 0x07);
+    result = registers.writeRegister(LSM303_CTRL_REG1_A, accelerometerPeriod.get(samplePeriod * 1000) | 0x07);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
-    // Enable the DRDY1 interrupt on INT1 pin.
-    result = i2c.writeRegister(address, LSM303_CTRL_REG3_A, 0x10);
+    // When reading samples in batches, stream samples into the FIFO and interrupt on INT1 once it reaches the
+    // batch size. Otherwise, bypass the FIFO and interrupt on INT1 as each sample becomes ready (CTRL_REG3_A, CTRL_REG5_A).
+    // Select the g range to that requested, using little endian data format and disable self-test and high rate functions (CTRL_REG4_A).
+    const uint8_t control[] = {
+        batchSize > 1 ? LSM303_A_INT1_WTM : LSM303_A_INT1_DRDY1,
+        (uint8_t) (0x80 | accelerometerRange.get(sampleRange)),
+        batchSize > 1 ? LSM303_A_FIFO_EN : 0x00
+    };
+
+    result = registers.writeRegisters(LSM303_CTRL_REG3_A, control, 3);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
-    // Select the g range to that requested, using little endian data format and disable self-test and high rate functions.
-    result = i2c.writeRegister(address, LSM303_CTRL_REG4_A, 0x80 | accelerometerRange.get(sampleRange));
+    result = registers.writeRegister(LSM303_FIFO_CTRL_REG_A, batchSize > 1 ? LSM303_A_FIFO_MODE_STREAM | (batchSize - 1) : 0x00);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     return MICROBIT_OK;
 }
 
+/**
+ * Places the accelerometer into standby, until configure() is next called.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured.
+ */
+int LSM303Accelerometer::standby()
+{
+    // Power down mode. configure() restores the data rate.
+    if (registers.writeRegister(LSM303_CTRL_REG1_A, 0x00) != 0)
+        return MICROBIT_I2C_ERROR;
+
+    return MICROBIT_OK;
+}
+
 /**
  * Poll to see if new data is available from the hardware. If so, update it.
  * n.b. it is not necessary to explicitly call this funciton to update data
@@ -146,35 +167,45 @@ int LSM303Accelerometer::requestUpdate()
     // Poll interrupt line from device (ACTIVE HI)
     if(int1.getDigitalValue())
     {
-        uint8_t data[6];
+        uint8_t data[6 * MICROBIT_ACCELEROMETER_FIFO_SIZE];
         int result;
+        int count = batchSize;
         int16_t *x;
         int16_t *y;
         int16_t *z;
 
-
-        // Read the combined accelerometer and magnetometer data.
-        result = i2c.readRegister(address, LSM303_OUT_X_L_A | 0x80, data, 6);
+        // Read the accelerometer data. In FIFO mode, the register address wraps around to
+        // LSM303_OUT_X_L_A after each sample, so the whole burst can be read at once.
+        // The watermark interrupt is only raised once the FIFO holds more than (batchSize - 1)
+        // samples, so there is no need to read LSM303_FIFO_SRC_REG_A first.
+        result = registers.readRegisters(LSM303_OUT_X_L_A, data, 6 * count);
 
         if (result !=0)
             return MICROBIT_I2C_ERROR;
 
-        // Read in each reading as a 16 bit little endian value, and scale to 10 bits.
-        x = ((int16_t *) &data[0]);
-        y = ((int16_t *) &data[2]);
-        z = ((int16_t *) &data[4]);
+        batchLength = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            // Read in each reading as a 16 bit little endian value, and scale to 10 bits.
+            x = ((int16_t *) &data[6*i]);
+            y = ((int16_t *) &data[6*i + 2]);
+            z = ((int16_t *) &data[6*i + 4]);
+
+            *x = *x / 32;
+            *y = *y / 32;
+            *z = *z / 32;
 
-        *x = *x / 32;
-        *y = *y / 32;
-        *z = *z / 32;
+            // Scale into millig (approx) and align to ENU coordinate system
+            sampleENU.x = -((int)(*y)) * sampleRange;
+            sampleENU.y = -((int)(*x)) * sampleRange;
+            sampleENU.z =  ((int)(*z)) * sampleRange;
 
-        // Scale into millig (approx) and align to ENU coordinate system
-        sampleENU.x = -((int)(*y)) * sampleRange;
-        sampleENU.y = -((int)(*x)) * sampleRange;
-        sampleENU.z =  ((int)(*z)) * sampleRange;
+            addSample();
+        }
 
         // indicate that new data is available.
-        update();
+        MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
     }
 
     return MICROBIT_OK;
@@ -187,7 +218,9 @@ int LSM303Accelerometer::requestUpdate()
   */
 void LSM303Accelerometer::idleTick()
 {
-    requestUpdate();
+    // Stop sampling once nothing is reading the accelerometer, or listening for its events.
+    if (isSampling())
+        requestUpdate();
 }
 
 /**
@@ -37,7 +37,7 @@ DEALINGS IN THE SOFTWARE.
 // Configuration table for available data update frequency.
 // maps microsecond period -> LSM303_CFG_REG_A_M data rate selection bits [2..3]
 //
-static const KeyValueTableEntry magnetometerPeriodData[] = {
+static constexpr KeyValueTableEntry magnetometerPeriodData[] = {
     {10000, 0x0C},             // 100 Hz
     {20000, 0x08},             // 50 Hz
     {50000, 0x04},             // 20 Hz
@@ -63,18 +63,32 @@ int LSM303Magnetometer::configure()
 
     // Now configure the magnetometer for the requested sample rate, low power continuous mode with temperature compensation disabled
     // TODO: Review if temperature compensation improves performance.
-    result = i2c.writeRegister(address, LSM303_CFG_REG_A_M, magnetometerPeriod.get(samplePeriod * 1000));
+    result = registers.writeRegister(LSM303_CFG_REG_A_M, magnetometerPeriod.get(samplePeriod * 1000));
     if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
     // Enable Data Ready interrupt, with buffering of data to avoid race conditions.
-    result = i2c.writeRegister(address, LSM303_CFG_REG_C_M, 0x01);
+    result = registers.writeRegister(LSM303_CFG_REG_C_M, 0x01);
     if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
     return MICROBIT_OK;
 }
 
+/**
+ * Places the compass into standby, until configure() is next called.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured.
+ */
+int LSM303Magnetometer::standby()
+{
+    // Idle mode, retaining the data rate. configure() returns the device to continuous mode.
+    if (registers.writeRegister(LSM303_CFG_REG_A_M, magnetometerPeriod.get(samplePeriod * 1000) | LSM303_M_MODE_IDLE) != MICROBIT_OK)
+        return MICROBIT_I2C_ERROR;
+
+    return MICROBIT_OK;
+}
+
 /**
   * Constructor.
   * Create a software abstraction of an FXSO8700 combined magnetometer/magnetometer
@@ -84,7 +98,7 @@ int LSM303Magnetometer::configure()
   * @param address the default I2C address of the magnetometer. Defaults to: FXS8700_DEFAULT_ADDR.
   *
  */
-LSM303Magnetometer::LSM303Magnetometer(MicroBitI2C &_i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitCompass(coordinateSpace, id), i2c(_i2c), int1(_int1)
+LSM303Magnetometer::LSM303Magnetometer(MicroBitI2C &_i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitCompass(coordinateSpace, id), i2c(_i2c), int1(_int1), registers(_i2c, address, 0x80)
 {
     // Store our identifiers.
     this->address = address;
@@ -125,7 +139,7 @@ int LSM303Magnetometer::requestUpdate()
 
 
         // Read the combined accelerometer and magnetometer data.
-        result = i2c.readRegister(address, LSM303_OUTX_L_REG_M | 0x80, data, 6);
+        result = registers.readRegisters(LSM303_OUTX_L_REG_M, data, 6);
 
         if (result !=0)
             return MICROBIT_I2C_ERROR;
@@ -157,7 +171,9 @@ int LSM303Magnetometer::requestUpdate()
   */
 void LSM303Magnetometer::idleTick()
 {
-    requestUpdate();
+    // Stop sampling once nothing is reading the compass, or listening for its events.
+    if (isSampling())
+        requestUpdate();
 }
 
 /**
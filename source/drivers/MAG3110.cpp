@@ -37,7 +37,7 @@ DEALINGS IN THE SOFTWARE.
 // Configuration table for available data update frequency.
 // maps microsecond period -> CTRL_REG1 data rate selection bits [3..5]
 //
-static const KeyValueTableEntry magnetometerPeriodData[] = {
+static constexpr KeyValueTableEntry magnetometerPeriodData[] = {
     {12500,      0x00},        // 80 Hz
     {25000,      0x20},        // 40 Hz
     {50000,      0x40},        // 20 Hz
@@ -67,7 +67,7 @@ int MAG3110::configure()
     uint8_t value;
 
     // First, take the device offline, so it can be configured.
-    result = i2c.writeRegister(address, MAG_CTRL_REG1, 0x00);
+    result = registers.writeRegister(MAG_CTRL_REG1, 0x00);
     if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
@@ -76,7 +76,7 @@ int MAG3110::configure()
     {
         // Read the status of the part...
         // If we can't communicate with it over I2C, pass on the error.
-        result = i2c.readRegister(address,MAG_SYSMOD, &value, 1);
+        result = registers.readRegisters(MAG_SYSMOD, &value, 1);
         if (result == MICROBIT_I2C_ERROR)
             return MICROBIT_I2C_ERROR;
 
@@ -93,19 +93,33 @@ int MAG3110::configure()
 
     // Now configure the magnetometer accordingly.
     // Enable automatic reset after each sample;
-    result = i2c.writeRegister(address, MAG_CTRL_REG2, 0xA0);
+    result = registers.writeRegister(MAG_CTRL_REG2, 0xA0);
     if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
 
     // Bring the device online, with the requested sample frequency.
-    result = i2c.writeRegister(address, MAG_CTRL_REG1, magnetometerPeriod.get(samplePeriod * 1000) | 0x01);
+    result = registers.writeRegister(MAG_CTRL_REG1, magnetometerPeriod.get(samplePeriod * 1000) | 0x01);
     if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
     return MICROBIT_OK;
 }
 
+/**
+ * Places the compass into standby, until configure() is next called.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured.
+ */
+int MAG3110::standby()
+{
+    // Standby mode. configure() brings the device back online.
+    if (registers.writeRegister(MAG_CTRL_REG1, 0x00) != MICROBIT_OK)
+        return MICROBIT_I2C_ERROR;
+
+    return MICROBIT_OK;
+}
+
 /**
   * Constructor.
   * Create a software abstraction of an FXSO8700 combined magnetometer/magnetometer
@@ -115,7 +129,7 @@ int MAG3110::configure()
   * @param address the default I2C address of the magnetometer. Defaults to: FXS8700_DEFAULT_ADDR.
   *
  */
-MAG3110::MAG3110(MicroBitI2C &_i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitCompass(coordinateSpace, id), i2c(_i2c), int1(_int1)
+MAG3110::MAG3110(MicroBitI2C &_i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitCompass(coordinateSpace, id), i2c(_i2c), int1(_int1), registers(_i2c, address)
 {
     // Store our identifiers.
     this->address = address;
@@ -155,7 +169,7 @@ int MAG3110::requestUpdate()
         int result;
 
         // Read the combined magnetometer and magnetometer data.
-        result = i2c.readRegister(address, MAG_OUT_X_MSB, data, 6);
+        result = registers.readRegisters(MAG_OUT_X_MSB, data, 6);
 
         if (result !=0)
             return MICROBIT_I2C_ERROR;
@@ -187,7 +201,9 @@ int MAG3110::requestUpdate()
   */
 void MAG3110::idleTick()
 {
-    requestUpdate();
+    // Stop sampling once nothing is reading the compass, or listening for its events.
+    if (isSampling())
+        requestUpdate();
 }
 
 /**
@@ -39,7 +39,7 @@ DEALINGS IN THE SOFTWARE.
 // Configuration table for available g force ranges.
 // Maps g -> XYZ_DATA_CFG bit [0..1]
 //
-static const KeyValueTableEntry accelerometerRangeData[] = {
+static constexpr KeyValueTableEntry accelerometerRangeData[] = {
     {2, 0},
     {4, 1},
     {8, 2}
@@ -50,7 +50,7 @@ CREATE_KEY_VALUE_TABLE(accelerometerRange, accelerometerRangeData);
 // Configuration table for available data update frequency.
 // maps microsecond period -> CTRL_REG1 data rate selection bits [3..5]
 //
-static const KeyValueTableEntry accelerometerPeriodData[] = {
+static constexpr KeyValueTableEntry accelerometerPeriodData[] = {
     {1250,      0x00},
     {2500,      0x08},
     {5000,      0x10},
@@ -71,7 +71,7 @@ CREATE_KEY_VALUE_TABLE(accelerometerPeriod, accelerometerPeriodData);
  * @param id The unique EventModel id of this component. Defaults to: MICROBIT_ID_ACCELEROMETER
  *
  */
-MMA8653::MMA8653(MicroBitI2C& _i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitAccelerometer(coordinateSpace, id), i2c(_i2c), int1(_int1)
+MMA8653::MMA8653(MicroBitI2C& _i2c, MicroBitPin _int1, CoordinateSpace &coordinateSpace, uint16_t address, uint16_t id) : MicroBitAccelerometer(coordinateSpace, id), i2c(_i2c), int1(_int1), registers(_i2c, address)
 {
     // Store our identifiers.
     this->status = 0;
@@ -101,43 +101,56 @@ int MMA8653::configure()
     samplePeriod = accelerometerPeriod.getKey(samplePeriod * 1000) / 1000;
     sampleRange = accelerometerRange.getKey(sampleRange);
 
+    // The MMA8653 has no FIFO, so samples are always read one at a time.
+    batchSize = 1;
+
     // Now configure the accelerometer accordingly.
 
     // First place the device into standby mode, so it can be configured.
-    result = i2c.writeRegister(address, MMA8653_CTRL_REG1, 0x00);
+    result = registers.writeRegister(MMA8653_CTRL_REG1, 0x00);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Enable high precisiosn mode. This consumes a bit more power, but still only 184 uA!
-    result = i2c.writeRegister(address, MMA8653_CTRL_REG2, 0x10);
-    if (result != 0)
-        return MICROBIT_I2C_ERROR;
-
-    // Enable the INT1 interrupt pin.
-    result = i2c.writeRegister(address, MMA8653_CTRL_REG4, 0x01);
+    result = registers.writeRegister(MMA8653_CTRL_REG2, 0x10);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
-    // Select the DATA_READY event source to be routed to INT1
-    result = i2c.writeRegister(address, MMA8653_CTRL_REG5, 0x01);
+    // Enable the DATA_READY interrupt (CTRL_REG4), and route it to the INT1 pin (CTRL_REG5).
+    const uint8_t interrupts[] = {0x01, 0x01};
+    result = registers.writeRegisters(MMA8653_CTRL_REG4, interrupts, 2);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Configure for the selected g range.
     value = accelerometerRange.get(sampleRange);
-    result = i2c.writeRegister(address, MMA8653_XYZ_DATA_CFG, value);
+    result = registers.writeRegister(MMA8653_XYZ_DATA_CFG, value);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     // Bring the device back online, with 10bit wide samples at the requested frequency.
     value = accelerometerPeriod.get(samplePeriod * 1000);
-    result = i2c.writeRegister(address, MMA8653_CTRL_REG1, value | 0x01);
+    result = registers.writeRegister(MMA8653_CTRL_REG1, value | 0x01);
     if (result != 0)
         return MICROBIT_I2C_ERROR;
 
     return MICROBIT_OK;
 }
 
+/**
+ * Places the accelerometer into standby, until configure() is next called.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured.
+ */
+int MMA8653::standby()
+{
+    // Standby mode. configure() brings the device back online.
+    if (registers.writeRegister(MMA8653_CTRL_REG1, 0x00) != 0)
+        return MICROBIT_I2C_ERROR;
+
+    return MICROBIT_OK;
+}
+
 /**
  * Poll to see if new data is available from the hardware. If so, update it.
  * n.b. it is not necessary to explicitly call this funciton to update data
@@ -166,7 +179,7 @@ int MMA8653::requestUpdate()
         Sample3D s;
 
         // Read the combined accelerometer and magnetometer data.
-        result = i2c.readRegister(address, MMA8653_OUT_X_MSB, (uint8_t *)data, 6);
+        result = registers.readRegisters(MMA8653_OUT_X_MSB, (uint8_t *)data, 6);
 
         if (result !=0)
             return MICROBIT_I2C_ERROR;
@@ -202,7 +215,9 @@ int MMA8653::requestUpdate()
   */
 void MMA8653::idleTick()
 {
-    requestUpdate();
+    // Stop sampling once nothing is reading the accelerometer, or listening for its events.
+    if (isSampling())
+        requestUpdate();
 }
 
 /**
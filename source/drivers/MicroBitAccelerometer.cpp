@@ -27,7 +27,9 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitEvent.h"
 #include "MicroBitCompat.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 #include "MicroBitDevice.h"
+#include "MicroBitOrientation.h"
 
 #include "MicroBitI2C.h"
 #include "MMA8653.h"
@@ -66,6 +68,17 @@ MicroBitAccelerometer::MicroBitAccelerometer(CoordinateSpace &cspace, uint16_t i
     this->shake.impulse_3 = 1;
     this->shake.impulse_6 = 1;
     this->shake.impulse_8 = 1;
+
+    // Read samples one at a time, until requested otherwise.
+    this->batchSize = 1;
+    this->batchLength = 0;
+    this->batch = NULL;
+
+    // Sample until we've gone unused for a while, and resume as soon as anyone starts listening for our events.
+    this->accessTime = 0;
+
+    if (EventModel::defaultEventBus)
+        EventModel::defaultEventBus->listen(MICROBIT_ID_MESSAGE_BUS_LISTENER, MICROBIT_EVT_ANY, this, &MicroBitAccelerometer::onListenerRegistered);
 }
 
 /**
@@ -79,48 +92,99 @@ MicroBitAccelerometer::MicroBitAccelerometer(CoordinateSpace &cspace, uint16_t i
 MicroBitAccelerometer& MicroBitAccelerometer::autoDetect(MicroBitI2C &i2c)
 {
     if (MicroBitAccelerometer::detectedAccelerometer == NULL)
-    {
-        // Configuration of IRQ lines
-        MicroBitPin int1(MICROBIT_ID_IO_INT1, P0_28, PIN_CAPABILITY_STANDARD);
-        MicroBitPin int2(MICROBIT_ID_IO_INT2, P0_29, PIN_CAPABILITY_STANDARD);
-        MicroBitPin int3(MICROBIT_ID_IO_INT3, P0_27, PIN_CAPABILITY_STANDARD);
+        detect(i2c, NULL);
 
-        // All known accelerometer/magnetometer peripherals have the same alignment
-        CoordinateSpace &coordinateSpace = *(new CoordinateSpace(SIMPLE_CARTESIAN, true, COORDINATE_SPACE_ROTATED_0));
+    if (MicroBitCompass::detectedCompass)
+        MicroBitCompass::detectedCompass->setAccelerometer(*MicroBitAccelerometer::detectedAccelerometer);
 
-        // Now, probe for connected peripherals, if none have already been found.
-        if (MMA8653::isDetected(i2c))
-            MicroBitAccelerometer::detectedAccelerometer = new MMA8653(i2c, int1, coordinateSpace);
+    return *MicroBitAccelerometer::detectedAccelerometer;
+}
 
-        else if (LSM303Accelerometer::isDetected(i2c))
-            MicroBitAccelerometer::detectedAccelerometer = new LSM303Accelerometer(i2c, int1, coordinateSpace);
+/**
+ * Device autodetection, remembering the device found.
+ *
+ * The device found on a previous boot is confirmed with a single WHO_AM_I read, and the
+ * bus is only scanned for every supported device if it does not respond.
+ *
+ * @param i2c the bus to scan.
+ * @param storage the storage used to record the device found.
+ *
+ */
+MicroBitAccelerometer& MicroBitAccelerometer::autoDetect(MicroBitI2C &i2c, MicroBitStorage &storage)
+{
+    if (MicroBitAccelerometer::detectedAccelerometer == NULL)
+        detect(i2c, &storage);
 
-        else if (FXOS8700::isDetected(i2c))
-        {
-            FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace);
-            MicroBitAccelerometer::detectedAccelerometer = fxos;
-            MicroBitCompass::detectedCompass = fxos;
-        }
+    if (MicroBitCompass::detectedCompass)
+        MicroBitCompass::detectedCompass->setAccelerometer(*MicroBitAccelerometer::detectedAccelerometer);
 
-        // Insert this case to support FXOS on the microbit1.5-SN
-        //else if (FXOS8700::isDetected(i2c, 0x3A))
-        //{
-        //    FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace, 0x3A);
-        //    MicroBitAccelerometer::detectedAccelerometer = fxos;
-        //    MicroBitCompass::detectedCompass = fxos;
-        //}
+    return *MicroBitAccelerometer::detectedAccelerometer;
+}
 
-        else
-        {
-            MicroBitAccelerometer *unavailable =  new MicroBitAccelerometer(coordinateSpace, MICROBIT_ID_ACCELEROMETER);
-            MicroBitAccelerometer::detectedAccelerometer = unavailable;
-        }
+/**
+ * Scans the given I2C bus for supported accelerometer devices, starting with the one recorded in storage (if any),
+ * and constructs an appropriate driver.
+ *
+ * @param i2c the bus to scan.
+ * @param storage the storage used to record the device found, or NULL to scan every time.
+ */
+void MicroBitAccelerometer::detect(MicroBitI2C &i2c, MicroBitStorage *storage)
+{
+    uint8_t cached = MICROBIT_ACCELEROMETER_NONE;
+    uint8_t device = MICROBIT_ACCELEROMETER_NONE;
+
+    // Configuration of IRQ lines
+    MicroBitPin int1(MICROBIT_ID_IO_INT1, P0_28, PIN_CAPABILITY_STANDARD);
+    MicroBitPin int2(MICROBIT_ID_IO_INT2, P0_29, PIN_CAPABILITY_STANDARD);
+    MicroBitPin int3(MICROBIT_ID_IO_INT3, P0_27, PIN_CAPABILITY_STANDARD);
+
+    // All known accelerometer/magnetometer peripherals have the same alignment
+    CoordinateSpace &coordinateSpace = *(new CoordinateSpace(SIMPLE_CARTESIAN, true, COORDINATE_SPACE_ROTATED_0));
+
+    if (storage)
+        storage->get(MICROBIT_ACCELEROMETER_STORAGE_KEY, &cached, 1);
+
+    // Confirm the device found last time is still there, before probing for every device we know of.
+    // Each probe of an absent device can take MICROBIT_I2C_MAX_RETRIES attempts to fail.
+    if ((cached == MICROBIT_ACCELEROMETER_MMA8653 && MMA8653::isDetected(i2c)) ||
+        (cached == MICROBIT_ACCELEROMETER_LSM303 && LSM303Accelerometer::isDetected(i2c)) ||
+        (cached == MICROBIT_ACCELEROMETER_FXOS8700 && FXOS8700::isDetected(i2c)))
+        device = cached;
+
+    else if (MMA8653::isDetected(i2c))
+        device = MICROBIT_ACCELEROMETER_MMA8653;
+
+    else if (LSM303Accelerometer::isDetected(i2c))
+        device = MICROBIT_ACCELEROMETER_LSM303;
+
+    else if (FXOS8700::isDetected(i2c))
+        device = MICROBIT_ACCELEROMETER_FXOS8700;
+
+    // Insert this case to support FXOS on the microbit1.5-SN
+    //else if (FXOS8700::isDetected(i2c, 0x3A))
+
+    if (device == MICROBIT_ACCELEROMETER_MMA8653)
+        MicroBitAccelerometer::detectedAccelerometer = new MMA8653(i2c, int1, coordinateSpace);
+
+    else if (device == MICROBIT_ACCELEROMETER_LSM303)
+        MicroBitAccelerometer::detectedAccelerometer = new LSM303Accelerometer(i2c, int1, coordinateSpace);
+
+    else if (device == MICROBIT_ACCELEROMETER_FXOS8700)
+    {
+        FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace);
+        MicroBitAccelerometer::detectedAccelerometer = fxos;
+        MicroBitCompass::detectedCompass = fxos;
     }
 
-    if (MicroBitCompass::detectedCompass)
-        MicroBitCompass::detectedCompass->setAccelerometer(*MicroBitAccelerometer::detectedAccelerometer);
+    else
+    {
+        MicroBitAccelerometer *unavailable =  new MicroBitAccelerometer(coordinateSpace, MICROBIT_ID_ACCELEROMETER);
+        MicroBitAccelerometer::detectedAccelerometer = unavailable;
+    }
 
-    return *MicroBitAccelerometer::detectedAccelerometer;
+    // Only record a device that was found, so that a missing one is looked for again next time.
+    if (storage && device != MICROBIT_ACCELEROMETER_NONE && device != cached)
+        storage->put(MICROBIT_ACCELEROMETER_STORAGE_KEY, &device, 1);
 }
 
 
@@ -137,21 +201,47 @@ MicroBitAccelerometer& MicroBitAccelerometer::autoDetect(MicroBitI2C &i2c)
   * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the read request fails.
   */
 int MicroBitAccelerometer::update()
+{
+    // This sample forms a batch on its own.
+    batchLength = 0;
+    addSample();
+
+    // Indicate that a new sample is available
+    MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
+
+    return MICROBIT_OK;
+};
+
+/**
+ * Stores the sample in sampleENU as the latest sample, appends it to the batch buffer and
+ * performs gesture tracking, without raising an event.
+ *
+ * Drivers reading a burst of samples call this for each sample, having reset batchLength,
+ * and then raise a single MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event.
+ */
+void MicroBitAccelerometer::addSample()
 {
     // Store the new data, after performing any necessary coordinate transformations.
     sample = coordinateSpace.transform(sampleENU);
 
+    if (batch && batchLength < batchSize)
+        batch[batchLength++] = sample;
+
+    stream.push(sample);
+
+    // The batch and stream hold every sample, but the latest sample is filtered if requested.
+    if (filter.getType() != MICROBIT_FILTER_NONE)
+    {
+        sampleENU = filter.push(sampleENU);
+        sample = coordinateSpace.transform(sampleENU);
+    }
+
     // Indicate that pitch and roll data is now stale, and needs to be recalculated if needed.
     status &= ~MICROBIT_ACCELEROMETER_IMU_DATA_VALID;
 
     // Update gesture tracking
     updateGesture();
-
-    // Indicate that a new sample is available
-    MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
-
-    return MICROBIT_OK;
-};
+}
 
 /**
   * A service function.
@@ -174,11 +264,15 @@ uint32_t MicroBitAccelerometer::instantaneousAccelerationSquared()
  *
  * This makes no use of historic data, and forms the input to the filter implemented in updateGesture().
  *
+ * @param force the squared magnitude of the current sample, as given by instantaneousAccelerationSquared().
+ *
  * @return A 'best guess' of the current posture of the device, based on instanataneous data.
  */
-uint16_t MicroBitAccelerometer::instantaneousPosture()
+uint16_t MicroBitAccelerometer::instantaneousPosture(uint32_t force)
 {
-    bool shakeDetected = false;
+    int ax = abs(sample.x);
+    int ay = abs(sample.y);
+    int az = abs(sample.z);
 
     // Test for shake events.
     // We detect a shake by measuring zero crossings in each axis. In other words, if we see a strong acceleration to the left followed by
@@ -186,37 +280,45 @@ uint16_t MicroBitAccelerometer::instantaneousPosture()
     //
     // If we see enough zero crossings in succession (MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD), then we decide that the device
     // has been shaken.
-    if ((sample.x < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.x) || (sample.x > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.x))
+    //
+    // A crossing needs a strong acceleration in some axis, so most samples skip the per axis tests entirely.
+    if (ax > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE || ay > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE || az > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE)
     {
-        shakeDetected = true;
-        shake.x = !shake.x;
-    }
+        bool shakeDetected = false;
 
-    if ((sample.y < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.y) || (sample.y > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.y))
-    {
-        shakeDetected = true;
-        shake.y = !shake.y;
-    }
-
-    if ((sample.z < -MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && shake.z) || (sample.z > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && !shake.z))
-    {
-        shakeDetected = true;
-        shake.z = !shake.z;
-    }
+        // An axis crosses when its sign differs from the direction last recorded for it.
+        if (ax > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && (sample.x > 0) != shake.x)
+        {
+            shakeDetected = true;
+            shake.x = !shake.x;
+        }
 
-    // If we detected a zero crossing in this sample period, count this.
-    if (shakeDetected && shake.count < MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD)
-    {
-        shake.count++;
+        if (ay > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && (sample.y > 0) != shake.y)
+        {
+            shakeDetected = true;
+            shake.y = !shake.y;
+        }
 
-        if (shake.count == 1)
-            shake.timer = 0;
+        if (az > MICROBIT_ACCELEROMETER_SHAKE_TOLERANCE && (sample.z > 0) != shake.z)
+        {
+            shakeDetected = true;
+            shake.z = !shake.z;
+        }
 
-        if (shake.count == MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD)
+        // If we detected a zero crossing in this sample period, count this.
+        if (shakeDetected && shake.count < MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD)
         {
-            shake.shaken = 1;
-            shake.timer = 0;
-            return MICROBIT_ACCELEROMETER_EVT_SHAKE;
+            shake.count++;
+
+            if (shake.count == 1)
+                shake.timer = 0;
+
+            if (shake.count == MICROBIT_ACCELEROMETER_SHAKE_COUNT_THRESHOLD)
+            {
+                shake.shaken = 1;
+                shake.timer = 0;
+                return MICROBIT_ACCELEROMETER_EVT_SHAKE;
+            }
         }
     }
 
@@ -237,32 +339,35 @@ uint16_t MicroBitAccelerometer::instantaneousPosture()
         else if (!shake.shaken && shake.timer >= MICROBIT_ACCELEROMETER_SHAKE_DAMPING)
         {
             shake.timer = 0;
-            if (shake.count > 0)
-                shake.count--;
+            shake.count--;
         }
     }
 
-    uint32_t force = instantaneousAccelerationSquared();
     if (force < MICROBIT_ACCELEROMETER_FREEFALL_THRESHOLD)
         return MICROBIT_ACCELEROMETER_EVT_FREEFALL;
 
-    // Determine our posture.
-    if (sample.x < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    // Determine our posture. Most samples are in none of the tilted postures, so test for that first.
+    const int tilt = 1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE;
+
+    if (ax <= tilt && ay <= tilt && az <= tilt)
+        return MICROBIT_ACCELEROMETER_EVT_NONE;
+
+    if (sample.x < -tilt)
         return MICROBIT_ACCELEROMETER_EVT_TILT_LEFT;
 
-    if (sample.x > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (sample.x > tilt)
         return MICROBIT_ACCELEROMETER_EVT_TILT_RIGHT;
 
-    if (sample.y < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (sample.y < -tilt)
         return MICROBIT_ACCELEROMETER_EVT_TILT_DOWN;
 
-    if (sample.y > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (sample.y > tilt)
         return MICROBIT_ACCELEROMETER_EVT_TILT_UP;
 
-    if (sample.z < (-1000 + MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (sample.z < -tilt)
         return MICROBIT_ACCELEROMETER_EVT_FACE_UP;
 
-    if (sample.z > (1000 - MICROBIT_ACCELEROMETER_TILT_TOLERANCE))
+    if (sample.z > tilt)
         return MICROBIT_ACCELEROMETER_EVT_FACE_DOWN;
 
     return MICROBIT_ACCELEROMETER_EVT_NONE;
@@ -271,9 +376,14 @@ uint16_t MicroBitAccelerometer::instantaneousPosture()
 /**
   * Updates the basic gesture recognizer. This performs instantaneous pose recognition, and also some low pass filtering to promote
   * stability.
+  *
+  * Gesture tracking is skipped entirely while nothing is listening for MICROBIT_ID_GESTURE events, unless getGesture() has been called.
   */
 void MicroBitAccelerometer::updateGesture()
 {
+    if (!(status & MICROBIT_ACCEL_GESTURE_TRACKING) && (EventModel::defaultEventBus == NULL || !EventModel::defaultEventBus->isListening(MICROBIT_ID_GESTURE)))
+        return;
+
     // Check for High/Low G force events - typically impulses, impacts etc.
     // Again, during such spikes, these event take priority of the posture of the device.
     // For these events, we don't perform any low pass filtering.
@@ -281,20 +391,26 @@ void MicroBitAccelerometer::updateGesture()
 
     if (force > MICROBIT_ACCELEROMETER_3G_THRESHOLD)
     {
-        if (force > MICROBIT_ACCELEROMETER_3G_THRESHOLD && !shake.impulse_3)
+        if (!shake.impulse_3)
         {
             MicroBitEvent e(MICROBIT_ID_GESTURE, MICROBIT_ACCELEROMETER_EVT_3G);
             shake.impulse_3 = 1;
         }
-        if (force > MICROBIT_ACCELEROMETER_6G_THRESHOLD && !shake.impulse_6)
-        {
-            MicroBitEvent e(MICROBIT_ID_GESTURE, MICROBIT_ACCELEROMETER_EVT_6G);
-            shake.impulse_6 = 1;
-        }
-        if (force > MICROBIT_ACCELEROMETER_8G_THRESHOLD && !shake.impulse_8)
+
+        // Each threshold is higher than the last, so a force below one needn't be tested against the next.
+        if (force > MICROBIT_ACCELEROMETER_6G_THRESHOLD)
         {
-            MicroBitEvent e(MICROBIT_ID_GESTURE, MICROBIT_ACCELEROMETER_EVT_8G);
-            shake.impulse_8 = 1;
+            if (!shake.impulse_6)
+            {
+                MicroBitEvent e(MICROBIT_ID_GESTURE, MICROBIT_ACCELEROMETER_EVT_6G);
+                shake.impulse_6 = 1;
+            }
+
+            if (force > MICROBIT_ACCELEROMETER_8G_THRESHOLD && !shake.impulse_8)
+            {
+                MicroBitEvent e(MICROBIT_ID_GESTURE, MICROBIT_ACCELEROMETER_EVT_8G);
+                shake.impulse_8 = 1;
+            }
         }
 
         impulseSigma = 0;
@@ -308,7 +424,7 @@ void MicroBitAccelerometer::updateGesture()
 
 
     // Determine what it looks like we're doing based on the latest sample...
-    uint16_t g = instantaneousPosture();
+    uint16_t g = instantaneousPosture(force);
 
     if (g == MICROBIT_ACCELEROMETER_EVT_SHAKE)
     {
@@ -320,6 +436,10 @@ void MicroBitAccelerometer::updateGesture()
     // Perform some low pass filtering to reduce jitter from any detected effects
     if (g == currentGesture)
     {
+        // Once the gesture is stable and reported, there is nothing more to do.
+        if (sigma >= MICROBIT_ACCELEROMETER_GESTURE_DAMPING && currentGesture == lastGesture)
+            return;
+
         if (sigma < MICROBIT_ACCELEROMETER_GESTURE_DAMPING)
             sigma++;
     }
@@ -356,6 +476,7 @@ int MicroBitAccelerometer::setPeriod(int period)
 {
     int result;
 
+    wake();
     samplePeriod = period;
     result = configure();
 
@@ -393,6 +514,7 @@ int MicroBitAccelerometer::setRange(int range)
 {
     int result;
 
+    wake();
     sampleRange = range;
     result = configure();
 
@@ -410,6 +532,110 @@ int MicroBitAccelerometer::getRange()
     return (int)sampleRange;
 }
 
+/**
+ * Attempts to set the number of samples read from the accelerometer in each burst.
+ *
+ * Where the hardware has a FIFO, it is filled to the given level before the samples are read
+ * together, and a single MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE event is raised for the batch.
+ * This greatly reduces the I2C and event overhead at high sample rates. Gesture tracking
+ * still considers every sample.
+ *
+ * @param size The requested number of samples per burst, between 1 and MICROBIT_ACCELEROMETER_FIFO_SIZE.
+ *             A size of 1 reads each sample as it becomes available.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the size is out of range,
+ *         MICROBIT_NO_RESOURCES if the batch buffer could not be allocated, or MICROBIT_I2C_ERROR
+ *         if the request fails.
+ *
+ * @code
+ * // read samples from the accelerometer sixteen at a time.
+ * accelerometer.setBatchSize(16);
+ * @endcode
+ *
+ * @note Hardware without a FIFO always uses a batch size of 1.
+ */
+int MicroBitAccelerometer::setBatchSize(int size)
+{
+    int result;
+
+    if (size < 1 || size > MICROBIT_ACCELEROMETER_FIFO_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Allocate a buffer large enough for the requested batch before the hardware starts filling it.
+    Sample3D *buffer = NULL;
+
+    if (size > 1)
+    {
+        buffer = new Sample3D[size];
+
+        if (buffer == NULL)
+            return MICROBIT_NO_RESOURCES;
+    }
+
+    delete[] batch;
+    batch = buffer;
+    batchLength = 0;
+
+    wake();
+    batchSize = size;
+    result = configure();
+
+    // The driver may have chosen a smaller batch. If it is reading samples singly, release the buffer.
+    if (batchSize == 1)
+    {
+        delete[] batch;
+        batch = NULL;
+    }
+
+    return result;
+}
+
+/**
+ * Reads the currently configured number of samples read from the accelerometer in each burst.
+ *
+ * @return The batch size, in samples.
+ */
+int MicroBitAccelerometer::getBatchSize()
+{
+    return (int)batchSize;
+}
+
+/**
+ * Reads the samples retrieved in the last burst from the accelerometer, oldest first,
+ * in the coordinate system defined in the constructor.
+ *
+ * @param buffer The buffer to copy the samples into.
+ *
+ * @param length The maximum number of samples to copy.
+ *
+ * @return The number of samples copied, or MICROBIT_INVALID_PARAMETER if buffer is NULL.
+ */
+int MicroBitAccelerometer::getBatch(Sample3D *buffer, int length)
+{
+    if (buffer == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    recordAccess();
+    requestUpdate();
+
+    // When samples are read singly, the batch is simply the latest sample.
+    if (batch == NULL)
+    {
+        if (length < 1)
+            return 0;
+
+        buffer[0] = sample;
+        return 1;
+    }
+
+    int count = min(length, (int)batchLength);
+
+    for (int i = 0; i < count; i++)
+        buffer[i] = batch[i];
+
+    return count;
+}
+
 /**
  * Configures the accelerometer for G range and sample rate defined
  * in this object. The nearest values are chosen to those defined
@@ -443,6 +669,190 @@ int MicroBitAccelerometer::requestUpdate()
     return MICROBIT_NOT_SUPPORTED;
 }
 
+/**
+ * Places the accelerometer into its lowest power mode, until configure() is next called.
+ *
+ * This is used to stop sampling while nothing is reading the accelerometer or listening for its events.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the accelerometer could not be configured,
+ *         or MICROBIT_NOT_SUPPORTED if the hardware has no such mode.
+ *
+ * @note This method should be overidden by the hardware driver to implement the requested
+ * changes in hardware.
+ */
+int MicroBitAccelerometer::standby()
+{
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+/**
+ * Records that the accelerometer has been read through its API.
+ *
+ * If the accelerometer is in standby, it is reconfigured and this waits for one sample period,
+ * so that the caller receives a fresh sample.
+ */
+void MicroBitAccelerometer::recordAccess()
+{
+    if (status & MICROBIT_ACCEL_STANDBY)
+    {
+        wake();
+        configure();
+        fiber_sleep(samplePeriod * batchSize);
+    }
+
+    accessTime = system_timer_current_time();
+}
+
+/**
+ * Records that the accelerometer is in use, without reconfiguring the hardware. Used by operations
+ * that are about to call configure() themselves.
+ */
+void MicroBitAccelerometer::wake()
+{
+    status &= ~MICROBIT_ACCEL_STANDBY;
+    accessTime = system_timer_current_time();
+}
+
+/**
+ * Determines if the accelerometer should continue to be sampled, placing it into standby if it has not
+ * been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+ *
+ * Drivers call this from idleTick(), and skip the update if it returns 0.
+ *
+ * @return 1 if the accelerometer should be sampled, 0 if it is in standby.
+ */
+int MicroBitAccelerometer::isSampling()
+{
+#if MICROBIT_SENSOR_IDLE_TIMEOUT > 0
+    if (status & MICROBIT_ACCEL_STANDBY)
+        return 0;
+
+    uint32_t now = system_timer_current_time();
+
+    // An enabled stream is waiting for every sample, however rarely it is read.
+    if (now - accessTime < MICROBIT_SENSOR_IDLE_TIMEOUT || stream.getCapacity() > 0)
+        return 1;
+
+    // We aren't told when listeners are removed, so check for them again once per timeout period.
+    if (EventModel::defaultEventBus && (EventModel::defaultEventBus->isListening(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE) || EventModel::defaultEventBus->isListening(MICROBIT_ID_GESTURE)))
+    {
+        accessTime = now;
+        return 1;
+    }
+
+    status |= MICROBIT_ACCEL_STANDBY;
+    standby();
+
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Brings the accelerometer out of standby when a listener is registered for its events,
+ * or for gesture events.
+ *
+ * @param evt The MICROBIT_ID_MESSAGE_BUS_LISTENER event raised by the message bus, carrying the ID listened to.
+ */
+void MicroBitAccelerometer::onListenerRegistered(MicroBitEvent evt)
+{
+    if ((status & MICROBIT_ACCEL_STANDBY) && (evt.value == id || evt.value == MICROBIT_ID_GESTURE || evt.value == MICROBIT_ID_ANY))
+    {
+        wake();
+        configure();
+    }
+}
+
+/**
+ * Enables a stream of every sample read from the accelerometer, to be read in bulk by an application fiber.
+ *
+ * Each sample is timestamped and queued as it is read, so no samples are lost between calls to readStream(),
+ * however often MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE events are processed.
+ *
+ * @param samples the number of samples to queue, or zero to disable the stream and free its storage.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+ *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+ *
+ * @code
+ * TimedSample3D samples[16];
+ *
+ * accelerometer.setStreamSize(64);
+ *
+ * while(1)
+ * {
+ *     int n = accelerometer.readStream(samples, 16);
+ *     // process n samples...
+ *     fiber_sleep(100);
+ * }
+ * @endcode
+ */
+int MicroBitAccelerometer::setStreamSize(int samples)
+{
+    return stream.setCapacity(samples);
+}
+
+/**
+ * Removes up to length of the oldest samples from the stream, in the coordinate system defined in the constructor.
+ *
+ * @param samples the buffer to store the samples in.
+ *
+ * @param length the largest number of samples to remove.
+ *
+ * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+ *
+ * @note samples read from the hardware in a single burst share a timestamp.
+ */
+int MicroBitAccelerometer::readStream(TimedSample3D *samples, int length)
+{
+    return stream.read(samples, length);
+}
+
+/**
+ * Provides the stream of samples, for access to its fill level and overflow count.
+ *
+ * @return the sample stream of this accelerometer.
+ */
+MicroBitSampleStream& MicroBitAccelerometer::getStream()
+{
+    return stream;
+}
+
+/**
+ * Smooths the samples read from the accelerometer, so that each read returns a filtered value without
+ * further bus traffic. The filter is updated incrementally as each sample arrives. Batches and streams
+ * still receive every unfiltered sample.
+ *
+ * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+ *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+ *
+ * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+ *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+ *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+ *
+ * @code
+ * // Report the median of the last 9 samples.
+ * accelerometer.setFilter(MICROBIT_FILTER_MEDIAN, 9);
+ * @endcode
+ */
+int MicroBitAccelerometer::setFilter(int type, int length)
+{
+    return filter.configure(type, length);
+}
+
+/**
+ * Determines the type of filter applied to the samples read, as set by setFilter().
+ *
+ * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+ */
+int MicroBitAccelerometer::getFilter()
+{
+    return filter.getType();
+}
+
 /**
  * Reads the last accelerometer value stored, and provides it in the coordinate system requested.
  *
@@ -451,6 +861,7 @@ int MicroBitAccelerometer::requestUpdate()
  */
 Sample3D MicroBitAccelerometer::getSample(CoordinateSystem coordinateSystem)
 {
+    recordAccess();
     requestUpdate();
     return coordinateSpace.transform(sampleENU, coordinateSystem);
 }
@@ -461,6 +872,7 @@ Sample3D MicroBitAccelerometer::getSample(CoordinateSystem coordinateSystem)
  */
 Sample3D MicroBitAccelerometer::getSample()
 {
+    recordAccess();
     requestUpdate();
     return sample;
 }
@@ -473,6 +885,7 @@ Sample3D MicroBitAccelerometer::getSample()
  */
 int MicroBitAccelerometer::getX()
 {
+    recordAccess();
     requestUpdate();
     return sample.x;
 }
@@ -485,6 +898,7 @@ int MicroBitAccelerometer::getX()
  */
 int MicroBitAccelerometer::getY()
 {
+    recordAccess();
     requestUpdate();
     return sample.y;
 }
@@ -497,6 +911,7 @@ int MicroBitAccelerometer::getY()
  */
 int MicroBitAccelerometer::getZ()
 {
+    recordAccess();
     requestUpdate();
     return sample.z;
 }
@@ -526,6 +941,7 @@ int MicroBitAccelerometer::getPitch()
   */
 float MicroBitAccelerometer::getPitchRadians()
 {
+    recordAccess();
     requestUpdate();
     if (!(status & MICROBIT_ACCELEROMETER_IMU_DATA_VALID))
         recalculatePitchRoll();
@@ -558,6 +974,7 @@ int MicroBitAccelerometer::getRoll()
   */
 float MicroBitAccelerometer::getRollRadians()
 {
+    recordAccess();
     requestUpdate();
     if (!(status & MICROBIT_ACCELEROMETER_IMU_DATA_VALID))
         recalculatePitchRoll();
@@ -573,22 +990,10 @@ float MicroBitAccelerometer::getRollRadians()
   */
 void MicroBitAccelerometer::recalculatePitchRoll()
 {
-    double x = (double) sample.x;
-    double y = (double) sample.y;
-    double z = (double) sample.z;
-
-    roll = atan2(x, -z);
-    pitch = atan2(y, (x*sin(roll) - z*cos(roll)));
-
-#if CONFIG_ENABLED(MICROBIT_FULL_RANGE_PITCH_CALCULATION)
-
-    // Handle to the two "negative quadrants", such that we get an output in the +/- 18- degree range.
-    // This ensures that the pitch values are consistent with the roll values.
-    if (z > 0.0)
-    {
-        double reference = pitch > 0.0 ? (PI / 2.0) : (-PI / 2.0);
-        pitch = reference + (reference - pitch);
-    }
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_ORIENTATION)
+    orientation_pitch_roll_fixed(sample, pitch, roll);
+#else
+    orientation_pitch_roll(sample, pitch, roll);
 #endif
 
     status |= MICROBIT_ACCELEROMETER_IMU_DATA_VALID;
@@ -597,6 +1002,9 @@ void MicroBitAccelerometer::recalculatePitchRoll()
 /**
   * Retrieves the last recorded gesture.
   *
+  * Gestures are only tracked while something is listening for MICROBIT_ID_GESTURE events, or once this
+  * has been called, so the first call may report a gesture that is out of date.
+  *
   * @return The last gesture that was detected.
   *
   * Example:
@@ -608,6 +1016,10 @@ void MicroBitAccelerometer::recalculatePitchRoll()
   */
 uint16_t MicroBitAccelerometer::getGesture()
 {
+    // Track gestures from now on, even if nothing is listening for gesture events.
+    status |= MICROBIT_ACCEL_GESTURE_TRACKING;
+    recordAccess();
+
     return lastGesture;
 }
 
@@ -616,6 +1028,7 @@ uint16_t MicroBitAccelerometer::getGesture()
   */
 MicroBitAccelerometer::~MicroBitAccelerometer()
 {
+    delete[] batch;
 }
 
 MicroBitAccelerometer* MicroBitAccelerometer::detectedAccelerometer = NULL;
@@ -0,0 +1,289 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitAnalogSampler.
+  *
+  * Samples one or more analog pins at a fixed rate, paced by a hardware timer.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitAnalogSampler.h"
+#include "MicroBitEvent.h"
+#include "ErrorNo.h"
+
+MicroBitAnalogSampler* MicroBitAnalogSampler::instance = NULL;
+
+/**
+  * Determines the ADC input attached to a pin.
+  *
+  * @param pin the pin.
+  *
+  * @return the input, or -1 if the pin is not an analog input.
+  */
+static int analogInput(PinName pin)
+{
+    // AIN0 - AIN1 are on P0.26 and P0.27, and AIN2 - AIN7 are on P0.01 - P0.06.
+    if (pin >= 1 && pin <= 6)
+        return pin + 1;
+
+    if (pin == 26 || pin == 27)
+        return pin - 26;
+
+    return -1;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a software representation of the analog sampler, which is idle until started.
+  *
+  * @param id the unique EventModel id of this component. Defaults to MICROBIT_ID_ANALOG_SAMPLER.
+  */
+MicroBitAnalogSampler::MicroBitAnalogSampler(uint16_t id)
+{
+    this->id = id;
+    this->buffer = NULL;
+    this->length = 0;
+    this->position = 0;
+    this->pinCount = 0;
+    this->channel = 0;
+    this->ready = -1;
+    this->overflows = 0;
+}
+
+/**
+  * Starts sampling the given pins.
+  *
+  * @param pins The pins to sample, which must be analog capable: MICROBIT_PIN_P0, P1, P2, P3, P4 or P10.
+  *
+  * @param pinCount The number of pins, up to MICROBIT_ANALOG_SAMPLER_MAX_PINS.
+  *
+  * @param frequency The number of times each pin is sampled per second.
+  *
+  * @param length The number of samples in each half of the buffer. When several pins are sampled, the samples are
+  *        interleaved, one from each pin in turn, so this should be a multiple of pinCount.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if a parameter is out of range or the conversions would be
+  *         closer together than MICROBIT_ANALOG_SAMPLER_MIN_PERIOD, MICROBIT_BUSY if another sampler is running,
+  *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+  *
+  * @code
+  * PinName pins[] = { MICROBIT_PIN_P0 };
+  * sampler.start(pins, 1, 8000, 256);
+  * @endcode
+  */
+int MicroBitAnalogSampler::start(const PinName *pins, int pinCount, int frequency, int length)
+{
+    if (pins == NULL || pinCount < 1 || pinCount > MICROBIT_ANALOG_SAMPLER_MAX_PINS || frequency < 1 || length < 1 || length > 0x7FFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Every pin is converted separately, so the ADC has to keep up with all of them.
+    uint32_t period = 1000000 / ((uint32_t)frequency * pinCount);
+
+    if (period < MICROBIT_ANALOG_SAMPLER_MIN_PERIOD)
+        return MICROBIT_INVALID_PARAMETER;
+
+    for (int i = 0; i < pinCount; i++)
+        if (analogInput(pins[i]) < 0)
+            return MICROBIT_INVALID_PARAMETER;
+
+    if (instance != NULL && instance != this)
+        return MICROBIT_BUSY;
+
+    stop();
+
+    buffer = (uint16_t *) malloc(2 * length * sizeof(uint16_t));
+
+    if (buffer == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    for (int i = 0; i < pinCount; i++)
+        inputs[i] = analogInput(pins[i]);
+
+    this->pinCount = pinCount;
+    this->length = length;
+    this->position = 0;
+    this->channel = 0;
+    this->ready = -1;
+    this->overflows = 0;
+
+    instance = this;
+
+    // Measure relative to the supply, as mbed's AnalogIn does.
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled;
+    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                      (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                      (ADC_CONFIG_REFSEL_SupplyOneThirdPrescaling << ADC_CONFIG_REFSEL_Pos) |
+                      ((1 << inputs[0]) << ADC_CONFIG_PSEL_Pos) |
+                      (ADC_CONFIG_EXTREFSEL_None << ADC_CONFIG_EXTREFSEL_Pos);
+
+    NRF_ADC->EVENTS_END = 0;
+    NRF_ADC->INTENSET = ADC_INTENSET_END_Msk;
+
+    NVIC_SetVector(ADC_IRQn, (uint32_t) &MicroBitAnalogSampler::adcHandler);
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    // Have the timer start each conversion, without any help from the processor.
+    MICROBIT_ANALOG_SAMPLER_TIMER->TASKS_STOP = 1;
+    MICROBIT_ANALOG_SAMPLER_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    MICROBIT_ANALOG_SAMPLER_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    MICROBIT_ANALOG_SAMPLER_TIMER->PRESCALER = 4;
+    MICROBIT_ANALOG_SAMPLER_TIMER->CC[0] = period;
+    MICROBIT_ANALOG_SAMPLER_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    MICROBIT_ANALOG_SAMPLER_TIMER->INTENCLR = 0xFFFFFFFF;
+
+    NRF_PPI->CH[MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL].EEP = (uint32_t) &MICROBIT_ANALOG_SAMPLER_TIMER->EVENTS_COMPARE[0];
+    NRF_PPI->CH[MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL].TEP = (uint32_t) &NRF_ADC->TASKS_START;
+    NRF_PPI->CHENSET = 1 << MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL;
+
+    MICROBIT_ANALOG_SAMPLER_TIMER->TASKS_CLEAR = 1;
+    MICROBIT_ANALOG_SAMPLER_TIMER->TASKS_START = 1;
+
+    status |= MICROBIT_COMPONENT_RUNNING;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * ADC interrupt handler. Stores each conversion, and moves the ADC on to the next input.
+  */
+void MicroBitAnalogSampler::adcHandler()
+{
+    MicroBitAnalogSampler *s = instance;
+
+    NRF_ADC->EVENTS_END = 0;
+
+    if (s == NULL || s->buffer == NULL)
+        return;
+
+    s->buffer[s->position++] = NRF_ADC->RESULT;
+
+    // Select the next pin, ready for the timer to start its conversion.
+    if (s->pinCount > 1)
+    {
+        if (++s->channel == s->pinCount)
+            s->channel = 0;
+
+        NRF_ADC->CONFIG = (NRF_ADC->CONFIG & ~ADC_CONFIG_PSEL_Msk) | ((1 << s->inputs[s->channel]) << ADC_CONFIG_PSEL_Pos);
+    }
+
+    if (s->position == s->length || s->position == 2 * s->length)
+    {
+        if (s->ready >= 0)
+            s->overflows++;
+
+        s->ready = s->position == s->length ? 0 : 1;
+
+        if (s->position == 2 * s->length)
+            s->position = 0;
+
+        MicroBitEvent(s->id, MICROBIT_ANALOG_SAMPLER_EVT_DATA);
+    }
+}
+
+/**
+  * Stops sampling, and frees the buffer.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitAnalogSampler::stop()
+{
+    if (!(status & MICROBIT_COMPONENT_RUNNING))
+        return MICROBIT_OK;
+
+    MICROBIT_ANALOG_SAMPLER_TIMER->TASKS_STOP = 1;
+    NRF_PPI->CHENCLR = 1 << MICROBIT_ANALOG_SAMPLER_PPI_CHANNEL;
+
+    NRF_ADC->INTENCLR = ADC_INTENCLR_END_Msk;
+    NVIC_DisableIRQ(ADC_IRQn);
+
+    // Let any conversion in progress finish, then release the pin. See MicroBitPin::disconnect().
+    while (NRF_ADC->BUSY);
+    NRF_ADC->EVENTS_END = 0;
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled;
+    NRF_ADC->CONFIG = (NRF_ADC->CONFIG & ~ADC_CONFIG_PSEL_Msk) | (ADC_CONFIG_PSEL_Disabled << ADC_CONFIG_PSEL_Pos);
+
+    free(buffer);
+    buffer = NULL;
+    ready = -1;
+
+    instance = NULL;
+    status &= ~MICROBIT_COMPONENT_RUNNING;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Collects the half of the buffer completed most recently. The samples are 10 bit, in the range 0 - 1023.
+  *
+  * The samples remain valid until the sampler next fills this half, which is the time taken to fill the other half.
+  *
+  * @param samples Set to the first sample.
+  *
+  * @return the number of samples, or MICROBIT_NO_DATA if no half has completed since the last call.
+  *
+  * @code
+  * fiber_wait_for_event(MICROBIT_ID_ANALOG_SAMPLER, MICROBIT_ANALOG_SAMPLER_EVT_DATA);
+  *
+  * uint16_t *samples;
+  * int count = sampler.read(&samples);
+  * @endcode
+  */
+int MicroBitAnalogSampler::read(uint16_t **samples)
+{
+    if (samples == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+    int half = ready;
+    ready = -1;
+    __enable_irq();
+
+    if (half < 0 || buffer == NULL)
+        return MICROBIT_NO_DATA;
+
+    *samples = &buffer[half * length];
+
+    return length;
+}
+
+/**
+  * @return the number of halves completed while the previous one was still waiting to be collected.
+  */
+uint32_t MicroBitAnalogSampler::getOverflowCount()
+{
+    return overflows;
+}
+
+/**
+  * Destructor.
+  *
+  * Stops sampling.
+  */
+MicroBitAnalogSampler::~MicroBitAnalogSampler()
+{
+    stop();
+}
@@ -45,16 +45,49 @@ DEALINGS IN THE SOFTWARE.
   * buttonA(MICROBIT_PIN_BUTTON_A, MICROBIT_ID_BUTTON_A);
   * @endcode
   */
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+MicroBitButton::MicroBitButton(PinName name, uint16_t id, MicroBitButtonEventConfiguration eventConfiguration, PinMode mode) : pin(name)
+#else
 MicroBitButton::MicroBitButton(PinName name, uint16_t id, MicroBitButtonEventConfiguration eventConfiguration, PinMode mode) : pin(name, mode)
+#endif
 {
     this->id = id;
     this->name = name;
     this->eventConfiguration = eventConfiguration;
     this->downStartTime = 0;
     this->sigma = 0;
+
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+    pin.mode(mode);
+    pin.fall(this, &MicroBitButton::onEdge);
+    pin.rise(this, &MicroBitButton::onEdge);
+
+    // Take a first look, in case the button is already held.
+    onEdge();
+#else
     system_timer_add_component(this);
+#endif
 }
 
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+/**
+  * Interrupt handler for an edge on the pin. Starts sampling the button, if it isn't being sampled already.
+  */
+void MicroBitButton::onEdge()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!(status & MICROBIT_BUTTON_STATE_SAMPLING))
+    {
+        status |= MICROBIT_BUTTON_STATE_SAMPLING;
+        system_timer_event_after_us(&sampleEvent, SYSTEM_TICK_PERIOD_MS * 1000, system_timer_method_callback<MicroBitButton, &MicroBitButton::systemTick>, this);
+    }
+
+    __set_PRIMASK(primask);
+}
+#endif
+
 /**
   * Changes the event configuration used by this button to the given MicroBitButtonEventConfiguration.
   *
@@ -114,7 +147,7 @@ void MicroBitButton::systemTick()
     // Check to see if we have on->off state change.
     if(sigma < MICROBIT_BUTTON_SIGMA_THRESH_LO && (status & MICROBIT_BUTTON_STATE))
     {
-        status = 0;
+        status &= MICROBIT_BUTTON_STATE_SAMPLING;
         MicroBitEvent evt(id,MICROBIT_BUTTON_EVT_UP);
 
        if (eventConfiguration == MICROBIT_BUTTON_ALL_EVENTS)
@@ -136,6 +169,31 @@ void MicroBitButton::systemTick()
         //fire hold event
         MicroBitEvent evt(id,MICROBIT_BUTTON_EVT_HOLD);
     }
+
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+    // Keep sampling while the button is pressed or bouncing. Once it has settled, go quiet until the next edge.
+    // The pin is checked with interrupts disabled, so that an edge arriving now isn't missed.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((status & MICROBIT_BUTTON_STATE) || sigma != MICROBIT_BUTTON_SIGMA_MIN || !pin)
+        system_timer_event_after_us(&sampleEvent, SYSTEM_TICK_PERIOD_MS * 1000, system_timer_method_callback<MicroBitButton, &MicroBitButton::systemTick>, this);
+    else
+        status &= ~MICROBIT_BUTTON_STATE_SAMPLING;
+
+    __set_PRIMASK(primask);
+
+#elif CONFIG_ENABLED(MICROBIT_SYSTEM_TICK_GOVERNOR)
+    // Only insist on regular sampling while the button is pressed or bouncing, so that an idle button
+    // doesn't stop the system tick from slowing down.
+    bool sampling = (status & MICROBIT_BUTTON_STATE) || sigma != MICROBIT_BUTTON_SIGMA_MIN;
+
+    if (sampling != ((status & MICROBIT_BUTTON_STATE_SAMPLING) != 0))
+    {
+        status = sampling ? status | MICROBIT_BUTTON_STATE_SAMPLING : status & ~MICROBIT_BUTTON_STATE_SAMPLING;
+        system_timer_set_requirement(this, sampling ? SYSTEM_TICK_PERIOD_MS : 0);
+    }
+#endif
 }
 
 /**
@@ -158,5 +216,9 @@ int MicroBitButton::isPressed()
   */
 MicroBitButton::~MicroBitButton()
 {
+#if CONFIG_ENABLED(MICROBIT_BUTTON_INTERRUPT_WAKE)
+    system_timer_cancel_event(&sampleEvent);
+#else
     system_timer_remove_component(this);
+#endif
 }
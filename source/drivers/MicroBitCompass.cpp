@@ -27,7 +27,10 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitEvent.h"
 #include "MicroBitCompat.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 #include "MicroBitDevice.h"
+#include "MicroBitOrientation.h"
+#include "MicroBitCompassCalibrator.h"
 
 #include "MAG3110.h"
 #include "LSM303Magnetometer.h"
@@ -78,6 +81,7 @@ void MicroBitCompass::init(uint16_t id)
     // Store our identifiers.
     this->id = id;
     this->status = 0;
+    this->calibrator = NULL;
 
     // Set a default rate of 10Hz.
     this->samplePeriod = 100;
@@ -86,6 +90,12 @@ void MicroBitCompass::init(uint16_t id)
     // Assume that we have no calibration information.
     status &= ~MICROBIT_COMPASS_STATUS_CALIBRATED;
 
+    // Sample until we've gone unused for a while, and resume as soon as anyone starts listening for our events.
+    this->accessTime = 0;
+
+    if (EventModel::defaultEventBus)
+        EventModel::defaultEventBus->listen(MICROBIT_ID_MESSAGE_BUS_LISTENER, MICROBIT_EVT_ANY, this, &MicroBitCompass::onListenerRegistered);
+
     // Indicate that we're up and running.
     status |= MICROBIT_COMPONENT_RUNNING;
 }
@@ -101,43 +111,29 @@ void MicroBitCompass::init(uint16_t id)
 MicroBitCompass& MicroBitCompass::autoDetect(MicroBitI2C &i2c)
 {
     if (MicroBitCompass::detectedCompass == NULL)
-    {
-        // Configuration of IRQ lines
-        MicroBitPin int1(MICROBIT_ID_IO_INT1, P0_28, PIN_CAPABILITY_STANDARD);
-        MicroBitPin int2(MICROBIT_ID_IO_INT2, P0_29, PIN_CAPABILITY_STANDARD);
-        MicroBitPin int3(MICROBIT_ID_IO_INT3, P0_27, PIN_CAPABILITY_STANDARD);
-
-        // All known accelerometer/magnetometer peripherals have the same alignment
-        CoordinateSpace &coordinateSpace = *(new CoordinateSpace(SIMPLE_CARTESIAN, true, COORDINATE_SPACE_ROTATED_0));
-
-        // Now, probe for connected peripherals, if none have already been found.
-        if (MAG3110::isDetected(i2c))
-            MicroBitCompass::detectedCompass = new MAG3110(i2c, int2, coordinateSpace);
-
-        else if (LSM303Magnetometer::isDetected(i2c))
-            MicroBitCompass::detectedCompass = new LSM303Magnetometer(i2c, int2, coordinateSpace);
-
-        else if (FXOS8700::isDetected(i2c))
-        {
-            FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace);
-            MicroBitAccelerometer::detectedAccelerometer = fxos;
-            MicroBitCompass::detectedCompass = fxos;
-        }
-
-        // Insert this case to support FXOS on the microbit1.5-SN
-        //else if (FXOS8700::isDetected(i2c, 0x3A))
-        //{
-        //    FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace, 0x3A);
-        //    MicroBitAccelerometer::detectedAccelerometer = fxos;
-        //    MicroBitCompass::detectedCompass = fxos;
-        //}
-
-        else
-        {
-            MicroBitCompass *unavailable = new MicroBitCompass(coordinateSpace, MICROBIT_ID_COMPASS);
-            MicroBitCompass::detectedCompass = unavailable;
-        }
-    }
+        detect(i2c, NULL);
+
+    // If an accelerometer has been discovered, enable tilt compensation on the e-compass.
+    if (MicroBitAccelerometer::detectedAccelerometer)
+        MicroBitCompass::detectedCompass->setAccelerometer(*MicroBitAccelerometer::detectedAccelerometer);
+
+    return *MicroBitCompass::detectedCompass;
+}
+
+/**
+ * Device autodetection, remembering the device found.
+ *
+ * The device found on a previous boot is confirmed with a single WHO_AM_I read, and the
+ * bus is only scanned for every supported device if it does not respond.
+ *
+ * @param i2c the bus to scan.
+ * @param storage the storage used to record the device found.
+ *
+ */
+MicroBitCompass& MicroBitCompass::autoDetect(MicroBitI2C &i2c, MicroBitStorage &storage)
+{
+    if (MicroBitCompass::detectedCompass == NULL)
+        detect(i2c, &storage);
 
     // If an accelerometer has been discovered, enable tilt compensation on the e-compass.
     if (MicroBitAccelerometer::detectedAccelerometer)
@@ -146,6 +142,72 @@ MicroBitCompass& MicroBitCompass::autoDetect(MicroBitI2C &i2c)
     return *MicroBitCompass::detectedCompass;
 }
 
+/**
+ * Scans the given I2C bus for supported compass devices, starting with the one recorded in storage (if any),
+ * and constructs an appropriate driver.
+ *
+ * @param i2c the bus to scan.
+ * @param storage the storage used to record the device found, or NULL to scan every time.
+ */
+void MicroBitCompass::detect(MicroBitI2C &i2c, MicroBitStorage *storage)
+{
+    uint8_t cached = MICROBIT_COMPASS_NONE;
+    uint8_t device = MICROBIT_COMPASS_NONE;
+
+    // Configuration of IRQ lines
+    MicroBitPin int1(MICROBIT_ID_IO_INT1, P0_28, PIN_CAPABILITY_STANDARD);
+    MicroBitPin int2(MICROBIT_ID_IO_INT2, P0_29, PIN_CAPABILITY_STANDARD);
+    MicroBitPin int3(MICROBIT_ID_IO_INT3, P0_27, PIN_CAPABILITY_STANDARD);
+
+    // All known accelerometer/magnetometer peripherals have the same alignment
+    CoordinateSpace &coordinateSpace = *(new CoordinateSpace(SIMPLE_CARTESIAN, true, COORDINATE_SPACE_ROTATED_0));
+
+    if (storage)
+        storage->get(MICROBIT_COMPASS_STORAGE_KEY, &cached, 1);
+
+    // Confirm the device found last time is still there, before probing for every device we know of.
+    // Each probe of an absent device can take MICROBIT_I2C_MAX_RETRIES attempts to fail.
+    if ((cached == MICROBIT_COMPASS_MAG3110 && MAG3110::isDetected(i2c)) ||
+        (cached == MICROBIT_COMPASS_LSM303 && LSM303Magnetometer::isDetected(i2c)) ||
+        (cached == MICROBIT_COMPASS_FXOS8700 && FXOS8700::isDetected(i2c)))
+        device = cached;
+
+    else if (MAG3110::isDetected(i2c))
+        device = MICROBIT_COMPASS_MAG3110;
+
+    else if (LSM303Magnetometer::isDetected(i2c))
+        device = MICROBIT_COMPASS_LSM303;
+
+    else if (FXOS8700::isDetected(i2c))
+        device = MICROBIT_COMPASS_FXOS8700;
+
+    // Insert this case to support FXOS on the microbit1.5-SN
+    //else if (FXOS8700::isDetected(i2c, 0x3A))
+
+    if (device == MICROBIT_COMPASS_MAG3110)
+        MicroBitCompass::detectedCompass = new MAG3110(i2c, int2, coordinateSpace);
+
+    else if (device == MICROBIT_COMPASS_LSM303)
+        MicroBitCompass::detectedCompass = new LSM303Magnetometer(i2c, int2, coordinateSpace);
+
+    else if (device == MICROBIT_COMPASS_FXOS8700)
+    {
+        FXOS8700 *fxos =  new FXOS8700(i2c, int3, coordinateSpace);
+        MicroBitAccelerometer::detectedAccelerometer = fxos;
+        MicroBitCompass::detectedCompass = fxos;
+    }
+
+    else
+    {
+        MicroBitCompass *unavailable = new MicroBitCompass(coordinateSpace, MICROBIT_ID_COMPASS);
+        MicroBitCompass::detectedCompass = unavailable;
+    }
+
+    // Only record a device that was found, so that a missing one is looked for again next time.
+    if (storage && device != MICROBIT_COMPASS_NONE && device != cached)
+        storage->put(MICROBIT_COMPASS_STORAGE_KEY, &device, 1);
+}
+
 /**
  * Gets the current heading of the device, relative to magnetic north.
  *
@@ -214,6 +276,7 @@ int MicroBitCompass::calibrate()
     if(isCalibrating())
         return MICROBIT_CALIBRATION_IN_PROGRESS;
 
+    recordAccess();
     requestUpdate();
 
     // Delete old calibration data
@@ -263,6 +326,17 @@ CompassCalibration MicroBitCompass::getCalibration()
     return calibration;
 }
 
+/**
+ * Registers a calibrator to be passed every sample read, before calibration is applied, so that it can
+ * refine the calibration in the background.
+ *
+ * @param calibrator The calibrator to pass samples to, or NULL to stop.
+ */
+void MicroBitCompass::setCalibrator(MicroBitCompassCalibrator *calibrator)
+{
+    this->calibrator = calibrator;
+}
+
 /**
  * Returns 0 or 1. 1 indicates that the compass is calibrated, zero means the compass requires calibration.
  */
@@ -327,6 +401,7 @@ int MicroBitCompass::setPeriod(int period)
 {
     int result;
 
+    wake();
     samplePeriod = period;
     result = configure();
 
@@ -362,6 +437,100 @@ int MicroBitCompass::requestUpdate()
     return MICROBIT_NOT_SUPPORTED;
 }
 
+/**
+ * Places the compass into its lowest power mode, until configure() is next called.
+ *
+ * This is used to stop sampling while nothing is reading the compass or listening for its events.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the compass could not be configured,
+ *         or MICROBIT_NOT_SUPPORTED if the hardware has no such mode.
+ *
+ * @note This method should be overidden by the hardware driver to implement the requested
+ * changes in hardware.
+ */
+int MicroBitCompass::standby()
+{
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+/**
+ * Records that the compass has been read through its API.
+ *
+ * If the compass is in standby, it is reconfigured and this waits for one sample period,
+ * so that the caller receives a fresh sample.
+ */
+void MicroBitCompass::recordAccess()
+{
+    if (status & MICROBIT_COMPASS_STATUS_STANDBY)
+    {
+        wake();
+        configure();
+        fiber_sleep(samplePeriod);
+    }
+
+    accessTime = system_timer_current_time();
+}
+
+/**
+ * Records that the compass is in use, without reconfiguring the hardware. Used by operations
+ * that are about to call configure() themselves.
+ */
+void MicroBitCompass::wake()
+{
+    status &= ~MICROBIT_COMPASS_STATUS_STANDBY;
+    accessTime = system_timer_current_time();
+}
+
+/**
+ * Determines if the compass should continue to be sampled, placing it into standby if it has not
+ * been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+ *
+ * Drivers call this from idleTick(), and skip the update if it returns 0.
+ *
+ * @return 1 if the compass should be sampled, 0 if it is in standby.
+ */
+int MicroBitCompass::isSampling()
+{
+#if MICROBIT_SENSOR_IDLE_TIMEOUT > 0
+    if (status & MICROBIT_COMPASS_STATUS_STANDBY)
+        return 0;
+
+    uint32_t now = system_timer_current_time();
+
+    // An enabled stream is waiting for every sample, however rarely it is read.
+    if (now - accessTime < MICROBIT_SENSOR_IDLE_TIMEOUT || stream.getCapacity() > 0 || (status & MICROBIT_COMPASS_STATUS_CALIBRATING))
+        return 1;
+
+    // We aren't told when listeners are removed, so check for them again once per timeout period.
+    if (EventModel::defaultEventBus && EventModel::defaultEventBus->isListening(id, MICROBIT_COMPASS_EVT_DATA_UPDATE))
+    {
+        accessTime = now;
+        return 1;
+    }
+
+    status |= MICROBIT_COMPASS_STATUS_STANDBY;
+    standby();
+
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Brings the compass out of standby when a listener is registered for its events.
+ *
+ * @param evt The MICROBIT_ID_MESSAGE_BUS_LISTENER event raised by the message bus, carrying the ID listened to.
+ */
+void MicroBitCompass::onListenerRegistered(MicroBitEvent evt)
+{
+    if ((status & MICROBIT_COMPASS_STATUS_STANDBY) && (evt.value == id || evt.value == MICROBIT_ID_ANY))
+    {
+        wake();
+        configure();
+    }
+}
+
 /**
  * Stores data from the compass sensor in our buffer.
  *
@@ -376,6 +545,10 @@ int MicroBitCompass::requestUpdate()
  */
 int MicroBitCompass::update()
 {
+    // Pass the uncalibrated sample on for background calibration, if enabled.
+    if (calibrator)
+        calibrator->addSample(sampleENU);
+
     // Store the raw data, and apply any calibration data we have.
     sampleENU.x = CALIBRATED_SAMPLE(sampleENU, x);
     sampleENU.y = CALIBRATED_SAMPLE(sampleENU, y);
@@ -384,12 +557,110 @@ int MicroBitCompass::update()
     // Store the user accessible data, in the requested coordinate space, and taking into account component placement of the sensor.
     sample = coordinateSpace.transform(sampleENU);
 
+    stream.push(sample);
+
+    // The stream holds every sample, but the latest sample is filtered if requested.
+    if (filter.getType() != MICROBIT_FILTER_NONE)
+    {
+        sampleENU = filter.push(sampleENU);
+        sample = coordinateSpace.transform(sampleENU);
+    }
+
     // Indicate that a new sample is available
     MicroBitEvent e(id, MICROBIT_COMPASS_EVT_DATA_UPDATE);
 
     return MICROBIT_OK;
 };
 
+/**
+ * Enables a stream of every sample read from the compass, to be read in bulk by an application fiber.
+ *
+ * Each sample is timestamped and queued as it is read, so no samples are lost between calls to readStream(),
+ * however often MICROBIT_COMPASS_EVT_DATA_UPDATE events are processed.
+ *
+ * @param samples the number of samples to queue, or zero to disable the stream and free its storage.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+ *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+ *
+ * @code
+ * TimedSample3D samples[16];
+ *
+ * compass.setStreamSize(64);
+ *
+ * while(1)
+ * {
+ *     int n = compass.readStream(samples, 16);
+ *     // process n samples...
+ *     fiber_sleep(100);
+ * }
+ * @endcode
+ */
+int MicroBitCompass::setStreamSize(int samples)
+{
+    return stream.setCapacity(samples);
+}
+
+/**
+ * Removes up to length of the oldest samples from the stream, in the coordinate system defined in the constructor.
+ *
+ * @param samples the buffer to store the samples in.
+ *
+ * @param length the largest number of samples to remove.
+ *
+ * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+ *
+ * @note samples read from the hardware in a single burst share a timestamp.
+ */
+int MicroBitCompass::readStream(TimedSample3D *samples, int length)
+{
+    return stream.read(samples, length);
+}
+
+/**
+ * Provides the stream of samples, for access to its fill level and overflow count.
+ *
+ * @return the sample stream of this compass.
+ */
+MicroBitSampleStream& MicroBitCompass::getStream()
+{
+    return stream;
+}
+
+/**
+ * Smooths the samples read from the compass, so that each read returns a filtered value without
+ * further bus traffic. The filter is updated incrementally as each sample arrives. The stream
+ * still receives every unfiltered sample.
+ *
+ * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+ *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+ *
+ * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+ *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+ *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+ *
+ * @code
+ * // Report the median of the last 9 samples.
+ * compass.setFilter(MICROBIT_FILTER_MEDIAN, 9);
+ * @endcode
+ */
+int MicroBitCompass::setFilter(int type, int length)
+{
+    return filter.configure(type, length);
+}
+
+/**
+ * Determines the type of filter applied to the samples read, as set by setFilter().
+ *
+ * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+ */
+int MicroBitCompass::getFilter()
+{
+    return filter.getType();
+}
+
 /**
  * Reads the last compass value stored, and provides it in the coordinate system requested.
  *
@@ -398,6 +669,7 @@ int MicroBitCompass::update()
  */
 Sample3D MicroBitCompass::getSample(CoordinateSystem coordinateSystem)
 {
+    recordAccess();
     requestUpdate();
     return coordinateSpace.transform(sampleENU, coordinateSystem);
 }
@@ -408,6 +680,7 @@ Sample3D MicroBitCompass::getSample(CoordinateSystem coordinateSystem)
  */
 Sample3D MicroBitCompass::getSample()
 {
+    recordAccess();
     requestUpdate();
     return sample;
 }
@@ -420,6 +693,7 @@ Sample3D MicroBitCompass::getSample()
  */
 int MicroBitCompass::getX()
 {
+    recordAccess();
     requestUpdate();
     return sample.x;
 }
@@ -432,6 +706,7 @@ int MicroBitCompass::getX()
  */
 int MicroBitCompass::getY()
 {
+    recordAccess();
     requestUpdate();
     return sample.y;
 }
@@ -444,6 +719,7 @@ int MicroBitCompass::getY()
  */
 int MicroBitCompass::getZ()
 {
+    recordAccess();
     requestUpdate();
     return sample.z;
 }
@@ -453,33 +729,15 @@ int MicroBitCompass::getZ()
  */
 int MicroBitCompass::tiltCompensatedBearing()
 {
-    // Precompute the tilt compensation parameters to improve readability.
     float phi = accelerometer->getRollRadians();
     float theta = accelerometer->getPitchRadians();
-
-    // Convert to floating point to reduce rounding errors
     Sample3D cs = this->getSample(NORTH_EAST_DOWN);
-    float x = (float) cs.x;
-    float y = (float) cs.y;
-    float z = (float) cs.z;
-
-    // Precompute cos and sin of pitch and roll angles to make the calculation a little more efficient.
-    float sinPhi = sin(phi);
-    float cosPhi = cos(phi);
-    float sinTheta = sin(theta);
-    float cosTheta = cos(theta);
-
-    // Calculate the tilt compensated bearing, and convert to degrees.
-    float bearing = (360*atan2(x*cosTheta + y*sinTheta*sinPhi + z*sinTheta*cosPhi, z*sinPhi - y*cosPhi)) / (2*PI);
 
-    // Handle the 90 degree offset caused by the NORTH_EAST_DOWN based calculation.
-    bearing = 90 - bearing;
-
-    // Ensure the calculated bearing is in the 0..359 degree range.
-    if (bearing < 0)
-        bearing += 360.0f;
-
-    return (int) (bearing);
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_ORIENTATION)
+    return orientation_bearing_fixed(cs, theta, phi);
+#else
+    return orientation_bearing(cs, theta, phi);
+#endif
 }
 
 /**
@@ -487,17 +745,13 @@ int MicroBitCompass::tiltCompensatedBearing()
  */
 int MicroBitCompass::basicBearing()
 {
-    // Convert to floating point to reduce rounding errors
     Sample3D cs = this->getSample(SIMPLE_CARTESIAN);
-    float x = (float) cs.x;
-    float y = (float) cs.y;
-
-    float bearing = (atan2(x,y))*180/PI;
-
-    if (bearing < 0)
-        bearing += 360.0;
 
-    return (int)bearing;
+#if CONFIG_ENABLED(MICROBIT_FIXED_POINT_ORIENTATION)
+    return orientation_basic_bearing_fixed(cs);
+#else
+    return orientation_basic_bearing(cs);
+#endif
 }
 
 /**
@@ -27,8 +27,6 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitCompassCalibrator.h"
 #include "EventModel.h"
 
-#define CALIBRATION_INCREMENT     200
-
 /**
   * Constructor.
   *
@@ -49,6 +47,7 @@ DEALINGS IN THE SOFTWARE.
 MicroBitCompassCalibrator::MicroBitCompassCalibrator(MicroBitCompass& _compass, MicroBitAccelerometer& _accelerometer, MicroBitDisplay& _display) : compass(_compass), accelerometer(_accelerometer), display(_display)
 {
     this->storage = NULL;
+    this->background = NULL;
 
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATE, this, &MicroBitCompassCalibrator::calibrateUX, MESSAGE_BUS_LISTENER_IMMEDIATE);
@@ -73,48 +72,301 @@ MicroBitCompassCalibrator::MicroBitCompassCalibrator(MicroBitCompass& _compass,
 MicroBitCompassCalibrator::MicroBitCompassCalibrator(MicroBitCompass& _compass, MicroBitAccelerometer& _accelerometer, MicroBitDisplay& _display, MicroBitStorage &storage) : compass(_compass), accelerometer(_accelerometer), display(_display)
 {
     this->storage = &storage;
+    this->background = NULL;
 
     //Attempt to load any stored calibration datafor the compass.
-    KeyValuePair *calibrationData =  this->storage->get("compassCal");
+    CompassCalibration cal = CompassCalibration();
 
-    if(calibrationData != NULL)
-    {
-        CompassCalibration cal = CompassCalibration();
-        memcpy(&cal, calibrationData->value, sizeof(CompassCalibration));
+    if(this->storage->get("compassCal", (uint8_t *)&cal, sizeof(CompassCalibration)) == MICROBIT_OK)
         compass.setCalibration(cal);
-        delete calibrationData;
-    }
 
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATE, this, &MicroBitCompassCalibrator::calibrateUX, MESSAGE_BUS_LISTENER_IMMEDIATE);
 }
+
+/**
+ * Calculates the integer square root of a value.
+ *
+ * @param v The value.
+ *
+ * @return the largest integer whose square is no greater than v.
+ */
+static uint32_t isqrt(uint64_t v)
+{
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit)
+    {
+        if (v >= result + bit)
+        {
+            v -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return (uint32_t) result;
+}
+
+/**
+ * Calculates the determinant of a 3x3 matrix.
+ */
+static int64_t determinant(int64_t m[3][3])
+{
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+         - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+         + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/**
+ * Solves m.x = b by Cramer's rule, given the determinant of m.
+ */
+static void cramer(int64_t m[3][3], int64_t det, int64_t b[3], int64_t x[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        int64_t t[3][3];
+
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                t[r][c] = c == i ? b[r] : m[r][c];
+
+        x[i] = determinant(t) / det;
+    }
+}
+
+/**
+ * Constructor.
+ *
+ * Create an empty fit.
+ */
+CompassSphereFit::CompassSphereFit()
+{
+    clear();
+}
+
+/**
+ * Discards all samples accumulated.
+ */
+void CompassSphereFit::clear()
+{
+    samples = 0;
+    sumLengths = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        sum[i] = 0;
+        sumCubes[i] = 0;
+
+        for (int j = 0; j < 3; j++)
+            sumSquares[i][j] = 0;
+    }
+}
+
+/**
+ * Adds a sample to the fit.
+ *
+ * @param s The sample to add.
+ *
+ * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if COMPASS_SPHERE_FIT_MAX_SAMPLES have already been added.
+ */
+int CompassSphereFit::add(Sample3D s)
+{
+    const int64_t limit = 1 << 14;
+    int64_t u[3];
+
+    if (samples >= COMPASS_SPHERE_FIT_MAX_SAMPLES)
+        return MICROBIT_NO_RESOURCES;
+
+    if (samples == 0)
+        origin = s;
+
+    // Work relative to the first sample, in coarser units, so that no component exceeds 2^14.
+    // Samples on the same sphere are never further apart than its diameter, so this loses little.
+    u[0] = (s.x - origin.x) / (1 << COMPASS_SPHERE_FIT_SHIFT);
+    u[1] = (s.y - origin.y) / (1 << COMPASS_SPHERE_FIT_SHIFT);
+    u[2] = (s.z - origin.z) / (1 << COMPASS_SPHERE_FIT_SHIFT);
+
+    int64_t length = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (u[i] > limit)
+            u[i] = limit;
+
+        if (u[i] < -limit)
+            u[i] = -limit;
+
+        length += u[i] * u[i];
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        sum[i] += u[i];
+        sumCubes[i] += u[i] * length;
+
+        for (int j = 0; j < 3; j++)
+            sumSquares[i][j] += u[i] * u[j];
+    }
+
+    sumLengths += length;
+    samples++;
+
+    return MICROBIT_OK;
+}
+
 /**
- * Scoring function for a hill climb algorithm.
+ * Determines the number of samples accumulated.
  *
- * @param c An approximated centre point
- * @param data a collection of data points
- * @param samples the number of samples in the 'data' array
+ * @return the number of samples added since the fit was last cleared.
+ */
+int CompassSphereFit::getSamples()
+{
+    return samples;
+}
+
+/**
+ * Determines the centre of the sphere relative to the origin, in accumulated units.
+ *
+ * A point c is the centre of a sphere through sample u if |u|^2 = 2u.c + k, for some constant k.
+ * Eliminating k, the least squares solution satisfies M.c = h, where M = n.sum(uu') - sum(u)sum(u)'
+ * is n^2 times the covariance of the samples, and h = (n.sum(u|u|^2) - sum(u)sum(|u|^2)) / 2.
+ *
+ * @param c Set to the centre found.
  *
- * @return The deviation between the closest and further point in the data array from the point given. 
+ * @param coverage If not NULL, set to the spread of the samples, as returned by getCoverage().
+ *
+ * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the samples do not yet determine a centre.
  */
-float MicroBitCompassCalibrator::measureScore(Sample3D &c, Sample3D *data, int samples)
+int CompassSphereFit::solve(int64_t c[3], int *coverage)
 {
-    float minD;
-    float maxD;
+    int64_t m[3][3];
+    int64_t h[3];
+    int64_t mn[3][3];
+    int64_t hn[3];
+    int64_t largest = 0;
+    int shift = 0;
+
+    if (coverage)
+        *coverage = 0;
 
-    minD = maxD = c.dSquared(data[0]);
-    for (int i = 1; i < samples; i++)
+    if (samples < 4)
+        return MICROBIT_NO_DATA;
+
+    for (int i = 0; i < 3; i++)
     {
-        float d = c.dSquared(data[i]);
+        h[i] = (samples * sumCubes[i] - sum[i] * sumLengths) / 2;
 
-        if (d < minD)
-            minD = d;
+        for (int j = 0; j < 3; j++)
+        {
+            m[i][j] = samples * sumSquares[i][j] - sum[i] * sum[j];
+            if (m[i][j] > largest)
+                largest = m[i][j];
+        }
+    }
 
-        if (d > maxD)
-            maxD = d;
+    // Scale the system down until Cramer's rule can be applied without overflow.
+    while ((largest >> shift) >= (1 << 12))
+        shift++;
+
+    for (int i = 0; i < 3; i++)
+    {
+        hn[i] = h[i] >> shift;
+
+        // A centre this far from the samples is not determined by them.
+        if (hn[i] >= (1 << 30) || hn[i] <= -(1 << 30))
+            return MICROBIT_NO_DATA;
+
+        for (int j = 0; j < 3; j++)
+            mn[i][j] = m[i][j] >> shift;
     }
 
-    return (maxD - minD);
+    int64_t det = determinant(mn);
+
+    if (det <= 0)
+        return MICROBIT_NO_DATA;
+
+    if (coverage)
+    {
+        // The ratio of the determinant to the cube of the mean eigenvalue, which is 1 only when the samples
+        // are spread equally in every direction.
+        int64_t trace = mn[0][0] + mn[1][1] + mn[2][2];
+        *coverage = (int) ((1024 * 27 * det) / (trace * trace * trace));
+
+        if (*coverage > 1024)
+            *coverage = 1024;
+    }
+
+    cramer(mn, det, hn, c);
+
+    for (int i = 0; i < 3; i++)
+        if (c[i] >= (1 << 16) || c[i] <= -(1 << 16))
+            return MICROBIT_NO_DATA;
+
+    // Scaling the system down loses precision, so correct the solution for the residual of the full system.
+    int64_t correction[3];
+
+    for (int i = 0; i < 3; i++)
+        hn[i] = (h[i] - m[i][0] * c[0] - m[i][1] * c[1] - m[i][2] * c[2]) >> shift;
+
+    cramer(mn, det, hn, correction);
+
+    for (int i = 0; i < 3; i++)
+        c[i] += correction[i];
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Estimates the centre and radius of the sphere on which the samples lie.
+ *
+ * @param centre Set to the centre of the sphere.
+ *
+ * @param radius Set to the root mean square distance of the samples from the centre.
+ *
+ * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the samples do not yet determine a centre.
+ */
+int CompassSphereFit::getCentre(Sample3D &centre, int &radius)
+{
+    int64_t c[3];
+
+    if (solve(c, NULL) != MICROBIT_OK)
+        return MICROBIT_NO_DATA;
+
+    // The mean of |u - c|^2 over all samples.
+    int64_t d = sumLengths + samples * (c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) - 2 * (c[0] * sum[0] + c[1] * sum[1] + c[2] * sum[2]);
+
+    centre.x = origin.x + (int) c[0] * (1 << COMPASS_SPHERE_FIT_SHIFT);
+    centre.y = origin.y + (int) c[1] * (1 << COMPASS_SPHERE_FIT_SHIFT);
+    centre.z = origin.z + (int) c[2] * (1 << COMPASS_SPHERE_FIT_SHIFT);
+
+    radius = isqrt(d > 0 ? d / samples : 0) * (1 << COMPASS_SPHERE_FIT_SHIFT);
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Estimates how well the samples cover the sphere, from the spread of the samples about their mean.
+ *
+ * @return a value from 0 (all samples lie in a plane) to 1024 (samples are spread evenly in every direction).
+ */
+int CompassSphereFit::getCoverage()
+{
+    int64_t c[3];
+    int coverage;
+
+    solve(c, &coverage);
+
+    return coverage;
 }
 
 /**
@@ -133,7 +385,30 @@ float MicroBitCompassCalibrator::measureScore(Sample3D &c, Sample3D *data, int s
  */
 CompassCalibration MicroBitCompassCalibrator::calibrate(Sample3D *data, int samples)
 {
-    Sample3D centre = approximateCentre(data, samples);
+    CompassSphereFit fit;
+    Sample3D centre;
+    int radius;
+
+    for (int i = 0; i < samples; i++)
+        fit.add(data[i]);
+
+    // Should the samples not determine a sphere, fall back to their centre of mass.
+    if (fit.getCentre(centre, radius) != MICROBIT_OK)
+    {
+        int64_t x = 0, y = 0, z = 0;
+
+        for (int i = 0; i < samples; i++)
+        {
+            x += data[i].x;
+            y += data[i].y;
+            z += data[i].z;
+        }
+
+        centre.x = samples ? x / samples : 0;
+        centre.y = samples ? y / samples : 0;
+        centre.z = samples ? z / samples : 0;
+    }
+
     return spherify(centre, data, samples);
 }
 /**
@@ -154,19 +429,20 @@ CompassCalibration MicroBitCompassCalibrator::spherify(Sample3D centre, Sample3D
     // We use the same algorithm though.
     CompassCalibration result;
 
-    float radius = 0;
-    float scaleX = 0.0;
-    float scaleY = 0.0;
-    float scaleZ = 0.0;
+    int radius = 0;
 
-    float scale = 0.0;
-    float weightX = 0.0;
-    float weightY = 0.0;
-    float weightZ = 0.0;
+    // Scale factors and weights are held in fixed point, with 1024 representing 1.0.
+    int scale = 0;
+    int64_t weightX = 0;
+    int64_t weightY = 0;
+    int64_t weightZ = 0;
 
     for (int i = 0; i < samples; i++)
     {
-        int d = sqrt((float)centre.dSquared(data[i]));
+        int64_t dx = data[i].x - centre.x;
+        int64_t dy = data[i].y - centre.y;
+        int64_t dz = data[i].z - centre.z;
+        int d = isqrt(dx*dx + dy*dy + dz*dz);
 
         if (d > radius)
             radius = d;
@@ -177,33 +453,47 @@ CompassCalibration MicroBitCompassCalibrator::spherify(Sample3D centre, Sample3D
     for (int i = 0; i < samples; i++)
     {
         // Calculate the distance from this point to the centre of the sphere
-        float d = sqrt(centre.dSquared(data[i]));
+        int64_t dx = data[i].x - centre.x;
+        int64_t dy = data[i].y - centre.y;
+        int64_t dz = data[i].z - centre.z;
+        int d = isqrt(dx*dx + dy*dy + dz*dz);
+
+        if (d == 0)
+            continue;
 
         // Now determine a scalar multiplier that, when applied to the vector to the centre,
         // will place this point on the surface of the sphere.
-        float s = (radius / d) - 1;
+        int s = (int) (((int64_t) radius * 1024) / d) - 1024;
 
-        scale = max(scale, s);
+        if (s > scale)
+            scale = s;
 
         // next, determine the scale effect this has on each of our components.
-        float dx = (data[i].x - centre.x); 
-        float dy = (data[i].y - centre.y);
-        float dz = (data[i].z - centre.z);
+        weightX += s * (dx < 0 ? -dx : dx) / d;
+        weightY += s * (dy < 0 ? -dy : dy) / d;
+        weightZ += s * (dz < 0 ? -dz : dz) / d;
+    }
 
-        weightX += s * fabsf(dx / d);
-        weightY += s * fabsf(dy / d);
-        weightZ += s * fabsf(dz / d);
+    // Only the direction of the weights matters, so reduce them as necessary to keep their squares in range.
+    while (weightX >= (1 << 30) || weightY >= (1 << 30) || weightZ >= (1 << 30))
+    {
+        weightX >>= 1;
+        weightY >>= 1;
+        weightZ >>= 1;
     }
 
-    float wmag = sqrt((weightX * weightX) + (weightY * weightY) + (weightZ * weightZ));
+    int64_t wmag = isqrt((weightX * weightX) + (weightY * weightY) + (weightZ * weightZ));
 
-    scaleX = 1.0 + scale * (weightX / wmag);
-    scaleY = 1.0 + scale * (weightY / wmag);
-    scaleZ = 1.0 + scale * (weightZ / wmag);
+    result.scale.x = 1024;
+    result.scale.y = 1024;
+    result.scale.z = 1024;
 
-    result.scale.x = (int)(1024 * scaleX);
-    result.scale.y = (int)(1024 * scaleY);
-    result.scale.z = (int)(1024 * scaleZ);
+    if (wmag > 0)
+    {
+        result.scale.x += (int) (scale * weightX / wmag);
+        result.scale.y += (int) (scale * weightY / wmag);
+        result.scale.z += (int) (scale * weightZ / wmag);
+    }
 
     result.centre.x = centre.x;
     result.centre.y = centre.y;
@@ -214,74 +504,6 @@ CompassCalibration MicroBitCompassCalibrator::spherify(Sample3D centre, Sample3D
     return result;
 }
 
-/*
- * Performs an interative approximation (hill descent) algorithm to determine an
- * estimated centre point of a sphere upon which the given data points reside.
- *
- * @param data an array containing sample points
- * @param samples the number of sample points in the 'data' array.
- *
- * @return the approximated centre point of the points in the 'data' array.
- */
-Sample3D MicroBitCompassCalibrator::approximateCentre(Sample3D *data, int samples)
-{
-    Sample3D c,t;
-    Sample3D centre = { 0,0,0 };
-    Sample3D best = { 0,0,0 };
-
-    float score;
-
-    for (int i = 0; i < samples; i++)
-    {
-        centre.x += data[i].x;
-        centre.y += data[i].y;
-        centre.z += data[i].z;
-    }
-
-    // Calclulate a centre of mass for our input samples. We only use this for validation purposes.
-    centre.x = centre.x / samples;
-    centre.y = centre.y / samples;
-    centre.z = centre.z / samples;
-
-    // Start hill climb in the centre of mass.
-    c = centre;
-
-    // calculate the nearest and furthest point to us.
-    score = measureScore(c, data, samples);
-
-    // iteratively attempt to improve position...
-    while (1)
-    {
-        for (int x = -CALIBRATION_INCREMENT; x <= CALIBRATION_INCREMENT; x=x+CALIBRATION_INCREMENT)
-        {
-            for (int y = -CALIBRATION_INCREMENT; y <= CALIBRATION_INCREMENT; y=y+CALIBRATION_INCREMENT)
-            {
-                for (int z = -CALIBRATION_INCREMENT; z <= CALIBRATION_INCREMENT; z=z+CALIBRATION_INCREMENT)
-                {
-                    t = c;
-                    t.x += x;
-                    t.y += y;
-                    t.z += z;
-
-                    float s = measureScore(t, data, samples);
-                    if (s < score)
-                    {
-                        score = s;
-                        best = t;
-                    }
-                }
-            }
-        }
-
-        if (best.x == c.x && best.y == c.y && best.z == c.z)
-            break;
-
-        c = best;
-    }
-
-    return c;
-}
-
 /**
  * Performs a simple game that in parallel, calibrates the compass.
  *
@@ -312,9 +534,14 @@ void MicroBitCompassCalibrator::calibrateUX(MicroBitEvent)
     Point cursor = {2,2};
 
     MicroBitImage img(5,5);
-    MicroBitImage smiley("0,255,0,255,0\n0,255,0,255,0\n0,0,0,0,0\n255,0,0,0,255\n0,255,255,255,0\n");
+    MICROBIT_IMAGE_LITERAL(smiley, "0,255,0,255,0\n0,255,0,255,0\n0,0,0,0,0\n255,0,0,0,255\n0,255,255,255,0\n");
 
     Sample3D data[PERIMETER_POINTS];
+    CompassSphereFit fit;
+    Sample3D centre;
+    Sample3D lastCentre;
+    int radius;
+    bool settled = false;
     uint8_t visited[PERIMETER_POINTS] = { 0 };
     uint8_t cursor_on = 0;
     uint8_t samples = 0;
@@ -396,24 +623,52 @@ void MicroBitCompassCalibrator::calibrateUX(MicroBitEvent)
             {
                 // Record the sample data for later processing...
                 data[samples] = compass.getSample(RAW);
+                fit.add(data[samples]);
 
                 // Record that this pixel has been visited.
                 visited[i] = 1;
                 samples++;
                 samples_this_period++;
+
+                // Refine our estimate of the centre, and see if it has moved by more than 1/16th of the radius.
+                if (fit.getCentre(centre, radius) == MICROBIT_OK)
+                {
+                    int64_t dx = centre.x - lastCentre.x;
+                    int64_t dy = centre.y - lastCentre.y;
+                    int64_t dz = centre.z - lastCentre.z;
+                    int64_t limit = radius / 16;
+
+                    settled = dx*dx + dy*dy + dz*dz <= limit * limit;
+                    lastCentre = centre;
+                }
             }
         }
+
+        // Finish as soon as the samples gathered cover enough of the sphere to be trusted.
+        if (settled && samples >= MICROBIT_COMPASS_CALIBRATION_MIN_SAMPLES && fit.getCoverage() >= MICROBIT_COMPASS_CALIBRATION_COVERAGE)
+            break;
+
         wait_ms(TIME_STEP);
         remaining_scroll_time-=TIME_STEP;
     }
 
-    CompassCalibration cal = calibrate(data, samples); 
+    CompassCalibration cal = calibrate(data, samples);
     compass.setCalibration(cal);
 
     if(this->storage)
         this->storage->put(ManagedString("compassCal"), (uint8_t *) &cal, sizeof(CompassCalibration));
 
+    // Any samples gathered in the background predate this calibration, so start afresh.
+    if (background && background->active)
+    {
+        background->stored = cal;
+        background->fit.clear();
+        background->samples = 0;
+        background->refining = false;
+    }
+
     // Show a smiley to indicate that we're done, and continue on with the user program.
+    display.stopAnimation();
     display.clear();
     display.printAsync(smiley, 0, 0, 0, 1500);
     wait_ms(1000);
@@ -422,3 +677,155 @@ void MicroBitCompassCalibrator::calibrateUX(MicroBitEvent)
     // Retore the display brightness to the level it was at before this function was called.
     display.setBrightness(displayBrightness);
 }
+
+/**
+  * Starts refining the calibration of the compass in the background, from the samples read as it is used.
+  *
+  * Samples are gathered once they are well spaced from each other, and the calibration is recalculated each time
+  * they cover enough of the sphere. The new calibration is written to storage only if it differs significantly
+  * from that last stored. See MICROBIT_COMPASS_BACKGROUND_SAMPLES and MICROBIT_COMPASS_BACKGROUND_THRESHOLD.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if there is insufficient memory.
+  */
+int MicroBitCompassCalibrator::startBackgroundCalibration()
+{
+    if (background == NULL)
+    {
+        background = new CompassBackgroundCalibration();
+
+        if (background == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        background->stored = compass.getCalibration();
+        background->samples = 0;
+        background->refining = false;
+
+        if (EventModel::defaultEventBus)
+            EventModel::defaultEventBus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE, this, &MicroBitCompassCalibrator::refineCalibration);
+    }
+
+    background->active = true;
+    compass.setCalibrator(this);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops refining the calibration of the compass in the background. The calibration in use is kept.
+  */
+void MicroBitCompassCalibrator::stopBackgroundCalibration()
+{
+    if (background == NULL)
+        return;
+
+    compass.setCalibrator(NULL);
+    background->active = false;
+
+    // If the samples gathered are being processed, refineCalibration() frees the state once complete.
+    if (!background->refining)
+        releaseBackground();
+}
+
+/**
+  * Frees the state of a background calibration, once it has stopped.
+  */
+void MicroBitCompassCalibrator::releaseBackground()
+{
+    if (EventModel::defaultEventBus)
+        EventModel::defaultEventBus->ignore(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE, this, &MicroBitCompassCalibrator::refineCalibration);
+
+    delete background;
+    background = NULL;
+}
+
+/**
+  * Offers a sample to the background calibration. Called by the compass with every sample read.
+  *
+  * This is inexpensive, and may be called from the idle thread. The calibration itself is recalculated
+  * by a MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE event handler.
+  *
+  * @param s The sample, in ENU format, before calibration is applied.
+  */
+void MicroBitCompassCalibrator::addSample(Sample3D s)
+{
+    if (background == NULL || background->refining || compass.isCalibrating())
+        return;
+
+    // Only gather samples at least a quarter of the field radius from those already held, so that a
+    // stationary device doesn't fill the buffer with the same point.
+    int64_t spacing = background->stored.radius / 4;
+
+    for (int i = 0; i < background->samples; i++)
+    {
+        int64_t dx = s.x - background->data[i].x;
+        int64_t dy = s.y - background->data[i].y;
+        int64_t dz = s.z - background->data[i].z;
+
+        if (dx*dx + dy*dy + dz*dz < spacing * spacing)
+            return;
+    }
+
+    background->data[background->samples++] = s;
+    background->fit.add(s);
+
+    if (background->samples >= MICROBIT_COMPASS_CALIBRATION_MIN_SAMPLES && background->fit.getCoverage() >= MICROBIT_COMPASS_CALIBRATION_COVERAGE)
+    {
+        // Enough of the sphere is covered. Recalculate the calibration from a fiber, at the message bus' leisure.
+        background->refining = true;
+        MicroBitEvent(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATION_UPDATE);
+    }
+    else if (background->samples == MICROBIT_COMPASS_BACKGROUND_SAMPLES)
+    {
+        // The samples never covered enough of the sphere. Start again.
+        background->fit.clear();
+        background->samples = 0;
+    }
+}
+
+/**
+ * Recalculates the calibration from the samples gathered in the background, storing it if it has changed significantly.
+ */
+void MicroBitCompassCalibrator::refineCalibration(MicroBitEvent)
+{
+    CompassBackgroundCalibration *b = background;
+
+    if (b == NULL || !b->refining)
+        return;
+
+    CompassCalibration cal = calibrate(b->data, b->samples);
+
+    // Leave the calibration alone if we've been stopped, or the interactive calibration was started in the meantime.
+    if (b->active && !compass.isCalibrating())
+    {
+        compass.setCalibration(cal);
+
+        // Only write to FLASH if the calibration has moved significantly from that last stored.
+        int64_t dx = cal.centre.x - b->stored.centre.x;
+        int64_t dy = cal.centre.y - b->stored.centre.y;
+        int64_t dz = cal.centre.z - b->stored.centre.z;
+        int64_t limit = b->stored.radius / MICROBIT_COMPASS_BACKGROUND_THRESHOLD;
+        int scaleLimit = 1024 / MICROBIT_COMPASS_BACKGROUND_THRESHOLD;
+
+        if (dx*dx + dy*dy + dz*dz > limit * limit ||
+            abs(cal.scale.x - b->stored.scale.x) > scaleLimit ||
+            abs(cal.scale.y - b->stored.scale.y) > scaleLimit ||
+            abs(cal.scale.z - b->stored.scale.z) > scaleLimit)
+        {
+            b->stored = cal;
+
+            if (storage)
+                storage->put(ManagedString("compassCal"), (uint8_t *) &cal, sizeof(CompassCalibration));
+        }
+    }
+
+    // Stopped while the samples were being processed.
+    if (!b->active)
+    {
+        releaseBackground();
+        return;
+    }
+
+    b->fit.clear();
+    b->samples = 0;
+    b->refining = false;
+}
@@ -34,9 +34,15 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitFiber.h"
 #include "ErrorNo.h"
 #include "NotifyEvents.h"
+#include "MicroBitPowerProfile.h"
 
 const int greyScaleTimings[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH] = {1, 23, 70, 163, 351, 726, 1476, 2976};
 
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+// The display driven by the greyscale timer.
+static MicroBitDisplay *greyscaleDisplay = NULL;
+#endif
+
 /**
   * Constructor.
   *
@@ -53,6 +59,7 @@ const int greyScaleTimings[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH] = {1, 23, 70, 1
   * @endcode
   */
 MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
+    freeDisplay(0, 0),
     matrixMap(map),
     image(map.width*2,map.height)
 {
@@ -68,6 +75,22 @@ MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
     strobeRow = 0;
     row_mask = 0;
 
+    blankRows = 0;
+    blankIdle = false;
+    lightSenseFrames = 0;
+
+    frontBuffer = NULL;
+    frontBufferSize = 0;
+    swapPending = 0;
+
+    animationQueueHead = 0;
+    animationQueueLength = 0;
+    animationTicket = 0;
+    animationCurrent = 0;
+    animationCompleted = 0;
+    animationCancelledFrom = 1;
+    animationCancelledTo = 0;
+
     for (int i = matrixMap.rowStart; i < matrixMap.rowStart + matrixMap.rows; i++)
         row_mask |= 0x01 << i;
 
@@ -76,16 +99,148 @@ MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
 
     LEDMatrix = new PortOut(Port0, row_mask | col_mask);
 
+    strobeTable = (uint16_t *) malloc(matrixMap.rows * matrixMap.columns * sizeof(uint16_t));
+    updateStrobeTable();
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    // The brightness timer is configured on each strobe, as it shares its timer.
+    NRF_GPIOTE->CONFIG[MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL] = 0;
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+    // Configure the greyscale timer as a 1MHz counter, which restarts from zero at the end of each bit plane.
+    greyscaleDisplay = this;
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_STOP = 1;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->PRESCALER = 4;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+    NVIC_SetVector(MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn, (uint32_t) &MicroBitDisplay::greyscaleTimerHandler);
+    NVIC_EnableIRQ(MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn);
+#endif
+
     this->greyscaleBitMsk = 0x01;
     this->timingCount = 0;
     this->setBrightness(MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS);
     this->mode = DISPLAY_MODE_BLACK_AND_WHITE;
     this->animationMode = ANIMATION_MODE_NONE;
     this->lightSensor = NULL;
+    this->lightFilterType = MICROBIT_FILTER_NONE;
+    this->lightFilterLength = 1;
 
 	system_timer_add_component(this);
 
     status |= MICROBIT_COMPONENT_RUNNING;
+
+    updateTickRequirement();
+}
+
+/**
+  * Informs the system tick governor of the tick period the display needs in its current mode,
+  * or that it needs none if the display is disabled.
+  */
+void MicroBitDisplay::updateTickRequirement()
+{
+    int period = 0;
+
+    // The display is strobed one row per tick, so needs a steady tick while it is running.
+    // While the image is blank, the display only needs to tick often enough to notice something being drawn.
+    if (status & MICROBIT_COMPONENT_RUNNING)
+        period = blankIdle && mode == DISPLAY_MODE_BLACK_AND_WHITE ? 0 : SYSTEM_TICK_PERIOD_MS;
+
+    system_timer_set_requirement(this, period);
+}
+
+/**
+  * Determines the columns lit in the given row of the matrix.
+  *
+  * @param row The row of the matrix.
+  *
+  * @return A bitmask of the lit columns, where bit 0 is the first column of the matrix.
+  */
+uint32_t MicroBitDisplay::getRowPattern(int row)
+{
+    const uint16_t *offsets = strobeTable + row * matrixMap.columns;
+    const uint8_t *bitmap = getFrameBitmap();
+    uint32_t pattern = 0;
+
+    for (int i = 0; i < matrixMap.columns; i++)
+    {
+        if(bitmap[offsets[i]])
+            pattern |= (1 << i);
+    }
+
+    return pattern;
+}
+
+/**
+  * Tracks whether the image has been blank for a whole frame, with no animation running, and if so relaxes
+  * the display's system tick requirement until something is drawn again. Used in black and white mode.
+  */
+void MicroBitDisplay::updateBlankIdle()
+{
+    bool idle = blankRows >= matrixMap.rows && animationMode == ANIMATION_MODE_NONE && animationQueueLength == 0;
+
+    // Ticks may be far apart while idle, so look at the whole image rather than waiting for a lit row to be strobed.
+    if (idle && blankIdle)
+    {
+        for (int row = 0; row < matrixMap.rows; row++)
+        {
+            if (getRowPattern(row))
+            {
+                blankRows = 0;
+                idle = false;
+                break;
+            }
+        }
+    }
+
+    if (idle != blankIdle)
+    {
+        blankIdle = idle;
+        updateTickRequirement();
+    }
+}
+
+/**
+  * Recomputes the strobe table for the current rotation.
+  */
+void MicroBitDisplay::updateStrobeTable()
+{
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        for (int i = 0; i < matrixMap.columns; i++)
+        {
+            int index = (i * matrixMap.rows) + row;
+
+            int x = matrixMap.map[index].x;
+            int y = matrixMap.map[index].y;
+            int t = x;
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+            {
+                    x = width - 1 - y;
+                    y = t;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+            {
+                    x = width - 1 - x;
+                    y = height - 1 - y;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+            {
+                    x = y;
+                    y = height - 1 - t;
+            }
+
+            strobeTable[row * matrixMap.columns + i] = y * (width * 2) + x;
+        }
+    }
 }
 
 /**
@@ -110,10 +265,38 @@ void MicroBitDisplay::systemTick()
 
     //reset the row counts and bit mask when we have hit the max.
     if(strobeRow == matrixMap.rows)
+    {
         strobeRow = 0;
+        publishFrame();
+    }
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_SKIP_BLANK_ROWS)
+    // Move on past any blank rows, unless every row is blank.
+    if(mode == DISPLAY_MODE_BLACK_AND_WHITE && brightness)
+    {
+        for (int i = 1; i < matrixMap.rows && getRowPattern(strobeRow) == 0; i++)
+        {
+            strobeRow++;
+
+            if(strobeRow == matrixMap.rows)
+            {
+                strobeRow = 0;
+                publishFrame();
+            }
+        }
+    }
+#endif
 
     if(mode == DISPLAY_MODE_BLACK_AND_WHITE)
+    {
         render();
+        updateBlankIdle();
+    }
+    else if (blankIdle)
+    {
+        blankRows = 0;
+        updateBlankIdle();
+    }
 
     if(mode == DISPLAY_MODE_GREYSCALE)
     {
@@ -131,8 +314,26 @@ void MicroBitDisplay::renderFinish()
     *LEDMatrix = 0;
 }
 
+/**
+  * Called as the strobe returns to the first row. Publishes the back buffer if a swap has been requested.
+  */
+void MicroBitDisplay::publishFrame()
+{
+    if (!swapPending || frontBuffer == NULL)
+        return;
+
+    memcpy(frontBuffer, image.getBitmap(), min(frontBufferSize, image.getSize()));
+    swapPending = 0;
+
+    MicroBitEvent(id, MICROBIT_DISPLAY_EVT_FRAME_SWAPPED);
+}
+
 void MicroBitDisplay::render()
 {
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    stopBrightnessTimer();
+#endif
+
     // Simple optimisation.
     // If display is at zero brightness, there's nothing to do.
     if(brightness == 0)
@@ -145,45 +346,58 @@ void MicroBitDisplay::render()
     uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
     uint32_t col_data = 0;
 
-    for (int i = 0; i < matrixMap.columns; i++)
+    // In light sense mode, one strobe is given over to the sensor and has no row of its own.
+    if (strobeRow < matrixMap.rows)
+        col_data = getRowPattern(strobeRow);
+
+    // Rows with nothing to show are not driven at all, and need no brightness callback.
+    if (col_data == 0)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        if (blankRows < 0xFF)
+            blankRows++;
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+        renderFinish();
+        return;
+    }
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
+    blankRows = 0;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
+#if CONFIG_ENABLED(MICROBIT_POWER_PROFILING)
+    // Account for the time each LED in this row will be lit.
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    uint32_t onTime = brightness == MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS ? system_timer_get_period() * 1000 :
+                      ((brightness * 950) / (MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)) * system_timer_get_period();
+#else
+    uint32_t onTime = brightness == MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS ? system_timer_get_period() * 1000 :
+                      brightness > MICROBIT_DISPLAY_MINIMUM_BRIGHTNESS ? ((brightness * 950) / (MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)) * system_timer_get_period() : 23;
+#endif
+    int lit = 0;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
-        {
-                x = y;
-                y = height - 1 - t;
-        }
+    for (uint32_t c = col_data; c; c &= c - 1)
+        lit++;
 
-        if(image.getBitmap()[y*(width*2)+x])
-            col_data |= (1 << i);
-    }
+    POWER_PROFILE_ADD_TIME(MICROBIT_POWER_DOMAIN_DISPLAY, lit * onTime);
+#endif
 
     // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
     col_data = ~col_data << matrixMap.columnStart & col_mask;
 
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    if(brightness != MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)
+    {
+        // Write the columns only. The row is driven, and released on time, by the brightness timer.
+        *LEDMatrix = col_data;
+        startBrightnessTimer(matrixMap.rowStart + strobeRow, ((brightness * 950) / (MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)) * system_timer_get_period());
+        return;
+    }
+#endif
+
     // Write the new bit pattern
     *LEDMatrix = col_data | row_data;
 
     //timer does not have enough resolution for brightness of 1. 23.53 us
     if(brightness != MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS && brightness > MICROBIT_DISPLAY_MINIMUM_BRIGHTNESS)
-        renderTimer.attach_us(this, &MicroBitDisplay::renderFinish, (((brightness * 950) / (MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)) * system_timer_get_period()));
+        system_timer_event_after_us(&renderTimer, (((brightness * 950) / (MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS)) * system_timer_get_period()), system_timer_method_callback<MicroBitDisplay, &MicroBitDisplay::renderFinish>, this);
 
     //this will take around 23us to execute
     if(brightness <= MICROBIT_DISPLAY_MINIMUM_BRIGHTNESS)
@@ -197,20 +411,93 @@ void MicroBitDisplay::renderWithLightSense()
     {
         MicroBitEvent(id, MICROBIT_DISPLAY_EVT_LIGHT_SENSE);
         strobeRow = 0;
-    }
-    else
-    {
-        render();
+        publishFrame();
         this->animationUpdate();
+        return;
+    }
+
+    render();
+    this->animationUpdate();
 
-        // Move on to the next row.
-        strobeRow++;
+    // Move on to the next row.
+    strobeRow++;
+
+    // The matrix is blanked for two slots while the sensor samples, so only give those slots to the sensor
+    // once in every MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES frames, and show the image in the remainder.
+    if(strobeRow == matrixMap.rows && ++lightSenseFrames < MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES)
+    {
+        strobeRow = 0;
+        publishFrame();
+    }
+    else if(strobeRow == matrixMap.rows)
+    {
+        lightSenseFrames = 0;
     }
+}
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+/**
+  * Lights the given row through the brightness GPIOTE channel, and starts the timer that turns it off.
+  *
+  * @param pin the pin of the row.
+  *
+  * @param onTime the time to light the row for, in microseconds.
+  */
+void MicroBitDisplay::startBrightnessTimer(int pin, uint32_t onTime)
+{
+    // A one shot 1MHz timer, whose compare event clears the row through PPI without interrupting the processor.
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->PRESCALER = 4;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_STOP_Msk;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->CC[0] = onTime == 0 ? 1 : onTime > 0xFFFF ? 0xFFFF : onTime;
+
+    NRF_PPI->CH[MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL].EEP = (uint32_t) &MICROBIT_DISPLAY_GREYSCALE_TIMER->EVENTS_COMPARE[0];
+    NRF_PPI->CH[MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL].TEP = (uint32_t) &NRF_GPIOTE->TASKS_OUT[MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL];
+    NRF_PPI->CHENSET = 1 << MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL;
+
+    // Taking the pin as a task drives it high immediately, and the task drives it low.
+    NRF_GPIOTE->CONFIG[MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos) |
+                                                                     (pin << GPIOTE_CONFIG_PSEL_Pos) |
+                                                                     (GPIOTE_CONFIG_POLARITY_HiToLo << GPIOTE_CONFIG_POLARITY_Pos) |
+                                                                     (GPIOTE_CONFIG_OUTINIT_High << GPIOTE_CONFIG_OUTINIT_Pos);
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_START = 1;
+}
 
+/**
+  * Stops the brightness timer, and returns the row pin it was driving to the port.
+  */
+void MicroBitDisplay::stopBrightnessTimer()
+{
+    if (!(NRF_PPI->CHEN & (1 << MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL)))
+        return;
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_STOP = 1;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_CLEAR = 1;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->EVENTS_COMPARE[0] = 0;
+
+    NRF_PPI->CHENCLR = 1 << MICROBIT_DISPLAY_BRIGHTNESS_PPI_CHANNEL;
+
+    // The row bit of the port is always clear, so the row stays dark once released.
+    NRF_GPIOTE->CONFIG[MICROBIT_DISPLAY_BRIGHTNESS_GPIOTE_CHANNEL] = 0;
 }
+#endif
 
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
 void MicroBitDisplay::renderGreyscale()
 {
+    stopGreyscaleTimer();
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    // Take the timer back from the brightness timer, if the mode has just changed.
+    stopBrightnessTimer();
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+#endif
+
     // Simple optimisation.
     // If display is at zero brightness, there's nothing to do.
     if(brightness == 0)
@@ -220,36 +507,102 @@ void MicroBitDisplay::renderGreyscale()
     }
 
     uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
+    uint32_t planes[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH];
 
-    // Calculate the bitpattern to write.
+    const uint16_t *offsets = strobeTable + strobeRow * matrixMap.columns;
+    const uint8_t *bitmap = getFrameBitmap();
+
+    memclr(planes, sizeof(planes));
+
+    // Calculate the bitpattern of every plane in one pass over the row.
     for (int i = 0; i < matrixMap.columns; i++)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        uint8_t v = min(bitmap[offsets[i]], brightness);
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+        for (int b = 0; b < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; b++)
+            if (v & (1 << b))
+                planes[b] |= (1 << i);
+    }
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
+    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+    for (int b = 0; b < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; b++)
+        greyscalePlanes[b] = (~planes[b] << matrixMap.columnStart & col_mask) | row_data;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
+    // The first few planes are too short to be worth an interrupt, so are shown by busy waiting.
+    for (timingCount = 0; timingCount < MICROBIT_DISPLAY_GREYSCALE_WAIT_PLANES; timingCount++)
+    {
+        *LEDMatrix = greyscalePlanes[timingCount];
+        wait_us(greyScaleTimings[timingCount]);
+    }
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
-        {
-                x = y;
-                y = height - 1 - t;
-        }
+    // Hand the rest over to the greyscale timer.
+    *LEDMatrix = greyscalePlanes[timingCount];
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_CLEAR = 1;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->CC[0] = greyScaleTimings[timingCount];
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_START = 1;
+}
+
+/**
+  * Greyscale timer interrupt handler. Shows the next bit plane of the current row.
+  */
+void MicroBitDisplay::greyscaleTimerHandler()
+{
+    MicroBitDisplay *d = greyscaleDisplay;
+
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->EVENTS_COMPARE[0] = 0;
+
+    if (d == NULL || ++d->timingCount >= MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH)
+    {
+        // The row is complete. Leave it dark until the next strobe.
+        MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_STOP = 1;
+
+        if (d)
+            d->renderFinish();
+
+        return;
+    }
+
+    // The timer restarted from zero on the compare, so the next plane's length is independent of our latency.
+    *d->LEDMatrix = d->greyscalePlanes[d->timingCount];
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->CC[0] = greyScaleTimings[d->timingCount];
+}
+
+/**
+  * Stops the greyscale timer, abandoning any bit planes still to be shown.
+  */
+void MicroBitDisplay::stopGreyscaleTimer()
+{
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->TASKS_STOP = 1;
+    MICROBIT_DISPLAY_GREYSCALE_TIMER->EVENTS_COMPARE[0] = 0;
+    NVIC_ClearPendingIRQ(MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn);
+}
+#else
+void MicroBitDisplay::renderGreyscale()
+{
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    // Return the row to the port, if the mode has just changed.
+    stopBrightnessTimer();
+#endif
+
+    // Simple optimisation.
+    // If display is at zero brightness, there's nothing to do.
+    if(brightness == 0)
+    {
+        renderFinish();
+        return;
+    }
+
+    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
+    uint32_t col_data = 0;
+
+    const uint16_t *offsets = strobeTable + strobeRow * matrixMap.columns;
+    const uint8_t *bitmap = getFrameBitmap();
 
-        if(min(image.getBitmap()[y * (width * 2) + x],brightness) & greyscaleBitMsk)
+    // Calculate the bitpattern to write.
+    for (int i = 0; i < matrixMap.columns; i++)
+    {
+        if(min(bitmap[offsets[i]],brightness) & greyscaleBitMsk)
             col_data |= (1 << i);
     }
 
@@ -270,8 +623,9 @@ void MicroBitDisplay::renderGreyscale()
         renderGreyscale();
         return;
     }
-    renderTimer.attach_us(this,&MicroBitDisplay::renderGreyscale, greyScaleTimings[timingCount++]);
+    system_timer_event_after_us(&renderTimer, greyScaleTimings[timingCount++], system_timer_method_callback<MicroBitDisplay, &MicroBitDisplay::renderGreyscale>, this);
 }
+#endif
 
 /**
   * Periodic callback, that we use to perform any animations we have running.
@@ -279,6 +633,10 @@ void MicroBitDisplay::renderGreyscale()
 void
 MicroBitDisplay::animationUpdate()
 {
+    // Once an animation has finished, start the next one waiting in the queue (if any).
+    while ((animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED) && animationQueueLength > 0)
+        startNextAnimation();
+
     // If there's no ongoing animation, then nothing to do.
     if (animationMode == ANIMATION_MODE_NONE)
         return;
@@ -306,6 +664,8 @@ MicroBitDisplay::animationUpdate()
             animationMode = ANIMATION_MODE_NONE;
             this->sendAnimationCompleteEvent();
         }
+
+        swapAsync();
     }
 }
 
@@ -315,36 +675,49 @@ MicroBitDisplay::animationUpdate()
   */
 void MicroBitDisplay::sendAnimationCompleteEvent()
 {
+    animationCompleted = animationCurrent;
+
     // Signal that we've completed an animation.
     MicroBitEvent(id,MICROBIT_DISPLAY_EVT_ANIMATION_COMPLETE);
 
     // Wake up a fiber that was blocked on the animation (if any).
-    MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, MICROBIT_DISPLAY_EVT_FREE);
+    freeDisplay.notify();
 }
 
 /**
   * Internal scrollText update method.
-  * Shift the screen image by one pixel to the left. If necessary, paste in the next char.
+  * Shift the screen image by one pixel to the left, and draw the newly exposed column of the current char.
   */
 void MicroBitDisplay::updateScrollText()
 {
+    // Once the last character has been shown, continue scrolling blank columns until the text has left the display.
+    if (scrollingChar >= scrollingText.length() && scrollingPosition >= width)
+    {
+        animationMode = ANIMATION_MODE_NONE;
+        this->sendAnimationCompleteEvent();
+        return;
+    }
+
     image.shiftLeft(1);
+
+    // Decode only the newly exposed column of the current glyph, and write it into the rightmost visible column.
+    MicroBitFont font = MicroBitFont::getSystemFont();
+    int c = scrollingChar < scrollingText.length() ? scrollingText.charAt(scrollingChar) : ' ';
+    const unsigned char *glyph = NULL;
+
+    if (scrollingPosition < MICROBIT_FONT_WIDTH && c >= MICROBIT_FONT_ASCII_START && c <= font.asciiEnd)
+        glyph = font.characters + (c - MICROBIT_FONT_ASCII_START) * MICROBIT_FONT_HEIGHT;
+
+    for (int row = 0; row < height; row++)
+        image.setPixelValue(width - 1, row, (glyph && row < MICROBIT_FONT_HEIGHT && (glyph[row] & (0x10 >> scrollingPosition))) ? 255 : 0);
+
     scrollingPosition++;
 
-    if (scrollingPosition == width + MICROBIT_DISPLAY_SPACING)
+    if (scrollingChar < scrollingText.length() && scrollingPosition == MICROBIT_FONT_WIDTH + MICROBIT_DISPLAY_SPACING)
     {
         scrollingPosition = 0;
-
-        image.print(scrollingChar < scrollingText.length() ? scrollingText.charAt(scrollingChar) : ' ',width,0);
-
-        if (scrollingChar > scrollingText.length())
-        {
-            animationMode = ANIMATION_MODE_NONE;
-            this->sendAnimationCompleteEvent();
-            return;
-        }
         scrollingChar++;
-   }
+    }
 }
 
 /**
@@ -425,20 +798,38 @@ void MicroBitDisplay::updateAnimateImage()
   */
 void MicroBitDisplay::stopAnimation()
 {
+    // Discard any animations waiting to be shown. Their resources are released once the queue is no longer visible
+    // to the strobe, as releasing them may reenable interrupts.
+    __disable_irq();
+    int queued = animationQueueLength;
+    animationQueueHead = 0;
+    animationQueueLength = 0;
+    animationCancelledFrom = animationCompleted + 1;
+    animationCancelledTo = animationTicket;
+    animationCompleted = animationTicket;
+    __enable_irq();
+
+    for (int i = 0; i < MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE; i++)
+    {
+        animationQueue[i].text = ManagedString();
+        animationQueue[i].image = MicroBitImage();
+    }
+
     // Reset any ongoing animation.
-    if (animationMode != ANIMATION_MODE_NONE)
+    if (animationMode != ANIMATION_MODE_NONE || queued)
     {
         animationMode = ANIMATION_MODE_NONE;
 
         // Indicate that we've completed an animation.
         MicroBitEvent(id,MICROBIT_DISPLAY_EVT_ANIMATION_COMPLETE);
 
-        // Wake up aall fibers that may blocked on the animation (if any).
-        MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_DISPLAY_EVT_FREE);
+        // Wake up all fibers that may blocked on the animation (if any).
+        freeDisplay.notifyAll();
     }
 
     // Clear the display and setup the animation timers.
     this->image.clear();
+    swapAsync();
 }
 
 /**
@@ -447,9 +838,165 @@ void MicroBitDisplay::stopAnimation()
   */
 void MicroBitDisplay::waitForFreeDisplay()
 {
-    // If there's an ongoing animation, wait for our turn to display.
-    if (animationMode != ANIMATION_MODE_NONE && animationMode != ANIMATION_MODE_STOPPED)
-        fiber_wait_for_event(MICROBIT_ID_NOTIFY, MICROBIT_DISPLAY_EVT_FREE);
+    // If there's an ongoing or queued animation, wait for our turn to display.
+    if ((animationMode != ANIMATION_MODE_NONE && animationMode != ANIMATION_MODE_STOPPED) || animationQueueLength > 0)
+        freeDisplay.wait();
+}
+
+/**
+  * Starts the given animation, replacing the state of any previous animation.
+  *
+  * @param a The animation to start.
+  */
+void MicroBitDisplay::startAnimation(const DisplayAnimation &a)
+{
+    animationCurrent = a.ticket;
+    animationDelay = a.delay;
+    animationTick = 0;
+
+    switch (a.mode)
+    {
+        case ANIMATION_MODE_PRINT_CHARACTER:
+            if (a.character)
+                image.print(a.character, 0, 0);
+            else
+                image.paste(a.image, a.x, a.y, a.alpha);
+
+            swapAsync();
+
+            // A zero delay shows the character or image until the display is next used, so completes immediately.
+            animationMode = a.delay > 0 ? ANIMATION_MODE_PRINT_CHARACTER : ANIMATION_MODE_NONE;
+            break;
+
+        case ANIMATION_MODE_PRINT_TEXT:
+            printingChar = 0;
+            printingText = a.text;
+            animationMode = ANIMATION_MODE_PRINT_TEXT;
+            break;
+
+        case ANIMATION_MODE_SCROLL_TEXT:
+            scrollingPosition = 0;
+            scrollingChar = 0;
+            scrollingText = a.text;
+            animationMode = ANIMATION_MODE_SCROLL_TEXT;
+            break;
+
+        case ANIMATION_MODE_SCROLL_IMAGE:
+            scrollingImagePosition = a.stride < 0 ? width : -a.image.getWidth();
+            scrollingImageStride = a.stride;
+            scrollingImage = a.image;
+            scrollingImageRendered = false;
+
+            animationDelay = a.stride == 0 ? 0 : a.delay;
+            animationMode = ANIMATION_MODE_SCROLL_IMAGE;
+            break;
+
+        case ANIMATION_MODE_ANIMATE_IMAGE:
+        case ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR:
+            // Assume right to left functionality, to align with scrollString()
+            scrollingImageStride = -a.stride;
+
+            //calculate starting position which is offset by the stride
+            scrollingImagePosition = (a.x == MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS) ? MICROBIT_DISPLAY_WIDTH + scrollingImageStride : a.x;
+            scrollingImage = a.image;
+            scrollingImageRendered = false;
+
+            animationDelay = a.stride == 0 ? 0 : a.delay;
+            animationTick = a.delay-1;
+            animationMode = (AnimationMode) a.mode;
+            break;
+
+        default:
+            animationMode = ANIMATION_MODE_NONE;
+            break;
+    }
+}
+
+/**
+  * Removes the animation at the head of the queue, and starts it.
+  */
+void MicroBitDisplay::startNextAnimation()
+{
+    DisplayAnimation a = animationQueue[animationQueueHead];
+
+    animationQueue[animationQueueHead].text = ManagedString();
+    animationQueue[animationQueueHead].image = MicroBitImage();
+
+    animationQueueHead = (animationQueueHead + 1) % MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE;
+    animationQueueLength--;
+
+    startAnimation(a);
+
+    if (animationMode == ANIMATION_MODE_NONE)
+        this->sendAnimationCompleteEvent();
+}
+
+/**
+  * Starts the given animation if the display is free, or adds it to the animation queue otherwise.
+  *
+  * @param a The animation to show.
+  *
+  * @param ticket Populated with the ticket issued to the animation.
+  *
+  * @return MICROBIT_OK, or MICROBIT_BUSY if the animation queue is full.
+  */
+int MicroBitDisplay::queueAnimation(DisplayAnimation &a, uint16_t &ticket)
+{
+    __disable_irq();
+
+    bool idle = (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED) && animationQueueLength == 0;
+
+    if (!idle && animationQueueLength == MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE)
+    {
+        __enable_irq();
+        return MICROBIT_BUSY;
+    }
+
+    a.ticket = ++animationTicket;
+    ticket = a.ticket;
+
+    // Queue slots are empty, so filling one releases nothing, and interrupts remain disabled.
+    if (!idle)
+    {
+        animationQueue[(animationQueueHead + animationQueueLength) % MICROBIT_DISPLAY_ANIMATION_QUEUE_SIZE] = a;
+        animationQueueLength++;
+    }
+
+    __enable_irq();
+
+    if (idle)
+    {
+        startAnimation(a);
+
+        if (animationMode == ANIMATION_MODE_NONE)
+            animationCompleted = a.ticket;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Shows the given animation, blocking the calling fiber until there is space for it in the animation queue,
+  * and then until it has completed.
+  *
+  * @param a The animation to show.
+  *
+  * @return MICROBIT_OK, or MICROBIT_CANCELLED if the animation was stopped by stopAnimation().
+  */
+int MicroBitDisplay::runAnimation(DisplayAnimation &a)
+{
+    uint16_t ticket;
+
+    while (queueAnimation(a, ticket) == MICROBIT_BUSY)
+        waitForFreeDisplay();
+
+    while ((int16_t)(animationCompleted - ticket) < 0)
+        fiberWait();
+
+    if ((int16_t)(ticket - animationCancelledFrom) >= 0 && (int16_t)(animationCancelledTo - ticket) >= 0)
+        return MICROBIT_CANCELLED;
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -464,14 +1011,14 @@ void MicroBitDisplay::fiberWait()
 }
 
 /**
-  * Prints the given character to the display, if it is not in use.
+  * Prints the given character to the display, or queues it if the display is in use.
   *
   * @param c The character to display.
   *
   * @param delay Optional parameter - the time for which to show the character. Zero displays the character forever,
   *              or until the Displays next use.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY is the screen is in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * display.printAsync('p');
@@ -480,28 +1027,18 @@ void MicroBitDisplay::fiberWait()
   */
 int MicroBitDisplay::printCharAsync(char c, int delay)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     //sanitise this value
     if(delay < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If the display is free, it's our turn to display.
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        image.print(c, 0, 0);
+    a.mode = ANIMATION_MODE_PRINT_CHARACTER;
+    a.character = c ? c : ' ';
+    a.delay = delay;
 
-        if (delay > 0)
-        {
-            animationDelay = delay;
-            animationTick = 0;
-            animationMode = ANIMATION_MODE_PRINT_CHARACTER;
-        }
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
-
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
@@ -513,7 +1050,7 @@ int MicroBitDisplay::printCharAsync(char c, int delay)
   * @param delay The time to delay between characters, in milliseconds. Must be > 0.
   *              Defaults to: MICROBIT_DEFAULT_PRINT_SPEED.
   *
-  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * display.printAsync("abc123",400);
@@ -521,6 +1058,9 @@ int MicroBitDisplay::printCharAsync(char c, int delay)
   */
 int MicroBitDisplay::printAsync(ManagedString s, int delay)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     if (s.length() == 1)
         return printCharAsync(s.charAt(0));
 
@@ -528,25 +1068,15 @@ int MicroBitDisplay::printAsync(ManagedString s, int delay)
     if (delay <= 0 )
         return MICROBIT_INVALID_PARAMETER;
 
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        printingChar = 0;
-        printingText = s;
-        animationDelay = delay;
-        animationTick = 0;
+    a.mode = ANIMATION_MODE_PRINT_TEXT;
+    a.text = s;
+    a.delay = delay;
 
-        animationMode = ANIMATION_MODE_PRINT_TEXT;
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
-
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
-  * Prints the given image to the display, if the display is not in use.
+  * Prints the given image to the display, or queues it if the display is in use.
   * Returns immediately, and executes the animation asynchronously.
   *
   * @param i The image to display.
@@ -566,26 +1096,21 @@ int MicroBitDisplay::printAsync(ManagedString s, int delay)
   */
 int MicroBitDisplay::printAsync(MicroBitImage i, int x, int y, int alpha, int delay)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     if(delay < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        image.paste(i, x, y, alpha);
-
-        if(delay > 0)
-        {
-            animationDelay = delay;
-            animationTick = 0;
-            animationMode = ANIMATION_MODE_PRINT_CHARACTER;
-        }
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
+    a.mode = ANIMATION_MODE_PRINT_CHARACTER;
+    a.character = 0;
+    a.image = i;
+    a.x = x;
+    a.y = y;
+    a.alpha = alpha;
+    a.delay = delay;
 
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
@@ -605,27 +1130,16 @@ int MicroBitDisplay::printAsync(MicroBitImage i, int x, int y, int alpha, int de
   */
 int MicroBitDisplay::printChar(char c, int delay)
 {
+    DisplayAnimation a;
+
     if (delay < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
-
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        this->printCharAsync(c, delay);
+    a.mode = ANIMATION_MODE_PRINT_CHARACTER;
+    a.character = c ? c : ' ';
+    a.delay = delay;
 
-        if (delay > 0)
-            fiberWait();
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
-
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 /**
@@ -646,33 +1160,20 @@ int MicroBitDisplay::printChar(char c, int delay)
   */
 int MicroBitDisplay::print(ManagedString s, int delay)
 {
+    DisplayAnimation a;
+
     //sanitise this value
     if(delay <= 0 )
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
+    if (s.length() == 1)
+        return printChar(s.charAt(0));
 
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        if (s.length() == 1)
-        {
-            return printCharAsync(s.charAt(0));
-        }
-        else
-        {
-            this->printAsync(s, delay);
-            fiberWait();
-        }
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
+    a.mode = ANIMATION_MODE_PRINT_TEXT;
+    a.text = s;
+    a.delay = delay;
 
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 /**
@@ -689,7 +1190,7 @@ int MicroBitDisplay::print(ManagedString s, int delay)
   *
   * @param delay The time to display the image for, or zero to show the image forever. Defaults to 0.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_CANCELLED or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * MicrobitImage i("1,1,1,1,1\n1,1,1,1,1\n");
@@ -698,27 +1199,20 @@ int MicroBitDisplay::print(ManagedString s, int delay)
   */
 int MicroBitDisplay::print(MicroBitImage i, int x, int y, int alpha, int delay)
 {
+    DisplayAnimation a;
+
     if(delay < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
-
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        this->printAsync(i, x, y, alpha, delay);
-
-        if (delay > 0)
-            fiberWait();
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
+    a.mode = ANIMATION_MODE_PRINT_CHARACTER;
+    a.character = 0;
+    a.image = i;
+    a.x = x;
+    a.y = y;
+    a.alpha = alpha;
+    a.delay = delay;
 
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 /**
@@ -730,7 +1224,7 @@ int MicroBitDisplay::print(MicroBitImage i, int x, int y, int alpha, int delay)
   * @param delay The time to delay between characters, in milliseconds. Defaults
   *              to: MICROBIT_DEFAULT_SCROLL_SPEED.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * display.scrollAsync("abc123",100);
@@ -738,27 +1232,18 @@ int MicroBitDisplay::print(MicroBitImage i, int x, int y, int alpha, int delay)
   */
 int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     //sanitise this value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If the display is free, it's our turn to display.
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        scrollingPosition = width-1;
-        scrollingChar = 0;
-        scrollingText = s;
+    a.mode = ANIMATION_MODE_SCROLL_TEXT;
+    a.text = s;
+    a.delay = delay;
 
-        animationDelay = delay;
-        animationTick = 0;
-        animationMode = ANIMATION_MODE_SCROLL_TEXT;
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
-
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
@@ -772,7 +1257,7 @@ int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
   *
   * @param stride The number of pixels to shift by in each update. Defaults to MICROBIT_DEFAULT_SCROLL_STRIDE.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * MicrobitImage i("1,1,1,1,1\n1,1,1,1,1\n");
@@ -781,28 +1266,19 @@ int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
   */
 int MicroBitDisplay::scrollAsync(MicroBitImage image, int delay, int stride)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     //sanitise the delay value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If the display is free, it's our turn to display.
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        scrollingImagePosition = stride < 0 ? width : -image.getWidth();
-        scrollingImageStride = stride;
-        scrollingImage = image;
-        scrollingImageRendered = false;
+    a.mode = ANIMATION_MODE_SCROLL_IMAGE;
+    a.image = image;
+    a.delay = delay;
+    a.stride = stride;
 
-        animationDelay = stride == 0 ? 0 : delay;
-        animationTick = 0;
-        animationMode = ANIMATION_MODE_SCROLL_IMAGE;
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
-
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
@@ -822,29 +1298,17 @@ int MicroBitDisplay::scrollAsync(MicroBitImage image, int delay, int stride)
   */
 int MicroBitDisplay::scroll(ManagedString s, int delay)
 {
+    DisplayAnimation a;
+
     //sanitise this value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
-
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        // Start the effect.
-        this->scrollAsync(s, delay);
-
-        // Wait for completion.
-        fiberWait();
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
+    a.mode = ANIMATION_MODE_SCROLL_TEXT;
+    a.text = s;
+    a.delay = delay;
 
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 /**
@@ -867,29 +1331,18 @@ int MicroBitDisplay::scroll(ManagedString s, int delay)
   */
 int MicroBitDisplay::scroll(MicroBitImage image, int delay, int stride)
 {
+    DisplayAnimation a;
+
     //sanitise the delay value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
-
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        // Start the effect.
-        this->scrollAsync(image, delay, stride);
+    a.mode = ANIMATION_MODE_SCROLL_IMAGE;
+    a.image = image;
+    a.delay = delay;
+    a.stride = stride;
 
-        // Wait for completion.
-        fiberWait();
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
-
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 /**
@@ -907,7 +1360,7 @@ int MicroBitDisplay::scroll(MicroBitImage image, int delay, int stride)
   *
   * @param autoClear defines whether or not the display is automatically cleared once the animation is complete. By default, the display is cleared. Set this parameter to zero to disable the autoClear operation.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY if the screen is in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the animation queue is full, or MICROBIT_INVALID_PARAMETER.
   *
   * @code
   * const int heart_w = 10;
@@ -920,32 +1373,20 @@ int MicroBitDisplay::scroll(MicroBitImage image, int delay, int stride)
   */
 int MicroBitDisplay::animateAsync(MicroBitImage image, int delay, int stride, int startingPosition, int autoClear)
 {
+    DisplayAnimation a;
+    uint16_t ticket;
+
     //sanitise the delay value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If the display is free, we can display.
-    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
-    {
-        // Assume right to left functionality, to align with scrollString()
-        stride = -stride;
-
-        //calculate starting position which is offset by the stride
-        scrollingImagePosition = (startingPosition == MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS) ? MICROBIT_DISPLAY_WIDTH + stride : startingPosition;
-        scrollingImageStride = stride;
-        scrollingImage = image;
-        scrollingImageRendered = false;
-
-        animationDelay = stride == 0 ? 0 : delay;
-        animationTick = delay-1;
-        animationMode = autoClear ? ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR : ANIMATION_MODE_ANIMATE_IMAGE;
-    }
-    else
-    {
-        return MICROBIT_BUSY;
-    }
+    a.mode = autoClear ? ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR : ANIMATION_MODE_ANIMATE_IMAGE;
+    a.image = image;
+    a.delay = delay;
+    a.stride = stride;
+    a.x = startingPosition;
 
-    return MICROBIT_OK;
+    return queueAnimation(a, ticket);
 }
 
 /**
@@ -975,31 +1416,19 @@ int MicroBitDisplay::animateAsync(MicroBitImage image, int delay, int stride, in
   */
 int MicroBitDisplay::animate(MicroBitImage image, int delay, int stride, int startingPosition, int autoClear)
 {
+    DisplayAnimation a;
+
     //sanitise the delay value
     if(delay <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    // If there's an ongoing animation, wait for our turn to display.
-    this->waitForFreeDisplay();
+    a.mode = autoClear ? ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR : ANIMATION_MODE_ANIMATE_IMAGE;
+    a.image = image;
+    a.delay = delay;
+    a.stride = stride;
+    a.x = startingPosition;
 
-    // If the display is free, it's our turn to display.
-    // If someone called stopAnimation(), then we simply skip...
-    if (animationMode == ANIMATION_MODE_NONE)
-    {
-        // Start the effect.
-        this->animateAsync(image, delay, stride, startingPosition, autoClear);
-
-        // Wait for completion.
-        //TODO: Put this in when we merge tight-validation
-        //if (delay > 0)
-            fiberWait();
-    }
-    else
-    {
-        return MICROBIT_CANCELLED;
-    }
-
-    return MICROBIT_OK;
+    return runAnimation(a);
 }
 
 
@@ -1037,12 +1466,8 @@ int MicroBitDisplay::setBrightness(int b)
   */
 void MicroBitDisplay::setDisplayMode(DisplayMode mode)
 {
-    if(mode == DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE)
-    {
-        //to reduce the artifacts on the display - increase the tick
-        if(system_timer_get_period() != MICROBIT_LIGHT_SENSOR_TICK_PERIOD)
-            system_timer_set_period(MICROBIT_LIGHT_SENSOR_TICK_PERIOD);
-    }
+    if(mode == DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE && this->mode != DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE)
+        lightSenseFrames = 0;
 
     if(this->mode == DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE && mode != DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE)
     {
@@ -1051,7 +1476,14 @@ void MicroBitDisplay::setDisplayMode(DisplayMode mode)
         this->lightSensor = NULL;
     }
 
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+    if(mode != DISPLAY_MODE_GREYSCALE)
+        stopGreyscaleTimer();
+#endif
+
     this->mode = mode;
+
+    updateTickRequirement();
 }
 
 /**
@@ -1089,7 +1521,13 @@ int MicroBitDisplay::getBrightness()
   */
 void MicroBitDisplay::rotateTo(DisplayRotation rotation)
 {
+    // Update the table atomically, so that a strobe never sees a mixture of rotations.
+    __disable_irq();
+
     this->rotation = rotation;
+    updateStrobeTable();
+
+    __enable_irq();
 }
 
 /**
@@ -1119,10 +1557,18 @@ void MicroBitDisplay::setEnable(bool enableDisplay)
     }
     else
     {
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+        stopGreyscaleTimer();
+#endif
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+        stopBrightnessTimer();
+#endif
         PortIn p(Port0, rmask | cmask);
         p.mode(PullNone);
         status &= ~MICROBIT_COMPONENT_RUNNING;
     }
+
+    updateTickRequirement();
 }
 
 /**
@@ -1166,6 +1612,121 @@ void MicroBitDisplay::disable()
 void MicroBitDisplay::clear()
 {
     image.clear();
+    swapAsync();
+}
+
+/**
+  * Enables or disables double buffering of the display.
+  *
+  * When enabled, the display strobes a private copy of the image. Drawing into `image` then has no visible
+  * effect until swap() or swapAsync() is called, after which the whole image is shown from the start of the next
+  * frame. This avoids tearing when redrawing the display while it is being refreshed. Animations and the other
+  * display methods request swaps automatically.
+  *
+  * @param enable true to enable double buffering, false to strobe `image` directly.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the front buffer could not be allocated.
+  *
+  * @code
+  * display.setDoubleBuffering(true);
+  * @endcode
+  */
+int MicroBitDisplay::setDoubleBuffering(bool enable)
+{
+    uint8_t *buffer = NULL;
+    uint16_t size = 0;
+
+    if (enable == (frontBuffer != NULL))
+        return MICROBIT_OK;
+
+    if (enable)
+    {
+        size = image.getSize();
+        buffer = (uint8_t *) malloc(size);
+
+        if (buffer == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        memcpy(buffer, image.getBitmap(), size);
+    }
+
+    // Exchange the buffers between frames, as seen from the strobe.
+    __disable_irq();
+    uint8_t *old = frontBuffer;
+    frontBuffer = buffer;
+    frontBufferSize = size;
+    swapPending = 0;
+    __enable_irq();
+
+    free(old);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines if the display is double buffered.
+  *
+  * @return true if double buffering is enabled, false otherwise.
+  */
+bool MicroBitDisplay::isDoubleBuffered()
+{
+    return frontBuffer != NULL;
+}
+
+/**
+  * Requests that the contents of `image` are shown from the start of the next frame.
+  * Returns immediately. Any further changes made to `image` before the swap takes place may be shown.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NOT_SUPPORTED if double buffering is not enabled.
+  */
+int MicroBitDisplay::swapAsync()
+{
+    if (frontBuffer == NULL)
+        return MICROBIT_NOT_SUPPORTED;
+
+    swapPending = 1;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Requests that the contents of `image` are shown from the start of the next frame, and blocks the calling fiber
+  * until the swap has taken place, so that drawing of the next frame can safely begin.
+  * If the scheduler is not running, this call will essentially perform a spinning wait.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NOT_SUPPORTED if double buffering is not enabled.
+  *
+  * @code
+  * display.setDoubleBuffering(true);
+  *
+  * while(1)
+  * {
+  *     display.image.clear();
+  *     display.image.setPixelValue(x, y, 255);
+  *     display.swap();
+  * }
+  * @endcode
+  */
+int MicroBitDisplay::swap()
+{
+    if (frontBuffer == NULL)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Register our interest before requesting the swap, so that the event cannot be missed.
+    if (fiber_wake_on_event(id, MICROBIT_DISPLAY_EVT_FRAME_SWAPPED) == MICROBIT_NOT_SUPPORTED)
+    {
+        swapPending = 1;
+
+        while(swapPending && frontBuffer != NULL)
+            __WFE();
+
+        return MICROBIT_OK;
+    }
+
+    swapPending = 1;
+    schedule();
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -1207,8 +1768,8 @@ MicroBitImage MicroBitDisplay::screenShot()
   * Internally, it constructs an instance of a MicroBitLightSensor if not already configured
   * and sets the display mode to DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
   *
-  * This also changes the tickPeriod to MICROBIT_LIGHT_SENSOR_TICK_SPEED so
-  * that the display does not suffer from artifacts.
+  * The light sensor takes a sample once every MICROBIT_LIGHT_SENSOR_SAMPLE_FRAMES frames, in a strobe slot
+  * of its own, so the system tick period is unaffected.
   *
   * @return an indicative light level in the range 0 - 255.
   *
@@ -1217,14 +1778,91 @@ MicroBitImage MicroBitDisplay::screenShot()
   * first time.
   */
 int MicroBitDisplay::readLightLevel()
+{
+    startLightSense();
+
+    return this->lightSensor->read();
+}
+
+/**
+  * Requests a fresh light level reading, without waiting for one to be taken.
+  *
+  * The display is put into DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE if it isn't already, and the most
+  * recent reading is returned immediately. An event with value MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY
+  * is raised from MICROBIT_ID_DISPLAY once the light sensor next completes a reading, which can then be
+  * collected with another call to this method, or with readLightLevel().
+  *
+  * @param timestamp If not NULL, set to the time the returned reading was taken, in milliseconds
+  *        (as given by system_timer_current_time()), or 0 if no reading has been taken yet.
+  *
+  * @return an indicative light level in the range 0 - 255, or MICROBIT_NO_DATA if the light sensor
+  *         has not yet completed its first reading.
+  *
+  * @code
+  * display.requestLightLevel();
+  * fiber_wait_for_event(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY);
+  * int level = display.requestLightLevel();
+  * @endcode
+  */
+int MicroBitDisplay::requestLightLevel(uint64_t *timestamp)
+{
+    startLightSense();
+
+    uint64_t t = this->lightSensor->requestSample();
+
+    if (timestamp)
+        *timestamp = t;
+
+    if (t == 0)
+        return MICROBIT_NO_DATA;
+
+    return this->lightSensor->read();
+}
+
+/**
+  * Puts the display into DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE and creates the light sensor,
+  * if this has not been done already.
+  */
+void MicroBitDisplay::startLightSense()
 {
     if(mode != DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE)
     {
         setDisplayMode(DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE);
         this->lightSensor = new MicroBitLightSensor(matrixMap);
+        this->lightSensor->setFilter(lightFilterType, lightFilterLength);
     }
+}
 
-    return this->lightSensor->read();
+/**
+  * Smooths the light level readings, so that each call to readLightLevel() returns a filtered value.
+  * The filter is updated incrementally as each set of light sensor samples is taken, rather than when read.
+  *
+  * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+  *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  *
+  * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+  *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+  *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @code
+  * display.setLightLevelFilter(MICROBIT_FILTER_MOVING_AVERAGE, 8);
+  * @endcode
+  */
+int MicroBitDisplay::setLightLevelFilter(int type, int length)
+{
+    // Validate the request up front, even if the light sensor isn't running yet.
+    if (!MicroBitSampleFilter::isValid(type, length))
+        return MICROBIT_INVALID_PARAMETER;
+
+    lightFilterType = type;
+    lightFilterLength = length;
+
+    if (this->lightSensor)
+        return this->lightSensor->setFilter(type, length);
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -1233,4 +1871,18 @@ int MicroBitDisplay::readLightLevel()
 MicroBitDisplay::~MicroBitDisplay()
 {
     system_timer_remove_component(this);
+    system_timer_cancel_event(&renderTimer);
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_BRIGHTNESS)
+    stopBrightnessTimer();
+#endif
+
+#if CONFIG_ENABLED(MICROBIT_DISPLAY_HARDWARE_GREYSCALE)
+    stopGreyscaleTimer();
+    NVIC_DisableIRQ(MICROBIT_DISPLAY_GREYSCALE_TIMER_IRQn);
+    greyscaleDisplay = NULL;
+#endif
+
+    free(strobeTable);
+    free(frontBuffer);
 }
@@ -27,9 +27,14 @@ DEALINGS IN THE SOFTWARE.
   *
   * @param fileName the name of the file to create/open.
   *
-  * @param mode One of: READ, WRITE, READ_AND_WRITE. Defaults to READ_AND_WRITE.
+  * @param mode One of: READ, WRITE, READ_AND_WRITE, optionally combined with CREATE and LOG_APPEND.
+  *             Defaults to READ_AND_WRITE | CREATE. LOG_APPEND opens the file as an append-only log:
+  *             every write is added to the end of the file, and its length is only recorded on close().
+  *
+  * @param cacheSize the size of the writeback cache for this file, in bytes, up to MBFS_BLOCK_SIZE.
+  *                  Defaults to MBFS_CACHE_SIZE.
   */
-MicroBitFile::MicroBitFile(ManagedString fileName, int mode)
+MicroBitFile::MicroBitFile(ManagedString fileName, int mode, int cacheSize)
 {
     this->fileName = fileName;
 
@@ -40,7 +45,7 @@ MicroBitFile::MicroBitFile(ManagedString fileName, int mode)
     else
         fs = MicroBitFileSystem::defaultFileSystem;
 
-    fileHandle = fs->open(fileName.toCharArray(), mode);
+    fileHandle = fs->open(fileName.toCharArray(), mode, cacheSize);
 }
 
 /**
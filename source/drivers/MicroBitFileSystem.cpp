@@ -24,6 +24,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitFlash.h"
 #include "MicroBitStorage.h"        
 #include "MicroBitCompat.h"
+#include "MicroBitDevice.h"
 #include "ErrorNo.h"
 
 static uint32_t *defaultScratchPage = (uint32_t *)DEFAULT_SCRATCH_PAGE;
@@ -32,43 +33,226 @@ MicroBitFileSystem* MicroBitFileSystem::defaultFileSystem = NULL;
 
 /**
   * Allocate a free logical block.
-  * This is chosen at random from the blocks available, to even out the wear on the physical device.
+  * This is chosen using a round robin algorithm, to even out the wear on the physical device.
   * @return a valid, unused block address on success, or zero if no space is available.
   */
 uint16_t MicroBitFileSystem::getFreeBlock()
 {
-    // Walk the File Table and allocate the first free block - starting immediately after the last block allocated,
-    // and wrapping around the filesystem space if we reach the end.
-    uint16_t block;
-    uint16_t deletedBlock = 0;
+    uint16_t block = findUnusedBlock();
 
-    for (block = (lastBlockAllocated + 1) % fileSystemSize; block != lastBlockAllocated; block++)
+    // If no UNUSED blocks are available, see if there are any marked as DELETED that we can recycle.
+    if (block == 0)
     {
-        if (fileSystemTable[block] == MBFS_UNUSED)
+        for (uint16_t b = 0; b < fileSystemSize; b++)
         {
-            lastBlockAllocated = block;
+            if (fileSystemTable[b] == MBFS_DELETED)
+            {
+                // recycle the FileTable, such that we can mark all previously deleted blocks as re-usable.
+                // Better to do this in bulk, rather than on a block by block basis to improve efficiency.
+                recycleFileTable();
+                block = findUnusedBlock();
+                break;
+            }
+        }
+    }
+
+    // Record the block we just allocated, so we can round-robin around blocks for load balancing.
+    // If no blocks are available - either UNUSED or marked as DELETED, then we're out of space and there's nothing we can do.
+    if (block)
+        lastBlockAllocated = block;
+
+    return block;
+}
+
+/**
+  * Find the next block marked as UNUSED in the file table, starting immediately after the last block allocated
+  * and wrapping around the file system space if necessary.
+  *
+  * @return The block number, or zero if no UNUSED blocks are available.
+  */
+uint16_t MicroBitFileSystem::findUnusedBlock()
+{
+    uint16_t block = lastBlockAllocated;
+
+    // Without a bitmap, walk the File Table itself.
+    if (freeBlockMap == NULL)
+    {
+        for (int i = 0; i < fileSystemSize; i++)
+        {
+            block = (block + 1) % fileSystemSize;
+
+            if (fileSystemTable[block] == MBFS_UNUSED)
+                return block;
+        }
+
+        return 0;
+    }
+
+    // Otherwise, walk the bitmap a word at a time, skipping any words with no free blocks.
+    int words = (fileSystemSize + 31) / 32;
+
+    block = (block + 1) % fileSystemSize;
+
+    for (int i = 0; i <= words; i++)
+    {
+        uint32_t bits = freeBlockMap[block / 32] >> (block % 32);
+
+        if (bits)
+        {
+            while ((bits & 1) == 0)
+            {
+                bits >>= 1;
+                block++;
+            }
+
             return block;
         }
 
-        if (fileSystemTable[block] == MBFS_DELETED)
-            deletedBlock = block;
+        // Move on to the start of the next word, wrapping around at the end of the file system.
+        block = (block / 32 + 1) * 32;
+        if (block >= fileSystemSize)
+            block = 0;
     }
 
-    // if no UNUSED blocks are available, try to recycle one marked as DELETED.
-    block = deletedBlock;
+    return 0;
+}
 
-    // If no blocks are available - either UNUSED or marked as DELETED, then we're out of space and there's nothing we can do.
-    if (block)
+/**
+  * Rebuild the bitmap of UNUSED blocks from the file table.
+  */
+void MicroBitFileSystem::buildFreeBlockMap()
+{
+    int words = (fileSystemSize + 31) / 32;
+
+    if (freeBlockMap == NULL)
+        freeBlockMap = (uint32_t *) malloc(words * sizeof(uint32_t));
+
+    // If we're short of memory, getFreeBlock() simply walks the File Table instead.
+    if (freeBlockMap == NULL)
+        return;
+
+    memclr(freeBlockMap, words * sizeof(uint32_t));
+
+    for (uint16_t block = 0; block < fileSystemSize; block++)
+        if (fileSystemTable[block] == MBFS_UNUSED)
+            freeBlockMap[block / 32] |= 1UL << (block % 32);
+}
+
+/**
+  * Restore the free block map and directory index from the mount checkpoint, if it is valid.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if there is no valid checkpoint,
+  *         or MICROBIT_NO_RESOURCES if there is not enough memory to restore it.
+  */
+int MicroBitFileSystem::loadCheckpoint()
+{
+#if CONFIG_ENABLED(MBFS_CHECKPOINT)
+    FileSystemCheckpoint *cp = (FileSystemCheckpoint *)checkpoint;
+    int words = (fileSystemSize + 31) / 32;
+
+    // Only trust a complete checkpoint, taken of this file system, since it was last changed.
+    if (cp == NULL || cp->magic != MBFS_CHECKPOINT_MAGIC || cp->valid != MBFS_CHECKPOINT_VALID)
+        return MICROBIT_NO_DATA;
+
+    if (cp->fileSystemTable != (uintptr_t)fileSystemTable || cp->fileSystemSize != fileSystemSize)
+        return MICROBIT_NO_DATA;
+
+    if (cp->indexSize != 0 && cp->indexSize != MBFS_INDEX_SIZE)
+        return MICROBIT_NO_DATA;
+
+    freeBlockMap = (uint32_t *) malloc(words * sizeof(uint32_t));
+
+    if (freeBlockMap == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    memcpy(freeBlockMap, cp->data, words * sizeof(uint32_t));
+
+#if MBFS_INDEX_SIZE > 0
+    // If the index wasn't saved, it is simply built on first use as normal.
+    if (cp->indexSize)
     {
-        // recycle the FileTable, such that we can mark all previously deleted blocks as re-usable.
-        // Better to do this in bulk, rather than on a block by block basis to improve efficiency. 
-        recycleFileTable();
+        directoryIndex = (DirectoryIndexEntry *) malloc(MBFS_INDEX_SIZE * sizeof(DirectoryIndexEntry));
 
-        // Record the block we just allocated, so we can round-robin around blocks for load balancing.
-        lastBlockAllocated = block;
+        if (directoryIndex)
+        {
+            memcpy(directoryIndex, cp->data + words, MBFS_INDEX_SIZE * sizeof(DirectoryIndexEntry));
+            directoryIndexLength = cp->indexLength;
+            status |= MBFS_STATUS_INDEXED | (cp->indexStatus & MBFS_STATUS_INDEX_INCOMPLETE);
+        }
     }
+#endif
 
-    return block;
+    status |= MBFS_STATUS_CHECKPOINTED;
+
+    return MICROBIT_OK;
+#else
+    return MICROBIT_NO_DATA;
+#endif
+}
+
+/**
+  * Write the free block map and directory index to the mount checkpoint.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if there is no room for a checkpoint,
+  *         or MICROBIT_NO_RESOURCES if the summary does not fit in a single page.
+  */
+int MicroBitFileSystem::writeCheckpoint()
+{
+#if CONFIG_ENABLED(MBFS_CHECKPOINT)
+    FileSystemCheckpoint *cp = (FileSystemCheckpoint *)checkpoint;
+    FileSystemCheckpoint header;
+    uint32_t value = MBFS_CHECKPOINT_VALID;
+    int words = (fileSystemSize + 31) / 32;
+
+    if (cp == NULL || freeBlockMap == NULL)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Make sure the directory index is present, so that the next mount has no need to scan the directories.
+    if (!(status & MBFS_STATUS_INDEXED))
+        buildDirectoryIndex();
+
+    header.magic = MBFS_CHECKPOINT_MAGIC;
+    header.valid = 0xFFFFFFFF;
+    header.fileSystemTable = (uintptr_t)fileSystemTable;
+    header.fileSystemSize = fileSystemSize;
+    header.indexSize = directoryIndex ? MBFS_INDEX_SIZE : 0;
+    header.indexLength = directoryIndexLength;
+    header.indexStatus = status & MBFS_STATUS_INDEX_INCOMPLETE;
+
+    if (sizeof(FileSystemCheckpoint) + words * sizeof(uint32_t) + header.indexSize * sizeof(DirectoryIndexEntry) > PAGE_SIZE)
+        return MICROBIT_NO_RESOURCES;
+
+    flash.erase_page(checkpoint);
+    flash.flash_write(cp, &header, sizeof(FileSystemCheckpoint));
+    flash.flash_write(cp->data, freeBlockMap, words * sizeof(uint32_t));
+
+    if (header.indexSize)
+        flash.flash_write(cp->data + words, directoryIndex, header.indexSize * sizeof(DirectoryIndexEntry));
+
+    // Only mark the checkpoint as valid once it is complete, in case we lose power part way through writing it.
+    flash.flash_write(&cp->valid, &value, sizeof(uint32_t));
+
+    status |= MBFS_STATUS_CHECKPOINTED;
+#endif
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Mark the mount checkpoint as out of date, before the file system is changed.
+  */
+void MicroBitFileSystem::invalidateCheckpoint()
+{
+#if CONFIG_ENABLED(MBFS_CHECKPOINT)
+    uint32_t value = 0;
+
+    // Clearing bits needs no erase, so this costs a single word write.
+    if (status & MBFS_STATUS_CHECKPOINTED)
+    {
+        flash.flash_write(&((FileSystemCheckpoint *)checkpoint)->valid, &value, sizeof(uint32_t));
+        status &= ~MBFS_STATUS_CHECKPOINTED;
+    }
+#endif
 }
 
 /**
@@ -176,8 +360,12 @@ int MicroBitFileSystem::init(uint32_t flashStart, int flashPages)
     // Zero initialise default parameters (mbed/ARMCC does not permit this is the class definition).
     fileSystemTable = NULL;
     lastBlockAllocated = 0;
+    freeBlockMap = NULL;
     rootDirectory = NULL;
     openFiles = NULL;
+    directoryIndex = NULL;
+    directoryIndexLength = 0;
+    checkpoint = NULL;
 
     // If we have a zero length, then dynamically determine our geometry.
     if (flashStart == 0)
@@ -203,13 +391,33 @@ int MicroBitFileSystem::init(uint32_t flashStart, int flashPages)
         // No file system was found, so format a fresh one.
         // Bring up a freshly formatted file system here.
         fileSystemSize = flashPages * (PAGE_SIZE / MBFS_BLOCK_SIZE);
+
+#if CONFIG_ENABLED(MBFS_CHECKPOINT)
+        // Keep the last page back, to hold the mount checkpoint.
+        if (flashPages > 1)
+            fileSystemSize -= PAGE_SIZE / MBFS_BLOCK_SIZE;
+#endif
+
         fileSystemTableSize = calculateFileTableSize();
 
         format();
     }
 
+#if CONFIG_ENABLED(MBFS_CHECKPOINT)
+    // The checkpoint lives in the page after the file system, if the file system leaves one free.
+    if (fileSystemSize / (PAGE_SIZE / MBFS_BLOCK_SIZE) < flashPages)
+        checkpoint = getBlock(fileSystemSize);
+#endif
+
+    // If the file system was left unchanged since its checkpoint, there's no need to scan the file table.
+    if (loadCheckpoint() != MICROBIT_OK)
+        buildFreeBlockMap();
+
+    // Start allocating from a random point, so that we don't always favour the same blocks after every restart.
+    lastBlockAllocated = microbit_random(fileSystemSize);
+
     // indicate that we have a valid FileSystem
-    status = MBFS_STATUS_INITIALISED;
+    status |= MBFS_STATUS_INITIALISED;
     return MICROBIT_OK;
 }
 
@@ -300,6 +508,18 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
     if (directory == NULL)
         directory = rootDirectory;
 
+    // Try the index first. We only need to scan the directory if the index doesn't hold every entry.
+    if (!(status & MBFS_STATUS_INDEXED))
+        buildDirectoryIndex();
+
+    if (directoryIndex)
+    {
+        dirent = indexLookup(file, directory->first_block);
+
+        if (dirent || !(status & MBFS_STATUS_INDEX_INCOMPLETE))
+            return dirent;
+    }
+
     block = directory->first_block;
     dir = (Directory *) getBlock(block);
     dirent = &dir->entry[0];
@@ -307,7 +527,7 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
     // Iterate through the directory entries until we find our file, or run out of space.
     while (1)
     {
-        if ((uint32_t)(dirent + 1) > (uint32_t)dir + MBFS_BLOCK_SIZE)
+        if ((uintptr_t)(dirent + 1) > (uintptr_t)dir + MBFS_BLOCK_SIZE)
         {
             block = getNextFileBlock(block);
             if (block == MBFS_EOF)
@@ -328,6 +548,188 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryEntry(char const * filename, con
     return NULL;
 }
 
+/**
+  * Calculate the index hash of a filename within a directory.
+  *
+  * @param name The filename, without any path.
+  * @param directory The first block of the directory holding the file.
+  *
+  * @return The hash value.
+  */
+uint16_t MicroBitFileSystem::getIndexHash(char const *name, uint16_t directory)
+{
+    // FNV-1a, folded to 16 bits.
+    uint32_t hash = 2166136261UL ^ directory;
+
+    while (*name)
+    {
+        hash ^= (uint8_t) *name++;
+        hash *= 16777619UL;
+    }
+
+    return (uint16_t) (hash ^ (hash >> 16));
+}
+
+/**
+  * Build the directory index, by scanning every directory in the file system.
+  */
+void MicroBitFileSystem::buildDirectoryIndex()
+{
+    status |= MBFS_STATUS_INDEXED;
+
+#if MBFS_INDEX_SIZE > 0
+    directoryIndex = (DirectoryIndexEntry *) malloc(MBFS_INDEX_SIZE * sizeof(DirectoryIndexEntry));
+
+    // Without an index, every lookup simply scans the directory.
+    if (directoryIndex == NULL)
+        return;
+
+    memclr(directoryIndex, MBFS_INDEX_SIZE * sizeof(DirectoryIndexEntry));
+    directoryIndexLength = 0;
+
+    indexDirectory(rootDirectory);
+#endif
+}
+
+/**
+  * Add every entry of the given directory, and of the directories within it, to the directory index.
+  *
+  * @param directory The directory to scan.
+  */
+void MicroBitFileSystem::indexDirectory(DirectoryEntry *directory)
+{
+    uint16_t block = directory->first_block;
+
+    while (block != MBFS_EOF)
+    {
+        DirectoryEntry *dirent = (DirectoryEntry *)getBlock(block);
+
+        for (uint16_t i = 0; i < MBFS_BLOCK_SIZE / sizeof(DirectoryEntry); i++, dirent++)
+        {
+            // Skip deleted entries, and those that have never been written.
+            if ((dirent->flags & MBFS_DIRECTORY_ENTRY_VALID) == 0 || dirent->file_name[0] == (char)0xFF)
+                continue;
+
+            indexInsert(dirent, directory->first_block);
+
+            if (dirent->flags != MBFS_DIRECTORY_ENTRY_NEW && (dirent->flags & MBFS_DIRECTORY_ENTRY_DIRECTORY))
+                indexDirectory(dirent);
+        }
+
+        block = getNextFileBlock(block);
+    }
+}
+
+/**
+  * Add a DirectoryEntry to the directory index.
+  * If the index is too full, the entry is not added, and the index is marked as incomplete.
+  *
+  * @param entry The entry to add.
+  * @param directory The first block of the directory holding the entry.
+  */
+void MicroBitFileSystem::indexInsert(DirectoryEntry *entry, uint16_t directory)
+{
+#if MBFS_INDEX_SIZE > 0
+    if (directoryIndex == NULL)
+        return;
+
+    // Keep a quarter of the slots free, so that probe sequences stay short.
+    if (directoryIndexLength >= MBFS_INDEX_SIZE - MBFS_INDEX_SIZE / 4)
+    {
+        status |= MBFS_STATUS_INDEX_INCOMPLETE;
+        return;
+    }
+
+    uint16_t hash = getIndexHash(entry->file_name, directory);
+    int slot = hash & (MBFS_INDEX_SIZE - 1);
+
+    while (directoryIndex[slot].entry != NULL)
+        slot = (slot + 1) & (MBFS_INDEX_SIZE - 1);
+
+    directoryIndex[slot].entry = entry;
+    directoryIndex[slot].directory = directory;
+    directoryIndex[slot].hash = hash;
+    directoryIndexLength++;
+#endif
+}
+
+/**
+  * Remove a DirectoryEntry from the directory index, if present.
+  *
+  * @param entry The entry to remove.
+  * @param directory The first block of the directory holding the entry.
+  */
+void MicroBitFileSystem::indexRemove(DirectoryEntry *entry, uint16_t directory)
+{
+#if MBFS_INDEX_SIZE > 0
+    if (directoryIndex == NULL)
+        return;
+
+    int slot = getIndexHash(entry->file_name, directory) & (MBFS_INDEX_SIZE - 1);
+
+    while (directoryIndex[slot].entry != entry)
+    {
+        if (directoryIndex[slot].entry == NULL)
+            return;
+
+        slot = (slot + 1) & (MBFS_INDEX_SIZE - 1);
+    }
+
+    // Close the gap, by moving back any later entries in the probe sequence that could occupy it.
+    int next = slot;
+    while (1)
+    {
+        next = (next + 1) & (MBFS_INDEX_SIZE - 1);
+
+        if (directoryIndex[next].entry == NULL)
+            break;
+
+        int home = directoryIndex[next].hash & (MBFS_INDEX_SIZE - 1);
+
+        // Only move the entry if its home slot is not cyclically within (slot, next].
+        if (((next - home) & (MBFS_INDEX_SIZE - 1)) >= ((next - slot) & (MBFS_INDEX_SIZE - 1)))
+        {
+            directoryIndex[slot] = directoryIndex[next];
+            slot = next;
+        }
+    }
+
+    directoryIndex[slot].entry = NULL;
+    directoryIndexLength--;
+#endif
+}
+
+/**
+  * Look up a filename in the directory index.
+  *
+  * @param name The filename, without any path.
+  * @param directory The first block of the directory to search.
+  *
+  * @return The DirectoryEntry for the given file, or NULL if it is not in the index.
+  */
+DirectoryEntry* MicroBitFileSystem::indexLookup(char const *name, uint16_t directory)
+{
+#if MBFS_INDEX_SIZE > 0
+    if (directoryIndex == NULL)
+        return NULL;
+
+    uint16_t hash = getIndexHash(name, directory);
+    int slot = hash & (MBFS_INDEX_SIZE - 1);
+
+    while (directoryIndex[slot].entry != NULL)
+    {
+        DirectoryIndexEntry *e = &directoryIndex[slot];
+
+        if (e->hash == hash && e->directory == directory && strcmp(e->entry->file_name, name) == 0)
+            return e->entry;
+
+        slot = (slot + 1) & (MBFS_INDEX_SIZE - 1);
+    }
+#endif
+
+    return NULL;
+}
+
 /**
   * Determine the number of logical blocks required to hold the file table.
   *
@@ -351,7 +753,7 @@ uint16_t MicroBitFileSystem::calculateFileTableSize()
   */
 uint32_t *MicroBitFileSystem::getPage(uint16_t block)
 {
-    uint32_t address = (uint32_t) getBlock(block);
+    uint32_t address = (uintptr_t) getBlock(block);
     return (uint32_t *) (address - address % PAGE_SIZE);
 }
 
@@ -364,7 +766,7 @@ uint32_t *MicroBitFileSystem::getPage(uint16_t block)
   */
 uint32_t *MicroBitFileSystem::getBlock(uint16_t block)
 {
-    return (uint32_t *)((uint32_t)fileSystemTable + block * MBFS_BLOCK_SIZE);
+    return (uint32_t *)((uintptr_t)fileSystemTable + block * MBFS_BLOCK_SIZE);
 }
 
 /**
@@ -379,6 +781,111 @@ uint16_t MicroBitFileSystem::getNextFileBlock(uint16_t block)
     return fileSystemTable[block];
 }
 
+/**
+  * Retrieve the logical block holding the given block of an open file.
+  *
+  * The walk along the file table starts from the nearest remembered block at or before the one requested,
+  * and the result is remembered for next time.
+  *
+  * @param file The open file.
+  * @param index The index of the block within the file, counting from zero.
+  *
+  * @return The logical block number.
+  */
+uint16_t MicroBitFileSystem::getFileBlock(FileDescriptor *file, uint16_t index)
+{
+    uint16_t block = file->dirent->first_block;
+    uint16_t position = 0;
+
+    for (int i = 0; i < file->blockCacheLength; i++)
+    {
+        FileBlockCacheEntry *e = &file->blockCache[i];
+
+        if (e->index <= index && e->index >= position)
+        {
+            position = e->index;
+            block = e->block;
+        }
+    }
+
+    while (position < index)
+    {
+        block = getNextFileBlock(block);
+        position++;
+    }
+
+    cacheFileBlock(file, index, block);
+
+    return block;
+}
+
+/**
+  * Determine the length of a log file, including any data written since its directory entry was last updated.
+  * Data is assumed to end at the last byte in the file's blocks that is not in the erased (0xFF) state.
+  *
+  * @param dirent The directory entry of the file.
+  *
+  * @return The length of the file, in bytes.
+  */
+uint32_t MicroBitFileSystem::getLogLength(DirectoryEntry *dirent)
+{
+    uint32_t length = dirent->flags == MBFS_DIRECTORY_ENTRY_NEW ? 0 : dirent->length;
+    uint32_t offset = 0;
+    uint16_t block = dirent->first_block;
+
+    // Only the blocks at or beyond the recorded length can hold unrecorded data.
+    while (block != MBFS_EOF)
+    {
+        if (offset + MBFS_BLOCK_SIZE > length)
+        {
+            uint8_t *data = (uint8_t *)getBlock(block);
+            int end = MBFS_BLOCK_SIZE;
+
+            while (end > 0 && data[end-1] == 0xFF)
+                end--;
+
+            if (offset + end > length)
+                length = offset + end;
+        }
+
+        offset += MBFS_BLOCK_SIZE;
+        block = getNextFileBlock(block);
+    }
+
+    return length;
+}
+
+/**
+  * Remember the logical block holding the given block of an open file, evicting the least recently used entry if necessary.
+  *
+  * @param file The open file.
+  * @param index The index of the block within the file, counting from zero.
+  * @param block The logical block number.
+  */
+void MicroBitFileSystem::cacheFileBlock(FileDescriptor *file, uint16_t index, uint16_t block)
+{
+#if MBFS_BLOCK_CACHE_SIZE > 0
+    int slot = 0;
+
+    // Reuse the entry for this block if we have one. Otherwise take a free entry, or the least recently used.
+    while (slot < file->blockCacheLength && file->blockCache[slot].index != index)
+        slot++;
+
+    if (slot == file->blockCacheLength)
+    {
+        if (file->blockCacheLength < MBFS_BLOCK_CACHE_SIZE)
+            file->blockCacheLength++;
+        else
+            slot--;
+    }
+
+    memmove(&file->blockCache[1], &file->blockCache[0], slot * sizeof(FileBlockCacheEntry));
+
+    file->blockCache[0].index = index;
+    file->blockCache[0].block = block;
+#endif
+}
+
 /**
   * Determine the logical block that contains the given address.
   *
@@ -388,7 +895,7 @@ uint16_t MicroBitFileSystem::getNextFileBlock(uint16_t block)
   */
 uint16_t MicroBitFileSystem::getBlockNumber(void *address)
 {
-    return (((uint32_t) address - (uint32_t) fileSystemTable) / MBFS_BLOCK_SIZE);
+    return (((uintptr_t) address - (uintptr_t) fileSystemTable) / MBFS_BLOCK_SIZE);
 }
 
 /**
@@ -401,6 +908,11 @@ uint16_t MicroBitFileSystem::getBlockNumber(void *address)
 int MicroBitFileSystem::fileTableWrite(uint16_t block, uint16_t value)
 {
     flash.flash_write(&fileSystemTable[block], &value, 2);
+
+    // Any write to the file table takes the block out of the UNUSED state, until the table is next recycled.
+    if (freeBlockMap)
+        freeBlockMap[block / 32] &= ~(1UL << (block % 32));
+
     return MICROBIT_OK;
 }
 
@@ -465,9 +977,22 @@ DirectoryEntry* MicroBitFileSystem::getDirectoryOf(char const * filename)
 int MicroBitFileSystem::recycleBlock(uint16_t block, int type)
 {
     uint32_t *page = getPage(block);
+    uint16_t b = getBlockNumber(page);
+    bool live = false;
+
+    for (int i = 0; i < PAGE_SIZE / MBFS_BLOCK_SIZE; i++)
+        if (fileSystemTable[b + i] != MBFS_DELETED && fileSystemTable[b + i] != MBFS_UNUSED)
+            live = true;
+
+    // If nothing on the page needs to be kept, simply erase it - there's no need to copy it through a scratch page.
+    if (!live)
+    {
+        flash.erase_page(page);
+        return MICROBIT_OK;
+    }
+
     uint32_t* scratch = getFreePage();
     uint8_t *write = (uint8_t *)scratch;
-    uint16_t b = getBlockNumber(page);
 
     for (int i = 0; i < PAGE_SIZE / MBFS_BLOCK_SIZE; i++)
     {
@@ -552,6 +1077,9 @@ int MicroBitFileSystem::recycleFileTable()
     for (uint16_t block = 0; getPage(block) < (uint32_t *)rootDirectory; block += PAGE_SIZE / MBFS_BLOCK_SIZE)
         recycleBlock(block);
 
+    // Every block that was DELETED is now available for allocation.
+    buildFreeBlockMap();
+
     return MICROBIT_OK;
 }
 
@@ -579,7 +1107,7 @@ DirectoryEntry* MicroBitFileSystem::createDirectoryEntry(DirectoryEntry *directo
     while (1)
     {
         // Scan through each of the blocks in the directory
-        if ((uint32_t)(dirent+1) > (uint32_t)dir + MBFS_BLOCK_SIZE)
+        if ((uintptr_t)(dirent+1) > (uintptr_t)dir + MBFS_BLOCK_SIZE)
         {
             block = getNextFileBlock(block);
             if (block == MBFS_EOF)
@@ -697,6 +1225,9 @@ DirectoryEntry* MicroBitFileSystem::createFile(char const * filename, DirectoryE
     // Push the new data back to FLASH memory
     flash.flash_write(dirent, &d, sizeof(DirectoryEntry));
     fileTableWrite(d.first_block, MBFS_EOF);
+
+    indexInsert(dirent, directory->first_block);
+
     return dirent;
 }
 
@@ -742,6 +1273,11 @@ FileDescriptor* MicroBitFileSystem::getFileDescriptor(int fd, bool remove)
   */
 int MicroBitFileSystem::createDirectory(char const *name)
 {
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
     DirectoryEntry* directory;        // Directory holding this file.
     DirectoryEntry* dirent;            // Entry in the direcoty of this file.
 
@@ -766,6 +1302,8 @@ int MicroBitFileSystem::createDirectory(char const *name)
     if (dirent)
         return MICROBIT_INVALID_PARAMETER;
 
+    invalidateCheckpoint();
+
     dirent = createFile(name, directory, true);
     if (dirent == NULL)
         return MICROBIT_NO_RESOURCES;
@@ -780,12 +1318,21 @@ int MicroBitFileSystem::createDirectory(char const *name)
   *  - MB_READ : read from the file.
   *  - MB_WRITE : write to the file.
   *  - MB_CREAT : create a new file, if it doesn't already exist.
+  *  - MB_APPEND : start with the seek position at the end of the file.
+  *  - MB_LOG : treat the file as an append-only log. All writes are added to the end of the file,
+  *             and the directory entry is only updated on close(), rather than on every flush().
   *
   * If a file is opened that doesn't exist, and MB_CREAT isn't passed,
   * an error is returned, otherwise the file is created.
   *
+  * If a log file was not closed (e.g. due to a reset), its length is recovered when it is next opened
+  * with MB_LOG, by scanning for the last byte written. Any 0xFF bytes at the end of the log are lost in this case.
+  *
   * @param filename name of the file to open, must contain only printable characters.
-  * @param flags One or more of MB_READ, MB_WRITE or MB_CREAT. 
+  * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG. 
+  * @param cacheSize The size of the writeback cache for this file, in bytes, up to MBFS_BLOCK_SIZE. Zero disables
+  *        the cache. The cache is allocated on the first small write, and is written back whenever it fills or the
+  *        end of a block is reached, such that a cache of MBFS_BLOCK_SIZE bytes results in whole block writes.
   * @return return the file handle,MICROBIT_NOT_SUPPORTED if the file system has
   *         not been initialised MICROBIT_INVALID_PARAMETER if the filename is
   *         too large, MICROBIT_NO_RESOURCES if the file system is full.
@@ -797,7 +1344,25 @@ int MicroBitFileSystem::createDirectory(char const *name)
   *    print("file open error");
   * @endcode
   */
-int MicroBitFileSystem::open(char const * filename, uint32_t flags)
+int MicroBitFileSystem::open(char const * filename, uint32_t flags, int cacheSize)
+{
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
+    return openFile(filename, flags, cacheSize);
+}
+
+/**
+  * Opens a file, as open(), for callers that already hold the FLASH lock.
+  *
+  * @param filename name of the file to open.
+  * @param flags One or more of MB_READ, MB_WRITE, MB_CREAT, MB_APPEND or MB_LOG.
+  * @param cacheSize The size of the writeback cache for this file, in bytes.
+  * @return the file handle on success, or an error code as open().
+  */
+int MicroBitFileSystem::openFile(char const * filename, uint32_t flags, int cacheSize)
 {
     FileDescriptor *file;               // File Descriptor of this file.
     DirectoryEntry* directory;          // Directory holding this file.
@@ -808,10 +1373,14 @@ int MicroBitFileSystem::open(char const * filename, uint32_t flags)
     if ((status & MBFS_STATUS_INITIALISED) == 0)
         return MICROBIT_NOT_SUPPORTED;
 
-    // Reject invalid filenames.
-    if(!isValidFilename(filename))
+    // Reject invalid filenames and cache sizes.
+    if(!isValidFilename(filename) || cacheSize < 0 || cacheSize > MBFS_BLOCK_SIZE)
         return MICROBIT_INVALID_PARAMETER;
 
+    // Any file that may be written takes the file system out of its checkpointed state.
+    if (flags & (MB_WRITE | MB_CREAT | MB_LOG))
+        invalidateCheckpoint();
+
     // Determine the directory for this file.
     directory = getDirectoryOf(filename);
 
@@ -860,11 +1429,14 @@ int MicroBitFileSystem::open(char const * filename, uint32_t flags)
     // Populate the FileDescriptor
     file->flags = (flags & ~(MB_CREAT));
     file->id = id;
-    file->length = dirent->flags == MBFS_DIRECTORY_ENTRY_NEW ? 0 : dirent->length;
-    file->seek = (flags & MB_APPEND) ? file->length : 0;
+    file->length = (flags & MB_LOG) ? getLogLength(dirent) : dirent->flags == MBFS_DIRECTORY_ENTRY_NEW ? 0 : dirent->length;
+    file->seek = (flags & (MB_APPEND | MB_LOG)) ? file->length : 0;
     file->dirent = dirent;
     file->directory = directory;
+    file->cacheSize = cacheSize;
     file->cacheLength = 0;
+    file->cache = NULL;
+    file->blockCacheLength = 0;
 
     // Add the file descriptor to the chain of open files.
     file->next = openFiles;
@@ -875,10 +1447,49 @@ int MicroBitFileSystem::open(char const * filename, uint32_t flags)
 }
 
 
+/**
+  * Update the directory entry of an open file, if its length has changed.
+  *
+  * @param file The open file.
+  */
+void MicroBitFileSystem::syncDirectoryEntry(FileDescriptor *file)
+{
+    // If the file has changed size, create an updated directory entry for the file, reflecting it's new length.
+    if (file->dirent->length != file->length)
+    {
+        DirectoryEntry d = *file->dirent;
+        d.length = file->length;
+
+        // Do some optimising to reduce FLASH churn if this is the first write to a file. No need then to create a new dirent...
+        if (file->dirent->flags == MBFS_DIRECTORY_ENTRY_NEW)
+        {
+            d.flags = MBFS_DIRECTORY_ENTRY_VALID;
+            flash.flash_write(file->dirent, &d, sizeof(DirectoryEntry));
+        }
+
+        // Otherwise, replace the dirent with a freshly allocated one, and mark the other as INVALID.
+        else
+        {
+            DirectoryEntry *newDirent;
+            uint16_t value = MBFS_DELETED;
+
+            // invalidate the old directory entry and create a new one with the updated data.
+            indexRemove(file->dirent, file->directory->first_block);
+            flash.flash_write(&file->dirent->flags, &value, 2);
+            newDirent = createDirectoryEntry(file->directory);
+            flash.flash_write(newDirent, &d, sizeof(DirectoryEntry));
+            indexInsert(newDirent, file->directory->first_block);
+            file->dirent = newDirent;
+        }
+    }
+}
+
 /**
   * Writes back all state associated with the given file to FLASH memory, 
   * leaving the file open.
   *
+  * For files opened with MB_LOG, only the file data is written back. The directory entry is updated by close().
+  *
   * @param fd file descriptor - obtained with open().
   * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the file system has not
   *         been initialised, MICROBIT_INVALID_PARAMETER if the given file handle
@@ -895,6 +1506,11 @@ int MicroBitFileSystem::open(char const * filename, uint32_t flags)
   */
 int MicroBitFileSystem::flush(int fd)
 {
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
     // Protect against accidental re-initialisation
     if ((status & MBFS_STATUS_INITIALISED) == 0)
         return MICROBIT_NOT_SUPPORTED;
@@ -908,31 +1524,9 @@ int MicroBitFileSystem::flush(int fd)
     // Flush any data in the writeback cache.
     writeBack(file);
 
-    // If the file has changed size, create an updated directory entry for the file, reflecting it's new length.
-    if (file->dirent->length != file->length)
-    {
-        DirectoryEntry d = *file->dirent;
-        d.length = file->length;
-
-        // Do some optimising to reduce FLASH churn if this is the first write to a file. No need then to create a new dirent...
-        if (file->dirent->flags == MBFS_DIRECTORY_ENTRY_NEW)
-        {
-            d.flags = MBFS_DIRECTORY_ENTRY_VALID;
-            flash.flash_write(file->dirent, &d, sizeof(DirectoryEntry));
-        }
-
-        // Otherwise, replace the dirent with a freshly allocated one, and mark the other as INVALID.
-        else
-        {
-            DirectoryEntry *newDirent;
-            uint16_t value = MBFS_DELETED;
-
-            // invalidate the old directory entry and create a new one with the updated data.
-            flash.flash_write(&file->dirent->flags, &value, 2);
-            newDirent = createDirectoryEntry(file->directory);
-            flash.flash_write(newDirent, &d, sizeof(DirectoryEntry));
-        }
-    }
+    // Log files only update their directory entry when closed.
+    if (!(file->flags & MB_LOG))
+        syncDirectoryEntry(file);
 
     return MICROBIT_OK;
 }
@@ -961,16 +1555,35 @@ int MicroBitFileSystem::flush(int fd)
   */
 int MicroBitFileSystem::close(int fd)
 {
-    // Firstly, ensure all unwritten data is flushed.
-    int r = flush(fd);
+    MicroBitFlashLock lock;
 
-    // If the flush called failed on validation, pass the error code onto the caller.
-    if (r != MICROBIT_OK)
-        return r;
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
+    // Protect against accidental re-initialisation
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    FileDescriptor *file = getFileDescriptor(fd);
+
+    // Ensure the file is open.
+    if(file == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Firstly, ensure all unwritten data is flushed, and the directory entry is up to date.
+    // Log files defer updating their metadata until now.
+    writeBack(file);
+    syncDirectoryEntry(file);
 
     // Remove the file descriptor from the list of open files, and free it.
-    // n.b. we know this is safe, as flush() validates this.
-    delete getFileDescriptor(fd, true);
+    getFileDescriptor(fd, true);
+
+    free(file->cache);
+    delete file;
+
+    // Once nothing is left open, record the state of the file system so that it can be mounted quickly.
+    if (openFiles == NULL && !(status & MBFS_STATUS_CHECKPOINTED))
+        writeCheckpoint();
 
     return MICROBIT_OK;
 }
@@ -1000,6 +1613,11 @@ int MicroBitFileSystem::close(int fd)
   */
 int MicroBitFileSystem::seek(int fd, int offset, uint8_t flags)
 {
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
     FileDescriptor *file;
     int position;
 
@@ -1059,13 +1677,18 @@ int MicroBitFileSystem::seek(int fd, int offset, uint8_t flags)
   */
 int MicroBitFileSystem::read(int fd, uint8_t* buffer, int size)
 {
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
     FileDescriptor *file;
     uint16_t block;
     uint8_t *readPointer;
     uint8_t *writePointer;
 
     uint32_t offset;
-    uint32_t position = 0;
+    uint16_t index;
     int bytesCopied = 0;
     int segmentLength;
 
@@ -1085,18 +1708,12 @@ int MicroBitFileSystem::read(int fd, uint8_t* buffer, int size)
     // Validate the read length.
     size = min(size, file->length - file->seek);
 
-    // Find the read position.
-    block = file->dirent->first_block; 
-
-    // Walk the file table until we reach the start block
-    while (file->seek - position > MBFS_BLOCK_SIZE)
-    {
-        block = getNextFileBlock(block);
-        position += MBFS_BLOCK_SIZE;
-    }
+    // Find the read position. A seek to the end of a block is treated as the end of that block, rather than the start of the next.
+    index = file->seek ? (file->seek - 1) / MBFS_BLOCK_SIZE : 0;
+    block = getFileBlock(file, index);
 
     // Once we have the correct start block, handle the byte offset.
-    offset = file->seek - position;
+    offset = file->seek - index * MBFS_BLOCK_SIZE;
 
     // Now, start copying bytes into the requested buffer.
     writePointer = buffer;
@@ -1113,18 +1730,114 @@ int MicroBitFileSystem::read(int fd, uint8_t* buffer, int size)
         writePointer += segmentLength;
         offset += segmentLength;
 
-        if (offset == MBFS_BLOCK_SIZE)
+        if (offset == MBFS_BLOCK_SIZE && bytesCopied < size)
         {
             block = getNextFileBlock(block);
+            index++;
             offset = 0;
         }
     }
 
+    // Remember where we finished, so that a sequential read can carry on from here.
+    cacheFileBlock(file, index, block);
+
     file->seek += bytesCopied;
 
     return bytesCopied;
 }
 
+/**
+  * Map a region of the file, for reading in place.
+  *
+  * Provides a pointer to the flash memory holding the data at the current seek
+  * position in the file, and the number of contiguous bytes available there, up to
+  * size. The seek position is incremented by the number of bytes returned, so
+  * repeated calls iterate over the file a run at a time. Runs extend across file
+  * blocks that happen to be adjacent in flash. The data remains valid until the
+  * file is next written or removed.
+  *
+  * @param fd File handle, obtained with open()
+  * @param data pointer to be set to the start of the mapped data
+  * @param size maximum number of bytes to map
+  * @return number of bytes mapped on success (zero at the end of the file),
+  *         MICROBIT_NOT_SUPPORTED if the file system is not initialised,
+  *         MICROBIT_INVALID_PARAMETER if the given file handle is invalid.
+  *
+  * @code
+  * MicroBitFileSystem f;
+  * const uint8_t *data;
+  * int fd = f.open("image.bin", MB_READ);
+  * int len;
+  * while ((len = f.map(fd, &data, 256)) > 0)
+  *    consume(data, len);
+  * @endcode
+  */
+int MicroBitFileSystem::map(int fd, const uint8_t **data, int size)
+{
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
+    FileDescriptor *file;
+    uint16_t block;
+    uint16_t next;
+
+    uint32_t offset;
+    uint16_t index;
+    int length;
+
+    // Protect against accidental re-initialisation
+    if ((status & MBFS_STATUS_INITIALISED) == 0)
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Ensure the file is open.
+    file = getFileDescriptor(fd);
+
+    if (file == NULL || data == NULL || size <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Flush any data in the writeback cache, so that flash holds the whole file.
+    writeBack(file);
+
+    // Validate the map length.
+    size = min(size, file->length - file->seek);
+
+    if (size == 0)
+    {
+        *data = NULL;
+        return 0;
+    }
+
+    // Find the block holding the next unread byte.
+    index = file->seek / MBFS_BLOCK_SIZE;
+    block = getFileBlock(file, index);
+    offset = file->seek - index * MBFS_BLOCK_SIZE;
+
+    *data = (uint8_t *)getBlock(block) + offset;
+    length = min(size, MBFS_BLOCK_SIZE - offset);
+
+    // Carry the run on into any following blocks which are also next to each other in flash.
+    while (length < size)
+    {
+        next = getNextFileBlock(block);
+
+        if (next != block + 1)
+            break;
+
+        block = next;
+        index++;
+        length = min(size, length + MBFS_BLOCK_SIZE);
+    }
+
+    // Remember where we finished, so that the next run can carry on from here.
+    cacheFileBlock(file, index, block);
+
+    file->seek += length;
+
+    return length;
+}
+
 /**
   * Flush a given file's cache back to FLASH memory.
   *
@@ -1158,22 +1871,20 @@ int MicroBitFileSystem::writeBuffer(FileDescriptor *file, uint8_t *buffer, int s
     uint8_t *writePointer;
 
     uint32_t offset;
-    uint32_t position = 0;
+    uint16_t index;
     int bytesCopied = 0;
     int segmentLength;
 
-    // Find the read position.
-    block = file->dirent->first_block;
+    // Log files are only ever written at the end.
+    if (file->flags & MB_LOG)
+        file->seek = file->length;
 
-    // Walk the file table until we reach the start block
-    while (file->seek - position > MBFS_BLOCK_SIZE)
-    {
-        block = getNextFileBlock(block);
-        position += MBFS_BLOCK_SIZE;
-    }
+    // Find the write position. A seek to the end of a block is treated as the end of that block, rather than the start of the next.
+    index = file->seek ? (file->seek - 1) / MBFS_BLOCK_SIZE : 0;
+    block = getFileBlock(file, index);
 
     // Once we have the correct start block, handle the byte offset.
-    offset = file->seek - position;
+    offset = file->seek - index * MBFS_BLOCK_SIZE;
     writePointer = (uint8_t *)getBlock(block) + offset;
 
     // Now, start copying bytes from the requested buffer.
@@ -1200,12 +1911,16 @@ int MicroBitFileSystem::writeBuffer(FileDescriptor *file, uint8_t *buffer, int s
             fileTableWrite(block, newBlock);
 
             block = newBlock;
+            index++;
 
             writePointer = (uint8_t *)getBlock(block);
             offset = 0;
         }
     }
 
+    // Remember where we finished, so that a sequential write can carry on from here.
+    cacheFileBlock(file, index, block);
+
     // update the filelength metadata and seek position such that multiple writes are sequential.
     file->length = max(file->length, file->seek + bytesCopied);
     file->seek += bytesCopied;
@@ -1262,6 +1977,11 @@ bool MicroBitFileSystem::isValidFilename(const char *name)
   */
 int MicroBitFileSystem::write(int fd, uint8_t* buffer, int size)
 {
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
     FileDescriptor *file;
     int bytesCopied = 0;
     int segmentSize;
@@ -1276,23 +1996,35 @@ int MicroBitFileSystem::write(int fd, uint8_t* buffer, int size)
     if (file == NULL || buffer == NULL || size == 0)
         return MICROBIT_INVALID_PARAMETER;
 
+    // Allocate the cache on first use. If there's no memory for it, simply write through.
+    if (size < file->cacheSize && file->cache == NULL)
+    {
+        file->cache = (uint8_t *) malloc(file->cacheSize);
+
+        if (file->cache == NULL)
+            file->cacheSize = 0;
+    }
+
     // Determine how to handle the write. If the buffer size is less than our cache size, 
     // write the data via the cache. Otherwise, a direct write through is likely more efficient.
     // This may take a few iterations if the cache is already quite full.
-    if (size < MBFS_CACHE_SIZE)
+    if (size < file->cacheSize)
     {
         while (bytesCopied < size)
         {
-            segmentSize = min(size, MBFS_CACHE_SIZE - file->cacheLength);
-            memcpy(&file->cache[file->cacheLength], buffer, segmentSize);
+            // The cache is written back when it is full, or when it reaches the end of a block, so that the
+            // writes to FLASH are block aligned.
+            uint32_t position = ((file->flags & MB_LOG) ? file->length : file->seek) + file->cacheLength;
+            int space = min(file->cacheSize - file->cacheLength, MBFS_BLOCK_SIZE - position % MBFS_BLOCK_SIZE);
+
+            segmentSize = min(size - bytesCopied, space);
+            memcpy(&file->cache[file->cacheLength], buffer + bytesCopied, segmentSize);
 
             file->cacheLength += segmentSize;
             bytesCopied += segmentSize;
             
-            if (file->cacheLength == MBFS_CACHE_SIZE)
+            if (segmentSize == space)
                 writeBack(file);
-
-
         }
 
         return bytesCopied;
@@ -1320,7 +2052,12 @@ int MicroBitFileSystem::write(int fd, uint8_t* buffer, int size)
   */
 int MicroBitFileSystem::remove(char const * filename)
 {
-    int fd = open(filename, MB_READ);
+    MicroBitFlashLock lock;
+
+    if (!lock.isLocked())
+        return MICROBIT_BUSY;
+
+    int fd = openFile(filename, MB_READ, MBFS_CACHE_SIZE);
     uint16_t block, nextBlock;
     uint16_t value;
 
@@ -1330,6 +2067,8 @@ int MicroBitFileSystem::remove(char const * filename)
 
     FileDescriptor *file = getFileDescriptor(fd, true);
 
+    invalidateCheckpoint();
+
     // To erase a file, all we need to do is mark its directory entry and data blocks as INVALID.
     // First mark the file table
     block = file->dirent->first_block;
@@ -1341,10 +2080,12 @@ int MicroBitFileSystem::remove(char const * filename)
     }
 
     // Mark the directory entry of this file as invalid.
+    indexRemove(file->dirent, file->directory->first_block);
     value = MBFS_DIRECTORY_ENTRY_DELETED;
     flash.flash_write(&file->dirent->flags, &value, 2);
 
     // release file metadata
+    free(file->cache);
     delete file;
 
     return MICROBIT_OK;
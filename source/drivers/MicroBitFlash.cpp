@@ -22,11 +22,14 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitFlash.h"
 #include "MicroBitDevice.h"
+#include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 #include "ErrorNo.h"
 #include "mbed.h"                   // NVIC
 
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
 
 #define WORD_ADDR(x) (((uint32_t)x) & 0xFFFFFFFC)
 
@@ -43,7 +46,6 @@ DEALINGS IN THE SOFTWARE.
 #endif
 
 #include "nrf_soc.h"
-extern "C" void btle_set_user_evt_handler(void (*func)(uint32_t));
 
 /*
  * Return to our predefined compiler settings.
@@ -52,13 +54,126 @@ extern "C" void btle_set_user_evt_handler(void (*func)(uint32_t));
 #pragma GCC diagnostic pop
 #endif
 
+// The interval after which an operation refused by the SoftDevice (as it was busy) is retried, in microseconds.
+#define FLASH_RETRY_PERIOD 10000
+
+/*
+ * An erase (zero length) or write operation, awaiting the SoftDevice.
+ */
+struct FlashOperation
+{
+    uint32_t *address;
+    uint32_t *buffer;
+    int length;
+};
+
 static bool evt_handler_registered = false;
-static volatile bool flash_op_complete = false;
+static uint32_t erase_count = 0;
+
+static FlashOperation flash_queue[MICROBIT_FLASH_QUEUE_SIZE];
+static volatile int flash_queue_head = 0;
+static volatile int flash_queue_length = 0;
+static volatile bool flash_op_running = false;
+static volatile bool flash_retry_pending = false;
+static SystemTimerEvent flash_retry_event;
+static FiberLock flash_lock;
+
+static void flash_start_next();
+
+static void flash_retry(void *)
+{
+    flash_retry_pending = false;
+    flash_start_next();
+}
+
+/*
+ * Hand the operation at the head of the queue to the SoftDevice, if it isn't already busy with one.
+ */
+static void flash_start_next()
+{
+    FlashOperation *op = &flash_queue[flash_queue_head];
+    uint32_t result;
+
+    // Mark the operation as running first, as the SoftDevice may complete it before returning.
+    // This is also called from interrupt context, so the test and set must be atomic.
+    __disable_irq();
+
+    if (flash_op_running || flash_queue_length == 0)
+    {
+        __enable_irq();
+        return;
+    }
+
+    flash_op_running = true;
+    __enable_irq();
+
+    if (op->length)
+        result = sd_flash_write(op->address, op->buffer, op->length);
+    else
+        result = sd_flash_page_erase(((uintptr_t)op->address)/PAGE_SIZE);
+
+    if (result == NRF_SUCCESS)
+        return;
+
+    // The SoftDevice is busy with something else. Try again shortly.
+    flash_op_running = false;
+
+    if (!flash_retry_pending)
+    {
+        flash_retry_pending = true;
+        system_timer_event_after_us(&flash_retry_event, FLASH_RETRY_PERIOD, flash_retry, NULL);
+    }
+}
 
 static void nvmc_event_handler(uint32_t evt)
 {
-    if(evt == NRF_EVT_FLASH_OPERATION_SUCCESS)
-        flash_op_complete = true;
+    if ((evt != NRF_EVT_FLASH_OPERATION_SUCCESS && evt != NRF_EVT_FLASH_OPERATION_ERROR) || !flash_op_running)
+        return;
+
+    flash_op_running = false;
+
+    // Failed operations are simply retried.
+    if (evt == NRF_EVT_FLASH_OPERATION_SUCCESS)
+    {
+        flash_queue_head = (flash_queue_head + 1) % MICROBIT_FLASH_QUEUE_SIZE;
+        flash_queue_length--;
+
+        MicroBitEvent(MICROBIT_ID_FLASH, MICROBIT_FLASH_EVT_COMPLETE);
+    }
+
+    flash_start_next();
+
+    if (flash_queue_length == 0)
+        MicroBitEvent(MICROBIT_ID_FLASH, MICROBIT_FLASH_EVT_IDLE);
+}
+
+/*
+ * Add an operation to the queue, waiting for space if necessary, and start it if the SoftDevice is idle.
+ */
+static void flash_enqueue(MicroBitFlash *flash, uint32_t *address, uint32_t *buffer, int length)
+{
+    while (1)
+    {
+        __disable_irq();
+
+        if (flash_queue_length < MICROBIT_FLASH_QUEUE_SIZE)
+        {
+            FlashOperation *op = &flash_queue[(flash_queue_head + flash_queue_length) % MICROBIT_FLASH_QUEUE_SIZE];
+
+            op->address = address;
+            op->buffer = buffer;
+            op->length = length;
+            flash_queue_length++;
+
+            __enable_irq();
+            break;
+        }
+
+        __enable_irq();
+        flash->flash_wait();
+    }
+
+    flash_start_next();
 }
 
 /**
@@ -68,7 +183,7 @@ MicroBitFlash::MicroBitFlash()
 {
     if (!evt_handler_registered)
     {
-        btle_set_user_evt_handler(nvmc_event_handler);
+        microbit_add_soc_event_handler(nvmc_event_handler);
         evt_handler_registered = true;
     }
 }
@@ -103,18 +218,13 @@ int MicroBitFlash::need_erase(uint8_t* source, uint8_t* flash_addr, int len)
   */
 void MicroBitFlash::erase_page(uint32_t* pg_addr) 
 {
+    erase_count++;
+
     if (ble_running())
     {
-        flash_op_complete = false;
-        while(1)
-        {
-            if (sd_flash_page_erase(((uint32_t)pg_addr)/PAGE_SIZE) == NRF_SUCCESS)
-                break;
-
-            wait_ms(10);
-        }
-        // Wait for SoftDevice to diable the write operation when it completes...
-        while(!flash_op_complete);
+        // Schedule SoftDevice to erase this page for us, and wait for it to complete.
+        flash_enqueue(this, pg_addr, NULL, 0);
+        flash_wait();
     }
     else
     {
@@ -123,7 +233,7 @@ void MicroBitFlash::erase_page(uint32_t* pg_addr)
         while (NRF_NVMC->READY == NVMC_READY_READY_Busy) { }
 
         // Erase page:
-        NRF_NVMC->ERASEPAGE = (uint32_t)pg_addr;
+        NRF_NVMC->ERASEPAGE = (uintptr_t)pg_addr;
         while (NRF_NVMC->READY == NVMC_READY_READY_Busy) { }
 
         // Turn off flash erase enable and wait until the NVMC is ready:
@@ -132,6 +242,99 @@ void MicroBitFlash::erase_page(uint32_t* pg_addr)
     }
 }
  
+/**
+  * Queue the erase of an entire page, and return without waiting for it to complete.
+  * A MICROBIT_FLASH_EVT_COMPLETE event is raised once the page is erased.
+  *
+  * Without BLE, the CPU cannot run while the FLASH is being erased, so the erase is performed immediately.
+  *
+  * @param page_address address of first word of page.
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitFlash::erase_page_async(uint32_t* pg_addr)
+{
+    if (ble_running())
+    {
+        erase_count++;
+        flash_enqueue(this, pg_addr, NULL, 0);
+    }
+    else
+    {
+        erase_page(pg_addr);
+        MicroBitEvent(MICROBIT_ID_FLASH, MICROBIT_FLASH_EVT_COMPLETE);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Queue a write to flash memory, and return without waiting for it to complete.
+  * A MICROBIT_FLASH_EVT_COMPLETE event is raised once the data is written.
+  *
+  * Without BLE, the CPU cannot run while the FLASH is being written, so the write is performed immediately.
+  *
+  * @param page_address address of memory to write to. Must be word aligned.
+  * @param buffer address to write from, must be word-aligned. This must remain valid until the write completes.
+  * @param len number of uint32_t words to write.
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitFlash::flash_burn_async(uint32_t* addr, uint32_t* buffer, int size)
+{
+    if (ble_running())
+    {
+        flash_enqueue(this, addr, buffer, size);
+    }
+    else
+    {
+        flash_burn(addr, buffer, size);
+        MicroBitEvent(MICROBIT_ID_FLASH, MICROBIT_FLASH_EVT_COMPLETE);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Wait for queued FLASH operations to complete.
+  * The calling fiber is descheduled while it waits, if possible. The idle thread and interrupt handlers spin instead.
+  *
+  * As operations complete in the order they were queued, an operation is known to have completed
+  * once no more operations remain than were queued after it.
+  *
+  * @param pending the number of operations that may remain queued. Defaults to zero, waiting for all operations.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitFlash::flash_wait(int pending)
+{
+    uint16_t value = pending ? MICROBIT_FLASH_EVT_COMPLETE : MICROBIT_FLASH_EVT_IDLE;
+
+    while (flash_queue_length > pending)
+    {
+        // If we can't deschedule, simply wait for the SoftDevice. The idle thread is restarted rather than
+        // resumed when next scheduled, so it must never be descheduled part way through an operation.
+        if (inInterruptContext() || fiber_is_idle() || fiber_wake_on_event(MICROBIT_ID_FLASH, value) != MICROBIT_OK)
+            continue;
+
+        // If enough operations completed before we started listening, we would miss the event, so raise it ourselves.
+        if (flash_queue_length <= pending)
+            MicroBitEvent(MICROBIT_ID_FLASH, value);
+
+        schedule();
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determine if any queued FLASH operations have yet to complete.
+  *
+  * @return true if FLASH operations are pending, false otherwise.
+  */
+bool MicroBitFlash::is_busy()
+{
+    return flash_queue_length != 0;
+}
+
 /**
   * Write to flash memory, assuming that a write is valid
   * (using need_erase).
@@ -147,18 +350,8 @@ void MicroBitFlash::flash_burn(uint32_t* addr, uint32_t* buffer, int size)
     {
         // Schedule SoftDevice to write this memory for us, and wait for it to complete.
         // This happens ASYNCHRONOUSLY when SD is enabled (and synchronously if disabled!!)
-        flash_op_complete = false;
-
-        while(1)
-        {
-            if (sd_flash_write(addr, buffer, size) == NRF_SUCCESS)
-                break;
-
-            wait_ms(10);
-        }
-
-        // Wait for SoftDevice to diable the write operation when it completes...
-        while(!flash_op_complete);
+        flash_enqueue(this, addr, buffer, size);
+        flash_wait();
     }
     else
     {
@@ -178,9 +371,135 @@ void MicroBitFlash::flash_burn(uint32_t* addr, uint32_t* buffer, int size)
     }
 }
  
+/**
+  * Determine the new value of a word in flash, after any of the given writes that cover it are applied.
+  *
+  * @param address address of the word in flash.
+  * @param value the current value of the word.
+  * @param writes the writes to apply. Later writes take precedence over earlier ones.
+  * @param count the number of writes.
+  * @return the updated value of the word.
+  */
+uint32_t MicroBitFlash::merge_word(uint32_t* address, uint32_t value, MicroBitFlashWrite* writes, int count)
+{
+    uint32_t word = (uintptr_t)address;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t from = (uintptr_t)writes[i].address;
+        uint32_t to = from + writes[i].length;
+
+        if (to <= word || from >= word + 4)
+            continue;
+
+        for (int b = 0; b < 4; b++)
+        {
+            if (word + b >= from && word + b < to)
+            {
+                value &= ~(0xFFUL << (b*8));
+                value |= ((uint32_t)((uint8_t *)writes[i].buffer)[word + b - from]) << (b*8);
+            }
+        }
+    }
+
+    return value;
+}
+
+/**
+  * Burn a range of words from a source page into a destination page, applying the given writes.
+  * Only words that differ from the destination's current value are burned, and consecutive
+  * words are burned together.
+  *
+  * @param dest the page to write to.
+  * @param source the page holding the existing data.
+  * @param page the page that the writes are addressed to.
+  * @param start the first word to burn.
+  * @param end the word after the last word to burn.
+  * @param writes the writes to apply.
+  * @param count the number of writes.
+  */
+void MicroBitFlash::burn_words(uint32_t* dest, uint32_t* source, uint32_t* page, int start, int end, MicroBitFlashWrite* writes, int count)
+{
+    uint32_t run[MICROBIT_FLASH_BURN_WORDS];
+    int length = 0;
+
+    for (int i = start; i <= end; i++)
+    {
+        bool changed = false;
+
+        if (i < end)
+        {
+            uint32_t value = merge_word(page + i, source[i], writes, count);
+
+            if (value != dest[i])
+            {
+                run[length++] = value;
+                changed = true;
+            }
+        }
+
+        // Burn the run of changed words when it ends, or when our buffer is full.
+        if (length && (!changed || length == MICROBIT_FLASH_BURN_WORDS))
+        {
+            this->flash_burn(dest + (changed ? i + 1 : i) - length, run, length);
+            length = 0;
+        }
+    }
+}
+
+/**
+  * Apply any of the given writes that fall within a page of flash memory.
+  * The page is erased at most once, and only if a bit needs to change from 0 to 1.
+  *
+  * @param page address of the page.
+  * @param writes the writes to apply.
+  * @param count the number of writes.
+  * @param scratch the scratch page to use if the page must be erased.
+  */
+void MicroBitFlash::write_page(uint32_t* page, MicroBitFlashWrite* writes, int count, uint32_t* scratch)
+{
+    uint32_t pageStart = (uintptr_t)page;
+    uint32_t pageEnd = pageStart + PAGE_SIZE;
+    int start = PAGE_SIZE / 4;
+    int end = 0;
+    bool erase = false;
+
+    // Determine the range of words touched by the writes within this page.
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t from = (uintptr_t)writes[i].address;
+        uint32_t to = from + writes[i].length;
+
+        if (to <= pageStart || from >= pageEnd)
+            continue;
+
+        start = MIN(start, (int)((MAX(from, pageStart) - pageStart) / 4));
+        end = MAX(end, (int)((MIN(to, pageEnd) - pageStart + 3) / 4));
+    }
+
+    // An erase is necessary if any bit needs to change from 0 to 1.
+    for (int i = start; i < end && !erase; i++)
+        if (~page[i] & merge_word(page + i, page[i], writes, count))
+            erase = true;
+
+    if (!erase)
+    {
+        burn_words(page, page, page, start, end, writes, count);
+        return;
+    }
+
+    // Preserve the data by assembling the updated page in the scratch page, then copy it back.
+    // Words left in the erased state are skipped in both cases.
+    this->erase_page(scratch);
+    burn_words(scratch, page, page, 0, PAGE_SIZE / 4, writes, count);
+    this->erase_page(page);
+    burn_words(page, scratch, page, 0, PAGE_SIZE / 4, NULL, 0);
+}
+
 /**
   * Writes the given number of bytes to the address in flash specified.
   * Neither address nor buffer need be word-aligned.
+  * Only the words that change are written, and the page is only erased if a bit needs to change from 0 to 1.
   * @param address location in flash to write to.
   * @param buffer location in memory to write from.
   * @length number of bytes to burn
@@ -197,66 +516,100 @@ void MicroBitFlash::flash_burn(uint32_t* addr, uint32_t* buffer, int size)
   */
 int MicroBitFlash::flash_write(void* address, void* from_buffer, 
                                int length, void* scratch_addr)
+{
+    MicroBitFlashWrite write;
+
+    write.address = address;
+    write.buffer = from_buffer;
+    write.length = length;
+
+    return flash_write(&write, 1, scratch_addr);
+}
+
+/**
+  * Makes several writes to flash memory at once.
+  * Writes to the same page are merged, so each page is erased at most once, however many writes
+  * it receives. Words whose contents would not change are not written at all.
+  *
+  * @param writes the writes to make. Where writes overlap, later writes take precedence.
+  * @param count the number of writes.
+  * @param scratch_addr if specified, scratch page to use. Use default otherwise.
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the scratch page is not page aligned.
+  *
+  * Example:
+  * @code
+  * MicroBitFlash flash();
+  * uint32_t a = 0x01, b = 0x02;
+  * MicroBitFlashWrite writes[] = {{(void *)0x38000, &a, sizeof(a)}, {(void *)0x38010, &b, sizeof(b)}};
+  * flash.flash_write(writes, 2);
+  * @endcode
+  */
+int MicroBitFlash::flash_write(MicroBitFlashWrite* writes, int count, void* scratch_addr)
 {
     // If no scratch_addr has been supplied use the default
     if(scratch_addr == NULL)
         scratch_addr = (uint32_t *)DEFAULT_SCRATCH_PAGE;
 
-
     // Ensure that scratch_addr is aligned on a page boundary.
-    if((uint32_t)scratch_addr & 0x3FF) 
+    if((uintptr_t)scratch_addr & 0x3FF) 
         return MICROBIT_INVALID_PARAMETER;
 
-    // Locate the hardware FLASH page used by this operation.
-    int page = (uint32_t)address / PAGE_SIZE;
-    uint32_t* pgAddr = (uint32_t*)(page * PAGE_SIZE);
-
-    // offset to write from within page.
-    int offset = (uint32_t)address % PAGE_SIZE;
+    // Determine the range of hardware FLASH pages used by this operation.
+    uint32_t first = 0xFFFFFFFF;
+    uint32_t last = 0;
 
-    uint8_t* writeFrom = (uint8_t*)pgAddr;
-    int start = WORD_ADDR(offset);
-    int end = WORD_ADDR((offset+length+4));
-    int erase = need_erase((uint8_t *)from_buffer, (uint8_t *)address, length);
-
-    // Preserve the data by writing to the scratch page.
-    if(erase) 
+    for (int i = 0; i < count; i++)
     {
-        if (!scratch_addr)
-            return MICROBIT_INVALID_PARAMETER;
-
-        this->erase_page((uint32_t *)scratch_addr);
+        if (writes[i].length <= 0)
+            continue;
 
-        this->flash_burn((uint32_t*)scratch_addr, pgAddr, PAGE_SIZE/4);
-        this->erase_page(pgAddr);
-        writeFrom = (uint8_t*)scratch_addr;
-        start = 0;
-        end = PAGE_SIZE;
+        first = MIN(first, (uintptr_t)writes[i].address / PAGE_SIZE);
+        last = MAX(last, ((uintptr_t)writes[i].address + writes[i].length - 1) / PAGE_SIZE);
     }
 
-    uint32_t writeWord = 0;
+    // Update each page in turn. Pages with no writes are left untouched.
+    for (uint32_t page = first; page <= last; page++)
+        write_page((uint32_t *)(page * PAGE_SIZE), writes, count, (uint32_t *)scratch_addr);
 
-    for(int i=start;i<end;i++) 
-    {
-        int byteOffset = i%4;
+    return MICROBIT_OK;
+}
 
-        if(i >= offset && i < (offset + length)) 
-        {
-            // Write from buffer.
-            writeWord |= (((uint8_t *)from_buffer)[i-offset] << ((byteOffset)*8));
-        }
-        else 
-        {
-            writeWord |= (writeFrom[i] << ((byteOffset)*8));
-        }
+/**
+  * Determine how many pages have been erased since the device started, by all instances of MicroBitFlash.
+  *
+  * @return the number of page erase operations.
+  */
+uint32_t MicroBitFlash::get_erase_count()
+{
+    return erase_count;
+}
 
-        if( ((i+1)%4) == 0) 
-        {
-            this->flash_burn(pgAddr + (i/4), &writeWord, 1);
-            writeWord = 0;
-        }
-    }
+/**
+  * Constructor. Acquires the lock, blocking the calling fiber until it is available if possible.
+  */
+MicroBitFlashLock::MicroBitFlashLock()
+{
+    locked = flash_lock.tryWait() == MICROBIT_OK;
 
-    return MICROBIT_OK;
+    if (!locked && fiber_scheduler_running() && !inInterruptContext() && !fiber_is_idle())
+        locked = flash_lock.wait() == MICROBIT_OK;
+}
+
+/**
+  * Destructor. Releases the lock, if it was acquired.
+  */
+MicroBitFlashLock::~MicroBitFlashLock()
+{
+    if (locked)
+        flash_lock.notify();
 }
 
+/**
+  * Determines if the lock was acquired.
+  *
+  * @return true if the lock is held by this object, false otherwise.
+  */
+bool MicroBitFlashLock::isLocked()
+{
+    return locked;
+}
@@ -26,9 +26,37 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitI2C.h"
 #include "ErrorNo.h"
+#include "MicroBitEvent.h"
+#include "MicroBitFiber.h"
+#include "MicroBitPowerProfile.h"
 #include "twi_master.h"
 #include "nrf_delay.h"
 
+// The state of the transfer in progress, held in engineStatus.
+#define I2C_ENGINE_RUNNING          0x01        // A transfer is in progress.
+#define I2C_ENGINE_RECEIVING        0x02        // The register address has been sent, and data is being read.
+#define I2C_ENGINE_ERROR            0x04        // The transfer has failed, and the bus is being stopped.
+#define I2C_ENGINE_LOCKED           0x08        // The peripheral is in use by mbed's polled driver.
+
+#define I2C_ENGINE_INTERRUPTS       (TWI_INTENSET_STOPPED_Msk | TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_ERROR_Msk)
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+// The instance driving each of the two TWI peripherals.
+static MicroBitI2C *twi_instance[2] = { NULL, NULL };
+
+extern "C" void SPI0_TWI0_IRQHandler(void)
+{
+    if (twi_instance[0])
+        twi_instance[0]->interruptHandler();
+}
+
+extern "C" void SPI1_TWI1_IRQHandler(void)
+{
+    if (twi_instance[1])
+        twi_instance[1]->interruptHandler();
+}
+#endif
+
 /**
   * Constructor.
   *
@@ -54,6 +82,24 @@ DEALINGS IN THE SOFTWARE.
 MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
 {
     this->retries = 0;
+    this->queueHead = NULL;
+    this->queueTail = NULL;
+    this->engineStatus = 0;
+    this->waiting = 0;
+    this->index = 0;
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    // Route the TWI interrupt to this instance. Interrupts are only enabled on the peripheral while
+    // a transfer is in progress, so mbed's polled driver is unaffected.
+    int n = (_i2c.i2c == NRF_TWI0) ? 0 : 1;
+    IRQn_Type irq = n ? SPI1_TWI1_IRQn : SPI0_TWI0_IRQn;
+
+    twi_instance[n] = this;
+    _i2c.i2c->INTENCLR = I2C_ENGINE_INTERRUPTS;
+
+    NVIC_ClearPendingIRQ(irq);
+    NVIC_EnableIRQ(irq);
+#endif
 }
 
 /**
@@ -71,6 +117,13 @@ MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
   */
 int MicroBitI2C::read(int address, char *data, int length, bool repeated)
 {
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    // mbed's driver polls the peripheral directly, so let any queued transfers finish first.
+    waitFor(NULL);
+#endif
+
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, true);
+
     int result = I2C::read(address,data,length,repeated);
 
 #ifdef MICROBIT_I2C_RESET_IN_FAIL
@@ -89,6 +142,13 @@ int MicroBitI2C::read(int address, char *data, int length, bool repeated)
     }
 #endif
 
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, false);
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    engineStatus &= ~I2C_ENGINE_LOCKED;
+    startTransfer();
+#endif
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
@@ -111,6 +171,13 @@ int MicroBitI2C::read(int address, char *data, int length, bool repeated)
   */
 int MicroBitI2C::write(int address, const char *data, int length, bool repeated)
 {
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    // mbed's driver polls the peripheral directly, so let any queued transfers finish first.
+    waitFor(NULL);
+#endif
+
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, true);
+
     int result = I2C::write(address,data,length,repeated);
 
     //0 indicates a success, presume failure
@@ -130,6 +197,13 @@ int MicroBitI2C::write(int address, const char *data, int length, bool repeated)
     }
 #endif    
 
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, false);
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    engineStatus &= ~I2C_ENGINE_LOCKED;
+    startTransfer();
+#endif
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
@@ -150,11 +224,18 @@ int MicroBitI2C::write(int address, const char *data, int length, bool repeated)
   */
 int MicroBitI2C::writeRegister(uint8_t address, uint8_t reg, uint8_t value)
 {
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    MicroBitI2CTransfer transfer;
+
+    writeRegisterAsync(transfer, address, reg, &value, 1);
+    return wait(transfer);
+#else
     uint8_t command[2];
     command[0] = reg;
     command[1] = value;
 
     return write(address, (const char *)command, 2);
+#endif
 }
 
 /**
@@ -176,11 +257,18 @@ int MicroBitI2C::readRegister(uint8_t address, uint8_t reg, uint8_t* buffer, int
     if (buffer == NULL || length <= 0 )
         return MICROBIT_INVALID_PARAMETER;
 
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    MicroBitI2CTransfer transfer;
+
+    readRegisterAsync(transfer, address, reg, buffer, length);
+    result = wait(transfer);
+#else
     result = write(address, (const char *)&reg, 1, true);
     if (result !=0)
         return MICROBIT_I2C_ERROR;
 
     result = read(address, (char *)buffer, length);
+#endif
     if (result !=0)
         return MICROBIT_I2C_ERROR;
 
@@ -206,3 +294,393 @@ int MicroBitI2C::readRegister(uint8_t address, uint8_t reg)
     
     return (result == MICROBIT_OK) ? (int)data : result;
 }
+
+/**
+ * Queues a read of consecutive registers, and returns without waiting for it to complete.
+ *
+ * Transfers are performed in the order they were queued, from the TWI interrupt.
+ *
+ * @param transfer Storage for the transfer, which must remain valid until it completes.
+ * @param address The address of the I2C device to read from.
+ * @param reg The address of the first register to read.
+ * @param buffer Memory area to read the data into, which must remain valid until the transfer completes.
+ * @param length The number of bytes to read.
+ * @param callback A function to call in interrupt context once the transfer completes, or NULL.
+ *
+ * @return MICROBIT_OK if the transfer was queued, or MICROBIT_INVALID_PARAMETER.
+ *
+ * @code
+ * MicroBitI2CTransfer t;
+ * uint8_t data[6];
+ *
+ * i2c.readRegisterAsync(t, address, reg, data, 6);
+ * // Do something else...
+ * if (i2c.wait(t) == MICROBIT_OK)
+ *     // Use the data...
+ * @endcode
+ */
+int MicroBitI2C::readRegisterAsync(MicroBitI2CTransfer &transfer, uint8_t address, uint8_t reg, uint8_t *buffer, int length, void (*callback)(MicroBitI2CTransfer *))
+{
+    if (buffer == NULL || length <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    transfer.address = address;
+    transfer.reg = reg;
+    transfer.flags = MICROBIT_I2C_TRANSFER_READ;
+    transfer.buffer = buffer;
+    transfer.length = length;
+    transfer.callback = callback;
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    queueTransfer(transfer);
+#else
+    // Without the interrupt driven engine, the transfer is simply performed now.
+    transfer.result = readRegister(address, reg, buffer, length);
+
+    if (callback)
+        callback(&transfer);
+#endif
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Queues a write of consecutive registers, and returns without waiting for it to complete.
+ *
+ * Transfers are performed in the order they were queued, from the TWI interrupt.
+ *
+ * @param transfer Storage for the transfer, which must remain valid until it completes.
+ * @param address The address of the I2C device to write to.
+ * @param reg The address of the first register to write.
+ * @param buffer The data to write, which must remain valid until the transfer completes.
+ * @param length The number of bytes to write.
+ * @param callback A function to call in interrupt context once the transfer completes, or NULL.
+ *
+ * @return MICROBIT_OK if the transfer was queued, MICROBIT_INVALID_PARAMETER,
+ *         or MICROBIT_NO_RESOURCES if the write could not be buffered.
+ */
+int MicroBitI2C::writeRegisterAsync(MicroBitI2CTransfer &transfer, uint8_t address, uint8_t reg, uint8_t *buffer, int length, void (*callback)(MicroBitI2CTransfer *))
+{
+    if (buffer == NULL || length <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    transfer.address = address;
+    transfer.reg = reg;
+    transfer.flags = 0;
+    transfer.buffer = buffer;
+    transfer.length = length;
+    transfer.callback = callback;
+
+#if CONFIG_ENABLED(MICROBIT_I2C_ASYNC)
+    queueTransfer(transfer);
+#else
+    // Without the interrupt driven engine, the transfer is simply performed now.
+    uint8_t *command = (uint8_t *)malloc(length + 1);
+
+    if (command == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    command[0] = reg;
+    memcpy(&command[1], buffer, length);
+
+    transfer.result = write(address, (const char *)command, length + 1);
+    free(command);
+
+    if (callback)
+        callback(&transfer);
+#endif
+
+    return MICROBIT_OK;
+}
+
+/**
+ * Waits for a queued transfer to complete.
+ *
+ * The calling fiber is descheduled while it waits, where possible. Otherwise, the processor
+ * sleeps until the next interrupt.
+ *
+ * @param transfer The transfer to wait for.
+ *
+ * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the transfer failed.
+ */
+int MicroBitI2C::wait(MicroBitI2CTransfer &transfer)
+{
+    waitFor(&transfer);
+    return transfer.result;
+}
+
+/**
+ * Determines if any queued transfers have yet to complete.
+ *
+ * @return true if transfers are pending, false otherwise.
+ */
+bool MicroBitI2C::isBusy()
+{
+    return queueHead != NULL;
+}
+
+/**
+  * Waits for a transfer, or for all queued transfers, to complete.
+  *
+  * When waiting for the queue to empty, the peripheral is then claimed for mbed's polled driver, and no
+  * further transfers start until I2C_ENGINE_LOCKED is cleared and startTransfer() is called.
+  *
+  * @param transfer the transfer to wait for, or NULL to wait until the queue is empty.
+  */
+void MicroBitI2C::waitFor(MicroBitI2CTransfer *transfer)
+{
+    while (1)
+    {
+        __disable_irq();
+
+        if (transfer ? transfer->result != MICROBIT_BUSY : queueHead == NULL)
+        {
+            // When waiting for the queue to drain, claim the peripheral before anything else is queued.
+            if (transfer == NULL)
+                engineStatus |= I2C_ENGINE_LOCKED;
+
+            __enable_irq();
+            return;
+        }
+
+        __enable_irq();
+
+        if (inInterruptContext())
+        {
+            // The TWI interrupt may not be able to preempt us, so advance the transfer ourselves.
+            __disable_irq();
+            interruptHandler();
+            __enable_irq();
+        }
+        else if (fiber_is_idle() || fiber_wake_on_event(MICROBIT_ID_I2C, MICROBIT_I2C_EVT_COMPLETE) != MICROBIT_OK)
+        {
+            // We can't deschedule, so sleep until the next interrupt.
+            __WFE();
+        }
+        else
+        {
+            // Completion events are only raised while someone is waiting. If the transfer completed
+            // before we started listening, we would miss the event, so raise it ourselves.
+            waiting++;
+
+            if (transfer ? transfer->result != MICROBIT_BUSY : queueHead == NULL)
+                MicroBitEvent(MICROBIT_ID_I2C, MICROBIT_I2C_EVT_COMPLETE);
+
+            schedule();
+            waiting--;
+        }
+    }
+}
+
+/**
+  * Adds a transfer to the tail of the queue, and starts it if the bus is idle.
+  *
+  * @param transfer the transfer to queue.
+  */
+void MicroBitI2C::queueTransfer(MicroBitI2CTransfer &transfer)
+{
+    transfer.result = MICROBIT_BUSY;
+    transfer.next = NULL;
+
+    __disable_irq();
+
+    if (queueTail)
+        queueTail->next = &transfer;
+    else
+        queueHead = &transfer;
+
+    queueTail = &transfer;
+
+    __enable_irq();
+
+    startTransfer();
+}
+
+/**
+  * Starts the transfer at the head of the queue, if there is one and the bus is idle.
+  */
+void MicroBitI2C::startTransfer()
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+    MicroBitI2CTransfer *t;
+
+    // This is called from both thread and interrupt context, so the test and set must be atomic.
+    __disable_irq();
+
+    t = queueHead;
+
+    if (t == NULL || (engineStatus & (I2C_ENGINE_RUNNING | I2C_ENGINE_LOCKED)))
+    {
+        __enable_irq();
+        return;
+    }
+
+    engineStatus = I2C_ENGINE_RUNNING;
+    index = 0;
+
+    __enable_irq();
+
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, true);
+
+    // Remember how mbed configured the peripheral, in case it has to be reset.
+    pins[0] = twi->PSELSCL;
+    pins[1] = twi->PSELSDA;
+    speed = twi->FREQUENCY;
+
+    twi->EVENTS_STOPPED = 0;
+    twi->EVENTS_RXDREADY = 0;
+    twi->EVENTS_TXDSENT = 0;
+    twi->EVENTS_ERROR = 0;
+    twi->SHORTS = 0;
+    twi->ADDRESS = t->address >> 1;
+    twi->INTENSET = I2C_ENGINE_INTERRUPTS;
+
+    // Every transfer starts by writing the register address.
+    twi->TXD = t->reg;
+    twi->TASKS_STARTTX = 1;
+}
+
+/**
+  * Completes the transfer in progress, and starts the next.
+  *
+  * @param result MICROBIT_OK or MICROBIT_I2C_ERROR.
+  */
+void MicroBitI2C::endTransfer(int result)
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+    MicroBitI2CTransfer *t = queueHead;
+
+    twi->INTENCLR = I2C_ENGINE_INTERRUPTS;
+    twi->SHORTS = 0;
+
+    queueHead = t->next;
+
+    if (queueHead == NULL)
+        queueTail = NULL;
+
+    engineStatus = 0;
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_I2C, false);
+
+    // The owner of the transfer may release it as soon as the result is set.
+    void (*callback)(MicroBitI2CTransfer *) = t->callback;
+
+    t->result = result;
+
+    if (callback)
+        callback(t);
+
+    if (waiting)
+        MicroBitEvent(MICROBIT_ID_I2C, MICROBIT_I2C_EVT_COMPLETE);
+
+    startTransfer();
+}
+
+/**
+ * Services the TWI interrupt, advancing the transfer in progress.
+ *
+ * @note This is called by the TWI interrupt handler, and should not be called by applications.
+ */
+void MicroBitI2C::interruptHandler()
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+    MicroBitI2CTransfer *t = queueHead;
+
+    if (t == NULL || !(engineStatus & I2C_ENGINE_RUNNING))
+        return;
+
+    if (twi->EVENTS_ERROR)
+    {
+        // The device didn't acknowledge, or the bus has locked up (see PAN56). Stop, and fail or retry the transfer once stopped.
+        twi->EVENTS_ERROR = 0;
+        twi->ERRORSRC = twi->ERRORSRC;
+        twi->SHORTS = 0;
+        twi->TASKS_RESUME = 1;
+        twi->TASKS_STOP = 1;
+
+        engineStatus |= I2C_ENGINE_ERROR;
+    }
+
+    if (twi->EVENTS_TXDSENT)
+    {
+        twi->EVENTS_TXDSENT = 0;
+
+        if (!(engineStatus & I2C_ENGINE_ERROR))
+        {
+            if (t->flags & MICROBIT_I2C_TRANSFER_READ)
+            {
+                // The register address has been sent. Issue a repeated start to read the data,
+                // suspending after each byte so we can stop the bus after the last.
+                engineStatus |= I2C_ENGINE_RECEIVING;
+                twi->SHORTS = t->length == 1 ? TWI_SHORTS_BB_STOP_Msk : TWI_SHORTS_BB_SUSPEND_Msk;
+                twi->TASKS_STARTRX = 1;
+            }
+            else if (index < t->length)
+            {
+                twi->TXD = t->buffer[index++];
+            }
+            else
+            {
+                twi->TASKS_STOP = 1;
+            }
+        }
+    }
+
+    if (twi->EVENTS_RXDREADY)
+    {
+        twi->EVENTS_RXDREADY = 0;
+
+        if ((engineStatus & I2C_ENGINE_RECEIVING) && index < t->length)
+        {
+            t->buffer[index++] = twi->RXD;
+
+            if (!(engineStatus & I2C_ENGINE_ERROR) && index < t->length)
+            {
+                if (index == t->length - 1)
+                    twi->SHORTS = TWI_SHORTS_BB_STOP_Msk;
+
+                // Allow the bus to settle before resuming (see PAN28).
+                nrf_delay_us(4);
+                twi->TASKS_RESUME = 1;
+            }
+        }
+    }
+
+    if (twi->EVENTS_STOPPED)
+    {
+        twi->EVENTS_STOPPED = 0;
+
+        if (!(engineStatus & I2C_ENGINE_ERROR))
+        {
+            retries = 0;
+            endTransfer(MICROBIT_OK);
+            return;
+        }
+
+#ifdef MICROBIT_I2C_RESET_IN_FAIL
+        if (retries < MICROBIT_I2C_MAX_RETRIES)
+        {
+            // Reset the peripheral, restore its configuration and try again.
+            twi->INTENCLR = I2C_ENGINE_INTERRUPTS;
+            twi->ENABLE = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+            twi->POWER = 0;
+            nrf_delay_us(5);
+            twi->POWER = 1;
+            twi_master_init_and_clear();
+
+            twi->ENABLE = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+            twi->PSELSCL = pins[0];
+            twi->PSELSDA = pins[1];
+            twi->FREQUENCY = speed;
+            twi->ENABLE = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+
+            retries++;
+            engineStatus = 0;
+            startTransfer();
+            return;
+        }
+#endif
+
+        retries = 0;
+        endTransfer(MICROBIT_I2C_ERROR);
+    }
+}
@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "MicroBitIO.h"
+#include "ErrorNo.h"
 
 /**
   * Constructor.
@@ -67,4 +68,162 @@ MicroBitIO::MicroBitIO(int ID_P0, int ID_P1, int ID_P2,
     P19(ID_P19,MICROBIT_PIN_P19,PIN_CAPABILITY_STANDARD),        //SCL
     P20(ID_P20,MICROBIT_PIN_P20,PIN_CAPABILITY_STANDARD)         //SDA
 {
+    outputMask = 0;
+    inputMask = 0;
+}
+
+/**
+  * Finds the pin on the edge connector attached to the given bit of the GPIO port.
+  *
+  * @param bit The bit in the GPIO port.
+  *
+  * @return the pin, or NULL if the bit has no pin on the edge connector.
+  */
+MicroBitPin* MicroBitIO::findPin(int bit)
+{
+    for (int i = 0; i < MICROBIT_IO_PINS; i++)
+        if (pin[i].name == bit)
+            return &pin[i];
+
+    return NULL;
+}
+
+/**
+  * Configures a set of pins as digital inputs or outputs, for use with readDigital() and writeDigital().
+  *
+  * @param mask The pins to configure, as a mask of bits in the processor's GPIO port.
+  *
+  * @param output true to configure the pins as outputs, false for inputs.
+  *
+  * @param pull The pull to apply to inputs.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_NOT_SUPPORTED on failure.
+  */
+int MicroBitIO::configureDigital(uint32_t mask, bool output, PinMode pull)
+{
+    // Check the whole request first, so that nothing is changed if any of it is invalid.
+    for (int bit = 0; bit < 32; bit++)
+    {
+        if (!(mask & (1 << bit)))
+            continue;
+
+        if (findPin(bit) == NULL)
+            return MICROBIT_INVALID_PARAMETER;
+    }
+
+    // Let each MicroBitPin set itself up, so that it knows the mode it is in. From here on, the port is driven directly.
+    for (int bit = 0; bit < 32; bit++)
+    {
+        if (!(mask & (1 << bit)))
+            continue;
+
+        MicroBitPin *p = findPin(bit);
+        int result;
+
+        if (output)
+        {
+            result = p->setDigitalValue((NRF_GPIO->OUT >> bit) & 1);
+        }
+        else
+        {
+            p->setPull(pull);
+            result = p->getDigitalValue();
+        }
+
+        if (result < 0)
+            return result;
+    }
+
+    if (output)
+    {
+        outputMask |= mask;
+        inputMask &= ~mask;
+    }
+    else
+    {
+        inputMask |= mask;
+        outputMask &= ~mask;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Configures a set of pins as digital outputs, ready to be written together with writeDigital().
+  *
+  * @param mask The pins to configure, as a mask of bits in the processor's GPIO port, i.e. (1 << P0.name) | (1 << P1.name).
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the mask includes a pin that is not on the edge connector,
+  *         or MICROBIT_NOT_SUPPORTED if it includes a pin that does not have digital capability.
+  *
+  * @note Once configured, the pins must not be given another mode through their MicroBitPin until the bulk operations are
+  *       finished with. Configuring the pins again will bring them back into line.
+  */
+int MicroBitIO::setDigitalOutputs(uint32_t mask)
+{
+    return configureDigital(mask, true, PullNone);
+}
+
+/**
+  * Configures a set of pins as digital inputs, ready to be read together with readDigital().
+  *
+  * @param mask The pins to configure, as a mask of bits in the processor's GPIO port, i.e. (1 << P0.name) | (1 << P1.name).
+  *
+  * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the mask includes a pin that is not on the edge connector,
+  *         or MICROBIT_NOT_SUPPORTED if it includes a pin that does not have digital capability.
+  *
+  * @note Once configured, the pins must not be given another mode through their MicroBitPin until the bulk operations are
+  *       finished with. Configuring the pins again will bring them back into line.
+  */
+int MicroBitIO::setDigitalInputs(uint32_t mask, PinMode pull)
+{
+    return configureDigital(mask, false, pull);
+}
+
+/**
+  * Sets the level of several digital outputs at once, with a single access to the GPIO port.
+  *
+  * @param mask The pins to write, as a mask of bits in the processor's GPIO port. These must have been configured with setDigitalOutputs().
+  *
+  * @param value The levels to write, one bit per pin in the same layout as the mask. Bits outside of the mask are ignored.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the mask includes a pin not configured as an output.
+  *
+  * @code
+  * uBit.io.setDigitalOutputs(bus);
+  * uBit.io.writeDigital(bus, data);
+  * @endcode
+  */
+int MicroBitIO::writeDigital(uint32_t mask, uint32_t value)
+{
+    if (mask & ~outputMask)
+        return MICROBIT_NOT_SUPPORTED;
+
+    NRF_GPIO->OUTSET = value & mask;
+    NRF_GPIO->OUTCLR = ~value & mask;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Reads the level of several digital inputs at once, with a single access to the GPIO port.
+  *
+  * @param mask The pins to read, as a mask of bits in the processor's GPIO port. These must have been configured with setDigitalInputs().
+  *
+  * @return the level of each pin, as a bit in the same layout as the mask, or MICROBIT_NOT_SUPPORTED if the mask includes a pin not
+  *         configured as an input.
+  *
+  * @code
+  * uBit.io.setDigitalInputs(keys, PullUp);
+  * int pressed = ~uBit.io.readDigital(keys) & keys;
+  * @endcode
+  */
+int MicroBitIO::readDigital(uint32_t mask)
+{
+    if (mask & ~inputMask)
+        return MICROBIT_NOT_SUPPORTED;
+
+    return NRF_GPIO->IN & mask;
 }
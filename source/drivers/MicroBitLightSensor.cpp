@@ -51,6 +51,21 @@ void MicroBitLightSensor::analogReady()
     chan++;
 
     chan = chan % MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+
+    if (chan != 0)
+        return;
+
+    // Each time every section of the display has been read, feed the filter and tell anyone waiting.
+    if (filter.getType() != MICROBIT_FILTER_NONE)
+        filter.push(average());
+
+    timestamp = system_timer_current_time();
+
+    if (notify)
+    {
+        notify = false;
+        MicroBitEvent(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY);
+    }
 }
 
 /**
@@ -82,10 +97,11 @@ void MicroBitLightSensor::analogDisable()
   *            Defaults to microbitMatrixMap, defined in MicroBitMatrixMaps.h.
   */
 MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
-    analogTrigger(),
     matrixMap(map)
 {
     this->chan = 0;
+    this->timestamp = 0;
+    this->notify = false;
 
     for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
         results[i] = 0;
@@ -96,6 +112,19 @@ MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
     this->sensePin = NULL;
 }
 
+/**
+  * Calculates the average of the results from each section of the display.
+  */
+int MicroBitLightSensor::average()
+{
+    int sum = 0;
+
+    for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
+        sum += results[i];
+
+    return sum / MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+}
+
 /**
   * This method returns a summed average of the three sections of the display.
   *
@@ -119,12 +148,7 @@ MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
   */
 int MicroBitLightSensor::read()
 {
-    int sum = 0;
-
-    for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
-        sum += results[i];
-
-    int average = sum / MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+    int average = filter.getType() != MICROBIT_FILTER_NONE ? filter.get().x : this->average();
 
     average = min(average, MICROBIT_LIGHT_SENSOR_MAX_VALUE);
 
@@ -165,7 +189,79 @@ void MicroBitLightSensor::startSensing(MicroBitEvent)
 
     this->sensePin = new AnalogIn(currentPin);
 
-    analogTrigger.attach_us(this, &MicroBitLightSensor::analogReady, MICROBIT_LIGHT_SENSOR_AN_SET_TIME);
+    system_timer_event_after_us(&analogTrigger, MICROBIT_LIGHT_SENSOR_AN_SET_TIME, system_timer_method_callback<MicroBitLightSensor, &MicroBitLightSensor::analogReady>, this);
+}
+
+/**
+  * Requests that an event with value MICROBIT_DISPLAY_EVT_LIGHT_LEVEL_READY is raised from MICROBIT_ID_DISPLAY
+  * when the next complete set of results has been taken. This method does not wait for the results.
+  *
+  * @return the time the results returned by read() were taken, in milliseconds (as given by
+  *         system_timer_current_time()), or 0 if no complete set of results has been taken yet.
+  */
+uint64_t MicroBitLightSensor::requestSample()
+{
+    notify = true;
+
+    return getTimestamp();
+}
+
+/**
+  * Determines when the results returned by read() were taken.
+  *
+  * @return the time, in milliseconds (as given by system_timer_current_time()), or 0 if no complete set
+  *         of results has been taken yet.
+  */
+uint64_t MicroBitLightSensor::getTimestamp()
+{
+    // A 64 bit value can't be read atomically, so don't let analogReady() update it part way through.
+    __disable_irq();
+    uint64_t t = timestamp;
+    __enable_irq();
+
+    return t;
+}
+
+ /**
+  * Smooths the readings of the light sensor, so that each read returns a filtered value. The filter is
+  * updated incrementally as each complete sample is taken, rather than when read.
+  *
+  * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+  *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  *
+  * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+  *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+  *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @code
+  * lightSensor.setFilter(MICROBIT_FILTER_EXPONENTIAL, 4);
+  * @endcode
+  */
+int MicroBitLightSensor::setFilter(int type, int length)
+{
+    int result = filter.configure(type, length);
+
+    // Start from the latest results, rather than reading as dark until the next set is complete.
+    if (result == MICROBIT_OK)
+    {
+        __disable_irq();
+        filter.push(average());
+        __enable_irq();
+    }
+
+    return result;
+}
+
+ /**
+  * Determines the type of filter applied to the readings, as set by setFilter().
+  *
+  * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  */
+int MicroBitLightSensor::getFilter()
+{
+    return filter.getType();
 }
 
 /**
@@ -175,6 +271,8 @@ void MicroBitLightSensor::startSensing(MicroBitEvent)
   */
 MicroBitLightSensor::~MicroBitLightSensor()
 {
+    system_timer_cancel_event(&analogTrigger);
+
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->ignore(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, this, &MicroBitLightSensor::startSensing);
 }
@@ -132,3 +132,61 @@ void MicroBitMemoryMap::findHashes()
         }
     }
 }
+
+/**
+  * Computes a 32 bit FNV-1a hash of the contents of one page of flash.
+  *
+  * Page hashes let a client compare the program it holds against the one on the device
+  * page by page, and resend only those pages that differ. Hashes are always computed
+  * from the live contents of flash, so they remain valid as pages are rewritten.
+  *
+  * @param address The address of the page. Must be page aligned.
+  *
+  * @return the hash of the page's contents.
+  */
+uint32_t MicroBitMemoryMap::getPageHash(uint32_t address)
+{
+    uint8_t *data = (uint8_t *) address;
+    uint32_t hash = MICROBIT_MEMORY_MAP_HASH_SEED;
+
+    for (int i = 0; i < PAGE_SIZE; i++)
+    {
+        hash ^= data[i];
+        hash *= MICROBIT_MEMORY_MAP_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+  * Computes the hashes of a run of consecutive pages of flash.
+  *
+  * Only pages above the Soft Device and below the scratch page can be hashed.
+  *
+  * @param address The address of the first page. Must be page aligned.
+  *
+  * @param hashes The buffer to store the hashes in.
+  *
+  * @param count The maximum number of hashes to store.
+  *
+  * @return the number of hashes stored, which is less than count if the end of the
+  *         program flash was reached, or MICROBIT_INVALID_PARAMETER if address is misaligned
+  *         or out of range.
+  */
+int MicroBitMemoryMap::getPageHashes(uint32_t address, uint32_t *hashes, int count)
+{
+    uint32_t end = DEFAULT_SCRATCH_PAGE;
+
+    if (hashes == NULL || address % PAGE_SIZE || address < memoryMapStore.memoryMap[1].startAddress || address >= end)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int stored = 0;
+
+    while (stored < count && address < end)
+    {
+        hashes[stored++] = getPageHash(address);
+        address += PAGE_SIZE;
+    }
+
+    return stored;
+}
@@ -50,6 +50,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitMessageBus.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 #include "ErrorNo.h"
 
 /**
@@ -61,11 +62,29 @@ DEALINGS IN THE SOFTWARE.
 MicroBitMessageBus::MicroBitMessageBus()
 {
     this->listeners = NULL;
-    this->evt_queue_head = NULL;
-    this->evt_queue_tail = NULL;
+    this->listenerIndex = NULL;
+    this->listenerIndexSize = 0;
+    this->evt_queue_head = 0;
     this->queueLength = 0;
+    this->deletionsPending = 0;
+    this->batchPending = false;
 
-    fiber_add_idle_component(this);
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    this->priority_queue_head = 0;
+    this->priorityQueueLength = 0;
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+    this->irq_queue_head = 0;
+    this->irq_queue_tail = 0;
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    this->resetStatistics();
+#endif
+
+    // We only need servicing when we have queued events or listeners awaiting deletion.
+    fiber_add_idle_component(this, MICROBIT_IDLE_COMPONENT_ON_DEMAND);
 
     if(EventModel::defaultEventBus == NULL)
         EventModel::defaultEventBus = this;
@@ -90,7 +109,12 @@ void async_callback(void *param)
     {
         // Drop this event, if that's how we've been configured.
         if (listener->flags & MESSAGE_BUS_LISTENER_DROP_IF_BUSY)
+        {
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+            listener->dropped++;
+#endif
             return;
+        }
 
         // Queue this event up for later, if that's how we've been configured.
         if (listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY)
@@ -108,9 +132,14 @@ void async_callback(void *param)
 
     while (1)
     {
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        // n.b. this includes any time the handler spends blocked.
+        uint32_t start = (uint32_t) system_timer_current_time_us();
+#endif
+
         // Firstly, check for a method callback into an object.
         if (listener->flags & MESSAGE_BUS_LISTENER_METHOD)
-            listener->cb_method->fire(listener->evt);
+            listener->cb_method()->fire(listener->evt);
 
         // Now a parameterised C function
         else if (listener->flags & MESSAGE_BUS_LISTENER_PARAMETERISED)
@@ -120,15 +149,14 @@ void async_callback(void *param)
         else
             listener->cb(listener->evt);
 
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        listener->handler_time += (uint32_t) system_timer_current_time_us() - start;
+        listener->dispatched++;
+#endif
+
         // If there are more events to process, dequeue the next one and process it.
-        if ((listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && listener->evt_queue)
+        if ((listener->flags & MESSAGE_BUS_LISTENER_QUEUE_IF_BUSY) && listener->dequeue(listener->evt))
         {
-            MicroBitEventQueueItem *item = listener->evt_queue;
-
-            listener->evt = item->evt;
-            listener->evt_queue = listener->evt_queue->next;
-            delete item;
-
             // We spin the scheduler here, to preven any particular event handler from continuously holding onto resources.
             schedule();
         }
@@ -140,6 +168,129 @@ void async_callback(void *param)
     listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
 }
 
+/**
+  * Invokes the batch callback on a given MicroBitListener, until its queue is empty.
+  *
+  * Internal wrapper function, used to enable
+  * batched callbacks through the fiber scheduler.
+  */
+static void async_batch_callback(void *param)
+{
+    MicroBitListener *listener = (MicroBitListener *)param;
+    MicroBitEvent *batch;
+    int length;
+
+    // If a fiber is already active within this listener, it will pick up any new events before it exits.
+    if (listener->flags & MESSAGE_BUS_LISTENER_BUSY)
+        return;
+
+    listener->flags |= MESSAGE_BUS_LISTENER_BUSY;
+
+    while ((length = listener->peek(batch)) > 0)
+    {
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        uint32_t start = (uint32_t) system_timer_current_time_us();
+#endif
+
+        listener->cb_batch(batch, length);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        listener->handler_time += (uint32_t) system_timer_current_time_us() - start;
+        listener->dispatched += length;
+#endif
+
+        listener->discard(length);
+
+        // If more events have arrived in the meantime, give other fibers a chance to run before the next batch.
+        if (listener->peek(batch) > 0)
+            schedule();
+    }
+
+    listener->flags &= ~MESSAGE_BUS_LISTENER_BUSY;
+}
+
+/**
+  * Delivers the given event to the given listener, if it matches, and should be processed in the given pass.
+  *
+  * @param l The listener to consider.
+  *
+  * @param evt The event to deliver.
+  *
+  * @param urgent true if this is the urgent processing pass, false otherwise.
+  *
+  * @return 0 if the listener matches, but was not processed in this pass. 2 if the event was queued for batch delivery. 1 otherwise.
+  */
+static int process_listener(MicroBitListener *l, MicroBitEvent &evt, bool urgent)
+{
+    bool listenerUrgent;
+
+    if (!(l->value == evt.value || l->value == MICROBIT_EVT_ANY))
+        return 1;
+
+    // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
+    // metadata in the listener itself.
+    if (fiber_scheduler_running())
+        listenerUrgent = (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE;
+    else
+        listenerUrgent = true;
+
+    // If we should process this event hander in this pass, then activate the listener.
+    if(listenerUrgent != urgent || (l->flags & MESSAGE_BUS_LISTENER_DELETING))
+        return 0;
+
+    // Batch listeners simply accumulate events, which are delivered from idleTick().
+    // If there's no scheduler to call idleTick(), deliver them straight away.
+    if (l->flags & MESSAGE_BUS_LISTENER_BATCH)
+    {
+        l->queue(evt);
+
+        if (fiber_scheduler_running())
+            return 2;
+
+        async_batch_callback(l);
+        return 1;
+    }
+
+    l->evt = evt;
+
+    // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
+    // This is normally only done for trusted system components.
+    // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
+    // should the event handler attempt a blocking operation, but doesn't have the overhead
+    // of creating a fiber needlessly. (cool huh?)
+    if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
+        async_callback(l);
+    else
+        invoke(async_callback, l);
+
+    return 1;
+}
+
+/**
+  * Determines if the given listener permits the given event to be coalesced.
+  *
+  * @param l The listener to consider.
+  *
+  * @param evt The event to test.
+  *
+  * @param matched Incremented if the listener would process the event in the standard pass.
+  *
+  * @return 0 if the listener would process the event in the standard pass, and is not flagged MESSAGE_BUS_LISTENER_COALESCE. 1 otherwise.
+  */
+static int listener_coalesces(MicroBitListener *l, MicroBitEvent &evt, int &matched)
+{
+    if (!(l->value == evt.value || l->value == MICROBIT_EVT_ANY) || (l->flags & MESSAGE_BUS_LISTENER_DELETING))
+        return 1;
+
+    // Urgent listeners have already seen this event, before it was queued.
+    if (fiber_scheduler_running() && (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE)
+        return 1;
+
+    matched++;
+
+    return (l->flags & MESSAGE_BUS_LISTENER_COALESCE) ? 1 : 0;
+}
+
 /**
   * Queue the given event for processing at a later time.
   * Add the given event at the tail of our queue.
@@ -150,7 +301,21 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
 {
     int processingComplete;
 
-    MicroBitEventQueueItem *prev = evt_queue_tail;
+    // By default, events join the standard queue.
+    MicroBitEvent *queue = evt_queue;
+    uint16_t depth = MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH;
+    uint16_t *head = &evt_queue_head;
+    uint16_t *length = &queueLength;
+
+    uint16_t position = queueLength;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    uint16_t priorityPosition = priorityQueueLength;
+#endif
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    statSent++;
+#endif
 
     // Now process all handler regsitered as URGENT.
     // These pre-empt the queue, and are useful for fast, high priority services.
@@ -161,64 +326,201 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
     if (processingComplete)
         return;
 
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    // Input events join the priority queue instead, so that they overtake anything waiting in the standard queue.
+    // A given source and value always uses the same queue, so the order of related events is preserved.
+    if (isPriority(evt))
+    {
+        queue = priority_queue;
+        depth = MESSAGE_BUS_PRIORITY_QUEUE_DEPTH;
+        head = &priority_queue_head;
+        length = &priorityQueueLength;
+        position = priorityPosition;
+    }
+#endif
+
+    __disable_irq();
+
+    // If an identical event is already waiting, and all its listeners are happy for it to be coalesced,
+    // simply bring the waiting event up to date rather than queueing another.
+    for (uint16_t i = 0; i < *length; i++)
+    {
+        MicroBitEvent &e = queue[(*head + i) % depth];
+
+        if (e.source == evt.source && e.value == evt.value)
+        {
+            if (isCoalescing(evt))
+            {
+                e.timestamp = evt.timestamp;
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+                statCoalesced++;
+#endif
+                __enable_irq();
+                return;
+            }
+
+            break;
+        }
+    }
+
     // If we need to queue, but there is no space, then there's nothg we can do.
-    if (queueLength >= MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
+    if (*length >= depth)
+    {
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        statDropped++;
+#endif
+        __enable_irq();
         return;
+    }
 
     // Otherwise, we need to queue this event for later processing...
     // We queue this event at the tail of the queue at the point where we entered queueEvent()
     // This is important as the processing above *may* have generated further events, and
-    // we want to maintain ordering of events.
-    MicroBitEventQueueItem *item = new MicroBitEventQueueItem(evt);
+    // we want to maintain ordering of events. Any such events are shuffled up one place in the ring.
+    if (position > *length)
+        position = *length;
+
+    for (uint16_t i = *length; i > position; i--)
+        queue[(*head + i) % depth] = queue[(*head + i - 1) % depth];
+
+    queue[(*head + position) % depth] = evt;
+    (*length)++;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+    statQueued++;
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    if (queue == priority_queue)
+        statPrioritised++;
+
+    if (queueLength + priorityQueueLength > statPeakQueueLength)
+        statPeakQueueLength = queueLength + priorityQueueLength;
+#else
+    if (queueLength > statPeakQueueLength)
+        statPeakQueueLength = queueLength;
+#endif
+#endif
+
+    __enable_irq();
 
-    // The queue was empty when we entered this function, so queue our event at the start of the queue.
+    fiber_idle_component_pending(this);
+}
+
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+/**
+  * Records an event raised in interrupt context, to be delivered once the bus is next serviced in thread context.
+  *
+  * @param evt The event to record.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the ring is full and the event was dropped.
+  */
+int MicroBitMessageBus::queueEventFromIRQ(MicroBitEvent &evt)
+{
+    // Interrupts of different priorities may post concurrently, and the Cortex-M0 has no exclusive access
+    // instructions, so claim the slot and fill it with interrupts briefly masked. The consumer only runs in
+    // thread context, so it can never observe a partially written slot.
+    uint32_t primask = __get_PRIMASK();
     __disable_irq();
 
-    if (prev == NULL)
-    {
-        item->next = evt_queue_head;
-        evt_queue_head = item;
-    }
-    else
+    uint8_t next = (irq_queue_head + 1) % MESSAGE_BUS_IRQ_QUEUE_DEPTH;
+
+    if (next == irq_queue_tail)
     {
-        item->next = prev->next;
-        prev->next = item;
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+        statDropped++;
+#endif
+        __set_PRIMASK(primask);
+        return MICROBIT_NO_RESOURCES;
     }
 
-    if (item->next == NULL)
-        evt_queue_tail = item;
+    irq_queue[irq_queue_head] = evt;
+    irq_queue_head = next;
 
-    queueLength++;
+    __set_PRIMASK(primask);
 
-    __enable_irq();
+    fiber_idle_component_pending(this);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Passes any events raised in interrupt context on to the event queue, in the order they were raised,
+  * running their urgent listeners as it does so.
+  */
+void MicroBitMessageBus::drainIRQEvents()
+{
+    while (irq_queue_tail != irq_queue_head)
+    {
+        MicroBitEvent evt = irq_queue[irq_queue_tail];
+        irq_queue_tail = (irq_queue_tail + 1) % MESSAGE_BUS_IRQ_QUEUE_DEPTH;
+
+        this->queueEvent(evt);
+    }
 }
+#endif
 
 /**
   * Extract the next event from the front of the event queue (if present).
+  * Events waiting in the priority queue are always extracted first.
+  *
+  * @param evt Updated with the event at the front of the queue.
   *
-  * @return a pointer to the MicroBitEventQueueItem that is at the head of the list.
+  * @return 1 if an event was extracted, 0 if the queue is empty.
   */
-MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvent()
+int MicroBitMessageBus::dequeueEvent(MicroBitEvent &evt)
 {
-    MicroBitEventQueueItem *item = NULL;
+    int dequeued = 0;
 
     __disable_irq();
 
-    if (evt_queue_head != NULL)
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    if (priorityQueueLength > 0)
     {
-        item = evt_queue_head;
-        evt_queue_head = item->next;
+        evt = priority_queue[priority_queue_head];
+        priority_queue_head = (priority_queue_head + 1) % MESSAGE_BUS_PRIORITY_QUEUE_DEPTH;
+        priorityQueueLength--;
 
-        if (evt_queue_head == NULL)
-            evt_queue_tail = NULL;
+        __enable_irq();
+        return 1;
+    }
+#endif
 
+    if (queueLength > 0)
+    {
+        evt = evt_queue[evt_queue_head];
+        evt_queue_head = (evt_queue_head + 1) % MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH;
         queueLength--;
+        dequeued = 1;
     }
 
     __enable_irq();
 
+    return dequeued;
+}
 
-    return item;
+/**
+  * Delivers the events waiting for each MESSAGE_BUS_LISTENER_BATCH listener, in a single call per listener.
+  */
+void MicroBitMessageBus::deliverBatches()
+{
+    MicroBitEvent *batch;
+
+    batchPending = false;
+
+    for (MicroBitListener *l = listeners; l != NULL; l = l->next)
+    {
+        // Busy listeners drain their own queue before they exit.
+        if (!(l->flags & MESSAGE_BUS_LISTENER_BATCH) || (l->flags & (MESSAGE_BUS_LISTENER_BUSY | MESSAGE_BUS_LISTENER_DELETING)))
+            continue;
+
+        if (l->peek(batch) == 0)
+            continue;
+
+        if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING)
+            async_batch_callback(l);
+        else
+            invoke(async_batch_callback, l);
+    }
 }
 
 /**
@@ -230,12 +532,40 @@ int MicroBitMessageBus::deleteMarkedListeners()
 {
     MicroBitListener *l, *p;
     int removed = 0;
+    int outstanding = deletionsPending;
+
+    // Only walk the list if there's something to reclaim.
+    if (outstanding == 0)
+        return 0;
 
     l = listeners;
     p = NULL;
 
+    // Walk this list of event handlers once to determine if there's anything to do.
+    // The index may refer to listeners we're about to delete, so is discarded before we start.
+    while (l != NULL && !((l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY)))
+        l = l->next;
+
+    if (l == NULL)
+    {
+        // All the listeners marked for deletion are still running, so ensure we try again later.
+        fiber_idle_component_pending(this);
+        return 0;
+    }
+
+    __disable_irq();
+    MicroBitListener **index = listenerIndex;
+    listenerIndex = NULL;
+    listenerIndexSize = 0;
+    __enable_irq();
+
+    free(index);
+
+    l = listeners;
+
     // Walk this list of event handlers. Delete any that match the given listener.
-    while (l != NULL)
+    // We can stop as soon as we've seen every listener marked for deletion.
+    while (l != NULL && outstanding > 0)
     {
         if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY))
         {
@@ -250,48 +580,248 @@ int MicroBitMessageBus::deleteMarkedListeners()
 
             delete t;
             removed++;
+            outstanding--;
+            deletionsPending--;
 
             continue;
         }
 
+        // Listeners that are still running can't be deleted yet, so ensure we try again later.
+        if (l->flags & MESSAGE_BUS_LISTENER_DELETING)
+        {
+            fiber_idle_component_pending(this);
+            outstanding--;
+        }
+
         p = l;
         l = l->next;
     }
 
+    rebuildListenerIndex();
+
     return removed;
 }
 
+/**
+  * Determines if the given event may be coalesced with an identical event already waiting in the queue.
+  *
+  * @param evt The event to test.
+  *
+  * @return 1 if every listener that would process the event in the standard pass is flagged
+  *         MESSAGE_BUS_LISTENER_COALESCE, 0 otherwise.
+  */
+int MicroBitMessageBus::isCoalescing(MicroBitEvent &evt)
+{
+    MicroBitListener *l;
+    int matched = 0;
+
+    // Wildcard listeners are always held at the head of the chain, followed later by the run of listeners for this source.
+    for (l = listeners; l != NULL && l->id == MICROBIT_ID_ANY; l = l->next)
+        if (!listener_coalesces(l, evt, matched))
+            return 0;
+
+    if (evt.source != MICROBIT_ID_ANY)
+        for (l = findListeners(evt.source); l != NULL && l->id == evt.source; l = l->next)
+            if (!listener_coalesces(l, evt, matched))
+                return 0;
+
+    return matched > 0;
+}
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+/**
+  * Determines if the given listener asks for the given event to be held in the priority queue.
+  *
+  * @param l The listener to consider.
+  *
+  * @param evt The event to test.
+  *
+  * @return 1 if the listener would process the event in the standard pass, and is flagged MESSAGE_BUS_LISTENER_PRIORITY. 0 otherwise.
+  */
+static int listener_prioritises(MicroBitListener *l, MicroBitEvent &evt)
+{
+    if (!(l->value == evt.value || l->value == MICROBIT_EVT_ANY) || (l->flags & MESSAGE_BUS_LISTENER_DELETING))
+        return 0;
+
+    return (l->flags & MESSAGE_BUS_LISTENER_PRIORITY) ? 1 : 0;
+}
+
+/**
+  * Determines if the given event should be held in the priority queue.
+  *
+  * @param evt The event to test.
+  *
+  * @return 1 if the event was raised by a button, the radio or the serial port, or if a listener that would
+  *         process it in the standard pass is flagged MESSAGE_BUS_LISTENER_PRIORITY. 0 otherwise.
+  */
+int MicroBitMessageBus::isPriority(MicroBitEvent &evt)
+{
+    MicroBitListener *l;
+
+    switch (evt.source)
+    {
+        case MICROBIT_ID_BUTTON_A:
+        case MICROBIT_ID_BUTTON_B:
+        case MICROBIT_ID_BUTTON_AB:
+        case MICROBIT_ID_RADIO:
+        case MICROBIT_ID_SERIAL:
+            return 1;
+    }
+
+    for (l = listeners; l != NULL && l->id == MICROBIT_ID_ANY; l = l->next)
+        if (listener_prioritises(l, evt))
+            return 1;
+
+    if (evt.source != MICROBIT_ID_ANY)
+        for (l = findListeners(evt.source); l != NULL && l->id == evt.source; l = l->next)
+            if (listener_prioritises(l, evt))
+                return 1;
+
+    return 0;
+}
+#endif
+
+/**
+  * Rebuilds the index used to locate the listeners for a given ID, following a change to the chain of listeners.
+  *
+  * If memory cannot be allocated for the index, process() falls back to walking the chain.
+  */
+void MicroBitMessageBus::rebuildListenerIndex()
+{
+    MicroBitListener *l;
+    MicroBitListener **index = NULL;
+    int count = 0;
+    uint16_t last = MICROBIT_ID_ANY;
+
+    // Count the distinct IDs in the chain. As the chain is sorted by ID, this is just the number of times the ID changes.
+    // Wildcard listeners are always held at the head of the chain, so are not indexed.
+
+    for (l = listeners; l != NULL; l = l->next)
+    {
+        if (l->id != last)
+        {
+            count++;
+            last = l->id;
+        }
+    }
+
+    if (count > 0)
+    {
+        index = (MicroBitListener **) malloc(count * sizeof(MicroBitListener *));
+
+        if (index != NULL)
+        {
+            int i = 0;
+            last = MICROBIT_ID_ANY;
+
+            for (l = listeners; l != NULL; l = l->next)
+            {
+                if (l->id != last)
+                {
+                    index[i++] = l;
+                    last = l->id;
+                }
+            }
+        }
+    }
+
+    // Swap in the new index atomically, as events may be processed in interrupt context.
+    __disable_irq();
+    MicroBitListener **old = listenerIndex;
+    listenerIndex = index;
+    listenerIndexSize = index ? count : 0;
+    __enable_irq();
+
+    free(old);
+}
+
+/**
+  * Locates the first listener in the chain registered for the given ID.
+  *
+  * @param id The ID to search for. Must not be MICROBIT_ID_ANY.
+  *
+  * @return The first listener registered for the ID, or NULL if there are none.
+  */
+MicroBitListener *MicroBitMessageBus::findListeners(uint16_t id)
+{
+    MicroBitListener *l;
+
+    // If we have no index (e.g. we ran out of memory), walk the chain.
+    if (listenerIndex == NULL)
+    {
+        l = listeners;
+
+        while (l != NULL && l->id < id)
+            l = l->next;
+
+        return (l != NULL && l->id == id) ? l : NULL;
+    }
+
+    // Otherwise, perform a binary search of the index.
+    int low = 0;
+    int high = listenerIndexSize - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        l = listenerIndex[mid];
+
+        if (l->id == id)
+            return l;
+
+        if (l->id < id)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NULL;
+}
+
 /**
   * Periodic callback from MicroBit.
   *
   * Process at least one event from the event queue, if it is not empty.
   * We then continue processing events until something appears on the runqueue.
+  * Events in the priority queue are processed first, including any that arrive whilst we are running.
   */
 void MicroBitMessageBus::idleTick()
 {
     // Clear out any listeners marked for deletion
     this->deleteMarkedListeners();
 
-    MicroBitEventQueueItem *item = this->dequeueEvent();
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+    // Pick up anything raised in interrupt context since we were last serviced, running its urgent listeners now.
+    this->drainIRQEvents();
+#endif
+
+    MicroBitEvent evt;
 
     // Whilst there are events to process and we have no useful other work to do, pull them off the queue and process them.
-    while (item)
+    while (this->dequeueEvent(evt))
     {
         // send the event to all standard event listeners.
-        this->process(item->evt);
-
-        // Free the queue item.
-        delete item;
+        this->process(evt);
 
         // If we have created some useful work to do, we stop processing.
         // This helps to minimise the number of blocked fibers we create at any point in time, therefore
         // also reducing the RAM footprint.
         if(!scheduler_runqueue_empty())
             break;
-
-        // Pull the next event to process, if there is one.
-        item = this->dequeueEvent();
     }
+
+    // Hand any events accumulated by batch listeners over in one go.
+    if (batchPending)
+        this->deliverBatches();
+
+    // If we stopped early, ensure we're called again to process the remainder of the queue.
+    if (queueLength > 0)
+        fiber_idle_component_pending(this);
+
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    if (priorityQueueLength > 0)
+        fiber_idle_component_pending(this);
+#endif
 }
 
 /**
@@ -319,6 +849,15 @@ int MicroBitMessageBus::send(MicroBitEvent evt)
     // We simply queue processing of the event until we're scheduled in normal thread context.
     // We do this to avoid the possibility of executing event handler code in IRQ context, which may bring
     // hidden race conditions to kids code. Queuing all events ensures causal ordering (total ordering in fact).
+#if CONFIG_ENABLED(MESSAGE_BUS_DEFERRED_IRQ_EVENTS)
+    // In interrupt context, just record the event and get out. Urgent listeners run when the bus is next serviced.
+    if (inInterruptContext() && fiber_scheduler_running())
+        return this->queueEventFromIRQ(evt);
+
+    // Anything raised earlier in interrupt context goes ahead of this event.
+    this->drainIRQEvents();
+#endif
+
     this->queueEvent(evt);
     return MICROBIT_OK;
 }
@@ -341,44 +880,36 @@ int MicroBitMessageBus::process(MicroBitEvent &evt, bool urgent)
 {
     MicroBitListener *l;
     int complete = 1;
-    bool listenerUrgent;
+    int result;
 
-    l = listeners;
-    while (l != NULL)
+    // Wildcard listeners are always held at the head of the chain, as MICROBIT_ID_ANY is zero.
+    for (l = listeners; l != NULL && l->id == MICROBIT_ID_ANY; l = l->next)
     {
-        if((l->id == evt.source || l->id == MICROBIT_ID_ANY) && (l->value == evt.value || l->value == MICROBIT_EVT_ANY))
-        {
-            // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
-            // metadata in the listener itself.
-            if (fiber_scheduler_running())
-                listenerUrgent = (l->flags & MESSAGE_BUS_LISTENER_IMMEDIATE) == MESSAGE_BUS_LISTENER_IMMEDIATE;
-            else
-                listenerUrgent = true;
+        result = process_listener(l, evt, urgent);
 
-            // If we should process this event hander in this pass, then activate the listener.
-            if(listenerUrgent == urgent && !(l->flags & MESSAGE_BUS_LISTENER_DELETING))
-            {
-                l->evt = evt;
-
-                // OK, if this handler has regisitered itself as non-blocking, we just execute it directly...
-                // This is normally only done for trusted system components.
-                // Otherwise, we invoke it in a 'fork on block' context, that will automatically create a fiber
-                // should the event handler attempt a blocking operation, but doesn't have the overhead
-                // of creating a fiber needlessly. (cool huh?)
-                if (l->flags & MESSAGE_BUS_LISTENER_NONBLOCKING || !fiber_scheduler_running())
-                    async_callback(l);
-                else
-                    invoke(async_callback, l);
-            }
-            else
-            {
-                complete = 0;
-            }
-        }
+        if (result == 0)
+            complete = 0;
 
-        l = l->next;
+        if (result == 2)
+            batchPending = true;
     }
 
+    // Then locate the (contiguous) run of listeners for the source of this event.
+    for (l = (evt.source == MICROBIT_ID_ANY) ? NULL : findListeners(evt.source); l != NULL && l->id == evt.source; l = l->next)
+    {
+        result = process_listener(l, evt, urgent);
+
+        if (result == 0)
+            complete = 0;
+
+        if (result == 2)
+            batchPending = true;
+    }
+
+    // Ensure we're scheduled to deliver any batches, even if this event was processed outside of idleTick().
+    if (batchPending)
+        fiber_idle_component_pending(this);
+
     return complete;
 }
 
@@ -409,13 +940,16 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
     {
         methodCallback = (newListener->flags & MESSAGE_BUS_LISTENER_METHOD) && (l->flags & MESSAGE_BUS_LISTENER_METHOD);
 
-        if (l->id == newListener->id && l->value == newListener->value && (methodCallback ? *l->cb_method == *newListener->cb_method : l->cb == newListener->cb) && newListener->cb_arg == l->cb_arg)
+        if (l->id == newListener->id && l->value == newListener->value && (methodCallback ? *l->cb_method() == *newListener->cb_method() : l->cb == newListener->cb) && newListener->cb_arg == l->cb_arg)
         {
             // We have a perfect match for this event listener already registered.
             // If it's marked for deletion, we simply resurrect the listener, and we're done.
             // Either way, we return an error code, as the *new* listener should be released...
             if(l->flags & MESSAGE_BUS_LISTENER_DELETING)
+            {
                 l->flags &= ~MESSAGE_BUS_LISTENER_DELETING;
+                deletionsPending--;
+            }
 
             return MICROBIT_NOT_SUPPORTED;
         }
@@ -428,6 +962,7 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
     if (listeners == NULL)
     {
         listeners = newListener;
+        rebuildListenerIndex();
         MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
 
         return MICROBIT_OK;
@@ -469,6 +1004,8 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
         p->next = newListener;
     }
 
+    rebuildListenerIndex();
+
     MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
     return MICROBIT_OK;
 }
@@ -489,14 +1026,15 @@ int MicroBitMessageBus::remove(MicroBitListener *listener)
     if (listener == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    l = listeners;
+    // If we're looking for a specific ID, we need only consider the (contiguous) run of listeners for that ID.
+    l = (listener->id == MICROBIT_ID_ANY) ? listeners : findListeners(listener->id);
 
     // Walk this list of event handlers. Delete any that match the given listener.
-    while (l != NULL)
+    while (l != NULL && (listener->id == MICROBIT_ID_ANY || l->id == listener->id))
     {
         if ((listener->flags & MESSAGE_BUS_LISTENER_METHOD) == (l->flags & MESSAGE_BUS_LISTENER_METHOD))
         {
-            if(((listener->flags & MESSAGE_BUS_LISTENER_METHOD) && (*l->cb_method == *listener->cb_method)) ||
+            if(((listener->flags & MESSAGE_BUS_LISTENER_METHOD) && (*l->cb_method() == *listener->cb_method())) ||
               ((!(listener->flags & MESSAGE_BUS_LISTENER_METHOD) && l->cb == listener->cb)))
             {
                 if ((listener->id == MICROBIT_ID_ANY || listener->id == l->id) && (listener->value == MICROBIT_EVT_ANY || listener->value == l->value) && (listener->cb_arg == l->cb_arg || listener->cb_arg == NULL))
@@ -506,7 +1044,13 @@ int MicroBitMessageBus::remove(MicroBitListener *listener)
                         listener_deletion_callback(l);
 
                     // Found a match. mark this to be removed from the list.
-                    l->flags |= MESSAGE_BUS_LISTENER_DELETING;
+                    if (!(l->flags & MESSAGE_BUS_LISTENER_DELETING))
+                    {
+                        l->flags |= MESSAGE_BUS_LISTENER_DELETING;
+                        deletionsPending++;
+                    }
+
+                    fiber_idle_component_pending(this);
                     removed++;
                 }
             }
@@ -544,10 +1088,90 @@ MicroBitListener* MicroBitMessageBus::elementAt(int n)
     return l;
 }
 
+/**
+  * Determines if any listener would receive events raised with the given ID and value, so that components can
+  * avoid the cost of generating events that nobody is waiting for.
+  *
+  * @param id The ID to test.
+  *
+  * @param value The event value to test. Defaults to MICROBIT_EVT_ANY, which matches listeners for any value.
+  *
+  * @return true if a listener is registered for the ID and value, or for MICROBIT_ID_ANY. false otherwise.
+  */
+bool MicroBitMessageBus::isListening(uint16_t id, uint16_t value)
+{
+    // Listeners for MICROBIT_ID_ANY are held at the front of the chain.
+    for (MicroBitListener *l = listeners; l != NULL && l->id == MICROBIT_ID_ANY; l = l->next)
+        if (!(l->flags & MESSAGE_BUS_LISTENER_DELETING) && (l->value == value || l->value == MICROBIT_EVT_ANY || value == MICROBIT_EVT_ANY))
+            return true;
+
+    if (id == MICROBIT_ID_ANY)
+        return false;
+
+    for (MicroBitListener *l = findListeners(id); l != NULL && l->id == id; l = l->next)
+        if (!(l->flags & MESSAGE_BUS_LISTENER_DELETING) && (l->value == value || l->value == MICROBIT_EVT_ANY || value == MICROBIT_EVT_ANY))
+            return true;
+
+    return false;
+}
+
+#if CONFIG_ENABLED(MESSAGE_BUS_STATISTICS)
+/**
+  * Provides a snapshot of the statistics recorded by this message bus.
+  *
+  * @param stats Updated with the statistics recorded since creation, or the last call to resetStatistics().
+  *
+  * @note Per listener statistics (including the time spent in each handler) are held in the MicroBitListener
+  *       itself, and are available through elementAt(). The listener totals only include current listeners.
+  */
+void MicroBitMessageBus::getStatistics(MicroBitMessageBusStatistics &stats)
+{
+    __disable_irq();
+    stats.sent = statSent;
+    stats.queued = statQueued;
+    stats.coalesced = statCoalesced;
+    stats.dropped = statDropped;
+    stats.prioritised = statPrioritised;
+    stats.peakQueueLength = statPeakQueueLength;
+    __enable_irq();
+
+    stats.dispatched = 0;
+    stats.listenerDropped = 0;
+
+    for (MicroBitListener *l = listeners; l != NULL; l = l->next)
+    {
+        stats.dispatched += l->dispatched;
+        stats.listenerDropped += l->dropped;
+    }
+}
+
+/**
+  * Resets the statistics recorded by this message bus, and by each of its listeners.
+  */
+void MicroBitMessageBus::resetStatistics()
+{
+    __disable_irq();
+    statSent = 0;
+    statQueued = 0;
+    statCoalesced = 0;
+    statDropped = 0;
+    statPrioritised = 0;
+    statPeakQueueLength = queueLength;
+#if CONFIG_ENABLED(MESSAGE_BUS_PRIORITY_LANE)
+    statPeakQueueLength += priorityQueueLength;
+#endif
+    __enable_irq();
+
+    for (MicroBitListener *l = listeners; l != NULL; l = l->next)
+        l->resetStatistics();
+}
+#endif
+
 /**
   * Destructor for MicroBitMessageBus, where we deregister this instance from the array of fiber components.
   */
 MicroBitMessageBus::~MicroBitMessageBus()
 {
     fiber_remove_idle_component(this);
+    free(listenerIndex);
 }
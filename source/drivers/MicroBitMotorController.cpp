@@ -0,0 +1,337 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitMotorController.
+  *
+  * Drives a DC motor to a position or velocity setpoint, using feedback from a quadrature encoder.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitMotorController.h"
+#include "MicroBitEvent.h"
+#include "ErrorNo.h"
+
+// The time the output may be saturated without any movement, before the motor is considered stalled.
+#define MICROBIT_MOTOR_STALL_US                 1000000
+
+/**
+  * Constructor.
+  *
+  * Create a motor controller, which is stopped until start() is called.
+  *
+  * @param decoder the decoder reading the motor's encoder.
+  *
+  * @param forward the pin driving the motor forward.
+  *
+  * @param reverse the pin driving the motor in reverse.
+  *
+  * @param id the ID of the new MicroBitMotorController object. Defaults to MICROBIT_ID_MOTOR_CONTROLLER.
+  *
+  * @code
+  * MicroBitQuadratureDecoder qdec(uBit.io.P0, uBit.io.P1, QDEC_USE_INTERRUPT);
+  * MicroBitMotorController motor(qdec, uBit.io.P13, uBit.io.P14);
+  * @endcode
+  */
+MicroBitMotorController::MicroBitMotorController(MicroBitQuadratureDecoder &decoder, MicroBitPin &forward, MicroBitPin &reverse, uint16_t id)
+    : decoder(decoder), forward(forward), reverse(reverse)
+{
+    this->id = id;
+    this->status = 0;
+    this->period = MICROBIT_MOTOR_DEFAULT_PERIOD_US;
+    this->kp = 1 << MICROBIT_MOTOR_GAIN_SHIFT;
+    this->ki = 0;
+    this->kd = 0;
+    this->tolerance = MICROBIT_MOTOR_DEFAULT_TOLERANCE;
+    this->target = 0;
+    this->velocity = 0;
+    this->remainder = 0;
+    this->integral = 0;
+    this->lastError = 0;
+    this->output = 0;
+    this->lastPosition = 0;
+    this->stallTime = 0;
+    this->reached = true;
+}
+
+/**
+  * Sets the gains of the PID loop. Each is a fixed point value with MICROBIT_MOTOR_GAIN_SHIFT fractional bits,
+  * so 256 is a gain of 1, and the output is in the range of MicroBitPin::setAnalogValue().
+  *
+  * @param kp the proportional gain, per count of error.
+  *
+  * @param ki the integral gain, per count of error per loop period.
+  *
+  * @param kd the derivative gain, per count of change in error per loop period.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if any gain is negative.
+  */
+int MicroBitMotorController::setGains(int32_t kp, int32_t ki, int32_t kd)
+{
+    if (kp < 0 || ki < 0 || kd < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+    this->kp = kp;
+    this->ki = ki;
+    this->kd = kd;
+    this->integral = 0;
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sets the period of the control loop. This takes effect from the next iteration.
+  *
+  * @param period the period, in microseconds.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if period is less than MICROBIT_MOTOR_MIN_PERIOD_US.
+  */
+int MicroBitMotorController::setPeriodUs(uint32_t period)
+{
+    if (period < MICROBIT_MOTOR_MIN_PERIOD_US)
+        return MICROBIT_INVALID_PARAMETER;
+
+    this->period = period;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sets the position error within which the setpoint is considered reached.
+  *
+  * @param counts the tolerance, in encoder counts.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if counts is negative.
+  */
+int MicroBitMotorController::setTolerance(int32_t counts)
+{
+    if (counts < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    this->tolerance = counts;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Moves the motor to the given position, and holds it there.
+  * MICROBIT_MOTOR_EVT_SETPOINT_REACHED is raised when it first arrives.
+  *
+  * @param position the position, in encoder counts.
+  */
+void MicroBitMotorController::setPosition(int64_t position)
+{
+    __disable_irq();
+    target = position;
+    velocity = 0;
+    remainder = 0;
+    reached = false;
+    __enable_irq();
+}
+
+/**
+  * Turns the motor at the given speed, by moving the position setpoint steadily.
+  *
+  * @param velocity the speed, in encoder counts per second. Use 0 to hold the current setpoint.
+  */
+void MicroBitMotorController::setVelocity(int32_t velocity)
+{
+    __disable_irq();
+    this->velocity = velocity;
+    this->remainder = 0;
+    this->reached = true;
+    __enable_irq();
+}
+
+/**
+  * Determines the position setpoint.
+  *
+  * @return the setpoint, in encoder counts.
+  */
+int64_t MicroBitMotorController::getTarget()
+{
+    __disable_irq();
+    int64_t t = target;
+    __enable_irq();
+
+    return t;
+}
+
+/**
+  * Determines the level the motor is being driven at.
+  *
+  * @return the level, from -MICROBIT_PIN_MAX_OUTPUT to MICROBIT_PIN_MAX_OUTPUT, negative in reverse.
+  */
+int MicroBitMotorController::getOutput()
+{
+    return output;
+}
+
+/**
+  * Drives the bridge at the given level.
+  *
+  * @param level the output, from -MICROBIT_PIN_MAX_OUTPUT to MICROBIT_PIN_MAX_OUTPUT.
+  */
+void MicroBitMotorController::drive(int32_t level)
+{
+    output = level;
+
+    if (level >= 0)
+    {
+        reverse.setAnalogValue(0);
+        forward.setAnalogValue(level);
+    }
+    else
+    {
+        forward.setAnalogValue(0);
+        reverse.setAnalogValue(-level);
+    }
+}
+
+/**
+  * Runs one iteration of the control loop, and schedules the next.
+  */
+void MicroBitMotorController::update()
+{
+    // Schedule the next iteration first, so the rate doesn't depend on the time taken here.
+    system_timer_event_after_us(&loopEvent, period, system_timer_method_callback<MicroBitMotorController, &MicroBitMotorController::update>, this);
+
+    decoder.poll();
+    int64_t position = decoder.getPosition();
+
+    // Advance the setpoint for velocity control, carrying the fraction of a count over to the next iteration.
+    if (velocity != 0)
+    {
+        int64_t step = (int64_t)velocity * period + remainder;
+        target += step / 1000000;
+        remainder = step % 1000000;
+    }
+
+    int64_t e = target - position;
+    int32_t error = e > INT32_MAX / 2 ? INT32_MAX / 2 : e < -INT32_MAX / 2 ? -INT32_MAX / 2 : (int32_t)e;
+
+    int64_t p = (int64_t)kp * error;
+    int64_t d = (int64_t)kd * (error - lastError);
+    int64_t limit = (int64_t)MICROBIT_PIN_MAX_OUTPUT << MICROBIT_MOTOR_GAIN_SHIFT;
+
+    // Only integrate while the output isn't saturated, so the integral can't wind up beyond what it can drive.
+    if (output > -MICROBIT_PIN_MAX_OUTPUT && output < MICROBIT_PIN_MAX_OUTPUT)
+        integral += (int64_t)ki * error;
+
+    if (integral > limit)
+        integral = limit;
+    if (integral < -limit)
+        integral = -limit;
+
+    int64_t level = (p + integral + d) >> MICROBIT_MOTOR_GAIN_SHIFT;
+
+    if (level > MICROBIT_PIN_MAX_OUTPUT)
+        level = MICROBIT_PIN_MAX_OUTPUT;
+    if (level < -MICROBIT_PIN_MAX_OUTPUT)
+        level = -MICROBIT_PIN_MAX_OUTPUT;
+
+    lastError = error;
+    drive((int32_t)level);
+
+    if (!reached && error <= tolerance && error >= -tolerance)
+    {
+        reached = true;
+        MicroBitEvent(id, MICROBIT_MOTOR_EVT_SETPOINT_REACHED);
+    }
+
+    if ((level == MICROBIT_PIN_MAX_OUTPUT || level == -MICROBIT_PIN_MAX_OUTPUT) && position == lastPosition)
+    {
+        if (stallTime < MICROBIT_MOTOR_STALL_US)
+        {
+            stallTime += period;
+            if (stallTime >= MICROBIT_MOTOR_STALL_US)
+                MicroBitEvent(id, MICROBIT_MOTOR_EVT_STALLED);
+        }
+    }
+    else
+    {
+        stallTime = 0;
+    }
+
+    lastPosition = position;
+}
+
+/**
+  * Starts the control loop, holding the motor at its current position.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_BUSY if already running, or MICROBIT_NOT_SUPPORTED if either pin
+  *         has no analog output.
+  */
+int MicroBitMotorController::start()
+{
+    if (status & MICROBIT_COMPONENT_RUNNING)
+        return MICROBIT_BUSY;
+
+    // Allocate both PWM channels here, rather than from the control loop.
+    if (forward.setAnalogValue(0) != MICROBIT_OK || reverse.setAnalogValue(0) != MICROBIT_OK)
+        return MICROBIT_NOT_SUPPORTED;
+
+    decoder.poll();
+
+    target = lastPosition = decoder.getPosition();
+    velocity = 0;
+    remainder = 0;
+    integral = 0;
+    lastError = 0;
+    output = 0;
+    stallTime = 0;
+    reached = true;
+
+    status |= MICROBIT_COMPONENT_RUNNING;
+
+    system_timer_event_after_us(&loopEvent, period, system_timer_method_callback<MicroBitMotorController, &MicroBitMotorController::update>, this);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops the control loop, and stops driving the motor.
+  */
+void MicroBitMotorController::stop()
+{
+    if (!(status & MICROBIT_COMPONENT_RUNNING))
+        return;
+
+    system_timer_cancel_event(&loopEvent);
+    drive(0);
+
+    status &= ~MICROBIT_COMPONENT_RUNNING;
+}
+
+/**
+  * Destructor for MicroBitMotorController.
+  *
+  * Ensures that stop() gets called if necessary.
+  */
+MicroBitMotorController::~MicroBitMotorController()
+{
+    stop();
+}
@@ -28,14 +28,24 @@ DEALINGS IN THE SOFTWARE.
   *
   * Commonly represents an I/O pin on the edge connector.
   */
+#include <new>
 #include "MicroBitConfig.h"
 #include "MicroBitPin.h"
 #include "MicroBitButton.h"
 #include "MicroBitSystemTimer.h"
 #include "TimedInterruptIn.h"
+#include "PulseCaptureIn.h"
 #include "DynamicPwm.h"
+#include "SoftPwmOut.h"
 #include "ErrorNo.h"
 
+// The driver behind analog outputs. Both provide the same interface.
+#if CONFIG_ENABLED(MICROBIT_PIN_SOFT_PWM)
+typedef SoftPwmOut PwmChannel;
+#else
+typedef DynamicPwm PwmChannel;
+#endif
+
 /**
   * Constructor.
   * Create a MicroBitPin instance, generally used to represent a pin on the edge connector.
@@ -75,19 +85,20 @@ void MicroBitPin::disconnect()
 {
     // This is a bit ugly, but rarely used code.
     // It would be much better to use some polymorphism here, but the mBed I/O classes aren't arranged in an inheritance hierarchy... yet. :-)
+    // Digital and analog inputs and outputs live in our own storage, so are destroyed without being freed.
     if (status & IO_STATUS_DIGITAL_IN)
-        delete ((DigitalIn *)pin);
+        ((DigitalIn *)pin)->~DigitalIn();
 
     if (status & IO_STATUS_DIGITAL_OUT)
-        delete ((DigitalOut *)pin);
+        ((DigitalOut *)pin)->~DigitalOut();
 
     if (status & IO_STATUS_ANALOG_IN){
         NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled; // forcibly disable the ADC - BUG in mbed....
-        delete ((AnalogIn *)pin);
+        ((AnalogIn *)pin)->~AnalogIn();
     }
 
     if (status & IO_STATUS_ANALOG_OUT)
-        delete ((DynamicPwm *)pin);
+        delete ((PwmChannel *)pin);
 
     if (status & IO_STATUS_TOUCH_IN)
         delete ((MicroBitButton *)pin);
@@ -95,6 +106,9 @@ void MicroBitPin::disconnect()
     if ((status & IO_STATUS_EVENT_ON_EDGE) || (status & IO_STATUS_EVENT_PULSE_ON_EDGE))
         delete ((TimedInterruptIn *)pin);
 
+    if (status & IO_STATUS_EVENT_PULSE_CAPTURE)
+        delete ((PulseCaptureIn *)pin);
+
     this->pin = NULL;
     this->status = 0;
 }
@@ -125,7 +139,7 @@ int MicroBitPin::setDigitalValue(int value)
     // Move into a Digital input state if necessary.
     if (!(status & IO_STATUS_DIGITAL_OUT)){
         disconnect();
-        pin = new DigitalOut(name);
+        pin = new (&storage) DigitalOut(name);
         status |= IO_STATUS_DIGITAL_OUT;
     }
 
@@ -154,16 +168,19 @@ int MicroBitPin::getDigitalValue()
         return MICROBIT_NOT_SUPPORTED;
 
     // Move into a Digital input state if necessary.
-    if (!(status & (IO_STATUS_DIGITAL_IN | IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE)))
+    if (!(status & (IO_STATUS_DIGITAL_IN | IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE | IO_STATUS_EVENT_PULSE_CAPTURE)))
     {
         disconnect();
-        pin = new DigitalIn(name, (PinMode)pullMode);
+        pin = new (&storage) DigitalIn(name, (PinMode)pullMode);
         status |= IO_STATUS_DIGITAL_IN;
     }
 
     if(status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE))
         return ((TimedInterruptIn *)pin)->read();
 
+    if(status & IO_STATUS_EVENT_PULSE_CAPTURE)
+        return ((PulseCaptureIn *)pin)->read();
+
     return ((DigitalIn *)pin)->read();
 }
 
@@ -189,9 +206,9 @@ int MicroBitPin::getDigitalValue(PinMode pull)
 int MicroBitPin::obtainAnalogChannel()
 {
     // Move into an analogue input state if necessary, if we are no longer the focus of a DynamicPWM instance, allocate ourselves again!
-    if (!(status & IO_STATUS_ANALOG_OUT) || !(((DynamicPwm *)pin)->getPinName() == name)){
+    if (!(status & IO_STATUS_ANALOG_OUT) || !(((PwmChannel *)pin)->getPinName() == name)){
         disconnect();
-        pin = (void *)new DynamicPwm(name);
+        pin = (void *)new PwmChannel(name);
         status |= IO_STATUS_ANALOG_OUT;
     }
 
@@ -220,7 +237,7 @@ int MicroBitPin::setAnalogValue(int value)
 
     //obtain use of the DynamicPwm instance, if it has changed / configure if we do not have one
     if(obtainAnalogChannel() == MICROBIT_OK)
-        return ((DynamicPwm *)pin)->write(level);
+        return ((PwmChannel *)pin)->write(level);
 
     return MICROBIT_OK;
 }
@@ -287,7 +304,7 @@ int MicroBitPin::getAnalogValue()
     // Move into an analogue input state if necessary.
     if (!(status & IO_STATUS_ANALOG_IN)){
         disconnect();
-        pin = new AnalogIn(name);
+        pin = new (&storage) AnalogIn(name);
         status |= IO_STATUS_ANALOG_IN;
     }
 
@@ -395,10 +412,10 @@ int MicroBitPin::setServoPulseUs(int pulseWidth)
     if(obtainAnalogChannel() == MICROBIT_OK)
     {
         //check if the period is set to 20ms
-        if(((DynamicPwm *)pin)->getPeriodUs() != MICROBIT_DEFAULT_PWM_PERIOD)
-            ((DynamicPwm *)pin)->setPeriodUs(MICROBIT_DEFAULT_PWM_PERIOD);
+        if(((PwmChannel *)pin)->getPeriodUs() != MICROBIT_DEFAULT_PWM_PERIOD)
+            ((PwmChannel *)pin)->setPeriodUs(MICROBIT_DEFAULT_PWM_PERIOD);
 
-        ((DynamicPwm *)pin)->pulsewidth_us(pulseWidth);
+        ((PwmChannel *)pin)->pulsewidth_us(pulseWidth);
     }
 
     return MICROBIT_OK;
@@ -417,7 +434,7 @@ int MicroBitPin::setAnalogPeriodUs(int period)
     if (!(status & IO_STATUS_ANALOG_OUT))
         return MICROBIT_NOT_SUPPORTED;
 
-    return ((DynamicPwm *)pin)->setPeriodUs(period);
+    return ((PwmChannel *)pin)->setPeriodUs(period);
 }
 
 /**
@@ -444,7 +461,7 @@ int MicroBitPin::getAnalogPeriodUs()
     if (!(status & IO_STATUS_ANALOG_OUT))
         return MICROBIT_NOT_SUPPORTED;
 
-    return ((DynamicPwm *)pin)->getPeriodUs();
+    return ((PwmChannel *)pin)->getPeriodUs();
 }
 
 /**
@@ -482,6 +499,12 @@ int MicroBitPin::setPull(PinMode pull)
         return MICROBIT_OK;
     }
 
+    if(status & IO_STATUS_EVENT_PULSE_CAPTURE)
+    {
+        ((PulseCaptureIn *)pin)->mode(pull);
+        return MICROBIT_OK;
+    }
+
     return MICROBIT_NOT_SUPPORTED;
 }
 
@@ -563,6 +586,28 @@ int MicroBitPin::enableRiseFallEvents(int eventType)
     return MICROBIT_OK;
 }
 
+/**
+  * This member function will construct a PulseCaptureIn instance, which measures the width
+  * of each pulse on the pin in hardware.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_BUSY if another pin is already in this mode.
+  */
+int MicroBitPin::enablePulseCapture()
+{
+    if (status & IO_STATUS_EVENT_PULSE_CAPTURE)
+        return MICROBIT_OK;
+
+    // The capture hardware can only follow one pin at a time.
+    if (PulseCaptureIn::instance != NULL)
+        return MICROBIT_BUSY;
+
+    disconnect();
+    pin = new PulseCaptureIn(name, id, (PinMode)pullMode);
+    status |= IO_STATUS_EVENT_PULSE_CAPTURE;
+
+    return MICROBIT_OK;
+}
+
 /**
   * If this pin is in a mode where the pin is generating events, it will destruct
   * the current instance attached to this MicroBitPin instance.
@@ -571,7 +616,7 @@ int MicroBitPin::enableRiseFallEvents(int eventType)
   */
 int MicroBitPin::disableEvents()
 {
-    if (status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE | IO_STATUS_TOUCH_IN))
+    if (status & (IO_STATUS_EVENT_ON_EDGE | IO_STATUS_EVENT_PULSE_ON_EDGE | IO_STATUS_EVENT_PULSE_CAPTURE | IO_STATUS_TOUCH_IN))
         disconnect();
 
     return MICROBIT_OK;
@@ -582,10 +627,11 @@ int MicroBitPin::disableEvents()
   *
   * MICROBIT_PIN_EVENT_ON_EDGE - Configures this pin to a digital input, and generates events whenever a rise/fall is detected on this pin. (MICROBIT_PIN_EVT_RISE, MICROBIT_PIN_EVT_FALL)
   * MICROBIT_PIN_EVENT_ON_PULSE - Configures this pin to a digital input, and generates events where the timestamp is the duration that this pin was either HI or LO. (MICROBIT_PIN_EVT_PULSE_HI, MICROBIT_PIN_EVT_PULSE_LO)
+  * MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE - As MICROBIT_PIN_EVENT_ON_PULSE, but each edge is timestamped in hardware, so durations are exact to the microsecond. Only one pin may be in this mode at a time.
   * MICROBIT_PIN_EVENT_ON_TOUCH - Configures this pin as a makey makey style touch sensor, in the form of a MicroBitButton. Normal button events will be generated using the ID of this pin.
   * MICROBIT_PIN_EVENT_NONE - Disables events for this pin.
   *
-  * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
+  * @param eventType One of: MICROBIT_PIN_EVENT_ON_EDGE, MICROBIT_PIN_EVENT_ON_PULSE, MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE, MICROBIT_PIN_EVENT_ON_TOUCH, MICROBIT_PIN_EVENT_NONE
   *
   * @code
   * MicroBitMessageBus bus;
@@ -601,10 +647,11 @@ int MicroBitPin::disableEvents()
   * bus.listen(MICROBIT_ID_IO_P0, MICROBIT_PIN_EVT_PULSE_HI, onPulse, MESSAGE_BUS_LISTENER_IMMEDIATE)
   * @endcode
   *
-  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the given eventype does not match
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the given eventype does not match, or MICROBIT_BUSY
+  *        if another pin is already in the MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE mode.
   *
   * @note In the MICROBIT_PIN_EVENT_ON_PULSE mode, the smallest pulse that was reliably detected was 85us, around 5khz. If more precision is required,
-  *       please use the InterruptIn class supplied by ARM mbed.
+  *       please use the MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE mode.
   */
 int MicroBitPin::eventOn(int eventType)
 {
@@ -615,6 +662,9 @@ int MicroBitPin::eventOn(int eventType)
             enableRiseFallEvents(eventType);
             break;
 
+        case MICROBIT_PIN_EVENT_ON_PULSE_CAPTURE:
+            return enablePulseCapture();
+
         case MICROBIT_PIN_EVENT_ON_TOUCH:
             isTouched();
             break;
@@ -30,6 +30,14 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include "MicroBitQuadratureDecoder.h"
 
+MicroBitQuadratureDecoder *MicroBitQuadratureDecoder::instance = NULL;
+
+extern "C" void QDEC_IRQHandler(void)
+{
+    if (MicroBitQuadratureDecoder::instance != NULL)
+        MicroBitQuadratureDecoder::instance->interruptHandler();
+}
+
 /**
   * Constructor.
   * Create a software abstraction of the quadrature decoder.
@@ -70,7 +78,10 @@ void MicroBitQuadratureDecoder::enableSystemTick()
     {
         flags |= QDEC_USE_SYSTEM_TICK;
         if ((status & MICROBIT_COMPONENT_RUNNING) != 0)
+        {
             system_timer_add_component(this);
+            system_timer_set_requirement(this, SYSTEM_TICK_PERIOD_MS);
+        }
     }
 }
 
@@ -128,8 +139,6 @@ int MicroBitQuadratureDecoder::start()
 {
     int sampleper;
 
-    faults = 0;
-
     for (sampleper = 7; sampleper >= 0; --sampleper)
     {
         // Find the highest (most power-efficient) sample period available
@@ -139,14 +148,20 @@ int MicroBitQuadratureDecoder::start()
             break;
     }
 
-    if ((status & MICROBIT_COMPONENT_RUNNING) != 0)
+    if ((status & MICROBIT_COMPONENT_RUNNING) != 0 || instance != NULL)
         return MICROBIT_BUSY;
 
+    faults = 0;
+    overflows = 0;
+
     NRF_QDEC->SHORTS = 0;           // No shorts
     NRF_QDEC->INTENCLR = ~0;        // No interrupts
     NRF_QDEC->LEDPOL = (flags & QDEC_LED_ACTIVE_LOW) != 0 ? 0 : 1;
     NRF_QDEC->SAMPLEPER = sampleper;
-    NRF_QDEC->REPORTPER = 7;        // Slowest possible reporting (not used)
+
+    // When interrupt driven, report after every 10 samples (the shortest period), so the position is never more
+    // than 10 samples old. Otherwise reports are not used.
+    NRF_QDEC->REPORTPER = (flags & QDEC_USE_INTERRUPT) != 0 ? 0 : 7;
     NRF_QDEC->PSELLED = LED != NULL ? LED->name : NC;
     NRF_QDEC->PSELA = phaseA.name;
     NRF_QDEC->PSELB = phaseB.name;
@@ -168,11 +183,29 @@ int MicroBitQuadratureDecoder::start()
     NRF_QDEC->TASKS_READCLRACC = 1; // Clear accumulators
     NRF_QDEC->ENABLE = 1;
 
+    timestamp = velocityTime = system_timer_current_time_us();
+    velocityPosition = position;
+    velocity = 0;
+
+    instance = this;
+
+    if ((flags & QDEC_USE_INTERRUPT) != 0)
+    {
+        NRF_QDEC->EVENTS_REPORTRDY = 0;
+        NRF_QDEC->EVENTS_ACCOF = 0;
+        NRF_QDEC->INTENSET = QDEC_INTENSET_REPORTRDY_Msk | QDEC_INTENSET_ACCOF_Msk;
+        NVIC_ClearPendingIRQ(QDEC_IRQn);
+        NVIC_EnableIRQ(QDEC_IRQn);
+    }
+
     NRF_QDEC->TASKS_START = 1;
     status |= MICROBIT_COMPONENT_RUNNING;
 
     if ((flags & QDEC_USE_SYSTEM_TICK) != 0)
+    {
         system_timer_add_component(this);
+        system_timer_set_requirement(this, SYSTEM_TICK_PERIOD_MS);
+    }
 
     return MICROBIT_OK;
 }
@@ -187,9 +220,13 @@ void MicroBitQuadratureDecoder::stop()
 
     if ((status & MICROBIT_COMPONENT_RUNNING) != 0)
     {
+        NRF_QDEC->INTENCLR = ~0;
+        NVIC_DisableIRQ(QDEC_IRQn);
+
         NRF_QDEC->TASKS_STOP = 1;
         NRF_QDEC->ENABLE = 0;
         status &= ~MICROBIT_COMPONENT_RUNNING;
+        instance = NULL;
     }
 }
 
@@ -203,9 +240,104 @@ void MicroBitQuadratureDecoder::stop()
   */
 void MicroBitQuadratureDecoder::poll()
 {
+    // The interrupt handler updates the same state, so keep it out while we do.
+    NVIC_DisableIRQ(QDEC_IRQn);
+
     NRF_QDEC->TASKS_READCLRACC = 1;
     position += (int32_t)NRF_QDEC->ACCREAD;
     faults = min(UINT16_MAX, faults + NRF_QDEC->ACCDBLREAD);
+
+    timestamp = system_timer_current_time_us();
+    updateVelocity(timestamp);
+
+    if ((flags & QDEC_USE_INTERRUPT) != 0 && instance == this)
+        NVIC_EnableIRQ(QDEC_IRQn);
+}
+
+/**
+  * Interrupt service routine for the QDEC. Accumulates the hardware count into the position on REPORTRDY,
+  * and counts any accumulator overflows.
+  */
+void MicroBitQuadratureDecoder::interruptHandler()
+{
+    if (NRF_QDEC->EVENTS_ACCOF)
+    {
+        NRF_QDEC->EVENTS_ACCOF = 0;
+        overflows = min(UINT16_MAX, overflows + 1);
+    }
+
+    if (NRF_QDEC->EVENTS_REPORTRDY)
+        NRF_QDEC->EVENTS_REPORTRDY = 0;
+
+    NRF_QDEC->TASKS_READCLRACC = 1;
+    position += (int32_t)NRF_QDEC->ACCREAD;
+    faults = min(UINT16_MAX, faults + NRF_QDEC->ACCDBLREAD);
+
+    timestamp = system_timer_current_time_us();
+    updateVelocity(timestamp);
+}
+
+/**
+  * Updates the velocity estimate, if the current window is complete.
+  * Must be called with interrupts disabled.
+  *
+  * @param now the current time, in microseconds.
+  */
+void MicroBitQuadratureDecoder::updateVelocity(uint64_t now)
+{
+    uint64_t elapsed = now - velocityTime;
+
+    if (elapsed < QDEC_VELOCITY_WINDOW_US)
+        return;
+
+    velocity = (int32_t)((position - velocityPosition) * 1000000 / (int64_t)elapsed);
+    velocityPosition = position;
+    velocityTime = now;
+}
+
+/**
+  * Read the absolute position of the encoder at last call to `poll()`.
+  *
+  * @return current decoder position.
+  */
+int64_t MicroBitQuadratureDecoder::getPosition()
+{
+    __disable_irq();
+    int64_t p = position;
+    __enable_irq();
+
+    return p;
+}
+
+/**
+  * Read the time of the last call to `poll()`, which is the time at which getPosition() was valid.
+  *
+  * @return the time of the last poll, in microseconds since power on.
+  */
+uint64_t MicroBitQuadratureDecoder::getTimestamp()
+{
+    __disable_irq();
+    uint64_t t = timestamp;
+    __enable_irq();
+
+    return t;
+}
+
+/**
+  * Read the speed of the encoder, measured over the last QDEC_VELOCITY_WINDOW_US microseconds.
+  *
+  * @return the velocity in encoder counts per second, positive or negative according to direction.
+  */
+int32_t MicroBitQuadratureDecoder::getVelocity()
+{
+    // The hardware only reports while the encoder is moving, so close the window here too, otherwise the
+    // estimate would never fall to zero once the encoder stops.
+    __disable_irq();
+    updateVelocity(system_timer_current_time_us());
+    int32_t v = velocity;
+    __enable_irq();
+
+    return v;
 }
 
 /**
@@ -217,7 +349,10 @@ void MicroBitQuadratureDecoder::poll()
   */
 void MicroBitQuadratureDecoder::resetPosition(int64_t position)
 {
+    __disable_irq();
+    this->velocityPosition += position - this->position;
     this->position = position;
+    __enable_irq();
 }
 
 /**
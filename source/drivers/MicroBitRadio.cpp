@@ -31,6 +31,29 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include "MicroBitFiber.h"
 #include "MicroBitBLEManager.h"
+#include "MicroBitMemoryPool.h"
+#include "MicroBitPowerProfile.h"
+
+/*
+ * The underlying Nordic libraries that support BLE do not compile cleanly with the stringent GCC settings we employ
+ * If we're compiling under GCC, then we suppress any warnings generated from this code (but not the rest of the DAL)
+ * The ARM cc compiler is more tolerant. We don't test __GNUC__ here to detect GCC as ARMCC also typically sets this
+ * as a compatability option, but does not support the options used...
+ */
+#if !defined(__arm)
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+#include "nrf_soc.h"
+
+/*
+ * Return to our predefined compiler settings.
+ */
+#if !defined(__arm)
+#pragma GCC diagnostic pop
+#endif
 
 /**
   * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -46,9 +69,9 @@ DEALINGS IN THE SOFTWARE.
   * TODO: Meshing should also be considered - again a GLOSSY approach may be effective here, and highly complementary to
   * the master/slave arachitecture of BLE.
   *
-  * TODO: This implementation may only operated whilst the BLE stack is disabled. The nrf51822 provides a timeslot API to allow
-  * BLE to cohabit with other protocols. Future work to allow this colocation would be benefical, and would also allow for the
-  * creation of wireless BLE bridges.
+  * NOTE: By default, this implementation may only operate whilst the BLE stack is disabled. With MICROBIT_RADIO_TIMESLOTS enabled,
+  * the radio instead shares the RADIO module with BLE, through the SoftDevice's timeslot API, and sends and receives only within
+  * the timeslots it is granted (see setTimeslots()).
   *
   * NOTE: This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
   * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
@@ -57,19 +80,78 @@ DEALINGS IN THE SOFTWARE.
 
 MicroBitRadio* MicroBitRadio::instance = NULL;
 
-extern "C" void RADIO_IRQHandler(void)
+// Frame buffers used for reception, held in a pool so that the radio interrupt handler doesn't churn the heap.
+static MicroBitMemoryPool framePool(MICROBIT_RADIO_FRAME_HEADROOM + sizeof(FrameBuffer), MICROBIT_RADIO_FRAME_POOL_SIZE);
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+// How long the SoftDevice may take to grant the earliest available timeslot, before it reports the request as blocked, in microseconds.
+#define MICROBIT_RADIO_TIMESLOT_TIMEOUT 100000
+
+// The shortest useful timeslot, in microseconds, long enough to ramp up the transceiver and send a full packet at 250kbit/s.
+#define MICROBIT_RADIO_TIMESLOT_MINIMUM (MICROBIT_RADIO_TIMESLOT_MARGIN + 1500)
+
+static uint32_t timeslot_length = MICROBIT_RADIO_TIMESLOT_LENGTH;
+static uint32_t timeslot_period = MICROBIT_RADIO_TIMESLOT_PERIOD;
+
+// The SoftDevice reads these after our signal handler returns, so they can't live on the stack.
+static nrf_radio_request_t timeslot_request;
+static nrf_radio_signal_callback_return_param_t timeslot_action;
+#endif
+
+/**
+  * Allocates memory for a FrameBuffer, from the radio's pool of frame buffers where possible.
+  * The memory is preceded by MICROBIT_RADIO_FRAME_HEADROOM bytes, so it may later be adopted by a PacketBuffer.
+  * This is safe to call from interrupt context.
+  *
+  * @param size The amount of memory required.
+  *
+  * @return A pointer to the memory.
+  */
+void *FrameBuffer::operator new(size_t size)
 {
-    if(NRF_RADIO->EVENTS_READY)
-    {
-        NRF_RADIO->EVENTS_READY = 0;
+    uint8_t *p = NULL;
+
+    if (size == sizeof(FrameBuffer))
+        p = (uint8_t *) framePool.allocate();
+
+    if (p == NULL)
+        p = (uint8_t *) malloc(MICROBIT_RADIO_FRAME_HEADROOM + size);
+
+    return p == NULL ? NULL : p + MICROBIT_RADIO_FRAME_HEADROOM;
+}
+
+/**
+  * Releases the memory held by a FrameBuffer, back to the pool it came from where appropriate.
+  *
+  * @param p The memory to release.
+  */
+void FrameBuffer::operator delete(void *p)
+{
+    if (p != NULL)
+        microbit_pool_free((uint8_t *)p - MICROBIT_RADIO_FRAME_HEADROOM);
+}
 
-        // Start listening and wait for the END event
-        NRF_RADIO->TASKS_START = 1;
+/*
+ * Handles the END and DISABLED events of the RADIO module. This runs from RADIO_IRQHandler when we have the
+ * RADIO module to ourselves, or from the timeslot signal handler when it is shared with the BLE stack.
+ */
+static void radio_event_handler()
+{
+    // Timestamp the frame as its address goes by. This happens at the same moment at the sender and every receiver.
+    if(NRF_RADIO->EVENTS_ADDRESS)
+    {
+        NRF_RADIO->EVENTS_ADDRESS = 0;
+        MicroBitRadio::instance->timestampFrame();
     }
 
+    // The end of a transmitted packet is handled once the transceiver has been disabled, below.
+    if(NRF_RADIO->EVENTS_END && MicroBitRadio::instance->isTransmitting())
+        NRF_RADIO->EVENTS_END = 0;
+
     if(NRF_RADIO->EVENTS_END)
     {
         NRF_RADIO->EVENTS_END = 0;
+
         if(NRF_RADIO->CRCSTATUS == 1)
         {
             int sample = (int)NRF_RADIO->RSSISAMPLE;
@@ -88,13 +170,94 @@ extern "C" void RADIO_IRQHandler(void)
         else
         {
             MicroBitRadio::instance->setRSSI(0);
+            MicroBitRadio::instance->crcFailed();
         }
 
-        // Start listening and wait for the END event
-        NRF_RADIO->TASKS_START = 1;
+        // Send anything queued whilst we were receiving. Otherwise, start listening and wait for the END event
+        if (!MicroBitRadio::instance->startTransmit())
+            NRF_RADIO->TASKS_START = 1;
+    }
+
+    if(NRF_RADIO->EVENTS_DISABLED && MicroBitRadio::instance->isTransmitting())
+    {
+        NRF_RADIO->EVENTS_DISABLED = 0;
+        MicroBitRadio::instance->transmitDisabled();
+    }
+}
+
+extern "C" void RADIO_IRQHandler(void)
+{
+    radio_event_handler();
+}
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+/*
+ * Describes the next timeslot to ask the SoftDevice for: either the earliest available, or one a period after the start of the current one.
+ */
+static nrf_radio_request_t *radio_timeslot_request(bool earliest)
+{
+    if (earliest)
+    {
+        timeslot_request.request_type = NRF_RADIO_REQ_TYPE_EARLIEST;
+        timeslot_request.params.earliest.hfclk = NRF_RADIO_HFCLK_CFG_FORCE_XTAL;
+        timeslot_request.params.earliest.priority = NRF_RADIO_PRIORITY_NORMAL;
+        timeslot_request.params.earliest.length_us = timeslot_length;
+        timeslot_request.params.earliest.timeout_us = MICROBIT_RADIO_TIMESLOT_TIMEOUT;
+    }
+    else
+    {
+        timeslot_request.request_type = NRF_RADIO_REQ_TYPE_NORMAL;
+        timeslot_request.params.normal.hfclk = NRF_RADIO_HFCLK_CFG_FORCE_XTAL;
+        timeslot_request.params.normal.priority = NRF_RADIO_PRIORITY_NORMAL;
+        timeslot_request.params.normal.distance_us = timeslot_period;
+        timeslot_request.params.normal.length_us = timeslot_length;
+    }
+
+    return &timeslot_request;
+}
+
+/*
+ * Called by the SoftDevice, at the highest interrupt priority, as each of our timeslots starts, for each RADIO
+ * and TIMER0 interrupt during it. TIMER0 is started from zero at the start of the timeslot, and marks its end.
+ */
+static nrf_radio_signal_callback_return_param_t *radio_timeslot_signal(uint8_t signal)
+{
+    timeslot_action.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_NONE;
+
+    switch (signal)
+    {
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_START:
+            MicroBitRadio::instance->timeslotStart();
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_RADIO:
+            radio_event_handler();
+            break;
+
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_TIMER0:
+            // Hand the RADIO module back, and ask for the next timeslot in the same breath.
+            if (MicroBitRadio::instance->timeslotEnd())
+            {
+                timeslot_action.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_REQUEST_AND_END;
+                timeslot_action.params.request.p_next = radio_timeslot_request(false);
+            }
+            else
+            {
+                timeslot_action.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_END;
+            }
+            break;
     }
+
+    return &timeslot_action;
 }
 
+static void radio_soc_event_handler(uint32_t evt)
+{
+    if (MicroBitRadio::instance != NULL)
+        MicroBitRadio::instance->timeslotEvent(evt);
+}
+#endif
+
 /**
   * Constructor.
   *
@@ -103,15 +266,30 @@ extern "C" void RADIO_IRQHandler(void)
   * @note This class is demand activated, as a result most resources are only
   *       committed if send/recv or event registrations calls are made.
   */
-MicroBitRadio::MicroBitRadio(uint16_t id) : datagram(*this), event (*this)
+MicroBitRadio::MicroBitRadio(uint16_t id) : datagram(*this), event (*this), bulk(*this), reliable(*this), time(*this)
 {
     this->id = id;
     this->status = 0;
+    this->dataRate = MICROBIT_RADIO_DEFAULT_DATA_RATE;
+    this->band = MICROBIT_RADIO_DEFAULT_FREQUENCY;
+    this->txPower = MICROBIT_RADIO_DEFAULT_TX_POWER;
+    this->inTimeslot = 0;
+    this->addressTime = 0;
 	this->group = MICROBIT_RADIO_DEFAULT_GROUP;
-	this->queueDepth = 0;
+    this->groups[0] = MICROBIT_RADIO_DEFAULT_GROUP;
+    this->groupMask = 0x01;
     this->rssi = 0;
-    this->rxQueue = NULL;
-    this->rxBuf = NULL;
+    this->rxHead = 0;
+    this->rxTail = 0;
+
+    this->txQueue = NULL;
+    this->txQueueLength = 0;
+    this->txState = MICROBIT_RADIO_TX_IDLE;
+
+    resetStatistics();
+
+    for (int i = 0; i <= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS; i++)
+        this->rxRing[i] = NULL;
 
     instance = this;
 }
@@ -128,7 +306,15 @@ int MicroBitRadio::setTransmitPower(int power)
     if (power < 0 || power >= MICROBIT_BLE_POWER_LEVELS)
         return MICROBIT_INVALID_PARAMETER;
 
-    NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[power];
+    this->txPower = power;
+
+    // When the RADIO module is shared, and we don't hold a timeslot, the new power level is used from the next one.
+    lock();
+
+    if (ownsTransceiver())
+        NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[power];
+
+    unlock();
 
     return MICROBIT_OK;
 }
@@ -139,31 +325,93 @@ int MicroBitRadio::setTransmitPower(int power)
   * @param band a frequency band in the range 0 - 100. Each step is 1MHz wide, based at 2400MHz.
   *
   * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the value is out of range,
-  *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
   */
 int MicroBitRadio::setFrequencyBand(int band)
 {
-    if (ble_running())
+    if (ble_running() && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
         return MICROBIT_NOT_SUPPORTED;
 
     if (band < MICROBIT_RADIO_LOWER_FREQ_BAND || band > MICROBIT_RADIO_UPPER_FREQ_BAND)
         return MICROBIT_INVALID_PARAMETER;
 
-    // We need to disable the radio before setting the frequency
+    this->band = band;
+
+    // When the RADIO module is shared, the new band is used from the next timeslot.
+    if (!(status & MICROBIT_RADIO_STATUS_INITIALISED) || (status & MICROBIT_RADIO_STATUS_TIMESLOTS))
+        return MICROBIT_OK;
+
+    // We need to disable the radio before setting the frequency, so let queued packets go first.
+    waitForTransmit();
     NVIC_DisableIRQ(RADIO_IRQn);
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while (NRF_RADIO->EVENTS_DISABLED == 0);
+    disableTransceiver();
 
     NRF_RADIO->FREQUENCY = (uint32_t)band;
 
     // Reenable the radio to wait for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0);
+    startReceiver();
 
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    NVIC_ClearPendingIRQ(RADIO_IRQn);
+    NVIC_EnableIRQ(RADIO_IRQn);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Change the data rate the radio sends and receives at.
+  *
+  * All micro:bits wishing to communicate must use the same data rate. If the radio is not yet enabled,
+  * the data rate is applied when it is.
+  *
+  * @param rate MICROBIT_RADIO_DATA_RATE_250KBIT, MICROBIT_RADIO_DATA_RATE_1MBIT or MICROBIT_RADIO_DATA_RATE_2MBIT.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the rate is not supported,
+  *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+  *
+  * @code
+  * radio.setDataRate(MICROBIT_RADIO_DATA_RATE_2MBIT);
+  * @endcode
+  */
+int MicroBitRadio::setDataRate(int rate)
+{
+    uint32_t mode;
+
+    if (ble_running() && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
+        return MICROBIT_NOT_SUPPORTED;
+
+    switch (rate)
+    {
+        case MICROBIT_RADIO_DATA_RATE_250KBIT:
+            mode = RADIO_MODE_MODE_Nrf_250Kbit;
+            break;
+
+        case MICROBIT_RADIO_DATA_RATE_1MBIT:
+            mode = RADIO_MODE_MODE_Nrf_1Mbit;
+            break;
+
+        case MICROBIT_RADIO_DATA_RATE_2MBIT:
+            mode = RADIO_MODE_MODE_Nrf_2Mbit;
+            break;
+
+        default:
+            return MICROBIT_INVALID_PARAMETER;
+    }
+
+    this->dataRate = rate;
+
+    // When the RADIO module is shared, the new data rate is used from the next timeslot.
+    if (!(status & MICROBIT_RADIO_STATUS_INITIALISED) || (status & MICROBIT_RADIO_STATUS_TIMESLOTS))
+        return MICROBIT_OK;
+
+    // We need to disable the radio before changing mode, so let queued packets go first.
+    waitForTransmit();
+    NVIC_DisableIRQ(RADIO_IRQn);
+    disableTransceiver();
+
+    NRF_RADIO->MODE = mode;
+
+    // Reenable the radio to wait for the next packet
+    startReceiver();
 
     NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
@@ -171,6 +419,61 @@ int MicroBitRadio::setFrequencyBand(int band)
     return MICROBIT_OK;
 }
 
+/**
+  * Retrieves the data rate the radio sends and receives at.
+  *
+  * @return the data rate, in kbit/s.
+  */
+int MicroBitRadio::getDataRate()
+{
+    return dataRate;
+}
+
+/**
+  * Turns off the transceiver, waiting until it has done so.
+  *
+  * @note the radio interrupt should be disabled by the caller.
+  */
+void MicroBitRadio::disableTransceiver()
+{
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->TASKS_DISABLE = 1;
+    while (NRF_RADIO->EVENTS_DISABLED == 0);
+}
+
+/**
+  * Turns on the receiver, to listen for the next packet.
+  *
+  * This does not wait for the receiver to ramp up. Reception starts as soon as it is ready,
+  * through the READY_START short.
+  */
+void MicroBitRadio::startReceiver()
+{
+    NRF_RADIO->EVENTS_READY = 0;
+    NRF_RADIO->EVENTS_END = 0;
+    NRF_RADIO->TASKS_RXEN = 1;
+}
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_LISTEN_BEFORE_TALK)
+/**
+  * Performs a clear channel assessment, by measuring the signal strength on our frequency.
+  *
+  * @return true if the signal is weaker than MICROBIT_RADIO_LBT_THRESHOLD, false if another device is transmitting.
+  */
+bool MicroBitRadio::channelClear()
+{
+    // The receiver may still be ramping up after a previous transmission or retune.
+    while (NRF_RADIO->STATE != RADIO_STATE_STATE_Rx);
+
+    NRF_RADIO->EVENTS_RSSIEND = 0;
+    NRF_RADIO->TASKS_RSSISTART = 1;
+    while (NRF_RADIO->EVENTS_RSSIEND == 0);
+
+    // RSSISAMPLE holds the magnitude of a negative dBm value, so larger numbers are weaker signals.
+    return NRF_RADIO->RSSISAMPLE > MICROBIT_RADIO_LBT_THRESHOLD;
+}
+#endif
+
 /**
   * Retrieve a pointer to the currently allocated receive buffer. This is the area of memory
   * actively being used by the radio hardware to store incoming data.
@@ -179,7 +482,7 @@ int MicroBitRadio::setFrequencyBand(int band)
   */
 FrameBuffer* MicroBitRadio::getRxBuf()
 {
-    return rxBuf;
+    return rxRing[rxHead];
 }
 
 /**
@@ -190,42 +493,40 @@ FrameBuffer* MicroBitRadio::getRxBuf()
   */
 int MicroBitRadio::queueRxBuf()
 {
+    FrameBuffer *rxBuf = rxRing[rxHead];
+
     if (rxBuf == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    if (queueDepth >= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS)
-        return MICROBIT_NO_RESOURCES;
-
-    // Store the received RSSI value in the frame
-    rxBuf->rssi = getRSSI();
+    uint8_t nextHead = rxHead == MICROBIT_RADIO_MAXIMUM_RX_BUFFERS ? 0 : rxHead + 1;
 
-    // Ensure that a replacement buffer is available before queuing.
-    FrameBuffer *newRxBuf = new FrameBuffer();
+    // Fold this packet into the running RSSI average. The first packet seeds it.
+    int sample = getRSSI() << MICROBIT_RADIO_RSSI_AVERAGE_SHIFT;
+    rssiAverage = stats.received ? rssiAverage + ((sample - rssiAverage) >> MICROBIT_RADIO_RSSI_AVERAGE_SHIFT) : sample;
+    stats.received++;
 
-    if (newRxBuf == NULL)
+    // If the ring is full, the hardware keeps the buffer it has, and the packet is dropped.
+    if (nextHead == rxTail)
+    {
+        stats.overflows++;
         return MICROBIT_NO_RESOURCES;
+    }
 
-    // We add to the tail of the queue to preserve causal ordering.
-    rxBuf->next = NULL;
+    stats.protocols[min(rxBuf->protocol, MICROBIT_RADIO_STATISTICS_PROTOCOLS - 1)]++;
 
-    if (rxQueue == NULL)
-    {
-        rxQueue = rxBuf;
-    }
-    else
-    {
-        FrameBuffer *p = rxQueue;
-        while (p->next != NULL)
-            p = p->next;
+    // Store the received RSSI value in the frame
+    rxBuf->rssi = getRSSI();
+    rxBuf->timestamp = addressTime;
 
-        p->next = rxBuf;
-    }
+    // Mark the frame with the group whose address the hardware matched.
+    rxBuf->group = groups[NRF_RADIO->RXMATCH & (MICROBIT_RADIO_MAX_GROUPS - 1)];
+    rxBuf->next = NULL;
 
-    // Increase our received packet count
-    queueDepth++;
+    // Queue the packet, and move the receiver hardware on to the next buffer. The queued one will be passed on to higher layer protocols/apps.
+    rxHead = nextHead;
 
-    // Allocate a new buffer for the receiver hardware to use. the old on will be passed on to higher layer protocols/apps.
-    rxBuf = newRxBuf;
+    // Ensure the packet is processed the next time we're idle.
+    fiber_idle_component_pending(this);
 
     return MICROBIT_OK;
 }
@@ -265,40 +566,187 @@ int MicroBitRadio::getRSSI()
 }
 
 /**
-  * Initialises the radio for use as a multipoint sender/receiver
+  * Begins transmitting the packet at the head of the transmit queue, if the radio is receiving.
+  *
+  * @return true if transmission has begun, false if the queue is empty or the radio is already transmitting.
   *
-  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @note should only be called from RADIO_IRQHandler, or with the radio interrupt disabled...
   */
-int MicroBitRadio::enable()
+bool MicroBitRadio::startTransmit()
 {
-    // If the device is already initialised, then there's nothing to do.
-    if (status & MICROBIT_RADIO_STATUS_INITIALISED)
-        return MICROBIT_OK;
+    if (txState != MICROBIT_RADIO_TX_IDLE || txQueue == NULL)
+        return false;
 
-    // Only attempt to enable this radio mode if BLE is disabled.
-    if (ble_running())
-        return MICROBIT_NOT_SUPPORTED;
+    txState = MICROBIT_RADIO_TX_STARTING;
 
-    // If this is the first time we've been enable, allocate out receive buffers.
-    if (rxBuf == NULL)
-        rxBuf = new FrameBuffer();
+    // Chain DISABLED -> TXEN -> READY -> START -> END -> DISABLE in hardware, so that the packet is sent
+    // as quickly as possible, and we're interrupted only once it has been.
+    NRF_RADIO->PACKETPTR = (uint32_t) txQueue;
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->SHORTS |= RADIO_SHORTS_DISABLED_TXEN_Msk | RADIO_SHORTS_END_DISABLE_Msk;
+    NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+    NRF_RADIO->TASKS_DISABLE = 1;
 
-    if (rxBuf == NULL)
-        return MICROBIT_NO_RESOURCES;
+    return true;
+}
 
-    // Enable the High Frequency clock on the processor. This is a pre-requisite for
-    // the RADIO module. Without this clock, no communication is possible.
-    NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
-    NRF_CLOCK->TASKS_HFCLKSTART = 1;
-    while (NRF_CLOCK->EVENTS_HFCLKSTARTED == 0);
+/**
+  * Called when the transceiver has been disabled during a transmission. Moves on to the next queued
+  * packet, or back to receiving once the queue is empty.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::transmitDisabled()
+{
+    if (txState == MICROBIT_RADIO_TX_IDLE)
+        return;
+
+    if (txState == MICROBIT_RADIO_TX_STARTING)
+    {
+        // The receiver is off, and the transmitter ramping up. If this is the last packet,
+        // go straight back to receiving once it has been sent.
+        txState = MICROBIT_RADIO_TX_SENDING;
+
+        if (txQueue->next == NULL)
+            NRF_RADIO->SHORTS = (NRF_RADIO->SHORTS & ~RADIO_SHORTS_DISABLED_TXEN_Msk) | RADIO_SHORTS_DISABLED_RXEN_Msk;
+
+        return;
+    }
+
+    // The packet at the head of the queue has been sent.
+    FrameBuffer *p = txQueue;
+
+    if (p->protocol == MICROBIT_RADIO_PROTOCOL_TIME)
+        time.beaconSent(p, addressTime);
+
+    txQueue = txQueue->next;
+    txQueueLength--;
+    delete p;
+
+    if (NRF_RADIO->SHORTS & RADIO_SHORTS_DISABLED_TXEN_Msk)
+    {
+        // The transmitter is already ramping up again. Point it at the next packet before it starts.
+        NRF_RADIO->PACKETPTR = (uint32_t) txQueue;
+
+        if (txQueue->next == NULL)
+            NRF_RADIO->SHORTS = (NRF_RADIO->SHORTS & ~RADIO_SHORTS_DISABLED_TXEN_Msk) | RADIO_SHORTS_DISABLED_RXEN_Msk;
 
-    // Bring up the nrf51822 RADIO module in Nordic's proprietary 1MBps packet radio mode.
-    setTransmitPower(MICROBIT_RADIO_DEFAULT_TX_POWER);
-    NRF_RADIO->FREQUENCY = MICROBIT_RADIO_DEFAULT_FREQUENCY;
+        return;
+    }
+
+    // The receiver is ramping up. Point it at our receive buffer before it starts.
+    NRF_RADIO->PACKETPTR = (uint32_t) getRxBuf();
+    NRF_RADIO->SHORTS &= ~(RADIO_SHORTS_DISABLED_RXEN_Msk | RADIO_SHORTS_END_DISABLE_Msk);
+    NRF_RADIO->INTENCLR = RADIO_INTENSET_DISABLED_Msk;
+    txState = MICROBIT_RADIO_TX_IDLE;
+
+    // Packets may have been queued since we decided that was the last.
+    startTransmit();
+}
+
+/**
+  * Records a packet that was discarded because its CRC did not match.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::crcFailed()
+{
+    stats.crcFailures++;
+}
 
-    // Configure for 1Mbps throughput.
+/**
+  * Retrieves counts of the packets seen by the receiver, since it was enabled or resetStatistics() was last called.
+  *
+  * @param statistics the structure to fill in.
+  *
+  * @return MICROBIT_OK.
+  *
+  * @code
+  * MicroBitRadioStatistics s;
+  * radio.getStatistics(s);
+  * if (s.overflows > 0)
+  *     // consider a larger MICROBIT_RADIO_MAXIMUM_RX_BUFFERS...
+  * @endcode
+  */
+int MicroBitRadio::getStatistics(MicroBitRadioStatistics &statistics)
+{
+    // Protect shared resource from ISR activity
+    lock();
+
+    statistics = stats;
+    statistics.rssiAverage = rssiAverage >> MICROBIT_RADIO_RSSI_AVERAGE_SHIFT;
+
+    // Allow ISR access to shared resource
+    unlock();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Resets all the receiver statistics to zero.
+  */
+void MicroBitRadio::resetStatistics()
+{
+    lock();
+
+    memclr(&stats, sizeof(stats));
+    rssiAverage = 0;
+
+    unlock();
+}
+
+/**
+  * Determines if the RADIO module may be used. When it is shared with the BLE stack, this is only whilst
+  * we hold a timeslot, so the caller should hold lock() until it has finished with the RADIO module.
+  *
+  * @return true if the radio has the RADIO module to itself, or holds a timeslot.
+  */
+bool MicroBitRadio::ownsTransceiver()
+{
+    if (status & MICROBIT_RADIO_STATUS_TIMESLOTS)
+        return inTimeslot;
+
+    return (status & MICROBIT_RADIO_STATUS_INITIALISED) || !ble_running();
+}
+
+/**
+  * Protects the transmit queue and statistics from the radio interrupt, or from the timeslot signal handler
+  * if the RADIO module is shared with the BLE stack.
+  */
+void MicroBitRadio::lock()
+{
+    // The SoftDevice calls our timeslot signal handler at the highest priority, so only masking every interrupt holds it off.
+    if (status & MICROBIT_RADIO_STATUS_TIMESLOTS)
+        __disable_irq();
+    else if (status & MICROBIT_RADIO_STATUS_INITIALISED)
+        NVIC_DisableIRQ(RADIO_IRQn);
+}
+
+/**
+  * Allows the radio interrupt or timeslot signal handler to run again.
+  */
+void MicroBitRadio::unlock()
+{
+    if (status & MICROBIT_RADIO_STATUS_TIMESLOTS)
+        __enable_irq();
+    else if (status & MICROBIT_RADIO_STATUS_INITIALISED)
+        NVIC_EnableIRQ(RADIO_IRQn);
+}
+
+/**
+  * Programs the RADIO hardware with our frequency, data rate, addresses and packet format,
+  * ready for startReceiver(). This is done once when the radio is enabled, or at the start of every timeslot.
+  */
+void MicroBitRadio::configureTransceiver()
+{
+    // Bring up the nrf51822 RADIO module in Nordic's proprietary packet radio mode.
+    NRF_RADIO->TXPOWER = (uint32_t)MICROBIT_BLE_POWER_LEVEL[txPower];
+    NRF_RADIO->FREQUENCY = band;
+
+    // Configure for 1Mbps throughput by default.
     // This may sound excessive, but running a high data rates reduces the chances of collisions...
-    NRF_RADIO->MODE = RADIO_MODE_MODE_Nrf_1Mbit;
+    NRF_RADIO->MODE = dataRate == MICROBIT_RADIO_DATA_RATE_2MBIT ? RADIO_MODE_MODE_Nrf_2Mbit :
+                      dataRate == MICROBIT_RADIO_DATA_RATE_250KBIT ? RADIO_MODE_MODE_Nrf_250Kbit : RADIO_MODE_MODE_Nrf_1Mbit;
 
     // Configure the addresses we use for this protocol. We run ANONYMOUSLY at the core.
     // A 40 bit addresses is used. The first 32 bits match the ASCII character code for "uBit".
@@ -306,14 +754,14 @@ int MicroBitRadio::enable()
     // We also map the assigned 8-bit GROUP id into the PREFIX field. This allows the RADIO hardware to perform
     // address matching for us, and only generate an interrupt when a packet matching our group is received.
     NRF_RADIO->BASE0 = MICROBIT_RADIO_BASE_ADDRESS;
+    NRF_RADIO->BASE1 = MICROBIT_RADIO_BASE_ADDRESS;
 
-    // Join the default group. This will configure the remaining byte in the RADIO hardware module.
-    setGroup(this->group);
+    // Program our group, and any others we listen to, into the remaining byte of each address.
+    setAddresses();
 
-    // The RADIO hardware module supports the use of multiple addresses, but as we're running anonymously, we only need one.
-    // Configure the RADIO module to use the default address (address 0) for both send and receive operations.
+    // The RADIO hardware module supports the use of multiple addresses. We use one per group we listen to (see addGroup()).
+    // Configure the RADIO module to send using the address of our own group (address 0). setAddresses() has enabled the receive addresses.
     NRF_RADIO->TXADDRESS = 0;
-    NRF_RADIO->RXADDRESSES = 1;
 
     // Packet layout configuration. The nrf51822 has a highly capable and flexible RADIO module that, in addition to transmission
     // and reception of data, also contains a LENGTH field, two optional additional 1 byte fields (S0 and S1) and a CRC calculation.
@@ -335,28 +783,249 @@ int MicroBitRadio::enable()
     NRF_RADIO->DATAWHITEIV = 0x18;
 
     // Set up the RADIO module to read and write from our internal buffer.
-    NRF_RADIO->PACKETPTR = (uint32_t)rxBuf;
+    NRF_RADIO->PACKETPTR = (uint32_t)getRxBuf();
 
-    // Configure the hardware to issue an interrupt whenever a task is complete (e.g. send/receive).
+    // Configure the hardware to issue an interrupt whenever a task is complete (e.g. send/receive),
+    // and as the address of each frame goes by if we're timestamping.
     NRF_RADIO->INTENSET = 0x00000008;
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
-    NVIC_EnableIRQ(RADIO_IRQn);
 
-    NRF_RADIO->SHORTS |= RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
+    if (status & MICROBIT_RADIO_STATUS_TIMESTAMPS)
+        NRF_RADIO->INTENSET = RADIO_INTENSET_ADDRESS_Msk;
 
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
+    // Sample the RSSI of each packet as it arrives, and start receiving or transmitting as soon as the
+    // transceiver has ramped up, so that we never have to wait for it.
+    NRF_RADIO->SHORTS = RADIO_SHORTS_ADDRESS_RSSISTART_Msk | RADIO_SHORTS_READY_START_Msk;
+}
 
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+/**
+  * Enables or disables timestamping of frames. When enabled, the radio is interrupted as the address of each frame
+  * is sent or received, and records the system time. Received frames carry this in their timestamp field.
+  *
+  * @param enabled true to timestamp frames.
+  *
+  * @return MICROBIT_OK.
+  */
+int MicroBitRadio::setTimestamping(bool enabled)
+{
+    lock();
+
+    if (enabled)
+        status |= MICROBIT_RADIO_STATUS_TIMESTAMPS;
+    else
+        status &= ~MICROBIT_RADIO_STATUS_TIMESTAMPS;
+
+    // If the transceiver isn't running, or we're between timeslots, this is applied when it starts.
+    if ((status & MICROBIT_RADIO_STATUS_INITIALISED) && ownsTransceiver())
+    {
+        if (enabled)
+            NRF_RADIO->INTENSET = RADIO_INTENSET_ADDRESS_Msk;
+        else
+            NRF_RADIO->INTENCLR = RADIO_INTENCLR_ADDRESS_Msk;
+    }
+
+    unlock();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Records the time at which the address of the frame being sent or received went by, if timestamping is enabled.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadio::timestampFrame()
+{
+    if (status & MICROBIT_RADIO_STATUS_TIMESTAMPS)
+        addressTime = (uint32_t) system_timer_current_time_us();
+}
+
+/**
+  * Called at the start of each timeslot granted by the SoftDevice. Reprograms the RADIO module,
+  * starts listening, and sends anything queued since the last timeslot.
+  *
+  * @note should only be called from the timeslot signal handler...
+  */
+void MicroBitRadio::timeslotStart()
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    inTimeslot = 1;
+
+    // The BLE stack leaves the RADIO module configured for its own use, so power cycle it back to its reset state.
+    NRF_RADIO->POWER = 0;
+    NRF_RADIO->POWER = 1;
+
+    configureTransceiver();
+
+    // Stop early enough to finish the packet in flight, and return the RADIO module before the timeslot ends.
+    NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+    NRF_TIMER0->CC[0] = timeslot_length - MICROBIT_RADIO_TIMESLOT_MARGIN;
+    NRF_TIMER0->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+    startReceiver();
+    startTransmit();
+#endif
+}
+
+/**
+  * Called shortly before the end of each timeslot, to hand the RADIO module back to the SoftDevice.
+  * A packet still being sent is sent again from the start of the next timeslot.
+  *
+  * @return true if another timeslot should be requested, or false if the radio is being disabled.
+  *
+  * @note should only be called from the timeslot signal handler...
+  */
+bool MicroBitRadio::timeslotEnd()
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    NRF_TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
+    NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+
+    NRF_RADIO->INTENCLR = 0xFFFFFFFF;
+    NRF_RADIO->SHORTS = 0;
+    disableTransceiver();
+
+    // The head of the transmit queue stays there until it has been sent in full.
+    txState = MICROBIT_RADIO_TX_IDLE;
+    inTimeslot = 0;
+#endif
+
+    return status & MICROBIT_RADIO_STATUS_INITIALISED;
+}
+
+/**
+  * Called with each SoC event raised by the SoftDevice. Requests a further timeslot if the one requested
+  * could not be granted.
+  *
+  * @param evt The event identifier.
+  */
+void MicroBitRadio::timeslotEvent(uint32_t evt)
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    if (!(status & MICROBIT_RADIO_STATUS_INITIALISED) || !(status & MICROBIT_RADIO_STATUS_TIMESLOTS))
+        return;
+
+    switch (evt)
+    {
+        // The BLE stack needed the radio at the time we asked for, or we gave our timeslots up. Start again as soon as we can.
+        case NRF_EVT_RADIO_BLOCKED:
+        case NRF_EVT_RADIO_CANCELED:
+        case NRF_EVT_RADIO_SESSION_IDLE:
+            sd_radio_request(radio_timeslot_request(true));
+            break;
+    }
+#endif
+}
+
+/**
+  * Sets the length and interval of the timeslots used when the radio is shared with the BLE stack.
+  * The share of airtime given to the radio is length / period. Changes take effect from the next timeslot requested.
+  *
+  * @param length The length of each timeslot, in microseconds.
+  *
+  * @param period The interval between the start of successive timeslots, in microseconds.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the length is too short to send a packet or is not
+  *         shorter than the period, or MICROBIT_NOT_SUPPORTED if MICROBIT_RADIO_TIMESLOTS is not enabled.
+  *
+  * @code
+  * radio.setTimeslots(10000, 20000);   // Give the radio half of the airtime.
+  * @endcode
+  */
+int MicroBitRadio::setTimeslots(uint32_t length, uint32_t period)
+{
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    if (length < MICROBIT_RADIO_TIMESLOT_MINIMUM || length >= period)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // The signal handler reads these as it requests each timeslot.
+    __disable_irq();
+    timeslot_length = length;
+    timeslot_period = period;
+    __enable_irq();
+
+    return MICROBIT_OK;
+#else
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Initialises the radio for use as a multipoint sender/receiver
+  *
+  * If the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is enabled, the RADIO module is shared with it,
+  * and packets are sent and received only within the timeslots the SoftDevice grants us.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled,
+  *         or MICROBIT_BUSY if the SoftDevice is still closing a previous timeslot session.
+  */
+int MicroBitRadio::enable()
+{
+    // If the device is already initialised, then there's nothing to do.
+    if (status & MICROBIT_RADIO_STATUS_INITIALISED)
+        return MICROBIT_OK;
+
+    bool shared = ble_running();
+
+    // Only attempt to enable this radio mode if BLE is disabled, or we can share the radio with it.
+    if (shared && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
+        return MICROBIT_NOT_SUPPORTED;
+
+    // If this is the first time we've been enable, allocate out receive buffers.
+    for (int i = 0; i <= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS; i++)
+    {
+        if (rxRing[i] == NULL)
+            rxRing[i] = new FrameBuffer();
+
+        if (rxRing[i] == NULL)
+            return MICROBIT_NO_RESOURCES;
+    }
+
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    if (shared)
+    {
+        // The SoftDevice owns the RADIO module, and lends it to us in timeslots. It also looks after the High Frequency clock.
+        if (sd_radio_session_open(radio_timeslot_signal) != NRF_SUCCESS)
+            return MICROBIT_BUSY;
+
+        microbit_add_soc_event_handler(radio_soc_event_handler);
+
+        status |= MICROBIT_RADIO_STATUS_TIMESLOTS | MICROBIT_RADIO_STATUS_INITIALISED;
+
+        if (sd_radio_request(radio_timeslot_request(true)) != NRF_SUCCESS)
+        {
+            status &= ~MICROBIT_RADIO_STATUS_INITIALISED;
+            sd_radio_session_close();
+            status &= ~MICROBIT_RADIO_STATUS_TIMESLOTS;
+
+            return MICROBIT_BUSY;
+        }
+    }
+#endif
+
+    if (!shared)
+    {
+        // Enable the High Frequency clock on the processor. This is a pre-requisite for
+        // the RADIO module. Without this clock, no communication is possible.
+        NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+        NRF_CLOCK->TASKS_HFCLKSTART = 1;
+        while (NRF_CLOCK->EVENTS_HFCLKSTARTED == 0);
+
+        configureTransceiver();
+
+        NVIC_ClearPendingIRQ(RADIO_IRQn);
+        NVIC_EnableIRQ(RADIO_IRQn);
+
+        // Start listening for the next packet
+        startReceiver();
+    }
 
     // register ourselves for a callback event, in order to empty the receive queue.
-    fiber_add_idle_component(this);
+    // We're only called when a packet has been queued.
+    fiber_add_idle_component(this, MICROBIT_IDLE_COMPONENT_ON_DEMAND);
 
     // Done. Record that our RADIO is configured.
     status |= MICROBIT_RADIO_STATUS_INITIALISED;
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_RADIO, true);
 
     return MICROBIT_OK;
 }
@@ -364,29 +1033,43 @@ int MicroBitRadio::enable()
 /**
   * Disables the radio for use as a multipoint sender/receiver.
   *
-  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
   */
 int MicroBitRadio::disable()
 {
     // Only attempt to enable.disable the radio if the protocol is alreayd running.
-    if (ble_running())
+    if (ble_running() && !(status & MICROBIT_RADIO_STATUS_TIMESLOTS))
         return MICROBIT_NOT_SUPPORTED;
 
     if (!(status & MICROBIT_RADIO_STATUS_INITIALISED))
         return MICROBIT_OK;
 
-    // Disable interrupts and STOP any ongoing packet reception.
-    NVIC_DisableIRQ(RADIO_IRQn);
+    // Let queued packets go, then disable interrupts and STOP any ongoing packet reception.
+    waitForTransmit();
 
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+#if CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS)
+    if (status & MICROBIT_RADIO_STATUS_TIMESLOTS)
+    {
+        // No further timeslots are requested once we're no longer initialised. Wait for the current one to finish.
+        status &= ~MICROBIT_RADIO_STATUS_INITIALISED;
+        sd_radio_session_close();
+        while (inTimeslot);
+
+        status &= ~MICROBIT_RADIO_STATUS_TIMESLOTS;
+    }
+    else
+#endif
+    {
+        NVIC_DisableIRQ(RADIO_IRQn);
+        disableTransceiver();
+    }
 
     // deregister ourselves from the callback event used to empty the receive queue.
     fiber_remove_idle_component(this);
 
     // record that the radio is now disabled
     status &= ~MICROBIT_RADIO_STATUS_INITIALISED;
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_RADIO, false);
 
     return MICROBIT_OK;
 }
@@ -394,34 +1077,142 @@ int MicroBitRadio::disable()
 /**
   * Sets the radio to listen to packets sent with the given group id.
   *
-  * @param group The group to join. A micro:bit can only listen to one group ID at any time.
+  * @param group The group to join. Packets are sent to this group. Further groups may be listened to with addGroup().
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
   */
 int MicroBitRadio::setGroup(uint8_t group)
 {
-    if (ble_running())
+    if (ble_running() && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
         return MICROBIT_NOT_SUPPORTED;
 
     // Record our group id locally
     this->group = group;
+    this->groups[0] = group;
 
     // Also append it to the address of this device, to allow the RADIO module to filter for us.
-    NRF_RADIO->PREFIX0 = (uint32_t)group;
+    // When the RADIO module is shared, and we don't hold a timeslot, this is done at the start of the next one.
+    lock();
+
+    if (ownsTransceiver())
+        setAddresses();
+
+    unlock();
 
     return MICROBIT_OK;
 }
 
+/**
+  * Additionally listens to packets sent with the given group id.
+  *
+  * Groups are matched by the RADIO hardware, so packets from other groups never consume a receive buffer.
+  * Packets received are marked with the group they were sent to. Packets are still sent to the group given to setGroup().
+  *
+  * @param group The group to listen to.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_RESOURCES if this micro:bit is already listening to
+  *         MICROBIT_RADIO_MAX_GROUPS groups, or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+  *
+  * @code
+  * radio.setGroup(1);
+  * radio.addGroup(2);    // Receive from groups 1 and 2, and send to group 1.
+  * @endcode
+  */
+int MicroBitRadio::addGroup(uint8_t group)
+{
+    if (ble_running() && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
+        return MICROBIT_NOT_SUPPORTED;
+
+    int slot = -1;
+
+    for (int i = 1; i < MICROBIT_RADIO_MAX_GROUPS; i++)
+    {
+        if (groupMask & (1 << i))
+        {
+            if (groups[i] == group)
+                return MICROBIT_OK;
+        }
+        else if (slot < 0)
+        {
+            slot = i;
+        }
+    }
+
+    if (slot < 0)
+        return MICROBIT_NO_RESOURCES;
+
+    groups[slot] = group;
+    groupMask |= 1 << slot;
+
+    lock();
+
+    if (ownsTransceiver())
+        setAddresses();
+
+    unlock();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops listening to packets sent with the given group id, previously given to addGroup().
+  *
+  * @param group The group to stop listening to.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the group was not added with addGroup(),
+  *         or MICROBIT_NOT_SUPPORTED if the BLE stack is running and MICROBIT_RADIO_TIMESLOTS is not enabled.
+  */
+int MicroBitRadio::removeGroup(uint8_t group)
+{
+    if (ble_running() && !CONFIG_ENABLED(MICROBIT_RADIO_TIMESLOTS))
+        return MICROBIT_NOT_SUPPORTED;
+
+    for (int i = 1; i < MICROBIT_RADIO_MAX_GROUPS; i++)
+    {
+        if ((groupMask & (1 << i)) && groups[i] == group)
+        {
+            groupMask &= ~(1 << i);
+
+            lock();
+
+            if (ownsTransceiver())
+                setAddresses();
+
+            unlock();
+
+            return MICROBIT_OK;
+        }
+    }
+
+    return MICROBIT_INVALID_PARAMETER;
+}
+
+/**
+  * Programs the RADIO hardware to match the addresses of our group, and any groups added with addGroup().
+  */
+void MicroBitRadio::setAddresses()
+{
+    uint32_t prefix[2] = {0, 0};
+
+    // Each logical address is BASE0 (address 0) or BASE1 (addresses 1-7), prefixed by a byte of PREFIX0 or PREFIX1.
+    for (int i = 0; i < MICROBIT_RADIO_MAX_GROUPS; i++)
+        prefix[i / 4] |= (uint32_t)groups[i] << ((i % 4) * 8);
+
+    NRF_RADIO->PREFIX0 = prefix[0];
+    NRF_RADIO->PREFIX1 = prefix[1];
+    NRF_RADIO->RXADDRESSES = groupMask;
+}
+
 /**
   * A background, low priority callback that is triggered whenever the processor is idle.
   * Here, we empty our queue of received packets, and pass them onto higher level protocol handlers.
   */
 void MicroBitRadio::idleTick()
 {
-    // Walk the list of packets and process each one.
-    while(rxQueue)
+    // Walk the queue of packets and process each one.
+    while(rxTail != rxHead)
     {
-        FrameBuffer *p = rxQueue;
+        FrameBuffer *p = rxRing[rxTail];
 
         switch (p->protocol)
         {
@@ -433,15 +1224,29 @@ void MicroBitRadio::idleTick()
                 event.packetReceived();
                 break;
 
+            case MICROBIT_RADIO_PROTOCOL_BULK:
+                bulk.packetReceived();
+                break;
+
+            case MICROBIT_RADIO_PROTOCOL_RELIABLE:
+                reliable.packetReceived();
+                break;
+
+            case MICROBIT_RADIO_PROTOCOL_TIME:
+                time.packetReceived();
+                break;
+
             default:
                 MicroBitEvent(MICROBIT_ID_RADIO_DATA_READY, p->protocol);
         }
 
         // If the packet was processed, it will have been recv'd, and taken from the queue.
         // If this was a packet for an unknown protocol, it will still be there, so simply free it.
-        if (p == rxQueue)
+        if (rxTail != rxHead && p == rxRing[rxTail])
         {
-            recv();
+            if (recv() == NULL)
+                break;
+
             delete p;
         }
     }
@@ -454,7 +1259,9 @@ void MicroBitRadio::idleTick()
   */
 int MicroBitRadio::dataReady()
 {
-    return queueDepth;
+    int depth = rxHead - rxTail;
+
+    return depth < 0 ? depth + MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1 : depth;
 }
 
 /**
@@ -462,41 +1269,47 @@ int MicroBitRadio::dataReady()
   * If a data packet is available, then it will be returned immediately to
   * the caller. This call will also dequeue the buffer.
   *
-  * @return The buffer containing the the packet. If no data is available, NULL is returned.
+  * @return The buffer containing the the packet. If no data is available, or no memory is available to replace it, NULL is returned.
   *
   * @note Once recv() has been called, it is the callers responsibility to
   *       delete the buffer when appropriate.
   */
 FrameBuffer* MicroBitRadio::recv()
 {
-    FrameBuffer *p = rxQueue;
+    if (rxTail == rxHead)
+        return NULL;
 
-    if (p)
-    {
-         // Protect shared resource from ISR activity
-        NVIC_DisableIRQ(RADIO_IRQn); 
+    // The caller takes ownership of the packet, so give its slot in the ring a fresh buffer.
+    // This happens here, in thread context, rather than in the interrupt handler.
+    FrameBuffer *replacement = new FrameBuffer();
 
-        rxQueue = rxQueue->next;
-        queueDepth--;
+    if (replacement == NULL)
+        return NULL;
 
-        // Allow ISR access to shared resource
-        NVIC_EnableIRQ(RADIO_IRQn);
-    }
+    FrameBuffer *p = rxRing[rxTail];
+    rxRing[rxTail] = replacement;
+
+    // Only the interrupt handler moves the head, and it never uses the slot at the tail, so no locking is needed.
+    rxTail = rxTail == MICROBIT_RADIO_MAXIMUM_RX_BUFFERS ? 0 : rxTail + 1;
 
     return p;
 }
 
 /**
   * Transmits the given buffer onto the broadcast radio.
-  * The call will wait until the transmission of the packet has completed before returning.
+  *
+  * The packet is copied onto a queue that is sent from the radio interrupt, so the call returns
+  * as soon as there is space in the queue, without waiting for the packet to be sent.
   *
   * @param data The packet contents to transmit.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the radio is not enabled,
+  *         MICROBIT_NO_RESOURCES if the queue is full and we're in interrupt context,
+  *         or MICROBIT_BUSY if MICROBIT_RADIO_LISTEN_BEFORE_TALK is enabled and the channel was never clear.
   */
 int MicroBitRadio::send(FrameBuffer *buffer)
 {
-    if (ble_running())
+    if (ble_running() && !(status & MICROBIT_RADIO_STATUS_TIMESLOTS))
         return MICROBIT_NOT_SUPPORTED;
 
     if (buffer == NULL)
@@ -505,46 +1318,68 @@ int MicroBitRadio::send(FrameBuffer *buffer)
     if (buffer->length > MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
         return MICROBIT_INVALID_PARAMETER;
 
-    // Firstly, disable the Radio interrupt. We want to wait until the trasmission completes.
-    NVIC_DisableIRQ(RADIO_IRQn);
+#if CONFIG_ENABLED(MICROBIT_RADIO_LISTEN_BEFORE_TALK)
+    // Wait for the channel to fall quiet, backing off for a random, growing number of slots each time it is busy.
+    // We can only listen if the receiver is enabled, and has the RADIO module to itself.
+    for (int attempt = 1; (status & MICROBIT_RADIO_STATUS_INITIALISED) && !(status & MICROBIT_RADIO_STATUS_TIMESLOTS) && !isTransmitting() && !channelClear(); attempt++)
+    {
+        if (attempt > MICROBIT_RADIO_LBT_ATTEMPTS)
+        {
+            stats.channelBusy++;
+            return MICROBIT_BUSY;
+        }
 
-    // Turn off the transceiver.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+        wait_us((1 + microbit_random(1 << attempt)) * MICROBIT_RADIO_LBT_SLOT);
+    }
+#endif
 
-    // Configure the radio to send the buffer provided.
-    NRF_RADIO->PACKETPTR = (uint32_t) buffer;
+    if (!(status & MICROBIT_RADIO_STATUS_INITIALISED))
+        return MICROBIT_NOT_SUPPORTED;
 
-    // Turn on the transmitter, and wait for it to signal that it's ready to use.
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_TXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0);
+    // Wait for space in the queue. The radio interrupt empties it, so we can't wait in interrupt context.
+    while (txQueueLength >= MICROBIT_RADIO_TX_QUEUE_SIZE)
+    {
+        if (inInterruptContext())
+            return MICROBIT_NO_RESOURCES;
+    }
 
-    // Start transmission and wait for end of packet.
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
-    while(NRF_RADIO->EVENTS_END == 0);
+    // Take a copy, so the caller is free to reuse their buffer as soon as we return.
+    FrameBuffer *packet = new FrameBuffer();
 
-    // Return the radio to using the default receive buffer
-    NRF_RADIO->PACKETPTR = (uint32_t) rxBuf;
+    if (packet == NULL)
+        return MICROBIT_NO_RESOURCES;
 
-    // Turn off the transmitter.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+    // Only the bytes that go on air are copied. The caller's buffer may be no larger than that (see MicroBitRadioDatagram::send()).
+    memcpy(packet, buffer, buffer->length + 1);
+    packet->next = NULL;
 
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
+    // Protect shared resource from ISR activity
+    lock();
 
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    FrameBuffer **p = &txQueue;
+    while (*p != NULL)
+        p = &(*p)->next;
 
-    // Re-enable the Radio interrupt.
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
-    NVIC_EnableIRQ(RADIO_IRQn);
+    *p = packet;
+    txQueueLength++;
+
+    // If a packet has just been received, the radio interrupt will start transmission once it has been processed.
+    // Between timeslots, the packet is sent at the start of the next one.
+    if (ownsTransceiver() && !NRF_RADIO->EVENTS_END)
+        startTransmit();
+
+    // Allow ISR access to shared resource
+    unlock();
 
     return MICROBIT_OK;
 }
+
+/**
+  * Waits until every queued packet has been transmitted.
+  *
+  * @note this must not be called in interrupt context, or whilst the radio interrupt is disabled.
+  */
+void MicroBitRadio::waitForTransmit()
+{
+    while (txQueueLength > 0);
+}
@@ -0,0 +1,273 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+
+#if MICROBIT_RADIO_BULK_MAX_SIZE > MICROBIT_RADIO_BULK_MAX_FRAGMENTS * MICROBIT_RADIO_BULK_FRAGMENT_SIZE
+#error "MICROBIT_RADIO_BULK_MAX_SIZE is too large to be sent in MICROBIT_RADIO_BULK_MAX_FRAGMENTS fragments"
+#endif
+
+/**
+  * Provides the ability to broadcast messages larger than a single radio packet to other micro:bits in the vicinity.
+  *
+  * Messages of up to MICROBIT_RADIO_BULK_MAX_SIZE bytes are split into numbered fragments on transmission, and
+  * reassembled on reception. A MICROBIT_RADIO_EVT_BULK event is raised once all the fragments of a message have arrived.
+  *
+  * As packets carry no sender address, only one message is reassembled at a time. A message that is interrupted
+  * by the fragments of another is discarded.
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+
+/**
+  * A message, either complete or being reassembled.
+  */
+struct RadioBulkMessage
+{
+    RadioBulkMessage    *next;
+    int                 rssi;
+    uint16_t            length;
+    uint8_t             data[0];
+};
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitRadioBulk which offers the ability
+  * to broadcast messages larger than a single radio packet to other micro:bits in the vicinity.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioBulk::MicroBitRadioBulk(MicroBitRadio &r) : radio(r)
+{
+    this->txId = 0;
+    this->rxMessage = NULL;
+    this->rxId = 0;
+    this->rxMissing = 0;
+    this->rxQueue = NULL;
+    this->rxQueueLength = 0;
+}
+
+/**
+  * Destructor.
+  *
+  * Releases any messages that are queued or partially received.
+  */
+MicroBitRadioBulk::~MicroBitRadioBulk()
+{
+    free(rxMessage);
+
+    while (rxQueue)
+    {
+        RadioBulkMessage *m = rxQueue;
+        rxQueue = rxQueue->next;
+        free(m);
+    }
+}
+
+/**
+  * Retreives a complete message.
+  *
+  * If a message is already available, then it will be returned immediately to the caller
+  * in the form of a PacketBuffer.
+  *
+  * @return the message received, or an empty PacketBuffer if no message is available.
+  */
+PacketBuffer MicroBitRadioBulk::recv()
+{
+    if (rxQueue == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    RadioBulkMessage *m = rxQueue;
+    rxQueue = rxQueue->next;
+    rxQueueLength--;
+
+    PacketBuffer packet(m->data, m->length, m->rssi);
+
+    free(m);
+    return packet;
+}
+
+/**
+  * Transmits the given buffer onto the broadcast radio, as a series of fragments.
+  *
+  * The fragments are queued for transmission, so this call returns once the last has been
+  * queued, without waiting for it to be sent.
+  *
+  * @param buffer The message contents to transmit.
+  *
+  * @param len The number of bytes to transmit.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+  */
+int MicroBitRadioBulk::send(uint8_t *buffer, int len)
+{
+    if (buffer == NULL || len <= 0 || len > MICROBIT_RADIO_BULK_MAX_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    FrameBuffer buf;
+
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_BULK;
+
+    buf.payload[0] = ++txId;
+    buf.payload[2] = len & 0xFF;
+    buf.payload[3] = len >> 8;
+
+    for (int offset = 0, index = 0; offset < len; offset += MICROBIT_RADIO_BULK_FRAGMENT_SIZE, index++)
+    {
+        int l = min(len - offset, MICROBIT_RADIO_BULK_FRAGMENT_SIZE);
+
+        buf.length = l + MICROBIT_RADIO_BULK_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+        buf.payload[1] = index;
+        memcpy(buf.payload + MICROBIT_RADIO_BULK_HEADER_SIZE, buffer + offset, l);
+
+        int result = radio.send(&buf);
+
+        if (result != MICROBIT_OK)
+            return result;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Transmits the given PacketBuffer onto the broadcast radio, as a series of fragments.
+  *
+  * The fragments are queued for transmission, so this call returns once the last has been
+  * queued, without waiting for it to be sent.
+  *
+  * @param data The message contents to transmit.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+  */
+int MicroBitRadioBulk::send(PacketBuffer data)
+{
+    return send((uint8_t *)data.getBytes(), data.length());
+}
+
+/**
+  * Transmits the given string onto the broadcast radio, as a series of fragments.
+  *
+  * The fragments are queued for transmission, so this call returns once the last has been
+  * queued, without waiting for it to be sent.
+  *
+  * @param data The message contents to transmit.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_BULK_MAX_SIZE`.
+  */
+int MicroBitRadioBulk::send(ManagedString data)
+{
+    return send((uint8_t *)data.toCharArray(), data.length());
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as a bulk fragment.
+  *
+  * This function adds the fragment to the message being reassembled, and queues the message
+  * for user reception once it is complete.
+  */
+void MicroBitRadioBulk::packetReceived()
+{
+    FrameBuffer *packet = radio.recv();
+
+    if (packet == NULL)
+        return;
+
+    int l = packet->length - (MICROBIT_RADIO_HEADER_SIZE - 1) - MICROBIT_RADIO_BULK_HEADER_SIZE;
+    uint8_t id = packet->payload[0];
+    int index = packet->payload[1];
+    int length = packet->payload[2] | (packet->payload[3] << 8);
+    int offset = index * MICROBIT_RADIO_BULK_FRAGMENT_SIZE;
+    int fragments = (length + MICROBIT_RADIO_BULK_FRAGMENT_SIZE - 1) / MICROBIT_RADIO_BULK_FRAGMENT_SIZE;
+
+    // Discard anything malformed, or too large for us to hold.
+    if (l <= 0 || length == 0 || length > MICROBIT_RADIO_BULK_MAX_SIZE || index >= fragments || l != min(length - offset, MICROBIT_RADIO_BULK_FRAGMENT_SIZE))
+    {
+        delete packet;
+        return;
+    }
+
+    // A fragment of a different message abandons the one in progress.
+    if (rxMessage && (id != rxId || length != rxMessage->length))
+    {
+        free(rxMessage);
+        rxMessage = NULL;
+    }
+
+    if (rxMessage == NULL)
+    {
+        rxMessage = (RadioBulkMessage *) malloc(sizeof(RadioBulkMessage) + length);
+
+        if (rxMessage == NULL)
+        {
+            delete packet;
+            return;
+        }
+
+        rxMessage->next = NULL;
+        rxMessage->rssi = 0;
+        rxMessage->length = length;
+        rxId = id;
+        rxMissing = fragments == MICROBIT_RADIO_BULK_MAX_FRAGMENTS ? 0xFFFFFFFF : (1UL << fragments) - 1;
+    }
+
+    memcpy(rxMessage->data + offset, packet->payload + MICROBIT_RADIO_BULK_HEADER_SIZE, l);
+    rxMissing &= ~(1UL << index);
+
+    // Report the weakest signal seen across the fragments.
+    rxMessage->rssi = max(rxMessage->rssi, packet->rssi);
+
+    delete packet;
+
+    if (rxMissing)
+        return;
+
+    // The message is complete. Add it to the tail of the queue to preserve causal ordering, if there's space.
+    RadioBulkMessage *m = rxMessage;
+    rxMessage = NULL;
+
+    if (rxQueueLength >= MICROBIT_RADIO_BULK_QUEUE_SIZE)
+    {
+        free(m);
+        return;
+    }
+
+    RadioBulkMessage **p = &rxQueue;
+    while (*p != NULL)
+        p = &(*p)->next;
+
+    *p = m;
+    rxQueueLength++;
+
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_BULK);
+}
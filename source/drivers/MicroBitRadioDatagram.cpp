@@ -97,17 +97,23 @@ PacketBuffer MicroBitRadioDatagram::recv()
     FrameBuffer *p = rxQueue;
     rxQueue = rxQueue->next;
 
-    PacketBuffer packet(p->payload, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1), p->rssi);
+    // The frame was allocated with room ahead of it to complete a PacketData header, with the frame header
+    // sitting in its headroom, so the packet can simply adopt the frame rather than copy the payload out of it.
+    PacketData *data = (PacketData *)((uint8_t *)p - MICROBIT_RADIO_FRAME_HEADROOM);
+    int rssi = p->rssi;
 
-    delete p;
-    return packet;
+    data->init();
+    data->length = p->length - (MICROBIT_RADIO_HEADER_SIZE - 1);
+    data->rssi = rssi;
+
+    return PacketBuffer(data);
 }
 
 /**
   * Transmits the given buffer onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, so this call returns without waiting
+  * for it to be sent.
   *
   * @param buffer The packet contents to transmit.
   *
@@ -135,8 +141,8 @@ int MicroBitRadioDatagram::send(uint8_t *buffer, int len)
 /**
   * Transmits the given string onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, so this call returns without waiting
+  * for it to be sent.
   *
   * @param data The packet contents to transmit.
   *
@@ -145,14 +151,25 @@ int MicroBitRadioDatagram::send(uint8_t *buffer, int len)
   */
 int MicroBitRadioDatagram::send(PacketBuffer data)
 {
-    return send((uint8_t *)data.getBytes(), data.length());
+    if (data.length() > MICROBIT_RADIO_MAX_PACKET_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Lay the frame header out in the headroom ahead of the payload, so the radio can take the packet as it is.
+    FrameBuffer *buf = (FrameBuffer *) data.getHeadroom();
+
+    buf->length = data.length() + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf->version = 1;
+    buf->group = 0;
+    buf->protocol = MICROBIT_RADIO_PROTOCOL_DATAGRAM;
+
+    return radio.send(buf);
 }
 
 /**
   * Transmits the given string onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, so this call returns without waiting
+  * for it to be sent.
   *
   * @param data The packet contents to transmit.
   *
@@ -174,6 +191,9 @@ void MicroBitRadioDatagram::packetReceived()
     FrameBuffer *packet = radio.recv();
     int queueDepth = 0;
 
+    if (packet == NULL)
+        return;
+
     // We add to the tail of the queue to preserve causal ordering.
     packet->next = NULL;
 
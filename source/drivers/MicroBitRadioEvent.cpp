@@ -26,6 +26,10 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitRadio.h"
 
+#if MICROBIT_RADIO_EVENT_BATCH_SIZE * MICROBIT_RADIO_EVENT_PACKED_SIZE > MICROBIT_RADIO_MAX_PACKET_SIZE
+#error "MICROBIT_RADIO_EVENT_BATCH_SIZE events do not fit in a radio packet"
+#endif
+
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
  *
@@ -51,6 +55,7 @@ DEALINGS IN THE SOFTWARE.
 MicroBitRadioEvent::MicroBitRadioEvent(MicroBitRadio &r) : radio(r)
 {
     this->suppressForwarding = false;
+    this->batchLength = 0;
 }
 
 /**
@@ -139,15 +144,33 @@ int MicroBitRadioEvent::ignore(uint16_t id, uint16_t value, EventModel &eventBus
 /**
   * Protocol handler callback. This is called when the radio receives a packet marked as using the event protocol.
   *
-  * This function process this packet, and fires the event contained inside onto the default EventModel.
+  * This function process this packet, and fires the events contained inside onto the default EventModel, in the order they were sent.
   */
 void MicroBitRadioEvent::packetReceived()
 {
     FrameBuffer *p = radio.recv();
-    MicroBitEvent *e = (MicroBitEvent *) p->payload;
+
+    if (p == NULL)
+        return;
 
     suppressForwarding = true;
-    e->fire();
+
+    if (p->version == MICROBIT_RADIO_EVENT_BATCH_VERSION)
+    {
+        int count = (p->length - (MICROBIT_RADIO_HEADER_SIZE - 1)) / MICROBIT_RADIO_EVENT_PACKED_SIZE;
+
+        for (int i = 0; i < count; i++)
+        {
+            uint8_t *packed = p->payload + i * MICROBIT_RADIO_EVENT_PACKED_SIZE;
+            MicroBitEvent(packed[0] | (packed[1] << 8), packed[2] | (packed[3] << 8));
+        }
+    }
+    else
+    {
+        MicroBitEvent *e = (MicroBitEvent *) p->payload;
+        e->fire();
+    }
+
     suppressForwarding = false;
 
     delete p;
@@ -157,12 +180,44 @@ void MicroBitRadioEvent::packetReceived()
   * Event handler callback. This is called whenever an event is received matching one of those registered through
   * the registerEvent() method described above. Upon receiving such an event, it is wrapped into
   * a radio packet and transmitted to any other micro:bits in the same group.
+  * Events that follow within MICROBIT_RADIO_EVENT_BATCH_WINDOW microseconds share the same packet.
   */
 void MicroBitRadioEvent::eventReceived(MicroBitEvent e)
 {
     if(suppressForwarding)
         return;
 
+    if (MICROBIT_RADIO_EVENT_BATCH_WINDOW > 0)
+    {
+        // We may be called in interrupt context, so add the event to the batch in a critical section.
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        if (batchLength < MICROBIT_RADIO_EVENT_BATCH_SIZE)
+        {
+            uint8_t *packed = batch + batchLength * MICROBIT_RADIO_EVENT_PACKED_SIZE;
+
+            packed[0] = e.source & 0xFF;
+            packed[1] = e.source >> 8;
+            packed[2] = e.value & 0xFF;
+            packed[3] = e.value >> 8;
+
+            batchLength++;
+        }
+
+        int length = batchLength;
+
+        __set_PRIMASK(primask);
+
+        // Send a full batch straight away. Otherwise, give further events a chance to join the first.
+        if (length == MICROBIT_RADIO_EVENT_BATCH_SIZE)
+            sendBatch();
+        else if (length == 1)
+            system_timer_event_after_us(&batchTimer, MICROBIT_RADIO_EVENT_BATCH_WINDOW, system_timer_method_callback<MicroBitRadioEvent, &MicroBitRadioEvent::sendBatch>, this);
+
+        return;
+    }
+
     FrameBuffer buf;
 
     buf.length = sizeof(MicroBitEvent) + MICROBIT_RADIO_HEADER_SIZE - 1;
@@ -173,3 +228,32 @@ void MicroBitRadioEvent::eventReceived(MicroBitEvent e)
 
     radio.send(&buf);
 }
+
+/**
+  * Transmits any events awaiting transmission as a single frame.
+  */
+void MicroBitRadioEvent::sendBatch()
+{
+    FrameBuffer buf;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    int length = batchLength;
+    memcpy(buf.payload, batch, length * MICROBIT_RADIO_EVENT_PACKED_SIZE);
+    batchLength = 0;
+
+    __set_PRIMASK(primask);
+
+    system_timer_cancel_event(&batchTimer);
+
+    if (length == 0)
+        return;
+
+    buf.length = length * MICROBIT_RADIO_EVENT_PACKED_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = MICROBIT_RADIO_EVENT_BATCH_VERSION;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_EVENTBUS;
+
+    radio.send(&buf);
+}
@@ -0,0 +1,456 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitFiber.h"
+#include "MicroBitDevice.h"
+#include "EventModel.h"
+
+/**
+  * Provides an acknowledged, ordered stream of packets between two micro:bits, built upon MicroBitRadio.
+  *
+  * Up to MICROBIT_RADIO_RELIABLE_WINDOW packets may be awaiting acknowledgement at once, so a sender can keep
+  * transmitting without waiting a round trip for each packet. If the oldest unacknowledged packet is not acknowledged
+  * within MICROBIT_RADIO_RELIABLE_TIMEOUT microseconds, every unacknowledged packet is sent again (go-back-N).
+  * The receiver only accepts packets in order, and acknowledges each packet it sees with the next sequence number it
+  * expects, so the acknowledgement of a later packet also covers any earlier ones whose acknowledgements were lost.
+  *
+  * The protocol has no addressing, so it is intended for use between exactly two micro:bits. Use a radio group
+  * that no other micro:bits share to keep other traffic off the link.
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitRadioReliable which offers an acknowledged, ordered stream
+  * of packets to another micro:bit.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioReliable::MicroBitRadioReliable(MicroBitRadio &r) : radio(r)
+{
+    this->listening = false;
+
+    this->txHead = 0;
+    this->txCount = 0;
+    this->txBase = 0;
+    this->txSession = 0;
+    this->txRetries = 0;
+    this->txSynced = false;
+    this->txFailed = false;
+
+    this->rxQueue = NULL;
+    this->rxQueueLength = 0;
+    this->rxExpected = 0;
+    this->rxSession = 0;
+    this->rxSynced = false;
+}
+
+/**
+  * Destructor.
+  *
+  * Releases any packets awaiting acknowledgement or reception.
+  */
+MicroBitRadioReliable::~MicroBitRadioReliable()
+{
+    system_timer_cancel_event(&retransmitTimer);
+
+    if (listening && EventModel::defaultEventBus)
+        EventModel::defaultEventBus->ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_TIMEOUT, this, &MicroBitRadioReliable::retransmit);
+
+    while (txCount)
+    {
+        delete txWindow[txHead];
+        txHead = (txHead + 1) % MICROBIT_RADIO_RELIABLE_WINDOW;
+        txCount--;
+    }
+
+    while (rxQueue)
+    {
+        FrameBuffer *p = rxQueue;
+        rxQueue = rxQueue->next;
+        delete p;
+    }
+}
+
+/**
+  * Registers our handlers with the default EventModel, and starts a new session, if that hasn't already been done.
+  */
+void MicroBitRadioReliable::init()
+{
+    if (listening || EventModel::defaultEventBus == NULL)
+        return;
+
+    EventModel::defaultEventBus->listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_TIMEOUT, this, &MicroBitRadioReliable::retransmit);
+    listening = true;
+
+    // A random session id lets our peer tell that we have restarted, and not mistake our packets for retransmissions.
+    txSession = microbit_random(256);
+}
+
+/**
+  * Retreives the next packet received, in the order sent.
+  *
+  * If a packet is already available, then it will be returned immediately to the caller
+  * in the form of a PacketBuffer.
+  *
+  * @return the data received, or an empty PacketBuffer if no data is available.
+  */
+PacketBuffer MicroBitRadioReliable::recv()
+{
+    if (rxQueue == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    FrameBuffer *p = rxQueue;
+    rxQueue = rxQueue->next;
+    rxQueueLength--;
+
+    PacketBuffer packet(p->payload + MICROBIT_RADIO_RELIABLE_HEADER_SIZE, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1) - MICROBIT_RADIO_RELIABLE_HEADER_SIZE, p->rssi);
+
+    delete p;
+    return packet;
+}
+
+/**
+  * Transmits the given buffer to the other micro:bit.
+  *
+  * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+  * the calling fiber is blocked until an acknowledgement makes room for it.
+  *
+  * @param buffer The packet contents to transmit.
+  *
+  * @param len The number of bytes to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+  *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+  *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  */
+int MicroBitRadioReliable::send(uint8_t *buffer, int len)
+{
+    if (buffer == NULL || len < 0 || len > MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (ble_running())
+        return MICROBIT_NOT_SUPPORTED;
+
+    // Without listening for timeouts, we can't retransmit.
+    init();
+
+    if (!listening)
+        return MICROBIT_NOT_SUPPORTED;
+
+    while (txCount == MICROBIT_RADIO_RELIABLE_WINDOW)
+    {
+        if (!fiber_scheduler_running())
+            return MICROBIT_BUSY;
+
+        fiber_wait_for_event(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_ACK);
+    }
+
+    FrameBuffer *packet = new FrameBuffer();
+
+    packet->length = len + MICROBIT_RADIO_RELIABLE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    packet->version = 1;
+    packet->group = 0;
+    packet->protocol = MICROBIT_RADIO_PROTOCOL_RELIABLE;
+    packet->payload[0] = txSynced ? 0 : MICROBIT_RADIO_RELIABLE_FLAG_SYNC;
+    packet->payload[1] = txSession;
+    packet->payload[2] = txBase + txCount;
+    memcpy(packet->payload + MICROBIT_RADIO_RELIABLE_HEADER_SIZE, buffer, len);
+
+    int result = radio.send(packet);
+
+    if (result != MICROBIT_OK)
+    {
+        delete packet;
+        return result;
+    }
+
+    txWindow[(txHead + txCount) % MICROBIT_RADIO_RELIABLE_WINDOW] = packet;
+    txCount++;
+
+    // Start the clock on the oldest packet.
+    if (txCount == 1)
+        system_timer_event_after_us(&retransmitTimer, retransmitTimeout(), system_timer_method_callback<MicroBitRadioReliable, &MicroBitRadioReliable::timeout>, this);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Transmits the given PacketBuffer to the other micro:bit.
+  *
+  * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+  * the calling fiber is blocked until an acknowledgement makes room for it.
+  *
+  * @param data The packet contents to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+  *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+  *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  */
+int MicroBitRadioReliable::send(PacketBuffer data)
+{
+    return send((uint8_t *)data.getBytes(), data.length());
+}
+
+/**
+  * Transmits the given string to the other micro:bit.
+  *
+  * The packet is transmitted immediately, and is retransmitted until acknowledged. If the transmit window is full,
+  * the calling fiber is blocked until an acknowledgement makes room for it.
+  *
+  * @param data The packet contents to transmit.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid or the number of bytes to
+  *         transmit is greater than `MICROBIT_RADIO_RELIABLE_PAYLOAD_SIZE`, MICROBIT_BUSY if the window is full and
+  *         the scheduler is not running, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  */
+int MicroBitRadioReliable::send(ManagedString data)
+{
+    return send((uint8_t *)data.toCharArray(), data.length());
+}
+
+/**
+  * Blocks the calling fiber until every packet sent has been acknowledged, or abandoned.
+  *
+  * @return MICROBIT_OK if every packet sent since the last call to flush() was acknowledged, MICROBIT_CANCELLED if
+  *         any were abandoned after MICROBIT_RADIO_RELIABLE_RETRIES attempts, or MICROBIT_BUSY if the scheduler is not running.
+  */
+int MicroBitRadioReliable::flush()
+{
+    while (txCount)
+    {
+        if (!fiber_scheduler_running())
+            return MICROBIT_BUSY;
+
+        fiber_wait_for_event(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_ACK);
+    }
+
+    int result = txFailed ? MICROBIT_CANCELLED : MICROBIT_OK;
+    txFailed = false;
+
+    return result;
+}
+
+/**
+  * Determines the number of packets sent that are yet to be acknowledged.
+  *
+  * @return the number of packets in the transmit window.
+  */
+int MicroBitRadioReliable::pending()
+{
+    return txCount;
+}
+
+/**
+  * Determines how long to wait for an acknowledgement before retransmitting.
+  *
+  * @return MICROBIT_RADIO_RELIABLE_TIMEOUT, lengthened in proportion to the airtime of a packet at data rates below 1Mbit.
+  */
+uint32_t MicroBitRadioReliable::retransmitTimeout()
+{
+    int rate = radio.getDataRate();
+
+    if (rate >= MICROBIT_RADIO_DATA_RATE_1MBIT)
+        return MICROBIT_RADIO_RELIABLE_TIMEOUT;
+
+    return (uint32_t) MICROBIT_RADIO_RELIABLE_TIMEOUT * MICROBIT_RADIO_DATA_RATE_1MBIT / rate;
+}
+
+/**
+  * Transmits an acknowledgement of the packets received so far.
+  */
+void MicroBitRadioReliable::sendAck()
+{
+    FrameBuffer ack;
+
+    ack.length = MICROBIT_RADIO_RELIABLE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    ack.version = 1;
+    ack.group = 0;
+    ack.protocol = MICROBIT_RADIO_PROTOCOL_RELIABLE;
+    ack.payload[0] = MICROBIT_RADIO_RELIABLE_FLAG_ACK;
+    ack.payload[1] = rxSession;
+    ack.payload[2] = rxExpected;
+
+    radio.send(&ack);
+}
+
+/**
+  * Processes an acknowledgement, removing the packets it covers from the transmit window.
+  *
+  * @param session The session id the acknowledgement refers to.
+  *
+  * @param next The sequence number the receiver expects next.
+  */
+void MicroBitRadioReliable::ackReceived(uint8_t session, uint8_t next)
+{
+    uint8_t acked = next - txBase;
+
+    // Ignore acknowledgements of an earlier session, and duplicates that make no progress.
+    if (session != txSession || acked == 0 || acked > txCount)
+        return;
+
+    while (acked--)
+    {
+        delete txWindow[txHead];
+        txHead = (txHead + 1) % MICROBIT_RADIO_RELIABLE_WINDOW;
+        txCount--;
+    }
+
+    txBase = next;
+    txRetries = 0;
+    txSynced = true;
+
+    // Restart the clock on the new oldest packet, if there is one.
+    if (txCount)
+        system_timer_event_after_us(&retransmitTimer, retransmitTimeout(), system_timer_method_callback<MicroBitRadioReliable, &MicroBitRadioReliable::timeout>, this);
+    else
+        system_timer_cancel_event(&retransmitTimer);
+
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_ACK);
+}
+
+/**
+  * Abandons every unacknowledged packet, and starts a new session.
+  */
+void MicroBitRadioReliable::abandon()
+{
+    while (txCount)
+    {
+        delete txWindow[txHead];
+        txHead = (txHead + 1) % MICROBIT_RADIO_RELIABLE_WINDOW;
+        txCount--;
+    }
+
+    // The receiver can't accept anything after the packets it missed, so restart the sequence.
+    txSession++;
+    txBase = 0;
+    txRetries = 0;
+    txSynced = false;
+    txFailed = true;
+
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_FAILED);
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_ACK);
+}
+
+/**
+  * Timer callback, made in interrupt context when the oldest unacknowledged packet is overdue.
+  */
+void MicroBitRadioReliable::timeout()
+{
+    // Transmitting spins until the radio is done, so leave that to the scheduler.
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE_TIMEOUT);
+}
+
+/**
+  * Event handler, called from the scheduler to resend the transmit window after a timeout.
+  */
+void MicroBitRadioReliable::retransmit(MicroBitEvent)
+{
+    if (txCount == 0)
+        return;
+
+    if (++txRetries > MICROBIT_RADIO_RELIABLE_RETRIES || ble_running())
+    {
+        abandon();
+        return;
+    }
+
+    for (int i = 0; i < txCount; i++)
+        radio.send(txWindow[(txHead + i) % MICROBIT_RADIO_RELIABLE_WINDOW]);
+
+    system_timer_event_after_us(&retransmitTimer, retransmitTimeout(), system_timer_method_callback<MicroBitRadioReliable, &MicroBitRadioReliable::timeout>, this);
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as reliable.
+  *
+  * This function processes acknowledgements, and acknowledges and queues data packets for user reception.
+  */
+void MicroBitRadioReliable::packetReceived()
+{
+    FrameBuffer *packet = radio.recv();
+
+    if (packet == NULL)
+        return;
+
+    if (packet->length < MICROBIT_RADIO_RELIABLE_HEADER_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
+    {
+        delete packet;
+        return;
+    }
+
+    uint8_t flags = packet->payload[0];
+    uint8_t session = packet->payload[1];
+    uint8_t seq = packet->payload[2];
+
+    if (flags & MICROBIT_RADIO_RELIABLE_FLAG_ACK)
+    {
+        ackReceived(session, seq);
+        delete packet;
+        return;
+    }
+
+    // A new session either starts from zero, or is one we joined part way through (e.g. after we restarted).
+    if (!rxSynced || session != rxSession)
+    {
+        rxSession = session;
+        rxExpected = (flags & MICROBIT_RADIO_RELIABLE_FLAG_SYNC) ? 0 : seq;
+        rxSynced = true;
+    }
+
+    // Accept only the next packet in sequence, and only if we have room for it.
+    // Anything else is discarded, and our acknowledgement tells the sender where to resume.
+    bool accepted = seq == rxExpected && rxQueueLength < MICROBIT_RADIO_RELIABLE_QUEUE_SIZE;
+
+    if (accepted)
+    {
+        rxExpected++;
+
+        // We add to the tail of the queue to preserve causal ordering.
+        packet->next = NULL;
+
+        FrameBuffer **p = &rxQueue;
+        while (*p != NULL)
+            p = &(*p)->next;
+
+        *p = packet;
+        rxQueueLength++;
+    }
+    else
+    {
+        delete packet;
+    }
+
+    sendAck();
+
+    if (accepted)
+        MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_RELIABLE);
+}
@@ -0,0 +1,381 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitRadio.h"
+#include "MicroBitDevice.h"
+#include "EventModel.h"
+
+/**
+  * Provides a network clock shared by a group of micro:bits, built upon MicroBitRadio.
+  *
+  * One micro:bit acts as the reference, and its system time is the network time. It broadcasts a beacon every
+  * MICROBIT_RADIO_TIME_BEACON_PERIOD microseconds. Each frame is timestamped by the radio interrupt as its address goes
+  * by, which happens at the same moment at the sender and every receiver, so the time taken to queue, send and process
+  * the beacon doesn't matter. The sender can't know when a beacon went until it has been sent, so each beacon carries the
+  * time at which the previous one was sent. Followers compare this with the time they received the previous beacon to
+  * learn the offset between their clock and the reference's, and the change in offset over successive beacons to learn
+  * the drift between them.
+  *
+  * Timestamps are taken from the system timer, so their resolution is that of the system timer (approximately 30us).
+  *
+  * @note This API does not contain any form of encryption, authentication or authorisation. Its purpose is solely for use as a
+  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
+  * For serious applications, BLE should be considered a substantially more secure alternative.
+  */
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of MicroBitRadioTime, which maintains a network clock shared with other micro:bits.
+  *
+  * @param r The underlying radio module used to send and receive data.
+  */
+MicroBitRadioTime::MicroBitRadioTime(MicroBitRadio &r) : radio(r)
+{
+    this->listening = false;
+    this->isReference = false;
+    this->synchronised = false;
+
+    this->txSeq = 0;
+    this->txSentSeq = 0;
+    this->txSentTime = 0;
+    this->txSent = false;
+
+    this->referenceId = 0;
+    this->rxSeq = 0;
+    this->rxValid = false;
+    this->rxTime = 0;
+
+    this->syncTime = 0;
+    this->offset = 0;
+    this->skew = 0;
+    this->skewValid = false;
+}
+
+/**
+  * Destructor.
+  *
+  * Stops sending beacons.
+  */
+MicroBitRadioTime::~MicroBitRadioTime()
+{
+    system_timer_cancel_event(&beaconTimer);
+
+    if (listening && EventModel::defaultEventBus)
+        EventModel::defaultEventBus->ignore(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_TIME_BEACON, this, &MicroBitRadioTime::sendBeacon);
+}
+
+/**
+  * Registers our handlers with the default EventModel, if that hasn't already been done.
+  */
+void MicroBitRadioTime::init()
+{
+    if (listening || EventModel::defaultEventBus == NULL)
+        return;
+
+    EventModel::defaultEventBus->listen(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_TIME_BEACON, this, &MicroBitRadioTime::sendBeacon);
+    listening = true;
+}
+
+/**
+  * Extends a timestamp taken by the radio interrupt to a 64 bit system time.
+  *
+  * @param timestamp The low 32 bits of the system time, no more than 71 minutes ago.
+  *
+  * @return The system time, in microseconds.
+  */
+uint64_t MicroBitRadioTime::extendTime(uint32_t timestamp)
+{
+    uint64_t now = system_timer_current_time_us();
+
+    return now - (uint32_t)((uint32_t)now - timestamp);
+}
+
+/**
+  * Starts keeping network time, and turns on radio timestamping. The radio should also be enabled.
+  *
+  * @param reference true if this micro:bit's system time is to be the network time. It then sends beacons for
+  *        others to synchronise to. Otherwise, we follow the first reference we hear.
+  *
+  * @return MICROBIT_OK on success.
+  *
+  * @code
+  * radio.enable();
+  * radio.time.enable(true);    // on one micro:bit
+  * radio.time.enable();        // on the rest
+  * @endcode
+  */
+int MicroBitRadioTime::enable(bool reference)
+{
+    disable();
+
+    radio.setTimestamping(true);
+
+    isReference = reference;
+
+    if (isReference)
+    {
+        // Sending spins until the radio is done, so leave that to the scheduler.
+        init();
+        system_timer_event_after_us(&beaconTimer, MICROBIT_RADIO_TIME_BEACON_PERIOD, system_timer_method_callback<MicroBitRadioTime, &MicroBitRadioTime::beaconDue>, this);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops keeping network time, and sending beacons.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadioTime::disable()
+{
+    system_timer_cancel_event(&beaconTimer);
+    radio.setTimestamping(false);
+
+    isReference = false;
+    synchronised = false;
+    txSent = false;
+    rxValid = false;
+    skewValid = false;
+    referenceId = 0;
+    offset = 0;
+    skew = 0;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines if our network time is valid.
+  *
+  * @return true if we are the reference, or have heard from our reference within the last
+  *         MICROBIT_RADIO_TIME_TIMEOUT beacon periods.
+  */
+bool MicroBitRadioTime::isSynchronised()
+{
+    if (isReference)
+        return true;
+
+    if (synchronised && system_timer_current_time_us() - rxTime > (uint64_t) MICROBIT_RADIO_TIME_TIMEOUT * MICROBIT_RADIO_TIME_BEACON_PERIOD)
+        synchronised = false;
+
+    return synchronised;
+}
+
+/**
+  * Retrieves the serial number of the micro:bit whose clock we follow.
+  *
+  * @return The serial number of our reference, or 0 if we are not synchronised.
+  */
+uint32_t MicroBitRadioTime::getReference()
+{
+    if (isReference)
+        return microbit_serial_number();
+
+    return isSynchronised() ? referenceId : 0;
+}
+
+/**
+  * Converts a system time to network time.
+  *
+  * @param time A system time, as returned by system_timer_current_time_us().
+  *
+  * @return The network time at that moment, in microseconds. Until we have synchronised, this is the system time.
+  */
+uint64_t MicroBitRadioTime::toNetworkTime(uint64_t time)
+{
+    if (isReference || !synchronised)
+        return time;
+
+    // Follow the offset measured at the last synchronisation, plus the drift since.
+    int64_t elapsed = (int64_t)(time - syncTime);
+
+    return time + offset + ((elapsed * skew) >> 24);
+}
+
+/**
+  * Determines the network time.
+  *
+  * @return The network time in microseconds. Until we have synchronised, this is the system time.
+  */
+uint64_t MicroBitRadioTime::currentTimeUs()
+{
+    return toNetworkTime(system_timer_current_time_us());
+}
+
+/**
+  * Determines the network time.
+  *
+  * @return The network time in milliseconds. Until we have synchronised, this is the system time.
+  */
+uint64_t MicroBitRadioTime::currentTime()
+{
+    return currentTimeUs() / 1000;
+}
+
+/**
+  * Timer callback, made in interrupt context when the next beacon is due.
+  */
+void MicroBitRadioTime::beaconDue()
+{
+    MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_TIME_BEACON);
+}
+
+/**
+  * Event handler, called from the scheduler to send a beacon.
+  */
+void MicroBitRadioTime::sendBeacon(MicroBitEvent)
+{
+    if (!isReference)
+        return;
+
+    FrameBuffer buf;
+    uint32_t id = microbit_serial_number();
+
+    buf.length = MICROBIT_RADIO_TIME_BEACON_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_TIME;
+
+    memcpy(&buf.payload[0], &id, sizeof(id));
+    buf.payload[4] = txSeq;
+    buf.payload[5] = 0;
+    memclr(&buf.payload[6], sizeof(uint64_t));
+
+    // Tell our followers when the previous beacon went, if it went.
+    if (txSent && txSentSeq == (uint8_t)(txSeq - 1))
+    {
+        uint64_t sent = extendTime(txSentTime);
+
+        buf.payload[5] = MICROBIT_RADIO_TIME_FLAG_PREVIOUS;
+        memcpy(&buf.payload[6], &sent, sizeof(sent));
+    }
+
+    if (radio.send(&buf) == MICROBIT_OK)
+        txSeq++;
+
+    system_timer_event_after_us(&beaconTimer, MICROBIT_RADIO_TIME_BEACON_PERIOD, system_timer_method_callback<MicroBitRadioTime, &MicroBitRadioTime::beaconDue>, this);
+}
+
+/**
+  * Records the time at which a beacon was sent.
+  *
+  * @param packet The beacon.
+  *
+  * @param timestamp The low 32 bits of the system time at which its address was sent.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+void MicroBitRadioTime::beaconSent(FrameBuffer *packet, uint32_t timestamp)
+{
+    if (packet->length < MICROBIT_RADIO_TIME_BEACON_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
+        return;
+
+    txSentSeq = packet->payload[4];
+    txSentTime = timestamp;
+    txSent = true;
+}
+
+/**
+  * Protocol handler callback. This is called when the radio receives a packet marked as a time beacon.
+  *
+  * This function synchronises our network clock with the reference.
+  */
+void MicroBitRadioTime::packetReceived()
+{
+    FrameBuffer *packet = radio.recv();
+
+    if (packet == NULL)
+        return;
+
+    uint32_t id;
+    uint64_t sent;
+    uint8_t seq = packet->payload[4];
+    uint8_t flags = packet->payload[5];
+    bool valid = packet->length >= MICROBIT_RADIO_TIME_BEACON_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1;
+    uint64_t received = extendTime(packet->timestamp);
+
+    memcpy(&id, &packet->payload[0], sizeof(id));
+    memcpy(&sent, &packet->payload[6], sizeof(sent));
+    delete packet;
+
+    if (!valid || isReference)
+        return;
+
+    // Follow the first reference we hear, until it falls silent.
+    if (id != referenceId)
+    {
+        if (isSynchronised())
+            return;
+
+        referenceId = id;
+        rxValid = false;
+        skewValid = false;
+        skew = 0;
+    }
+
+    // The beacon tells us when the reference sent the previous beacon. If we received that one too, the difference is our offset.
+    if (rxValid && seq == (uint8_t)(rxSeq + 1) && (flags & MICROBIT_RADIO_TIME_FLAG_PREVIOUS))
+    {
+        int64_t measured = (int64_t)(sent - rxTime);
+
+        // The change in offset since the last synchronisation tells us how fast the reference's clock runs against ours.
+        if (synchronised)
+        {
+            int64_t elapsed = (int64_t)(rxTime - syncTime);
+
+            if (elapsed > 0)
+            {
+                int64_t s = ((measured - offset) << 24) / elapsed;
+
+                // A larger change means the reference has restarted, so start measuring again.
+                if (s > MICROBIT_RADIO_TIME_MAX_SKEW || s < -MICROBIT_RADIO_TIME_MAX_SKEW)
+                {
+                    skew = 0;
+                    skewValid = false;
+                }
+                else
+                {
+                    skew = skewValid ? skew + (((int32_t)s - skew) >> 2) : (int32_t)s;
+                    skewValid = true;
+                }
+            }
+        }
+
+        bool first = !synchronised;
+
+        offset = measured;
+        syncTime = rxTime;
+        synchronised = true;
+
+        if (first)
+            MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_TIME_SYNC);
+    }
+
+    rxSeq = seq;
+    rxTime = received;
+    rxValid = true;
+}
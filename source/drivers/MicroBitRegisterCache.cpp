@@ -0,0 +1,222 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitRegisterCache.
+  *
+  * Wraps the register accesses of a single I2C sensor, keeping a shadow copy of the control registers written
+  * through it, so that redundant writes can be skipped.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitRegisterCache.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * @param _i2c The I2C interface the device is attached to.
+  *
+  * @param address The 8-bit I2C address of the device.
+  *
+  * @param autoIncrement Bits to set in the register address of multi-byte transfers, for devices
+  *        that only auto-increment when asked to (e.g. 0x80 for the LSM303). Defaults to 0.
+  */
+MicroBitRegisterCache::MicroBitRegisterCache(MicroBitI2C &_i2c, uint16_t address, uint8_t autoIncrement) : i2c(_i2c)
+{
+    this->address = address;
+    this->autoIncrement = autoIncrement;
+    this->count = 0;
+}
+
+/**
+  * Looks up the shadow copy of a register.
+  *
+  * @param r The address of the register.
+  *
+  * @return the index of the shadow copy, or -1 if the register is not shadowed.
+  */
+int MicroBitRegisterCache::find(uint8_t r)
+{
+    for (int i = 0; i < count; i++)
+        if (reg[i] == r)
+            return i;
+
+    return -1;
+}
+
+/**
+  * Records the value last written to a register, if space allows.
+  *
+  * @param r The address of the register.
+  *
+  * @param v The value written.
+  */
+void MicroBitRegisterCache::store(uint8_t r, uint8_t v)
+{
+    int i = find(r);
+
+    if (i < 0)
+    {
+        // Once full, further registers are simply written through.
+        if (count == MICROBIT_I2C_REGISTER_CACHE_SIZE)
+            return;
+
+        i = count++;
+        reg[i] = r;
+    }
+
+    value[i] = v;
+}
+
+/**
+  * Stops shadowing a register, whose contents are no longer known.
+  *
+  * @param r The address of the register.
+  */
+void MicroBitRegisterCache::forget(uint8_t r)
+{
+    int i = find(r);
+
+    if (i < 0)
+        return;
+
+    count--;
+    reg[i] = reg[count];
+    value[i] = value[count];
+}
+
+/**
+  * Writes a control register, unless it is already known to hold the given value.
+  *
+  * @param r The address of the register.
+  *
+  * @param v The value to write.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the write failed.
+  */
+int MicroBitRegisterCache::writeRegister(uint8_t r, uint8_t v)
+{
+    int i = find(r);
+
+    if (i >= 0 && value[i] == v)
+        return MICROBIT_OK;
+
+    if (i2c.writeRegister(address, r, v) != MICROBIT_OK)
+    {
+        forget(r);
+        return MICROBIT_I2C_ERROR;
+    }
+
+    store(r, v);
+    return MICROBIT_OK;
+}
+
+/**
+  * Writes a run of consecutive control registers. Only the span of registers whose contents would
+  * change is written, in a single transaction.
+  *
+  * @param r The address of the first register.
+  *
+  * @param values The value to write to each register.
+  *
+  * @param length The number of registers to write.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the write failed.
+  */
+int MicroBitRegisterCache::writeRegisters(uint8_t r, const uint8_t *values, int length)
+{
+    int first = 0;
+    int last = length - 1;
+    int i;
+
+    if (values == NULL || length <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Trim the registers at either end that already hold the values requested.
+    while (first <= last && (i = find(r + first)) >= 0 && value[i] == values[first])
+        first++;
+
+    while (last > first && (i = find(r + last)) >= 0 && value[i] == values[last])
+        last--;
+
+    if (first > last)
+        return MICROBIT_OK;
+
+    if (first == last)
+        return writeRegister(r + first, values[first]);
+
+    MicroBitI2CTransfer transfer;
+    int result = i2c.writeRegisterAsync(transfer, address, (r + first) | autoIncrement, (uint8_t *) &values[first], last - first + 1);
+
+    if (result == MICROBIT_OK)
+        result = i2c.wait(transfer);
+
+    for (i = first; i <= last; i++)
+    {
+        if (result == MICROBIT_OK)
+            store(r + i, values[i]);
+        else
+            forget(r + i);
+    }
+
+    return result == MICROBIT_OK ? MICROBIT_OK : MICROBIT_I2C_ERROR;
+}
+
+/**
+  * Reads a run of consecutive registers from the device, in a single transaction.
+  *
+  * @param r The address of the first register.
+  *
+  * @param buffer Memory area to read the data into.
+  *
+  * @param length The number of registers to read.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read failed.
+  */
+int MicroBitRegisterCache::readRegisters(uint8_t r, uint8_t *buffer, int length)
+{
+    return i2c.readRegister(address, length > 1 ? r | autoIncrement : r, buffer, length);
+}
+
+/**
+  * Reads a single register from the device.
+  *
+  * @param r The address of the register.
+  *
+  * @return the byte read on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read failed.
+  */
+int MicroBitRegisterCache::readRegister(uint8_t r)
+{
+    return i2c.readRegister(address, r);
+}
+
+/**
+  * Discards the shadow copy of every register, so that each is written again on next use.
+  * Call this whenever the device may have been reset.
+  */
+void MicroBitRegisterCache::invalidate()
+{
+    count = 0;
+}
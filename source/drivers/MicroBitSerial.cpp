@@ -32,8 +32,21 @@ DEALINGS IN THE SOFTWARE.
 
 uint8_t MicroBitSerial::status = 0;
 
+FiberLock MicroBitSerial::rxLock;
+
+FiberLock MicroBitSerial::txLock;
+
 int MicroBitSerial::baudrate = 0;
 
+/**
+  * A complete frame received while framing is enabled, followed in memory by its data.
+  */
+struct SerialFrame
+{
+    SerialFrame *next;
+    uint16_t length;
+};
+
 /**
   * Constructor.
   * Create an instance of MicroBitSerial
@@ -42,9 +55,9 @@ int MicroBitSerial::baudrate = 0;
   *
   * @param rx the Pin to be used for receiving data
   *
-  * @param rxBufferSize the size of the buffer to be used for receiving bytes
+  * @param rxBufferSize the size of the buffer to be used for receiving bytes, up to MICROBIT_SERIAL_MAX_BUFFER_SIZE
   *
-  * @param txBufferSize the size of the buffer to be used for transmitting bytes
+  * @param txBufferSize the size of the buffer to be used for transmitting bytes, up to MICROBIT_SERIAL_MAX_BUFFER_SIZE
   *
   * @code
   * MicroBitSerial serial(USBTX, USBRX);
@@ -55,20 +68,18 @@ int MicroBitSerial::baudrate = 0;
   *
   *       Buffers aren't allocated until the first send or receive respectively.
   */
-MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uint8_t txBufferSize) : RawSerial(tx,rx), delimeters()
+MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint16_t rxBufferSize, uint16_t txBufferSize) : RawSerial(tx,rx), rxBuff(rxBufferSize), txBuff(txBufferSize)
 {
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->rxBuffSize = rxBufferSize + 1;
-    this->txBuffSize = txBufferSize + 1;
-
-    this->rxBuff = NULL;
-    this->txBuff = NULL;
+    memclr(delimeters, sizeof(delimeters));
 
-    this->rxBuffHead = 0;
-    this->rxBuffTail = 0;
+    this->txLowWaterMark = 0;
 
-    this->txBuffHead = 0;
-    this->txBuffTail = 0;
+    this->frameBuff = NULL;
+    this->frameLength = 0;
+    this->frameEscape = false;
+    this->frameOverflow = false;
+    this->frameQueue = NULL;
+    this->frameQueueLength = 0;
 
     this->rxBuffHeadMatch = -1;
 
@@ -88,46 +99,139 @@ MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uin
   */
 void MicroBitSerial::dataReceived()
 {
-    //get the received character
-    //Note: always read from the serial to clear the RX interrupt
-    char c = getc();
+    bool delimMatch = false;
+    bool headMatch = false;
+    bool frameMatch = false;
+    bool full = false;
+
+    //drain every character waiting in the UART's receive FIFO in this one interrupt,
+    //and raise each event at most once for the whole batch.
+    do
+    {
+        //get the received character
+        //Note: always read from the serial to clear the RX interrupt
+        char c = getc();
 
-    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
-        return;
+        //framed data bypasses the rxBuff entirely.
+        if(frameBuff != NULL)
+        {
+            int result = frameReceived(c);
 
-    int delimeterOffset = 0;
-    int delimLength = this->delimeters.length();
+            frameMatch |= result == MICROBIT_SERIAL_EVT_FRAME_RECEIVED;
+            full |= result == MICROBIT_SERIAL_EVT_RX_FULL;
+            continue;
+        }
+
+        if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
+            continue;
 
-    //iterate through our delimeters (if any) to see if there is a match
-    while(delimeterOffset < delimLength)
-    {
         //fire an event if there is to block any waiting fibers
-        if(this->delimeters.charAt(delimeterOffset) == c)
-            MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+        if(MicroBitRingBuffer::isDelimeter(delimeters, c))
+            delimMatch = true;
 
-        delimeterOffset++;
+        //store the character, unless we are about to collide with the tail
+        if(rxBuff.put(c))
+        {
+            //if we have any fibers waiting for a specific number of characters, unblock them
+            if(rxBuffHeadMatch >= 0)
+                if(rxBuff.getHead() == rxBuffHeadMatch)
+                {
+                    rxBuffHeadMatch = -1;
+                    headMatch = true;
+                }
+        }
+        else
+            //otherwise, our buffer is full, send an event to the user...
+            full = true;
     }
+    while(readable());
+
+    if(delimMatch)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+
+    if(headMatch)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
 
-    uint16_t newHead = (rxBuffHead + 1) % rxBuffSize;
+    if(frameMatch)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_FRAME_RECEIVED);
 
-    //look ahead to our newHead value to see if we are about to collide with the tail
-    if(newHead != rxBuffTail)
+    if(full)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_RX_FULL);
+}
+
+/**
+  * An internal method, used by the receive interrupt, to decode a received character
+  * when framing is enabled.
+  *
+  * @param c the character received.
+  *
+  * @return MICROBIT_SERIAL_EVT_FRAME_RECEIVED if a frame was completed, MICROBIT_SERIAL_EVT_RX_FULL
+  *         if a frame was completed but could not be stored, or zero otherwise.
+  */
+int MicroBitSerial::frameReceived(uint8_t c)
+{
+    int result = 0;
+
+    if(c == MICROBIT_SERIAL_SLIP_END)
     {
-        //if we are not, store the character, and update our actual head.
-        this->rxBuff[rxBuffHead] = c;
-        rxBuffHead = newHead;
+        //empty frames are simply padding between frames.
+        if(frameLength > 0 && !frameOverflow)
+        {
+            SerialFrame *frame = NULL;
+
+            if(frameQueueLength < MICROBIT_SERIAL_FRAME_QUEUE_SIZE)
+                frame = (SerialFrame *)malloc(sizeof(SerialFrame) + frameLength);
 
-        //if we have any fibers waiting for a specific number of characters, unblock them
-        if(rxBuffHeadMatch >= 0)
-            if(rxBuffHead == rxBuffHeadMatch)
+            if(frame != NULL)
             {
-                rxBuffHeadMatch = -1;
-                MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
+                frame->next = NULL;
+                frame->length = frameLength;
+                memcpy(frame + 1, frameBuff, frameLength);
+
+                SerialFrame **last = &frameQueue;
+
+                while(*last != NULL)
+                    last = &(*last)->next;
+
+                *last = frame;
+                frameQueueLength++;
+
+                result = MICROBIT_SERIAL_EVT_FRAME_RECEIVED;
             }
+            else
+                result = MICROBIT_SERIAL_EVT_RX_FULL;
+        }
+
+        frameLength = 0;
+        frameEscape = false;
+        frameOverflow = false;
+
+        return result;
     }
+
+    if(c == MICROBIT_SERIAL_SLIP_ESC)
+    {
+        frameEscape = true;
+        return result;
+    }
+
+    if(frameEscape)
+    {
+        if(c == MICROBIT_SERIAL_SLIP_ESC_END)
+            c = MICROBIT_SERIAL_SLIP_END;
+
+        else if(c == MICROBIT_SERIAL_SLIP_ESC_ESC)
+            c = MICROBIT_SERIAL_SLIP_ESC;
+
+        frameEscape = false;
+    }
+
+    if(frameLength < MICROBIT_SERIAL_MAX_FRAME_SIZE)
+        frameBuff[frameLength++] = c;
     else
-        //otherwise, our buffer is full, send an event to the user...
-        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_RX_FULL);
+        frameOverflow = true;
+
+    return result;
 }
 
 /**
@@ -138,23 +242,25 @@ void MicroBitSerial::dataReceived()
   */
 void MicroBitSerial::dataWritten()
 {
-    if(txBuffTail == txBuffHead || !(status & MICROBIT_SERIAL_TX_BUFF_INIT))
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT) || txBuff.isEmpty())
         return;
 
     //send our current char
-    putc(txBuff[txBuffTail]);
-
-    uint16_t nextTail = (txBuffTail + 1) % txBuffSize;
+    putc(txBuff.peek());
 
     //unblock any waiting fibers that are waiting for transmission to finish.
-    if(nextTail == txBuffHead)
+    if(txBuff.length() == 1)
     {
         MicroBitEvent(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
         detach(Serial::TxIrq);
     }
 
     //update our tail!
-    txBuffTail = nextTail;
+    txBuff.commitRead(1);
+
+    //let any producer know it's time to refill the buffer.
+    if(txLowWaterMark && txBufferedSize() == txLowWaterMark)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_TX_LOW_WATER);
 }
 
 /**
@@ -174,19 +280,7 @@ void MicroBitSerial::dataWritten()
   */
 int MicroBitSerial::setTxInterrupt(uint8_t *string, int len, MicroBitSerialMode mode)
 {
-    int copiedBytes = 0;
-
-    for(copiedBytes = 0; copiedBytes < len; copiedBytes++)
-    {
-        uint16_t nextHead = (txBuffHead + 1) % txBuffSize;
-        if(nextHead != txBuffTail)
-        {
-            this->txBuff[txBuffHead] = string[copiedBytes];
-            txBuffHead = nextHead;
-        }
-        else
-            break;
-    }
+    int copiedBytes = txBuff.write(string, len);
 
     if(mode != SYNC_SPINWAIT)
         fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
@@ -198,19 +292,21 @@ int MicroBitSerial::setTxInterrupt(uint8_t *string, int len, MicroBitSerialMode
 }
 
 /**
-  * Locks the mutex so that others can't use this serial instance for reception
+  * Locks the mutex so that others can't use this serial instance for reception,
+  * blocking the calling fiber until the mutex is available
   */
 void MicroBitSerial::lockRx()
 {
-    status |= MICROBIT_SERIAL_RX_IN_USE;
+    rxLock.wait();
 }
 
 /**
-  * Locks the mutex so that others can't use this serial instance for transmission
+  * Locks the mutex so that others can't use this serial instance for transmission,
+  * blocking the calling fiber until the mutex is available
   */
 void MicroBitSerial::lockTx()
 {
-    status |= MICROBIT_SERIAL_TX_IN_USE;
+    txLock.wait();
 }
 
 /**
@@ -218,7 +314,7 @@ void MicroBitSerial::lockTx()
   */
 void MicroBitSerial::unlockRx()
 {
-    status &= ~MICROBIT_SERIAL_RX_IN_USE;
+    rxLock.notify();
 }
 
 /**
@@ -226,7 +322,7 @@ void MicroBitSerial::unlockRx()
   */
 void MicroBitSerial::unlockTx()
 {
-    status &= ~MICROBIT_SERIAL_TX_IN_USE;
+    txLock.notify();
 }
 
 /**
@@ -239,17 +335,14 @@ int MicroBitSerial::initialiseRx()
     {
         //ensure that we receive no interrupts after freeing our buffer
         detach(Serial::RxIrq);
-        free(this->rxBuff);
+        rxBuff.release();
     }
 
     status &= ~MICROBIT_SERIAL_RX_BUFF_INIT;
 
-    if((this->rxBuff = (uint8_t *)malloc(rxBuffSize)) == NULL)
+    if(rxBuff.allocate() != MICROBIT_OK)
         return MICROBIT_NO_RESOURCES;
 
-    this->rxBuffHead = 0;
-    this->rxBuffTail = 0;
-
     //set the receive interrupt
     status |= MICROBIT_SERIAL_RX_BUFF_INIT;
     attach(this, &MicroBitSerial::dataReceived, Serial::RxIrq);
@@ -267,17 +360,14 @@ int MicroBitSerial::initialiseTx()
     {
         //ensure that we receive no interrupts after freeing our buffer
         detach(Serial::TxIrq);
-        free(this->txBuff);
+        txBuff.release();
     }
 
     status &= ~MICROBIT_SERIAL_TX_BUFF_INIT;
 
-    if((this->txBuff = (uint8_t *)malloc(txBuffSize)) == NULL)
+    if(txBuff.allocate() != MICROBIT_OK)
         return MICROBIT_NO_RESOURCES;
 
-    this->txBuffHead = 0;
-    this->txBuffTail = 0;
-
     status |= MICROBIT_SERIAL_TX_BUFF_INIT;
 
     return MICROBIT_OK;
@@ -337,39 +427,7 @@ int MicroBitSerial::getChar(MicroBitSerialMode mode)
             eventAfter(1, mode);
     }
 
-    char c = rxBuff[rxBuffTail];
-
-    rxBuffTail = (rxBuffTail + 1) % rxBuffSize;
-
-    return c;
-}
-
-/**
-  * An internal method that copies values from a circular buffer to a linear buffer.
-  *
-  * @param circularBuff a pointer to the source circular buffer
-  *
-  * @param circularBuffSize the size of the circular buffer
-  *
-  * @param linearBuff a pointer to the destination linear buffer
-  *
-  * @param tailPosition the tail position in the circular buffer you want to copy from
-  *
-  * @param headPosition the head position in the circular buffer you want to copy to
-  *
-  * @note this method assumes that the linear buffer has the appropriate amount of
-  *       memory to contain the copy operation
-  */
-void MicroBitSerial::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition)
-{
-    int toBuffIndex = 0;
-
-    while(tailPosition != headPosition)
-    {
-        linearBuff[toBuffIndex++] = circularBuff[tailPosition];
-
-        tailPosition = (tailPosition + 1) % circularBuffSize;
-    }
+    return rxBuff.get();
 }
 
 /**
@@ -726,39 +784,26 @@ ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerial
 
     lockRx();
 
-    int localTail = rxBuffTail;
-    int preservedTail = rxBuffTail;
-
-    int foundIndex = -1;
+    uint32_t map[8];
+    MicroBitRingBuffer::delimeterMap(delimeters, map);
 
-    //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBuffHead && foundIndex  == -1)
-    {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuff[localTail];
-
-        for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-            if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
-
-        localTail = (localTail + 1) % rxBuffSize;
-    }
+    //ASYNC mode just searches our stored characters for any matches.
+    int foundIndex = rxBuff.find(map);
 
     //if our mode is SYNC_SPINWAIT and we didn't see any matching characters in our buffer
-    //spin until we find a match!
+    //spin until we find a match, searching only the characters that have arrived since.
     if(mode == SYNC_SPINWAIT)
     {
+        int searched = rxBufferedSize();
+
         while(foundIndex == -1)
         {
-            while(localTail == rxBuffHead);
-
-            char c = rxBuff[localTail];
+            while(rxBufferedSize() == searched);
 
-            for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-                if(delimeters.charAt(delimeterIterator) == c)
-                    foundIndex = localTail;
+            int available = rxBufferedSize();
 
-            localTail = (localTail + 1) % rxBuffSize;
+            foundIndex = rxBuff.find(map, searched);
+            searched = available;
         }
     }
 
@@ -768,24 +813,23 @@ ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerial
     {
         eventOn(delimeters, mode);
 
-        foundIndex = rxBuffHead - 1;
+        foundIndex = rxBuff.find(map);
 
-        this->delimeters = ManagedString();
+        memclr(this->delimeters, sizeof(this->delimeters));
     }
 
     if(foundIndex >= 0)
     {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBuffSize - preservedTail) + foundIndex : foundIndex - preservedTail;
+        int localBuffSize = foundIndex;
 
         uint8_t localBuff[localBuffSize + 1];
 
         memclr(&localBuff, localBuffSize + 1);
 
-        circularCopy(rxBuff, rxBuffSize, localBuff, preservedTail, foundIndex);
+        rxBuff.read(localBuff, localBuffSize);
 
         //plus one for the character we listened for...
-        rxBuffTail = (rxBuffTail + localBuffSize + 1) % rxBuffSize;
+        rxBuff.commitRead(1);
 
         unlockRx();
 
@@ -881,7 +925,7 @@ int MicroBitSerial::eventAfter(int len, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->rxBuffHeadMatch = (rxBuffHead + len) % rxBuffSize;
+    this->rxBuffHeadMatch = rxBuff.wrap(rxBuff.getHead() + len);
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -917,7 +961,7 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->delimeters = delimeters;
+    MicroBitRingBuffer::delimeterMap(delimeters, this->delimeters);
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -936,7 +980,7 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
   */
 int MicroBitSerial::isReadable()
 {
-    return (rxBuffTail != rxBuffHead) ? 1 : 0;
+    return rxBuff.isEmpty() ? 0 : 1;
 }
 
 /**
@@ -949,7 +993,7 @@ int MicroBitSerial::isReadable()
   */
 int MicroBitSerial::isWriteable()
 {
-    return (txBuffHead != (txBuffTail - 1)) ? 1 : 0;
+    return txBuff.isFull() ? 0 : 1;
 }
 
 /**
@@ -960,15 +1004,14 @@ int MicroBitSerial::isWriteable()
   * @return MICROBIT_SERIAL_IN_USE if another fiber is currently using this instance
   *         for reception, otherwise MICROBIT_OK.
   */
-int MicroBitSerial::setRxBufferSize(uint8_t size)
+int MicroBitSerial::setRxBufferSize(uint16_t size)
 {
     if(rxInUse())
         return MICROBIT_SERIAL_IN_USE;
 
     lockRx();
 
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->rxBuffSize = size + 1;
+    rxBuff.setCapacity(size);
 
     int result = initialiseRx();
 
@@ -985,15 +1028,14 @@ int MicroBitSerial::setRxBufferSize(uint8_t size)
   * @return MICROBIT_SERIAL_IN_USE if another fiber is currently using this instance
   *         for transmission, otherwise MICROBIT_OK.
   */
-int MicroBitSerial::setTxBufferSize(uint8_t size)
+int MicroBitSerial::setTxBufferSize(uint16_t size)
 {
     if(txInUse())
         return MICROBIT_SERIAL_IN_USE;
 
     lockTx();
 
-    // + 1 so there is a usable buffer size, of the size the user requested.
-    this->txBuffSize = size + 1;
+    txBuff.setCapacity(size);
 
     int result = initialiseTx();
 
@@ -1009,7 +1051,7 @@ int MicroBitSerial::setTxBufferSize(uint8_t size)
   */
 int MicroBitSerial::getRxBufferSize()
 {
-    return this->rxBuffSize;
+    return rxBuff.getSize();
 }
 
 /**
@@ -1019,7 +1061,7 @@ int MicroBitSerial::getRxBufferSize()
   */
 int MicroBitSerial::getTxBufferSize()
 {
-    return this->txBuffSize;
+    return txBuff.getSize();
 }
 
 /**
@@ -1036,7 +1078,7 @@ int MicroBitSerial::clearRxBuffer()
 
     lockRx();
 
-    rxBuffTail = rxBuffHead;
+    rxBuff.clear();
 
     unlockRx();
 
@@ -1057,7 +1099,7 @@ int MicroBitSerial::clearTxBuffer()
 
     lockTx();
 
-    txBuffTail = txBuffHead;
+    txBuff.clear();
 
     unlockTx();
 
@@ -1072,10 +1114,7 @@ int MicroBitSerial::clearTxBuffer()
   */
 int MicroBitSerial::rxBufferedSize()
 {
-    if(rxBuffTail > rxBuffHead)
-        return (rxBuffSize - rxBuffTail) + rxBuffHead;
-
-    return rxBuffHead - rxBuffTail;
+    return rxBuff.length();
 }
 
 /**
@@ -1086,10 +1125,359 @@ int MicroBitSerial::rxBufferedSize()
   */
 int MicroBitSerial::txBufferedSize()
 {
-    if(txBuffTail > txBuffHead)
-        return (txBuffSize - txBuffTail) + txBuffHead;
+    return txBuff.length();
+}
+
+/**
+  * Provides direct access to the characters waiting in the rxBuff, so they can be parsed in place
+  * without being copied. Only the contiguous region starting at the oldest character is exposed, so
+  * when the waiting characters wrap around the end of the buffer, the remainder becomes available
+  * once this region has been released with commitRead().
+  *
+  * @param data populated with a pointer to the oldest character waiting in the rxBuff.
+  *
+  * @return the number of characters available at data, MICROBIT_SERIAL_IN_USE if another fiber
+  *         is currently using this instance for reception, or MICROBIT_NO_RESOURCES if the
+  *         rxBuff could not be allocated.
+  *
+  * @code
+  * uint8_t *data;
+  * int len = serial.getReadRegion(data);
+  *
+  * if (len > 0)
+  *     serial.commitRead(parse(data, len));
+  * @endcode
+  */
+int MicroBitSerial::getReadRegion(uint8_t *&data)
+{
+    if(rxInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our rx buffer
+    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
+    {
+        int result = initialiseRx();
+
+        if(result != MICROBIT_OK)
+            return result;
+    }
+
+    return rxBuff.getReadRegion(data);
+}
+
+/**
+  * Releases characters at the start of the region given by getReadRegion(), once they have been used.
+  *
+  * @param len the number of characters to release.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than are waiting.
+  */
+int MicroBitSerial::commitRead(int len)
+{
+    return rxBuff.commitRead(len);
+}
+
+/**
+  * Provides direct access to free space in the txBuff, so that data can be written in place
+  * without being copied. Only the contiguous region following the last character queued is exposed.
+  *
+  * @param data populated with a pointer to the free space in the txBuff.
+  *
+  * @return the number of bytes that may be written at data, MICROBIT_SERIAL_IN_USE if another fiber
+  *         is currently using this instance for transmission, or MICROBIT_NO_RESOURCES if the
+  *         txBuff could not be allocated.
+  *
+  * @code
+  * uint8_t *data;
+  * int len = serial.getWriteRegion(data);
+  *
+  * if (len >= 4)
+  * {
+  *     memcpy(data, "ping", 4);
+  *     serial.commitWrite(4);
+  * }
+  * @endcode
+  */
+int MicroBitSerial::getWriteRegion(uint8_t *&data)
+{
+    if(txInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our tx buffer
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
+    {
+        int result = initialiseTx();
+
+        if(result != MICROBIT_OK)
+            return result;
+    }
+
+    return txBuff.getWriteRegion(data);
+}
+
+/**
+  * Queues bytes written into the region given by getWriteRegion() for transmission. Returns immediately.
+  *
+  * @param len the number of bytes written.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or larger than the region.
+  */
+int MicroBitSerial::commitWrite(int len)
+{
+    uint8_t *data;
+
+    if(len < 0 || len > getWriteRegion(data))
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(len == 0)
+        return MICROBIT_OK;
+
+    txBuff.commitWrite(len);
+
+    //set the TX interrupt
+    attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Enables or disables binary framing of received data. While enabled, received bytes are decoded
+  * as SLIP (RFC 1055) frames as they arrive, rather than being stored in the rxBuff. Each complete
+  * frame is queued for recvFrame(), and an event with the id MICROBIT_ID_SERIAL and the value
+  * MICROBIT_SERIAL_EVT_FRAME_RECEIVED is raised.
+  *
+  * Frames longer than MICROBIT_SERIAL_MAX_FRAME_SIZE bytes are discarded. If
+  * MICROBIT_SERIAL_FRAME_QUEUE_SIZE frames are already waiting, new frames are discarded, and
+  * MICROBIT_SERIAL_EVT_RX_FULL is raised.
+  *
+  * @param enable true to decode frames, false to return to receiving a stream of characters.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the frame buffer could not be allocated.
+  */
+int MicroBitSerial::setFraming(bool enable)
+{
+    if(enable == (frameBuff != NULL))
+        return MICROBIT_OK;
+
+    if(enable)
+    {
+        uint8_t *buffer = (uint8_t *)malloc(MICROBIT_SERIAL_MAX_FRAME_SIZE);
+
+        if(buffer == NULL)
+            return MICROBIT_NO_RESOURCES;
 
-    return txBuffHead - txBuffTail;
+        frameLength = 0;
+        frameEscape = false;
+        frameOverflow = false;
+        frameBuff = buffer;
+
+        //set the receive interrupt
+        attach(this, &MicroBitSerial::dataReceived, Serial::RxIrq);
+
+        return MICROBIT_OK;
+    }
+
+    __disable_irq();
+    uint8_t *buffer = frameBuff;
+    SerialFrame *frame = frameQueue;
+    frameBuff = NULL;
+    frameQueue = NULL;
+    frameQueueLength = 0;
+    __enable_irq();
+
+    free(buffer);
+
+    while(frame != NULL)
+    {
+        SerialFrame *next = frame->next;
+        free(frame);
+        frame = next;
+    }
+
+    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
+        detach(Serial::RxIrq);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Reads the oldest complete frame received while framing is enabled.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - A frame is returned if available, otherwise an empty PacketBuffer is
+  *                    returned immediately.
+  *
+  *            SYNC_SPINWAIT - A frame is returned if available, otherwise this method will
+  *                            spin (lock up the processor) until a frame is received.
+  *
+  *            SYNC_SLEEP - A frame is returned if available, otherwise the calling fiber
+  *                         sleeps until a frame is received.
+  *
+  *         Defaults to SYNC_SLEEP.
+  *
+  * @return the decoded frame, or an empty PacketBuffer if no frame is available or framing is not enabled.
+  */
+PacketBuffer MicroBitSerial::recvFrame(MicroBitSerialMode mode)
+{
+    if(frameBuff == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    if(mode == SYNC_SPINWAIT)
+        while(frameQueue == NULL);
+
+    if(mode == SYNC_SLEEP && frameQueue == NULL)
+        fiber_wait_for_event(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_FRAME_RECEIVED);
+
+    __disable_irq();
+    SerialFrame *frame = frameQueue;
+
+    if(frame != NULL)
+    {
+        frameQueue = frame->next;
+        frameQueueLength--;
+    }
+    __enable_irq();
+
+    if(frame == NULL)
+        return PacketBuffer::EmptyPacket;
+
+    PacketBuffer packet((uint8_t *)(frame + 1), frame->length);
+    free(frame);
+
+    return packet;
+}
+
+/**
+  * Sends a buffer as a single SLIP (RFC 1055) frame. The frame is encoded directly into the txBuff.
+  *
+  * @param buffer a pointer to the first byte of the frame.
+  *
+  * @param bufferLen the number of bytes in the frame.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - the frame is encoded into the txBuff and this method returns immediately.
+  *                    If the whole encoded frame does not fit, nothing is sent.
+  *
+  *            SYNC_SPINWAIT - the frame is encoded into the txBuff as space allows, and this method
+  *                            will spin (lock up the processor) until it has been sent.
+  *
+  *            SYNC_SLEEP - the frame is encoded into the txBuff as space allows, and the fiber
+  *                         sleeps until it has been sent.
+  *
+  *         Defaults to SYNC_SLEEP.
+  *
+  * @return the number of bytes in the frame, MICROBIT_SERIAL_IN_USE if another fiber is using
+  *         the serial instance for transmission, MICROBIT_INVALID_PARAMETER if buffer is invalid
+  *         or bufferLen is <= 0, or MICROBIT_NO_RESOURCES if an ASYNC frame does not fit in the txBuff.
+  */
+int MicroBitSerial::sendFrame(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode)
+{
+    if(txInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    if(bufferLen <= 0 || buffer == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    lockTx();
+
+    //lazy initialisation of our tx buffer
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
+    {
+        int result = initialiseTx();
+
+        if(result != MICROBIT_OK)
+        {
+            unlockTx();
+            return result;
+        }
+    }
+
+    //an ASYNC frame is only sent if it fits completely, so a partial frame is never left behind.
+    if(mode == ASYNC)
+    {
+        int encodedLen = bufferLen + 2;
+
+        for(int i = 0; i < bufferLen; i++)
+            if(buffer[i] == MICROBIT_SERIAL_SLIP_END || buffer[i] == MICROBIT_SERIAL_SLIP_ESC)
+                encodedLen++;
+
+        if(encodedLen > txBuff.space())
+        {
+            unlockTx();
+            return MICROBIT_NO_RESOURCES;
+        }
+    }
+
+    //position -1 and bufferLen are the frame delimeters either side of the data.
+    int position = -1;
+    uint8_t escape = 0;
+
+    while(position <= bufferLen)
+    {
+        uint8_t c;
+
+        if(escape)
+            c = escape;
+        else if(position < 0 || position == bufferLen)
+            c = MICROBIT_SERIAL_SLIP_END;
+        else if(buffer[position] == MICROBIT_SERIAL_SLIP_END || buffer[position] == MICROBIT_SERIAL_SLIP_ESC)
+            c = MICROBIT_SERIAL_SLIP_ESC;
+        else
+            c = buffer[position];
+
+        if(!txBuff.put(c))
+        {
+            //the txBuff is full, so wait for it to drain before continuing.
+            if(mode != SYNC_SPINWAIT)
+                fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
+
+            attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+            send(mode);
+            continue;
+        }
+
+        if(escape)
+        {
+            escape = 0;
+            position++;
+        }
+        else if(c == MICROBIT_SERIAL_SLIP_ESC)
+            escape = buffer[position] == MICROBIT_SERIAL_SLIP_END ? MICROBIT_SERIAL_SLIP_ESC_END : MICROBIT_SERIAL_SLIP_ESC_ESC;
+        else
+            position++;
+    }
+
+    if(mode != SYNC_SPINWAIT)
+        fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
+
+    //set the TX interrupt
+    attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
+    send(mode);
+
+    unlockTx();
+
+    return bufferLen;
+}
+
+/**
+  * Sends a PacketBuffer as a single SLIP (RFC 1055) frame. The frame is encoded directly into the txBuff.
+  *
+  * @param frame the frame to send.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. See sendFrame(uint8_t *, int, MicroBitSerialMode).
+  *         Defaults to SYNC_SLEEP.
+  *
+  * @return the number of bytes in the frame, MICROBIT_SERIAL_IN_USE if another fiber is using
+  *         the serial instance for transmission, MICROBIT_INVALID_PARAMETER if the frame is empty,
+  *         or MICROBIT_NO_RESOURCES if an ASYNC frame does not fit in the txBuff.
+  */
+int MicroBitSerial::sendFrame(PacketBuffer frame, MicroBitSerialMode mode)
+{
+    return sendFrame(frame.getBytes(), frame.length(), mode);
 }
 
 /**
@@ -1101,7 +1489,7 @@ int MicroBitSerial::txBufferedSize()
   */
 int MicroBitSerial::rxInUse()
 {
-    return (status & MICROBIT_SERIAL_RX_IN_USE);
+    return rxLock.isLocked();
 }
 
 /**
@@ -1113,7 +1501,41 @@ int MicroBitSerial::rxInUse()
   */
 int MicroBitSerial::txInUse()
 {
-    return (status & MICROBIT_SERIAL_TX_IN_USE);
+    return txLock.isLocked();
+}
+
+/**
+  * Configures an event to be raised as the txBuff drains, so that a fiber producing data can top
+  * the buffer up before it empties, keeping the line busy without blocking in send() or polling.
+  *
+  * Once the number of bytes waiting to be transmitted falls to the given level, an event with
+  * the id MICROBIT_ID_SERIAL and the value MICROBIT_SERIAL_EVT_TX_LOW_WATER is raised.
+  * An event with the id MICROBIT_ID_NOTIFY and the value MICROBIT_SERIAL_EVT_TX_EMPTY is also
+  * raised each time the txBuff becomes empty.
+  *
+  * @param bytes the number of bytes remaining at which to raise the event, or zero to disable the event.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if bytes is negative or not less than the size of the txBuff.
+  *
+  * @code
+  * serial.setTxLowWaterMark(16);
+  *
+  * while(1)
+  * {
+  *     // Queue as much as the buffer will take, then sleep until it has drained.
+  *     serial.send(nextChunk(), ASYNC);
+  *     fiber_wait_for_event(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_TX_LOW_WATER);
+  * }
+  * @endcode
+  */
+int MicroBitSerial::setTxLowWaterMark(int bytes)
+{
+    if(bytes < 0 || bytes >= txBuff.getSize())
+        return MICROBIT_INVALID_PARAMETER;
+
+    txLowWaterMark = bytes;
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -33,6 +33,53 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitFlash.h"
 #include "MicroBitCompat.h"
 
+// The number of KeyValuePairs that fit in the storage page, after the KeyValueStore struct.
+#define MICROBIT_STORAGE_PAIRS ((PAGE_SIZE - sizeof(KeyValueStore)) / sizeof(KeyValuePair))
+
+/*
+ * A RAM index of the log in the storage page, shared by all instances as there is only one storage page.
+ * Each entry holds a hash of the key of the pair in that slot, or zero if the slot has been cleared.
+ */
+static uint16_t pairHash[MICROBIT_STORAGE_PAIRS];
+static int logLength = -1;           // The number of slots used by the log, or -1 if the index needs to be rebuilt.
+
+/*
+ * Determine if the given pair in the log is superseded by a later version of the same key.
+ */
+static bool supersededInLog(KeyValuePair *pair, KeyValuePair *end)
+{
+    for (KeyValuePair *later = pair + 1; later < end; later++)
+        if(strcmp((char *)pair->key, (char *)later->key) == 0)
+            return true;
+
+    return false;
+}
+
+/*
+ * Determine if the given key is changed by any of a batch of updates after the given position.
+ */
+static bool supersededInBatch(const char *key, MicroBitStorageUpdate *updates, int count, int position)
+{
+    for (int i = position + 1; i < count; i++)
+        if(strcmp(key, updates[i].key) == 0)
+            return true;
+
+    return false;
+}
+
+/*
+ * Hash a key for the RAM index. Never returns zero.
+ */
+static uint16_t keyHash(const char *key)
+{
+    uint16_t hash = 5381;
+
+    while (*key)
+        hash = (hash << 5) + hash + (uint8_t) *key++;
+
+    return hash ? hash : 1;
+}
+
 
 /**
   * Default constructor.
@@ -101,136 +148,221 @@ void MicroBitStorage::scratchKeyValueStore(KeyValueStore store)
 }
 
 /**
-  * Function for populating the scratch page with a KeyValuePair.
-  *
-  * @param pair the KeyValuePair struct to write to the scratch page.
+  * Determine the address of the first KeyValuePair in the storage page, initialising
+  * the page if it does not yet hold a valid store.
   *
-  * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-  * is used to determine the offset into the scratch page, where the KeyValuePair should
-  * be written.
+  * @return a pointer to the first KeyValuePair slot.
   */
-void MicroBitStorage::scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer)
+KeyValuePair* MicroBitStorage::getFirstPair()
 {
-    //we can only write using words
-    uint32_t *p = (uint32_t *) &pair;
-
-    //calculate our various offsets
     uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
+    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
 
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
+    KeyValueStore *store = (KeyValueStore *)flashBlockPointer;
 
-    uint32_t flashPointerOffset = flashPointer - flashBlockPointer;
+    // A store in the original layout holds its pairs contiguously, followed by unused space, so it is already a valid log.
+    // Compact it anyway, to bring the header up to date.
+    if(store->magic == MICROBIT_STORAGE_LEGACY_MAGIC)
+        compact();
 
-    scratchPointer += flashPointerOffset;
+    //if we haven't used flash before, we need to configure it
+    else if(store->magic != MICROBIT_STORAGE_MAGIC)
+    {
+        KeyValueStore newStore = KeyValueStore(MICROBIT_STORAGE_MAGIC, 0);
 
-    //KeyValuePair is word aligned...
-    int wordsToWrite = sizeof(KeyValuePair) / 4;
+        flashPageErase(flashBlockPointer);
+        flashCopy((uint32_t *)&newStore, flashBlockPointer, sizeof(KeyValueStore) / 4);
+        logLength = -1;
+    }
 
-    flashCopy(p, scratchPointer, wordsToWrite);
+    return (KeyValuePair *)(flashBlockPointer + sizeof(KeyValueStore) / 4);
 }
 
 /**
-  * Places a given key, and it's corresponding value into flash at the earliest
-  * available point.
+  * Determine the address of the first unused KeyValuePair slot at the end of the log.
   *
-  * @param key the unique name that should be used as an identifier for the given data.
-  *            The key is presumed to be null terminated.
-  *
-  * @param data a pointer to the beginning of the data to be persisted.
+  * @return a pointer to the slot, or NULL if the storage page is full.
+  */
+KeyValuePair* MicroBitStorage::getFreePair()
+{
+    KeyValuePair *pair = getFirstPair();
+
+    buildIndex();
+
+    return logLength < (int)MICROBIT_STORAGE_PAIRS ? pair + logLength : NULL;
+}
+
+/**
+  * Find the most recent KeyValuePair in the log with the given key.
   *
-  * @param dataSize the size of the data to be persisted
+  * @param key the key to find.
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-  *         MICROBIT_NO_RESOURCES if the storage page is full
+  * @return a pointer to the KeyValuePair in FLASH, or NULL if the key is not present.
   */
-int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+KeyValuePair* MicroBitStorage::findPair(const char* key)
 {
-    KeyValuePair pair = KeyValuePair();
+    KeyValuePair *pair = getFirstPair();
+    uint16_t hash = keyHash(key);
 
-    int keySize = strlen(key) + 1;
+    buildIndex();
 
-    if(keySize > (int)sizeof(pair.key) || dataSize > (int)sizeof(pair.value) || dataSize < 0)
-        return MICROBIT_INVALID_PARAMETER;
+    // Later pairs supersede earlier ones, in case we were interrupted before clearing the previous version of a key.
+    for (int i = logLength - 1; i >= 0; i--)
+        if(pairHash[i] == hash && strcmp(key, (char *)pair[i].key) == 0)
+            return &pair[i];
 
-    KeyValuePair *currentValue = get(key);
+    return NULL;
+}
 
-    int upToDate = currentValue && (memcmp(currentValue->value, data, dataSize) == 0);
+/**
+  * Rebuild the RAM index of the log, if it is not already up to date.
+  */
+void MicroBitStorage::buildIndex()
+{
+    if (logLength >= 0)
+        return;
 
-    if(currentValue)
-        delete currentValue;
+    KeyValuePair *pair = getFirstPair();
 
-    if(upToDate)
-        return MICROBIT_OK;
+    // The log ends at the first unused slot, which is still erased.
+    for (logLength = 0; logLength < (int)MICROBIT_STORAGE_PAIRS && *(uint32_t *)&pair[logLength] != 0xFFFFFFFF; logLength++)
+        pairHash[logLength] = pair[logLength].key[0] ? keyHash((char *)pair[logLength].key) : 0;
+}
 
-    memcpy(pair.key, key, keySize);
-    memcpy(pair.value, data, dataSize);
+/**
+  * Clear a KeyValuePair in the log to zero, so that it is no longer used.
+  *
+  * @param pair the KeyValuePair to clear.
+  */
+void MicroBitStorage::clearPair(KeyValuePair* pair)
+{
+    KeyValuePair cleared;
+    memclr(&cleared, sizeof(KeyValuePair));
+
+    flashCopy((uint32_t *)&cleared, (uint32_t *)pair, sizeof(KeyValuePair) / 4);
+    pairHash[pair - getFirstPair()] = 0;
+}
 
+/**
+  * Copy the current KeyValuePairs to the start of a freshly erased storage page, recovering
+  * the space used by pairs that have since been updated or removed, and applying the given changes as we go.
+  *
+  * @param updates the changes to apply.
+  *
+  * @param count the number of changes.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the result would not fit in the storage page,
+  *         in which case the store is left unchanged.
+  */
+int MicroBitStorage::compact(MicroBitStorageUpdate* updates, int count)
+{
     //calculate our various offsets.
     uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
+    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
     uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
 
     uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
     uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
 
-    int storeSize = size();
-
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
-
-    KeyValuePair storedPair = KeyValuePair();
+    KeyValuePair *first = (KeyValuePair *)(flashBlockPointer + kvStoreSize);
+    KeyValuePair *end = (KeyValuePair *)(flashBlockPointer + pg_size / 4);
+    uint32_t *out = scratchPointer + kvStoreSize;
 
-    int found = 0;
+    //find the end of the log.
+    KeyValuePair *last = first;
+    while (last + 1 <= end && *(uint32_t *)last != 0xFFFFFFFF)
+        last++;
 
-    //erase our scratch page
-    flashPageErase(scratchPointer);
-
-    //iterate through key value pairs in flash, writing them to the scratch page.
-    for(int i = 0; i < storeSize; i++)
+    //make a dry run first, to check that everything will fit before we erase anything.
+    for (int pass = 0; pass < 2; pass++)
     {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+        uint32_t pairs = 0;
 
-        //check if the keys match...
-        if(strcmp((char *)storedPair.key, (char *)pair.key) == 0)
+        if (pass == 1)
         {
-            found = 1;
-            //scratch our KeyValueStore struct so that it is preserved.
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-            scratchKeyValuePair(pair, flashPointer);
+            //erase our scratch page, and write our KeyValueStore struct
+            flashPageErase(scratchPointer);
+            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, 0));
         }
-        else
+
+        //copy across every pair that is still in use, and isn't about to be changed.
+        for (KeyValuePair *pair = first; pair < last; pair++)
         {
-            scratchKeyValuePair(storedPair, flashPointer);
+            if(pair->key[0] == 0 || supersededInLog(pair, last) || supersededInBatch((char *)pair->key, updates, count, -1))
+                continue;
+
+            if (pass == 1)
+            {
+                flashCopy((uint32_t *)pair, out, kvPairSize);
+                out += kvPairSize;
+            }
+
+            pairs++;
         }
 
-        flashPointer += kvPairSize;
-    }
+        //then add the new values.
+        for (int i = 0; i < count; i++)
+        {
+            if(updates[i].data == NULL || supersededInBatch(updates[i].key, updates, count, i))
+                continue;
 
-    if(!found)
-    {
-        //if we haven't got a match for the key, check we can add a new KeyValuePair
-        if(storeSize == (int)((pg_size - kvStoreSize) / MICROBIT_STORAGE_BLOCK_SIZE))
-            return MICROBIT_NO_RESOURCES;
+            if (pass == 1)
+            {
+                KeyValuePair pair = KeyValuePair();
+                memcpy(pair.key, updates[i].key, strlen(updates[i].key) + 1);
+                memcpy(pair.value, updates[i].data, updates[i].dataSize);
 
-        storeSize += 1;
+                flashCopy((uint32_t *)&pair, out, kvPairSize);
+                out += kvPairSize;
+            }
 
-        //scratch our updated values.
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-        scratchKeyValuePair(pair, flashPointer);
+            pairs++;
+        }
+
+        if (pairs > MICROBIT_STORAGE_PAIRS)
+            return MICROBIT_NO_RESOURCES;
     }
 
-    //erase our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
+    //erase our storage page, and copy from scratch to storage.
+    flashPageErase(flashBlockPointer);
+    flashCopy(scratchPointer, flashBlockPointer, out - scratchPointer);
 
-    //copy from scratch to storage.
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
+    //the pairs have all moved, so the index must be rebuilt.
+    logLength = -1;
 
     return MICROBIT_OK;
 }
 
+/**
+  * Places a given key, and it's corresponding value into flash at the earliest
+  * available point.
+  *
+  * @param key the unique name that should be used as an identifier for the given data.
+  *            The key is presumed to be null terminated.
+  *
+  * @param data a pointer to the beginning of the data to be persisted.
+  *
+  * @param dataSize the size of the data to be persisted
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key is empty or the key or size is too large,
+  *         MICROBIT_NO_RESOURCES if the storage page is full, or MICROBIT_BUSY if FLASH is in use
+  *         by another fiber and the caller cannot wait (e.g. the idle thread).
+  */
+int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+{
+    MicroBitStorageUpdate change;
+
+    change.key = key;
+    change.data = data;
+    change.dataSize = dataSize;
+
+    // A NULL value would be taken as a removal.
+    if(data == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return update(&change, 1);
+}
+
 /**
   * Places a given key, and it's corresponding value into flash at the earliest
   * available point.
@@ -242,7 +374,8 @@ int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
   * @param dataSize the size of the data to be persisted
   *
   * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-  *         MICROBIT_NO_RESOURCES if the storage page is full
+  *         MICROBIT_NO_RESOURCES if the storage page is full, or MICROBIT_BUSY if FLASH is in use
+  *         by another fiber and the caller cannot wait (e.g. the idle thread).
   */
 int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
 {
@@ -261,42 +394,13 @@ int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
   */
 KeyValuePair* MicroBitStorage::get(const char* key)
 {
-    //calculate our offsets for our storage page
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
-
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
+    KeyValuePair *storedPair = findPair(key);
 
-    int storeSize = size();
-
-    //we haven't got anything stored, so return...
-    if(storeSize == 0)
+    if(storedPair == NULL)
         return NULL;
 
-    //our KeyValueStore struct is always at 0
-    flashBlockPointer += sizeof(KeyValueStore) / 4;
-
     KeyValuePair *pair = new KeyValuePair();
-
-    int i;
-
-    //iterate through flash until we have a match, or drop out.
-    for(i = 0; i < storeSize; i++)
-    {
-        memcpy(pair, flashBlockPointer, sizeof(KeyValuePair));
-
-        if(strcmp(key,(char *)pair->key) == 0)
-            break;
-
-        flashBlockPointer += sizeof(KeyValuePair) / 4;
-    }
-
-    //clean up
-    if(i == storeSize)
-    {
-        delete pair;
-        return NULL;
-    }
+    memcpy(pair, storedPair, sizeof(KeyValuePair));
 
     return pair;
 }
@@ -317,75 +421,164 @@ KeyValuePair* MicroBitStorage::get(ManagedString key)
 }
 
 /**
-  * Removes a KeyValuePair identified by a given key.
+  * Retreives the value of a KeyValuePair identified by a given key, without allocating any memory.
   *
   * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-  *         was not found in flash.
+  * @param buffer the buffer to copy the value into.
+  *
+  * @param length the size of the buffer. At most MICROBIT_STORAGE_VALUE_SIZE bytes are copied.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage,
+  *         or MICROBIT_INVALID_PARAMETER if the buffer is invalid.
   */
-int MicroBitStorage::remove(const char* key)
+int MicroBitStorage::get(const char* key, uint8_t* buffer, int length)
 {
-    //calculate our various offsets
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-
-    uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
-    uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
+    if(buffer == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
 
-    int storeSize = size();
+    KeyValuePair *storedPair = findPair(key);
 
-    //if we have no data, we have nothing to do.
-    if(storeSize == 0)
+    if(storedPair == NULL)
         return MICROBIT_NO_DATA;
 
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
-    scratchPointer += kvStoreSize;
+    memcpy(buffer, storedPair->value, min(length, MICROBIT_STORAGE_VALUE_SIZE));
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Retreives the value of a KeyValuePair identified by a given key, without allocating any memory.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @param buffer the buffer to copy the value into.
+  *
+  * @param length the size of the buffer. At most MICROBIT_STORAGE_VALUE_SIZE bytes are copied.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the key was not found in storage,
+  *         or MICROBIT_INVALID_PARAMETER if the buffer is invalid.
+  */
+int MicroBitStorage::get(ManagedString key, uint8_t* buffer, int length)
+{
+    return get((char *)key.toCharArray(), buffer, length);
+}
+
+/**
+  * Applies several changes to the store at once.
+  *
+  * If there is space at the end of the log for every new value, they are simply appended. Otherwise the store
+  * is compacted just once, with all of the changes applied, at the cost of a single erase of the storage page.
+  *
+  * @param updates the changes to apply. Where the same key appears more than once, the last change is used.
+  *
+  * @param count the number of changes.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if any key is empty or any key or size is too large,
+  *         MICROBIT_NO_RESOURCES if the results would not fit in the storage page, or MICROBIT_BUSY if FLASH is in use
+  *         by another fiber and the caller cannot wait (e.g. the idle thread). No changes are made on error.
+  *
+  * @code
+  * MicroBitStorageUpdate updates[] = {{"compassCal", (uint8_t *)&cal, sizeof(cal)}, {"tempCal", NULL, 0}};
+  * storage.update(updates, 2);
+  * @endcode
+  */
+int MicroBitStorage::update(MicroBitStorageUpdate* updates, int count)
+{
+    int required = 0;
 
-    KeyValuePair storedPair = KeyValuePair();
+    if(updates == NULL || count < 0)
+        return MICROBIT_INVALID_PARAMETER;
 
-    int found = 0;
+    //the log is only consistent between updates, so they must not be interleaved with those of another fiber.
+    MicroBitFlashLock lock;
 
-    //set up our scratch area
-    flashPageErase(scratchPointer);
+    if(!lock.isLocked())
+        return MICROBIT_BUSY;
 
-    //iterate through our flash copy pairs to scratch, unless there is a key patch
-    for(int i = 0; i < storeSize; i++)
+    //validate every change before making any of them, and count the new values that need a slot.
+    for (int i = 0; i < count; i++)
     {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+        int keySize = updates[i].key ? strlen(updates[i].key) + 1 : 0;
+
+        if(keySize <= 1 || keySize > MICROBIT_STORAGE_KEY_SIZE)
+            return MICROBIT_INVALID_PARAMETER;
 
-        //if we have a match, don't increment our scratchPointer
-        if(strcmp((char *)storedPair.key, (char *)key) == 0)
+        if(updates[i].data && (updates[i].dataSize > MICROBIT_STORAGE_VALUE_SIZE || updates[i].dataSize < 0))
+            return MICROBIT_INVALID_PARAMETER;
+
+        if(updates[i].data && !supersededInBatch(updates[i].key, updates, count, i))
         {
-            found = 1;
-            //write our new KeyValueStore data
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize - 1));
+            KeyValuePair *currentValue = findPair(updates[i].key);
+
+            if(!(currentValue && memcmp(currentValue->value, updates[i].data, updates[i].dataSize) == 0))
+                required++;
         }
-        else
+    }
+
+    //if there isn't room at the end of the page, recover the space used by old values, applying our changes at the same time.
+    buildIndex();
+
+    if(logLength + required > (int)MICROBIT_STORAGE_PAIRS)
+        return compact(updates, count);
+
+    //otherwise, append the new values to the log, then clear the old ones. None of this requires a page erase.
+    for (int i = 0; i < count; i++)
+    {
+        if(supersededInBatch(updates[i].key, updates, count, i))
+            continue;
+
+        KeyValuePair *currentValue = findPair(updates[i].key);
+
+        if(updates[i].data == NULL)
         {
-            //otherwise copy the KeyValuePair from our storage page.
-            flashCopy(flashPointer, scratchPointer, sizeof(KeyValuePair) / 4);
-            scratchPointer += sizeof(KeyValuePair) / 4;
+            //clear every version of the pair, in case an earlier update was interrupted.
+            while(currentValue)
+            {
+                clearPair(currentValue);
+                currentValue = findPair(updates[i].key);
+            }
+
+            continue;
         }
 
-        flashPointer += sizeof(KeyValuePair) / 4;
+        if(currentValue && memcmp(currentValue->value, updates[i].data, updates[i].dataSize) == 0)
+            continue;
+
+        KeyValuePair pair = KeyValuePair();
+        memcpy(pair.key, updates[i].key, strlen(updates[i].key) + 1);
+        memcpy(pair.value, updates[i].data, updates[i].dataSize);
+
+        flashCopy((uint32_t *)&pair, (uint32_t *)getFreePair(), sizeof(KeyValuePair) / 4);
+        pairHash[logLength++] = keyHash(updates[i].key);
+
+        if(currentValue)
+            clearPair(currentValue);
     }
 
-    //if we haven't got a match, write our old KeyValueStore struct
-    if(!found)
-    {
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
+    return MICROBIT_OK;
+}
+
+/**
+  * Removes a KeyValuePair identified by a given key.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key was not found in flash,
+  *         or MICROBIT_BUSY if FLASH is in use by another fiber and the caller cannot wait (e.g. the idle thread).
+  */
+int MicroBitStorage::remove(const char* key)
+{
+    MicroBitStorageUpdate change;
+
+    if(findPair(key) == NULL)
         return MICROBIT_NO_DATA;
-    }
 
-    //copy scratch to our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
+    change.key = key;
+    change.data = NULL;
+    change.dataSize = 0;
 
-    return MICROBIT_OK;
+    return update(&change, 1);
 }
 
 /**
@@ -393,8 +586,8 @@ int MicroBitStorage::remove(const char* key)
   *
   * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-  *         was not found in flash.
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key was not found in flash,
+  *         or MICROBIT_BUSY if FLASH is in use by another fiber and the caller cannot wait (e.g. the idle thread).
   */
 int MicroBitStorage::remove(ManagedString key)
 {
@@ -408,30 +601,15 @@ int MicroBitStorage::remove(ManagedString key)
   */
 int MicroBitStorage::size()
 {
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
-
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
-
-    KeyValueStore store = KeyValueStore();
+    KeyValuePair *pair = getFirstPair();
+    int count = 0;
 
-    //read our data!
-    memcpy(&store, flashBlockPointer, sizeof(KeyValueStore));
+    buildIndex();
 
-    //if we haven't used flash before, we need to configure it
-    if(store.magic != MICROBIT_STORAGE_MAGIC)
-    {
-        store.magic = MICROBIT_STORAGE_MAGIC;
-        store.size = 0;
-
-        //erase the scratch page and write our new KeyValueStore
-        flashPageErase((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)));
-        scratchKeyValueStore(store);
-
-        //erase flash, and copy the scratch page over
-        flashPageErase((uint32_t *)flashBlockPointer);
-        flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, pg_size/4);
-    }
+    //count the pairs in use, ignoring any that have been superseded by a later version.
+    for (int i = 0; i < logLength; i++)
+        if(pairHash[i] && findPair((char *)pair[i].key) == &pair[i])
+            count++;
 
-    return store.size;
+    return count;
 }
@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitThermometer.h"
 #include "MicroBitSystemTimer.h"
 #include "MicroBitFiber.h"
+#include "MicroBitPowerProfile.h"
 
 /*
  * The underlying Nordic libraries that support BLE do not compile cleanly with the stringent GCC settings we employ
@@ -50,6 +51,14 @@ DEALINGS IN THE SOFTWARE.
 #pragma GCC diagnostic pop
 #endif
 
+MicroBitThermometer* MicroBitThermometer::instance = NULL;
+
+extern "C" void TEMP_IRQHandler(void)
+{
+    if(NRF_TEMP->EVENTS_DATARDY && MicroBitThermometer::instance)
+        MicroBitThermometer::instance->conversionComplete();
+}
+
 /**
   * Constructor.
   * Create new MicroBitThermometer that gives an indication of the current temperature.
@@ -69,15 +78,13 @@ MicroBitThermometer::MicroBitThermometer(MicroBitStorage& _storage, uint16_t id)
     this->id = id;
     this->samplePeriod = MICROBIT_THERMOMETER_PERIOD;
     this->sampleTime = 0;
+    this->accessTime = 0;
     this->offset = 0;
+    this->converting = false;
 
-    KeyValuePair *tempCalibration =  storage->get("tempCal");
+    instance = this;
 
-    if(tempCalibration != NULL)
-    {
-        memcpy(&offset, tempCalibration->value, sizeof(int16_t));
-        delete tempCalibration;
-    }
+    storage->get("tempCal", (uint8_t *)&offset, sizeof(int16_t));
 }
 
 /**
@@ -96,7 +103,11 @@ MicroBitThermometer::MicroBitThermometer(uint16_t id) :
     this->id = id;
     this->samplePeriod = MICROBIT_THERMOMETER_PERIOD;
     this->sampleTime = 0;
+    this->accessTime = 0;
     this->offset = 0;
+    this->converting = false;
+
+    instance = this;
 }
 
 /**
@@ -110,6 +121,7 @@ MicroBitThermometer::MicroBitThermometer(uint16_t id) :
   */
 int MicroBitThermometer::getTemperature()
 {
+    accessTime = system_timer_current_time();
     updateSample();
     return temperature - offset;
 }
@@ -119,6 +131,9 @@ int MicroBitThermometer::getTemperature()
   * Updates the temperature sample of this instance of MicroBitThermometer
   * only if isSampleNeeded() indicates that an update is required.
   *
+  * Unless Bluetooth is enabled, this only starts a conversion, and the new sample is recorded
+  * from the TEMP interrupt once it is ready. Only the very first reading is waited for.
+  *
   * This call also will add the thermometer to fiber components to receive
   * periodic callbacks.
   *
@@ -135,58 +150,99 @@ int MicroBitThermometer::updateSample()
     }
 
     // check if we need to update our sample...
-    if(isSampleNeeded())
+    if(isSampleNeeded() && !converting)
     {
-        int32_t processorTemperature;
         uint8_t sd_enabled;
 
         // For now, we just rely on the nrf senesor to be the most accurate.
         // The compass module also has a temperature sensor, and has the lowest power consumption, so will run the cooler...
         // ...however it isn't trimmed for accuracy during manufacture, so requires calibration.
 
+        // Schedule our next sample.
+        sampleTime = system_timer_current_time() + samplePeriod;
+
         sd_softdevice_is_enabled(&sd_enabled);
 
         if (sd_enabled)
         {
-            // If Bluetooth is enabled, we need to go through the Nordic software to safely do this
+            // If Bluetooth is enabled, the TEMP peripheral belongs to the Nordic software, which we need to go through to safely do this.
+            int32_t processorTemperature;
+
+            POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_THERMOMETER, true);
             sd_temp_get(&processorTemperature);
+            POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_THERMOMETER, false);
+            recordSample(processorTemperature);
         }
         else
         {
-            // Othwerwise, we access the information directly...
-            uint32_t *TEMP = (uint32_t *)0x4000C508;
+            // Othwerwise, we start a conversion directly, and collect the result when the peripheral interrupts us.
+            converting = true;
+            POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_THERMOMETER, true);
+
+            NRF_TEMP->EVENTS_DATARDY = 0;
+            NRF_TEMP->INTENSET = TEMP_INTENSET_DATARDY_Msk;
+            NVIC_ClearPendingIRQ(TEMP_IRQn);
+            NVIC_EnableIRQ(TEMP_IRQn);
 
             NRF_TEMP->TASKS_START = 1;
+        }
+    }
 
-            while (NRF_TEMP->EVENTS_DATARDY == 0);
+    // There's nothing to return until the first reading is in, so only then do we wait for the conversion.
+    if (!(status & MICROBIT_THERMOMETER_SAMPLED))
+    {
+        while (converting);
+        status |= MICROBIT_THERMOMETER_SAMPLED;
+    }
 
-            NRF_TEMP->EVENTS_DATARDY = 0;
+    return MICROBIT_OK;
+};
 
-            processorTemperature = *TEMP;
+/**
+  * Collects the result of a temperature conversion started by updateSample().
+  *
+  * @note should only be called from TEMP_IRQHandler...
+  */
+void MicroBitThermometer::conversionComplete()
+{
+    uint32_t *TEMP = (uint32_t *)0x4000C508;
 
-            NRF_TEMP->TASKS_STOP = 1;
-        }
+    NRF_TEMP->EVENTS_DATARDY = 0;
 
+    int32_t processorTemperature = *TEMP;
 
-        // Record our reading...
-        temperature = processorTemperature / 4;
+    NRF_TEMP->TASKS_STOP = 1;
+    NRF_TEMP->INTENCLR = TEMP_INTENCLR_DATARDY_Msk;
+    NVIC_DisableIRQ(TEMP_IRQn);
+    POWER_PROFILE_ACTIVE(MICROBIT_POWER_DOMAIN_THERMOMETER, false);
 
-        // Schedule our next sample.
-        sampleTime = system_timer_current_time() + samplePeriod;
+    recordSample(processorTemperature);
 
-        // Send an event to indicate that we'e updated our temperature.
-        MicroBitEvent e(id, MICROBIT_THERMOMETER_EVT_UPDATE);
-    }
+    converting = false;
+}
 
-    return MICROBIT_OK;
-};
+/**
+  * Records a raw temperature reading from the processor, and raises MICROBIT_THERMOMETER_EVT_UPDATE.
+  *
+  * @param processorTemperature the reading, in quarter degrees celsius.
+  */
+void MicroBitThermometer::recordSample(int32_t processorTemperature)
+{
+    // Record our reading, filtering in the sensor's native quarter degrees to keep the precision.
+    temperature = filter.push((int)processorTemperature) / 4;
+
+    // Send an event to indicate that we'e updated our temperature.
+    MicroBitEvent e(id, MICROBIT_THERMOMETER_EVT_UPDATE);
+}
 
 /**
   * Periodic callback from MicroBit idle thread.
   */
 void MicroBitThermometer::idleTick()
 {
-    updateSample();
+    // Stop sampling once nothing is reading the temperature, or listening for its events.
+    if (isSampleNeeded() && isSampling())
+        updateSample();
 }
 
 /**
@@ -199,6 +255,32 @@ int MicroBitThermometer::isSampleNeeded()
     return  system_timer_current_time() >= sampleTime;
 }
 
+/**
+  * Determines if the thermometer should continue to be sampled in the background. This is not the case
+  * once it has not been read for MICROBIT_SENSOR_IDLE_TIMEOUT milliseconds and nothing is listening for its events.
+  *
+  * @return 1 if the thermometer should be sampled, 0 otherwise.
+  */
+int MicroBitThermometer::isSampling()
+{
+#if MICROBIT_SENSOR_IDLE_TIMEOUT > 0
+    unsigned long now = system_timer_current_time();
+
+    if (now - accessTime < MICROBIT_SENSOR_IDLE_TIMEOUT)
+        return 1;
+
+    if (EventModel::defaultEventBus && EventModel::defaultEventBus->isListening(id, MICROBIT_THERMOMETER_EVT_UPDATE))
+        return 1;
+
+    // There's no hardware to wake, so simply look again when the next sample would have been due.
+    sampleTime = now + samplePeriod;
+
+    return 0;
+#else
+    return 1;
+#endif
+}
+
 /**
   * Set the sample rate at which the temperatureis read (in ms).
   *
@@ -225,6 +307,38 @@ int MicroBitThermometer::getPeriod()
     return samplePeriod;
 }
 
+ /**
+  * Smooths the readings of the thermometer, so that each read returns a filtered value. The filter is
+  * updated incrementally as each sample is taken, rather than when read.
+  *
+  * @param type The type of filter: MICROBIT_FILTER_NONE (the default), MICROBIT_FILTER_MOVING_AVERAGE,
+  *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  *
+  * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+  *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+  *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @code
+  * thermometer.setFilter(MICROBIT_FILTER_MOVING_AVERAGE, 8);
+  * @endcode
+  */
+int MicroBitThermometer::setFilter(int type, int length)
+{
+    return filter.configure(type, length);
+}
+
+ /**
+  * Determines the type of filter applied to the readings, as set by setFilter().
+  *
+  * @return MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE, MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  */
+int MicroBitThermometer::getFilter()
+{
+    return filter.getType();
+}
+
 /**
   * Set the value that is used to offset the raw silicon temperature.
   *
@@ -263,6 +377,7 @@ int MicroBitThermometer::getOffset()
   */
 int MicroBitThermometer::setCalibration(int calibrationTemp)
 {
+    accessTime = system_timer_current_time();
     updateSample();
     return setOffset(temperature - calibrationTemp);
 }
@@ -0,0 +1,251 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for MicroBitTouchSensor.
+  *
+  * Measures the capacitance of one or more touch pads, from the time each one takes to charge.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitTouchSensor.h"
+#include "ErrorNo.h"
+
+// A gap between reads of the pads longer than this, in timer ticks, means the scan was interrupted.
+#define MICROBIT_TOUCH_GAP_TICKS            32
+
+// The time given for the pads to discharge before each scan, in timer ticks.
+#define MICROBIT_TOUCH_DISCHARGE_TICKS      160
+
+/**
+  * Reads the current time from the timer.
+  */
+static inline uint32_t touchNow()
+{
+    MICROBIT_TOUCH_TIMER->TASKS_CAPTURE[0] = 1;
+    return MICROBIT_TOUCH_TIMER->CC[0];
+}
+
+/**
+  * Constructor.
+  *
+  * Create a touch sensor, with no pads.
+  */
+MicroBitTouchSensor::MicroBitTouchSensor()
+{
+    this->padCount = 0;
+    this->calibrated = false;
+}
+
+/**
+  * Adds a pad to be scanned.
+  *
+  * @param pad the pin attached to the pad, e.g. MICROBIT_PIN_P0.
+  *
+  * @return the index of the pad, used to read its results, MICROBIT_INVALID_PARAMETER if the pin is out of range,
+  *         or MICROBIT_NO_RESOURCES if MICROBIT_TOUCH_MAX_PADS pads have been added already.
+  */
+int MicroBitTouchSensor::addPad(PinName pad)
+{
+    if (pad < 0 || pad > 31)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (padCount == MICROBIT_TOUCH_MAX_PADS)
+        return MICROBIT_NO_RESOURCES;
+
+    pads[padCount] = pad;
+    charge[padCount] = 0;
+    baseline[padCount] = 0;
+
+    // The new pad needs its own baseline, so the next scan calibrates again.
+    calibrated = false;
+
+    return padCount++;
+}
+
+/**
+  * Measures the charge time of every pad once.
+  *
+  * @return true if the measurement was taken without interruption, false otherwise.
+  */
+bool MicroBitTouchSensor::measure()
+{
+    uint32_t mask = 0;
+
+    // Drive every pad low, with its input connected, so that releasing the pads is a single write to DIRCLR.
+    for (int i = 0; i < padCount; i++)
+    {
+        mask |= 1 << pads[i];
+        charge[i] = MICROBIT_TOUCH_TIMEOUT_US * 16;
+
+        NRF_GPIO->PIN_CNF[pads[i]] = (GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos) |
+                                     (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+                                     (GPIO_PIN_CNF_PULL_Disabled << GPIO_PIN_CNF_PULL_Pos);
+    }
+
+    NRF_GPIO->OUTCLR = mask;
+
+    MICROBIT_TOUCH_TIMER->TASKS_STOP = 1;
+    MICROBIT_TOUCH_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    MICROBIT_TOUCH_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    MICROBIT_TOUCH_TIMER->PRESCALER = 0;
+    MICROBIT_TOUCH_TIMER->SHORTS = 0;
+    MICROBIT_TOUCH_TIMER->TASKS_CLEAR = 1;
+    MICROBIT_TOUCH_TIMER->TASKS_START = 1;
+
+    while (touchNow() < MICROBIT_TOUCH_DISCHARGE_TICKS);
+
+    // Release every pad at once, and note the time each one is first seen HI.
+    uint32_t pending = mask;
+    uint32_t start = touchNow();
+    uint32_t last = start;
+    bool interrupted = false;
+
+    NRF_GPIO->DIRCLR = mask;
+
+    while (pending)
+    {
+        uint32_t in = NRF_GPIO->IN;
+        uint32_t now = touchNow();
+
+        if (now - last > MICROBIT_TOUCH_GAP_TICKS)
+            interrupted = true;
+
+        last = now;
+
+        if (in & pending)
+        {
+            for (int i = 0; i < padCount; i++)
+                if (in & pending & (1 << pads[i]))
+                    charge[i] = now - start;
+
+            pending &= ~in;
+        }
+
+        if (now - start >= MICROBIT_TOUCH_TIMEOUT_US * 16)
+            break;
+    }
+
+    MICROBIT_TOUCH_TIMER->TASKS_STOP = 1;
+
+    return !interrupted;
+}
+
+/**
+  * Measures every pad once. The first scan also calibrates the pads, if calibrate() hasn't been called.
+  *
+  * This takes as long as the slowest pad takes to charge, up to MICROBIT_TOUCH_TIMEOUT_US, and is repeated if it is
+  * interrupted for long enough to affect the result.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no pads have been added.
+  */
+int MicroBitTouchSensor::scan()
+{
+    if (padCount == 0)
+        return MICROBIT_NO_DATA;
+
+    if (!calibrated)
+        return calibrate();
+
+    for (int i = 0; i < MICROBIT_TOUCH_RETRIES && !measure(); i++);
+
+    // A pad reading less than its baseline has simply become quieter, so follow it down.
+    for (int i = 0; i < padCount; i++)
+        if (charge[i] < baseline[i])
+            baseline[i] = charge[i];
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Finds the untouched capacitance of every pad, by averaging MICROBIT_TOUCH_CALIBRATION_SCANS scans.
+  * The pads must not be touched at the time.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no pads have been added.
+  */
+int MicroBitTouchSensor::calibrate()
+{
+    if (padCount == 0)
+        return MICROBIT_NO_DATA;
+
+    uint32_t total[MICROBIT_TOUCH_MAX_PADS] = { 0 };
+
+    for (int scan = 0; scan < MICROBIT_TOUCH_CALIBRATION_SCANS; scan++)
+    {
+        for (int i = 0; i < MICROBIT_TOUCH_RETRIES && !measure(); i++);
+
+        for (int i = 0; i < padCount; i++)
+            total[i] += charge[i];
+    }
+
+    for (int i = 0; i < padCount; i++)
+        baseline[i] = total[i] / MICROBIT_TOUCH_CALIBRATION_SCANS;
+
+    calibrated = true;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the capacitance of a pad above its baseline, in the last scan.
+  *
+  * @param pad the index of the pad, as returned by addPad().
+  *
+  * @return the capacitance in femtofarads, or MICROBIT_INVALID_PARAMETER if pad is out of range.
+  *
+  * @code
+  * int p0 = touch.addPad(MICROBIT_PIN_P0);
+  * touch.scan();
+  * int strength = touch.getCapacitance(p0);
+  * @endcode
+  */
+int MicroBitTouchSensor::getCapacitance(int pad)
+{
+    if (pad < 0 || pad >= padCount)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint32_t ticks = charge[pad] > baseline[pad] ? charge[pad] - baseline[pad] : 0;
+
+    // A pad charges to the input HI threshold of 0.7 VDD in 1.204 RC, and each tick is 62.5ns, so
+    // C = ticks * 62.5ns / (1.204 R). In femtofarads, with R in kilohms, this is ticks * 51910 / R.
+    return (int)(((uint64_t)ticks * 51910) / MICROBIT_TOUCH_RESISTANCE_KOHM);
+}
+
+/**
+  * Determines if a pad was touched in the last scan.
+  *
+  * @param pad the index of the pad, as returned by addPad().
+  *
+  * @return 1 if the pad's capacitance is at least MICROBIT_TOUCH_THRESHOLD above its baseline, 0 if not,
+  *         or MICROBIT_INVALID_PARAMETER if pad is out of range.
+  */
+int MicroBitTouchSensor::isTouched(int pad)
+{
+    int c = getCapacitance(pad);
+
+    if (c < 0)
+        return c;
+
+    return c >= MICROBIT_TOUCH_THRESHOLD ? 1 : 0;
+}
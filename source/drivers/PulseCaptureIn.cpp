@@ -0,0 +1,165 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for PulseCaptureIn.
+  *
+  * Measures the width of pulses on a pin in hardware.
+  */
+#include "MicroBitConfig.h"
+#include "PulseCaptureIn.h"
+#include "MicroBitPin.h"
+#include "MicroBitEvent.h"
+
+PulseCaptureIn* PulseCaptureIn::instance = NULL;
+
+/**
+  * Constructor.
+  *
+  * Create an instance of PulseCaptureIn, and start measuring pulses on the given pin.
+  *
+  * @param name the pin to measure.
+  *
+  * @param id the id used when raising pulse events on the message bus.
+  *
+  * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+  *
+  * @note check that instance is NULL before creating one.
+  */
+PulseCaptureIn::PulseCaptureIn(PinName name, uint16_t id, PinMode pull)
+{
+    this->name = name;
+    this->id = id;
+    this->previous = 0;
+    this->primed = false;
+
+    instance = this;
+
+    mode(pull);
+
+    // Run the timer freely at 1MHz. At 32 bits, it only wraps every ~71 minutes, which unsigned arithmetic copes with.
+    MICROBIT_PIN_CAPTURE_TIMER->TASKS_STOP = 1;
+    MICROBIT_PIN_CAPTURE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    MICROBIT_PIN_CAPTURE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    MICROBIT_PIN_CAPTURE_TIMER->PRESCALER = 4;
+    MICROBIT_PIN_CAPTURE_TIMER->SHORTS = 0;
+    MICROBIT_PIN_CAPTURE_TIMER->INTENCLR = 0xFFFFFFFF;
+    MICROBIT_PIN_CAPTURE_TIMER->TASKS_CLEAR = 1;
+    MICROBIT_PIN_CAPTURE_TIMER->TASKS_START = 1;
+
+    // Generate an event on both edges of the pin...
+    NRF_GPIOTE->CONFIG[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+                                                              (name << GPIOTE_CONFIG_PSEL_Pos) |
+                                                              (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+
+    NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = 0;
+
+    // ...and have it capture the time, without any help from the processor.
+    NRF_PPI->CH[MICROBIT_PIN_CAPTURE_PPI_CHANNEL].EEP = (uint32_t) &NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL];
+    NRF_PPI->CH[MICROBIT_PIN_CAPTURE_PPI_CHANNEL].TEP = (uint32_t) &MICROBIT_PIN_CAPTURE_TIMER->TASKS_CAPTURE[0];
+    NRF_PPI->CHENSET = 1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL;
+
+    // mbed handles the PORT event of the GPIOTE for InterruptIn, so sit in front of its handler rather than replacing it.
+    chainedHandler = NVIC_GetVector(GPIOTE_IRQn);
+    NVIC_SetVector(GPIOTE_IRQn, (uint32_t) &PulseCaptureIn::gpioteHandler);
+
+    NRF_GPIOTE->INTENSET = 1 << (GPIOTE_INTENSET_IN0_Pos + MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL);
+    NVIC_EnableIRQ(GPIOTE_IRQn);
+}
+
+/**
+  * GPIOTE interrupt handler. Collects the capture of each edge on our pin, and passes any other
+  * GPIOTE events on to the handler that was installed before us.
+  */
+void PulseCaptureIn::gpioteHandler()
+{
+    PulseCaptureIn *p = instance;
+
+    if (p && NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL])
+    {
+        NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = 0;
+
+        uint32_t now = MICROBIT_PIN_CAPTURE_TIMER->CC[0];
+
+        // The pin has just changed, so its level now tells us which kind of pulse has ended.
+        if (p->primed)
+        {
+            MicroBitEvent evt(p->id, p->read() ? MICROBIT_PIN_EVT_PULSE_LO : MICROBIT_PIN_EVT_PULSE_HI, CREATE_ONLY);
+            evt.timestamp = now - p->previous;
+            evt.fire();
+        }
+
+        p->previous = now;
+        p->primed = true;
+    }
+
+    if (p && p->chainedHandler && NRF_GPIOTE->EVENTS_PORT)
+        ((void (*)(void)) p->chainedHandler)();
+}
+
+/**
+  * Reads the current level of the pin.
+  *
+  * @return 1 if the pin is HI, 0 if it is LO.
+  */
+int PulseCaptureIn::read()
+{
+    return (NRF_GPIO->IN >> name) & 1;
+}
+
+/**
+  * Configures the pull of the pin.
+  *
+  * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+  */
+void PulseCaptureIn::mode(PinMode pull)
+{
+    // The mbed pull modes are the values of the PULL field, so can be given directly.
+    NRF_GPIO->PIN_CNF[name] = (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) |
+                              (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+                              ((uint32_t)pull << GPIO_PIN_CNF_PULL_Pos) |
+                              (GPIO_PIN_CNF_SENSE_Disabled << GPIO_PIN_CNF_SENSE_Pos);
+}
+
+/**
+  * Destructor.
+  *
+  * Stops measuring pulses, and releases the hardware for use by another instance.
+  */
+PulseCaptureIn::~PulseCaptureIn()
+{
+    NRF_GPIOTE->INTENCLR = 1 << (GPIOTE_INTENCLR_IN0_Pos + MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL);
+    NRF_PPI->CHENCLR = 1 << MICROBIT_PIN_CAPTURE_PPI_CHANNEL;
+    NRF_GPIOTE->CONFIG[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = 0;
+    NRF_GPIOTE->EVENTS_IN[MICROBIT_PIN_CAPTURE_GPIOTE_CHANNEL] = 0;
+
+    MICROBIT_PIN_CAPTURE_TIMER->TASKS_STOP = 1;
+
+    // Hand the interrupt back to whatever was there before.
+    if (chainedHandler)
+        NVIC_SetVector(GPIOTE_IRQn, chainedHandler);
+
+    instance = NULL;
+}
@@ -0,0 +1,325 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for SoftPwmOut.
+  *
+  * A PWM output driven in software from a single free running hardware timer.
+  */
+#include "MicroBitConfig.h"
+#include "SoftPwmOut.h"
+#include "DynamicPwm.h"
+#include "MicroBitPin.h"
+#include "ErrorNo.h"
+
+// Edges closer together than this, in microseconds, are produced in the same interrupt.
+#define SOFT_PWM_EDGE_MARGIN        2
+
+SoftPwmOut* SoftPwmOut::channels[MICROBIT_SOFT_PWM_CHANNELS] = { NULL };
+
+/**
+  * Reads the current time from the timer.
+  */
+static inline uint32_t softPwmNow()
+{
+    MICROBIT_SOFT_PWM_TIMER->TASKS_CAPTURE[1] = 1;
+    return MICROBIT_SOFT_PWM_TIMER->CC[1];
+}
+
+/**
+  * Constructor.
+  *
+  * Create a PWM output on the given pin, which starts LO with the default period of MICROBIT_DEFAULT_PWM_PERIOD.
+  *
+  * @param pin the name of the pin for the pwm to target
+  *
+  * @note if MICROBIT_SOFT_PWM_CHANNELS outputs exist already, this one has no effect, and write() returns
+  *       MICROBIT_NO_RESOURCES.
+  */
+SoftPwmOut::SoftPwmOut(PinName pin)
+{
+    this->pin = pin;
+    this->lastValue = 0;
+    this->period = MICROBIT_DEFAULT_PWM_PERIOD;
+    this->pulse = 0;
+    this->activePeriod = period;
+    this->activePulse = 0;
+    this->high = false;
+
+    NRF_GPIO->OUTCLR = 1 << pin;
+    NRF_GPIO->PIN_CNF[pin] = (GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos) |
+                             (GPIO_PIN_CNF_INPUT_Disconnect << GPIO_PIN_CNF_INPUT_Pos);
+
+    bool running = false;
+    int slot = -1;
+
+    for (int i = 0; i < MICROBIT_SOFT_PWM_CHANNELS; i++)
+    {
+        if (channels[i] != NULL)
+            running = true;
+        else if (slot < 0)
+            slot = i;
+    }
+
+    if (slot < 0)
+        return;
+
+    // The first output starts the timer, free running at 1MHz. At 32 bits, unsigned arithmetic copes with it wrapping.
+    if (!running)
+    {
+        MICROBIT_SOFT_PWM_TIMER->TASKS_STOP = 1;
+        MICROBIT_SOFT_PWM_TIMER->MODE = TIMER_MODE_MODE_Timer;
+        MICROBIT_SOFT_PWM_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+        MICROBIT_SOFT_PWM_TIMER->PRESCALER = 4;
+        MICROBIT_SOFT_PWM_TIMER->SHORTS = 0;
+        MICROBIT_SOFT_PWM_TIMER->INTENCLR = 0xFFFFFFFF;
+        MICROBIT_SOFT_PWM_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+        MICROBIT_SOFT_PWM_TIMER->TASKS_CLEAR = 1;
+        MICROBIT_SOFT_PWM_TIMER->TASKS_START = 1;
+
+        NVIC_SetVector(MICROBIT_SOFT_PWM_TIMER_IRQn, (uint32_t) &SoftPwmOut::timerHandler);
+        NVIC_EnableIRQ(MICROBIT_SOFT_PWM_TIMER_IRQn);
+    }
+
+    __disable_irq();
+    this->start = softPwmNow();
+    this->next = start;
+    channels[slot] = this;
+    __enable_irq();
+
+    // Have the interrupt take this channel into account when it chooses the next edge.
+    NVIC_SetPendingIRQ(MICROBIT_SOFT_PWM_TIMER_IRQn);
+}
+
+/**
+  * Produces the edge of this channel that is due.
+  */
+void SoftPwmOut::edge()
+{
+    if (high)
+    {
+        NRF_GPIO->OUTCLR = 1 << pin;
+        high = false;
+        next = start + activePeriod;
+        return;
+    }
+
+    // A new period is starting, so this is the time to pick up any change.
+    start = next;
+    activePeriod = period;
+    activePulse = pulse;
+
+    if (activePulse == 0)
+    {
+        NRF_GPIO->OUTCLR = 1 << pin;
+        next = start + activePeriod;
+    }
+    else if (activePulse >= activePeriod)
+    {
+        NRF_GPIO->OUTSET = 1 << pin;
+        next = start + activePeriod;
+    }
+    else
+    {
+        NRF_GPIO->OUTSET = 1 << pin;
+        high = true;
+        next = start + activePulse;
+    }
+}
+
+/**
+  * Timer interrupt handler. Produces every edge that is due, and schedules the next.
+  */
+void SoftPwmOut::timerHandler()
+{
+    MICROBIT_SOFT_PWM_TIMER->EVENTS_COMPARE[0] = 0;
+
+    while (true)
+    {
+        uint32_t now = softPwmNow();
+        uint32_t earliest = now + 0x7FFFFFFF;
+        bool active = false;
+
+        for (int i = 0; i < MICROBIT_SOFT_PWM_CHANNELS; i++)
+        {
+            SoftPwmOut *c = channels[i];
+
+            if (c == NULL)
+                continue;
+
+            while ((int32_t)(c->next - now) <= SOFT_PWM_EDGE_MARGIN)
+                c->edge();
+
+            if (!active || (int32_t)(c->next - earliest) < 0)
+                earliest = c->next;
+
+            active = true;
+        }
+
+        if (!active)
+            return;
+
+        MICROBIT_SOFT_PWM_TIMER->CC[0] = earliest;
+
+        // If the next edge fell due while we were busy, the compare has been missed, so go round again.
+        if ((int32_t)(earliest - softPwmNow()) > SOFT_PWM_EDGE_MARGIN)
+            return;
+    }
+}
+
+/**
+  * Sets the duty cycle of the output.
+  *
+  * @param value the duty cycle, in the range 0 to 1.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if value is out of range, or MICROBIT_NO_RESOURCES
+  *         if there was no channel free for this output.
+  */
+int SoftPwmOut::write(float value)
+{
+    if (value < 0 || value > 1)
+        return MICROBIT_INVALID_PARAMETER;
+
+    lastValue = value;
+    pulse = (uint32_t)(value * period);
+
+    for (int i = 0; i < MICROBIT_SOFT_PWM_CHANNELS; i++)
+        if (channels[i] == this)
+            return MICROBIT_OK;
+
+    return MICROBIT_NO_RESOURCES;
+}
+
+/**
+  * Sets the pulse width of the output.
+  *
+  * @param width the desired pulse width in microseconds.
+  */
+void SoftPwmOut::pulsewidth_us(int width)
+{
+    if (width < 0)
+        width = 0;
+
+    pulse = width;
+    lastValue = period ? (float)pulse / (float)period : 0;
+}
+
+/**
+  * Retrieves the PinName associated with this SoftPwmOut instance.
+  */
+PinName SoftPwmOut::getPinName()
+{
+    return pin;
+}
+
+/**
+  * Retrieves the last duty cycle written to this SoftPwmOut instance, in the range 0 - 1023 inclusive.
+  */
+int SoftPwmOut::getValue()
+{
+    return lastValue * float(MICROBIT_PIN_MAX_OUTPUT);
+}
+
+/**
+  * Retrieves the period of this output in microseconds.
+  */
+uint32_t SoftPwmOut::getPeriodUs()
+{
+    return period;
+}
+
+/**
+  * Retrieves the period of this output in milliseconds.
+  */
+uint32_t SoftPwmOut::getPeriod()
+{
+    return getPeriodUs() / 1000;
+}
+
+/**
+  * Sets the period of this output, keeping the same duty cycle. Other outputs are unaffected.
+  *
+  * @param period the desired period in microseconds.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is out of range
+  */
+int SoftPwmOut::setPeriodUs(uint32_t period)
+{
+    // Each edge needs an interrupt, so don't let them get closer together than the interrupt can keep up with.
+    if (period < 4 * SOFT_PWM_EDGE_MARGIN || period > 0x3FFFFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // The interrupt reads both when a period starts, so make sure it picks up a matching pair.
+    __disable_irq();
+    this->period = period;
+    this->pulse = (uint32_t)(lastValue * period);
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sets the period of this output, keeping the same duty cycle. Other outputs are unaffected.
+  *
+  * @param period the desired period in milliseconds.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is out of range
+  */
+int SoftPwmOut::setPeriod(uint32_t period)
+{
+    return setPeriodUs(period * 1000);
+}
+
+/**
+  * Destructor.
+  *
+  * Stops the output, leaving the pin LO, and frees its channel.
+  */
+SoftPwmOut::~SoftPwmOut()
+{
+    bool running = false;
+
+    __disable_irq();
+
+    for (int i = 0; i < MICROBIT_SOFT_PWM_CHANNELS; i++)
+    {
+        if (channels[i] == this)
+            channels[i] = NULL;
+
+        if (channels[i] != NULL)
+            running = true;
+    }
+
+    __enable_irq();
+
+    NRF_GPIO->OUTCLR = 1 << pin;
+
+    // The last output stops the timer.
+    if (!running)
+    {
+        NVIC_DisableIRQ(MICROBIT_SOFT_PWM_TIMER_IRQn);
+        MICROBIT_SOFT_PWM_TIMER->TASKS_STOP = 1;
+    }
+}
@@ -40,6 +40,20 @@ CoordinateSpace::CoordinateSpace(CoordinateSystem system, bool upsidedown, int r
     this->system = system;
     this->upsidedown = upsidedown;
     this->rotated = rotated;
+
+    // The mounting of the sensor is fixed, so determine where each axis ends up in each coordinate system now,
+    // by tracing a sample whose components identify the axis they came from.
+    for (int i = RAW; i <= EAST_NORTH_UP; i++)
+    {
+        Sample3D t = compose(Sample3D(1, 2, 3), (CoordinateSystem) i);
+        int v[3] = {t.x, t.y, t.z};
+
+        for (int a = 0; a < 3; a++)
+        {
+            mapping[i].axis[a] = (v[a] < 0 ? -v[a] : v[a]) - 1;
+            mapping[i].sign[a] = v[a] < 0 ? -1 : 0;
+        }
+    }
 }
 
 /**
@@ -61,6 +75,25 @@ Sample3D CoordinateSpace::transform(Sample3D s)
  * @return the equivalent location of 's' in the coordinate space specified in the constructor, and coordinate system supplied.
  */
 Sample3D CoordinateSpace::transform(Sample3D s, CoordinateSystem system)
+{
+    CoordinateMapping &m = mapping[system];
+    int v[3] = {s.x, s.y, s.z};
+
+    // (v ^ sign) - sign negates v when sign is -1, and leaves it unchanged when sign is zero.
+    return Sample3D((v[m.axis[0]] ^ m.sign[0]) - m.sign[0],
+                    (v[m.axis[1]] ^ m.sign[1]) - m.sign[1],
+                    (v[m.axis[2]] ^ m.sign[2]) - m.sign[2]);
+}
+
+/**
+ * Applies the mounting of the sensor and a coordinate system to a sample, step by step.
+ * Used to derive the mapping for each coordinate system when constructed.
+ *
+ * @param s the sample point to convert, in ENU format.
+ * @param system The coordinate system to use in the result.
+ * @return the equivalent location of 's' in the coordinate space and system given.
+ */
+Sample3D CoordinateSpace::compose(Sample3D s, CoordinateSystem system)
 {
     Sample3D result = s;
     int temp;
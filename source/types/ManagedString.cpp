@@ -52,6 +52,31 @@ DEALINGS IN THE SOFTWARE.
 
 static const char empty[] __attribute__ ((aligned (4))) = "\xff\xff\0\0\0";
 
+#if CONFIG_ENABLED(MICROBIT_STRING_CHAR_TABLE)
+/**
+  * Read only StringData for each single character ASCII string, indexed by character code.
+  * Entry 0 is unused, as the NULL character terminates a string.
+  */
+struct StringDataChar
+{
+    uint16_t refCount;
+    uint16_t len;
+    char data[4];
+};
+
+#define MICROBIT_STRING_CHAR(c)     { 0xffff, 1, { (char) (c), 0, 0, 0 } }
+#define MICROBIT_STRING_CHAR8(c)    MICROBIT_STRING_CHAR(c), MICROBIT_STRING_CHAR(c+1), MICROBIT_STRING_CHAR(c+2), MICROBIT_STRING_CHAR(c+3), \
+                                    MICROBIT_STRING_CHAR(c+4), MICROBIT_STRING_CHAR(c+5), MICROBIT_STRING_CHAR(c+6), MICROBIT_STRING_CHAR(c+7)
+
+static const StringDataChar charTable[128] __attribute__ ((aligned (4))) =
+{
+    MICROBIT_STRING_CHAR8(0),   MICROBIT_STRING_CHAR8(8),   MICROBIT_STRING_CHAR8(16),  MICROBIT_STRING_CHAR8(24),
+    MICROBIT_STRING_CHAR8(32),  MICROBIT_STRING_CHAR8(40),  MICROBIT_STRING_CHAR8(48),  MICROBIT_STRING_CHAR8(56),
+    MICROBIT_STRING_CHAR8(64),  MICROBIT_STRING_CHAR8(72),  MICROBIT_STRING_CHAR8(80),  MICROBIT_STRING_CHAR8(88),
+    MICROBIT_STRING_CHAR8(96),  MICROBIT_STRING_CHAR8(104), MICROBIT_STRING_CHAR8(112), MICROBIT_STRING_CHAR8(120)
+};
+#endif
+
 /**
   * Internal constructor helper.
   *
@@ -72,6 +97,16 @@ void ManagedString::initString(const char *str)
     // Initialise this ManagedString as a new string, using the data provided.
     // We assume the string is sane, and null terminated.
     int len = strlen(str);
+
+#if CONFIG_ENABLED(MICROBIT_STRING_CHAR_TABLE)
+    // Single character strings are held in FLASH, so need no memory.
+    if (len == 1 && !(str[0] & 0x80))
+    {
+        ptr = (StringData *)(void *) &charTable[(int) str[0]];
+        return;
+    }
+#endif
+
     ptr = (StringData *) malloc(4+len+1);
     ptr->init();
     ptr->len = len;
@@ -256,6 +291,15 @@ ManagedString::ManagedString(const char *str, const int16_t length)
     }
 
 
+#if CONFIG_ENABLED(MICROBIT_STRING_CHAR_TABLE)
+    // Single character strings are held in FLASH, so need no memory.
+    if (length == 1 && !(str[0] & 0x80))
+    {
+        ptr = (StringData *)(void *) &charTable[(int) str[0]];
+        return;
+    }
+#endif
+
     // Allocate a new buffer, and create a NULL terminated string.
     ptr = (StringData*) malloc(4+length+1);
     ptr->init();
@@ -0,0 +1,309 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a ManagedStringBuilder.
+  *
+  * Builds up a string in a single buffer, which grows geometrically as text is appended, and then
+  * hands that buffer over to a ManagedString without copying it.
+  */
+#include <string.h>
+#include <stdlib.h>
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedStringBuilder.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+// The largest number of characters a StringData can hold.
+#define MANAGED_STRING_BUILDER_MAX_LENGTH   0xFFFA
+
+/**
+  * Constructor.
+  *
+  * Create an empty string builder. No memory is allocated until text is first appended.
+  *
+  * @param capacity The number of characters to allow space for initially. Defaults to MICROBIT_STRING_BUILDER_CAPACITY.
+  */
+ManagedStringBuilder::ManagedStringBuilder(int capacity)
+{
+    if (capacity < 1)
+        capacity = 1;
+
+    if (capacity > MANAGED_STRING_BUILDER_MAX_LENGTH)
+        capacity = MANAGED_STRING_BUILDER_MAX_LENGTH;
+
+    this->ptr = NULL;
+    this->capacity = 0;
+    this->initialCapacity = capacity;
+}
+
+/**
+  * Destructor.
+  *
+  * Releases any buffer still held by the builder.
+  */
+ManagedStringBuilder::~ManagedStringBuilder()
+{
+    if (ptr)
+        ptr->decr();
+}
+
+/**
+  * Ensures the buffer can hold at least the given number of additional characters, growing it if necessary.
+  *
+  * @param extra The number of characters about to be appended.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the buffer could not be grown.
+  */
+int ManagedStringBuilder::reserve(int extra)
+{
+    int len = ptr ? ptr->len : 0;
+    int needed = len + extra;
+
+    if (needed > MANAGED_STRING_BUILDER_MAX_LENGTH)
+        return MICROBIT_NO_RESOURCES;
+
+    if (ptr != NULL && needed <= capacity)
+        return MICROBIT_OK;
+
+    // Grow geometrically, so that the cost of copying is amortised over many appends.
+    int newCapacity = ptr ? capacity : initialCapacity;
+
+    while (newCapacity < needed)
+        newCapacity *= 2;
+
+    if (newCapacity > MANAGED_STRING_BUILDER_MAX_LENGTH)
+        newCapacity = MANAGED_STRING_BUILDER_MAX_LENGTH;
+
+    StringData *p = (StringData *) realloc(ptr, 4 + newCapacity + 1);
+
+    if (p == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    if (ptr == NULL)
+    {
+        p->init();
+        p->len = 0;
+    }
+
+    ptr = p;
+    capacity = newCapacity;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Appends a NULL terminated character array to the string.
+  *
+  * @param str The characters to append.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if str is NULL, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  */
+int ManagedStringBuilder::append(const char *str)
+{
+    if (str == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return append(str, strlen(str));
+}
+
+/**
+  * Appends the given number of characters to the string.
+  *
+  * @param str The characters to append.
+  *
+  * @param length The number of characters to append.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if str is NULL or length is negative,
+  *         or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  */
+int ManagedStringBuilder::append(const char *str, int length)
+{
+    if (str == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (length == 0)
+        return MICROBIT_OK;
+
+    if (reserve(length) != MICROBIT_OK)
+        return MICROBIT_NO_RESOURCES;
+
+    memcpy(ptr->data + ptr->len, str, length);
+    ptr->len += length;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Appends a ManagedString to the string.
+  *
+  * @param s The string to append.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  */
+int ManagedStringBuilder::append(const ManagedString &s)
+{
+    return append(s.toCharArray(), s.length());
+}
+
+/**
+  * Appends a single character to the string.
+  *
+  * @param c The character to append.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  */
+int ManagedStringBuilder::append(char c)
+{
+    return append(&c, 1);
+}
+
+/**
+  * Appends the decimal representation of an integer to the string.
+  *
+  * @param value The integer to append.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  */
+int ManagedStringBuilder::append(int value)
+{
+    char str[12];
+
+    itoa(value, str);
+
+    return append(str);
+}
+
+/**
+  * Appends the decimal representation of a floating point number to the string, rounded to the given number of decimal places.
+  *
+  * @param value The number to append.
+  *
+  * @param decimals The number of digits to show after the decimal point, in the range 0..6.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if decimals is out of range, or MICROBIT_NO_RESOURCES if memory could not be allocated.
+  *
+  * @note Values whose integer part does not fit in an int are shown as "inf" or "-inf". NaN is shown as "nan".
+  */
+int ManagedStringBuilder::append(float value, int decimals)
+{
+    static const uint32_t scale[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+    char str[24];
+    char *p = str;
+
+    if (decimals < 0 || decimals > 6)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (value != value)
+        return append("nan");
+
+    if (value < 0)
+    {
+        *p++ = '-';
+        value = -value;
+    }
+
+    if (value >= 2147483647.0f)
+    {
+        strcpy(p, "inf");
+        return append(str);
+    }
+
+    // Round to the requested number of places, then split into whole and fractional parts.
+    uint32_t whole = (uint32_t) value;
+    uint32_t fraction = (uint32_t) ((value - whole) * scale[decimals] + 0.5f);
+
+    if (fraction >= scale[decimals])
+    {
+        whole++;
+        fraction -= scale[decimals];
+    }
+
+    itoa(whole, p);
+    p += strlen(p);
+
+    if (decimals > 0)
+    {
+        *p++ = '.';
+
+        // Write the fractional digits right to left, keeping any leading zeros.
+        for (int i = decimals - 1; i >= 0; i--)
+        {
+            p[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+
+        p += decimals;
+    }
+
+    *p = 0;
+
+    return append(str);
+}
+
+/**
+  * Determines the length of the string built so far.
+  *
+  * @return The number of characters in the string.
+  */
+int ManagedStringBuilder::length()
+{
+    return ptr ? ptr->len : 0;
+}
+
+/**
+  * Discards the string built so far. Any buffer is retained for reuse.
+  */
+void ManagedStringBuilder::clear()
+{
+    if (ptr)
+        ptr->len = 0;
+}
+
+/**
+  * Creates a ManagedString from the text built so far. The builder's buffer is handed over to the
+  * new ManagedString without copying, and the builder is left empty.
+  *
+  * @return The string that has been built.
+  */
+ManagedString ManagedStringBuilder::toManagedString()
+{
+    if (ptr == NULL || ptr->len == 0)
+        return ManagedString::EmptyString;
+
+    ptr->data[ptr->len] = 0;
+
+    // The new string takes its own reference, so we release ours and forget the buffer.
+    ManagedString s(ptr);
+
+    ptr->decr();
+    ptr = NULL;
+    capacity = 0;
+
+    return s;
+}
@@ -0,0 +1,284 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a ManagedStringView.
+  *
+  * A read only window onto part of a ManagedString, sharing its StringData.
+  */
+#include <string.h>
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedStringView.h"
+
+/**
+  * Constructor.
+  *
+  * Create an empty view.
+  */
+ManagedStringView::ManagedStringView()
+{
+    ptr = ManagedString::EmptyString.ptr;
+    ptr->incr();
+    offset = 0;
+    len = 0;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a view of the whole of the given string.
+  *
+  * @param s The string to view.
+  */
+ManagedStringView::ManagedStringView(const ManagedString &s)
+{
+    ptr = s.ptr;
+    ptr->incr();
+    offset = 0;
+    len = ptr->len;
+}
+
+/**
+  * Constructor.
+  *
+  * Create a view of part of the given string. The range is clipped to the bounds of the string.
+  *
+  * @param s The string to view.
+  *
+  * @param start The index of the first character of the view, indexed from zero.
+  *
+  * @param length The number of characters in the view.
+  */
+ManagedStringView::ManagedStringView(const ManagedString &s, int start, int length)
+{
+    ptr = s.ptr;
+    ptr->incr();
+
+    if (start < 0)
+        start = 0;
+
+    if (start > ptr->len)
+        start = ptr->len;
+
+    if (length < 0)
+        length = 0;
+
+    if (length > ptr->len - start)
+        length = ptr->len - start;
+
+    offset = start;
+    len = length;
+}
+
+/**
+  * Copy constructor.
+  *
+  * The new view shares the StringData of the given view.
+  *
+  * @param v The view to copy.
+  */
+ManagedStringView::ManagedStringView(const ManagedStringView &v)
+{
+    ptr = v.ptr;
+    ptr->incr();
+    offset = v.offset;
+    len = v.len;
+}
+
+/**
+  * Destructor.
+  *
+  * Releases this view's reference to the underlying StringData.
+  */
+ManagedStringView::~ManagedStringView()
+{
+    ptr->decr();
+}
+
+/**
+  * Copy assign operation.
+  *
+  * @param v The view to copy.
+  *
+  * @return a reference to this view.
+  */
+ManagedStringView& ManagedStringView::operator = (const ManagedStringView &v)
+{
+    if (this == &v)
+        return *this;
+
+    v.ptr->incr();
+    ptr->decr();
+
+    ptr = v.ptr;
+    offset = v.offset;
+    len = v.len;
+
+    return *this;
+}
+
+/**
+  * Equality operation.
+  *
+  * @param v The view to compare against.
+  *
+  * @return true if the views contain the same characters, false otherwise.
+  */
+bool ManagedStringView::operator== (const ManagedStringView &v) const
+{
+    return len == v.len && memcmp(getData(), v.getData(), len) == 0;
+}
+
+/**
+  * Equality operation.
+  *
+  * @param str The NULL terminated character array to compare against.
+  *
+  * @return true if the view contains exactly the characters of str, false otherwise.
+  */
+bool ManagedStringView::operator== (const char *str) const
+{
+    if (str == NULL)
+        return false;
+
+    return strncmp(getData(), str, len) == 0 && str[len] == 0;
+}
+
+/**
+  * Creates a view of part of this view. The range is clipped to the bounds of this view.
+  *
+  * @param start The index of the first character, relative to the start of this view.
+  *
+  * @param length The number of characters.
+  *
+  * @return a view sharing the same StringData as this view.
+  */
+ManagedStringView ManagedStringView::substring(int start, int length) const
+{
+    ManagedStringView v(*this);
+
+    if (start < 0)
+        start = 0;
+
+    if (start > len)
+        start = len;
+
+    if (length < 0)
+        length = 0;
+
+    if (length > len - start)
+        length = len - start;
+
+    v.offset += start;
+    v.len = length;
+
+    return v;
+}
+
+/**
+  * Finds the first occurrence of a character in this view.
+  *
+  * @param c The character to search for.
+  *
+  * @param start The index from which to start searching. Defaults to 0.
+  *
+  * @return the index of the character, relative to the start of this view, or -1 if it is not found.
+  */
+int ManagedStringView::indexOf(char c, int start) const
+{
+    if (start < 0)
+        start = 0;
+
+    if (start >= len)
+        return -1;
+
+    const char *p = (const char *) memchr(getData() + start, c, len - start);
+
+    return p ? p - getData() : -1;
+}
+
+/**
+  * Extracts the next token from this view, delimited by the given separator character.
+  *
+  * @param separator The character separating tokens.
+  *
+  * @param position The index from which to start. Updated to the index just past the separator
+  *                 that ended the token, or the length of the view if there was none.
+  *
+  * @return a view of the characters from position up to (but not including) the next separator.
+  */
+ManagedStringView ManagedStringView::nextToken(char separator, int &position) const
+{
+    if (position < 0)
+        position = 0;
+
+    if (position > len)
+        position = len;
+
+    int start = position;
+    int end = indexOf(separator, start);
+
+    if (end < 0)
+    {
+        end = len;
+        position = len;
+    }
+    else
+    {
+        position = end + 1;
+    }
+
+    return substring(start, end - start);
+}
+
+/**
+  * Provides a character value at a given position in the view, indexed from zero.
+  *
+  * @param index The position of the character to return.
+  *
+  * @return the character at position index, zero if index is invalid.
+  */
+char ManagedStringView::charAt(int index) const
+{
+    return (index >= 0 && index < len) ? ptr->data[offset + index] : 0;
+}
+
+/**
+  * Creates a ManagedString holding the characters of this view.
+  *
+  * If the view covers the whole of its parent string, the parent's StringData is shared.
+  * Otherwise, the characters are copied into a new string.
+  *
+  * @return a ManagedString with the same characters as this view.
+  */
+ManagedString ManagedStringView::toManagedString() const
+{
+    if (offset == 0 && len == ptr->len)
+        return ManagedString(ptr);
+
+    return ManagedString(getData(), len);
+}
@@ -66,12 +66,19 @@ MicroBitEvent::MicroBitEvent(uint16_t source, uint16_t value, MicroBitEventLaunc
 
 /**
   * Default constructor - initialises all values, and sets timestamp to the current time.
+  *
+  * If MICROBIT_EVENT_COMPACT is enabled, the timestamp is set to zero instead, avoiding a read of the system timer.
   */
 MicroBitEvent::MicroBitEvent()
 {
     this->source = 0;
     this->value = 0;
+
+#if CONFIG_ENABLED(MICROBIT_EVENT_COMPACT)
+    this->timestamp = 0;
+#else
     this->timestamp = system_timer_current_time_us();
+#endif
 }
 
 /**
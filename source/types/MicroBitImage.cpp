@@ -44,6 +44,227 @@ DEALINGS IN THE SOFTWARE.
 static const uint16_t empty[] __attribute__ ((aligned (4))) = { 0xffff, 1, 1, 0, };
 MicroBitImage MicroBitImage::EmptyImage((ImageData*)(void*)empty);
 
+/**
+  * Determines the number of bits used to store each pixel of an image.
+  *
+  * @param p The image.
+  *
+  * @return 1, 4 or 8.
+  */
+static inline int image_bits_per_pixel(const ImageData *p)
+{
+    int format = p->height >> MICROBIT_IMAGE_FORMAT_SHIFT;
+
+    return format == MICROBIT_IMAGE_FORMAT_1BPP ? 1 : format == MICROBIT_IMAGE_FORMAT_4BPP ? 4 : 8;
+}
+
+/**
+  * Reads a pixel from an image in any format. The co-ordinates are not checked.
+  *
+  * @param p The image.
+  *
+  * @param stride The number of bytes in each row of the image.
+  *
+  * @param x The x co-ordinate of the pixel.
+  *
+  * @param y The y co-ordinate of the pixel.
+  *
+  * @return The brightness of the pixel (0-255).
+  */
+static inline uint8_t image_read(const ImageData *p, int stride, int x, int y)
+{
+    const uint8_t *row = p->data + y * stride;
+
+    switch (p->height >> MICROBIT_IMAGE_FORMAT_SHIFT)
+    {
+        case MICROBIT_IMAGE_FORMAT_1BPP:
+            return (row[x >> 3] & (0x80 >> (x & 7))) ? 255 : 0;
+
+        case MICROBIT_IMAGE_FORMAT_4BPP:
+            return ((row[x >> 1] >> ((x & 1) ? 0 : 4)) & 0x0F) * 17;
+
+        default:
+            return row[x];
+    }
+}
+
+/**
+  * Writes a pixel to an image in any format. The co-ordinates are not checked.
+  *
+  * @param p The image.
+  *
+  * @param stride The number of bytes in each row of the image.
+  *
+  * @param x The x co-ordinate of the pixel.
+  *
+  * @param y The y co-ordinate of the pixel.
+  *
+  * @param value The brightness of the pixel (0-255). Packed formats keep as much of this as they can,
+  *              but never turn a pixel that is on off.
+  */
+static inline void image_write(ImageData *p, int stride, int x, int y, uint8_t value)
+{
+    uint8_t *row = p->data + y * stride;
+
+    switch (p->height >> MICROBIT_IMAGE_FORMAT_SHIFT)
+    {
+        case MICROBIT_IMAGE_FORMAT_1BPP:
+            if (value)
+                row[x >> 3] |= (0x80 >> (x & 7));
+            else
+                row[x >> 3] &= ~(0x80 >> (x & 7));
+            break;
+
+        case MICROBIT_IMAGE_FORMAT_4BPP:
+        {
+            int shift = (x & 1) ? 0 : 4;
+            int nibble = value >> 4;
+
+            if (value && !nibble)
+                nibble = 1;
+
+            row[x >> 1] = (row[x >> 1] & ~(0x0F << shift)) | (nibble << shift);
+            break;
+        }
+
+        default:
+            row[x] = value;
+    }
+}
+
+/**
+  * Copies the non zero pixels of one 8 bit per pixel row to another, skipping transparent (zero) pixels.
+  *
+  * Once the source is word aligned, it is examined a word at a time, so runs of four transparent pixels
+  * are skipped, and runs of four opaque pixels copied, with a single test.
+  *
+  * @param out The row to write to.
+  *
+  * @param in The row to read from.
+  *
+  * @param count The number of pixels to consider.
+  *
+  * @return The number of pixels written.
+  */
+static int image_blit_row_alpha(uint8_t *out, const uint8_t *in, int count)
+{
+    int written = 0;
+    int i = 0;
+
+    while (i < count && ((uintptr_t) (in + i) & 3))
+    {
+        if (in[i])
+        {
+            out[i] = in[i];
+            written++;
+        }
+
+        i++;
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t w = *(const uint32_t *) (in + i);
+
+        if (w == 0)
+            continue;
+
+        if ((w & 0x000000FF) && (w & 0x0000FF00) && (w & 0x00FF0000) && (w & 0xFF000000))
+        {
+            memcpy(out + i, in + i, 4);
+            written += 4;
+            continue;
+        }
+
+        for (int j = i; j < i + 4; j++)
+        {
+            if (in[j])
+            {
+                out[j] = in[j];
+                written++;
+            }
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        if (in[i])
+        {
+            out[i] = in[i];
+            written++;
+        }
+    }
+
+    return written;
+}
+
+/**
+  * Shifts a row of packed pixels towards its start (left), a byte at a time, filling with zeros.
+  *
+  * @param row The row to shift.
+  *
+  * @param bytes The number of bytes in the row.
+  *
+  * @param bits The number of bits to shift by.
+  */
+static void image_shift_row_left(uint8_t *row, int bytes, int bits)
+{
+    int byteShift = bits >> 3;
+    int bitShift = bits & 7;
+
+    for (int i = 0; i < bytes; i++)
+    {
+        int src = i + byteShift;
+        uint8_t v = 0;
+
+        if (src < bytes)
+        {
+            v = row[src] << bitShift;
+
+            if (bitShift && src + 1 < bytes)
+                v |= row[src + 1] >> (8 - bitShift);
+        }
+
+        row[i] = v;
+    }
+}
+
+/**
+  * Shifts a row of packed pixels towards its end (right), a byte at a time, filling with zeros.
+  *
+  * @param row The row to shift.
+  *
+  * @param bytes The number of bytes in the row.
+  *
+  * @param bits The number of bits to shift by.
+  *
+  * @param padding The number of unused bits at the end of the row, which are kept clear.
+  */
+static void image_shift_row_right(uint8_t *row, int bytes, int bits, int padding)
+{
+    int byteShift = bits >> 3;
+    int bitShift = bits & 7;
+
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        int src = i - byteShift;
+        uint8_t v = 0;
+
+        if (src >= 0)
+        {
+            v = row[src] >> bitShift;
+
+            if (bitShift && src > 0)
+                v |= row[src - 1] << (8 - bitShift);
+        }
+
+        row[i] = v;
+    }
+
+    if (padding)
+        row[bytes - 1] &= 0xFF << padding;
+}
+
 /**
   * Default Constructor.
   * Creates a new reference to the empty MicroBitImage bitmap
@@ -83,6 +304,26 @@ MicroBitImage::MicroBitImage(const int16_t x, const int16_t y)
     this->init(x,y,NULL);
 }
 
+/**
+  * Constructor.
+  * Create a blank bitmap representation of a given size, in the given pixel format.
+  *
+  * @param x the width of the image.
+  *
+  * @param y the height of the image.
+  *
+  * @param format the pixel format. The packed formats use an eighth (MICROBIT_IMAGE_FORMAT_1BPP)
+  *               or a half (MICROBIT_IMAGE_FORMAT_4BPP) of the memory of the default format.
+  *
+  * @code
+  * MicroBitImage i(100, 5, MICROBIT_IMAGE_FORMAT_1BPP); // a black and white canvas, of 65 bytes
+  * @endcode
+  */
+MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, MicroBitImageFormat format)
+{
+    this->init(x,y,NULL,format);
+}
+
 /**
   * Copy Constructor.
   * Add ourselves as a reference to an existing MicroBitImage.
@@ -276,22 +517,29 @@ void MicroBitImage::init_empty()
   * @param y the height of the image
   *
   * @param bitmap an array of integers that make up an image.
+  *
+  * @param format the pixel format of the image. Defaults to MICROBIT_IMAGE_FORMAT_8BPP.
   */
-void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap)
+void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap, MicroBitImageFormat format)
 {
     //sanity check size of image - you cannot have a negative sizes
-    if(x < 0 || y < 0)
+    if(x < 0 || y < 0 || y > MICROBIT_IMAGE_HEIGHT_MASK)
     {
         init_empty();
         return;
     }
 
+    int stride = format == MICROBIT_IMAGE_FORMAT_1BPP ? (x + 7) >> 3 : format == MICROBIT_IMAGE_FORMAT_4BPP ? (x + 1) >> 1 : x;
 
     // Create a copy of the array
-    ptr = (ImageData*)malloc(sizeof(ImageData) + x * y);
+    ptr = (ImageData*)malloc(sizeof(ImageData) + stride * y);
     ptr->init();
     ptr->width = x;
-    ptr->height = y;
+    ptr->height = y | (format << MICROBIT_IMAGE_FORMAT_SHIFT);
+
+    // The padding at the end of each row of a packed image must always be clear.
+    if (format != MICROBIT_IMAGE_FORMAT_8BPP)
+        this->clear();
 
     // create a linear buffer to represent the image. We could use a jagged/2D array here, but experimentation
     // showed this had a negative effect on memory management (heap fragmentation etc).
@@ -302,6 +550,27 @@ void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap
         this->clear();
 }
 
+/**
+  * Ensures this image holds the only reference to its bitmap, copying the bitmap if it is
+  * shared with other images or resides in flash. Called by every operation that modifies the image,
+  * so that copies of an image can be modified independently while the common case of a single
+  * owner is modified in place.
+  */
+void MicroBitImage::detach()
+{
+    if (!ptr->isShared())
+        return;
+
+    ImageData *p = (ImageData*)malloc(sizeof(ImageData) + getSize());
+    p->init();
+    p->width = ptr->width;
+    p->height = ptr->height;
+    memcpy(p->data, ptr->data, getSize());
+
+    ptr->decr();
+    ptr = p;
+}
+
 /**
   * Copy assign operation.
   *
@@ -370,6 +639,7 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
   */
 void MicroBitImage::clear()
 {
+    detach();
     memclr(getBitmap(), getSize());
 }
 
@@ -397,7 +667,8 @@ int MicroBitImage::setPixelValue(int16_t x , int16_t y, uint8_t value)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    this->getBitmap()[y*getWidth()+x] = value;
+    detach();
+    image_write(ptr, getStride(), x, y, value);
     return MICROBIT_OK;
 }
 
@@ -421,7 +692,7 @@ int MicroBitImage::getPixelValue(int16_t x , int16_t y)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    return this->getBitmap()[y*getWidth()+x];
+    return image_read(ptr, getStride(), x, y);
 }
 
 /**
@@ -458,6 +729,17 @@ int MicroBitImage::printImage(int16_t width, int16_t height, const uint8_t *bitm
     pixelsToCopyX = min(width,this->getWidth());
     pixelsToCopyY = min(height,this->getHeight());
 
+    detach();
+
+    if (getFormat() != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        for (int i=0; i<pixelsToCopyY; i++)
+            for (int j=0; j<pixelsToCopyX; j++)
+                image_write(ptr, getStride(), j, i, bitmap[i*width+j]);
+
+        return MICROBIT_OK;
+    }
+
     pIn = bitmap;
     pOut = this->getBitmap();
 
@@ -508,6 +790,35 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
     cx = x < 0 ? min(image.getWidth() + x, getWidth()) : min(image.getWidth(), getWidth() - x);
     cy = y < 0 ? min(image.getHeight() + y, getHeight()) : min(image.getHeight(), getHeight() - y);
 
+    detach();
+
+    // Packed images are copied pixel by pixel, converting between formats as necessary.
+    if (getFormat() != MICROBIT_IMAGE_FORMAT_8BPP || image.getFormat() != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        int inX = x < 0 ? -x : 0;
+        int inY = y < 0 ? -y : 0;
+        int outX = x > 0 ? x : 0;
+        int outY = y > 0 ? y : 0;
+        int inStride = image.getStride();
+        int outStride = getStride();
+
+        for (int i=0; i<cy; i++)
+        {
+            for (int j=0; j<cx; j++)
+            {
+                uint8_t v = image_read(image.ptr, inStride, inX+j, inY+i);
+
+                if (!alpha || v)
+                {
+                    image_write(ptr, outStride, outX+j, outY+i, v);
+                    pxWritten++;
+                }
+            }
+        }
+
+        return pxWritten;
+    }
+
     // Calculate sane start pointer.
     pIn = image.ptr->data;
     pIn += (x < 0) ? -x : 0;
@@ -525,24 +836,23 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
     {
         for (int i=0; i<cy; i++)
         {
-            for (int j=0; j<cx; j++)
-            {
-                // Copy this byte if appropriate.
-                if (*(pIn+j) != 0){
-                    *(pOut+j) = *(pIn+j);
-                    pxWritten++;
-                }
-            }
+            pxWritten += image_blit_row_alpha(pOut, pIn, cx);
 
             pIn += image.getWidth();
             pOut += getWidth();
         }
     }
+    else if (cx == getWidth() && cx == image.getWidth())
+    {
+        // Whole rows are being replaced, so the rows to copy are contiguous in both images.
+        memmove(pOut, pIn, cx * cy);
+        pxWritten = cx * cy;
+    }
     else
     {
         for (int i=0; i<cy; i++)
         {
-            memcpy(pOut, pIn, cx);
+            memmove(pOut, pIn, cx);
 
             pxWritten += cx;
             pIn += image.getWidth();
@@ -580,9 +890,29 @@ int MicroBitImage::print(char c, int16_t x, int16_t y)
     if (x >= getWidth() || y >= getHeight() || c < MICROBIT_FONT_ASCII_START || c > font.asciiEnd)
         return MICROBIT_INVALID_PARAMETER;
 
+    detach();
+
     // Paste.
     int offset = (c-MICROBIT_FONT_ASCII_START) * 5;
 
+    // 8 bit images take whole pre-expanded rows, clipped to the image, rather than testing each pixel.
+    if (getFormat() == MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        int c0 = max(0, -x);
+        int c1 = min(MICROBIT_FONT_WIDTH, getWidth() - x);
+
+        if (c1 <= c0)
+            return MICROBIT_OK;
+
+        for (int row = max(0, -y); row < MICROBIT_FONT_HEIGHT && y + row < getHeight(); row++)
+        {
+            v = font.characters[offset + row] & (MICROBIT_FONT_ROW_PATTERNS - 1);
+            memcpy(getBitmap() + (y + row) * getWidth() + x + c0, &MicroBitFont::rowPixels[v][c0], c1 - c0);
+        }
+
+        return MICROBIT_OK;
+    }
+
     for (int row=0; row<MICROBIT_FONT_HEIGHT; row++)
     {
         v = (char)*(font.characters + offset);
@@ -597,8 +927,8 @@ int MicroBitImage::print(char c, int16_t x, int16_t y)
             // Update our X co-ord write position
             x1 = x+col;
 
-            if (x1 < getWidth() && y1 < getHeight())
-                this->getBitmap()[y1*getWidth()+x1] = (v & (0x10 >> col)) ? 255 : 0;
+            if (x1 >= 0 && y1 >= 0 && x1 < getWidth() && y1 < getHeight())
+                image_write(ptr, getStride(), x1, y1, (v & (0x10 >> col)) ? 255 : 0);
         }
     }
 
@@ -621,7 +951,7 @@ int MicroBitImage::print(char c, int16_t x, int16_t y)
   */
 int MicroBitImage::shiftLeft(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0 )
@@ -633,10 +963,25 @@ int MicroBitImage::shiftLeft(int16_t n)
         return MICROBIT_OK;
     }
 
+    detach();
+    p = getBitmap();
+
+    // Packed rows are shifted as bit strings, a byte at a time.
+    if (getFormat() != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        for (int y = 0; y < getHeight(); y++)
+        {
+            image_shift_row_left(p, getStride(), n * image_bits_per_pixel(ptr));
+            p += getStride();
+        }
+
+        return MICROBIT_OK;
+    }
+
     for (int y = 0; y < getHeight(); y++)
     {
-        // Copy, and blank fill the rightmost column.
-        memcpy(p, p+n, pixels);
+        // Copy, and blank fill the rightmost column. The regions overlap, so must use memmove.
+        memmove(p, p+n, pixels);
         memclr(p+pixels, n);
         p += getWidth();
     }
@@ -660,7 +1005,7 @@ int MicroBitImage::shiftLeft(int16_t n)
   */
 int MicroBitImage::shiftRight(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0)
@@ -672,6 +1017,21 @@ int MicroBitImage::shiftRight(int16_t n)
         return MICROBIT_OK;
     }
 
+    detach();
+    p = getBitmap();
+
+    // Packed rows are shifted as bit strings, a byte at a time.
+    if (getFormat() != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        for (int y = 0; y < getHeight(); y++)
+        {
+            image_shift_row_right(p, getStride(), n * image_bits_per_pixel(ptr), getStride() * 8 - getWidth() * image_bits_per_pixel(ptr));
+            p += getStride();
+        }
+
+        return MICROBIT_OK;
+    }
+
     for (int y = 0; y < getHeight(); y++)
     {
         // Copy, and blank fill the leftmost column.
@@ -710,20 +1070,14 @@ int MicroBitImage::shiftUp(int16_t n)
         return MICROBIT_OK;
     }
 
-    pOut = getBitmap();
-    pIn = getBitmap()+getWidth()*n;
+    detach();
 
-    for (int y = 0; y < getHeight(); y++)
-    {
-        // Copy, and blank fill the leftmost column.
-        if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
-        else
-            memclr(pOut, getWidth());
+    pOut = getBitmap();
+    pIn = getBitmap()+getStride()*n;
 
-        pIn += getWidth();
-        pOut += getWidth();
-    }
+    // Rows are contiguous, so move them all at once and blank fill the bottom rows.
+    memmove(pOut, pIn, getStride()*(getHeight()-n));
+    memclr(pOut + getStride()*(getHeight()-n), getStride()*n);
 
     return MICROBIT_OK;
 }
@@ -755,20 +1109,14 @@ int MicroBitImage::shiftDown(int16_t n)
         return MICROBIT_OK;
     }
 
-    pOut = getBitmap() + getWidth()*(getHeight()-1);
-    pIn = pOut - getWidth()*n;
+    detach();
 
-    for (int y = 0; y < getHeight(); y++)
-    {
-        // Copy, and blank fill the leftmost column.
-        if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
-        else
-            memclr(pOut, getWidth());
+    pIn = getBitmap();
+    pOut = getBitmap() + getStride()*n;
 
-        pIn -= getWidth();
-        pOut -= getWidth();
-    }
+    // Rows are contiguous, so move them all at once and blank fill the top rows.
+    memmove(pOut, pIn, getStride()*(getHeight()-n));
+    memclr(pIn, getStride()*n);
 
     return MICROBIT_OK;
 }
@@ -786,21 +1134,20 @@ int MicroBitImage::shiftDown(int16_t n)
 ManagedString MicroBitImage::toString()
 {
     //width including commans and \n * height
-    int stringSize = getSize() * 2;
+    int stringSize = getWidth() * getHeight() * 2;
 
     //plus one for string terminator
     char parseBuffer[stringSize + 1];
 
     parseBuffer[stringSize] = '\0';
 
-    uint8_t *bitmapPtr = getBitmap();
-
     int parseIndex = 0;
     int widthCount = 0;
+    int row = 0;
 
     while (parseIndex < stringSize)
     {
-        if(*bitmapPtr)
+        if(image_read(ptr, getStride(), widthCount, row))
             parseBuffer[parseIndex] = '1';
         else
             parseBuffer[parseIndex] = '0';
@@ -811,6 +1158,7 @@ ManagedString MicroBitImage::toString()
         {
             parseBuffer[parseIndex] = '\n';
             widthCount = 0;
+            row++;
         }
         else
         {
@@ -819,7 +1167,6 @@ ManagedString MicroBitImage::toString()
         }
 
         parseIndex++;
-        bitmapPtr++;
     }
 
     return ManagedString(parseBuffer);
@@ -844,6 +1191,27 @@ ManagedString MicroBitImage::toString()
   */
 MicroBitImage MicroBitImage::crop(int startx, int starty, int cropWidth, int cropHeight)
 {
+    // Packed images are cropped pixel by pixel, into an image of the same format.
+    if (getFormat() != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        if (startx < 0 || starty < 0 || startx >= getWidth() || starty >= getHeight())
+            return MicroBitImage();
+
+        cropWidth = min(cropWidth, getWidth() - startx);
+        cropHeight = min(cropHeight, getHeight() - starty);
+
+        if (cropWidth <= 0 || cropHeight <= 0)
+            return MicroBitImage();
+
+        MicroBitImage cropped(cropWidth, cropHeight, getFormat());
+
+        for (int y = 0; y < cropHeight; y++)
+            for (int x = 0; x < cropWidth; x++)
+                image_write(cropped.ptr, cropped.getStride(), x, y, image_read(ptr, getStride(), startx + x, starty + y));
+
+        return cropped;
+    }
+
     int newWidth = startx + cropWidth;
     int newHeight = starty + cropHeight;
 
@@ -883,11 +1251,18 @@ bool MicroBitImage::isReadOnly()
 }
 
 /**
-  * Create a copy of the image bitmap. Used particularly, when isReadOnly() is true.
+  * Create a copy of the image bitmap.
+  *
+  * Modifying an image copies its bitmap automatically when it is shared, so this is only needed before
+  * writing to getBitmap() directly.
   *
   * @return an instance of MicroBitImage which can be modified independently of the current instance
   */
 MicroBitImage MicroBitImage::clone()
 {
-    return MicroBitImage(getWidth(), getHeight(), getBitmap());
+    MicroBitImage i(getWidth(), getHeight(), getFormat());
+
+    memcpy(i.getBitmap(), getBitmap(), getSize());
+
+    return i;
 }
@@ -0,0 +1,381 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Orientation calculations shared by MicroBitAccelerometer and MicroBitCompass.
+  *
+  * Each calculation is provided both in floating point, and in fixed point using CORDIC.
+  */
+#include "MicroBitOrientation.h"
+#include "MicroBitCompat.h"
+
+// atan(2^-i) for each CORDIC iteration, as binary angles.
+static const int32_t cordic_angles[MICROBIT_CORDIC_ITERATIONS] = {
+    8192, 4836, 2555, 1297, 651, 326, 163, 81, 41, 20, 10, 5, 3, 1, 1
+};
+
+// The reciprocal of the CORDIC gain, scaled by MICROBIT_ANGLE_UNITY.
+#define CORDIC_INVERSE_GAIN     9949
+
+// Inputs are scaled into this range before fixed point calculations, so that products with sines
+// and cosines, and the growth of the CORDIC vector, cannot overflow.
+#define FIXED_INPUT_LIMIT       (1 << MICROBIT_ANGLE_UNITY_SHIFT)
+
+/**
+  * Wraps a binary angle to the range -MICROBIT_ANGLE_HALF_TURN..(MICROBIT_ANGLE_HALF_TURN - 1).
+  */
+static inline int32_t fixed_wrap(int32_t angle)
+{
+    return ((angle + MICROBIT_ANGLE_HALF_TURN) & (MICROBIT_ANGLE_FULL_TURN - 1)) - MICROBIT_ANGLE_HALF_TURN;
+}
+
+/**
+  * Scales a vector down, preserving its direction, until each component is within FIXED_INPUT_LIMIT.
+  */
+static void fixed_normalise(int32_t &x, int32_t &y, int32_t &z)
+{
+    while (abs(x) >= FIXED_INPUT_LIMIT || abs(y) >= FIXED_INPUT_LIMIT || abs(z) >= FIXED_INPUT_LIMIT)
+    {
+        x >>= 1;
+        y >>= 1;
+        z >>= 1;
+    }
+}
+
+/**
+  * Calculates the angle of the vector (x, y) from the x axis, as atan2(y, x) does.
+  *
+  * @param y the y component of the vector.
+  *
+  * @param x the x component of the vector.
+  *
+  * @return the angle, as a binary angle between -MICROBIT_ANGLE_HALF_TURN and MICROBIT_ANGLE_HALF_TURN.
+  *         Zero is returned for a zero length vector.
+  */
+int32_t fixed_atan2(int32_t y, int32_t x)
+{
+    int32_t angle = 0;
+    int32_t nx;
+
+    if (x == 0 && y == 0)
+        return 0;
+
+    // Bring the vector to a known magnitude: small enough not to overflow, and large enough to keep precision.
+    while (abs(x) >= FIXED_INPUT_LIMIT || abs(y) >= FIXED_INPUT_LIMIT)
+    {
+        x >>= 1;
+        y >>= 1;
+    }
+
+    while (abs(x) < FIXED_INPUT_LIMIT / 2 && abs(y) < FIXED_INPUT_LIMIT / 2)
+    {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    // CORDIC converges for vectors in the right half plane, so rotate the others by half a turn first.
+    if (x < 0)
+    {
+        x = -x;
+        y = -y;
+        angle = MICROBIT_ANGLE_HALF_TURN;
+    }
+
+    // Rotate the vector onto the x axis, accumulating the angle rotated through.
+    for (int i = 0; i < MICROBIT_CORDIC_ITERATIONS; i++)
+    {
+        if (y > 0)
+        {
+            nx = x + (y >> i);
+            y = y - (x >> i);
+            angle += cordic_angles[i];
+        }
+        else
+        {
+            nx = x - (y >> i);
+            y = y + (x >> i);
+            angle -= cordic_angles[i];
+        }
+
+        x = nx;
+    }
+
+    return fixed_wrap(angle);
+}
+
+/**
+  * Calculates the sine and cosine of an angle.
+  *
+  * @param angle the angle, as a binary angle. Any value is accepted, and wrapped to a single turn.
+  *
+  * @param sine set to the sine of the angle, scaled by MICROBIT_ANGLE_UNITY.
+  *
+  * @param cosine set to the cosine of the angle, scaled by MICROBIT_ANGLE_UNITY.
+  */
+void fixed_sincos(int32_t angle, int32_t &sine, int32_t &cosine)
+{
+    int32_t x = CORDIC_INVERSE_GAIN;
+    int32_t y = 0;
+    int32_t nx;
+    bool negate = false;
+
+    // CORDIC converges for angles within a quarter turn of zero. Other angles are reflected through the origin.
+    angle = fixed_wrap(angle);
+
+    if (angle > MICROBIT_ANGLE_QUARTER_TURN)
+    {
+        angle -= MICROBIT_ANGLE_HALF_TURN;
+        negate = true;
+    }
+    else if (angle < -MICROBIT_ANGLE_QUARTER_TURN)
+    {
+        angle += MICROBIT_ANGLE_HALF_TURN;
+        negate = true;
+    }
+
+    // Rotate a unit vector (prescaled by the CORDIC gain) from the x axis through the angle.
+    for (int i = 0; i < MICROBIT_CORDIC_ITERATIONS; i++)
+    {
+        if (angle >= 0)
+        {
+            nx = x - (y >> i);
+            y = y + (x >> i);
+            angle -= cordic_angles[i];
+        }
+        else
+        {
+            nx = x + (y >> i);
+            y = y - (x >> i);
+            angle += cordic_angles[i];
+        }
+
+        x = nx;
+    }
+
+    sine = negate ? -y : y;
+    cosine = negate ? -x : x;
+}
+
+/**
+  * Converts an angle in radians to a binary angle.
+  *
+  * @param radians the angle, in radians.
+  *
+  * @return the binary angle.
+  */
+int32_t fixed_from_radians(float radians)
+{
+    return (int32_t) (radians * (float)(MICROBIT_ANGLE_HALF_TURN / PI));
+}
+
+/**
+  * Converts a binary angle to radians.
+  *
+  * @param angle the binary angle.
+  *
+  * @return the angle, in radians.
+  */
+float fixed_to_radians(int32_t angle)
+{
+    return angle * (float)(PI / MICROBIT_ANGLE_HALF_TURN);
+}
+
+/**
+  * Calculates the pitch and roll of the device from an accelerometer sample, in floating point.
+  *
+  * @param sample the accelerometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @param pitch set to the pitch of the device, in radians.
+  *
+  * @param roll set to the roll of the device, in radians.
+  */
+void orientation_pitch_roll(const Sample3D &sample, float &pitch, float &roll)
+{
+    double x = (double) sample.x;
+    double y = (double) sample.y;
+    double z = (double) sample.z;
+
+    roll = atan2(x, -z);
+    pitch = atan2(y, (x*sin(roll) - z*cos(roll)));
+
+#if CONFIG_ENABLED(MICROBIT_FULL_RANGE_PITCH_CALCULATION)
+
+    // Handle to the two "negative quadrants", such that we get an output in the +/- 18- degree range.
+    // This ensures that the pitch values are consistent with the roll values.
+    if (z > 0.0)
+    {
+        double reference = pitch > 0.0 ? (PI / 2.0) : (-PI / 2.0);
+        pitch = reference + (reference - pitch);
+    }
+#endif
+}
+
+/**
+  * Calculates the pitch and roll of the device from an accelerometer sample, in fixed point.
+  *
+  * @param sample the accelerometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @param pitch set to the pitch of the device, in radians.
+  *
+  * @param roll set to the roll of the device, in radians.
+  */
+void orientation_pitch_roll_fixed(const Sample3D &sample, float &pitch, float &roll)
+{
+    int32_t x = sample.x;
+    int32_t y = sample.y;
+    int32_t z = sample.z;
+    int32_t sinRoll, cosRoll;
+
+    fixed_normalise(x, y, z);
+
+    int32_t r = fixed_atan2(x, -z);
+    fixed_sincos(r, sinRoll, cosRoll);
+
+    // Both arguments are kept scaled by MICROBIT_ANGLE_UNITY to preserve precision. Each is within 2^29.
+    int32_t p = fixed_atan2(y << MICROBIT_ANGLE_UNITY_SHIFT, x*sinRoll - z*cosRoll);
+
+#if CONFIG_ENABLED(MICROBIT_FULL_RANGE_PITCH_CALCULATION)
+
+    // Handle to the two "negative quadrants", such that we get an output in the +/- 18- degree range.
+    // This ensures that the pitch values are consistent with the roll values.
+    if (z > 0)
+    {
+        int32_t reference = p > 0 ? MICROBIT_ANGLE_QUARTER_TURN : -MICROBIT_ANGLE_QUARTER_TURN;
+        p = reference + (reference - p);
+    }
+#endif
+
+    pitch = fixed_to_radians(p);
+    roll = fixed_to_radians(r);
+}
+
+/**
+  * Calculates a tilt compensated bearing from a magnetometer sample, in floating point.
+  *
+  * @param field the magnetometer sample, in the NORTH_EAST_DOWN coordinate system.
+  *
+  * @param pitch the pitch of the device, in radians.
+  *
+  * @param roll the roll of the device, in radians.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_bearing(const Sample3D &field, float pitch, float roll)
+{
+    // Precompute the tilt compensation parameters to improve readability.
+    float phi = roll;
+    float theta = pitch;
+
+    // Convert to floating point to reduce rounding errors
+    float x = (float) field.x;
+    float y = (float) field.y;
+    float z = (float) field.z;
+
+    // Precompute cos and sin of pitch and roll angles to make the calculation a little more efficient.
+    float sinPhi = sin(phi);
+    float cosPhi = cos(phi);
+    float sinTheta = sin(theta);
+    float cosTheta = cos(theta);
+
+    // Calculate the tilt compensated bearing, and convert to degrees.
+    float bearing = (360*atan2(x*cosTheta + y*sinTheta*sinPhi + z*sinTheta*cosPhi, z*sinPhi - y*cosPhi)) / (2*PI);
+
+    // Handle the 90 degree offset caused by the NORTH_EAST_DOWN based calculation.
+    bearing = 90 - bearing;
+
+    // Ensure the calculated bearing is in the 0..359 degree range.
+    if (bearing < 0)
+        bearing += 360.0f;
+
+    return (int) (bearing);
+}
+
+/**
+  * Calculates a tilt compensated bearing from a magnetometer sample, in fixed point.
+  *
+  * @param field the magnetometer sample, in the NORTH_EAST_DOWN coordinate system.
+  *
+  * @param pitch the pitch of the device, in radians.
+  *
+  * @param roll the roll of the device, in radians.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_bearing_fixed(const Sample3D &field, float pitch, float roll)
+{
+    int32_t x = field.x;
+    int32_t y = field.y;
+    int32_t z = field.z;
+    int32_t sinPhi, cosPhi, sinTheta, cosTheta;
+
+    fixed_normalise(x, y, z);
+
+    fixed_sincos(fixed_from_radians(roll), sinPhi, cosPhi);
+    fixed_sincos(fixed_from_radians(pitch), sinTheta, cosTheta);
+
+    // Calculate the tilt compensated bearing. Each term is within 2^28, so the sums cannot overflow.
+    int32_t north = x*cosTheta + ((y*sinTheta) >> MICROBIT_ANGLE_UNITY_SHIFT)*sinPhi + ((z*sinTheta) >> MICROBIT_ANGLE_UNITY_SHIFT)*cosPhi;
+    int32_t east = z*sinPhi - y*cosPhi;
+
+    // Handle the 90 degree offset caused by the NORTH_EAST_DOWN based calculation, and wrap into a single turn.
+    int32_t bearing = (MICROBIT_ANGLE_QUARTER_TURN - fixed_atan2(north, east)) & (MICROBIT_ANGLE_FULL_TURN - 1);
+
+    return (bearing * 360) >> 16;
+}
+
+/**
+  * Calculates a bearing from a magnetometer sample, without tilt compensation, in floating point.
+  *
+  * @param field the magnetometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_basic_bearing(const Sample3D &field)
+{
+    // Convert to floating point to reduce rounding errors
+    float x = (float) field.x;
+    float y = (float) field.y;
+
+    float bearing = (atan2(x,y))*180/PI;
+
+    if (bearing < 0)
+        bearing += 360.0;
+
+    return (int)bearing;
+}
+
+/**
+  * Calculates a bearing from a magnetometer sample, without tilt compensation, in fixed point.
+  *
+  * @param field the magnetometer sample, in the SIMPLE_CARTESIAN coordinate system.
+  *
+  * @return the bearing, in degrees from 0 to 359.
+  */
+int orientation_basic_bearing_fixed(const Sample3D &field)
+{
+    int32_t bearing = fixed_atan2(field.x, field.y) & (MICROBIT_ANGLE_FULL_TURN - 1);
+
+    return (bearing * 360) >> 16;
+}
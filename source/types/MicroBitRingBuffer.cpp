@@ -0,0 +1,398 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitRingBuffer.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Creates an empty ring buffer. No storage is allocated until allocate() is called.
+  *
+  * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+  */
+MicroBitRingBuffer::MicroBitRingBuffer(int capacity)
+{
+    buffer = NULL;
+    size = storageFor(capacity);
+    head = 0;
+    tail = 0;
+}
+
+/**
+  * Destructor.
+  *
+  * Frees the storage of this ring buffer.
+  */
+MicroBitRingBuffer::~MicroBitRingBuffer()
+{
+    release();
+}
+
+/**
+  * Changes the number of bytes the buffer can hold. This takes effect the next time allocate() is called.
+  *
+  * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+  */
+void MicroBitRingBuffer::setCapacity(int capacity)
+{
+    size = storageFor(capacity);
+}
+
+/**
+  * Allocates new storage for this ring buffer, freeing any existing storage and its contents.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @note interrupts that use this buffer should be disabled while it is reallocated.
+  */
+int MicroBitRingBuffer::allocate()
+{
+    release();
+
+    if((buffer = (uint8_t *)malloc(size)) == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Frees the storage of this ring buffer.
+  */
+void MicroBitRingBuffer::release()
+{
+    if(buffer != NULL)
+        free(buffer);
+
+    buffer = NULL;
+    head = 0;
+    tail = 0;
+}
+
+/**
+  * Determines the storage needed for a buffer of the given capacity.
+  *
+  * @param capacity the number of bytes the buffer should hold, up to MICROBIT_RING_BUFFER_MAX_SIZE.
+  *
+  * @return the number of bytes of storage for the buffer.
+  */
+uint16_t MicroBitRingBuffer::storageFor(int capacity)
+{
+    // + 1 so there is a usable buffer of the size requested.
+    capacity = min(max(capacity, 0), MICROBIT_RING_BUFFER_MAX_SIZE) + 1;
+
+#if CONFIG_ENABLED(MICROBIT_SERIAL_POWER_OF_TWO_BUFFERS)
+    int slots = 1;
+
+    while(slots < capacity)
+        slots <<= 1;
+
+    capacity = slots;
+#endif
+
+    return capacity;
+}
+
+/**
+  * Reads a byte from the buffer, without removing it. Called by the consumer only.
+  *
+  * @param offset the position of the byte, relative to the tail of the buffer.
+  *
+  * @return the byte, or -1 if fewer than offset + 1 bytes are buffered.
+  */
+int MicroBitRingBuffer::peek(int offset)
+{
+    if(offset < 0 || offset >= length())
+        return -1;
+
+    return buffer[wrap(tail + offset)];
+}
+
+/**
+  * Adds as many bytes as will fit to the head of the buffer. Called by the producer only.
+  *
+  * @param data the bytes to add.
+  *
+  * @param len the number of bytes to add.
+  *
+  * @return the number of bytes added.
+  */
+int MicroBitRingBuffer::write(const uint8_t *data, int len)
+{
+    uint16_t h = head;
+    int n = min(len, space());
+
+    if(n <= 0)
+        return 0;
+
+    //copy up to the end of the storage, then the remainder to its start.
+    int first = min(n, size - h);
+
+    memcpy(buffer + h, data, first);
+    memcpy(buffer, data + first, n - first);
+
+    head = wrap(h + n);
+
+    return n;
+}
+
+/**
+  * Removes up to len bytes from the tail of the buffer. Called by the consumer only.
+  *
+  * @param data the buffer to store the bytes in.
+  *
+  * @param len the largest number of bytes to remove.
+  *
+  * @return the number of bytes removed.
+  */
+int MicroBitRingBuffer::read(uint8_t *data, int len)
+{
+    int n = copy(data, len);
+
+    tail = wrap(tail + n);
+
+    return n;
+}
+
+/**
+  * Copies up to len bytes from the tail of the buffer, without removing them. Called by the consumer only.
+  *
+  * @param data the buffer to store the bytes in.
+  *
+  * @param len the largest number of bytes to copy.
+  *
+  * @return the number of bytes copied.
+  */
+int MicroBitRingBuffer::copy(uint8_t *data, int len)
+{
+    uint16_t t = tail;
+    int n = min(len, length());
+
+    if(n <= 0)
+        return 0;
+
+    //copy up to the end of the storage, then the remainder from its start.
+    int first = min(n, size - t);
+
+    memcpy(data, buffer + t, first);
+    memcpy(data + first, buffer, n - first);
+
+    return n;
+}
+
+/**
+  * Searches the buffered bytes for the first character in a delimeter map.
+  *
+  * @param map a delimeter map, built with delimeterMap().
+  *
+  * @param offset the position to search from, relative to the tail of the buffer.
+  *
+  * @return the position of the first delimeter relative to the tail of the buffer, or -1 if none is buffered.
+  */
+int MicroBitRingBuffer::find(const uint32_t *map, int offset)
+{
+    int n = length();
+
+    if(offset < 0)
+        offset = 0;
+
+    uint16_t i = wrap(tail + offset);
+
+    for(int position = offset; position < n; position++, i = next(i))
+        if(isDelimeter(map, buffer[i]))
+            return position;
+
+    return -1;
+}
+
+/**
+  * Provides direct access to the longest contiguous run of buffered bytes. Called by the consumer only.
+  *
+  * @param data set to point at the first buffered byte.
+  *
+  * @return the number of bytes in the run.
+  */
+int MicroBitRingBuffer::getReadRegion(uint8_t *&data)
+{
+    uint16_t h = head;
+
+    data = buffer + tail;
+
+    return (h >= tail) ? h - tail : size - tail;
+}
+
+/**
+  * Removes bytes from the tail of the buffer, after they have been read through getReadRegion().
+  *
+  * @param len the number of bytes to remove.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than are buffered.
+  */
+int MicroBitRingBuffer::commitRead(int len)
+{
+    if(len < 0 || len > length())
+        return MICROBIT_INVALID_PARAMETER;
+
+    tail = wrap(tail + len);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Provides direct access to the longest contiguous run of free storage. Called by the producer only.
+  *
+  * @param data set to point at the first free byte.
+  *
+  * @return the number of bytes in the run.
+  */
+int MicroBitRingBuffer::getWriteRegion(uint8_t *&data)
+{
+    uint16_t t = tail;
+
+    data = buffer + head;
+
+    //one byte is always left free, so that a full buffer can be told apart from an empty one.
+    if(head >= t)
+        return size - head - (t == 0 ? 1 : 0);
+
+    return t - head - 1;
+}
+
+/**
+  * Adds bytes to the head of the buffer, after they have been written through getWriteRegion().
+  *
+  * @param len the number of bytes to add.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if len is negative or more than will fit.
+  */
+int MicroBitRingBuffer::commitWrite(int len)
+{
+    uint8_t *data;
+
+    if(len < 0 || len > getWriteRegion(data))
+        return MICROBIT_INVALID_PARAMETER;
+
+    head = wrap(head + len);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Discards the buffered bytes. Called by the consumer only.
+  */
+void MicroBitRingBuffer::clear()
+{
+    tail = head;
+}
+
+/**
+  * @return the number of bytes currently buffered.
+  */
+int MicroBitRingBuffer::length()
+{
+    uint16_t h = head;
+    uint16_t t = tail;
+
+    if(t > h)
+        return (size - t) + h;
+
+    return h - t;
+}
+
+/**
+  * @return the number of bytes that can be added before the buffer is full.
+  */
+int MicroBitRingBuffer::space()
+{
+    return size - 1 - length();
+}
+
+/**
+  * @return true if no bytes are buffered.
+  */
+bool MicroBitRingBuffer::isEmpty()
+{
+    return head == tail;
+}
+
+/**
+  * @return true if no more bytes can be added.
+  */
+bool MicroBitRingBuffer::isFull()
+{
+    return next(head) == tail;
+}
+
+/**
+  * @return the number of bytes the buffer can hold.
+  */
+int MicroBitRingBuffer::getCapacity()
+{
+    return size - 1;
+}
+
+/**
+  * @return the number of bytes of storage, including the byte that is always left free.
+  */
+int MicroBitRingBuffer::getSize()
+{
+    return size;
+}
+
+/**
+  * @return the head index, where the next byte added will be stored.
+  */
+uint16_t MicroBitRingBuffer::getHead()
+{
+    return head;
+}
+
+/**
+  * @return a pointer to the storage of this buffer, or NULL if it has none.
+  */
+uint8_t *MicroBitRingBuffer::getBuffer()
+{
+    return buffer;
+}
+
+/**
+  * Builds a bitmap of the given delimeters, with one bit for each character value, so that
+  * characters can be matched with a single lookup.
+  *
+  * @param delimeters the delimeter characters.
+  *
+  * @param map the bitmap of 8 words to populate.
+  */
+void MicroBitRingBuffer::delimeterMap(ManagedString delimeters, uint32_t *map)
+{
+    memclr(map, 8 * sizeof(uint32_t));
+
+    for(int i = 0; i < delimeters.length(); i++)
+    {
+        uint8_t c = delimeters.charAt(i);
+        map[c >> 5] |= 1UL << (c & 0x1F);
+    }
+}
@@ -0,0 +1,276 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitSampleFilter.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Creates a filter that passes samples through unchanged.
+  */
+MicroBitSampleFilter::MicroBitSampleFilter()
+{
+    history = NULL;
+    type = MICROBIT_FILTER_NONE;
+    length = 1;
+    shift = 0;
+
+    reset();
+}
+
+/**
+  * Destructor.
+  *
+  * Frees the storage of the filter, if any.
+  */
+MicroBitSampleFilter::~MicroBitSampleFilter()
+{
+    if (history != NULL)
+        free(history);
+}
+
+/**
+  * Selects the filter to apply, discarding any samples it holds.
+  *
+  * @param type The type of filter: MICROBIT_FILTER_NONE, MICROBIT_FILTER_MOVING_AVERAGE,
+  *        MICROBIT_FILTER_EXPONENTIAL or MICROBIT_FILTER_MEDIAN.
+  *
+  * @param length The number of samples to filter over, from 1 to MICROBIT_FILTER_MAX_LENGTH.
+  *        For the exponential filter, this is the time constant in samples, and must be a power of two.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if type or length is out of range,
+  *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  *
+  * @note If the filter is fed from an interrupt, reconfiguring it is safe, but should be rare.
+  */
+int MicroBitSampleFilter::configure(int type, int length)
+{
+    Sample3D *h = NULL;
+    Sample3D *old;
+
+    if (!isValid(type, length))
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (type == MICROBIT_FILTER_MOVING_AVERAGE || type == MICROBIT_FILTER_MEDIAN)
+    {
+        h = (Sample3D *) malloc(length * sizeof(Sample3D));
+
+        if (h == NULL)
+            return MICROBIT_NO_RESOURCES;
+    }
+
+    // Swap the storage over atomically, in case the filter is fed from an interrupt.
+    __disable_irq();
+
+    old = history;
+    history = h;
+
+    this->type = type;
+    this->length = length;
+
+    for (shift = 0; (1 << shift) < length; shift++);
+
+    reset();
+
+    __enable_irq();
+
+    if (old != NULL)
+        free(old);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines if a filter type and length are supported, as given to configure().
+  *
+  * @return true if the filter can be configured, false otherwise.
+  */
+bool MicroBitSampleFilter::isValid(int type, int length)
+{
+    if (type < MICROBIT_FILTER_NONE || type > MICROBIT_FILTER_MEDIAN || length < 1 || length > MICROBIT_FILTER_MAX_LENGTH)
+        return false;
+
+    // The exponential filter divides by its length with a shift.
+    if (type == MICROBIT_FILTER_EXPONENTIAL && (length & (length - 1)))
+        return false;
+
+    return true;
+}
+
+/**
+  * @return the type of filter in use, e.g. MICROBIT_FILTER_MEDIAN.
+  */
+int MicroBitSampleFilter::getType()
+{
+    return type;
+}
+
+/**
+  * @return the number of samples filtered over.
+  */
+int MicroBitSampleFilter::getLength()
+{
+    return length;
+}
+
+/**
+  * Discards the samples held, so the next sample is passed through unchanged.
+  */
+void MicroBitSampleFilter::reset()
+{
+    count = 0;
+    head = 0;
+
+    state[0] = state[1] = state[2] = 0;
+}
+
+/**
+  * Sorts a handful of values into ascending order, and returns their median.
+  */
+static int median(int *v, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        int t = v[i];
+        int j = i;
+
+        while (j > 0 && v[j-1] > t)
+        {
+            v[j] = v[j-1];
+            j--;
+        }
+
+        v[j] = t;
+    }
+
+    return (v[(n - 1) / 2] + v[n / 2]) / 2;
+}
+
+/**
+  * Adds a sample to the filter. Called by the sensor driver only.
+  *
+  * @param sample The sample to add.
+  *
+  * @return the filtered value, including this sample.
+  */
+Sample3D MicroBitSampleFilter::push(const Sample3D &sample)
+{
+    switch (type)
+    {
+        case MICROBIT_FILTER_MOVING_AVERAGE:
+        case MICROBIT_FILTER_MEDIAN:
+            // Replace the oldest sample held, keeping a running sum of those that remain.
+            if (count == length)
+            {
+                state[0] -= history[head].x;
+                state[1] -= history[head].y;
+                state[2] -= history[head].z;
+            }
+            else
+            {
+                count++;
+            }
+
+            history[head] = sample;
+            head = (head + 1) % length;
+
+            state[0] += sample.x;
+            state[1] += sample.y;
+            state[2] += sample.z;
+
+            if (type == MICROBIT_FILTER_MOVING_AVERAGE)
+            {
+                output.x = state[0] / count;
+                output.y = state[1] / count;
+                output.z = state[2] / count;
+            }
+            else
+            {
+                int x[MICROBIT_FILTER_MAX_LENGTH];
+                int y[MICROBIT_FILTER_MAX_LENGTH];
+                int z[MICROBIT_FILTER_MAX_LENGTH];
+
+                for (int i = 0; i < count; i++)
+                {
+                    x[i] = history[i].x;
+                    y[i] = history[i].y;
+                    z[i] = history[i].z;
+                }
+
+                output.x = median(x, count);
+                output.y = median(y, count);
+                output.z = median(z, count);
+            }
+            break;
+
+        case MICROBIT_FILTER_EXPONENTIAL:
+            // Hold the output with 4 extra bits of precision, so that small changes aren't lost to the shift.
+            if (count == 0)
+            {
+                state[0] = sample.x * 16;
+                state[1] = sample.y * 16;
+                state[2] = sample.z * 16;
+                count = 1;
+            }
+            else
+            {
+                state[0] += (sample.x * 16 - state[0]) >> shift;
+                state[1] += (sample.y * 16 - state[1]) >> shift;
+                state[2] += (sample.z * 16 - state[2]) >> shift;
+            }
+
+            output.x = state[0] / 16;
+            output.y = state[1] / 16;
+            output.z = state[2] / 16;
+            break;
+
+        default:
+            output = sample;
+            break;
+    }
+
+    return output;
+}
+
+/**
+  * Adds a scalar sample to the filter. Called by the sensor driver only.
+  *
+  * @param value The sample to add.
+  *
+  * @return the filtered value, including this sample.
+  */
+int MicroBitSampleFilter::push(int value)
+{
+    return push(Sample3D(value, 0, 0)).x;
+}
+
+/**
+  * @return the filtered value, as of the last sample pushed.
+  */
+Sample3D MicroBitSampleFilter::get()
+{
+    return output;
+}
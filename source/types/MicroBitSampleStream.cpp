@@ -0,0 +1,143 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitSampleStream.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * Creates a disabled sample stream.
+  */
+MicroBitSampleStream::MicroBitSampleStream() : buffer(0)
+{
+    overflows = 0;
+}
+
+/**
+  * Sets the number of samples the stream can hold, discarding any samples it holds.
+  *
+  * @param samples the number of samples to hold, or zero to disable the stream and free its storage.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if samples is out of range,
+  *         or MICROBIT_NO_RESOURCES if the storage could not be allocated.
+  */
+int MicroBitSampleStream::setCapacity(int samples)
+{
+    if (samples < 0 || samples > MICROBIT_RING_BUFFER_MAX_SIZE / (int)sizeof(TimedSample3D))
+        return MICROBIT_INVALID_PARAMETER;
+
+    overflows = 0;
+
+    if (samples == 0)
+    {
+        buffer.release();
+        return MICROBIT_OK;
+    }
+
+    buffer.setCapacity(samples * sizeof(TimedSample3D));
+    return buffer.allocate();
+}
+
+/**
+  * @return the number of samples the stream can hold, or zero if it is disabled.
+  */
+int MicroBitSampleStream::getCapacity()
+{
+    if (buffer.getBuffer() == NULL)
+        return 0;
+
+    return buffer.getCapacity() / sizeof(TimedSample3D);
+}
+
+/**
+  * Adds a sample to the stream, timestamped with the current system time. Called by the sensor driver only.
+  *
+  * @param sample the sample to add.
+  */
+void MicroBitSampleStream::push(const Sample3D &sample)
+{
+    if (buffer.getBuffer() == NULL)
+        return;
+
+    // Only whole samples are ever stored, so the consumer never sees part of one.
+    if (buffer.space() < (int)sizeof(TimedSample3D))
+    {
+        overflows++;
+        return;
+    }
+
+    TimedSample3D s;
+    s.sample = sample;
+    s.timestamp = (uint32_t) system_timer_current_time_us();
+
+    buffer.write((uint8_t *)&s, sizeof(TimedSample3D));
+}
+
+/**
+  * Removes up to length of the oldest samples from the stream. Called by the consumer only.
+  *
+  * @param samples the buffer to store the samples in.
+  *
+  * @param length the largest number of samples to remove.
+  *
+  * @return the number of samples removed, or MICROBIT_INVALID_PARAMETER if samples is NULL.
+  */
+int MicroBitSampleStream::read(TimedSample3D *samples, int length)
+{
+    if (samples == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (buffer.getBuffer() == NULL)
+        return 0;
+
+    int count = min(length, available());
+
+    if (count <= 0)
+        return 0;
+
+    return buffer.read((uint8_t *)samples, count * sizeof(TimedSample3D)) / sizeof(TimedSample3D);
+}
+
+/**
+  * @return the number of samples waiting to be read.
+  */
+int MicroBitSampleStream::available()
+{
+    if (buffer.getBuffer() == NULL)
+        return 0;
+
+    return buffer.length() / sizeof(TimedSample3D);
+}
+
+/**
+  * @return the number of samples discarded because the stream was full, since its capacity was last set.
+  */
+uint32_t MicroBitSampleStream::getOverflowCount()
+{
+    return overflows;
+}
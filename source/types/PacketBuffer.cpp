@@ -25,6 +25,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "PacketBuffer.h"
+#include "MicroBitMemoryPool.h"
 #include "ErrorNo.h"
 
 // Create the EmptyPacket reference.
@@ -79,6 +80,18 @@ PacketBuffer::PacketBuffer(uint8_t *data, int length, int rssi)
     this->init(data, length, rssi);
 }
 
+/**
+  * Constructor.
+  * Creates a PacketBuffer that takes ownership of an existing payload, without copying it.
+  *
+  * @param data The payload to adopt. This must have been initialised with a single reference,
+  *             and be held in memory that can be released with microbit_pool_free().
+  */
+PacketBuffer::PacketBuffer(PacketData *data)
+{
+    ptr = data;
+}
+
 /**
   * Copy Constructor.
   * Add ourselves as a reference to an existing PacketBuffer.
@@ -96,6 +109,9 @@ PacketBuffer::PacketBuffer(const PacketBuffer &buffer)
     ptr->incr();
 }
 
+// Payloads of typical radio packets are recycled through a pool, rather than churning the heap.
+static MicroBitMemoryPool packetPool(sizeof(PacketData) + MICROBIT_PACKET_POOL_PAYLOAD_SIZE, MICROBIT_PACKET_POOL_SIZE);
+
 /**
   * Internal constructor-initialiser.
   *
@@ -110,7 +126,15 @@ void PacketBuffer::init(uint8_t *data, int length, int rssi)
     if (length < 0)
         length = 0;
 
-    ptr = (PacketData *) malloc(sizeof(PacketData) + length);
+    ptr = NULL;
+
+    // The payload is returned to the pool by RefCounted::decr(), once it is no longer referenced.
+    if (length <= MICROBIT_PACKET_POOL_PAYLOAD_SIZE)
+        ptr = (PacketData *) packetPool.allocate();
+
+    if (ptr == NULL)
+        ptr = (PacketData *) malloc(sizeof(PacketData) + length);
+
     ptr->init();
 
     ptr->length = length;
@@ -282,6 +306,18 @@ uint8_t*PacketBuffer::getBytes()
     return ptr->payload;
 }
 
+/**
+  * Provide a pointer to the MICROBIT_PACKET_BUFFER_HEADROOM bytes held immediately ahead of the packet data,
+  * which a lower layer may use to prepend a header in place. These bytes are not part of the packet contents,
+  * and are not copied or compared with the packet.
+  *
+  * @return The start of the headroom. The packet data follows it directly.
+  */
+uint8_t *PacketBuffer::getHeadroom()
+{
+    return ptr->headroom;
+}
+
 /**
   * Gets number of bytes in this buffer
   *
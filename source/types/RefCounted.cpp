@@ -30,7 +30,9 @@ DEALINGS IN THE SOFTWARE.
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "RefCounted.h"
-#include "MicroBitDisplay.h"
+#include "MicroBitMemoryPool.h"
+#include "MicroBitDevice.h"
+#include "ErrorNo.h"
 
 /**
   * Initializes for one outstanding reference.
@@ -74,6 +76,16 @@ bool RefCounted::isReadOnly()
     return isReadOnlyInline(this);
 }
 
+/**
+  * Checks if the object may be seen by more than one owner, and so must be copied before it is modified.
+  *
+  * @return true if the object resides in flash memory or has more than one outstanding reference, false otherwise.
+  */
+bool RefCounted::isShared()
+{
+    return isReadOnlyInline(this) || refCount > 3;
+}
+
 /**
   * Increment reference count.
   */
@@ -93,6 +105,7 @@ void RefCounted::decr()
 
     refCount -= 2;
     if (refCount == 1) {
-        free(this);
+        // Return the memory to the pool it came from, if any.
+        microbit_pool_free(this);
     }
 }